@@ -0,0 +1,391 @@
+﻿#ifndef __VSNC_UTILS_CLOCK_H__
+#define __VSNC_UTILS_CLOCK_H__
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define __VSNC_CLOCK_TSC__
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif // _MSC_VER
+#endif // x86
+
+
+namespace vsnc
+{
+
+	namespace utils
+	{
+
+
+		/// <summary>
+		/// 获取以纳秒为单位的单调时间，时间基准与__steady()相同
+		/// </summary>
+		/// <returns>以纳秒为单位的单调时间</returns>
+		inline int64_t __monotonic_ns() noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+
+		/// <summary>
+		/// <para>基于时间戳计数器（rdtsc）的单调时钟</para>
+		/// <para>以约Calibration_Ms毫秒的忙等对照__monotonic_ns()标定频率，应在启动时调用Calibrate完成，否则在首次读取时进行；此后读取只需一条rdtsc、一次乘法与一个顺序锁，结果与__monotonic_ns()同一时间基准</para>
+		/// <para>每隔Reanchor_Ms毫秒由恰好读取的线程重新对照__monotonic_ns()锚定一次，并以自标定起的整个时长修正频率，使误差不随运行时间累积；重新锚定只向前跳，读数不会倒退</para>
+		/// <para>CPU不支持恒定频率的TSC或非x86平台时退化为__monotonic_ns()</para>
+		/// </summary>
+		class TscClock
+		{
+		public:
+
+			/// <summary>以毫秒为单位的标定时长</summary>
+			static constexpr int64_t Calibration_Ms = 20;
+			/// <summary>以毫秒为单位的重新锚定间隔</summary>
+			static constexpr int64_t Reanchor_Ms    = 1000;
+
+		public:
+
+			/// <summary>
+			/// 获取进程内唯一的实例，首次调用时标定
+			/// </summary>
+			/// <returns>实例</returns>
+			static const TscClock& Instance()
+			{
+				static const TscClock clock;
+				return clock;
+			}
+
+			/// <summary>
+			/// 在启动时标定，使标定的忙等不落在首次读取时间的调用方
+			/// </summary>
+			static void Calibrate() { Instance(); }
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			TscClock(const TscClock&) = delete;
+
+			/// <summary>
+			/// 获取以纳秒为单位的单调时间
+			/// </summary>
+			/// <returns>以纳秒为单位的单调时间</returns>
+			int64_t Now() const noexcept;
+
+			/// <summary>
+			/// 判断是否使用了TSC
+			/// </summary>
+			/// <returns>使用TSC返回true，退化为__monotonic_ns()返回false</returns>
+			bool    Available() const noexcept { return m_bAvailable; }
+
+			/// <summary>
+			/// 获取标定得到的TSC频率
+			/// </summary>
+			/// <returns>以赫兹为单位的频率，不可用时为0</returns>
+			double  Frequency() const noexcept { return m_bAvailable ? (1e9 / m_dNsPerTick.load(std::memory_order_relaxed)) : 0.0; }
+
+			/// <summary>
+			/// 获取重新锚定的次数
+			/// </summary>
+			/// <returns>重新锚定的次数</returns>
+			uint64_t Reanchors() const noexcept { return m_uSeq.load(std::memory_order_relaxed) / 2; }
+
+		private:
+
+			/// <summary>
+			/// 构造函数，检测并标定TSC
+			/// </summary>
+			TscClock() noexcept;
+
+			/// <summary>
+			/// 同时采样TSC与单调时间，取读取窗口最小的一次以减小误差
+			/// </summary>
+			/// <param name="tsc">TSC读数</param>
+			/// <param name="ns">对应的以纳秒为单位的单调时间</param>
+			static void _Sample(uint64_t& tsc, int64_t& ns) noexcept;
+
+			/// <summary>
+			/// 重新锚定，同时只有一个线程进行，其他线程照常以旧锚点读取
+			/// </summary>
+			/// <param name="seq">读取锚点时的顺序号</param>
+			/// <param name="base">读取到的锚点TSC读数</param>
+			/// <param name="ns">读取到的锚点单调时间</param>
+			/// <param name="k">读取到的每个TSC周期的纳秒数</param>
+			void        _Reanchor(uint32_t seq, const uint64_t base, const int64_t ns, const double k) const noexcept;
+
+			/// <summary>
+			/// 检测CPU是否提供恒定频率的TSC
+			/// </summary>
+			/// <returns>提供返回true</returns>
+			static bool _Invariant() noexcept;
+
+		private:
+
+			/// <summary>是否使用TSC</summary>
+			bool                          m_bAvailable;
+			/// <summary>标定起点的TSC读数</summary>
+			uint64_t                      m_uStartTsc;
+			/// <summary>标定起点的单调时间</summary>
+			int64_t                       m_iStartNs;
+			/// <summary>以TSC周期计的重新锚定间隔</summary>
+			int64_t                       m_iInterval;
+			/// <summary>锚点的顺序号，奇数表示正在重新锚定</summary>
+			mutable std::atomic<uint32_t> m_uSeq;
+			/// <summary>锚点的TSC读数</summary>
+			mutable std::atomic<uint64_t> m_uBaseTsc;
+			/// <summary>锚点的单调时间</summary>
+			mutable std::atomic<int64_t>  m_iBaseNs;
+			/// <summary>每个TSC周期的纳秒数</summary>
+			mutable std::atomic<double>   m_dNsPerTick;
+		};
+
+
+		/// <summary>
+		/// 基于TSC获取以纳秒为单位的单调时间，时间基准与__monotonic_ns()相同
+		/// </summary>
+		/// <returns>以纳秒为单位的单调时间</returns>
+		inline int64_t __tsc_ns() noexcept { return TscClock::Instance().Now(); }
+
+
+		/// <summary>
+		/// <para>粗粒度缓存时钟</para>
+		/// <para>由后台线程每隔Interval微秒将__monotonic_ns()写入共享变量，读取只是一次原子读，适合每个数据包都要取时间的循环</para>
+		/// <para>进程内同时只应存在一个实例；没有实例时Now()退化为__monotonic_ns()</para>
+		/// </summary>
+		class CoarseClock
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数，启动更新线程
+			/// </summary>
+			/// <param name="interval">以微秒为单位的更新间隔，即读数的最大误差</param>
+			explicit CoarseClock(const int64_t interval = 1000);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			CoarseClock(const CoarseClock&) = delete;
+
+			/// <summary>
+			/// 析构函数，停止更新线程
+			/// </summary>
+			~CoarseClock();
+
+			/// <summary>
+			/// 获取缓存的以纳秒为单位的单调时间
+			/// </summary>
+			/// <returns>以纳秒为单位的单调时间</returns>
+			static int64_t Now() noexcept
+			{
+				auto ns = _Cache().load(std::memory_order_relaxed);
+				return ns ? ns : __monotonic_ns();
+			}
+
+		private:
+
+			/// <summary>
+			/// 获取共享的缓存时间
+			/// </summary>
+			/// <returns>缓存时间</returns>
+			static std::atomic<int64_t>& _Cache() noexcept
+			{
+				static std::atomic<int64_t> cache { 0 };
+				return cache;
+			}
+
+		private:
+
+			/// <summary>运行状态</summary>
+			std::atomic<bool> m_bRun;
+			/// <summary>更新线程</summary>
+			std::thread       m_iThread;
+		};
+
+
+		/// <summary>
+		/// 获取缓存的以纳秒为单位的单调时间，精度为CoarseClock的更新间隔
+		/// </summary>
+		/// <returns>以纳秒为单位的单调时间</returns>
+		inline int64_t __coarse_ns() noexcept { return CoarseClock::Now(); }
+
+		/// <summary>
+		/// <para>获取单调时间与UTC时间之差</para>
+		/// <para>首次调用时采样一次，此后不随系统时间调整变化，因此同一进程内的换算结果保持单调</para>
+		/// </summary>
+		/// <returns>以纳秒为单位的UTC时间减单调时间</returns>
+		inline int64_t __utc_offset_ns() noexcept
+		{
+			static const int64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count() - __monotonic_ns();
+			return offset;
+		}
+
+		/// <summary>
+		/// 将单调时间换算为Client::Send与Receive使用的以毫秒为单位的UTC时间戳
+		/// </summary>
+		/// <param name="ns">以纳秒为单位的单调时间</param>
+		/// <returns>以毫秒为单位的UTC时间</returns>
+		inline int64_t __monotonic_to_utc(const int64_t ns) noexcept { return (ns + __utc_offset_ns()) / 1000000; }
+
+		/// <summary>
+		/// 将以毫秒为单位的UTC时间戳换算为本进程的单调时间
+		/// </summary>
+		/// <param name="utc">以毫秒为单位的UTC时间</param>
+		/// <returns>以纳秒为单位的单调时间</returns>
+		inline int64_t __utc_to_monotonic(const int64_t utc) noexcept { return utc * 1000000 - __utc_offset_ns(); }
+
+
+	}
+
+}
+
+
+inline vsnc::utils::TscClock::TscClock() noexcept :
+	m_bAvailable(false),
+	m_uStartTsc(0),
+	m_iStartNs(0),
+	m_iInterval(INT64_MAX),
+	m_uSeq(0),
+	m_uBaseTsc(0),
+	m_iBaseNs(0),
+	m_dNsPerTick(0.0)
+{
+	if (!_Invariant()) {
+		return;
+	}
+	uint64_t tsc0 = 0, tsc1 = 0;
+	int64_t ns0 = 0, ns1 = 0;
+	_Sample(tsc0, ns0);
+	do {
+		_Sample(tsc1, ns1);
+	} while (ns1 - ns0 < Calibration_Ms * 1000000);
+	if (tsc1 <= tsc0) {
+		return;
+	}
+	auto k = static_cast<double>(ns1 - ns0) / static_cast<double>(tsc1 - tsc0);
+	m_uStartTsc = tsc0;
+	m_iStartNs = ns0;
+	m_iInterval = static_cast<int64_t>(Reanchor_Ms * 1000000 / k);
+	m_uBaseTsc.store(tsc1, std::memory_order_relaxed);
+	m_iBaseNs.store(ns1, std::memory_order_relaxed);
+	m_dNsPerTick.store(k, std::memory_order_relaxed);
+	m_bAvailable = true;
+}
+
+
+inline int64_t vsnc::utils::TscClock::Now() const noexcept
+{
+#ifdef __VSNC_CLOCK_TSC__
+	while (m_bAvailable) {
+		auto tsc = __rdtsc();
+		auto seq = m_uSeq.load(std::memory_order_acquire);
+		auto base = m_uBaseTsc.load(std::memory_order_relaxed);
+		auto ns = m_iBaseNs.load(std::memory_order_relaxed);
+		auto k = m_dNsPerTick.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if ((seq & 1) || (seq != m_uSeq.load(std::memory_order_relaxed))) {
+			continue;
+		}
+		auto delta = static_cast<int64_t>(tsc - base);
+		if (delta >= m_iInterval) {
+			_Reanchor(seq, base, ns, k);
+			continue;
+		}
+		return ns + static_cast<int64_t>(static_cast<double>(delta) * k);
+	}
+#endif // __VSNC_CLOCK_TSC__
+	return __monotonic_ns();
+}
+
+
+inline void vsnc::utils::TscClock::_Sample(uint64_t& tsc, int64_t& ns) noexcept
+{
+#ifdef __VSNC_CLOCK_TSC__
+	uint64_t best = UINT64_MAX;
+	for (int i = 0; i < 5; ++i) {
+		auto before = __rdtsc();
+		auto t = __monotonic_ns();
+		auto after = __rdtsc();
+		if (after - before < best) {
+			best = after - before;
+			tsc = before + (after - before) / 2;
+			ns = t;
+		}
+	}
+#else
+	tsc = 0;
+	ns = __monotonic_ns();
+#endif // __VSNC_CLOCK_TSC__
+}
+
+
+inline void vsnc::utils::TscClock::_Reanchor(uint32_t seq, const uint64_t base, const int64_t ns, const double k) const noexcept
+{
+	if (!m_uSeq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire)) {
+		return;
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	uint64_t tsc = 0;
+	int64_t now = 0;
+	_Sample(tsc, now);
+	// 以自标定起的整个时长修正频率，锚点取单调时间与旧锚点外推值中较大者，使读数不倒退
+	auto predicted = ns + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(tsc - base)) * k);
+	m_uBaseTsc.store(tsc, std::memory_order_relaxed);
+	m_iBaseNs.store((std::max)(now, predicted), std::memory_order_relaxed);
+	m_dNsPerTick.store(static_cast<double>(now - m_iStartNs) / static_cast<double>(tsc - m_uStartTsc), std::memory_order_relaxed);
+	m_uSeq.store(seq + 2, std::memory_order_release);
+}
+
+
+inline bool vsnc::utils::TscClock::_Invariant() noexcept
+{
+#ifdef __VSNC_CLOCK_TSC__
+#ifdef _MSC_VER
+	int regs[4] = { 0 };
+	__cpuid(regs, 0x80000000);
+	if (static_cast<unsigned>(regs[0]) < 0x80000007u) {
+		return false;
+	}
+	__cpuid(regs, 0x80000007);
+	return (regs[3] & (1 << 8)) != 0;
+#else
+	unsigned a = 0, b = 0, c = 0, d = 0;
+	if (!__get_cpuid(0x80000007, &a, &b, &c, &d)) {
+		return false;
+	}
+	return (d & (1u << 8)) != 0;
+#endif // _MSC_VER
+#else
+	return false;
+#endif // __VSNC_CLOCK_TSC__
+}
+
+
+inline vsnc::utils::CoarseClock::CoarseClock(const int64_t interval) :
+	m_bRun(true)
+{
+	_Cache().store(__monotonic_ns(), std::memory_order_relaxed);
+	auto period = std::chrono::microseconds((interval > 0) ? interval : 1);
+	m_iThread = std::thread([this, period]() {
+		while (m_bRun.load(std::memory_order_relaxed)) {
+			std::this_thread::sleep_for(period);
+			_Cache().store(__monotonic_ns(), std::memory_order_relaxed);
+		}
+	});
+}
+
+
+inline vsnc::utils::CoarseClock::~CoarseClock()
+{
+	m_bRun = false;
+	m_iThread.join();
+	_Cache().store(0, std::memory_order_relaxed);
+}
+
+
+#endif // !__VSNC_UTILS_CLOCK_H__
@@ -7,12 +7,18 @@
 #include <sstream>
 #include <iostream>
 #include <stdexcept>
+#include <type_traits>
 
 
 #include <cstring>
 #include <cerrno>
 
 
+#ifdef DEBUG
+#include "logger.h"
+#endif // DEBUG
+
+
 namespace vsnc
 {
 
@@ -149,12 +155,36 @@ inline std::string vsnc::utils::__fmt_err(const std::string path, const int line
 #endif // _WIN32
 	};
 
-	std::ostringstream os;
-	os << "[" << err << "]" << file_name(path.c_str()) << ":" << line << ": " << msg;
 #ifdef DEBUG
-	std::cerr << os.str() << std::endl;
+	// 롢ļкԶƲ첽־̸߳ʽڳ߳ƴַ
+	if constexpr (std::is_arithmetic<_Err>::value || std::is_enum<_Err>::value) {
+		log_error("[{}]{}:{}: {}", err, file_name(path.c_str()), line, msg);
+	}
+	else {
+		std::ostringstream code;
+		code << err;
+		log_error("[{}]{}:{}: {}", code.str(), file_name(path.c_str()), line, msg);
+	}
 #endif // DEBUG
-	return os.str();
+	std::string ret = "[";
+	if constexpr (std::is_arithmetic<_Err>::value) {
+		ret += std::to_string(err);
+	}
+	else if constexpr (std::is_enum<_Err>::value) {
+		ret += std::to_string(static_cast<typename std::underlying_type<_Err>::type>(err));
+	}
+	else {
+		std::ostringstream code;
+		code << err;
+		ret += code.str();
+	}
+	ret += "]";
+	ret += file_name(path.c_str());
+	ret += ":";
+	ret += std::to_string(line);
+	ret += ": ";
+	ret += msg;
+	return ret;
 }
 
 
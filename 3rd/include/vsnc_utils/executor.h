@@ -0,0 +1,587 @@
+﻿#ifndef __VSNC_UTILS_EXECUTOR_H__
+#define __VSNC_UTILS_EXECUTOR_H__
+
+
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <stdint.h>
+
+
+#include "logger.h"
+
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#define __VSNC_EXECUTOR_LEAN__
+#endif // !WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#ifdef __VSNC_EXECUTOR_LEAN__
+#undef WIN32_LEAN_AND_MEAN
+#undef __VSNC_EXECUTOR_LEAN__
+#endif // __VSNC_EXECUTOR_LEAN__
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif // _WIN32
+
+
+namespace vsnc
+{
+
+	namespace utils
+	{
+
+
+		/// <summary>
+		/// <para>Chase–Lev工作窃取双端队列</para>
+		/// <para>拥有者线程在底部Push/Pop（后进先出，缓存友好），其他线程在顶部Steal（先进先出）；只有队列仅剩一个元素时拥有者才与窃取者竞争CAS</para>
+		/// <para>容量固定为2的幂，队列满时Push返回false，由调用方转交其他队列；元素类型须为指针</para>
+		/// </summary>
+		/// <typeparam name="T">元素类型</typeparam>
+		template<typename T>
+		class WorkStealingDeque
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="capacity">容量，向上取整为2的幂</param>
+			explicit WorkStealingDeque(const std::size_t capacity = 4096);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			WorkStealingDeque(const WorkStealingDeque&) = delete;
+
+			/// <summary>
+			/// 在底部压入元素，仅拥有者线程调用
+			/// </summary>
+			/// <param name="value">元素</param>
+			/// <returns>队列已满返回false</returns>
+			bool        Push(T value) noexcept;
+
+			/// <summary>
+			/// 从底部取出元素，仅拥有者线程调用
+			/// </summary>
+			/// <returns>队列为空返回nullptr</returns>
+			T           Pop() noexcept;
+
+			/// <summary>
+			/// 从顶部窃取元素，任意线程可调用
+			/// </summary>
+			/// <returns>队列为空或与其他线程竞争失败返回nullptr</returns>
+			T           Steal() noexcept;
+
+			/// <summary>
+			/// 判断队列是否为空，结果仅为近似值
+			/// </summary>
+			/// <returns>为空返回true</returns>
+			bool        Empty() const noexcept;
+
+		private:
+
+			/// <summary>环形缓冲区</summary>
+			std::unique_ptr<std::atomic<T>[]>  m_pBuffer;
+			/// <summary>容量减一</summary>
+			const int64_t                      m_nMask;
+			/// <summary>顶部下标，窃取者递增</summary>
+			std::atomic<int64_t>               m_nTop;
+			/// <summary>使顶部与底部下标位于不同缓存行</summary>
+			char                               m_cPadding[64];
+			/// <summary>底部下标，仅拥有者修改</summary>
+			std::atomic<int64_t>               m_nBottom;
+		};
+
+
+		/// <summary>
+		/// 将当前线程绑定到逻辑核
+		/// </summary>
+		/// <param name="core">逻辑核序号，超出核数时取模</param>
+		/// <returns>成功返回true</returns>
+		bool __pin_thread(const std::size_t core) noexcept;
+
+
+		/// <summary>
+		/// 执行器参数
+		/// </summary>
+		struct ExecutorOptions
+		{
+			/// <summary>工作线程个数，为0时取硬件并发数</summary>
+			std::size_t Threads   = 0;
+			/// <summary>是否将第i个工作线程绑定到第i个逻辑核（超出核数时取模）</summary>
+			bool        Pin       = false;
+			/// <summary>每个工作线程本地队列的容量，满时溢出到共享队列</summary>
+			std::size_t QueueSize = 4096;
+			/// <summary>找不到任务时在挂起前重试窃取的轮数</summary>
+			std::size_t Spin      = 64;
+		};
+
+
+		/// <summary>
+		/// 执行器统计信息
+		/// </summary>
+		struct ExecutorStats
+		{
+			/// <summary>执行的任务个数</summary>
+			uint64_t Executed = 0;
+			/// <summary>从其他工作线程窃取的任务个数</summary>
+			uint64_t Stolen   = 0;
+			/// <summary>经共享队列提交的任务个数（非工作线程提交或本地队列已满）</summary>
+			uint64_t Injected = 0;
+			/// <summary>工作线程挂起的次数</summary>
+			uint64_t Parked   = 0;
+			/// <summary>抛出异常的任务个数</summary>
+			uint64_t Failed   = 0;
+		};
+
+
+		/// <summary>
+		/// <para>工作窃取线程池</para>
+		/// <para>每个工作线程拥有一个WorkStealingDeque；在工作线程中提交的任务压入本地队列，其他线程提交的任务进入加锁的共享队列</para>
+		/// <para>工作线程依次从本地队列、共享队列、随机选取的其他工作线程取任务，连续Spin轮找不到任务后在条件变量上挂起，提交任务时仅在有线程挂起时才加锁唤醒</para>
+		/// <para>析构时执行完所有已提交的任务后再停止工作线程；任务抛出的异常被捕获并记入日志与Failed计数，不会终止工作线程</para>
+		/// </summary>
+		class Executor
+		{
+		public:
+
+			/// <summary>任务</summary>
+			using task_type = std::function<void()>;
+
+		private:
+
+			/// <summary>
+			/// 排队的任务
+			/// </summary>
+			struct __task
+			{
+				task_type func;
+			};
+
+			/// <summary>
+			/// 工作线程
+			/// </summary>
+			struct __worker
+			{
+				/// <summary>本地队列</summary>
+				WorkStealingDeque<__task*> deque;
+				/// <summary>选择窃取对象的随机数状态</summary>
+				uint32_t                   seed;
+				/// <summary>执行的任务个数</summary>
+				std::atomic<uint64_t>      executed;
+				/// <summary>窃取的任务个数</summary>
+				std::atomic<uint64_t>      stolen;
+				/// <summary>线程</summary>
+				std::thread                thread;
+
+				__worker(const std::size_t capacity, const uint32_t s) : deque(capacity), seed(s), executed(0), stolen(0) {}
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数，启动工作线程
+			/// </summary>
+			/// <param name="opts">参数</param>
+			explicit Executor(const ExecutorOptions& opts = ExecutorOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			Executor(const Executor&) = delete;
+
+			/// <summary>
+			/// 析构函数，执行完已提交的任务后停止工作线程
+			/// </summary>
+			~Executor();
+
+			/// <summary>
+			/// 提交任务
+			/// </summary>
+			/// <param name="task">任务</param>
+			void          Execute(task_type task);
+
+			/// <summary>
+			/// 获取工作线程个数
+			/// </summary>
+			/// <returns>工作线程个数</returns>
+			std::size_t   Size() const noexcept { return m_iWorkers.size(); }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			ExecutorStats GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 工作线程主循环
+			/// </summary>
+			/// <param name="index">工作线程序号</param>
+			void          _Run(const std::size_t index);
+
+			/// <summary>
+			/// 为工作线程查找任务
+			/// </summary>
+			/// <param name="self">工作线程</param>
+			/// <returns>找不到返回nullptr</returns>
+			__task*       _Find(__worker& self);
+
+			/// <summary>
+			/// 从共享队列取出任务
+			/// </summary>
+			/// <returns>队列为空返回nullptr</returns>
+			__task*       _PopInjected();
+
+			/// <summary>
+			/// 判断是否还有未执行的任务
+			/// </summary>
+			/// <returns>有任务返回true</returns>
+			bool          _HasWork();
+
+			/// <summary>
+			/// 有线程挂起时唤醒一个
+			/// </summary>
+			void          _Notify();
+
+			/// <summary>
+			/// 当前线程所属的执行器与工作线程
+			/// </summary>
+			/// <returns>非工作线程时executor为nullptr</returns>
+			static std::pair<Executor*, __worker*>& _Current() noexcept;
+
+		private:
+
+			/// <summary>参数</summary>
+			const ExecutorOptions                  m_iOpts;
+			/// <summary>工作线程</summary>
+			std::vector<std::unique_ptr<__worker>> m_iWorkers;
+			/// <summary>共享队列</summary>
+			std::deque<__task*>                    m_iInjected;
+			/// <summary>共享队列中的任务个数，供无锁判断</summary>
+			std::atomic<std::size_t>               m_uInjected;
+			/// <summary>保护共享队列与挂起状态的互斥锁</summary>
+			std::mutex                             m_iMutex;
+			/// <summary>唤醒挂起的工作线程</summary>
+			std::condition_variable                m_iCond;
+			/// <summary>挂起的工作线程个数</summary>
+			std::atomic<int>                       m_nSleeping;
+			/// <summary>经共享队列提交的任务个数</summary>
+			std::atomic<uint64_t>                  m_uInjectedTotal;
+			/// <summary>挂起次数</summary>
+			std::atomic<uint64_t>                  m_uParked;
+			/// <summary>抛出异常的任务个数</summary>
+			std::atomic<uint64_t>                  m_uFailed;
+			/// <summary>运行状态</summary>
+			std::atomic<bool>                      m_bRun;
+		};
+
+
+	}
+
+}
+
+
+inline bool vsnc::utils::__pin_thread(const std::size_t core) noexcept
+{
+	auto n = (std::max)(1u, std::thread::hardware_concurrency());
+#ifdef _WIN32
+	return 0 != SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (core % n));
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core % n, &set);
+	return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+	(void)core;
+	(void)n;
+	return false;
+#endif // _WIN32
+}
+
+
+template<typename T>
+inline vsnc::utils::WorkStealingDeque<T>::WorkStealingDeque(const std::size_t capacity) :
+	m_nMask([capacity]() {
+		std::size_t n = 2;
+		while (n < capacity) {
+			n <<= 1;
+		}
+		return static_cast<int64_t>(n - 1);
+	}()),
+	m_nTop(0),
+	m_nBottom(0)
+{
+	m_pBuffer.reset(new std::atomic<T>[static_cast<std::size_t>(m_nMask + 1)]);
+	for (int64_t i = 0; i <= m_nMask; ++i) {
+		m_pBuffer[static_cast<std::size_t>(i)].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+
+template<typename T>
+inline bool vsnc::utils::WorkStealingDeque<T>::Push(T value) noexcept
+{
+	auto b = m_nBottom.load(std::memory_order_relaxed);
+	auto t = m_nTop.load(std::memory_order_acquire);
+	if (b - t > m_nMask) {
+		return false;
+	}
+	m_pBuffer[static_cast<std::size_t>(b & m_nMask)].store(value, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_nBottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+
+template<typename T>
+inline T vsnc::utils::WorkStealingDeque<T>::Pop() noexcept
+{
+	auto b = m_nBottom.load(std::memory_order_relaxed) - 1;
+	m_nBottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto t = m_nTop.load(std::memory_order_relaxed);
+	if (t > b) {
+		m_nBottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	auto value = m_pBuffer[static_cast<std::size_t>(b & m_nMask)].load(std::memory_order_relaxed);
+	if (t == b) {
+		// 仅剩一个元素，与窃取者竞争
+		if (!m_nTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			value = nullptr;
+		}
+		m_nBottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return value;
+}
+
+
+template<typename T>
+inline T vsnc::utils::WorkStealingDeque<T>::Steal() noexcept
+{
+	auto t = m_nTop.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto b = m_nBottom.load(std::memory_order_acquire);
+	if (t >= b) {
+		return nullptr;
+	}
+	auto value = m_pBuffer[static_cast<std::size_t>(t & m_nMask)].load(std::memory_order_relaxed);
+	if (!m_nTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return value;
+}
+
+
+template<typename T>
+inline bool vsnc::utils::WorkStealingDeque<T>::Empty() const noexcept
+{
+	return m_nTop.load(std::memory_order_acquire) >= m_nBottom.load(std::memory_order_acquire);
+}
+
+
+inline vsnc::utils::Executor::Executor(const ExecutorOptions& opts) :
+	m_iOpts(opts),
+	m_uInjected(0),
+	m_nSleeping(0),
+	m_uInjectedTotal(0),
+	m_uParked(0),
+	m_uFailed(0),
+	m_bRun(true)
+{
+	auto n = opts.Threads ? opts.Threads : (std::max)(1u, std::thread::hardware_concurrency());
+	for (std::size_t i = 0; i < n; ++i) {
+		m_iWorkers.emplace_back(new __worker(opts.QueueSize, static_cast<uint32_t>(i * 2654435761u + 1)));
+	}
+	for (std::size_t i = 0; i < n; ++i) {
+		m_iWorkers[i]->thread = std::thread(&Executor::_Run, this, i);
+	}
+}
+
+
+inline vsnc::utils::Executor::~Executor()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		m_bRun.store(false);
+	}
+	m_iCond.notify_all();
+	for (auto& w : m_iWorkers) {
+		if (w->thread.joinable()) {
+			w->thread.join();
+		}
+	}
+}
+
+
+inline void vsnc::utils::Executor::Execute(task_type task)
+{
+	auto t = new __task{ std::move(task) };
+	auto& cur = _Current();
+	if ((this == cur.first) && cur.second->deque.Push(t)) {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		_Notify();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		m_iInjected.push_back(t);
+		m_uInjected.fetch_add(1);
+	}
+	m_uInjectedTotal.fetch_add(1, std::memory_order_relaxed);
+	_Notify();
+}
+
+
+inline vsnc::utils::ExecutorStats vsnc::utils::Executor::GetStats() const noexcept
+{
+	ExecutorStats stats;
+	for (auto& w : m_iWorkers) {
+		stats.Executed += w->executed.load(std::memory_order_relaxed);
+		stats.Stolen += w->stolen.load(std::memory_order_relaxed);
+	}
+	stats.Injected = m_uInjectedTotal.load(std::memory_order_relaxed);
+	stats.Parked = m_uParked.load(std::memory_order_relaxed);
+	stats.Failed = m_uFailed.load(std::memory_order_relaxed);
+	return stats;
+}
+
+
+inline void vsnc::utils::Executor::_Run(const std::size_t index)
+{
+	if (m_iOpts.Pin) {
+		__pin_thread(index);
+	}
+	auto& self = *m_iWorkers[index];
+	_Current() = std::make_pair(this, &self);
+	while (true) {
+		__task* t = nullptr;
+		for (std::size_t spin = 0; (spin <= m_iOpts.Spin) && !t; ++spin) {
+			t = _Find(self);
+			if (!t && spin) {
+				std::this_thread::yield();
+			}
+		}
+		if (t) {
+			try {
+				t->func();
+			}
+			catch (const std::exception& e) {
+				m_uFailed.fetch_add(1, std::memory_order_relaxed);
+				log_error("executor worker {} task failed: {}", index, e.what());
+			}
+			catch (...) {
+				m_uFailed.fetch_add(1, std::memory_order_relaxed);
+				log_error("executor worker {} task failed: unknown exception", index);
+			}
+			delete t;
+			self.executed.store(self.executed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_iMutex);
+		m_nSleeping.fetch_add(1);
+		// 与Execute中的先入队再读m_nSleeping配对，二者至少有一方能看到对方
+		if (!_HasWork()) {
+			if (!m_bRun.load()) {
+				m_nSleeping.fetch_sub(1);
+				break;
+			}
+			m_uParked.fetch_add(1, std::memory_order_relaxed);
+			m_iCond.wait(lock);
+		}
+		m_nSleeping.fetch_sub(1);
+	}
+	_Current() = std::make_pair(nullptr, nullptr);
+}
+
+
+inline vsnc::utils::Executor::__task* vsnc::utils::Executor::_Find(__worker& self)
+{
+	if (auto t = self.deque.Pop()) {
+		return t;
+	}
+	if (auto t = _PopInjected()) {
+		return t;
+	}
+	auto n = m_iWorkers.size();
+	if (n < 2) {
+		return nullptr;
+	}
+	// xorshift32选取起点，依次尝试其他工作线程
+	self.seed ^= self.seed << 13;
+	self.seed ^= self.seed >> 17;
+	self.seed ^= self.seed << 5;
+	auto start = self.seed % n;
+	for (std::size_t i = 0; i < n; ++i) {
+		auto& victim = *m_iWorkers[(start + i) % n];
+		if (&victim == &self) {
+			continue;
+		}
+		if (auto t = victim.deque.Steal()) {
+			self.stolen.store(self.stolen.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return t;
+		}
+	}
+	return nullptr;
+}
+
+
+inline vsnc::utils::Executor::__task* vsnc::utils::Executor::_PopInjected()
+{
+	if (!m_uInjected.load(std::memory_order_acquire)) {
+		return nullptr;
+	}
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	if (m_iInjected.empty()) {
+		return nullptr;
+	}
+	auto t = m_iInjected.front();
+	m_iInjected.pop_front();
+	m_uInjected.fetch_sub(1);
+	return t;
+}
+
+
+inline bool vsnc::utils::Executor::_HasWork()
+{
+	if (m_uInjected.load()) {
+		return true;
+	}
+	for (auto& w : m_iWorkers) {
+		if (!w->deque.Empty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+inline void vsnc::utils::Executor::_Notify()
+{
+	if (m_nSleeping.load()) {
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		m_iCond.notify_one();
+	}
+}
+
+
+inline std::pair<vsnc::utils::Executor*, vsnc::utils::Executor::__worker*>& vsnc::utils::Executor::_Current() noexcept
+{
+	static thread_local std::pair<Executor*, __worker*> current(nullptr, nullptr);
+	return current;
+}
+
+
+#endif // !__VSNC_UTILS_EXECUTOR_H__
@@ -0,0 +1,730 @@
+﻿#ifndef __VSNC_UTILS_LOGGER_H__
+#define __VSNC_UTILS_LOGGER_H__
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <stdint.h>
+
+
+#include "utils.h"
+#include "clock.h"
+
+
+namespace vsnc
+{
+
+	namespace utils
+	{
+
+
+		/// <summary>
+		/// 日志级别，避开Windows头文件中的ERROR宏与调试宏DEBUG
+		/// </summary>
+		enum class log_level : int8_t
+		{
+			/// <summary>跟踪</summary>
+			TRACE,
+			/// <summary>调试</summary>
+			DBG,
+			/// <summary>信息</summary>
+			INFO,
+			/// <summary>警告</summary>
+			WARN,
+			/// <summary>错误</summary>
+			ERR,
+			/// <summary>关闭</summary>
+			OFF
+		};
+
+
+		/// <summary>
+		/// 日志参数
+		/// </summary>
+		struct LoggerOptions
+		{
+			/// <summary>低于该级别的日志直接丢弃</summary>
+			log_level   Level         = log_level::INFO;
+			/// <summary>每个线程的环形缓冲区的记录个数，向上取2的幂，只对之后首次写日志的线程生效</summary>
+			std::size_t RingSize      = 1024;
+			/// <summary>同一条日志语句每秒最多写入的条数，为0时不限制</summary>
+			uint32_t    RateLimit     = 100;
+			/// <summary>以毫秒为单位的后台线程空闲时的轮询间隔</summary>
+			int64_t     FlushInterval = 20;
+			/// <summary>日志文件路径，为空时写到标准输出</summary>
+			std::string Path;
+		};
+
+
+		/// <summary>
+		/// 日志统计信息
+		/// </summary>
+		struct LoggerStats
+		{
+			/// <summary>写出的日志条数</summary>
+			uint64_t Written    = 0;
+			/// <summary>因环形缓冲区已满而丢弃的条数</summary>
+			uint64_t Dropped    = 0;
+			/// <summary>因超过频率限制而丢弃的条数</summary>
+			uint64_t Suppressed = 0;
+		};
+
+
+		/// <summary>
+		/// 日志语句，每条日志语句对应一个静态实例，记录格式串与频率限制状态
+		/// </summary>
+		struct LogSite
+		{
+			/// <summary>级别</summary>
+			const log_level       Level;
+			/// <summary>源文件</summary>
+			const char* const     File;
+			/// <summary>行号</summary>
+			const int             Line;
+			/// <summary>格式串，以{}作为参数占位符</summary>
+			const char* const     Format;
+			/// <summary>当前限流窗口，以秒为单位</summary>
+			std::atomic<int64_t>  Window { -1 };
+			/// <summary>当前窗口内的条数</summary>
+			std::atomic<uint32_t> Count { 0 };
+			/// <summary>尚未报告的被限流条数</summary>
+			std::atomic<uint32_t> Suppressed { 0 };
+
+			LogSite(const log_level level, const char* const path, const int line, const char* const fmt) noexcept :
+				Level(level), File(path), Line(line), Format(fmt) {}
+		};
+
+
+		/// <summary>
+		/// 参数的二进制编解码，编码在写日志的线程完成，解码与格式化在后台线程完成
+		/// </summary>
+		template <typename _Ty, typename _Enable = void>
+		struct __log_codec;
+
+		/// <summary>
+		/// 算术类型按原样拷贝
+		/// </summary>
+		template <typename _Ty>
+		struct __log_codec<_Ty, typename std::enable_if<std::is_arithmetic<_Ty>::value>::type>
+		{
+			static char*       Encode(char* p, const char* const end, const _Ty& v) noexcept
+			{
+				if (!p || (p + sizeof(_Ty) > end)) {
+					return nullptr;
+				}
+				memcpy(p, &v, sizeof(_Ty));
+				return p + sizeof(_Ty);
+			}
+
+			static const char* Append(std::string& out, const char* p, const char* const end)
+			{
+				if (!p || (p + sizeof(_Ty) > end)) {
+					out += "<?>";
+					return nullptr;
+				}
+				_Ty v;
+				memcpy(&v, p, sizeof(_Ty));
+				_Put(out, v);
+				return p + sizeof(_Ty);
+			}
+
+		private:
+
+			static void _Put(std::string& out, const bool v) { out += v ? "true" : "false"; }
+			static void _Put(std::string& out, const char v) { out += v; }
+			template <typename _Num>
+			static typename std::enable_if<std::is_integral<_Num>::value>::type _Put(std::string& out, const _Num v) { out += std::to_string(v); }
+			template <typename _Num>
+			static typename std::enable_if<std::is_floating_point<_Num>::value>::type _Put(std::string& out, const _Num v) { out += __to_string_with_precision(v); }
+		};
+
+		/// <summary>
+		/// 字符串拷贝内容，过长时截断
+		/// </summary>
+		struct __log_string_codec
+		{
+			static char*       Encode(char* p, const char* const end, const char* const s, const std::size_t len) noexcept
+			{
+				if (!p || (p + 2 > end)) {
+					return nullptr;
+				}
+				auto n = (std::min)(len, (std::min)(static_cast<std::size_t>(end - p - 2), static_cast<std::size_t>(UINT16_MAX)));
+				p[0] = static_cast<char>(n >> 8);
+				p[1] = static_cast<char>(n);
+				memcpy(p + 2, s, n);
+				return p + 2 + n;
+			}
+
+			static const char* Append(std::string& out, const char* p, const char* const end)
+			{
+				if (!p || (p + 2 > end)) {
+					out += "<?>";
+					return nullptr;
+				}
+				auto n = (static_cast<std::size_t>(static_cast<uint8_t>(p[0])) << 8) | static_cast<uint8_t>(p[1]);
+				out.append(p + 2, n);
+				return p + 2 + n;
+			}
+		};
+
+		/// <summary>
+		/// 枚举按底层整数类型拷贝
+		/// </summary>
+		template <typename _Ty>
+		struct __log_codec<_Ty, typename std::enable_if<std::is_enum<_Ty>::value>::type> : __log_codec<typename std::underlying_type<_Ty>::type>
+		{
+			static char* Encode(char* p, const char* const end, const _Ty& v) noexcept
+			{
+				return __log_codec<typename std::underlying_type<_Ty>::type>::Encode(p, end, static_cast<typename std::underlying_type<_Ty>::type>(v));
+			}
+		};
+
+		template <>
+		struct __log_codec<const char*> : __log_string_codec
+		{
+			static char* Encode(char* p, const char* const end, const char* const s) noexcept
+			{
+				return __log_string_codec::Encode(p, end, s ? s : "(null)", s ? strlen(s) : 6);
+			}
+		};
+
+		template <>
+		struct __log_codec<char*> : __log_codec<const char*> {};
+
+		template <>
+		struct __log_codec<std::string> : __log_string_codec
+		{
+			static char* Encode(char* p, const char* const end, const std::string& s) noexcept
+			{
+				return __log_string_codec::Encode(p, end, s.data(), s.size());
+			}
+		};
+
+
+		/// <summary>
+		/// <para>异步日志</para>
+		/// <para>写日志的线程只把时间戳、日志语句与二进制参数拷贝进本线程的单生产者单消费者环形缓冲区，不加锁、不格式化、不做系统调用；缓冲区在线程首次写日志或调用Attach时创建，只有这一次分配并加锁</para>
+		/// <para>后台线程按时间戳合并各线程的记录，格式化后批量写出；缓冲区已满时丢弃并计数，同一日志语句每秒超过RateLimit条时丢弃并在下一秒报告条数</para>
+		/// <para>参数支持算术类型、C字符串与std::string，格式串中以{}作为占位符；一条记录的参数超过Payload_Len字节时截断</para>
+		/// </summary>
+		class Logger
+		{
+		public:
+
+			/// <summary>单条记录的长度</summary>
+			static constexpr std::size_t Slot_Len = 256;
+
+		private:
+
+			/// <summary>格式化函数类型</summary>
+			using format_func = void(*)(std::string&, const char*, const char*, const char*);
+
+			/// <summary>
+			/// 记录头
+			/// </summary>
+			struct __header
+			{
+				/// <summary>以纳秒为单位的单调时间</summary>
+				int64_t        ts;
+				/// <summary>日志语句</summary>
+				const LogSite* site;
+				/// <summary>按参数类型实例化的格式化函数</summary>
+				format_func    format;
+				/// <summary>上一秒被限流的条数</summary>
+				uint32_t       suppressed;
+				/// <summary>参数长度</summary>
+				uint32_t       len;
+			};
+
+		public:
+
+			/// <summary>单条记录可容纳的参数长度</summary>
+			static constexpr std::size_t Payload_Len = Slot_Len - sizeof(__header);
+
+		private:
+
+			/// <summary>
+			/// 单生产者单消费者环形缓冲区，由写日志的线程与后台线程共同持有
+			/// </summary>
+			struct __ring
+			{
+				explicit __ring(const std::size_t slots) : mask(slots - 1), data(new char[slots * Slot_Len]) {}
+
+				/// <summary>容量减1</summary>
+				const uint64_t          mask;
+				/// <summary>记录存储区</summary>
+				std::unique_ptr<char[]> data;
+				/// <summary>生产者位置</summary>
+				alignas(64) std::atomic<uint64_t> head { 0 };
+				/// <summary>消费者位置</summary>
+				alignas(64) std::atomic<uint64_t> tail { 0 };
+				/// <summary>因已满而丢弃的条数</summary>
+				std::atomic<uint64_t>   dropped { 0 };
+			};
+
+		public:
+
+			/// <summary>
+			/// 获取进程内唯一的实例，首次调用时以默认参数启动后台线程
+			/// </summary>
+			/// <returns>实例</returns>
+			static Logger& Instance()
+			{
+				static Logger logger;
+				return logger;
+			}
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			Logger(const Logger&) = delete;
+
+			/// <summary>
+			/// 析构函数，写出剩余的记录并停止后台线程
+			/// </summary>
+			~Logger();
+
+			/// <summary>
+			/// 修改参数，日志文件在后台线程下一次写出前切换
+			/// </summary>
+			/// <param name="opts">日志参数</param>
+			void        Configure(const LoggerOptions& opts);
+
+			/// <summary>
+			/// 判断某级别是否会被写出
+			/// </summary>
+			/// <param name="level">级别</param>
+			/// <returns>会写出返回true</returns>
+			bool        Enabled(const log_level level) const noexcept { return level >= m_eLevel.load(std::memory_order_relaxed); }
+
+			/// <summary>
+			/// <para>为调用线程预先创建并登记环形缓冲区</para>
+			/// <para>线程首次写日志时才创建缓冲区会在那一次分配内存并加锁，对时延敏感的线程应在启动时调用</para>
+			/// </summary>
+			/// <returns>成功返回true，内存不足返回false，此后该线程的日志计入丢弃</returns>
+			bool        Attach() noexcept { return nullptr != _Ring(); }
+
+			/// <summary>
+			/// 写一条日志，由log_*宏调用
+			/// </summary>
+			/// <param name="site">日志语句</param>
+			/// <param name="args">参数</param>
+			template <typename... _Args>
+			void        Write(LogSite& site, const _Args&... args) noexcept;
+
+			/// <summary>
+			/// 阻塞直到此前写入的日志全部写出
+			/// </summary>
+			void        Flush();
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			LoggerStats GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 构造函数，启动后台线程
+			/// </summary>
+			Logger();
+
+			/// <summary>
+			/// 获取本线程的环形缓冲区，首次调用时创建并登记
+			/// </summary>
+			/// <returns>环形缓冲区，创建失败返回nullptr</returns>
+			__ring*     _Ring() noexcept;
+
+			/// <summary>
+			/// 判断日志语句在当前窗口内是否还可以写入
+			/// </summary>
+			/// <param name="site">日志语句</param>
+			/// <param name="now">以纳秒为单位的当前时间</param>
+			/// <param name="suppressed">新窗口开始时返回上一窗口被限流的条数</param>
+			/// <returns>可以写入返回true</returns>
+			bool        _Admit(LogSite& site, const int64_t now, uint32_t& suppressed) noexcept;
+
+			/// <summary>
+			/// 后台线程
+			/// </summary>
+			void        _Run();
+
+			/// <summary>
+			/// 取出各线程的全部记录，按时间排序后写出
+			/// </summary>
+			/// <returns>写出的条数</returns>
+			std::size_t _Drain();
+
+			/// <summary>
+			/// 按参数类型格式化一条记录
+			/// </summary>
+			/// <param name="out">输出</param>
+			/// <param name="fmt">格式串</param>
+			/// <param name="p">参数起始位置</param>
+			/// <param name="end">参数结束位置</param>
+			template <typename... _Args>
+			static void _Format(std::string& out, const char* fmt, const char* p, const char* const end);
+
+			/// <summary>
+			/// 输出记录的时间、级别与位置
+			/// </summary>
+			/// <param name="out">输出</param>
+			/// <param name="ts">以纳秒为单位的单调时间</param>
+			/// <param name="site">日志语句</param>
+			static void _Prefix(std::string& out, const int64_t ts, const LogSite* site);
+
+		private:
+
+			/// <summary>最低级别</summary>
+			std::atomic<log_level>               m_eLevel;
+			/// <summary>每秒条数上限</summary>
+			std::atomic<uint32_t>                m_uRateLimit;
+			/// <summary>新线程的环形缓冲区大小</summary>
+			std::atomic<std::size_t>             m_uRingSize;
+			/// <summary>参数、缓冲区列表与输出文件的互斥锁</summary>
+			std::mutex                           m_iMutex;
+			/// <summary>唤醒后台线程</summary>
+			std::condition_variable              m_iCond;
+			/// <summary>日志参数</summary>
+			LoggerOptions                        m_iOpts;
+			/// <summary>是否需要切换输出文件</summary>
+			bool                                 m_bReopen;
+			/// <summary>各线程的环形缓冲区</summary>
+			std::vector<std::shared_ptr<__ring>> m_iRings;
+			/// <summary>输出文件</summary>
+			FILE*                                m_pFile;
+			/// <summary>已写出的条数</summary>
+			std::atomic<uint64_t>                m_uWritten;
+			/// <summary>丢弃的条数</summary>
+			std::atomic<uint64_t>                m_uDropped;
+			/// <summary>被限流的条数</summary>
+			std::atomic<uint64_t>                m_uSuppressed;
+			/// <summary>运行状态</summary>
+			bool                                 m_bRun;
+			/// <summary>后台线程</summary>
+			std::thread                          m_iThread;
+		};
+
+
+	}
+
+}
+
+
+/// <summary>定义以自动记录文件名与行数，参数只在级别启用时求值</summary>
+#define __vsnc_log(level, fmt, ...) \
+	do { \
+		if (vsnc::utils::Logger::Instance().Enabled(level)) { \
+			static vsnc::utils::LogSite __vsnc_site(level, __FILE__, __LINE__, fmt); \
+			vsnc::utils::Logger::Instance().Write(__vsnc_site, ##__VA_ARGS__); \
+		} \
+	} while (0)
+#define log_trace(fmt, ...) __vsnc_log(vsnc::utils::log_level::TRACE, fmt, ##__VA_ARGS__)
+#define log_debug(fmt, ...) __vsnc_log(vsnc::utils::log_level::DBG, fmt, ##__VA_ARGS__)
+#define log_info(fmt, ...)  __vsnc_log(vsnc::utils::log_level::INFO, fmt, ##__VA_ARGS__)
+#define log_warn(fmt, ...)  __vsnc_log(vsnc::utils::log_level::WARN, fmt, ##__VA_ARGS__)
+#define log_error(fmt, ...) __vsnc_log(vsnc::utils::log_level::ERR, fmt, ##__VA_ARGS__)
+
+
+inline vsnc::utils::Logger::Logger() :
+	m_eLevel(LoggerOptions().Level),
+	m_uRateLimit(LoggerOptions().RateLimit),
+	m_uRingSize(LoggerOptions().RingSize),
+	m_bReopen(false),
+	m_pFile(stdout),
+	m_uWritten(0),
+	m_uDropped(0),
+	m_uSuppressed(0),
+	m_bRun(true),
+	m_iThread(&Logger::_Run, this)
+{
+}
+
+
+inline vsnc::utils::Logger::~Logger()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		m_bRun = false;
+	}
+	m_iCond.notify_one();
+	m_iThread.join();
+	if (m_pFile && (stdout != m_pFile)) {
+		fclose(m_pFile);
+	}
+}
+
+
+inline void vsnc::utils::Logger::Configure(const LoggerOptions& opts)
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	m_bReopen = (opts.Path != m_iOpts.Path);
+	m_iOpts = opts;
+	m_eLevel = opts.Level;
+	m_uRateLimit = opts.RateLimit;
+	m_uRingSize = opts.RingSize;
+}
+
+
+template<typename... _Args>
+inline void vsnc::utils::Logger::Write(LogSite& site, const _Args&... args) noexcept
+{
+	auto now = __tsc_ns();
+	uint32_t suppressed = 0;
+	if (!_Admit(site, now, suppressed)) {
+		return;
+	}
+	auto ring_ptr = _Ring();
+	if (!ring_ptr) {
+		m_uDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	auto& ring = *ring_ptr;
+	auto head = ring.head.load(std::memory_order_relaxed);
+	if (head - ring.tail.load(std::memory_order_acquire) > ring.mask) {
+		ring.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	auto slot = ring.data.get() + (head & ring.mask) * Slot_Len;
+	auto begin = slot + sizeof(__header);
+	char* p = begin;
+	const char* const end = slot + Slot_Len;
+	int expand[] = { 0, (p = __log_codec<typename std::decay<_Args>::type>::Encode(p, end, args), 0)... };
+	(void)expand;
+	(void)end;
+	__header h;
+	h.ts = now;
+	h.site = &site;
+	h.format = &Logger::_Format<typename std::decay<_Args>::type...>;
+	h.suppressed = suppressed;
+	// 参数被截断时后台按实际长度解码，截断之后的占位符输出<?>
+	h.len = p ? static_cast<uint32_t>(p - begin) : static_cast<uint32_t>(Payload_Len);
+	memcpy(slot, &h, sizeof(h));
+	ring.head.store(head + 1, std::memory_order_release);
+}
+
+
+inline void vsnc::utils::Logger::Flush()
+{
+	m_iCond.notify_one();
+	while (true) {
+		auto pending = false;
+		{
+			std::lock_guard<std::mutex> lock(m_iMutex);
+			for (auto& r : m_iRings) {
+				pending = pending || (r->head.load(std::memory_order_acquire) != r->tail.load(std::memory_order_acquire));
+			}
+		}
+		if (!pending) {
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	if (m_pFile) {
+		fflush(m_pFile);
+	}
+}
+
+
+inline vsnc::utils::LoggerStats vsnc::utils::Logger::GetStats() const noexcept
+{
+	LoggerStats stats;
+	stats.Written = m_uWritten.load(std::memory_order_relaxed);
+	stats.Dropped = m_uDropped.load(std::memory_order_relaxed);
+	stats.Suppressed = m_uSuppressed.load(std::memory_order_relaxed);
+	return stats;
+}
+
+
+inline vsnc::utils::Logger::__ring* vsnc::utils::Logger::_Ring() noexcept
+{
+	static thread_local std::shared_ptr<__ring> ring;
+	if (!ring) {
+		std::size_t slots = 1;
+		while (slots < m_uRingSize.load(std::memory_order_relaxed)) {
+			slots <<= 1;
+		}
+		// 分配或登记失败时不保留缓冲区，下一次写日志再尝试
+		try {
+			auto created = std::make_shared<__ring>(slots);
+			std::lock_guard<std::mutex> lock(m_iMutex);
+			m_iRings.push_back(created);
+			ring = std::move(created);
+		}
+		catch (...) {
+			return nullptr;
+		}
+	}
+	return ring.get();
+}
+
+
+inline bool vsnc::utils::Logger::_Admit(LogSite& site, const int64_t now, uint32_t& suppressed) noexcept
+{
+	auto limit = m_uRateLimit.load(std::memory_order_relaxed);
+	if (!limit) {
+		return true;
+	}
+	auto sec = now / 1000000000;
+	auto win = site.Window.load(std::memory_order_relaxed);
+	if ((win != sec) && site.Window.compare_exchange_strong(win, sec, std::memory_order_relaxed)) {
+		site.Count.store(0, std::memory_order_relaxed);
+		suppressed = site.Suppressed.exchange(0, std::memory_order_relaxed);
+	}
+	if (site.Count.fetch_add(1, std::memory_order_relaxed) >= limit) {
+		site.Suppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+
+inline void vsnc::utils::Logger::_Run()
+{
+	std::unique_lock<std::mutex> lock(m_iMutex);
+	while (m_bRun) {
+		auto interval = m_iOpts.FlushInterval;
+		lock.unlock();
+		auto cnt = _Drain();
+		lock.lock();
+		if (!cnt && m_bRun) {
+			m_iCond.wait_for(lock, std::chrono::milliseconds((interval > 0) ? interval : 1));
+		}
+	}
+	lock.unlock();
+	_Drain();
+}
+
+
+inline std::size_t vsnc::utils::Logger::_Drain()
+{
+	std::vector<std::shared_ptr<__ring>> rings;
+	{
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		if (m_bReopen) {
+			m_bReopen = false;
+			auto file = m_iOpts.Path.empty() ? stdout : fopen(m_iOpts.Path.c_str(), "a");
+			if (file) {
+				if (m_pFile && (stdout != m_pFile)) {
+					fclose(m_pFile);
+				}
+				m_pFile = file;
+			}
+		}
+		// 所属线程已退出且已取空的缓冲区不再保留
+		m_iRings.erase(std::remove_if(m_iRings.begin(), m_iRings.end(), [](const std::shared_ptr<__ring>& r) {
+			return (1 == r.use_count()) && (r->head.load(std::memory_order_acquire) == r->tail.load(std::memory_order_relaxed));
+		}), m_iRings.end());
+		rings = m_iRings;
+	}
+	std::vector<std::pair<int64_t, std::string>> lines;
+	for (auto& r : rings) {
+		auto dropped = r->dropped.exchange(0, std::memory_order_relaxed);
+		if (dropped) {
+			m_uDropped.fetch_add(dropped, std::memory_order_relaxed);
+			std::string line;
+			_Prefix(line, __tsc_ns(), nullptr);
+			line += "logger: " + std::to_string(dropped) + " messages dropped, ring buffer full\n";
+			lines.emplace_back(__tsc_ns(), std::move(line));
+		}
+		auto tail = r->tail.load(std::memory_order_relaxed);
+		auto head = r->head.load(std::memory_order_acquire);
+		for (; tail != head; ++tail) {
+			auto slot = r->data.get() + (tail & r->mask) * Slot_Len;
+			__header h;
+			memcpy(&h, slot, sizeof(h));
+			std::string line;
+			_Prefix(line, h.ts, h.site);
+			h.format(line, h.site->Format, slot + sizeof(__header), slot + sizeof(__header) + h.len);
+			if (h.suppressed) {
+				m_uSuppressed.fetch_add(h.suppressed, std::memory_order_relaxed);
+				line += " (" + std::to_string(h.suppressed) + " similar messages suppressed)";
+			}
+			line += '\n';
+			lines.emplace_back(h.ts, std::move(line));
+		}
+		r->tail.store(tail, std::memory_order_release);
+	}
+	if (lines.empty()) {
+		return 0;
+	}
+	std::stable_sort(lines.begin(), lines.end(), [](const std::pair<int64_t, std::string>& lhs, const std::pair<int64_t, std::string>& rhs) {
+		return lhs.first < rhs.first;
+	});
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	if (m_pFile) {
+		for (auto& l : lines) {
+			fwrite(l.second.data(), 1, l.second.size(), m_pFile);
+		}
+		fflush(m_pFile);
+	}
+	m_uWritten.fetch_add(lines.size(), std::memory_order_relaxed);
+	return lines.size();
+}
+
+
+template<typename... _Args>
+inline void vsnc::utils::Logger::_Format(std::string& out, const char* fmt, const char* p, const char* const end)
+{
+	using append_func = const char* (*)(std::string&, const char*, const char*);
+	static const append_func appends[] = { &__log_codec<_Args>::Append..., nullptr };
+	std::size_t idx = 0;
+	for (; *fmt; ++fmt) {
+		if (('{' == fmt[0]) && ('}' == fmt[1])) {
+			if (idx < sizeof...(_Args)) {
+				p = appends[idx++](out, p, end);
+			}
+			++fmt;
+			continue;
+		}
+		out += *fmt;
+	}
+}
+
+
+inline void vsnc::utils::Logger::_Prefix(std::string& out, const int64_t ts, const LogSite* site)
+{
+	static const char* const names[] = { "TRACE", "DEBUG", "INFO ", "WARN ", "ERROR", "OFF  " };
+	auto ns = ts + __utc_offset_ns();
+	auto sec = static_cast<time_t>(ns / 1000000000);
+	tm t;
+#ifdef _WIN32
+	localtime_s(&t, &sec);
+#else
+	localtime_r(&sec, &t);
+#endif // _WIN32
+	char buf[64];
+	auto n = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &t);
+	snprintf(buf + n, sizeof(buf) - n, ".%06d ", static_cast<int>((ns / 1000) % 1000000));
+	out += buf;
+	if (!site) {
+		out += "WARN  ";
+		return;
+	}
+	out += names[static_cast<int>(site->Level)];
+	out += ' ';
+#ifdef _WIN32
+	auto name = strrchr(site->File, '\\');
+#else
+	auto name = strrchr(site->File, '/');
+#endif // _WIN32
+	out += name ? (name + 1) : site->File;
+	out += ':';
+	out += std::to_string(site->Line);
+	out += ' ';
+}
+
+
+#endif // !__VSNC_UTILS_LOGGER_H__
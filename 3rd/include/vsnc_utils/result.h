@@ -0,0 +1,324 @@
+﻿#ifndef __VSNC_UTILS_RESULT_H__
+#define __VSNC_UTILS_RESULT_H__
+
+
+#include <string>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+
+#include "error.h"
+
+
+namespace vsnc
+{
+
+	namespace utils
+	{
+
+
+		/// <summary>
+		/// <para>不抛异常的错误信息</para>
+		/// <para>只保存错误码、所处位置与静态字符串的指针，构造与拷贝都不分配内存；格式化后的信息只在调用Message时生成</para>
+		/// <para>错误码为0表示没有错误</para>
+		/// </summary>
+		class Error
+		{
+		public:
+
+			/// <summary>
+			/// 构造一个表示没有错误的对象
+			/// </summary>
+			constexpr Error() noexcept : m_nCode(0), m_nLine(0), m_pFile(""), m_pWhat("") {}
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="code">错误码，不应为0</param>
+			/// <param name="what">错误描述，须为静态字符串</param>
+			/// <param name="path">错误所处文件</param>
+			/// <param name="line">错误所处行数</param>
+			constexpr Error(const int code, const char* const what, const char* const path = "", const int line = 0) noexcept :
+				m_nCode(code), m_nLine(line), m_pFile(path), m_pWhat(what) {}
+
+			/// <summary>
+			/// 判断是否有错误
+			/// </summary>
+			explicit operator bool() const noexcept { return 0 != m_nCode; }
+
+			/// <summary>
+			/// 获取错误码
+			/// </summary>
+			/// <returns>错误码</returns>
+			int         Code() const noexcept { return m_nCode; }
+
+			/// <summary>
+			/// 获取错误描述
+			/// </summary>
+			/// <returns>错误描述</returns>
+			const char* What() const noexcept { return m_pWhat; }
+
+			/// <summary>
+			/// <para>获取格式化后的错误信息，格式与__fmt_err相同：[err]file:line: msg</para>
+			/// <para>每次调用都重新格式化，应只在需要输出时调用</para>
+			/// </summary>
+			/// <returns>格式化后的错误信息</returns>
+			std::string Message() const { return __fmt_err(m_pFile, m_nLine, m_pWhat, m_nCode); }
+
+			/// <summary>
+			/// 转为异常抛出，供仍需异常的调用方使用
+			/// </summary>
+			[[noreturn]] void Throw() const { throw std::runtime_error(Message()); }
+
+		private:
+
+			/// <summary>错误码</summary>
+			int         m_nCode;
+			/// <summary>错误所处行数</summary>
+			int         m_nLine;
+			/// <summary>错误所处文件</summary>
+			const char* m_pFile;
+			/// <summary>错误描述</summary>
+			const char* m_pWhat;
+		};
+
+
+		/// <summary>
+		/// <para>值或错误</para>
+		/// <para>成功时持有_Ty类型的值，失败时持有Error；可由值或Error隐式构造，便于直接return</para>
+		/// <para>失败时访问Value是未定义行为，调用前应先判断</para>
+		/// </summary>
+		template <typename _Ty>
+		class Result
+		{
+		public:
+
+			/// <summary>值类型</summary>
+			using value_type = _Ty;
+
+		public:
+
+			/// <summary>
+			/// 以值构造成功的结果
+			/// </summary>
+			/// <param name="value">值</param>
+			Result(const value_type& value) : m_bOk(true) { new (&m_iValue) value_type(value); }
+
+			/// <summary>
+			/// 以值构造成功的结果
+			/// </summary>
+			/// <param name="value">值</param>
+			Result(value_type&& value) : m_bOk(true) { new (&m_iValue) value_type(std::move(value)); }
+
+			/// <summary>
+			/// 以错误构造失败的结果
+			/// </summary>
+			/// <param name="err">错误</param>
+			Result(const Error& err) noexcept : m_bOk(false), m_iError(err) {}
+
+			/// <summary>
+			/// 拷贝构造函数
+			/// </summary>
+			Result(const Result& other) : m_bOk(other.m_bOk)
+			{
+				if (m_bOk) {
+					new (&m_iValue) value_type(other.m_iValue);
+				}
+				else {
+					new (&m_iError) Error(other.m_iError);
+				}
+			}
+
+			/// <summary>
+			/// 移动构造函数，值类型的移动构造不抛异常时同样不抛，使std::vector等容器扩容时移动而不是拷贝
+			/// </summary>
+			Result(Result&& other) noexcept(std::is_nothrow_move_constructible<value_type>::value) : m_bOk(other.m_bOk)
+			{
+				if (m_bOk) {
+					new (&m_iValue) value_type(std::move(other.m_iValue));
+				}
+				else {
+					new (&m_iError) Error(other.m_iError);
+				}
+			}
+
+			/// <summary>
+			/// 析构函数
+			/// </summary>
+			~Result() { _Destroy(); }
+
+			/// <summary>
+			/// 拷贝赋值，先拷贝到临时对象，拷贝抛异常时本对象不变
+			/// </summary>
+			Result& operator=(const Result& other)
+			{
+				if (this != &other) {
+					Result tmp(other);
+					*this = std::move(tmp);
+				}
+				return *this;
+			}
+
+			/// <summary>
+			/// 移动赋值，值的移动构造抛异常时本对象成为失败的结果，不会再次析构已析构的值
+			/// </summary>
+			Result& operator=(Result&& other) noexcept(std::is_nothrow_move_constructible<value_type>::value)
+			{
+				if (this != &other) {
+					_Destroy();
+					// 先切换到失败状态再构造值，构造成功后才标记为成功
+					m_bOk = false;
+					new (&m_iError) Error(other.m_bOk ? Error() : other.m_iError);
+					if (other.m_bOk) {
+						new (&m_iValue) value_type(std::move(other.m_iValue));
+						m_bOk = true;
+					}
+				}
+				return *this;
+			}
+
+			/// <summary>
+			/// 判断是否成功
+			/// </summary>
+			/// <returns>成功返回true</returns>
+			bool               Ok() const noexcept { return m_bOk; }
+
+			/// <summary>
+			/// 判断是否成功
+			/// </summary>
+			explicit operator  bool() const noexcept { return m_bOk; }
+
+			/// <summary>
+			/// 获取值
+			/// </summary>
+			/// <returns>值的引用</returns>
+			value_type&        Value() & noexcept { return m_iValue; }
+
+			/// <summary>
+			/// 获取值
+			/// </summary>
+			/// <returns>值的常引用</returns>
+			const value_type&  Value() const & noexcept { return m_iValue; }
+
+			/// <summary>
+			/// 取出值
+			/// </summary>
+			/// <returns>值的右值引用</returns>
+			value_type&&       Value() && noexcept { return std::move(m_iValue); }
+
+			/// <summary>
+			/// 成功时返回值，失败时返回给定的默认值
+			/// </summary>
+			/// <param name="def">默认值</param>
+			/// <returns>值或默认值</returns>
+			value_type         ValueOr(value_type def) const { return m_bOk ? m_iValue : def; }
+
+			/// <summary>
+			/// 获取错误，成功时返回没有错误的对象
+			/// </summary>
+			/// <returns>错误</returns>
+			Error              Err() const noexcept { return m_bOk ? Error() : m_iError; }
+
+		private:
+
+			/// <summary>
+			/// 析构持有的值
+			/// </summary>
+			void               _Destroy() noexcept
+			{
+				if (m_bOk) {
+					m_iValue.~value_type();
+				}
+			}
+
+		private:
+
+			/// <summary>是否成功</summary>
+			bool m_bOk;
+			union
+			{
+				/// <summary>值</summary>
+				value_type m_iValue;
+				/// <summary>错误</summary>
+				Error      m_iError;
+			};
+		};
+
+
+		/// <summary>
+		/// 不带值的结果
+		/// </summary>
+		template <>
+		class Result<void>
+		{
+		public:
+
+			/// <summary>值类型</summary>
+			using value_type = void;
+
+		public:
+
+			/// <summary>
+			/// 构造成功的结果
+			/// </summary>
+			Result() noexcept = default;
+
+			/// <summary>
+			/// 以错误构造结果，错误码为0时即为成功
+			/// </summary>
+			/// <param name="err">错误</param>
+			Result(const Error& err) noexcept : m_iError(err) {}
+
+			/// <summary>
+			/// 判断是否成功
+			/// </summary>
+			/// <returns>成功返回true</returns>
+			bool              Ok() const noexcept { return !m_iError; }
+
+			/// <summary>
+			/// 判断是否成功
+			/// </summary>
+			explicit operator bool() const noexcept { return !m_iError; }
+
+			/// <summary>
+			/// 获取错误
+			/// </summary>
+			/// <returns>错误</returns>
+			Error             Err() const noexcept { return m_iError; }
+
+		private:
+
+			/// <summary>错误</summary>
+			Error m_iError;
+		};
+
+
+		/// <summary>
+		/// 当条件为真时返回错误，是__throw_if的不抛异常版本
+		/// </summary>
+		/// <param name="path">判断所处文件</param>
+		/// <param name="line">判断所处行数</param>
+		/// <param name="cond">判断条件</param>
+		/// <param name="msg">错误信息，须为静态字符串</param>
+		/// <param name="err">错误码</param>
+		/// <returns>条件为真返回错误，否则返回没有错误的对象</returns>
+		inline Error __error_if(const char* const path, const int line, const bool cond, const char* const msg, const int err = -1) noexcept
+		{
+			return cond ? Error((0 != err) ? err : -1, msg, path, line) : Error();
+		}
+
+		/// <summary>定义以无需传入文件名、行数，与throw_if等一一对应</summary>
+#define make_error(code, msg)  vsnc::utils::Error               (code, msg, __FILE__, __LINE__)
+#define error_if(cond)         vsnc::utils::__error_if          (__FILE__, __LINE__, cond, #cond)
+#define error_if_zero(val)     vsnc::utils::__error_if          (__FILE__, __LINE__, (0 == (val)), #val " is zero")
+#define error_if_nullptr(ptr)  vsnc::utils::__error_if          (__FILE__, __LINE__, (nullptr == (ptr)), #ptr " is null pointer")
+#define error_if_negative(err) vsnc::utils::__error_if          (__FILE__, __LINE__, (0 > (err)), #err " is negative", static_cast<int>(err))
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_UTILS_RESULT_H__
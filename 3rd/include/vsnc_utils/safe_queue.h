@@ -8,6 +8,7 @@
 
 
 #include "error.h"
+#include "result.h"
 
 
 namespace vsnc
@@ -71,6 +72,18 @@ namespace vsnc
 			/// <returns>为空返回非零值，否则返回零值</returns>
 			bool           empty() const { return m_queue.empty(); }
 
+			/// <summary>
+			/// 不抛异常地获取队列头部数据的拷贝
+			/// </summary>
+			/// <returns>队列头部数据，队列为空时返回错误码为EAGAIN的错误</returns>
+			Result<T>      try_front();
+
+			/// <summary>
+			/// 不抛异常地取出队列头部的数据，判断与取出在同一次加锁中完成
+			/// </summary>
+			/// <returns>队列头部数据，队列为空时返回错误码为EAGAIN的错误</returns>
+			Result<T>      try_pop();
+
 		private:
 
 			/// <summary>
@@ -134,6 +147,38 @@ namespace vsnc
 			__safe_queueopt([this]() { m_queue.pop(); });
 		}
 
+		/// <summary>
+		/// 不抛异常地获取队列头部数据的拷贝
+		/// </summary>
+		/// <returns>队列头部数据，队列为空时返回错误码为EAGAIN的错误</returns>
+		template<typename T>
+		inline Result<T> SafeQueue<T>::try_front()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (m_queue.empty()) {
+				return make_error(EAGAIN, "queue is empty");
+			}
+			return m_queue.front();
+		}
+
+
+		/// <summary>
+		/// 不抛异常地取出队列头部的数据，判断与取出在同一次加锁中完成
+		/// </summary>
+		/// <returns>队列头部数据，队列为空时返回错误码为EAGAIN的错误</returns>
+		template<typename T>
+		inline Result<T> SafeQueue<T>::try_pop()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (m_queue.empty()) {
+				return make_error(EAGAIN, "queue is empty");
+			}
+			Result<T> value(std::move(m_queue.front()));
+			m_queue.pop();
+			return value;
+		}
+
+
 		/// <summary>
 		/// 在队列尾部插入数据
 		/// </summary>
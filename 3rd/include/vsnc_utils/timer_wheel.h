@@ -0,0 +1,571 @@
+﻿#ifndef __VSNC_UTILS_TIMER_WHEEL_H__
+#define __VSNC_UTILS_TIMER_WHEEL_H__
+
+
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+
+
+#include "utils.h"
+
+
+namespace vsnc
+{
+
+	namespace utils
+	{
+
+
+		/// <summary>
+		/// <para>分层时间轮</para>
+		/// <para>共Levels层，每层Slots个槽，第n层的一个槽跨越Slots^n个刻度；定时器按到期刻度与当前刻度之差放入对应层，高层的槽在低一层转完一圈时下放</para>
+		/// <para>插入与取消为O(1)，每个定时器在到期前最多被下放Levels-1次；刻度为1毫秒时可表示约49天内的到期时间，更远的到期时间先放在最高层</para>
+		/// <para>时间单位由调用方决定，通常为__steady()的毫秒；非线程安全，跨线程使用见TimerThread</para>
+		/// </summary>
+		class TimerWheel
+		{
+		public:
+
+			/// <summary>定时器标识</summary>
+			using timer_id      = uint64_t;
+			/// <summary>到期回调</summary>
+			using callback_type = std::function<void()>;
+
+			/// <summary>无效的定时器标识</summary>
+			static constexpr timer_id    Invalid_Timer = 0;
+			/// <summary>层数</summary>
+			static constexpr std::size_t Levels        = 4;
+			/// <summary>每层槽数的位数</summary>
+			static constexpr std::size_t Slot_Bits     = 8;
+			/// <summary>每层槽数</summary>
+			static constexpr std::size_t Slots         = static_cast<std::size_t>(1) << Slot_Bits;
+
+		private:
+
+			/// <summary>空链接</summary>
+			static constexpr uint32_t    Npos          = UINT32_MAX;
+
+			/// <summary>
+			/// 定时器节点，以下标链接成各槽的双向链表
+			/// </summary>
+			struct __node
+			{
+				/// <summary>到期刻度</summary>
+				uint64_t      expires = 0;
+				/// <summary>前驱</summary>
+				uint32_t      prev    = Npos;
+				/// <summary>后继</summary>
+				uint32_t      next    = Npos;
+				/// <summary>所在的槽，空闲时为Npos</summary>
+				uint32_t      slot    = Npos;
+				/// <summary>代数，节点每次回收后加1，使旧标识失效</summary>
+				uint32_t      gen     = 1;
+				/// <summary>到期回调</summary>
+				callback_type cb;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="now">当前时间</param>
+			/// <param name="resolution">一个刻度的时长</param>
+			explicit TimerWheel(const int64_t now = 0, const int64_t resolution = 1);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			TimerWheel(const TimerWheel&) = delete;
+
+			/// <summary>
+			/// 添加在指定时间到期的定时器，已过去的时间在下一次推进时到期
+			/// </summary>
+			/// <param name="deadline">到期时间</param>
+			/// <param name="cb">到期回调</param>
+			/// <returns>定时器标识</returns>
+			timer_id      ScheduleAt(const int64_t deadline, callback_type cb);
+
+			/// <summary>
+			/// 添加在最近一次推进的时间之后delay到期的定时器
+			/// </summary>
+			/// <param name="delay">延时</param>
+			/// <param name="cb">到期回调</param>
+			/// <returns>定时器标识</returns>
+			timer_id      ScheduleAfter(const int64_t delay, callback_type cb) { return ScheduleAt(m_iNow + delay, std::move(cb)); }
+
+			/// <summary>
+			/// 取消定时器
+			/// </summary>
+			/// <param name="id">定时器标识</param>
+			/// <returns>定时器尚未到期返回true，已到期、已取消或标识无效返回false</returns>
+			bool          Cancel(const timer_id id) noexcept;
+
+			/// <summary>
+			/// 推进到指定时间，取出到期定时器的回调而不执行
+			/// </summary>
+			/// <param name="now">当前时间</param>
+			/// <param name="out">按到期先后追加到期回调</param>
+			/// <returns>到期的定时器个数</returns>
+			std::size_t   Expire(const int64_t now, std::vector<callback_type>& out);
+
+			/// <summary>
+			/// <para>推进到指定时间并执行到期定时器的回调</para>
+			/// <para>回调中可以添加或取消定时器，但本次已取出的定时器不能再被取消</para>
+			/// </summary>
+			/// <param name="now">当前时间</param>
+			/// <returns>到期的定时器个数</returns>
+			std::size_t   Advance(const int64_t now);
+
+			/// <summary>
+			/// 获取距下一次需要推进的时间，可直接用作事件循环的等待时间
+			/// </summary>
+			/// <returns>相对于最近一次推进的时间，没有定时器时返回-1</returns>
+			int64_t       NextTimeout() const noexcept;
+
+			/// <summary>
+			/// 获取最近一次推进的时间
+			/// </summary>
+			/// <returns>最近一次推进的时间</returns>
+			int64_t       Now() const noexcept { return m_iNow; }
+
+			/// <summary>
+			/// 获取未到期的定时器个数
+			/// </summary>
+			/// <returns>未到期的定时器个数</returns>
+			std::size_t   Size() const noexcept { return m_uSize; }
+
+			/// <summary>
+			/// 判断是否没有未到期的定时器
+			/// </summary>
+			/// <returns>没有返回true</returns>
+			bool          Empty() const noexcept { return !m_uSize; }
+
+		private:
+
+			/// <summary>
+			/// 将时间转换为刻度
+			/// </summary>
+			/// <param name="t">时间</param>
+			/// <param name="ceil">是否向上取整</param>
+			/// <returns>刻度</returns>
+			uint64_t      _Tick(const int64_t t, const bool ceil) const noexcept;
+
+			/// <summary>
+			/// 按到期刻度将节点放入对应的槽
+			/// </summary>
+			/// <param name="idx">节点下标</param>
+			void          _Link(const uint32_t idx) noexcept;
+
+			/// <summary>
+			/// 将节点从所在的槽中移除
+			/// </summary>
+			/// <param name="idx">节点下标</param>
+			void          _Unlink(const uint32_t idx) noexcept;
+
+			/// <summary>
+			/// 回收节点
+			/// </summary>
+			/// <param name="idx">节点下标</param>
+			void          _Release(const uint32_t idx);
+
+			/// <summary>
+			/// 将指定层中当前刻度对应的槽下放到低层
+			/// </summary>
+			/// <param name="level">层号，大于0</param>
+			/// <returns>该层的槽号</returns>
+			std::size_t   _Cascade(const std::size_t level) noexcept;
+
+		private:
+
+			/// <summary>刻度0对应的时间</summary>
+			const int64_t              m_iOrigin;
+			/// <summary>一个刻度的时长</summary>
+			const int64_t              m_iResolution;
+			/// <summary>最近一次推进的时间</summary>
+			int64_t                    m_iNow;
+			/// <summary>下一个待处理的刻度</summary>
+			uint64_t                   m_uTick;
+			/// <summary>定时器节点</summary>
+			std::vector<__node>        m_iNodes;
+			/// <summary>空闲节点下标</summary>
+			std::vector<uint32_t>      m_iFree;
+			/// <summary>各层各槽的链表头</summary>
+			std::vector<uint32_t>      m_iSlots;
+			/// <summary>各层的定时器个数</summary>
+			std::size_t                m_uCount[Levels];
+			/// <summary>未到期的定时器个数</summary>
+			std::size_t                m_uSize;
+			/// <summary>Advance取出回调的缓冲区</summary>
+			std::vector<callback_type> m_iFired;
+		};
+
+
+		/// <summary>
+		/// <para>由独立线程驱动的定时器</para>
+		/// <para>以__steady()的毫秒为时间源，回调在定时器线程中执行，执行期间不持有锁，因此回调中可以添加或取消定时器</para>
+		/// </summary>
+		class TimerThread
+		{
+		public:
+
+			/// <summary>定时器标识</summary>
+			using timer_id      = TimerWheel::timer_id;
+			/// <summary>到期回调</summary>
+			using callback_type = TimerWheel::callback_type;
+
+		public:
+
+			/// <summary>
+			/// 构造函数，启动定时器线程
+			/// </summary>
+			/// <param name="resolution">以毫秒为单位的刻度</param>
+			explicit TimerThread(const int64_t resolution = 1);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			TimerThread(const TimerThread&) = delete;
+
+			/// <summary>
+			/// 析构函数，停止定时器线程，未到期的定时器不再执行
+			/// </summary>
+			~TimerThread();
+
+			/// <summary>
+			/// 添加定时器
+			/// </summary>
+			/// <param name="delay">以毫秒为单位的延时</param>
+			/// <param name="cb">到期回调</param>
+			/// <returns>定时器标识</returns>
+			timer_id    Schedule(const int64_t delay, callback_type cb);
+
+			/// <summary>
+			/// 取消定时器
+			/// </summary>
+			/// <param name="id">定时器标识</param>
+			/// <returns>定时器尚未到期返回true</returns>
+			bool        Cancel(const timer_id id);
+
+			/// <summary>
+			/// 获取未到期的定时器个数
+			/// </summary>
+			/// <returns>未到期的定时器个数</returns>
+			std::size_t Size();
+
+		private:
+
+			/// <summary>
+			/// 定时器线程
+			/// </summary>
+			void        _Run();
+
+		private:
+
+			/// <summary>时间轮</summary>
+			TimerWheel              m_iWheel;
+			/// <summary>保护时间轮的互斥锁</summary>
+			std::mutex              m_iMutex;
+			/// <summary>添加定时器或停止时唤醒定时器线程</summary>
+			std::condition_variable m_iCond;
+			/// <summary>运行状态</summary>
+			bool                    m_bRun;
+			/// <summary>定时器线程</summary>
+			std::thread             m_iThread;
+		};
+
+
+	}
+
+}
+
+
+inline vsnc::utils::TimerWheel::TimerWheel(const int64_t now, const int64_t resolution) :
+	m_iOrigin(now),
+	m_iResolution((resolution > 0) ? resolution : 1),
+	m_iNow(now),
+	m_uTick(0),
+	m_iSlots(Levels * Slots, Npos),
+	m_uSize(0)
+{
+	for (auto& c : m_uCount) {
+		c = 0;
+	}
+}
+
+
+inline vsnc::utils::TimerWheel::timer_id vsnc::utils::TimerWheel::ScheduleAt(const int64_t deadline, callback_type cb)
+{
+	uint32_t idx;
+	if (m_iFree.empty()) {
+		idx = static_cast<uint32_t>(m_iNodes.size());
+		m_iNodes.emplace_back();
+	}
+	else {
+		idx = m_iFree.back();
+		m_iFree.pop_back();
+	}
+	auto& node = m_iNodes[idx];
+	node.expires = _Tick(deadline, true);
+	node.cb = std::move(cb);
+	_Link(idx);
+	++m_uSize;
+	return (static_cast<timer_id>(node.gen) << 32) | (idx + 1);
+}
+
+
+inline bool vsnc::utils::TimerWheel::Cancel(const timer_id id) noexcept
+{
+	auto low = static_cast<uint32_t>(id);
+	if (!low || (low > m_iNodes.size())) {
+		return false;
+	}
+	auto idx = low - 1;
+	auto& node = m_iNodes[idx];
+	if ((node.gen != static_cast<uint32_t>(id >> 32)) || (Npos == node.slot)) {
+		return false;
+	}
+	_Unlink(idx);
+	_Release(idx);
+	--m_uSize;
+	return true;
+}
+
+
+inline std::size_t vsnc::utils::TimerWheel::Expire(const int64_t now, std::vector<callback_type>& out)
+{
+	if (now > m_iNow) {
+		m_iNow = now;
+	}
+	auto target = _Tick(now, false);
+	std::size_t cnt = 0;
+	while (m_uTick <= target) {
+		if (!m_uSize) {
+			m_uTick = target + 1;
+			break;
+		}
+		auto slot = static_cast<std::size_t>(m_uTick & (Slots - 1));
+		if (!slot) {
+			for (std::size_t level = 1; level < Levels; ++level) {
+				if (_Cascade(level)) {
+					break;
+				}
+			}
+		}
+		if (!m_uCount[0]) {
+			// 最低层为空时直接跳到下一次下放的刻度
+			auto boundary = (m_uTick | (Slots - 1)) + 1;
+			m_uTick = (boundary <= target) ? boundary : (target + 1);
+			continue;
+		}
+		auto& head = m_iSlots[slot];
+		while (Npos != head) {
+			auto idx = head;
+			_Unlink(idx);
+			out.push_back(std::move(m_iNodes[idx].cb));
+			_Release(idx);
+			--m_uSize;
+			++cnt;
+		}
+		++m_uTick;
+	}
+	return cnt;
+}
+
+
+inline std::size_t vsnc::utils::TimerWheel::Advance(const int64_t now)
+{
+	std::vector<callback_type> fired;
+	fired.swap(m_iFired);
+	auto cnt = Expire(now, fired);
+	for (auto& cb : fired) {
+		if (cb) {
+			cb();
+		}
+	}
+	fired.clear();
+	if (fired.capacity() > m_iFired.capacity()) {
+		fired.swap(m_iFired);
+	}
+	return cnt;
+}
+
+
+inline int64_t vsnc::utils::TimerWheel::NextTimeout() const noexcept
+{
+	if (!m_uSize) {
+		return -1;
+	}
+	auto boundary = (m_uTick | (Slots - 1)) + 1;
+	auto next = boundary;
+	if (m_uCount[0]) {
+		for (auto tick = m_uTick; tick < boundary; ++tick) {
+			if (Npos != m_iSlots[static_cast<std::size_t>(tick & (Slots - 1))]) {
+				next = tick;
+				break;
+			}
+		}
+	}
+	auto at = m_iOrigin + static_cast<int64_t>(next) * m_iResolution;
+	return (at > m_iNow) ? (at - m_iNow) : 0;
+}
+
+
+inline uint64_t vsnc::utils::TimerWheel::_Tick(const int64_t t, const bool ceil) const noexcept
+{
+	if (t <= m_iOrigin) {
+		return 0;
+	}
+	auto d = t - m_iOrigin;
+	return static_cast<uint64_t>(ceil ? ((d + m_iResolution - 1) / m_iResolution) : (d / m_iResolution));
+}
+
+
+inline void vsnc::utils::TimerWheel::_Link(const uint32_t idx) noexcept
+{
+	auto& node = m_iNodes[idx];
+	auto expires = (node.expires > m_uTick) ? node.expires : m_uTick;
+	auto delta = expires - m_uTick;
+	std::size_t level = 0;
+	while ((level + 1 < Levels) && (delta >> (Slot_Bits * (level + 1)))) {
+		++level;
+	}
+	if (delta >> (Slot_Bits * Levels)) {
+		// 超出最高层的范围，放在最高层最远的槽，下放时再按实际到期刻度重新放置
+		expires = m_uTick + (static_cast<uint64_t>(1) << (Slot_Bits * Levels)) - 1;
+	}
+	auto slot = level * Slots + static_cast<std::size_t>((expires >> (Slot_Bits * level)) & (Slots - 1));
+	node.slot = static_cast<uint32_t>(slot);
+	node.prev = Npos;
+	node.next = m_iSlots[slot];
+	if (Npos != node.next) {
+		m_iNodes[node.next].prev = idx;
+	}
+	m_iSlots[slot] = idx;
+	++m_uCount[level];
+}
+
+
+inline void vsnc::utils::TimerWheel::_Unlink(const uint32_t idx) noexcept
+{
+	auto& node = m_iNodes[idx];
+	if (Npos != node.prev) {
+		m_iNodes[node.prev].next = node.next;
+	}
+	else {
+		m_iSlots[node.slot] = node.next;
+	}
+	if (Npos != node.next) {
+		m_iNodes[node.next].prev = node.prev;
+	}
+	--m_uCount[node.slot / Slots];
+	node.prev = Npos;
+	node.next = Npos;
+	node.slot = Npos;
+}
+
+
+inline void vsnc::utils::TimerWheel::_Release(const uint32_t idx)
+{
+	auto& node = m_iNodes[idx];
+	node.cb = nullptr;
+	++node.gen;
+	m_iFree.push_back(idx);
+}
+
+
+inline std::size_t vsnc::utils::TimerWheel::_Cascade(const std::size_t level) noexcept
+{
+	auto index = static_cast<std::size_t>((m_uTick >> (Slot_Bits * level)) & (Slots - 1));
+	auto& head = m_iSlots[level * Slots + index];
+	auto idx = head;
+	head = Npos;
+	while (Npos != idx) {
+		auto next = m_iNodes[idx].next;
+		--m_uCount[level];
+		_Link(idx);
+		idx = next;
+	}
+	return index;
+}
+
+
+inline vsnc::utils::TimerThread::TimerThread(const int64_t resolution) :
+	m_iWheel(__steady(), resolution),
+	m_bRun(true),
+	m_iThread(&TimerThread::_Run, this)
+{
+}
+
+
+inline vsnc::utils::TimerThread::~TimerThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		m_bRun = false;
+	}
+	m_iCond.notify_one();
+	m_iThread.join();
+}
+
+
+inline vsnc::utils::TimerThread::timer_id vsnc::utils::TimerThread::Schedule(const int64_t delay, callback_type cb)
+{
+	timer_id id;
+	{
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		id = m_iWheel.ScheduleAt(__steady() + delay, std::move(cb));
+	}
+	m_iCond.notify_one();
+	return id;
+}
+
+
+inline bool vsnc::utils::TimerThread::Cancel(const timer_id id)
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	return m_iWheel.Cancel(id);
+}
+
+
+inline std::size_t vsnc::utils::TimerThread::Size()
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	return m_iWheel.Size();
+}
+
+
+inline void vsnc::utils::TimerThread::_Run()
+{
+	std::vector<callback_type> fired;
+	std::unique_lock<std::mutex> lock(m_iMutex);
+	while (m_bRun) {
+		m_iWheel.Expire(__steady(), fired);
+		if (!fired.empty()) {
+			lock.unlock();
+			for (auto& cb : fired) {
+				if (cb) {
+					cb();
+				}
+			}
+			fired.clear();
+			lock.lock();
+			continue;
+		}
+		auto wait = m_iWheel.NextTimeout();
+		if (wait < 0) {
+			m_iCond.wait(lock);
+		}
+		else {
+			m_iCond.wait_for(lock, std::chrono::milliseconds(wait));
+		}
+	}
+}
+
+
+#endif // !__VSNC_UTILS_TIMER_WHEEL_H__
@@ -105,6 +105,12 @@ namespace vsnc
 		/// <returns>ԺΪλUTCʱ</returns>
 		inline int64_t     __utc() noexcept { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count(); }
 
+		/// <summary>
+		/// ȡԺΪλĵʱ䣬ϵͳʱӰ죬ڼʱ붨ʱ
+		/// </summary>
+		/// <returns>ԺΪλĵʱ</returns>
+		inline int64_t     __steady() noexcept { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
 		/// <summary>
 		/// ǰ߳Ϊλʱ
 		/// </summary>
@@ -0,0 +1,154 @@
+﻿/************************************************************************
+ * @ObjectName: bench.h
+ * @Description: 性能测试的各项入口
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_BENCH_BENCH_H__
+#define __VSNC_BENCH_BENCH_H__
+
+
+#include <stdint.h>
+
+
+namespace vsnc
+{
+
+	namespace bench
+	{
+
+
+		/// <summary>
+		/// <para>测量从Connect到CONNECTED的耗时</para>
+		/// <para>在进程内启动打洞服务器，以不可达的内网端点模拟跨NAT的两端，分别测量依次尝试、并行探测与经缓存端点恢复三种方式</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench connect [rounds] [timeout]</param>
+		/// <returns>进程退出码</returns>
+		int Connect(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>测量前向纠错的编解码吞吐量与丢包恢复能力</para>
+		/// <para>解码测试中每块丢失与校验包个数相同的数据包；丢包恢复测试分别施加独立丢包与突发丢包</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench fec [size] [megabytes]</param>
+		/// <returns>进程退出码</returns>
+		int Fec(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>在虚拟时间的瓶颈链路模型上运行拥塞控制器，与netem的rate、delay、jitter、loss场景对应</para>
+		/// <para>输出各场景的带宽利用率、丢包率、瓶颈排队时延分布，以及带宽突变后估计带宽的收敛时间</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench congestion [seconds]</param>
+		/// <returns>进程退出码</returns>
+		int Congestion(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>测量4KB到1MB的消息经分片与重组的吞吐量，对比拷贝接收与交出重组缓冲区两种方式</para>
+		/// <para>并在丢包下发送大消息，检查正在重组的消息与缓冲池合计不超过内存上限</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench fragment [megabytes]</param>
+		/// <returns>进程退出码</returns>
+		int Fragment(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>对比utils::TimerWheel与以std::priority_queue实现的定时器</para>
+		/// <para>插入在时间范围内均匀分布的定时器，取消一半，再以1毫秒步长推进到全部到期，分别输出插入、取消的单次开销与到期的总耗时</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench timer [count] [milliseconds]</param>
+		/// <returns>进程退出码</returns>
+		int Timer(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>测量utils中各时钟的单次读取开销与TSC时钟的标定耗时</para>
+		/// <para>并在一段时间内周期性对照TSC时钟与单调时钟，输出跨越重新锚定的最大偏差</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench clock [reads] [seconds]</param>
+		/// <returns>进程退出码</returns>
+		int Clock(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>对比throw_if抛出并捕获异常与error_if返回Result两种错误路径在成功与失败时的单次开销</para>
+		/// <para>并测量失败后格式化错误信息的开销，以及Result在std::vector扩容时的移动</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench error [iterations]</param>
+		/// <returns>进程退出码</returns>
+		int Error(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>在1到指定线程数下对比工作窃取的utils::Executor与单个加锁队列的线程池的任务吞吐量</para>
+		/// <para>分别测量外部线程逐个注入与任务内递归展开两种负载，并输出窃取、注入与挂起次数；多核扩展性需在多核机器上运行</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench executor [tasks] [threads]</param>
+		/// <returns>进程退出码</returns>
+		int Executor(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>在一个forwarder::EventLoop上运行大量由调用者驱动的punch::Client空闲会话，注册到进程内的rendezvous::Server后以200毫秒超时循环接收，测量每个会话占用的内存、CPU与轮询次数</para>
+		/// <para>再由一个客户端依次连接随机会话并发送数据包，测量从发送到协程恢复的唤醒延迟；CPU包含进程内服务器处理心跳的开销</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench idle [sessions] [seconds]</param>
+		/// <returns>进程退出码</returns>
+		int Idle(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>以1、2、4…直到指定个数的工作线程运行forwarder::ShardedForwarder，每个会话是由所属工作线程驱动的punch::Client，经进程内的rendezvous::Server与发送端的客户端连通</para>
+		/// <para>测量全部会话从上游客户端接收并经各工作线程的下游套接字向回环转发的总包速率，输出相对单个工作线程的倍数与各工作线程分到的会话个数；发送端线程与工作线程个数相同并共享CPU，多核扩展性需在多核机器上运行</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench shard [sessions] [seconds] [workers]</param>
+		/// <returns>进程退出码</returns>
+		int Shard(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>以多路交错、带丢包与到达噪声的RTP流测量只解析、只拷贝与分流加统计加拷贝三种处理的单包开销及其在每秒百万包下占用的核比例</para>
+		/// <para>并核对注入与统计的丢包个数及抖动，最后以每秒百万包实时输入分流器，输出实际达到的包速率与线程忙碌比例</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench rtp [packets] [ssrcs] [seconds]</param>
+		/// <returns>进程退出码</returns>
+		int Rtp(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>在内存链路上逐个收发数据报，对比明文与AES-256-GCM、ChaCha20-Poly1305认证加密传输的吞吐量</para>
+		/// <para>输出Gbit/s、相对明文的耗时倍数与每个数据报增加的纳秒数</para>
+		/// <para>再检查只发送不接收的对端：首个会话无需质询即可送达，重启后的新会话经一次质询后恢复</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench secure [size] [megabytes]</param>
+		/// <returns>进程退出码，检查未通过返回1</returns>
+		int Secure(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>在两端的内存链路上完成路径MTU搜索后把路径变窄，按原长度发送一批数据报并把丢包率报告给探测层</para>
+		/// <para>检查低于阈值的丢包率不触发、丢包突发触发重新确认，且搜索收敛到变窄后的长度</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench pmtu [narrow] [count]</param>
+		/// <returns>进程退出码</returns>
+		int Pmtu(int argc, char* argv[]);
+
+		/// <summary>
+		/// <para>以实时的时延链路模拟两条独立路径：基础时延10毫秒、对数正态抖动、1%的50到200毫秒时延尖峰与0.5%的丢包，按固定包速率同时经单路径与双路径的forwarder::MultipathTransport发送</para>
+		/// <para>输出两者的p50/p99/p99.9时延与丢包率、各路径最先到达的次数与首个副本的领先时间，以及SequenceWindow::Insert的单次耗时</para>
+		/// </summary>
+		/// <param name="argc">参数个数</param>
+		/// <param name="argv">命令行参数：bench multipath [seconds] [pps]</param>
+		/// <returns>进程退出码</returns>
+		int Multipath(int argc, char* argv[]);
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_BENCH_BENCH_H__
@@ -0,0 +1,80 @@
+﻿/************************************************************************
+ * @ObjectName: clock_bench.cpp
+ * @Description: 各时钟的读取开销与TSC时钟相对单调时钟的偏差测试
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+
+
+#include <vsnc_utils/clock.h>
+#include <vsnc_utils/utils.h>
+
+
+namespace
+{
+	/// <summary>
+	/// 连续读取时钟，以读数之和防止读取被优化掉
+	/// </summary>
+	/// <returns>单次读取的纳秒数</returns>
+	template<typename Read>
+	double measure(Read read, const std::size_t count, int64_t& sink)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < count; ++i) {
+			sink += read();
+		}
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+	}
+
+	std::string ns(const double v)
+	{
+		return vsnc::utils::__to_string_with_precision(v, 1) + " ns";
+	}
+}
+
+
+int vsnc::bench::Clock(int argc, char* argv[])
+{
+	std::size_t count = (argc > 2) ? static_cast<std::size_t>(atoi(argv[2])) : 10000000;
+	int64_t duration = ((argc > 3) ? atoi(argv[3]) : 3) * 1000LL;
+	auto start = std::chrono::steady_clock::now();
+	utils::TscClock::Calibrate();
+	auto calibration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	auto& tsc = utils::TscClock::Instance();
+	std::cout << "tsc: " << (tsc.Available() ? "available" : "unavailable") << " " << utils::__to_string_with_precision(tsc.Frequency() / 1e9, 3)
+		<< " GHz, calibration " << utils::__to_string_with_precision(calibration, 1) << " ms" << std::endl;
+	int64_t sink = 0;
+	std::cout << "read cost over " << count << " reads:" << std::endl;
+	std::cout << "  __monotonic_ns: " << ns(measure(utils::__monotonic_ns, count, sink)) << std::endl;
+	std::cout << "  __tsc_ns:       " << ns(measure(utils::__tsc_ns, count, sink)) << std::endl;
+	std::cout << "  __steady:       " << ns(measure(utils::__steady, count, sink)) << std::endl;
+	std::cout << "  __utc:          " << ns(measure(utils::__utc, count, sink)) << std::endl;
+	{
+		utils::CoarseClock coarse;
+		std::cout << "  __coarse_ns:    " << ns(measure(utils::__coarse_ns, count, sink)) << std::endl;
+	}
+	// 偏差：每10毫秒同时读取两个时钟，跨越多次重新锚定
+	int64_t worst = 0;
+	auto reanchors = tsc.Reanchors();
+	auto end = utils::__steady() + duration;
+	while (utils::__steady() < end) {
+		auto before = utils::__monotonic_ns();
+		auto t = utils::__tsc_ns();
+		auto after = utils::__monotonic_ns();
+		// 单调时钟读数落在[before, after]内，超出该区间的部分才是偏差
+		auto diff = (t < before) ? (before - t) : ((t > after) ? (t - after) : 0);
+		worst = (std::max)(worst, diff);
+		utils::__sleep_milliseconds(10);
+	}
+	std::cout << "tsc vs monotonic over " << duration / 1000 << " s: max deviation " << worst << " ns, reanchors " << tsc.Reanchors() - reanchors
+		<< " (sink " << (sink & 1) << ")" << std::endl;
+	return 0;
+}
@@ -0,0 +1,205 @@
+﻿/************************************************************************
+ * @ObjectName: congestion_bench.cpp
+ * @Description: 拥塞控制在模拟瓶颈链路上的收敛与时延测试
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "link.h"
+#include "../forwarder/congestion.h"
+#include "../generator/histogram.h"
+
+
+namespace
+{
+	/// <summary>以微秒为单位的模拟步长</summary>
+	constexpr int64_t     Step        = 250;
+	/// <summary>数据包长度</summary>
+	constexpr std::size_t Packet_Size = 1200;
+	/// <summary>以微秒为单位的预热时间，不计入统计</summary>
+	constexpr int64_t     Warmup      = 5000000;
+	/// <summary>单个反馈最多携带的项数，与CongestionTransport在1504字节MTU下相同</summary>
+	constexpr std::size_t Max_Items   = 250;
+
+	/// <summary>
+	/// 模拟场景
+	/// </summary>
+	struct Scenario
+	{
+		/// <summary>名称</summary>
+		std::string                 name;
+		/// <summary>瓶颈链路参数</summary>
+		vsnc::bench::NetemOptions   link;
+		/// <summary>以微秒为单位的时刻与此后的瓶颈带宽</summary>
+		std::vector<std::pair<int64_t, uint64_t>> steps;
+	};
+
+	/// <summary>
+	/// 模拟结果
+	/// </summary>
+	struct Outcome
+	{
+		/// <summary>预热后的平均吞吐量与瓶颈带宽之比</summary>
+		double   utilization = 0;
+		/// <summary>预热后的发送丢包率</summary>
+		double   loss        = 0;
+		/// <summary>预热后以微秒为单位的瓶颈排队时延分布</summary>
+		vsnc::generator::Histogram queue;
+		/// <summary>最后一次带宽变化后估计带宽回到新带宽的0.8到1.1倍之间所用的微秒数，未回到时为-1</summary>
+		int64_t  settle      = -1;
+		/// <summary>最终的估计带宽</summary>
+		uint64_t rate        = 0;
+		/// <summary>过载降速次数</summary>
+		uint64_t overuses    = 0;
+	};
+
+	/// <summary>
+	/// 在虚拟时间中运行一个场景：发送端始终有数据，按估计带宽整形发出，接收端每隔反馈间隔回送到达时间
+	/// </summary>
+	Outcome simulate(const Scenario& sc, const int64_t duration)
+	{
+		vsnc::forwarder::CongestionOptions opts;
+		vsnc::forwarder::CongestionController cc(opts);
+		vsnc::bench::NetemLink link(sc.link);
+		std::deque<std::pair<int64_t, vsnc::forwarder::CongestionController::feedback_type>> inflight;
+		std::deque<std::pair<int64_t, std::vector<vsnc::forwarder::CongestionController::feedback_type>>> feedbacks;
+		std::vector<vsnc::forwarder::CongestionController::feedback_type> pending;
+		Outcome out;
+		double tokens = static_cast<double>(opts.Burst);
+		uint16_t seq = 0;
+		int64_t feedbackAt = 0;
+		int64_t changedAt = 0;
+		uint64_t sent = 0, dropped = 0, delivered = 0;
+		double capacity = 0;
+		std::size_t next = 0;
+		for (int64_t now = 0; now < duration; now += Step) {
+			while ((next < sc.steps.size()) && (sc.steps[next].first <= now)) {
+				link.SetRate(sc.steps[next++].second);
+				changedAt = now;
+				out.settle = -1;
+			}
+			auto measured = (now >= Warmup);
+			if (measured) {
+				capacity += static_cast<double>(link.Rate()) * Step / 1e6;
+			}
+			// 发送端：令牌桶按当前估计带宽整形
+			tokens = (std::min)(tokens + static_cast<double>(cc.Rate()) * Step / 1e6, static_cast<double>(opts.Burst));
+			while (tokens >= Packet_Size) {
+				tokens -= Packet_Size;
+				cc.OnSent(seq, Packet_Size, now);
+				int64_t arrival = 0, queue = 0;
+				auto ok = link.Send(Packet_Size, now, arrival, queue);
+				if (measured) {
+					++sent;
+					dropped += ok ? 0 : 1;
+					out.queue.Record(queue);
+				}
+				if (ok) {
+					inflight.emplace_back(arrival, vsnc::forwarder::CongestionController::feedback_type(seq, 0));
+				}
+				++seq;
+			}
+			// 接收端：记录到达时间，按间隔或项数上限回送反馈
+			while (!inflight.empty() && (inflight.front().first <= now)) {
+				auto item = inflight.front().second;
+				item.second = static_cast<uint32_t>(inflight.front().first);
+				pending.push_back(item);
+				delivered += measured ? Packet_Size : 0;
+				inflight.pop_front();
+			}
+			if (!pending.empty() && ((now - feedbackAt >= opts.FeedbackInterval * 1000) || (pending.size() >= Max_Items))) {
+				feedbacks.emplace_back(now + sc.link.Delay, std::move(pending));
+				pending.clear();
+				feedbackAt = now;
+			}
+			while (!feedbacks.empty() && (feedbacks.front().first <= now)) {
+				cc.OnFeedback(feedbacks.front().second, now);
+				feedbacks.pop_front();
+			}
+			cc.OnTick(now);
+			auto rate = static_cast<double>(cc.Rate());
+			auto target = static_cast<double>(link.Rate());
+			if ((out.settle < 0) && (now > changedAt) && (rate >= 0.8 * target) && (rate <= 1.1 * target)) {
+				out.settle = now - changedAt;
+			}
+		}
+		out.utilization = capacity ? delivered / capacity : 0;
+		out.loss = sent ? static_cast<double>(dropped) / sent : 0;
+		out.rate = cc.Rate();
+		out.overuses = cc.GetStats().Overuses;
+		return out;
+	}
+
+	std::vector<Scenario> scenarios()
+	{
+		std::vector<Scenario> ret;
+		Scenario sc;
+		sc.name = "2Mbps 40ms";
+		ret.push_back(sc);
+		sc.name = "2Mbps 40ms 1% loss";
+		sc.link.Loss = 0.01;
+		ret.push_back(sc);
+		sc.name = "2Mbps 40ms 5% burst loss";
+		sc.link.Loss = 0.05;
+		sc.link.Burst = 4;
+		ret.push_back(sc);
+		sc = Scenario();
+		sc.name = "2Mbps 40ms 10ms jitter";
+		sc.link.Jitter = 10000;
+		ret.push_back(sc);
+		sc = Scenario();
+		sc.name = "8Mbps 100ms";
+		sc.link.Rate = 1000000;
+		sc.link.Delay = 50000;
+		ret.push_back(sc);
+		sc = Scenario();
+		sc.name = "4->1Mbps at 20s";
+		sc.link.Rate = 500000;
+		sc.steps.emplace_back(20000000, 125000);
+		ret.push_back(sc);
+		sc.name = "1->4Mbps at 20s";
+		sc.link.Rate = 125000;
+		sc.steps.clear();
+		sc.steps.emplace_back(20000000, 500000);
+		ret.push_back(sc);
+		return ret;
+	}
+
+	std::string percent(const double v)
+	{
+		return vsnc::utils::__to_string_with_precision(v * 100, 1) + "%";
+	}
+}
+
+
+int vsnc::bench::Congestion(int argc, char* argv[])
+{
+	int64_t duration = ((argc > 2) ? atoi(argv[2]) : 60) * 1000000LL;
+	std::cout << "virtual time " << duration / 1000000 << "s, " << Packet_Size << "-byte packets, first " << Warmup / 1000000
+		<< "s excluded" << std::endl;
+	for (auto& sc : scenarios()) {
+		auto out = simulate(sc, duration);
+		std::cout << sc.name << ": utilization " << percent(out.utilization)
+			<< " loss " << percent(out.loss)
+			<< " queue p50/p95/max " << out.queue.Percentile(0.5) / 1000 << "/" << out.queue.Percentile(0.95) / 1000 << "/" << out.queue.Max() / 1000 << "ms"
+			<< " rate " << out.rate * 8 / 1000 << "kbps"
+			<< " overuses " << out.overuses;
+		if (!sc.steps.empty()) {
+			std::cout << " settle " << ((out.settle < 0) ? std::string("never") : (std::to_string(out.settle / 1000) + "ms"));
+		}
+		std::cout << std::endl;
+	}
+	return 0;
+}
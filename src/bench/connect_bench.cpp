@@ -0,0 +1,132 @@
+﻿/************************************************************************
+ * @ObjectName: connect_bench.cpp
+ * @Description: 从Connect到CONNECTED的耗时测试
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "../generator/histogram.h"
+#include "../punch/client.h"
+#include "../rendezvous/server.h"
+
+
+namespace
+{
+	/// <summary>以毫秒为单位的等待注册的最长时间</summary>
+	constexpr int64_t  Register_Timeout = 3000;
+	/// <summary>序列号基数，避开实际部署中的序列号</summary>
+	constexpr uint64_t Seqno_Base       = 0x7100000000000000ULL;
+
+	using client_ptr = std::unique_ptr<vsnc::punch::Client>;
+
+	/// <summary>
+	/// 等待客户端进入指定状态
+	/// </summary>
+	/// <returns>从调用到进入该状态的毫秒数，超时返回-1</returns>
+	int64_t waitState(const vsnc::punch::Client& client, const vsnc::p2p::vsnc_p2p_state state, const int64_t timeout)
+	{
+		auto start = vsnc::utils::__steady();
+		while (client.GetState() != state) {
+			if (vsnc::utils::__steady() - start > timeout) {
+				return -1;
+			}
+			vsnc::utils::__sleep_milliseconds(1);
+		}
+		return vsnc::utils::__steady() - start;
+	}
+
+	client_ptr makeClient(const uint64_t seqno, const uint16_t port, const vsnc::punch::ClientOptions& opts)
+	{
+		client_ptr client(new vsnc::punch::Client(seqno, "127.0.0.1", port, 0, opts));
+		if (waitState(*client, vsnc::p2p::vsnc_p2p_state::FREE, Register_Timeout) < 0) {
+			return nullptr;
+		}
+		return client;
+	}
+
+	void report(const char* name, const vsnc::generator::Histogram& hist, const int rounds)
+	{
+		std::cout << name << ": connected " << hist.Count() << "/" << rounds
+			<< " p50/p90/max: " << hist.Percentile(0.5) << "/" << hist.Percentile(0.9) << "/" << hist.Max() << "ms" << std::endl;
+	}
+}
+
+
+int vsnc::bench::Connect(int argc, char* argv[])
+{
+	auto rounds = (argc > 2) ? atoi(argv[2]) : 10;
+	int64_t timeout = (argc > 3) ? atoi(argv[3]) : 1000;
+	rendezvous::ServerOptions srv_opts;
+	srv_opts.Port = 0;
+	srv_opts.Workers = 1;
+	srv_opts.Capacity = 1024;
+	rendezvous::Server server(srv_opts);
+	if (!server.Start()) {
+		std::cout << "Server::Start() failed." << std::endl;
+		return 1;
+	}
+	// 以不可路由的文档地址作为上报的内网端点，内网阶段必然失败，公网端点即回环上的真实端口
+	punch::ClientOptions opts;
+	opts.Timeout = timeout;
+	inet_pton(AF_INET, "192.0.2.1", &opts.Intranet.Ip);
+	opts.Intranet.Port = 9;
+	generator::Histogram serial, parallel, resumed;
+	// 经缓存端点先于服务器事件连通的次数，回环上服务器往返极短，二者先后接近随机
+	int early = 0;
+	uint64_t seqno = Seqno_Base;
+	for (auto r = 0; r < rounds; ++r) {
+		for (auto mode = 0; mode < 2; ++mode) {
+			opts.Parallel = (1 == mode);
+			auto a = makeClient(++seqno, server.Port(), opts);
+			auto b = makeClient(++seqno, server.Port(), opts);
+			if (!a || !b) {
+				std::cout << "registration timed out" << std::endl;
+				continue;
+			}
+			a->Connect(seqno);
+			auto elapsed = waitState(*a, p2p::vsnc_p2p_state::CONNECTED, 4 * timeout);
+			if (elapsed < 0) {
+				continue;
+			}
+			(opts.Parallel ? parallel : serial).Record(elapsed);
+			if (!opts.Parallel) {
+				continue;
+			}
+			// 以相同的序列号重建发起方并写入缓存的对端端点，对端仍保留着发起方的缓存
+			auto ep = a->PeerEndpoint();
+			auto self = seqno - 1;
+			a.reset();
+			waitState(*b, p2p::vsnc_p2p_state::FREE, 2 * timeout);
+			a = makeClient(self, server.Port(), opts);
+			if (!a) {
+				continue;
+			}
+			a->Cache(seqno, ep);
+			a->Connect(seqno);
+			elapsed = waitState(*a, p2p::vsnc_p2p_state::CONNECTED, 4 * timeout);
+			if (elapsed >= 0) {
+				resumed.Record(elapsed);
+				early += a->Resumed() ? 1 : 0;
+			}
+		}
+	}
+	server.Stop();
+	std::cout << "phase timeout: " << timeout << "ms, intranet endpoint unreachable" << std::endl;
+	report("serial  ", serial, rounds);
+	report("parallel", parallel, rounds);
+	report("resumed ", resumed, rounds);
+	std::cout << "resumed before EVENT: " << early << std::endl;
+	return 0;
+}
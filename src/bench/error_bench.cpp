@@ -0,0 +1,111 @@
+﻿/************************************************************************
+ * @ObjectName: error_bench.cpp
+ * @Description: 异常与Result两种错误路径的单次开销对比
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+
+#include <vsnc_utils/error.h>
+#include <vsnc_utils/result.h>
+#include <vsnc_utils/utils.h>
+
+
+namespace
+{
+	/// <summary>使判断条件在编译期未知</summary>
+	volatile int g_iLimit = 0;
+
+	/// <summary>
+	/// 以异常报告失败，与仓库中throw_if的用法相同
+	/// </summary>
+	int checkThrow(const int v)
+	{
+		throw_if(v >= g_iLimit);
+		return v;
+	}
+
+	/// <summary>
+	/// 以Result报告失败
+	/// </summary>
+	vsnc::utils::Result<int> checkResult(const int v) noexcept
+	{
+		auto err = error_if(v >= g_iLimit);
+		if (err) {
+			return err;
+		}
+		return v;
+	}
+
+	double nanoseconds(const std::chrono::steady_clock::time_point start, const std::size_t ops)
+	{
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+	}
+
+	std::string ns(const double v)
+	{
+		return vsnc::utils::__to_string_with_precision(v, 1) + " ns";
+	}
+}
+
+
+int vsnc::bench::Error(int argc, char* argv[])
+{
+	std::size_t count = (argc > 2) ? static_cast<std::size_t>(atoi(argv[2])) : 1000000;
+	static_assert(std::is_nothrow_move_constructible<utils::Result<int>>::value, "Result<int> must move without throwing");
+	static_assert(std::is_nothrow_move_constructible<utils::Result<std::string>>::value, "Result<std::string> must move without throwing");
+	for (auto fail : { false, true }) {
+		g_iLimit = fail ? 0 : INT32_MAX;
+		std::size_t failures = 0;
+		int64_t sum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < count; ++i) {
+			try {
+				sum += checkThrow(static_cast<int>(i & 0xffff));
+			}
+			catch (const std::runtime_error&) {
+				++failures;
+			}
+		}
+		auto thrown = nanoseconds(start, count);
+		start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < count; ++i) {
+			auto r = checkResult(static_cast<int>(i & 0xffff));
+			if (r) {
+				sum += r.Value();
+			}
+			else {
+				++failures;
+			}
+		}
+		auto returned = nanoseconds(start, count);
+		std::cout << (fail ? "failure" : "success") << " path: exception " << ns(thrown) << " result " << ns(returned);
+		if (fail) {
+			// 调用方需要输出时才格式化错误信息
+			start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < count; ++i) {
+				auto r = checkResult(static_cast<int>(i & 0xffff));
+				sum += static_cast<int64_t>(r.Err().Message().size());
+			}
+			std::cout << " result+Message() " << ns(nanoseconds(start, count));
+		}
+		std::cout << " (failures " << failures << ", sum " << (sum & 1) << ")" << std::endl;
+	}
+	// 移动不抛异常时，std::vector扩容移动元素而不是拷贝
+	std::vector<utils::Result<std::string>> results;
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < count; ++i) {
+		results.emplace_back(std::string(64, 'x'));
+	}
+	std::cout << "vector<Result<string>> push with growth: " << ns(nanoseconds(start, count)) << std::endl;
+	return 0;
+}
@@ -0,0 +1,204 @@
+﻿/************************************************************************
+ * @ObjectName: executor_bench.cpp
+ * @Description: 工作窃取线程池与单队列线程池在不同线程数下的任务吞吐量对比
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+
+
+#include <vsnc_utils/executor.h>
+#include <vsnc_utils/utils.h>
+
+
+namespace
+{
+	/// <summary>每个任务的计算量，约数十纳秒，使调度开销占主导</summary>
+	constexpr int Work = 64;
+
+	/// <summary>
+	/// 对照组：所有线程共用一个加锁队列的线程池
+	/// </summary>
+	class LockedPool
+	{
+	public:
+
+		explicit LockedPool(const std::size_t threads) : m_bRun(true)
+		{
+			for (std::size_t i = 0; i < threads; ++i) {
+				m_threads.emplace_back([this]() { _Run(); });
+			}
+		}
+
+		~LockedPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_bRun = false;
+			}
+			m_cv.notify_all();
+			for (auto& t : m_threads) {
+				t.join();
+			}
+		}
+
+		void Execute(std::function<void()> task)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_tasks.push_back(std::move(task));
+			}
+			m_cv.notify_one();
+		}
+
+	private:
+
+		void _Run()
+		{
+			for (;;) {
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_cv.wait(lock, [this]() { return !m_bRun || !m_tasks.empty(); });
+					if (m_tasks.empty()) {
+						return;
+					}
+					task = std::move(m_tasks.front());
+					m_tasks.pop_front();
+				}
+				task();
+			}
+		}
+
+		std::mutex                        m_mutex;
+		std::condition_variable           m_cv;
+		std::deque<std::function<void()>> m_tasks;
+		std::vector<std::thread>          m_threads;
+		bool                              m_bRun;
+	};
+
+	/// <summary>防止计算被优化掉</summary>
+	std::atomic<uint64_t> g_uSink(0);
+
+	void work(const uint64_t seed)
+	{
+		auto v = seed;
+		for (int i = 0; i < Work; ++i) {
+			v = v * 6364136223846793005ULL + 1442695040888963407ULL;
+		}
+		if (0 == v) {
+			g_uSink.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void wait(const std::atomic<uint64_t>& done, const uint64_t count)
+	{
+		while (done.load(std::memory_order_acquire) < count) {
+			std::this_thread::yield();
+		}
+	}
+
+	/// <summary>
+	/// 外部注入：调用线程逐个提交count个任务并等待全部完成
+	/// </summary>
+	/// <returns>每秒完成的任务数</returns>
+	template <typename Pool>
+	double inject(Pool& pool, const uint64_t count)
+	{
+		std::atomic<uint64_t> done(0);
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < count; ++i) {
+			pool.Execute([&done, i]() {
+				work(i);
+				done.fetch_add(1, std::memory_order_release);
+			});
+		}
+		wait(done, count);
+		return count / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/// <summary>
+	/// 任务内展开：每个任务再提交两个子任务直到指定深度，Executor中子任务进入本线程的双端队列并由空闲线程窃取
+	/// </summary>
+	template <typename Pool>
+	void spawn(Pool& pool, std::atomic<uint64_t>& done, const int depth)
+	{
+		work(static_cast<uint64_t>(depth));
+		if (depth > 0) {
+			pool.Execute([&pool, &done, depth]() { spawn(pool, done, depth - 1); });
+			pool.Execute([&pool, &done, depth]() { spawn(pool, done, depth - 1); });
+		}
+		done.fetch_add(1, std::memory_order_release);
+	}
+
+	/// <returns>每秒完成的任务数</returns>
+	template <typename Pool>
+	double fanout(Pool& pool, const int depth)
+	{
+		std::atomic<uint64_t> done(0);
+		auto count = (2ULL << depth) - 1;
+		auto start = std::chrono::steady_clock::now();
+		pool.Execute([&pool, &done, depth]() { spawn(pool, done, depth); });
+		wait(done, count);
+		return count / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string mtps(const double v)
+	{
+		return vsnc::utils::__to_string_with_precision(v / 1e6, 2) + "M/s";
+	}
+}
+
+
+int vsnc::bench::Executor(int argc, char* argv[])
+{
+	uint64_t count = (argc > 2) ? static_cast<uint64_t>(atoll(argv[2])) : 1000000;
+	std::size_t max = (argc > 3) ? static_cast<std::size_t>(atoi(argv[3])) : (std::max)(std::thread::hardware_concurrency(), 1u);
+	// 展开树的任务数取不超过count的2^(depth+1)-1
+	auto depth = 0;
+	while ((4ULL << depth) - 1 <= count) {
+		++depth;
+	}
+	std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", " << count << " injected tasks, "
+		<< (2ULL << depth) - 1 << " fan-out tasks, " << Work << " rounds of work each" << std::endl;
+	std::vector<std::size_t> threads;
+	for (std::size_t n = 1; n < max; n *= 2) {
+		threads.push_back(n);
+	}
+	threads.push_back(max);
+	for (auto n : threads) {
+		utils::ExecutorOptions opts;
+		opts.Threads = n;
+		double stealInject = 0, stealFanout = 0;
+		utils::ExecutorStats stats;
+		{
+			utils::Executor pool(opts);
+			stealInject = inject(pool, count);
+			stealFanout = fanout(pool, depth);
+			stats = pool.GetStats();
+		}
+		double lockInject = 0, lockFanout = 0;
+		{
+			LockedPool pool(n);
+			lockInject = inject(pool, count);
+			lockFanout = fanout(pool, depth);
+		}
+		std::cout << n << " threads: executor inject " << mtps(stealInject) << " fan-out " << mtps(stealFanout)
+			<< " | locked queue inject " << mtps(lockInject) << " fan-out " << mtps(lockFanout)
+			<< " | stolen " << stats.Stolen << " injected " << stats.Injected << " parked " << stats.Parked << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,171 @@
+﻿/************************************************************************
+ * @ObjectName: fec_bench.cpp
+ * @Description: 前向纠错的编解码吞吐量与丢包恢复测试
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "link.h"
+#include "../forwarder/fec.h"
+
+
+namespace
+{
+	/// <summary>丢包恢复测试中每种丢包条件发送的数据包个数</summary>
+	constexpr std::size_t Loss_Packets = 100000;
+
+	struct Code
+	{
+		const char*                 name;
+		vsnc::forwarder::FecOptions opts;
+	};
+
+	std::vector<Code> codes()
+	{
+		std::vector<Code> ret(3);
+		ret[0].name = "xor(8,1)";
+		ret[0].opts.Mode = vsnc::forwarder::fec_mode::XOR;
+		ret[0].opts.Data = 8;
+		ret[0].opts.Parity = 1;
+		ret[1].name = "rs(8,2) ";
+		ret[1].opts.Data = 8;
+		ret[1].opts.Parity = 2;
+		ret[2].name = "rs(16,4)";
+		ret[2].opts.Data = 16;
+		ret[2].opts.Parity = 4;
+		return ret;
+	}
+
+	double seconds(const std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string gbps(const double bytes, const double sec)
+	{
+		return vsnc::utils::__to_string_with_precision(bytes / sec / 1e9, 3) + " GB/s";
+	}
+
+	/// <summary>
+	/// 取出链路中的全部数据报，并丢弃每块的前drop个数据包，使接收端每块都必须解码
+	/// </summary>
+	void strip(vsnc::bench::MemoryLink& from, vsnc::bench::MemoryLink& to, const uint8_t drop)
+	{
+		std::vector<char> buf(2048);
+		vsnc::utils::BasicMemory<char> mem(buf.data(), buf.size());
+		int64_t ts = 0;
+		ssize_t len = 0;
+		while ((len = from.Receive(mem, ts, 0)) > 0) {
+			auto data = (0 == buf[6]);
+			if (data && (static_cast<uint8_t>(buf[2]) < drop)) {
+				continue;
+			}
+			vsnc::utils::BasicMemory<char> out(buf.data(), static_cast<std::size_t>(len));
+			to.Send(out, ts);
+		}
+	}
+
+	/// <summary>
+	/// 取走接收端可交付的全部数据包
+	/// </summary>
+	/// <returns>交付的字节数</returns>
+	uint64_t drain(vsnc::forwarder::FecTransport& rx, uint64_t& packets)
+	{
+		std::vector<char> buf(2048);
+		vsnc::utils::BasicMemory<char> mem(buf.data(), buf.size());
+		int64_t ts = 0;
+		ssize_t len = 0;
+		uint64_t bytes = 0;
+		while ((len = rx.Receive(mem, ts, 0)) > 0) {
+			bytes += static_cast<uint64_t>(len);
+			++packets;
+		}
+		return bytes;
+	}
+}
+
+
+int vsnc::bench::Fec(int argc, char* argv[])
+{
+	std::size_t size = (argc > 2) ? static_cast<std::size_t>(atoi(argv[2])) : 1200;
+	std::size_t total = ((argc > 3) ? static_cast<std::size_t>(atoi(argv[3])) : 256) << 20;
+	auto count = total / size;
+	std::vector<char> payload(size);
+	for (std::size_t i = 0; i < size; ++i) {
+		payload[i] = static_cast<char>(i * 131 + 7);
+	}
+	utils::BasicMemory<char> mem(payload.data(), payload.size());
+	std::cout << "payload: " << size << " bytes x " << count << std::endl;
+	for (auto& code : codes()) {
+		// 编码：数据包的封装与每块校验包的计算，下层链路不排队
+		{
+			MemoryLink sink(LossModel(1));
+			forwarder::FecTransport tx(sink, code.opts);
+			auto start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < count; ++i) {
+				tx.Send(mem, static_cast<int64_t>(i));
+			}
+			auto sec = seconds(start);
+			std::cout << code.name << " encode: " << gbps(static_cast<double>(size) * count, sec);
+		}
+		// 解码：每块丢失与校验包个数相同的数据包，接收端每块都要求解
+		{
+			MemoryLink wire, lossy;
+			forwarder::FecTransport tx(wire, code.opts);
+			for (std::size_t i = 0; i < count; ++i) {
+				tx.Send(mem, static_cast<int64_t>(i));
+			}
+			tx.Flush();
+			strip(wire, lossy, code.opts.Parity);
+			forwarder::FecTransport rx(lossy, code.opts);
+			uint64_t packets = 0;
+			auto start = std::chrono::steady_clock::now();
+			auto bytes = drain(rx, packets);
+			auto sec = seconds(start);
+			std::cout << " decode (" << static_cast<int>(code.opts.Parity) << "/" << static_cast<int>(code.opts.Data) << " lost per block): "
+				<< gbps(static_cast<double>(bytes), sec) << " delivered " << packets << "/" << count << std::endl;
+		}
+	}
+	// 丢包恢复：独立丢包与平均连续4包的突发丢包下的残余丢包率，以及接收端统计的Lost与实际未交付个数的对照
+	std::cout << "residual loss over " << Loss_Packets << " packets, lost counted/actual:" << std::endl;
+	const double rates[] = { 0.01, 0.02, 0.05, 0.1, 0.2 };
+	for (auto& code : codes()) {
+		for (auto rate : rates) {
+			std::cout << code.name << " loss " << utils::__to_string_with_precision(rate * 100, 0) << "%";
+			for (auto burst : { 1.0, 4.0 }) {
+				MemoryLink link(LossModel(rate, burst, 7));
+				forwarder::FecTransport tx(link, code.opts);
+				forwarder::FecTransport rx(link, code.opts);
+				uint64_t packets = 0;
+				for (std::size_t i = 0; i < Loss_Packets; ++i) {
+					tx.Send(mem, static_cast<int64_t>(i));
+					drain(rx, packets);
+					// 每100个数据包结束一次块，覆盖Flush提前结束的不完整块
+					if (0 == (i + 1) % 100) {
+						tx.Flush();
+						drain(rx, packets);
+					}
+				}
+				tx.Flush();
+				drain(rx, packets);
+				auto residual = 1.0 - static_cast<double>(packets) / Loss_Packets;
+				std::cout << ((1.0 == burst) ? "  uniform: " : "  burst=4: ") << utils::__to_string_with_precision(residual * 100, 3) << "% "
+					<< rx.GetStats().Lost << "/" << (Loss_Packets - packets);
+			}
+			std::cout << std::endl;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+﻿/************************************************************************
+ * @ObjectName: fragment_bench.cpp
+ * @Description: 分片与重组在4KB到1MB消息上的吞吐量测试
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "link.h"
+#include "../forwarder/fragment.h"
+
+
+namespace
+{
+	/// <summary>测试的消息长度</summary>
+	constexpr std::size_t Sizes[] = { 4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024 };
+
+	double seconds(const std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string gbps(const double bytes, const double sec)
+	{
+		return vsnc::utils::__to_string_with_precision(bytes / sec / 1e9, 3) + " GB/s";
+	}
+
+	/// <summary>
+	/// 逐个发送并接收消息
+	/// </summary>
+	/// <param name="copy">为true时以Receive拷贝到调用方的缓冲区，否则以ReceiveMessage交出重组缓冲区并归还</param>
+	/// <returns>秒数</returns>
+	double run(const vsnc::utils::BasicMemory<char>& msg, const std::size_t count, const bool copy, std::size_t& received)
+	{
+		vsnc::bench::MemoryLink link;
+		vsnc::forwarder::FragmentTransport tx(link);
+		vsnc::forwarder::FragmentTransport rx(link);
+		std::vector<char> out(msg.Length());
+		vsnc::utils::BasicMemory<char> mem(out.data(), out.size());
+		vsnc::forwarder::FragmentTransport::buffer_type buf;
+		int64_t ts = 0;
+		received = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < count; ++i) {
+			tx.Send(msg, static_cast<int64_t>(i));
+			if (copy) {
+				received += (rx.Receive(mem, ts, 0) > 0) ? 1 : 0;
+			}
+			else if (rx.ReceiveMessage(buf, ts, 0) > 0) {
+				++received;
+				rx.Recycle(std::move(buf));
+			}
+		}
+		return seconds(start);
+	}
+}
+
+
+int vsnc::bench::Fragment(int argc, char* argv[])
+{
+	std::size_t total = ((argc > 2) ? static_cast<std::size_t>(atoi(argv[2])) : 256) << 20;
+	for (auto size : Sizes) {
+		std::vector<char> payload(size);
+		for (std::size_t i = 0; i < size; ++i) {
+			payload[i] = static_cast<char>(i * 131 + 7);
+		}
+		utils::BasicMemory<char> msg(payload.data(), payload.size());
+		auto count = (std::max)(total / size, static_cast<std::size_t>(1));
+		std::size_t received = 0;
+		std::cout << size / 1024 << "KB x " << count;
+		for (auto copy : { true, false }) {
+			auto sec = run(msg, count, copy, received);
+			std::cout << (copy ? "  copy: " : "  zero-copy: ") << gbps(static_cast<double>(size) * received, sec)
+				<< " " << static_cast<uint64_t>(received / sec) << " msg/s";
+		}
+		std::cout << std::endl;
+	}
+	// 内存上限：0.1%丢包下逐个发送1MB消息，约一半不能收齐，未收齐的消息堆积到上限后被逐出，检查正在重组与缓冲池合计的峰值
+	forwarder::FragmentOptions opts;
+	opts.MaxBytes = 8 * 1024 * 1024;
+	opts.PoolPerClass = 16;
+	MemoryLink link(LossModel(0.001, 1, 7));
+	forwarder::FragmentTransport tx(link, opts);
+	forwarder::FragmentTransport rx(link, opts);
+	std::vector<char> payload(1024 * 1024);
+	utils::BasicMemory<char> msg(payload.data(), payload.size());
+	forwarder::FragmentTransport::buffer_type buf;
+	std::size_t peak = 0;
+	int64_t ts = 0;
+	for (std::size_t i = 0; i < 1000; ++i) {
+		tx.Send(msg, static_cast<int64_t>(i));
+		while (rx.ReceiveMessage(buf, ts, 0) > 0) {
+			rx.Recycle(std::move(buf));
+		}
+		auto stats = rx.GetStats();
+		peak = (std::max)(peak, stats.PendingBytes + stats.PooledBytes);
+	}
+	auto stats = rx.GetStats();
+	std::cout << "1MB at 0.1% loss, MaxBytes " << (opts.MaxBytes >> 20) << "MB: received " << stats.MessagesReceived << "/1000 evicted " << stats.Evicted
+		<< " peak pending+pooled " << (peak >> 10) << "KB" << std::endl;
+	return 0;
+}
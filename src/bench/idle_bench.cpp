@@ -0,0 +1,213 @@
+﻿/************************************************************************
+ * @ObjectName: idle_bench.cpp
+ * @Description: 事件循环上由调用者驱动的空闲P2P客户端会话的内存、CPU开销与首包唤醒延迟测试
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#include <stdio.h>
+#endif // _WIN32
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "../forwarder/async_client.h"
+#include "../forwarder/event_loop.h"
+#include "../generator/histogram.h"
+#include "../punch/client.h"
+#include "../rendezvous/server.h"
+
+
+namespace
+{
+	/// <summary>以毫秒为单位的每次接收的超时时间，与转发器的接收循环相同</summary>
+	constexpr int64_t     Receive_Timeout  = 200;
+	/// <summary>以毫秒为单位的两次唤醒测量的间隔</summary>
+	constexpr int64_t     Probe_Interval   = 50;
+	/// <summary>以毫秒为单位的等待注册与连接的最长时间</summary>
+	constexpr int64_t     Register_Timeout = 3000;
+	/// <summary>接收缓冲区长度，与转发器协程帧中的缓冲区相同</summary>
+	constexpr std::size_t Buffer_Len       = 1504;
+	/// <summary>序列号基数，避开实际部署中的序列号</summary>
+	constexpr uint64_t    Seqno_Base       = 0x7200000000000000ULL;
+
+	int64_t micros()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/// <summary>
+	/// 空闲会话：与转发器相同，先等待注册完成，再以客户端为底层循环接收，收到数据包时记录从发送到协程恢复的微秒数
+	/// </summary>
+	vsnc::forwarder::Task session(vsnc::forwarder::EventLoop& loop, vsnc::punch::Client& client, std::atomic<std::size_t>& registered,
+		vsnc::generator::Histogram& wakeups)
+	{
+		co_await vsnc::forwarder::LeaveAsync(loop, client, vsnc::p2p::vsnc_p2p_state::OFFLINE, Register_Timeout);
+		registered.fetch_add(1);
+		char buf[Buffer_Len];
+		vsnc::utils::BasicMemory<char> mem(buf, sizeof(buf));
+		vsnc::forwarder::ClientTransport link(client);
+		int64_t ts = 0;
+		for (;;) {
+			auto ret = co_await vsnc::forwarder::ReceiveAsync(loop, link, mem, ts, Receive_Timeout);
+			if (ret > 0) {
+				wakeups.Record(micros() - ts);
+			}
+		}
+	}
+
+	/// <summary>
+	/// 等待客户端进入指定状态
+	/// </summary>
+	/// <returns>进入该状态返回true，超时返回false</returns>
+	bool waitState(const vsnc::punch::Client& client, const vsnc::p2p::vsnc_p2p_state state, const int64_t timeout)
+	{
+		auto start = vsnc::utils::__steady();
+		while (client.GetState() != state) {
+			if (vsnc::utils::__steady() - start > timeout) {
+				return false;
+			}
+			vsnc::utils::__sleep_milliseconds(1);
+		}
+		return true;
+	}
+
+	/// <returns>进程占用的物理内存字节数</returns>
+	uint64_t resident()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS pmc = {};
+		GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+		return pmc.WorkingSetSize;
+#else
+		long pages = 0, rss = 0;
+		auto fp = fopen("/proc/self/statm", "r");
+		if (fp) {
+			if (2 != fscanf(fp, "%ld %ld", &pages, &rss)) {
+				rss = 0;
+			}
+			fclose(fp);
+		}
+		return static_cast<uint64_t>(rss) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif // _WIN32
+	}
+
+	/// <returns>进程消耗的用户态与内核态CPU微秒数</returns>
+	int64_t cpu()
+	{
+#ifdef _WIN32
+		FILETIME create, exit, kernel, user;
+		GetProcessTimes(GetCurrentProcess(), &create, &exit, &kernel, &user);
+		auto to = [](const FILETIME& ft) {
+			return static_cast<int64_t>((static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) / 10;
+		};
+		return to(kernel) + to(user);
+#else
+		rusage ru = {};
+		getrusage(RUSAGE_SELF, &ru);
+		return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+#endif // _WIN32
+	}
+}
+
+
+int vsnc::bench::Idle(int argc, char* argv[])
+{
+	std::size_t sessions = (argc > 2) ? static_cast<std::size_t>(atoi(argv[2])) : 1000;
+	int64_t seconds = (argc > 3) ? atoi(argv[3]) : 10;
+	if (0 == sessions) {
+		return 1;
+	}
+	rendezvous::ServerOptions srv_opts;
+	srv_opts.Port = 0;
+	srv_opts.Workers = 1;
+	srv_opts.Capacity = sessions + 16;
+	rendezvous::Server server(srv_opts);
+	if (!server.Start()) {
+		std::cout << "Server::Start() failed." << std::endl;
+		return 1;
+	}
+	// 以不可路由的文档地址作为上报的内网端点，连接经回环上的公网端点完成
+	punch::ClientOptions opts;
+	inet_pton(AF_INET, "192.0.2.1", &opts.Intranet.Ip);
+	opts.Intranet.Port = 9;
+	opts.Parallel = true;
+	forwarder::EventLoopOptions loop_opts;
+	std::vector<std::unique_ptr<punch::Client>> clients;
+	std::atomic<std::size_t> registered{ 0 };
+	generator::Histogram wakeups;
+	auto before = resident();
+	{
+		forwarder::EventLoop loop(loop_opts);
+		auto driven = opts;
+		driven.Thread = false;
+		for (std::size_t i = 0; i < sessions; ++i) {
+			clients.emplace_back(new punch::Client(Seqno_Base + i, "127.0.0.1", server.Port(), 0, driven));
+			loop.Spawn(session(loop, *clients.back(), registered, wakeups));
+		}
+		std::thread runner([&loop]() { loop.Run(); });
+		auto start = utils::__steady();
+		while ((registered.load() < sessions) && (utils::__steady() - start < Register_Timeout)) {
+			utils::__sleep_milliseconds(10);
+		}
+		// 等待所有会话挂起后再开始计量，空闲期间只有客户端与服务器之间的心跳
+		utils::__sleep_milliseconds(2 * Receive_Timeout);
+		auto after = resident();
+		auto cpuStart = cpu();
+		auto idleStart = micros();
+		utils::__sleep_milliseconds(seconds * 1000);
+		auto idle = static_cast<double>(micros() - idleStart) / 1e6;
+		auto used = cpu() - cpuStart;
+		// 由一个有后台线程的客户端依次连接随机会话并发送一个数据包，测量从发送到协程恢复的延迟
+		auto sender = std::unique_ptr<punch::Client>(new punch::Client(Seqno_Base + sessions, "127.0.0.1", server.Port(), 0, opts));
+		waitState(*sender, p2p::vsnc_p2p_state::FREE, Register_Timeout);
+		std::mt19937 rng(7);
+		std::uniform_int_distribution<std::size_t> pick(0, sessions - 1);
+		int probes = 0;
+		int connected = 0;
+		char payload[64] = {};
+		utils::BasicMemory<char> mem(payload, sizeof(payload));
+		for (int64_t t = 0; t < seconds * 1000; t += Probe_Interval, ++probes) {
+			sender->Connect(Seqno_Base + pick(rng));
+			if (waitState(*sender, p2p::vsnc_p2p_state::CONNECTED, Register_Timeout)) {
+				++connected;
+				sender->Send(mem, micros());
+			}
+			utils::__sleep_milliseconds(Probe_Interval);
+		}
+		loop.Stop();
+		runner.join();
+		sender.reset();
+		auto stats = loop.GetStats();
+		std::cout << sessions << " idle punch::Client sessions (" << registered.load() << " registered), " << Receive_Timeout << "ms receive timeout, "
+			<< "timer resolution " << loop_opts.TimerResolution << "ms" << std::endl;
+		std::cout << "memory: " << (after - before) / sessions << " bytes/session" << std::endl;
+		std::cout << "cpu: " << utils::__to_string_with_precision(used / idle / sessions, 1) << " us/s per session while idle, including the in-process server" << std::endl;
+		std::cout << "loop: " << utils::__to_string_with_precision(stats.Polls / (idle + probes * Probe_Interval / 1000.0) / sessions, 1) << " polls/s per session, "
+			<< stats.Wakeups << " readiness wake-ups" << std::endl;
+		std::cout << "wake-up latency: " << wakeups.Count() << " samples (" << connected << "/" << probes << " connected), p50/p99/max "
+			<< wakeups.Percentile(0.5) << "/" << wakeups.Percentile(0.99) << "/" << wakeups.Max() << "us" << std::endl;
+	}
+	clients.clear();
+	server.Stop();
+	return 0;
+}
@@ -0,0 +1,269 @@
+﻿/************************************************************************
+ * @ObjectName: link.h
+ * @Description: 性能测试用的进程内数据报链路、丢包模型与虚拟时间的瓶颈链路模型
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_BENCH_LINK_H__
+#define __VSNC_BENCH_LINK_H__
+
+
+#include <deque>
+#include <random>
+#include <vector>
+#include <cstring>
+
+
+#include <stdint.h>
+
+
+#include "../forwarder/transport.h"
+
+
+namespace vsnc
+{
+
+	namespace bench
+	{
+
+
+		/// <summary>
+		/// <para>Gilbert-Elliott两状态丢包模型</para>
+		/// <para>好状态不丢包，坏状态全部丢包；平均丢包率为Loss，坏状态的平均持续包数为Burst，Burst为1时退化为独立丢包</para>
+		/// </summary>
+		class LossModel
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="loss">0到1之间的平均丢包率</param>
+			/// <param name="burst">平均连续丢包个数，不小于1</param>
+			/// <param name="seed">随机数种子</param>
+			LossModel(const double loss = 0, const double burst = 1, const uint32_t seed = 1) :
+				m_iRng(seed), m_bBad(false)
+			{
+				m_dLeave = 1.0 / (burst < 1 ? 1 : burst);
+				m_dEnter = (loss >= 1) ? 1 : (loss * m_dLeave / (1 - loss));
+			}
+
+			/// <summary>
+			/// 判断下一个数据包是否丢失
+			/// </summary>
+			/// <returns>丢失返回true</returns>
+			bool Drop()
+			{
+				if (m_dEnter <= 0) {
+					return false;
+				}
+				m_bBad = m_bBad ? (m_iUniform(m_iRng) >= m_dLeave) : (m_iUniform(m_iRng) < m_dEnter);
+				return m_bBad;
+			}
+
+		private:
+
+			/// <summary>随机数发生器</summary>
+			std::mt19937                           m_iRng;
+			/// <summary>[0, 1)均匀分布</summary>
+			std::uniform_real_distribution<double> m_iUniform;
+			/// <summary>好状态进入坏状态的概率</summary>
+			double                                 m_dEnter;
+			/// <summary>坏状态回到好状态的概率</summary>
+			double                                 m_dLeave;
+			/// <summary>是否处于坏状态</summary>
+			bool                                   m_bBad;
+		};
+
+
+		/// <summary>
+		/// 瓶颈链路参数，与netem的rate、limit、delay、jitter、loss对应
+		/// </summary>
+		struct NetemOptions
+		{
+			/// <summary>以字节每秒为单位的瓶颈带宽</summary>
+			uint64_t Rate    = 250000;
+			/// <summary>以微秒为单位的瓶颈队列容量，排队时延超过该值的数据包被丢弃</summary>
+			int64_t  Limit   = 200000;
+			/// <summary>以微秒为单位的单向传播时延</summary>
+			int64_t  Delay   = 20000;
+			/// <summary>以微秒为单位的最大时延抖动，在[0, Jitter]内均匀分布且不造成乱序</summary>
+			int64_t  Jitter  = 0;
+			/// <summary>0到1之间的随机丢包率</summary>
+			double   Loss    = 0;
+			/// <summary>平均连续丢包个数</summary>
+			double   Burst   = 1;
+			/// <summary>随机数种子</summary>
+			uint32_t Seed    = 1;
+		};
+
+
+		/// <summary>
+		/// <para>虚拟时间的单向瓶颈链路模型</para>
+		/// <para>数据包先经过按Rate服务的先进先出队列，队列时延超过Limit时尾部丢弃，再经随机丢包与传播时延、抖动后到达；只计算到达时间，不搬运数据</para>
+		/// </summary>
+		class NetemLink
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="opts">链路参数</param>
+			explicit NetemLink(const NetemOptions& opts) :
+				m_iOpts(opts), m_iLoss(opts.Loss, opts.Burst, opts.Seed), m_iRng(opts.Seed + 1), m_nBusy(0), m_nLastArrival(0) {}
+
+			/// <summary>
+			/// 修改瓶颈带宽，已在队列中的数据包不受影响
+			/// </summary>
+			/// <param name="rate">以字节每秒为单位的瓶颈带宽</param>
+			void     SetRate(const uint64_t rate) noexcept { m_iOpts.Rate = rate; }
+
+			/// <summary>
+			/// 获取瓶颈带宽
+			/// </summary>
+			/// <returns>以字节每秒为单位的瓶颈带宽</returns>
+			uint64_t Rate() const noexcept { return m_iOpts.Rate; }
+
+			/// <summary>
+			/// 发送一个数据包
+			/// </summary>
+			/// <param name="size">数据包长度</param>
+			/// <param name="now">以微秒为单位的发送时间，须单调不减</param>
+			/// <param name="arrival">以微秒为单位的到达时间</param>
+			/// <param name="queue">以微秒为单位的排队时延</param>
+			/// <returns>到达返回true，被丢弃返回false</returns>
+			bool     Send(const std::size_t size, const int64_t now, int64_t& arrival, int64_t& queue)
+			{
+				auto start = (m_nBusy > now) ? m_nBusy : now;
+				queue = start - now;
+				if (queue > m_iOpts.Limit) {
+					return false;
+				}
+				m_nBusy = start + static_cast<int64_t>(size * 1000000ULL / (m_iOpts.Rate ? m_iOpts.Rate : 1));
+				if (m_iLoss.Drop()) {
+					return false;
+				}
+				auto jitter = m_iOpts.Jitter ? static_cast<int64_t>(m_iRng() % static_cast<uint64_t>(m_iOpts.Jitter + 1)) : 0;
+				arrival = m_nBusy + m_iOpts.Delay + jitter;
+				if (arrival < m_nLastArrival) {
+					arrival = m_nLastArrival;
+				}
+				m_nLastArrival = arrival;
+				return true;
+			}
+
+		private:
+
+			/// <summary>链路参数</summary>
+			NetemOptions m_iOpts;
+			/// <summary>丢包模型</summary>
+			LossModel    m_iLoss;
+			/// <summary>抖动的随机数发生器</summary>
+			std::mt19937 m_iRng;
+			/// <summary>瓶颈队列清空的时间</summary>
+			int64_t      m_nBusy;
+			/// <summary>上一个数据包的到达时间</summary>
+			int64_t      m_nLastArrival;
+		};
+
+
+		/// <summary>
+		/// <para>进程内的单向数据报链路，发送的数据报按丢包模型丢弃后排队，由Receive取出</para>
+		/// <para>Receive不等待，队列为空时立即返回超时；非线程安全</para>
+		/// </summary>
+		class MemoryLink final : public forwarder::Transport
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="loss">丢包模型</param>
+			explicit MemoryLink(const LossModel& loss = LossModel()) : m_iLoss(loss), m_uSent(0), m_uDropped(0) {}
+
+			/// <summary>
+			/// 发送数据报
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>数据长度，丢弃时同样返回数据长度</returns>
+			ssize_t  Send(const utils::Memory<char>& mem, const int64_t ts) override
+			{
+				++m_uSent;
+				if (m_iLoss.Drop()) {
+					++m_uDropped;
+					return static_cast<ssize_t>(mem.Length());
+				}
+				m_iQueue.emplace_back();
+				m_iQueue.back().ts = ts;
+				m_iQueue.back().data.assign(mem.Data(), mem.Data() + mem.Length());
+				return static_cast<ssize_t>(mem.Length());
+			}
+
+			/// <summary>
+			/// 取出一个数据报
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <param name="timeout">忽略</param>
+			/// <returns>成功返回数据长度，缓冲区过小返回-1，队列为空返回-2</returns>
+			ssize_t  Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override
+			{
+				if (m_iQueue.empty()) {
+					return -2;
+				}
+				auto& front = m_iQueue.front();
+				auto len = front.data.size();
+				if (len > mem.Length()) {
+					m_iQueue.pop_front();
+					return -1;
+				}
+				memcpy(mem.Data(), front.data.data(), len);
+				ts = front.ts;
+				m_iQueue.pop_front();
+				return static_cast<ssize_t>(len);
+			}
+
+			/// <summary>
+			/// 获取发送的数据报个数，含丢弃的
+			/// </summary>
+			/// <returns>数据报个数</returns>
+			uint64_t Sent() const noexcept { return m_uSent; }
+
+			/// <summary>
+			/// 获取丢弃的数据报个数
+			/// </summary>
+			/// <returns>数据报个数</returns>
+			uint64_t Dropped() const noexcept { return m_uDropped; }
+
+		private:
+
+			/// <summary>
+			/// 排队的数据报
+			/// </summary>
+			struct __datagram
+			{
+				/// <summary>时间戳</summary>
+				int64_t           ts = 0;
+				/// <summary>数据</summary>
+				std::vector<char> data;
+			};
+
+			/// <summary>丢包模型</summary>
+			LossModel              m_iLoss;
+			/// <summary>排队的数据报</summary>
+			std::deque<__datagram> m_iQueue;
+			/// <summary>发送的数据报个数</summary>
+			uint64_t               m_uSent;
+			/// <summary>丢弃的数据报个数</summary>
+			uint64_t               m_uDropped;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_BENCH_LINK_H__
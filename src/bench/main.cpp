@@ -0,0 +1,89 @@
+﻿/************************************************************************
+ * @ObjectName: main.cpp
+ * @Description: 性能测试入口
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include <iostream>
+#include <string.h>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+
+#include "bench.h"
+
+
+static void usage()
+{
+	std::cout << "usage: bench connect [rounds] [timeout]" << std::endl;
+	std::cout << "       bench fec [size] [megabytes]" << std::endl;
+	std::cout << "       bench congestion [seconds]" << std::endl;
+	std::cout << "       bench fragment [megabytes]" << std::endl;
+	std::cout << "       bench timer [count] [milliseconds]" << std::endl;
+	std::cout << "       bench clock [reads] [seconds]" << std::endl;
+	std::cout << "       bench error [iterations]" << std::endl;
+	std::cout << "       bench executor [tasks] [threads]" << std::endl;
+	std::cout << "       bench idle [sessions] [seconds]" << std::endl;
+	std::cout << "       bench shard [sessions] [seconds] [workers]" << std::endl;
+	std::cout << "       bench rtp [packets] [ssrcs] [seconds]" << std::endl;
+	std::cout << "       bench secure [size] [megabytes]" << std::endl;
+	std::cout << "       bench pmtu [narrow] [count]" << std::endl;
+	std::cout << "       bench multipath [seconds] [pps]" << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+	//初始化WSA
+	WORD sockVersion = MAKEWORD(2, 2);
+	WSADATA wsaData;
+	if (WSAStartup(sockVersion, &wsaData) != 0) return 0;
+
+	auto ret = 1;
+	if ((argc > 1) && (0 == strcmp(argv[1], "connect"))) {
+		ret = vsnc::bench::Connect(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "fec"))) {
+		ret = vsnc::bench::Fec(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "congestion"))) {
+		ret = vsnc::bench::Congestion(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "fragment"))) {
+		ret = vsnc::bench::Fragment(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "timer"))) {
+		ret = vsnc::bench::Timer(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "clock"))) {
+		ret = vsnc::bench::Clock(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "error"))) {
+		ret = vsnc::bench::Error(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "executor"))) {
+		ret = vsnc::bench::Executor(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "idle"))) {
+		ret = vsnc::bench::Idle(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "shard"))) {
+		ret = vsnc::bench::Shard(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "rtp"))) {
+		ret = vsnc::bench::Rtp(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "secure"))) {
+		ret = vsnc::bench::Secure(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "pmtu"))) {
+		ret = vsnc::bench::Pmtu(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "multipath"))) {
+		ret = vsnc::bench::Multipath(argc, argv);
+	}
+	else {
+		usage();
+	}
+	WSACleanup();
+	return ret;
+}
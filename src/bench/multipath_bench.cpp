@@ -0,0 +1,238 @@
+﻿/************************************************************************
+ * @ObjectName: multipath_bench.cpp
+ * @Description: 多路径冗余发送对尾延迟与丢包的削减测试
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "../forwarder/multipath.h"
+#include "../forwarder/seq_window.h"
+#include "../generator/histogram.h"
+
+
+namespace
+{
+	/// <summary>以微秒为单位的路径基础时延</summary>
+	constexpr int64_t     Base_Delay   = 10000;
+	/// <summary>对数正态抖动的中位数，以微秒为单位</summary>
+	constexpr double      Jitter_Scale = 2000;
+	/// <summary>对数正态抖动的形状参数</summary>
+	constexpr double      Jitter_Shape = 0.5;
+	/// <summary>发生时延尖峰的概率</summary>
+	constexpr double      Spike_Rate   = 0.01;
+	/// <summary>以微秒为单位的时延尖峰范围</summary>
+	constexpr int64_t     Spike_Min    = 50000;
+	constexpr int64_t     Spike_Max    = 200000;
+	/// <summary>随机丢包率</summary>
+	constexpr double      Loss_Rate    = 0.005;
+	/// <summary>数据包长度</summary>
+	constexpr std::size_t Packet_Size  = 200;
+
+	int64_t micros()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/// <summary>
+	/// <para>实时的单向时延链路：每个数据报独立地经基础时延、对数正态抖动、偶发的时延尖峰与随机丢包后到达，允许乱序</para>
+	/// <para>Send与Receive可在不同线程中并发调用</para>
+	/// </summary>
+	class DelayLink final : public vsnc::forwarder::Transport
+	{
+	private:
+
+		struct __datagram
+		{
+			int64_t           due;
+			int64_t           ts;
+			std::vector<char> data;
+
+			bool operator>(const __datagram& other) const noexcept { return due > other.due; }
+		};
+
+	public:
+
+		explicit DelayLink(const uint32_t seed) : m_iRng(seed), m_iJitter(std::log(Jitter_Scale), Jitter_Shape) {}
+
+		ssize_t Send(const vsnc::utils::Memory<char>& mem, const int64_t ts) override
+		{
+			std::lock_guard<std::mutex> lock(m_iMutex);
+			if (m_iUniform(m_iRng) < Loss_Rate) {
+				return static_cast<ssize_t>(mem.Length());
+			}
+			auto delay = Base_Delay + static_cast<int64_t>(m_iJitter(m_iRng));
+			if (m_iUniform(m_iRng) < Spike_Rate) {
+				delay += Spike_Min + static_cast<int64_t>(m_iUniform(m_iRng) * (Spike_Max - Spike_Min));
+			}
+			m_iQueue.push(__datagram{ micros() + delay, ts, std::vector<char>(mem.Data(), mem.Data() + mem.Length()) });
+			m_iCond.notify_one();
+			return static_cast<ssize_t>(mem.Length());
+		}
+
+		ssize_t Receive(vsnc::utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override
+		{
+			std::unique_lock<std::mutex> lock(m_iMutex);
+			auto deadline = micros() + timeout * 1000;
+			while (true) {
+				auto now = micros();
+				if (!m_iQueue.empty() && (m_iQueue.top().due <= now)) {
+					break;
+				}
+				if ((timeout >= 0) && (now >= deadline)) {
+					return -2;
+				}
+				auto until = m_iQueue.empty() ? deadline : m_iQueue.top().due;
+				if (timeout >= 0) {
+					until = (std::min)(until, deadline);
+				}
+				if (m_iQueue.empty() && (timeout < 0)) {
+					m_iCond.wait(lock);
+				}
+				else {
+					m_iCond.wait_for(lock, std::chrono::microseconds(until - now));
+				}
+			}
+			auto& top = m_iQueue.top();
+			if (top.data.size() > mem.Length()) {
+				m_iQueue.pop();
+				return -1;
+			}
+			memcpy(mem.Data(), top.data.data(), top.data.size());
+			ts = top.ts;
+			auto len = static_cast<ssize_t>(top.data.size());
+			m_iQueue.pop();
+			return len;
+		}
+
+	private:
+
+		std::mutex                                                                   m_iMutex;
+		std::condition_variable                                                      m_iCond;
+		std::priority_queue<__datagram, std::vector<__datagram>, std::greater<__datagram>> m_iQueue;
+		std::mt19937                                                                 m_iRng;
+		std::uniform_real_distribution<double>                                       m_iUniform;
+		std::lognormal_distribution<double>                                          m_iJitter;
+	};
+
+	/// <summary>
+	/// 接收到发送结束后linger微秒为止，记录从发送到交付的微秒数
+	/// </summary>
+	/// <returns>交付的数据包个数</returns>
+	uint64_t drain(vsnc::forwarder::MultipathTransport& mp, vsnc::generator::Histogram& latency, const std::atomic<bool>& sending, const int64_t linger)
+	{
+		char buf[Packet_Size + vsnc::forwarder::MultipathTransport::Header_Len];
+		vsnc::utils::BasicMemory<char> mem(buf, sizeof(buf));
+		int64_t ts = 0;
+		uint64_t n = 0;
+		int64_t stop = -1;
+		while (true) {
+			if ((stop < 0) && !sending.load()) {
+				stop = micros() + linger;
+			}
+			if ((stop >= 0) && (micros() >= stop)) {
+				return n;
+			}
+			if (mp.Receive(mem, ts, 10) > 0) {
+				latency.Record(micros() - ts);
+				++n;
+			}
+		}
+	}
+
+	std::string ms(const int64_t us)
+	{
+		return vsnc::utils::__to_string_with_precision(us / 1000.0, 1);
+	}
+
+	void report(const char* name, const vsnc::generator::Histogram& latency, const uint64_t sent, const uint64_t delivered)
+	{
+		std::cout << name << ": p50 " << ms(latency.Percentile(0.5)) << " ms  p99 " << ms(latency.Percentile(0.99)) << " ms  p99.9 "
+			<< ms(latency.Percentile(0.999)) << " ms  loss " << vsnc::utils::__to_string_with_precision(100.0 * (sent - delivered) / (sent ? sent : 1), 2)
+			<< "%" << std::endl;
+	}
+
+	/// <returns>以纳秒为单位的单次去重的平均耗时，八分之一的输入与前一个交换位置</returns>
+	double windowCost(const std::size_t count)
+	{
+		std::vector<uint32_t> seqs(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			seqs[i] = static_cast<uint32_t>(i);
+		}
+		for (std::size_t i = 8; i < count; i += 8) {
+			std::swap(seqs[i], seqs[i - 1]);
+		}
+		vsnc::forwarder::SequenceWindow window;
+		std::size_t fresh = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (auto seq : seqs) {
+			fresh += (vsnc::forwarder::seq_state::FRESH == window.Insert(seq)) ? 1 : 0;
+		}
+		auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		return (fresh == count) ? ns / count : -1;
+	}
+}
+
+
+int vsnc::bench::Multipath(int argc, char* argv[])
+{
+	int64_t seconds = (argc > 2) ? atoi(argv[2]) : 10;
+	int64_t pps = (argc > 3) ? atoi(argv[3]) : 1000;
+	if (pps <= 0) {
+		return 1;
+	}
+	// 单路径与双路径同时运行；单路径的链路与双路径的第一条路径使用相同的随机数种子，两者经历相同的时延与丢包
+	DelayLink solo(1), a(1), b(2);
+	forwarder::MultipathTransport one({ &solo });
+	forwarder::MultipathTransport two({ &a, &b });
+	generator::Histogram oneLatency, twoLatency;
+	std::atomic<bool> sending{ true };
+	uint64_t oneDelivered = 0, twoDelivered = 0;
+	// 发送结束后再接收一个最大时延尖峰的时间，使迟到的数据包计入时延而不是丢包
+	std::thread r1([&]() { oneDelivered = drain(one, oneLatency, sending, Base_Delay + Spike_Max + 100000); });
+	std::thread r2([&]() { twoDelivered = drain(two, twoLatency, sending, Base_Delay + Spike_Max + 100000); });
+	std::vector<char> payload(Packet_Size, 0x5a);
+	utils::BasicMemory<char> mem(payload.data(), payload.size());
+	uint64_t sent = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto interval = std::chrono::microseconds(1000000 / pps);
+	for (int64_t i = 0; i < seconds * pps; ++i) {
+		std::this_thread::sleep_until(start + i * interval);
+		auto ts = micros();
+		one.Send(mem, ts);
+		two.Send(mem, ts);
+		++sent;
+	}
+	sending.store(false);
+	r1.join();
+	r2.join();
+	std::cout << "paths: " << Base_Delay / 1000 << " ms base delay, lognormal jitter (median " << Jitter_Scale / 1000 << " ms), "
+		<< Spike_Rate * 100 << "% spikes of " << Spike_Min / 1000 << "-" << Spike_Max / 1000 << " ms, " << Loss_Rate * 100 << "% loss; "
+		<< pps << " pps for " << seconds << " s" << std::endl;
+	report("one path ", oneLatency, sent, oneDelivered);
+	report("two paths", twoLatency, sent, twoDelivered);
+	auto stats = two.GetStats();
+	std::cout << "wins " << stats.Wins[0] << "/" << stats.Wins[1] << ", rescued " << stats.Rescued << ", first-copy lead avg "
+		<< ms(stats.GainAvg) << " ms, p99 " << ms(stats.Gain99) << " ms" << std::endl;
+	std::cout << "SequenceWindow::Insert: " << utils::__to_string_with_precision(windowCost(10000000), 1) << " ns with 1/8 of inputs reordered" << std::endl;
+	return 0;
+}
@@ -0,0 +1,153 @@
+﻿/************************************************************************
+ * @ObjectName: pmtu_bench.cpp
+ * @Description: 路径MTU在路径变窄后由丢包触发重新确认的检查
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+
+#include "link.h"
+#include "../forwarder/pmtu.h"
+
+
+namespace
+{
+	/// <summary>以毫秒为单位的探测超时时间，缩短以便快速完成搜索</summary>
+	constexpr int64_t Probe_Timeout = 20;
+
+	/// <summary>
+	/// 路径上限可变的单向内存链路，超出上限的数据报被静默丢弃，模拟路由改变后中间设备丢弃大包
+	/// </summary>
+	class NarrowLink final : public vsnc::forwarder::Transport
+	{
+	public:
+
+		explicit NarrowLink(const std::size_t limit) : m_uLimit(limit) {}
+
+		ssize_t Send(const vsnc::utils::Memory<char>& mem, const int64_t ts) override
+		{
+			if (mem.Length() > m_uLimit) {
+				return static_cast<ssize_t>(mem.Length());
+			}
+			return m_iQueue.Send(mem, ts);
+		}
+
+		ssize_t Receive(vsnc::utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override
+		{
+			return m_iQueue.Receive(mem, ts, timeout);
+		}
+
+		void SetLimit(const std::size_t limit) noexcept { m_uLimit = limit; }
+
+	private:
+
+		vsnc::bench::MemoryLink m_iQueue;
+		std::size_t             m_uLimit;
+	};
+
+	/// <summary>
+	/// 双向链路的一端：发往一条链路，从另一条链路接收
+	/// </summary>
+	class DuplexLink final : public vsnc::forwarder::Transport
+	{
+	public:
+
+		DuplexLink(NarrowLink& out, NarrowLink& in) : m_iOut(out), m_iIn(in) {}
+
+		ssize_t Send(const vsnc::utils::Memory<char>& mem, const int64_t ts) override { return m_iOut.Send(mem, ts); }
+
+		ssize_t Receive(vsnc::utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override
+		{
+			return m_iIn.Receive(mem, ts, timeout);
+		}
+
+	private:
+
+		NarrowLink& m_iOut;
+		NarrowLink& m_iIn;
+	};
+
+	/// <summary>
+	/// 交替驱动两端，直到发起端的搜索完成
+	/// </summary>
+	/// <returns>以毫秒为单位的耗时，超时返回-1</returns>
+	int64_t settle(vsnc::forwarder::PmtuTransport& a, vsnc::forwarder::PmtuTransport& b)
+	{
+		std::vector<char> buf(2048);
+		vsnc::utils::BasicMemory<char> mem(buf.data(), buf.size());
+		int64_t ts = 0;
+		auto start = std::chrono::steady_clock::now();
+		auto elapsed = [start]() {
+			return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		};
+		while (vsnc::forwarder::pmtu_state::COMPLETE != a.State()) {
+			if (elapsed() > 5000) {
+				return -1;
+			}
+			b.Receive(mem, ts, 0);
+			a.Receive(mem, ts, 1);
+		}
+		return elapsed();
+	}
+
+	/// <summary>
+	/// 以当前最大长度发送一批数据报
+	/// </summary>
+	/// <returns>丢包率</returns>
+	double burst(vsnc::forwarder::PmtuTransport& a, vsnc::forwarder::PmtuTransport& b, const std::size_t count)
+	{
+		std::vector<char> payload(a.MaxPayload(), 0x5a);
+		vsnc::utils::BasicMemory<char> src(payload.data(), payload.size());
+		std::vector<char> buf(2048);
+		vsnc::utils::BasicMemory<char> dst(buf.data(), buf.size());
+		int64_t ts = 0;
+		std::size_t received = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			a.Send(src, 0);
+			if (b.Receive(dst, ts, 0) > 0) {
+				++received;
+			}
+		}
+		return 1.0 - static_cast<double>(received) / static_cast<double>(count);
+	}
+}
+
+
+int vsnc::bench::Pmtu(int argc, char* argv[])
+{
+	std::size_t narrow = (argc > 2) ? static_cast<std::size_t>(atoi(argv[2])) : 1400;
+	std::size_t count = (argc > 3) ? static_cast<std::size_t>(atoi(argv[3])) : 100;
+	forwarder::PmtuOptions opts;
+	opts.ProbeTimeout = Probe_Timeout;
+	opts.ProbeRetries = 2;
+	NarrowLink ab(opts.MaxSize - opts.Overhead), ba(opts.MaxSize - opts.Overhead);
+	DuplexLink da(ab, ba), db(ba, ab);
+	forwarder::PmtuTransport a(da, opts);
+	forwarder::PmtuTransport b(db, opts);
+	a.Poll();
+	auto ms = settle(a, b);
+	std::cout << "initial search: path mtu " << a.PathMtu() << " in " << ms << "ms" << std::endl;
+
+	// 路径变窄：按当前长度发送的数据报全部丢失，低于阈值的丢包率不触发，超过阈值才重新确认
+	ab.SetLimit(narrow - opts.Overhead);
+	ba.SetLimit(narrow - opts.Overhead);
+	auto loss = burst(a, b, count);
+	a.ReportLoss(opts.LossThreshold / 2);
+	auto ignored = (0 == a.GetStats().Rechecks);
+	a.ReportLoss(loss);
+	auto rechecks = a.GetStats().Rechecks;
+	ms = settle(a, b);
+	auto after = burst(a, b, count);
+	std::cout << "path narrowed to " << narrow << ": loss " << loss * 100 << "% rechecks " << rechecks << " path mtu " << a.PathMtu()
+		<< " in " << ms << "ms, loss after recheck " << after * 100 << "%" << std::endl;
+	auto ok = ignored && (1 == rechecks) && (ms >= 0) && (a.PathMtu() <= narrow) && (a.PathMtu() + opts.Precision >= narrow) && (0 == after);
+	std::cout << (ok ? "ok" : "FAILED: loss burst did not trigger a re-probe down to the narrowed path") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,279 @@
+﻿/************************************************************************
+ * @ObjectName: rtp_bench.cpp
+ * @Description: RTP解析、分流与接收统计在每秒百万包下的单包开销测试
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "../forwarder/rtp.h"
+
+
+namespace
+{
+	/// <summary>数据包长度</summary>
+	constexpr std::size_t Packet_Size = 1200;
+	/// <summary>每批生成的数据包个数，约19MB，超出末级缓存以接近实际的接收缓冲区</summary>
+	constexpr std::size_t Chunk       = 16384;
+	/// <summary>同一个同步源连续发出的数据包个数</summary>
+	constexpr std::size_t Run         = 8;
+	/// <summary>注入的独立丢包率</summary>
+	constexpr double      Loss        = 0.01;
+	/// <summary>以微秒为单位的到达时间均匀噪声上限</summary>
+	constexpr int64_t     Noise       = 2000;
+	/// <summary>目标包速率</summary>
+	constexpr uint64_t    Target_Pps  = 1000000;
+	/// <summary>负载类型</summary>
+	constexpr uint8_t     Payload     = 96;
+
+	/// <summary>
+	/// 按固定速率发出的多路RTP流，各同步源以Run个数据包为一段交错，按Loss丢弃
+	/// </summary>
+	class Stream
+	{
+	public:
+
+		explicit Stream(const std::size_t sources) :
+			m_iSeq(sources, 0),
+			m_iBuf(Chunk * Packet_Size),
+			m_iArrival(Chunk),
+			m_iRng(7),
+			m_uIndex(0),
+			m_uDropped(0)
+		{
+			for (std::size_t i = 0; i < Chunk; ++i) {
+				auto p = m_iBuf.data() + i * Packet_Size;
+				memset(p, static_cast<int>(i), Packet_Size);
+				p[0] = static_cast<char>(0x80);
+				p[1] = static_cast<char>(Payload);
+			}
+		}
+
+		/// <summary>
+		/// 生成下一批数据包的头与到达时间
+		/// </summary>
+		/// <returns>本批数据包个数</returns>
+		std::size_t Fill()
+		{
+			std::uniform_real_distribution<double> u(0, 1);
+			std::uniform_int_distribution<int64_t> noise(0, Noise);
+			std::size_t n = 0;
+			while (n < Chunk) {
+				auto s = (m_uIndex / Run) % m_iSeq.size();
+				auto seq = m_iSeq[s]++;
+				// 按1MHz发送时刻，90kHz时间戳
+				auto sent = static_cast<int64_t>(m_uIndex++);
+				if (u(m_iRng) < Loss) {
+					++m_uDropped;
+					continue;
+				}
+				auto p = m_iBuf.data() + n * Packet_Size;
+				__put(p + 2, seq, 2);
+				__put(p + 4, static_cast<uint32_t>(sent * 9 / 100), 4);
+				__put(p + 8, static_cast<uint32_t>(0x1000 + s), 4);
+				m_iArrival[n] = sent + noise(m_iRng);
+				++n;
+			}
+			return n;
+		}
+
+		const char*    Data(const std::size_t i) const noexcept { return m_iBuf.data() + i * Packet_Size; }
+		int64_t        Arrival(const std::size_t i) const noexcept { return m_iArrival[i]; }
+		uint64_t       Dropped() const noexcept { return m_uDropped; }
+
+	private:
+
+		static void __put(char* p, const uint32_t v, const int n) noexcept
+		{
+			for (auto i = 0; i < n; ++i) {
+				p[i] = static_cast<char>(v >> (8 * (n - 1 - i)));
+			}
+		}
+
+		std::vector<uint16_t> m_iSeq;
+		std::vector<char>     m_iBuf;
+		std::vector<int64_t>  m_iArrival;
+		std::mt19937_64       m_iRng;
+		uint64_t              m_uIndex;
+		uint64_t              m_uDropped;
+	};
+
+	/// <summary>
+	/// 测量的处理方式
+	/// </summary>
+	enum class Mode
+	{
+		/// <summary>只解析RTP头</summary>
+		PARSE,
+		/// <summary>只把数据包拷贝到发送缓冲区，即未分流时的转发路径</summary>
+		COPY,
+		/// <summary>分流、更新统计并拷贝</summary>
+		DEMUX
+	};
+
+	const char* name(const Mode mode)
+	{
+		switch (mode) {
+		case Mode::PARSE:
+			return "parse only          ";
+		case Mode::COPY:
+			return "copy only           ";
+		default:
+			return "demux + stats + copy";
+		}
+	}
+
+	/// <summary>防止处理被优化掉</summary>
+	volatile std::size_t g_uSink = 0;
+
+	/// <summary>
+	/// 以最快速度处理count个数据包
+	/// </summary>
+	/// <returns>每个数据包的纳秒数</returns>
+	double measure(const Mode mode, const uint64_t count, vsnc::forwarder::RtpDemux& demux, Stream& stream)
+	{
+		vsnc::forwarder::RtpView view;
+		std::vector<char> out(Packet_Size);
+		std::size_t sink = 0;
+		double elapsed = 0;
+		uint64_t done = 0;
+		while (done < count) {
+			auto n = stream.Fill();
+			auto start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < n; ++i) {
+				auto p = stream.Data(i);
+				switch (mode) {
+				case Mode::PARSE:
+					sink += view.Parse(p, Packet_Size) ? view.Sequence() : 0;
+					break;
+				case Mode::COPY:
+					memcpy(out.data(), p, Packet_Size);
+					sink += static_cast<uint8_t>(out[2]);
+					break;
+				default:
+					sink += demux.Input(p, Packet_Size, stream.Arrival(i));
+					memcpy(out.data(), p, Packet_Size);
+					sink += static_cast<uint8_t>(out[2]);
+					break;
+				}
+			}
+			elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			done += n;
+		}
+		g_uSink = sink;
+		return elapsed * 1e9 / done;
+	}
+
+	/// <summary>
+	/// 按Target_Pps实时输入分流器，每毫秒补足到期的数据包，同一批数据包的到达时间相同
+	/// </summary>
+	/// <param name="busy">处理数据包所用时间占总时间的比例</param>
+	/// <returns>实际达到的包速率</returns>
+	double paced(const std::size_t sources, const int64_t seconds, double& busy)
+	{
+		vsnc::forwarder::RtpDemux demux;
+		for (std::size_t s = 0; s < sources; ++s) {
+			demux.AddSsrcRoute(static_cast<uint32_t>(0x1000 + s), s + 1);
+		}
+		Stream stream(sources);
+		std::vector<char> out(Packet_Size);
+		std::size_t sink = 0;
+		auto n = stream.Fill();
+		std::size_t next = 0;
+		uint64_t done = 0;
+		double work = 0;
+		auto start = std::chrono::steady_clock::now();
+		auto now = start;
+		auto end = start + std::chrono::seconds(seconds);
+		while (now < end) {
+			auto due = static_cast<uint64_t>(std::chrono::duration<double>(now - start).count() * Target_Pps);
+			auto begin = now;
+			while (done < due) {
+				if (next == n) {
+					// 生成下一批数据包的时间不计入处理时间
+					auto fill = std::chrono::steady_clock::now();
+					n = stream.Fill();
+					next = 0;
+					begin += std::chrono::steady_clock::now() - fill;
+				}
+				auto p = stream.Data(next++);
+				auto arrival = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+				sink += demux.Input(p, Packet_Size, arrival);
+				memcpy(out.data(), p, Packet_Size);
+				++done;
+			}
+			now = std::chrono::steady_clock::now();
+			work += std::chrono::duration<double>(now - begin).count();
+			if (done >= due) {
+				vsnc::utils::__sleep_milliseconds(1);
+				now = std::chrono::steady_clock::now();
+			}
+		}
+		g_uSink = sink;
+		auto elapsed = std::chrono::duration<double>(now - start).count();
+		busy = work / elapsed;
+		return done / elapsed;
+	}
+
+	std::string fixed(const double v, const int precision)
+	{
+		return vsnc::utils::__to_string_with_precision(v, precision);
+	}
+}
+
+
+int vsnc::bench::Rtp(int argc, char* argv[])
+{
+	uint64_t count = (argc > 2) ? static_cast<uint64_t>(atoll(argv[2])) : 10000000;
+	std::size_t sources = (argc > 3) ? static_cast<std::size_t>(atoi(argv[3])) : 4;
+	int64_t seconds = (argc > 4) ? atoi(argv[4]) : 5;
+	std::cout << count << " packets of " << Packet_Size << " bytes, " << sources << " SSRCs interleaved in runs of " << Run
+		<< ", " << fixed(Loss * 100, 0) << "% loss, 0-" << Noise << "us arrival noise" << std::endl;
+	double copy = 0;
+	for (auto mode : { Mode::PARSE, Mode::COPY, Mode::DEMUX }) {
+		forwarder::RtpDemux demux;
+		for (std::size_t s = 0; s < sources; ++s) {
+			demux.AddSsrcRoute(static_cast<uint32_t>(0x1000 + s), s + 1);
+		}
+		Stream stream(sources);
+		auto ns = measure(mode, count, demux, stream);
+		copy = (Mode::COPY == mode) ? ns : copy;
+		// 每秒百万包时每个数据包的纳秒数即千分之一核
+		std::cout << name(mode) << ": " << fixed(ns, 1) << " ns/pkt, " << fixed(ns * Target_Pps / 1e7, 2) << "% of one core at "
+			<< Target_Pps << " pps";
+		if (Mode::DEMUX != mode) {
+			std::cout << std::endl;
+			continue;
+		}
+		std::cout << ", +" << fixed(ns - copy, 1) << " ns/pkt over copy only" << std::endl;
+		int64_t lost = 0;
+		double jitter = 0;
+		auto sources_stats = demux.GetSources();
+		for (auto& s : sources_stats) {
+			lost += s.Lost;
+			jitter += static_cast<double>(s.JitterUs);
+		}
+		std::cout << "loss injected/reported: " << stream.Dropped() << "/" << lost << ", mean jitter "
+			<< fixed(sources_stats.empty() ? 0 : jitter / sources_stats.size(), 0) << "us (uniform 0-" << Noise << "us noise: "
+			<< fixed(Noise / 3.0, 0) << "us)" << std::endl;
+	}
+	// 实时：以目标速率持续输入，到达时间取实际时刻
+	double busy = 0;
+	auto pps = paced(sources, seconds, busy);
+	std::cout << "paced demux + stats + copy for " << seconds << "s: " << fixed(pps, 0) << " pps achieved of " << Target_Pps
+		<< ", thread busy " << fixed(busy * 100, 1) << "%" << std::endl;
+	return 0;
+}
@@ -0,0 +1,154 @@
+﻿/************************************************************************
+ * @ObjectName: secure_bench.cpp
+ * @Description: 认证加密传输与明文传输的收发吞吐量对比
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "link.h"
+#include "../forwarder/secure.h"
+
+
+namespace
+{
+	/// <summary>以字节为单位的每次收发之前预热的数据量，不计入统计</summary>
+	constexpr uint64_t Warmup = 16 * 1024 * 1024;
+
+	/// <summary>
+	/// 双向内存链路的一端：发往一个队列，从另一个队列接收
+	/// </summary>
+	class DuplexLink final : public vsnc::forwarder::Transport
+	{
+	public:
+
+		DuplexLink(vsnc::bench::MemoryLink& out, vsnc::bench::MemoryLink& in) : m_iOut(out), m_iIn(in) {}
+
+		ssize_t Send(const vsnc::utils::Memory<char>& mem, const int64_t ts) override { return m_iOut.Send(mem, ts); }
+
+		ssize_t Receive(vsnc::utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override
+		{
+			return m_iIn.Receive(mem, ts, timeout);
+		}
+
+	private:
+
+		vsnc::bench::MemoryLink& m_iOut;
+		vsnc::bench::MemoryLink& m_iIn;
+	};
+
+	/// <summary>
+	/// 逐个发送并立即接收，直到送达bytes字节
+	/// </summary>
+	/// <returns>以秒为单位的耗时，有数据报未送达时返回-1</returns>
+	double transfer(vsnc::forwarder::Transport& tx, vsnc::forwarder::Transport& rx, const std::size_t size, const uint64_t bytes)
+	{
+		std::vector<char> in(size, 0x5a);
+		std::vector<char> out(size);
+		vsnc::utils::BasicMemory<char> src(in.data(), in.size());
+		vsnc::utils::BasicMemory<char> dst(out.data(), out.size());
+		int64_t ts = 0;
+		uint64_t done = 0;
+		auto start = std::chrono::steady_clock::now();
+		while (done < bytes) {
+			in[0] = static_cast<char>(done);
+			if ((tx.Send(src, 0) < 0) || (rx.Receive(dst, ts, 0) != static_cast<ssize_t>(size))) {
+				return -1;
+			}
+			done += size;
+		}
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/// <summary>
+	/// 只发送不接收的对端：首个会话无需应答质询即可送达；对端以新会话重启后须应答质询才能替换当前会话
+	/// </summary>
+	/// <returns>检查是否通过</returns>
+	bool sendOnly(const uint8_t* const key, const std::size_t size, const std::size_t mtu)
+	{
+		vsnc::bench::MemoryLink ab, ba;
+		DuplexLink a(ab, ba), b(ba, ab);
+		vsnc::forwarder::SecureTransport sender(a, key, vsnc::forwarder::aead_cipher::CHACHA20_POLY1305, 1024, mtu);
+		vsnc::forwarder::SecureTransport receiver(b, key, vsnc::forwarder::aead_cipher::CHACHA20_POLY1305, 1024, mtu);
+		std::vector<char> buf(size);
+		vsnc::utils::BasicMemory<char> mem(buf.data(), buf.size());
+		int64_t ts = 0;
+		std::size_t delivered = 0;
+		for (auto i = 0; i < 100; ++i) {
+			sender.Send(mem, 0);
+			delivered += (receiver.Receive(mem, ts, 0) == static_cast<ssize_t>(size)) ? 1 : 0;
+		}
+		auto first = (100 == delivered) && (0 == receiver.GetStats().Challenges);
+		// 重启的对端：首个数据报被丢弃并触发质询，应答后才送达
+		vsnc::forwarder::SecureTransport restarted(a, key, vsnc::forwarder::aead_cipher::CHACHA20_POLY1305, 1024, mtu);
+		restarted.Send(mem, 0);
+		auto dropped = (-2 == receiver.Receive(mem, ts, 0));
+		restarted.Receive(mem, ts, 0);
+		receiver.Receive(mem, ts, 0);
+		restarted.Send(mem, 0);
+		auto resumed = (receiver.Receive(mem, ts, 0) == static_cast<ssize_t>(size));
+		auto& stats = receiver.GetStats();
+		std::cout << "send-only peer: delivered " << delivered << "/100 without challenge, restart dropped " << stats.Unverified
+			<< " and resumed after " << stats.Challenges << " challenge" << std::endl;
+		return first && dropped && resumed && (1 == stats.Restarts);
+	}
+
+	std::string gbps(const uint64_t bytes, const double seconds)
+	{
+		return vsnc::utils::__to_string_with_precision(bytes * 8 / seconds / 1e9, 2) + " Gbit/s";
+	}
+}
+
+
+int vsnc::bench::Secure(int argc, char* argv[])
+{
+	std::size_t size = (argc > 2) ? static_cast<std::size_t>(atoi(argv[2])) : 1200;
+	uint64_t bytes = ((argc > 3) ? static_cast<uint64_t>(atoll(argv[3])) : 1024) * 1024 * 1024;
+	auto mtu = (std::max)(static_cast<std::size_t>(1504), size + forwarder::SecureTransport::Overhead);
+	std::cout << (bytes >> 20) << "MB in " << size << "-byte datagrams, send then receive on one thread, "
+		<< "AES-NI " << (forwarder::Aead::Accelerated() ? "available" : "unavailable") << std::endl;
+	double plain = 0;
+	{
+		MemoryLink link;
+		transfer(link, link, size, Warmup);
+		plain = transfer(link, link, size, bytes);
+	}
+	std::cout << "plaintext: " << gbps(bytes, plain) << std::endl;
+	uint8_t key[forwarder::Aead::Key_Len];
+	for (std::size_t i = 0; i < sizeof(key); ++i) {
+		key[i] = static_cast<uint8_t>(i * 7 + 1);
+	}
+	for (auto cipher : { forwarder::aead_cipher::AES_256_GCM, forwarder::aead_cipher::CHACHA20_POLY1305 }) {
+		MemoryLink ab, ba;
+		DuplexLink a(ab, ba), b(ba, ab);
+		forwarder::SecureTransport sa(a, key, cipher, 1024, mtu);
+		forwarder::SecureTransport sb(b, key, cipher, 1024, mtu);
+		transfer(sa, sb, size, Warmup);
+		auto sec = transfer(sa, sb, size, bytes);
+		if (sec < 0) {
+			std::cout << sa.Name() << ": handshake failed" << std::endl;
+			continue;
+		}
+		auto& stats = sb.GetStats();
+		std::cout << sa.Name() << ": " << gbps(bytes, sec) << ", " << utils::__to_string_with_precision(sec / plain, 2)
+			<< "x plaintext time, +" << utils::__to_string_with_precision((sec - plain) * 1e9 / (bytes / size), 0)
+			<< " ns/datagram, opened " << stats.Opened << " unverified " << stats.Unverified << " challenges " << stats.Challenges
+			<< std::endl;
+	}
+	auto ok = sendOnly(key, size, mtu);
+	std::cout << (ok ? "ok" : "FAILED: a peer that never receives must be accepted as the first session, and only a session change challenged") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+﻿/************************************************************************
+ * @ObjectName: shard_bench.cpp
+ * @Description: 多核分片转发器在1到16个工作线程下经P2P客户端会话的转发包速率测试
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "../forwarder/async_client.h"
+#include "../forwarder/shard.h"
+#include "../punch/client.h"
+#include "../rendezvous/server.h"
+
+
+namespace
+{
+	/// <summary>转发的数据包长度</summary>
+	constexpr std::size_t Packet_Size      = 1200;
+	/// <summary>接收缓冲区长度，与转发器协程帧中的缓冲区相同</summary>
+	constexpr std::size_t Buffer_Len       = 1504;
+	/// <summary>会话每转发多少个数据包让出一次执行权，发送端每轮向每个会话发送的数据包个数</summary>
+	constexpr int         Batch            = 32;
+	/// <summary>以毫秒为单位的预热时间，不计入统计</summary>
+	constexpr int64_t     Warmup           = 200;
+	/// <summary>以毫秒为单位的每次接收的超时时间，与转发器的接收循环相同</summary>
+	constexpr int64_t     Receive_Timeout  = 200;
+	/// <summary>以毫秒为单位的等待注册与连接的最长时间</summary>
+	constexpr int64_t     Register_Timeout = 5000;
+	/// <summary>会话客户端的序列号基数，避开实际部署中的序列号</summary>
+	constexpr uint64_t    Seqno_Base       = 0x7300000000000000ULL;
+	/// <summary>发送端客户端的序列号基数</summary>
+	constexpr uint64_t    Sender_Base      = 0x7400000000000000ULL;
+
+	/// <summary>
+	/// 单个会话的包计数，独占缓存行，避免工作线程之间的伪共享
+	/// </summary>
+	struct alignas(64) Counter
+	{
+		std::atomic<uint64_t> packets{ 0 };
+	};
+
+	/// <summary>
+	/// 客户端参数：以不可路由的文档地址作为上报的内网端点，连接经回环上的公网端点完成
+	/// </summary>
+	vsnc::punch::ClientOptions clientOptions()
+	{
+		vsnc::punch::ClientOptions opts;
+		inet_pton(AF_INET, "192.0.2.1", &opts.Intranet.Ip);
+		opts.Intranet.Port = 9;
+		opts.Parallel = true;
+		opts.Thread = false;
+		return opts;
+	}
+
+	/// <summary>
+	/// 转发会话：与转发器相同，由所属工作线程驱动的P2P客户端接收上游数据，经工作线程的下游套接字发往回环上的接收端
+	/// </summary>
+	vsnc::forwarder::Task forward(vsnc::forwarder::EventLoop& loop, const int sock, const sockaddr_in to, const uint64_t seqno, const uint16_t port,
+		Counter& counter, std::atomic<std::size_t>& registered, vsnc::forwarder::ShardedForwarder::active_type active)
+	{
+		vsnc::punch::Client client(seqno, "127.0.0.1", port, 0, clientOptions());
+		co_await vsnc::forwarder::LeaveAsync(loop, client, vsnc::p2p::vsnc_p2p_state::OFFLINE, Register_Timeout);
+		registered.fetch_add(1);
+		vsnc::forwarder::ClientTransport link(client);
+		char buf[Buffer_Len];
+		vsnc::utils::BasicMemory<char> mem(buf, sizeof(buf));
+		int64_t ts = 0;
+		uint64_t n = 0;
+		auto batch = 0;
+		while (*active) {
+			auto ret = co_await vsnc::forwarder::ReceiveAsync(loop, link, mem, ts, Receive_Timeout);
+			if ((ret > 0) && (sendto(sock, buf, static_cast<int>(ret), 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to)) > 0)) {
+				counter.packets.store(++n, std::memory_order_relaxed);
+			}
+			if (++batch >= Batch) {
+				batch = 0;
+				co_await loop.Yield();
+			}
+		}
+	}
+
+	/// <summary>
+	/// 发送端线程：驱动一组P2P客户端，会话全部注册后各自连接一个会话，此后每轮向每个会话发送一批数据包
+	/// </summary>
+	void drive(const uint64_t base, const uint64_t first, const uint64_t last, const uint16_t port, const std::size_t sessions,
+		const std::atomic<std::size_t>& registered, std::atomic<std::size_t>& connected, const std::atomic<bool>& run)
+	{
+		std::vector<std::unique_ptr<vsnc::punch::Client>> clients;
+		std::vector<int64_t> attempts;
+		std::vector<bool> up;
+		for (auto i = first; i < last; ++i) {
+			clients.emplace_back(new vsnc::punch::Client(Sender_Base + base + i, "127.0.0.1", port, 0, clientOptions()));
+			attempts.push_back(-Register_Timeout);
+			up.push_back(false);
+		}
+		char payload[Packet_Size];
+		memset(payload, 0x5a, sizeof(payload));
+		vsnc::utils::BasicMemory<char> mem(payload, sizeof(payload));
+		while (run.load(std::memory_order_relaxed)) {
+			auto busy = false;
+			for (std::size_t i = 0; i < clients.size(); ++i) {
+				auto& c = *clients[i];
+				c.Pump();
+				auto state = c.GetState();
+				auto now = vsnc::utils::__steady();
+				if ((vsnc::p2p::vsnc_p2p_state::FREE == state) && (registered.load() == sessions) && (now - attempts[i] >= Register_Timeout)) {
+					attempts[i] = now;
+					c.Connect(Seqno_Base + base + first + i);
+				}
+				if (vsnc::p2p::vsnc_p2p_state::CONNECTED != state) {
+					continue;
+				}
+				if (!up[i]) {
+					up[i] = true;
+					connected.fetch_add(1);
+				}
+				for (auto k = 0; k < Batch; ++k) {
+					c.Send(mem, 0);
+				}
+				busy = true;
+			}
+			if (!busy) {
+				vsnc::utils::__sleep_milliseconds(1);
+			}
+		}
+	}
+
+	uint64_t total(const std::vector<Counter>& counters)
+	{
+		uint64_t n = 0;
+		for (auto& c : counters) {
+			n += c.packets.load(std::memory_order_relaxed);
+		}
+		return n;
+	}
+}
+
+
+int vsnc::bench::Shard(int argc, char* argv[])
+{
+	std::size_t sessions = (argc > 2) ? static_cast<std::size_t>(atoi(argv[2])) : 256;
+	int64_t seconds = (argc > 3) ? atoi(argv[3]) : 3;
+	std::size_t max = (argc > 4) ? static_cast<std::size_t>(atoi(argv[4])) : 16;
+	rendezvous::ServerOptions srv_opts;
+	srv_opts.Port = 0;
+	srv_opts.Workers = 1;
+	rendezvous::Server server(srv_opts);
+	if (!server.Start()) {
+		std::cout << "Server::Start() failed." << std::endl;
+		return 1;
+	}
+	// 回环上的接收端只绑定不读取，接收缓冲区满后内核直接丢弃，测量的是转发端的转发速率
+	auto sink = static_cast<int>(socket(AF_INET, SOCK_DGRAM, 0));
+	sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = 0;
+	inet_pton(AF_INET, "127.0.0.1", &to.sin_addr);
+	socklen_t len = sizeof(to);
+	if ((-1 == sink) || (bind(sink, reinterpret_cast<sockaddr*>(&to), sizeof(to)) == -1)
+		|| (getsockname(sink, reinterpret_cast<sockaddr*>(&to), &len) == -1)) {
+		std::cout << "UDP::bind() failed." << std::endl;
+		server.Stop();
+		return 1;
+	}
+	auto port = server.Port();
+	std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", " << sessions << " punch::Client sessions, "
+		<< Packet_Size << "-byte packets from in-process senders to loopback, " << seconds << "s per run" << std::endl;
+	double base = 0;
+	uint64_t round = 0;
+	for (std::size_t n = 1; n <= max; n *= 2) {
+		// 每轮使用新的序列号，避免服务器上尚未过期的上一轮注册
+		auto seqno = (++round) << 32;
+		std::vector<Counter> counters(sessions);
+		std::atomic<std::size_t> registered{ 0 };
+		std::atomic<std::size_t> connected{ 0 };
+		std::atomic<bool> run{ true };
+		forwarder::ShardOptions opts;
+		opts.Workers = n;
+		opts.Port = 0;
+		forwarder::ShardedForwarder forwarder([to, seqno, port, &counters, &registered](forwarder::EventLoop& loop, const int sock, const uint64_t peer,
+			forwarder::ShardedForwarder::active_type active) {
+			return forward(loop, sock, to, Seqno_Base + seqno + peer, port, counters[peer], registered, std::move(active));
+		}, opts);
+		for (std::size_t i = 0; i < sessions; ++i) {
+			forwarder.AddSession(i);
+		}
+		if (!forwarder.Start()) {
+			std::cout << "ShardedForwarder::Start() failed." << std::endl;
+			break;
+		}
+		// 发送端线程与工作线程个数相同，各自负责一部分会话
+		std::vector<std::thread> senders;
+		for (std::size_t t = 0; t < n; ++t) {
+			senders.emplace_back(drive, seqno, sessions * t / n, sessions * (t + 1) / n, port, sessions, std::cref(registered), std::ref(connected), std::cref(run));
+		}
+		auto start = utils::__steady();
+		while ((connected.load() < sessions) && (utils::__steady() - start < 2 * Register_Timeout)) {
+			utils::__sleep_milliseconds(10);
+		}
+		utils::__sleep_milliseconds(Warmup);
+		auto from = total(counters);
+		auto begin = std::chrono::steady_clock::now();
+		utils::__sleep_milliseconds(seconds * 1000);
+		auto forwarded = total(counters) - from;
+		auto sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		auto stats = forwarder.GetStats();
+		run.store(false);
+		for (auto& t : senders) {
+			t.join();
+		}
+		forwarder.Stop();
+		auto pps = forwarded / sec;
+		base = base ? base : pps;
+		std::cout << n << " workers: " << utils::__to_string_with_precision(pps / 1e6, 3) << " Mpps, "
+			<< utils::__to_string_with_precision(pps * Packet_Size * 8 / 1e9, 2) << " Gbit/s, x"
+			<< utils::__to_string_with_precision(pps / base, 2) << " of 1 worker, connected " << connected.load() << "/" << sessions
+			<< ", sessions per worker";
+		for (auto& s : stats) {
+			std::cout << " " << s.Sessions;
+		}
+		std::cout << std::endl;
+	}
+	closesocket(sink);
+	server.Stop();
+	return 0;
+}
@@ -0,0 +1,133 @@
+﻿/************************************************************************
+ * @ObjectName: timer_bench.cpp
+ * @Description: 分层时间轮与二叉堆定时器的插入、取消与到期开销对比
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "bench.h"
+
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+
+#include <vsnc_utils/timer_wheel.h>
+#include <vsnc_utils/utils.h>
+
+
+namespace
+{
+	/// <summary>
+	/// 以std::priority_queue实现的定时器，取消时只做标记，到期时跳过，是时间轮之外最常见的做法
+	/// </summary>
+	class HeapTimer
+	{
+	public:
+
+		uint64_t ScheduleAt(const int64_t deadline, std::function<void()> cb)
+		{
+			m_iQueue.push(__entry{ deadline, m_iCancelled.size(), std::move(cb) });
+			m_iCancelled.push_back(false);
+			return m_iCancelled.size() - 1;
+		}
+
+		void Cancel(const uint64_t id) { m_iCancelled[id] = true; }
+
+		std::size_t Advance(const int64_t now)
+		{
+			std::size_t fired = 0;
+			while (!m_iQueue.empty() && (m_iQueue.top().deadline <= now)) {
+				auto cb = std::move(const_cast<__entry&>(m_iQueue.top()).cb);
+				auto id = m_iQueue.top().id;
+				m_iQueue.pop();
+				if (!m_iCancelled[id]) {
+					cb();
+					++fired;
+				}
+			}
+			return fired;
+		}
+
+	private:
+
+		struct __entry
+		{
+			int64_t               deadline;
+			uint64_t              id;
+			std::function<void()> cb;
+
+			bool operator>(const __entry& other) const noexcept { return deadline > other.deadline; }
+		};
+
+		std::priority_queue<__entry, std::vector<__entry>, std::greater<__entry>> m_iQueue;
+		std::vector<bool>                                                          m_iCancelled;
+	};
+
+	double nanoseconds(const std::chrono::steady_clock::time_point start, const std::size_t ops)
+	{
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+	}
+
+	std::string ns(const double v)
+	{
+		return vsnc::utils::__to_string_with_precision(v, 1) + " ns";
+	}
+
+	/// <summary>
+	/// 插入count个在[1, spread]毫秒内均匀分布的定时器，取消其中一半，再以1毫秒步长推进到全部到期
+	/// </summary>
+	template<typename Timer>
+	void run(const char* name, Timer& timer, const std::vector<int64_t>& deadlines, const int64_t spread)
+	{
+		std::vector<uint64_t> ids(deadlines.size());
+		uint64_t fired = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < deadlines.size(); ++i) {
+			ids[i] = timer.ScheduleAt(deadlines[i], [&fired]() { ++fired; });
+		}
+		auto insert = nanoseconds(start, deadlines.size());
+		start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < ids.size(); i += 2) {
+			timer.Cancel(ids[i]);
+		}
+		auto cancel = nanoseconds(start, (ids.size() + 1) / 2);
+		start = std::chrono::steady_clock::now();
+		for (int64_t now = 1; now <= spread; ++now) {
+			timer.Advance(now);
+		}
+		auto expire = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << name << " insert: " << ns(insert) << " cancel: " << ns(cancel)
+			<< " expire: " << vsnc::utils::__to_string_with_precision(expire, 2) << " ms for " << spread << " ticks, fired " << fired << std::endl;
+	}
+}
+
+
+int vsnc::bench::Timer(int argc, char* argv[])
+{
+	std::size_t count = (argc > 2) ? static_cast<std::size_t>(atoi(argv[2])) : 100000;
+	int64_t spread = (argc > 3) ? atoi(argv[3]) : 30000;
+	std::mt19937_64 rng(7);
+	std::uniform_int_distribution<int64_t> dist(1, spread);
+	std::vector<int64_t> deadlines(count);
+	for (auto& d : deadlines) {
+		d = dist(rng);
+	}
+	std::cout << count << " timers over " << spread << " ms, half cancelled" << std::endl;
+	for (auto round = 0; round < 3; ++round) {
+		{
+			utils::TimerWheel wheel;
+			run("wheel", wheel, deadlines, spread);
+		}
+		{
+			HeapTimer heap;
+			run("heap ", heap, deadlines, spread);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,802 @@
+﻿/************************************************************************
+ * @ObjectName: aead.cpp
+ * @Description: 带关联数据的认证加密（AES-256-GCM与ChaCha20-Poly1305）
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "aead.h"
+
+
+#include <algorithm>
+#include <cstring>
+
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define __VSNC_AEAD_X86__
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define __VSNC_TARGET(isa)
+#else
+#include <cpuid.h>
+#define __VSNC_TARGET(isa) __attribute__((target(isa)))
+#endif // _MSC_VER
+#endif // x86
+
+
+namespace
+{
+	/// <summary>AES-256的轮数</summary>
+	constexpr int         Aes_Rounds = 14;
+	/// <summary>GCM与CTR的分组长度</summary>
+	constexpr std::size_t Block_Len  = 16;
+	/// <summary>硬件CTR每批并行加密的分组个数</summary>
+	constexpr std::size_t Lanes      = 8;
+
+	uint32_t load32be(const uint8_t* p) noexcept
+	{
+		return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+	}
+
+	void store32be(uint8_t* p, const uint32_t v) noexcept
+	{
+		p[0] = static_cast<uint8_t>(v >> 24);
+		p[1] = static_cast<uint8_t>(v >> 16);
+		p[2] = static_cast<uint8_t>(v >> 8);
+		p[3] = static_cast<uint8_t>(v);
+	}
+
+	uint32_t load32le(const uint8_t* p) noexcept
+	{
+		return p[0] | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	void store32le(uint8_t* p, const uint32_t v) noexcept
+	{
+		p[0] = static_cast<uint8_t>(v);
+		p[1] = static_cast<uint8_t>(v >> 8);
+		p[2] = static_cast<uint8_t>(v >> 16);
+		p[3] = static_cast<uint8_t>(v >> 24);
+	}
+
+	void store64be(uint8_t* p, const uint64_t v) noexcept
+	{
+		store32be(p, static_cast<uint32_t>(v >> 32));
+		store32be(p + 4, static_cast<uint32_t>(v));
+	}
+
+	void store64le(uint8_t* p, const uint64_t v) noexcept
+	{
+		store32le(p, static_cast<uint32_t>(v));
+		store32le(p + 4, static_cast<uint32_t>(v >> 32));
+	}
+
+	uint32_t rotr32(const uint32_t v, const int n) noexcept
+	{
+		return (v >> n) | (v << (32 - n));
+	}
+
+	uint32_t rotl32(const uint32_t v, const int n) noexcept
+	{
+		return (v << n) | (v >> (32 - n));
+	}
+
+	/// <summary>
+	/// 写入GCM的计数器分组：96位随机数后接32位大端序计数
+	/// </summary>
+	void counterBlock(uint8_t* blk, const uint8_t* nonce, const uint32_t ctr) noexcept
+	{
+		memcpy(blk, nonce, vsnc::forwarder::Aead::Nonce_Len);
+		store32be(blk + 12, ctr);
+	}
+
+	/// <summary>
+	/// AES的S盒与加密T表，首次使用时生成
+	/// </summary>
+	struct AesTables
+	{
+		/// <summary>S盒</summary>
+		uint8_t  sbox[256];
+		/// <summary>合并了字节代换、行移位与列混合的T表</summary>
+		uint32_t te[4][256];
+
+		AesTables() noexcept
+		{
+			// p遍历GF(2^8)的乘法群（生成元3），q为p的逆元
+			uint8_t p = 1, q = 1;
+			do {
+				p = static_cast<uint8_t>(p ^ (p << 1) ^ ((p & 0x80) ? 0x1B : 0));
+				q = static_cast<uint8_t>(q ^ (q << 1));
+				q = static_cast<uint8_t>(q ^ (q << 2));
+				q = static_cast<uint8_t>(q ^ (q << 4));
+				if (q & 0x80) {
+					q ^= 0x09;
+				}
+				auto x = static_cast<uint8_t>(q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4));
+				sbox[p] = static_cast<uint8_t>(x ^ 0x63);
+			} while (p != 1);
+			sbox[0] = 0x63;
+			for (int i = 0; i < 256; ++i) {
+				uint32_t s = sbox[i];
+				uint32_t s2 = ((s << 1) ^ ((s & 0x80) ? 0x1B : 0)) & 0xFF;
+				te[0][i] = (s2 << 24) | (s << 16) | (s << 8) | (s2 ^ s);
+				te[1][i] = rotr32(te[0][i], 8);
+				te[2][i] = rotr32(te[0][i], 16);
+				te[3][i] = rotr32(te[0][i], 24);
+			}
+		}
+
+		static uint8_t rotl8(const uint8_t v, const int n) noexcept
+		{
+			return static_cast<uint8_t>((v << n) | (v >> (8 - n)));
+		}
+	};
+
+	const AesTables& aesTables() noexcept
+	{
+		static const AesTables t;
+		return t;
+	}
+
+	void aesExpand256(const uint8_t* key, uint32_t w[60]) noexcept
+	{
+		auto& t = aesTables();
+		uint32_t rcon = 0x01;
+		for (int i = 0; i < 8; ++i) {
+			w[i] = load32be(key + 4 * i);
+		}
+		for (int i = 8; i < 60; ++i) {
+			auto x = w[i - 1];
+			if (0 == i % 8) {
+				x = (static_cast<uint32_t>(t.sbox[(x >> 16) & 0xFF]) << 24) | (static_cast<uint32_t>(t.sbox[(x >> 8) & 0xFF]) << 16)
+					| (static_cast<uint32_t>(t.sbox[x & 0xFF]) << 8) | t.sbox[x >> 24];
+				x ^= rcon << 24;
+				rcon <<= 1;
+			}
+			else if (4 == i % 8) {
+				x = (static_cast<uint32_t>(t.sbox[x >> 24]) << 24) | (static_cast<uint32_t>(t.sbox[(x >> 16) & 0xFF]) << 16)
+					| (static_cast<uint32_t>(t.sbox[(x >> 8) & 0xFF]) << 8) | t.sbox[x & 0xFF];
+			}
+			w[i] = w[i - 8] ^ x;
+		}
+	}
+
+	void aesEncryptTable(const uint32_t* w, const uint8_t* in, uint8_t* out) noexcept
+	{
+		auto& t = aesTables();
+		auto s0 = load32be(in) ^ w[0];
+		auto s1 = load32be(in + 4) ^ w[1];
+		auto s2 = load32be(in + 8) ^ w[2];
+		auto s3 = load32be(in + 12) ^ w[3];
+		for (int r = 1; r < Aes_Rounds; ++r) {
+			auto k = w + 4 * r;
+			auto t0 = t.te[0][s0 >> 24] ^ t.te[1][(s1 >> 16) & 0xFF] ^ t.te[2][(s2 >> 8) & 0xFF] ^ t.te[3][s3 & 0xFF] ^ k[0];
+			auto t1 = t.te[0][s1 >> 24] ^ t.te[1][(s2 >> 16) & 0xFF] ^ t.te[2][(s3 >> 8) & 0xFF] ^ t.te[3][s0 & 0xFF] ^ k[1];
+			auto t2 = t.te[0][s2 >> 24] ^ t.te[1][(s3 >> 16) & 0xFF] ^ t.te[2][(s0 >> 8) & 0xFF] ^ t.te[3][s1 & 0xFF] ^ k[2];
+			auto t3 = t.te[0][s3 >> 24] ^ t.te[1][(s0 >> 16) & 0xFF] ^ t.te[2][(s1 >> 8) & 0xFF] ^ t.te[3][s2 & 0xFF] ^ k[3];
+			s0 = t0;
+			s1 = t1;
+			s2 = t2;
+			s3 = t3;
+		}
+		auto k = w + 4 * Aes_Rounds;
+		auto last = [&t](const uint32_t a, const uint32_t b, const uint32_t c, const uint32_t d) {
+			return (static_cast<uint32_t>(t.sbox[a >> 24]) << 24) | (static_cast<uint32_t>(t.sbox[(b >> 16) & 0xFF]) << 16)
+				| (static_cast<uint32_t>(t.sbox[(c >> 8) & 0xFF]) << 8) | t.sbox[d & 0xFF];
+		};
+		store32be(out, last(s0, s1, s2, s3) ^ k[0]);
+		store32be(out + 4, last(s1, s2, s3, s0) ^ k[1]);
+		store32be(out + 8, last(s2, s3, s0, s1) ^ k[2]);
+		store32be(out + 12, last(s3, s0, s1, s2) ^ k[3]);
+	}
+
+	/// <summary>4位查表GHASH的约减常数</summary>
+	constexpr uint64_t Ghash_Last4[16] = {
+		0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+		0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0,
+	};
+
+	void ghashTableInit(const uint8_t* h, uint64_t high[16], uint64_t low[16]) noexcept
+	{
+		auto vh = (static_cast<uint64_t>(load32be(h)) << 32) | load32be(h + 4);
+		auto vl = (static_cast<uint64_t>(load32be(h + 8)) << 32) | load32be(h + 12);
+		high[0] = low[0] = 0;
+		high[8] = vh;
+		low[8] = vl;
+		for (int i = 4; i > 0; i >>= 1) {
+			auto t = (vl & 1) * 0xe1000000u;
+			vl = (vh << 63) | (vl >> 1);
+			vh = (vh >> 1) ^ (static_cast<uint64_t>(t) << 32);
+			high[i] = vh;
+			low[i] = vl;
+		}
+		for (int i = 2; i <= 8; i *= 2) {
+			for (int j = 1; j < i; ++j) {
+				high[i + j] = high[i] ^ high[j];
+				low[i + j] = low[i] ^ low[j];
+			}
+		}
+	}
+
+	void ghashMulTable(uint8_t x[16], const uint64_t high[16], const uint64_t low[16]) noexcept
+	{
+		auto lo = x[15] & 0xF;
+		auto zh = high[lo];
+		auto zl = low[lo];
+		for (int i = 15; i >= 0; --i) {
+			lo = x[i] & 0xF;
+			auto hi = (x[i] >> 4) & 0xF;
+			if (15 != i) {
+				auto rem = zl & 0xF;
+				zl = (zh << 60) | (zl >> 4);
+				zh = (zh >> 4) ^ (Ghash_Last4[rem] << 48) ^ high[lo];
+				zl ^= low[lo];
+			}
+			auto rem = zl & 0xF;
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (Ghash_Last4[rem] << 48) ^ high[hi];
+			zl ^= low[hi];
+		}
+		store64be(x, zh);
+		store64be(x + 8, zl);
+	}
+
+	void ghashTable(uint8_t y[16], const uint8_t* data, const std::size_t len, const uint64_t high[16], const uint64_t low[16]) noexcept
+	{
+		for (std::size_t off = 0; off < len; off += Block_Len) {
+			auto n = (std::min)(Block_Len, len - off);
+			for (std::size_t i = 0; i < n; ++i) {
+				y[i] ^= data[off + i];
+			}
+			ghashMulTable(y, high, low);
+		}
+	}
+
+#ifdef __VSNC_AEAD_X86__
+	__VSNC_TARGET("ssse3")
+	__m128i byteSwap(const __m128i v) noexcept
+	{
+		return _mm_shuffle_epi8(v, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+	}
+
+	/// <summary>
+	/// 字节逆序域内的无约减乘法，结果累加到(lo, hi)
+	/// </summary>
+	__VSNC_TARGET("pclmul,sse2")
+	void clmulAccumulate(const __m128i a, const __m128i b, __m128i& lo, __m128i& hi) noexcept
+	{
+		auto t0 = _mm_clmulepi64_si128(a, b, 0x00);
+		auto t1 = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+		auto t2 = _mm_clmulepi64_si128(a, b, 0x11);
+		lo = _mm_xor_si128(lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+		hi = _mm_xor_si128(hi, _mm_xor_si128(t2, _mm_srli_si128(t1, 8)));
+	}
+
+	/// <summary>
+	/// 将256位乘积左移一位并按x^128+x^7+x^2+x+1约减（Intel GCM白皮书算法5）
+	/// </summary>
+	__VSNC_TARGET("sse2")
+	__m128i ghashReduce(__m128i lo, __m128i hi) noexcept
+	{
+		auto c0 = _mm_srli_epi32(lo, 31);
+		auto c1 = _mm_srli_epi32(hi, 31);
+		lo = _mm_slli_epi32(lo, 1);
+		hi = _mm_slli_epi32(hi, 1);
+		auto carry = _mm_srli_si128(c0, 12);
+		lo = _mm_or_si128(lo, _mm_slli_si128(c0, 4));
+		hi = _mm_or_si128(_mm_or_si128(hi, _mm_slli_si128(c1, 4)), carry);
+		auto a = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+		auto b = _mm_srli_si128(a, 4);
+		lo = _mm_xor_si128(lo, _mm_slli_si128(a, 12));
+		auto d = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+		lo = _mm_xor_si128(lo, _mm_xor_si128(d, b));
+		return _mm_xor_si128(hi, lo);
+	}
+
+	__VSNC_TARGET("pclmul,ssse3")
+	__m128i ghashMulHardware(const __m128i a, const __m128i b) noexcept
+	{
+		auto lo = _mm_setzero_si128();
+		auto hi = _mm_setzero_si128();
+		clmulAccumulate(a, b, lo, hi);
+		return ghashReduce(lo, hi);
+	}
+
+	__VSNC_TARGET("pclmul,ssse3")
+	void ghashPowers(const uint8_t* h, uint8_t* powers) noexcept
+	{
+		auto h1 = byteSwap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h)));
+		auto hn = h1;
+		for (int i = 0; i < 4; ++i) {
+			_mm_store_si128(reinterpret_cast<__m128i*>(powers + 16 * i), hn);
+			hn = ghashMulHardware(hn, h1);
+		}
+	}
+
+	/// <summary>
+	/// 硬件GHASH，每4个完整分组以H^4..H^1合并一次约减，末尾不足一个分组时补0
+	/// </summary>
+	__VSNC_TARGET("pclmul,ssse3")
+	__m128i ghashHardware(__m128i y, const uint8_t* data, const std::size_t len, const uint8_t* powers) noexcept
+	{
+		auto p = reinterpret_cast<const __m128i*>(powers);
+		auto h1 = _mm_load_si128(p), h2 = _mm_load_si128(p + 1), h3 = _mm_load_si128(p + 2), h4 = _mm_load_si128(p + 3);
+		std::size_t off = 0;
+		for (; off + 4 * Block_Len <= len; off += 4 * Block_Len) {
+			auto x0 = _mm_xor_si128(y, byteSwap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + off))));
+			auto x1 = byteSwap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + off + 16)));
+			auto x2 = byteSwap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + off + 32)));
+			auto x3 = byteSwap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + off + 48)));
+			auto lo = _mm_setzero_si128();
+			auto hi = _mm_setzero_si128();
+			clmulAccumulate(x0, h4, lo, hi);
+			clmulAccumulate(x1, h3, lo, hi);
+			clmulAccumulate(x2, h2, lo, hi);
+			clmulAccumulate(x3, h1, lo, hi);
+			y = ghashReduce(lo, hi);
+		}
+		for (; off < len; off += Block_Len) {
+			__m128i x;
+			if (off + Block_Len <= len) {
+				x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + off));
+			}
+			else {
+				alignas(16) uint8_t tail[16] = { 0 };
+				memcpy(tail, data + off, len - off);
+				x = _mm_load_si128(reinterpret_cast<const __m128i*>(tail));
+			}
+			y = ghashMulHardware(_mm_xor_si128(y, byteSwap(x)), h1);
+		}
+		return y;
+	}
+
+	/// <summary>
+	/// 硬件CTR的待加密分组
+	/// </summary>
+	struct CtrLane
+	{
+		/// <summary>输入，为nullptr时直接输出密钥流</summary>
+		const uint8_t* in;
+		/// <summary>输出</summary>
+		uint8_t*       out;
+		/// <summary>长度，不超过一个分组</summary>
+		std::size_t    len;
+	};
+
+	__VSNC_TARGET("aes,sse2")
+	void ctrFlush(const __m128i* keys, __m128i* blocks, const CtrLane* lanes, const std::size_t n) noexcept
+	{
+		for (std::size_t i = 0; i < n; ++i) {
+			blocks[i] = _mm_xor_si128(blocks[i], keys[0]);
+		}
+		for (int r = 1; r < Aes_Rounds; ++r) {
+			for (std::size_t i = 0; i < n; ++i) {
+				blocks[i] = _mm_aesenc_si128(blocks[i], keys[r]);
+			}
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			blocks[i] = _mm_aesenclast_si128(blocks[i], keys[Aes_Rounds]);
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			auto& lane = lanes[i];
+			if (!lane.in) {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(lane.out), blocks[i]);
+			}
+			else if (Block_Len == lane.len) {
+				auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lane.in));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(lane.out), _mm_xor_si128(x, blocks[i]));
+			}
+			else {
+				alignas(16) uint8_t ks[16];
+				_mm_store_si128(reinterpret_cast<__m128i*>(ks), blocks[i]);
+				for (std::size_t b = 0; b < lane.len; ++b) {
+					lane.out[b] = static_cast<uint8_t>(lane.in[b] ^ ks[b]);
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// 硬件CTR：把各数据包的J0与数据分组连成一串，每Lanes个分组并行加密一次
+	/// </summary>
+	__VSNC_TARGET("aes,sse4.1")
+	void ctrHardware(const uint8_t* round_keys, const vsnc::forwarder::AeadPacket* pkts, const std::size_t count, uint8_t* masks) noexcept
+	{
+		__m128i keys[Aes_Rounds + 1];
+		for (int r = 0; r <= Aes_Rounds; ++r) {
+			keys[r] = _mm_load_si128(reinterpret_cast<const __m128i*>(round_keys + 16 * r));
+		}
+		__m128i blocks[Lanes];
+		CtrLane lanes[Lanes];
+		std::size_t n = 0;
+		for (std::size_t p = 0; p < count; ++p) {
+			auto& pkt = pkts[p];
+			alignas(16) uint8_t j0[16];
+			counterBlock(j0, pkt.Nonce, 0);
+			auto base = _mm_load_si128(reinterpret_cast<const __m128i*>(j0));
+			auto nblock = (pkt.Len + Block_Len - 1) / Block_Len;
+			for (std::size_t k = 0; k <= nblock; ++k) {
+				auto ctr = static_cast<uint32_t>(k + 1);
+				blocks[n] = _mm_insert_epi32(base, static_cast<int>((ctr >> 24) | ((ctr >> 8) & 0xFF00) | ((ctr << 8) & 0xFF0000) | (ctr << 24)), 3);
+				if (0 == k) {
+					lanes[n] = { nullptr, masks + Block_Len * p, Block_Len };
+				}
+				else {
+					auto off = (k - 1) * Block_Len;
+					lanes[n] = { pkt.In + off, pkt.Out + off, (std::min)(Block_Len, pkt.Len - off) };
+				}
+				if (Lanes == ++n) {
+					ctrFlush(keys, blocks, lanes, n);
+					n = 0;
+				}
+			}
+		}
+		if (n) {
+			ctrFlush(keys, blocks, lanes, n);
+		}
+	}
+
+	/// <summary>
+	/// 检测CPU是否支持AES-NI、PCLMULQDQ、SSSE3与SSE4.1
+	/// </summary>
+	/// <returns>都支持返回true</returns>
+	bool detectAesNi() noexcept
+	{
+#ifdef _MSC_VER
+		int regs[4] = { 0 };
+		__cpuid(regs, 1);
+		auto c = static_cast<unsigned>(regs[2]);
+#else
+		unsigned a = 0, b = 0, c = 0, d = 0;
+		if (!__get_cpuid(1, &a, &b, &c, &d)) {
+			return false;
+		}
+#endif // _MSC_VER
+		constexpr unsigned need = (1u << 1) | (1u << 9) | (1u << 19) | (1u << 25);
+		return need == (c & need);
+	}
+#endif // __VSNC_AEAD_X86__
+
+	/// <summary>
+	/// 生成一个64字节的ChaCha20密钥流分组
+	/// </summary>
+	void chachaBlock(const uint32_t key[8], const uint32_t counter, const uint8_t* nonce, uint8_t out[64]) noexcept
+	{
+		uint32_t s[16] = {
+			0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+			key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+			counter, load32le(nonce), load32le(nonce + 4), load32le(nonce + 8),
+		};
+		uint32_t x[16];
+		memcpy(x, s, sizeof(x));
+		auto quarter = [&x](const int a, const int b, const int c, const int d) {
+			x[a] += x[b]; x[d] = rotl32(x[d] ^ x[a], 16);
+			x[c] += x[d]; x[b] = rotl32(x[b] ^ x[c], 12);
+			x[a] += x[b]; x[d] = rotl32(x[d] ^ x[a], 8);
+			x[c] += x[d]; x[b] = rotl32(x[b] ^ x[c], 7);
+		};
+		for (int i = 0; i < 10; ++i) {
+			quarter(0, 4, 8, 12);
+			quarter(1, 5, 9, 13);
+			quarter(2, 6, 10, 14);
+			quarter(3, 7, 11, 15);
+			quarter(0, 5, 10, 15);
+			quarter(1, 6, 11, 12);
+			quarter(2, 7, 8, 13);
+			quarter(3, 4, 9, 14);
+		}
+		for (int i = 0; i < 16; ++i) {
+			store32le(out + 4 * i, x[i] + s[i]);
+		}
+	}
+
+	void chachaXor(const uint32_t key[8], const uint8_t* nonce, const uint8_t* in, uint8_t* out, const std::size_t len) noexcept
+	{
+		uint8_t ks[64];
+		uint32_t counter = 1;
+		for (std::size_t off = 0; off < len; off += 64, ++counter) {
+			chachaBlock(key, counter, nonce, ks);
+			auto n = (std::min)(static_cast<std::size_t>(64), len - off);
+			for (std::size_t i = 0; i < n; ++i) {
+				out[off + i] = static_cast<uint8_t>(in[off + i] ^ ks[i]);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Poly1305，以26位为一个分量，乘积不超过64位
+	/// </summary>
+	class Poly1305
+	{
+	public:
+
+		explicit Poly1305(const uint8_t key[32]) noexcept
+		{
+			m_r[0] = load32le(key) & 0x3ffffff;
+			m_r[1] = (load32le(key + 3) >> 2) & 0x3ffff03;
+			m_r[2] = (load32le(key + 6) >> 4) & 0x3ffc0ff;
+			m_r[3] = (load32le(key + 9) >> 6) & 0x3f03fff;
+			m_r[4] = (load32le(key + 12) >> 8) & 0x00fffff;
+			for (int i = 0; i < 4; ++i) {
+				m_pad[i] = load32le(key + 16 + 4 * i);
+			}
+			memset(m_h, 0, sizeof(m_h));
+		}
+
+		/// <summary>
+		/// 输入数据，不足16字节的部分补0，即AEAD构造中的pad16
+		/// </summary>
+		void Update(const uint8_t* data, const std::size_t len) noexcept
+		{
+			std::size_t off = 0;
+			for (; off + 16 <= len; off += 16) {
+				_Block(data + off);
+			}
+			if (off < len) {
+				uint8_t tail[16] = { 0 };
+				memcpy(tail, data + off, len - off);
+				_Block(tail);
+			}
+		}
+
+		void Final(uint8_t tag[16]) noexcept
+		{
+			auto h0 = m_h[0], h1 = m_h[1], h2 = m_h[2], h3 = m_h[3], h4 = m_h[4];
+			uint32_t c = h1 >> 26; h1 &= 0x3ffffff;
+			h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+			h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+			h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+			h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+			h1 += c;
+			// 计算h + 5 - 2^130，不为负时取之
+			auto g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+			auto g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+			auto g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+			auto g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+			auto g4 = h4 + c - (1u << 26);
+			auto mask = (g4 >> 31) - 1;
+			h0 = (h0 & ~mask) | (g0 & mask);
+			h1 = (h1 & ~mask) | (g1 & mask);
+			h2 = (h2 & ~mask) | (g2 & mask);
+			h3 = (h3 & ~mask) | (g3 & mask);
+			h4 = (h4 & ~mask) | (g4 & mask);
+			uint32_t w[4] = {
+				h0 | (h1 << 26),
+				(h1 >> 6) | (h2 << 20),
+				(h2 >> 12) | (h3 << 14),
+				(h3 >> 18) | (h4 << 8),
+			};
+			uint64_t f = 0;
+			for (int i = 0; i < 4; ++i) {
+				f = static_cast<uint64_t>(w[i]) + m_pad[i] + (f >> 32);
+				store32le(tag + 4 * i, static_cast<uint32_t>(f));
+			}
+		}
+
+	private:
+
+		void _Block(const uint8_t* m) noexcept
+		{
+			auto r0 = m_r[0], r1 = m_r[1], r2 = m_r[2], r3 = m_r[3], r4 = m_r[4];
+			auto s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+			auto h0 = m_h[0] + (load32le(m) & 0x3ffffff);
+			auto h1 = m_h[1] + ((load32le(m + 3) >> 2) & 0x3ffffff);
+			auto h2 = m_h[2] + ((load32le(m + 6) >> 4) & 0x3ffffff);
+			auto h3 = m_h[3] + ((load32le(m + 9) >> 6) & 0x3ffffff);
+			auto h4 = m_h[4] + ((load32le(m + 12) >> 8) | (1u << 24));
+			auto mul = [](const uint32_t a, const uint32_t b) { return static_cast<uint64_t>(a) * b; };
+			auto d0 = mul(h0, r0) + mul(h1, s4) + mul(h2, s3) + mul(h3, s2) + mul(h4, s1);
+			auto d1 = mul(h0, r1) + mul(h1, r0) + mul(h2, s4) + mul(h3, s3) + mul(h4, s2);
+			auto d2 = mul(h0, r2) + mul(h1, r1) + mul(h2, r0) + mul(h3, s4) + mul(h4, s3);
+			auto d3 = mul(h0, r3) + mul(h1, r2) + mul(h2, r1) + mul(h3, r0) + mul(h4, s4);
+			auto d4 = mul(h0, r4) + mul(h1, r3) + mul(h2, r2) + mul(h3, r1) + mul(h4, r0);
+			uint32_t c = static_cast<uint32_t>(d0 >> 26); h0 = static_cast<uint32_t>(d0) & 0x3ffffff;
+			d1 += c; c = static_cast<uint32_t>(d1 >> 26); h1 = static_cast<uint32_t>(d1) & 0x3ffffff;
+			d2 += c; c = static_cast<uint32_t>(d2 >> 26); h2 = static_cast<uint32_t>(d2) & 0x3ffffff;
+			d3 += c; c = static_cast<uint32_t>(d3 >> 26); h3 = static_cast<uint32_t>(d3) & 0x3ffffff;
+			d4 += c; c = static_cast<uint32_t>(d4 >> 26); h4 = static_cast<uint32_t>(d4) & 0x3ffffff;
+			h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+			h1 += c;
+			m_h[0] = h0; m_h[1] = h1; m_h[2] = h2; m_h[3] = h3; m_h[4] = h4;
+		}
+
+	private:
+
+		uint32_t m_r[5];
+		uint32_t m_h[5];
+		uint32_t m_pad[4];
+	};
+}
+
+
+vsnc::forwarder::Aead::Aead(const aead_cipher cipher, const uint8_t* const key) noexcept :
+	m_eCipher((aead_cipher::AUTO == cipher) ? (Accelerated() ? aead_cipher::AES_256_GCM : aead_cipher::CHACHA20_POLY1305) : cipher),
+	m_bHardware((aead_cipher::AES_256_GCM == m_eCipher) && Accelerated())
+{
+	aesExpand256(key, m_iWords);
+	for (int i = 0; i < 60; ++i) {
+		store32be(m_iRoundKeys + 4 * i, m_iWords[i]);
+	}
+	uint8_t h[16] = { 0 };
+	aesEncryptTable(m_iWords, h, h);
+	ghashTableInit(h, m_iHigh, m_iLow);
+	memset(m_iPowers, 0, sizeof(m_iPowers));
+#ifdef __VSNC_AEAD_X86__
+	if (m_bHardware) {
+		ghashPowers(h, m_iPowers);
+	}
+#endif // __VSNC_AEAD_X86__
+	for (int i = 0; i < 8; ++i) {
+		m_iChaChaKey[i] = load32le(key + 4 * i);
+	}
+}
+
+
+bool vsnc::forwarder::Aead::Open(const AeadPacket& pkt) const noexcept
+{
+	bool ok = false;
+	OpenBatch(&pkt, 1, &ok);
+	return ok;
+}
+
+
+void vsnc::forwarder::Aead::SealBatch(const AeadPacket* const pkts, const std::size_t count) const noexcept
+{
+	if (aead_cipher::CHACHA20_POLY1305 == m_eCipher) {
+		for (std::size_t p = 0; p < count; ++p) {
+			chachaXor(m_iChaChaKey, pkts[p].Nonce, pkts[p].In, pkts[p].Out, pkts[p].Len);
+			_ChaChaTag(pkts[p], pkts[p].Out, pkts[p].Tag);
+		}
+		return;
+	}
+	// 先加密再对密文计算GHASH，因此In与Out相同时也能原地加密
+	uint8_t masks[Lanes * Block_Len];
+	for (std::size_t base = 0; base < count; base += Lanes) {
+		auto n = (std::min)(Lanes, count - base);
+		_GcmCtr(pkts + base, n, masks);
+		for (std::size_t p = 0; p < n; ++p) {
+			_GcmTag(pkts[base + p], pkts[base + p].Out, masks + Block_Len * p, pkts[base + p].Tag);
+		}
+	}
+}
+
+
+std::size_t vsnc::forwarder::Aead::OpenBatch(const AeadPacket* const pkts, const std::size_t count, bool* const ok) const noexcept
+{
+	std::size_t passed = 0;
+	uint8_t tag[Tag_Len];
+	if (aead_cipher::CHACHA20_POLY1305 == m_eCipher) {
+		for (std::size_t p = 0; p < count; ++p) {
+			_ChaChaTag(pkts[p], pkts[p].In, tag);
+			auto good = __aead_equal(tag, pkts[p].Tag, Tag_Len);
+			if (good) {
+				chachaXor(m_iChaChaKey, pkts[p].Nonce, pkts[p].In, pkts[p].Out, pkts[p].Len);
+				++passed;
+			}
+			if (ok) {
+				ok[p] = good;
+			}
+		}
+		return passed;
+	}
+	// 先对密文计算GHASH，再解密；标签在解密后比较，未通过时Out的内容无意义
+	uint8_t masks[Lanes * Block_Len];
+	uint8_t hashes[Lanes * Block_Len];
+	const uint8_t zero[Block_Len] = { 0 };
+	for (std::size_t base = 0; base < count; base += Lanes) {
+		auto n = (std::min)(Lanes, count - base);
+		for (std::size_t p = 0; p < n; ++p) {
+			_GcmTag(pkts[base + p], pkts[base + p].In, zero, hashes + Block_Len * p);
+		}
+		_GcmCtr(pkts + base, n, masks);
+		for (std::size_t p = 0; p < n; ++p) {
+			for (std::size_t i = 0; i < Tag_Len; ++i) {
+				tag[i] = static_cast<uint8_t>(hashes[Block_Len * p + i] ^ masks[Block_Len * p + i]);
+			}
+			auto good = __aead_equal(tag, pkts[base + p].Tag, Tag_Len);
+			passed += good ? 1 : 0;
+			if (ok) {
+				ok[base + p] = good;
+			}
+		}
+	}
+	return passed;
+}
+
+
+const char* vsnc::forwarder::Aead::Name() const noexcept
+{
+	if (aead_cipher::CHACHA20_POLY1305 == m_eCipher) {
+		return "chacha20-poly1305";
+	}
+	return m_bHardware ? "aes-256-gcm/aes-ni" : "aes-256-gcm/table";
+}
+
+
+bool vsnc::forwarder::Aead::Accelerated() noexcept
+{
+#ifdef __VSNC_AEAD_X86__
+	static const bool available = detectAesNi();
+	return available;
+#else
+	return false;
+#endif // __VSNC_AEAD_X86__
+}
+
+
+void vsnc::forwarder::Aead::_GcmTag(const AeadPacket& pkt, const uint8_t* const ct, const uint8_t* const mask, uint8_t* const tag) const noexcept
+{
+	uint8_t lens[Block_Len];
+	store64be(lens, static_cast<uint64_t>(pkt.AadLen) * 8);
+	store64be(lens + 8, static_cast<uint64_t>(pkt.Len) * 8);
+	uint8_t y[Block_Len] = { 0 };
+#ifdef __VSNC_AEAD_X86__
+	if (m_bHardware) {
+		auto acc = _mm_setzero_si128();
+		acc = ghashHardware(acc, pkt.Aad, pkt.AadLen, m_iPowers);
+		acc = ghashHardware(acc, ct, pkt.Len, m_iPowers);
+		acc = ghashHardware(acc, lens, Block_Len, m_iPowers);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y), byteSwap(acc));
+	}
+	else
+#endif // __VSNC_AEAD_X86__
+	{
+		ghashTable(y, pkt.Aad, pkt.AadLen, m_iHigh, m_iLow);
+		ghashTable(y, ct, pkt.Len, m_iHigh, m_iLow);
+		ghashTable(y, lens, Block_Len, m_iHigh, m_iLow);
+	}
+	for (std::size_t i = 0; i < Tag_Len; ++i) {
+		tag[i] = static_cast<uint8_t>(y[i] ^ mask[i]);
+	}
+}
+
+
+void vsnc::forwarder::Aead::_GcmCtr(const AeadPacket* const pkts, const std::size_t count, uint8_t* const masks) const noexcept
+{
+#ifdef __VSNC_AEAD_X86__
+	if (m_bHardware) {
+		ctrHardware(m_iRoundKeys, pkts, count, masks);
+		return;
+	}
+#endif // __VSNC_AEAD_X86__
+	uint8_t ctr[Block_Len];
+	uint8_t ks[Block_Len];
+	for (std::size_t p = 0; p < count; ++p) {
+		auto& pkt = pkts[p];
+		counterBlock(ctr, pkt.Nonce, 1);
+		aesEncryptTable(m_iWords, ctr, masks + Block_Len * p);
+		for (std::size_t off = 0; off < pkt.Len; off += Block_Len) {
+			counterBlock(ctr, pkt.Nonce, static_cast<uint32_t>(off / Block_Len + 2));
+			aesEncryptTable(m_iWords, ctr, ks);
+			auto n = (std::min)(Block_Len, pkt.Len - off);
+			for (std::size_t i = 0; i < n; ++i) {
+				pkt.Out[off + i] = static_cast<uint8_t>(pkt.In[off + i] ^ ks[i]);
+			}
+		}
+	}
+}
+
+
+void vsnc::forwarder::Aead::_ChaChaTag(const AeadPacket& pkt, const uint8_t* const ct, uint8_t* const tag) const noexcept
+{
+	uint8_t block[64];
+	chachaBlock(m_iChaChaKey, 0, pkt.Nonce, block);
+	Poly1305 mac(block);
+	mac.Update(pkt.Aad, pkt.AadLen);
+	mac.Update(ct, pkt.Len);
+	uint8_t lens[16];
+	store64le(lens, static_cast<uint64_t>(pkt.AadLen));
+	store64le(lens + 8, static_cast<uint64_t>(pkt.Len));
+	mac.Update(lens, sizeof(lens));
+	mac.Final(tag);
+}
+
+
+bool vsnc::forwarder::__aead_equal(const uint8_t* const a, const uint8_t* const b, const std::size_t len) noexcept
+{
+	uint8_t diff = 0;
+	for (std::size_t i = 0; i < len; ++i) {
+		diff |= static_cast<uint8_t>(a[i] ^ b[i]);
+	}
+	return 0 == diff;
+}
@@ -0,0 +1,193 @@
+﻿/************************************************************************
+ * @ObjectName: aead.h
+ * @Description: 带关联数据的认证加密（AES-256-GCM与ChaCha20-Poly1305）
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_AEAD_H__
+#define __VSNC_FORWARDER_AEAD_H__
+
+
+#include <cstddef>
+
+
+#include <stdint.h>
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>认证加密算法</summary>
+		enum class aead_cipher : uint8_t
+		{
+			AUTO              = 0, // CPU支持AES-NI与PCLMULQDQ时选AES_256_GCM，否则选CHACHA20_POLY1305
+			AES_256_GCM       = 1, // AES-256-GCM
+			CHACHA20_POLY1305 = 2, // ChaCha20-Poly1305（RFC 8439）
+		};
+
+
+		/// <summary>
+		/// <para>一次加密或解密的数据包</para>
+		/// <para>In与Out可以指向同一缓冲区以原地加解密，但不能部分重叠</para>
+		/// </summary>
+		struct AeadPacket
+		{
+			/// <summary>Nonce_Len字节的随机数，同一密钥下不得重复</summary>
+			const uint8_t* Nonce  = nullptr;
+			/// <summary>只认证不加密的关联数据</summary>
+			const uint8_t* Aad    = nullptr;
+			/// <summary>关联数据长度</summary>
+			std::size_t    AadLen = 0;
+			/// <summary>输入的明文或密文</summary>
+			const uint8_t* In     = nullptr;
+			/// <summary>输出的密文或明文</summary>
+			uint8_t*       Out    = nullptr;
+			/// <summary>明文与密文的长度</summary>
+			std::size_t    Len    = 0;
+			/// <summary>Tag_Len字节的认证标签，加密时写入，解密时读取</summary>
+			uint8_t*       Tag    = nullptr;
+		};
+
+
+		/// <summary>
+		/// <para>认证加密上下文</para>
+		/// <para>AES-256-GCM在CPU支持AES-NI与PCLMULQDQ时以硬件指令计算，每批最多8个分组并行加密、GHASH每4个分组合并一次约减；否则退化为查表实现，结果一致</para>
+		/// <para>ChaCha20-Poly1305为可移植的标量实现，作为没有AES-NI时的首选</para>
+		/// <para>构造后只读，可在多个线程中同时使用</para>
+		/// </summary>
+		class Aead
+		{
+		public:
+
+			/// <summary>密钥长度</summary>
+			static constexpr std::size_t Key_Len   = 32;
+			/// <summary>随机数长度</summary>
+			static constexpr std::size_t Nonce_Len = 12;
+			/// <summary>认证标签长度</summary>
+			static constexpr std::size_t Tag_Len   = 16;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="cipher">算法，AUTO按CPU选择</param>
+			/// <param name="key">Key_Len字节的密钥</param>
+			Aead(const aead_cipher cipher, const uint8_t* const key) noexcept;
+
+			/// <summary>
+			/// 加密并计算认证标签
+			/// </summary>
+			/// <param name="pkt">数据包</param>
+			void               Seal(const AeadPacket& pkt) const noexcept { SealBatch(&pkt, 1); }
+
+			/// <summary>
+			/// 校验认证标签并解密
+			/// </summary>
+			/// <param name="pkt">数据包</param>
+			/// <returns>校验通过返回true，否则Out的内容无意义</returns>
+			bool               Open(const AeadPacket& pkt) const noexcept;
+
+			/// <summary>
+			/// <para>批量加密</para>
+			/// <para>硬件AES-GCM将各数据包的计数器分组连成一串并行加密，小数据包也能填满流水线</para>
+			/// </summary>
+			/// <param name="pkts">数据包数组</param>
+			/// <param name="count">数据包个数</param>
+			void               SealBatch(const AeadPacket* const pkts, const std::size_t count) const noexcept;
+
+			/// <summary>
+			/// 批量校验并解密
+			/// </summary>
+			/// <param name="pkts">数据包数组</param>
+			/// <param name="count">数据包个数</param>
+			/// <param name="ok">各数据包是否校验通过，可为nullptr</param>
+			/// <returns>校验通过的数据包个数</returns>
+			std::size_t        OpenBatch(const AeadPacket* const pkts, const std::size_t count, bool* const ok) const noexcept;
+
+			/// <summary>
+			/// 获取算法
+			/// </summary>
+			/// <returns>算法，不会是AUTO</returns>
+			aead_cipher        Cipher() const noexcept { return m_eCipher; }
+
+			/// <summary>
+			/// 获取实现名
+			/// </summary>
+			/// <returns>"aes-256-gcm/aes-ni"、"aes-256-gcm/table"或"chacha20-poly1305"</returns>
+			const char*        Name() const noexcept;
+
+			/// <summary>
+			/// 判断CPU是否支持AES-NI与PCLMULQDQ
+			/// </summary>
+			/// <returns>支持返回true</returns>
+			static bool        Accelerated() noexcept;
+
+		private:
+
+			/// <summary>
+			/// 计算GCM的GHASH并与加密的J0异或得到标签
+			/// </summary>
+			/// <param name="pkt">数据包</param>
+			/// <param name="ct">密文</param>
+			/// <param name="mask">加密的J0</param>
+			/// <param name="tag">输出的标签</param>
+			void               _GcmTag(const AeadPacket& pkt, const uint8_t* const ct, const uint8_t* const mask, uint8_t* const tag) const noexcept;
+
+			/// <summary>
+			/// 以CTR模式处理一批数据包，同时生成各数据包的加密J0
+			/// </summary>
+			/// <param name="pkts">数据包数组</param>
+			/// <param name="count">数据包个数</param>
+			/// <param name="masks">输出的加密J0，每个数据包16字节</param>
+			void               _GcmCtr(const AeadPacket* const pkts, const std::size_t count, uint8_t* const masks) const noexcept;
+
+			/// <summary>
+			/// 计算ChaCha20-Poly1305的标签
+			/// </summary>
+			/// <param name="pkt">数据包</param>
+			/// <param name="ct">密文</param>
+			/// <param name="tag">输出的标签</param>
+			void               _ChaChaTag(const AeadPacket& pkt, const uint8_t* const ct, uint8_t* const tag) const noexcept;
+
+		private:
+
+			/// <summary>算法</summary>
+			aead_cipher m_eCipher;
+			/// <summary>是否使用AES-NI与PCLMULQDQ</summary>
+			bool        m_bHardware;
+			/// <summary>AES-256的轮密钥</summary>
+			alignas(16) uint8_t  m_iRoundKeys[15 * 16];
+			/// <summary>查表实现使用的大端序轮密钥</summary>
+			uint32_t    m_iWords[60];
+			/// <summary>硬件GHASH使用的H^1..H^4，字节逆序存放</summary>
+			alignas(16) uint8_t  m_iPowers[4 * 16];
+			/// <summary>查表GHASH使用的乘H表的高64位</summary>
+			uint64_t    m_iHigh[16];
+			/// <summary>查表GHASH使用的乘H表的低64位</summary>
+			uint64_t    m_iLow[16];
+			/// <summary>ChaCha20的密钥</summary>
+			uint32_t    m_iChaChaKey[8];
+		};
+
+
+		/// <summary>
+		/// 常数时间比较，用于比较认证标签
+		/// </summary>
+		/// <param name="a">数据</param>
+		/// <param name="b">数据</param>
+		/// <param name="len">长度</param>
+		/// <returns>相等返回true</returns>
+		bool __aead_equal(const uint8_t* const a, const uint8_t* const b, const std::size_t len) noexcept;
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_AEAD_H__
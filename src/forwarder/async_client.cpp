@@ -0,0 +1,79 @@
+﻿/************************************************************************
+ * @ObjectName: async_client.cpp
+ * @Description: P2P客户端与传输层的协程接口，连接与接收以co_await等待
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "async_client.h"
+
+
+#include <vsnc_utils/utils.h>
+
+
+vsnc::forwarder::ReceiveAwaiter::ReceiveAwaiter(EventLoop& loop, Transport& lower, utils::Memory<char>& mem, int64_t& ts, const int64_t timeout) :
+	m_iLoop(loop),
+	m_iLower(lower),
+	m_iMem(mem),
+	m_nTs(ts),
+	m_nTimeout(timeout),
+	m_nResult(-2)
+{
+	m_nDeadline = (timeout < 0) ? -1 : (utils::__steady() + timeout);
+}
+
+
+bool vsnc::forwarder::ReceiveAwaiter::Poll(const int64_t wait)
+{
+	auto ret = m_iLower.Receive(m_iMem, m_nTs, wait);
+	if (-2 == ret) {
+		return false;
+	}
+	m_nResult = ret;
+	return true;
+}
+
+
+vsnc::forwarder::ConnectAwaiter::ConnectAwaiter(EventLoop& loop, punch::Client& client, const uint64_t peer, const int64_t timeout) :
+	m_iLoop(loop),
+	m_iClient(client),
+	m_uPeer(peer),
+	m_nTimeout(timeout),
+	m_eResult(p2p::vsnc_p2p_state::FREE)
+{
+}
+
+
+bool vsnc::forwarder::ConnectAwaiter::Poll(const int64_t wait)
+{
+	m_iClient.Pump();
+	m_eResult = m_iClient.GetState();
+	return (p2p::vsnc_p2p_state::REQUESTING != m_eResult) && (p2p::vsnc_p2p_state::CONNECTING != m_eResult);
+}
+
+
+void vsnc::forwarder::ConnectAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+	m_nDeadline = (m_nTimeout < 0) ? -1 : (utils::__steady() + m_nTimeout);
+	m_iClient.Connect(m_uPeer);
+	m_eResult = p2p::vsnc_p2p_state::REQUESTING;
+	m_iLoop.Watch(*this, h);
+}
+
+
+vsnc::forwarder::StateAwaiter::StateAwaiter(EventLoop& loop, punch::Client& client, const p2p::vsnc_p2p_state state, const int64_t timeout) :
+	m_iLoop(loop),
+	m_iClient(client),
+	m_eState(state),
+	m_nTimeout(timeout),
+	m_eResult(state)
+{
+	m_nDeadline = (timeout < 0) ? -1 : (utils::__steady() + timeout);
+}
+
+
+bool vsnc::forwarder::StateAwaiter::Poll(const int64_t wait)
+{
+	m_iClient.Pump();
+	m_eResult = m_iClient.GetState();
+	return m_eState != m_eResult;
+}
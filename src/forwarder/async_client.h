@@ -0,0 +1,279 @@
+﻿/************************************************************************
+ * @ObjectName: async_client.h
+ * @Description: P2P客户端与传输层的协程接口，连接与接收以co_await等待
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_ASYNC_CLIENT_H__
+#define __VSNC_FORWARDER_ASYNC_CLIENT_H__
+
+
+#include <coroutine>
+
+
+#include <stdint.h>
+
+
+#include <p2p/client.h>
+#include <vsnc_utils/memory.h>
+
+
+#include "transport.h"
+#include "event_loop.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// <para>接收数据的等待对象，co_await的结果与Transport::Receive的返回值相同</para>
+		/// <para>已有数据时不挂起协程</para>
+		/// </summary>
+		class ReceiveAwaiter final : public Poller
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="loop">事件循环</param>
+			/// <param name="lower">传输</param>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则不超时</param>
+			ReceiveAwaiter(EventLoop& loop, Transport& lower, utils::Memory<char>& mem, int64_t& ts, const int64_t timeout);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			ReceiveAwaiter(const ReceiveAwaiter&) = delete;
+
+			bool    Poll(const int64_t wait) override;
+			bool    Blocking() const noexcept override { return true; }
+			int     Handle(int64_t& next) noexcept override { return m_iLower.Handle(next); }
+
+			bool    await_ready() { return Poll(0) || (0 == m_nTimeout); }
+			void    await_suspend(std::coroutine_handle<> h) { m_iLoop.Watch(*this, h); }
+			ssize_t await_resume() const noexcept { return m_nResult; }
+
+		private:
+
+			/// <summary>事件循环</summary>
+			EventLoop&           m_iLoop;
+			/// <summary>传输</summary>
+			Transport&           m_iLower;
+			/// <summary>接收缓冲区</summary>
+			utils::Memory<char>& m_iMem;
+			/// <summary>接收到的数据时间戳</summary>
+			int64_t&             m_nTs;
+			/// <summary>超时时间</summary>
+			const int64_t        m_nTimeout;
+			/// <summary>接收结果，超时为-2</summary>
+			ssize_t              m_nResult;
+		};
+
+
+		/// <summary>
+		/// <para>发起连接并等待结果的等待对象</para>
+		/// <para>co_await的结果为连接结束时的状态：CONNECTED为成功，FREE或OFFLINE为失败；超时时为REQUESTING或CONNECTING</para>
+		/// </summary>
+		class ConnectAwaiter final : public Poller
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="loop">事件循环</param>
+			/// <param name="client">P2P客户端</param>
+			/// <param name="peer">对端序列号</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则以客户端内部的5秒超时为准</param>
+			ConnectAwaiter(EventLoop& loop, punch::Client& client, const uint64_t peer, const int64_t timeout);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			ConnectAwaiter(const ConnectAwaiter&) = delete;
+
+			bool                Poll(const int64_t wait) override;
+			int                 Handle(int64_t& next) noexcept override { return m_iClient.Handle(next); }
+
+			bool                await_ready() const noexcept { return false; }
+			void                await_suspend(std::coroutine_handle<> h);
+			p2p::vsnc_p2p_state await_resume() const noexcept { return m_eResult; }
+
+		private:
+
+			/// <summary>事件循环</summary>
+			EventLoop&          m_iLoop;
+			/// <summary>P2P客户端</summary>
+			punch::Client&      m_iClient;
+			/// <summary>对端序列号</summary>
+			const uint64_t      m_uPeer;
+			/// <summary>超时时间</summary>
+			const int64_t       m_nTimeout;
+			/// <summary>最近一次采样的状态</summary>
+			p2p::vsnc_p2p_state m_eResult;
+		};
+
+
+		/// <summary>
+		/// <para>等待客户端离开指定状态的等待对象，co_await的结果为最近一次采样的状态</para>
+		/// <para>客户端由调用者驱动时在等待期间驱动客户端，例如等待注册完成</para>
+		/// </summary>
+		class StateAwaiter final : public Poller
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="loop">事件循环</param>
+			/// <param name="client">P2P客户端</param>
+			/// <param name="state">等待离开的状态</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则不超时</param>
+			StateAwaiter(EventLoop& loop, punch::Client& client, const p2p::vsnc_p2p_state state, const int64_t timeout);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			StateAwaiter(const StateAwaiter&) = delete;
+
+			bool                Poll(const int64_t wait) override;
+			int                 Handle(int64_t& next) noexcept override { return m_iClient.Handle(next); }
+
+			bool                await_ready() { return Poll(0) || (0 == m_nTimeout); }
+			void                await_suspend(std::coroutine_handle<> h) { m_iLoop.Watch(*this, h); }
+			p2p::vsnc_p2p_state await_resume() const noexcept { return m_eResult; }
+
+		private:
+
+			/// <summary>事件循环</summary>
+			EventLoop&                m_iLoop;
+			/// <summary>P2P客户端</summary>
+			punch::Client&            m_iClient;
+			/// <summary>等待离开的状态</summary>
+			const p2p::vsnc_p2p_state m_eState;
+			/// <summary>超时时间</summary>
+			const int64_t             m_nTimeout;
+			/// <summary>最近一次采样的状态</summary>
+			p2p::vsnc_p2p_state       m_eResult;
+		};
+
+
+		/// <summary>
+		/// 以协程方式接收数据
+		/// </summary>
+		/// <param name="loop">事件循环</param>
+		/// <param name="lower">传输</param>
+		/// <param name="mem">接收缓冲区</param>
+		/// <param name="ts">接收到的数据时间戳</param>
+		/// <param name="timeout">以毫秒为单位的超时时间，小于0则不超时</param>
+		/// <returns>等待对象，结果与Transport::Receive的返回值相同</returns>
+		inline ReceiveAwaiter ReceiveAsync(EventLoop& loop, Transport& lower, utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1)
+		{
+			return ReceiveAwaiter(loop, lower, mem, ts, timeout);
+		}
+
+
+		/// <summary>
+		/// 以协程方式等待客户端离开指定状态
+		/// </summary>
+		/// <param name="loop">事件循环</param>
+		/// <param name="client">P2P客户端</param>
+		/// <param name="state">等待离开的状态</param>
+		/// <param name="timeout">以毫秒为单位的超时时间，小于0则不超时</param>
+		/// <returns>等待对象，结果为最近一次采样的状态</returns>
+		inline StateAwaiter LeaveAsync(EventLoop& loop, punch::Client& client, const p2p::vsnc_p2p_state state, const int64_t timeout = -1)
+		{
+			return StateAwaiter(loop, client, state, timeout);
+		}
+
+
+		/// <summary>
+		/// <para>P2P客户端的协程接口</para>
+		/// <para>co_await client.ConnectAsync(peer)发起连接并等待结果，co_await client.ReceiveAsync(mem, ts)等待数据，发送本身不阻塞因此直接调用</para>
+		/// </summary>
+		class AsyncClient
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="loop">事件循环</param>
+			/// <param name="client">P2P客户端</param>
+			AsyncClient(EventLoop& loop, punch::Client& client) noexcept : m_iLoop(loop), m_iLink(client), m_pClient(&client) {}
+
+			/// <summary>
+			/// 更换底层客户端，在客户端被重建后调用
+			/// </summary>
+			/// <param name="client">P2P客户端</param>
+			void            Reset(punch::Client& client) noexcept { m_iLink.Reset(client); m_pClient = &client; }
+
+			/// <summary>
+			/// 向对端发起连接
+			/// </summary>
+			/// <param name="peer">对端序列号</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则以客户端内部的5秒超时为准</param>
+			/// <returns>等待对象，结果为连接结束时的状态</returns>
+			ConnectAwaiter  ConnectAsync(const uint64_t peer, const int64_t timeout = -1) { return ConnectAwaiter(m_iLoop, *m_pClient, peer, timeout); }
+
+			/// <summary>
+			/// 等待客户端离开指定状态
+			/// </summary>
+			/// <param name="state">等待离开的状态</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则不超时</param>
+			/// <returns>等待对象，结果为最近一次采样的状态</returns>
+			StateAwaiter    LeaveAsync(const p2p::vsnc_p2p_state state, const int64_t timeout = -1) { return StateAwaiter(m_iLoop, *m_pClient, state, timeout); }
+
+			/// <summary>
+			/// 接收数据
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则不超时</param>
+			/// <returns>等待对象，成功返回接收到的字节数，失败返回-1，超时返回-2</returns>
+			ReceiveAwaiter  ReceiveAsync(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) { return ReceiveAwaiter(m_iLoop, m_iLink, mem, ts, timeout); }
+
+			/// <summary>
+			/// 发送数据
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回发送的字节数，失败返回-1</returns>
+			ssize_t         Send(const utils::Memory<char>& mem, const int64_t ts) { return m_iLink.Send(mem, ts); }
+
+			/// <summary>
+			/// 获取客户端状态
+			/// </summary>
+			/// <returns>客户端状态</returns>
+			p2p::vsnc_p2p_state GetState() const noexcept { return m_pClient->GetState(); }
+
+			/// <summary>
+			/// 获取作为传输的客户端，供叠加协议层
+			/// </summary>
+			/// <returns>传输</returns>
+			Transport&      Link() noexcept { return m_iLink; }
+
+		private:
+
+			/// <summary>事件循环</summary>
+			EventLoop&      m_iLoop;
+			/// <summary>以客户端为底层的传输</summary>
+			ClientTransport m_iLink;
+			/// <summary>P2P客户端</summary>
+			punch::Client*  m_pClient;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_ASYNC_CLIENT_H__
@@ -0,0 +1,265 @@
+﻿/************************************************************************
+ * @ObjectName: clock_sync.cpp
+ * @Description: 估计对端时钟的偏差与漂移，得到校正后的单向时延
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "clock_sync.h"
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+
+#include <vsnc_utils/clock.h>
+
+
+#include "wire.h"
+
+
+namespace
+{
+	/// <summary>数据报类型：数据</summary>
+	constexpr char        Kind_Data     = 0;
+	/// <summary>数据报类型：探测请求，携带t1</summary>
+	constexpr char        Kind_Request  = 1;
+	/// <summary>数据报类型：探测应答，携带t1、t2、t3</summary>
+	constexpr char        Kind_Response = 2;
+	/// <summary>探测请求长度</summary>
+	constexpr std::size_t Request_Len   = 9;
+	/// <summary>探测应答长度</summary>
+	constexpr std::size_t Response_Len  = 25;
+	/// <summary>拟合漂移所需的最少样本个数</summary>
+	constexpr std::size_t Min_Fit       = 4;
+
+	/// <summary>
+	/// 获取以微秒为单位的单调时间，用于超时与探测间隔
+	/// </summary>
+	/// <returns>以微秒为单位的单调时间</returns>
+	int64_t steadyMicroseconds()
+	{
+		return vsnc::utils::__tsc_ns() / 1000;
+	}
+
+	/// <summary>
+	/// <para>获取以微秒为单位的系统时间，与__utc()同一时钟</para>
+	/// <para>数据包的ts由对端以__utc()打上，探测的时间戳必须取自同一时钟，估计出的偏差才能直接用于ts</para>
+	/// </summary>
+	/// <returns>以微秒为单位的系统时间</returns>
+	int64_t utcMicroseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+}
+
+
+constexpr std::size_t vsnc::forwarder::ClockSyncTransport::Header_Len;
+
+
+vsnc::forwarder::ClockSyncTransport::ClockSyncTransport(Transport& lower, const ClockSyncOptions& opts) :
+	m_iLower(lower),
+	m_iOpts(opts),
+	m_nProbeAt(0),
+	m_dRefAt(0.0),
+	m_dRefOffset(0.0),
+	m_dDrift(0.0),
+	m_dLastDelay(0.0),
+	m_dDelaySum(0.0),
+	m_uDelayed(0),
+	m_iRecvBuf(opts.Mtu)
+{
+	m_iSendBuf.reserve(opts.Mtu);
+}
+
+
+ssize_t vsnc::forwarder::ClockSyncTransport::Send(const utils::Memory<char>& mem, const int64_t ts)
+{
+	m_iSendBuf.resize(Header_Len + mem.Length());
+	m_iSendBuf[0] = Kind_Data;
+	memcpy(m_iSendBuf.data() + Header_Len, mem.Data(), mem.Length());
+	utils::BasicMemory<char> out(m_iSendBuf.data(), m_iSendBuf.size());
+	if (m_iLower.Send(out, ts) < 0) {
+		return -1;
+	}
+	return static_cast<ssize_t>(mem.Length());
+}
+
+
+ssize_t vsnc::forwarder::ClockSyncTransport::Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout)
+{
+	auto start = steadyMicroseconds();
+	while (true) {
+		Poll();
+		auto now = steadyMicroseconds();
+		auto elapsed = (now - start) / 1000;
+		// 不阻塞超过下一次探测的时间，以便按时探测
+		auto due = (std::max)((m_nProbeAt - now + 999) / 1000, static_cast<int64_t>(0));
+		auto wait = (timeout < 0) ? due : (std::min)((std::max)(timeout - elapsed, static_cast<int64_t>(0)), due);
+		utils::BasicMemory<char> buf(m_iRecvBuf.data(), m_iRecvBuf.size());
+		auto ret = m_iLower.Receive(buf, ts, wait);
+		now = steadyMicroseconds();
+		auto stamp = utcMicroseconds();
+		auto expired = (timeout >= 0) && ((now - start) / 1000 >= timeout);
+		if (-2 == ret) {
+			if (expired) {
+				return ret;
+			}
+			continue;
+		}
+		if (ret <= 0) {
+			return ret;
+		}
+		auto p = m_iRecvBuf.data();
+		auto len = static_cast<std::size_t>(ret);
+		if (Kind_Data == p[0]) {
+			auto n = len - Header_Len;
+			if (n > mem.Length()) {
+				return -1;
+			}
+			memcpy(mem.Data(), p + Header_Len, n);
+			++m_iStats.Received;
+			if (Synced()) {
+				m_dLastDelay = OneWayDelay(ts);
+				m_dDelaySum += m_dLastDelay;
+				if (!m_uDelayed++ || (m_dLastDelay < m_iStats.MinDelay)) {
+					m_iStats.MinDelay = m_dLastDelay;
+				}
+				m_iStats.MaxDelay = (std::max)(m_iStats.MaxDelay, m_dLastDelay);
+			}
+			return static_cast<ssize_t>(n);
+		}
+		if ((Kind_Request == p[0]) && (len >= Request_Len)) {
+			// t2为收到请求的时间，t3为发出应答的时间
+			char resp[Response_Len];
+			resp[0] = Kind_Response;
+			memcpy(resp + 1, p + 1, 8);
+			__put_u64(resp + 9, static_cast<uint64_t>(stamp));
+			__put_u64(resp + 17, static_cast<uint64_t>(utcMicroseconds()));
+			utils::BasicMemory<char> out(resp, sizeof(resp));
+			m_iLower.Send(out, 0);
+		}
+		else if ((Kind_Response == p[0]) && (len >= Response_Len)) {
+			auto t1 = static_cast<int64_t>(__get_u64(p + 1));
+			auto t2 = static_cast<int64_t>(__get_u64(p + 9));
+			auto t3 = static_cast<int64_t>(__get_u64(p + 17));
+			// 本端在t1与t4之间调整系统时间时往返时延失真，负值直接丢弃，偏大的由最小往返时延滤波滤除
+			auto rtt = (stamp - t1) - (t3 - t2);
+			if ((t1 <= stamp) && (rtt >= 0)) {
+				__sample s;
+				s.at = stamp;
+				s.offset = ((t2 - t1) + (t3 - stamp)) / 2;
+				s.rtt = rtt;
+				_Update(s);
+			}
+		}
+		if (expired) {
+			return -2;
+		}
+	}
+}
+
+
+void vsnc::forwarder::ClockSyncTransport::Poll()
+{
+	auto now = steadyMicroseconds();
+	if (now < m_nProbeAt) {
+		return;
+	}
+	m_nProbeAt = now + m_iOpts.Interval * 1000;
+	char req[Request_Len];
+	req[0] = Kind_Request;
+	__put_u64(req + 1, static_cast<uint64_t>(utcMicroseconds()));
+	utils::BasicMemory<char> out(req, sizeof(req));
+	if (m_iLower.Send(out, 0) >= 0) {
+		++m_iStats.Probes;
+	}
+}
+
+
+int64_t vsnc::forwarder::ClockSyncTransport::ToLocal(const int64_t ts) const noexcept
+{
+	if (!Synced()) {
+		return ts;
+	}
+	return ts - _Offset(utcMicroseconds()) / 1000;
+}
+
+
+double vsnc::forwarder::ClockSyncTransport::OneWayDelay(const int64_t ts) const noexcept
+{
+	auto now = utcMicroseconds();
+	return static_cast<double>(now - (ts * 1000 - _Offset(now))) / 1000.0;
+}
+
+
+vsnc::forwarder::ClockSyncStats vsnc::forwarder::ClockSyncTransport::GetStats() const noexcept
+{
+	auto stats = m_iStats;
+	stats.Offset = _Offset(utcMicroseconds());
+	stats.Drift = m_dDrift * 1e6;
+	stats.Rtt = m_iHistory.empty() ? 0 : m_iHistory.back().rtt;
+	stats.AvgDelay = m_uDelayed ? (m_dDelaySum / static_cast<double>(m_uDelayed)) : 0.0;
+	return stats;
+}
+
+
+int64_t vsnc::forwarder::ClockSyncTransport::_Offset(const int64_t now) const noexcept
+{
+	if (m_iHistory.empty()) {
+		return 0;
+	}
+	return static_cast<int64_t>(m_dRefOffset + m_dDrift * (static_cast<double>(now) - m_dRefAt));
+}
+
+
+void vsnc::forwarder::ClockSyncTransport::_Update(const __sample& s)
+{
+	++m_iStats.Samples;
+	// 偏差远超往返时延所能解释的范围，说明某端的系统时间发生了跳变，旧样本不再可用
+	if (!m_iHistory.empty() && (std::abs(s.offset - _Offset(s.at)) > m_iOpts.Step * 1000 + s.rtt)) {
+		++m_iStats.Steps;
+		m_iWindow.clear();
+		m_iHistory.clear();
+	}
+	m_iWindow.push_back(s);
+	while (m_iWindow.size() > (std::max)(m_iOpts.Window, static_cast<std::size_t>(1))) {
+		m_iWindow.pop_front();
+	}
+	// 往返时延最小的样本受排队影响最小，其偏差最可信
+	auto best = *std::min_element(m_iWindow.begin(), m_iWindow.end(), [](const __sample& lhs, const __sample& rhs) {
+		return lhs.rtt < rhs.rtt;
+	});
+	if (!m_iHistory.empty() && (m_iHistory.back().at == best.at)) {
+		return;
+	}
+	m_iHistory.push_back(best);
+	while (m_iHistory.size() > (std::max)(m_iOpts.History, static_cast<std::size_t>(1))) {
+		m_iHistory.pop_front();
+	}
+	// 以样本均值为参考点做最小二乘拟合，样本不足时只取最新的偏差
+	double mt = 0.0, mo = 0.0;
+	for (auto& h : m_iHistory) {
+		mt += static_cast<double>(h.at);
+		mo += static_cast<double>(h.offset);
+	}
+	mt /= static_cast<double>(m_iHistory.size());
+	mo /= static_cast<double>(m_iHistory.size());
+	if (m_iHistory.size() < Min_Fit) {
+		m_dRefAt = static_cast<double>(best.at);
+		m_dRefOffset = static_cast<double>(best.offset);
+		m_dDrift = 0.0;
+		return;
+	}
+	double sxy = 0.0, sxx = 0.0;
+	for (auto& h : m_iHistory) {
+		auto dx = static_cast<double>(h.at) - mt;
+		sxy += dx * (static_cast<double>(h.offset) - mo);
+		sxx += dx * dx;
+	}
+	auto limit = m_iOpts.MaxDrift * 1e-6;
+	m_dDrift = (sxx > 0.0) ? (std::max)(-limit, (std::min)(limit, sxy / sxx)) : 0.0;
+	m_dRefAt = mt;
+	m_dRefOffset = mo;
+}
@@ -0,0 +1,234 @@
+﻿/************************************************************************
+ * @ObjectName: clock_sync.h
+ * @Description: 估计对端时钟的偏差与漂移，得到校正后的单向时延
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_CLOCK_SYNC_H__
+#define __VSNC_FORWARDER_CLOCK_SYNC_H__
+
+
+#include <vector>
+#include <deque>
+
+
+#include <stdint.h>
+
+
+#include "transport.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 时钟同步参数
+		/// </summary>
+		struct ClockSyncOptions
+		{
+			/// <summary>以毫秒为单位的探测间隔</summary>
+			int64_t     Interval = 1000;
+			/// <summary>最小往返时延滤波的样本个数</summary>
+			std::size_t Window   = 8;
+			/// <summary>拟合漂移所用的滤波后样本个数</summary>
+			std::size_t History  = 32;
+			/// <summary>以ppm为单位的漂移上限，拟合结果超出时截断</summary>
+			double      MaxDrift = 500.0;
+			/// <summary>以毫秒为单位的跳变阈值，样本偏差偏离拟合值超过该值与其往返时延之和时，视为某端调整了系统时间，丢弃此前的样本重新估计</summary>
+			int64_t     Step     = 20;
+			/// <summary>下层单个数据报的最大长度</summary>
+			std::size_t Mtu      = 1504;
+		};
+
+
+		/// <summary>
+		/// 时钟同步统计信息
+		/// </summary>
+		struct ClockSyncStats
+		{
+			/// <summary>以微秒为单位的当前偏差，对端时钟减本地时钟</summary>
+			int64_t  Offset   = 0;
+			/// <summary>以ppm为单位的漂移，对端时钟相对本地时钟每秒多走的微秒数</summary>
+			double   Drift    = 0.0;
+			/// <summary>以微秒为单位的滤波后往返时延</summary>
+			int64_t  Rtt      = 0;
+			/// <summary>发出的探测个数</summary>
+			uint64_t Probes   = 0;
+			/// <summary>收到的探测应答个数</summary>
+			uint64_t Samples  = 0;
+			/// <summary>检测到的系统时间跳变次数</summary>
+			uint64_t Steps    = 0;
+			/// <summary>收到的数据包个数</summary>
+			uint64_t Received = 0;
+			/// <summary>以毫秒为单位的校正后单向时延平均值</summary>
+			double   AvgDelay = 0.0;
+			/// <summary>以毫秒为单位的校正后单向时延最小值</summary>
+			double   MinDelay = 0.0;
+			/// <summary>以毫秒为单位的校正后单向时延最大值</summary>
+			double   MaxDelay = 0.0;
+		};
+
+
+		/// <summary>
+		/// <para>时钟同步传输层</para>
+		/// <para>Receive得到的ts是发送端的时钟，直接与本地时间相减混入了两端的时钟偏差；本层以NTP方式周期性交换时间戳（t1..t4）估计偏差，</para>
+		/// <para>在最近Window个样本中取往返时延最小者以滤除排队抖动，再对滤波后的样本做最小二乘拟合得到漂移，使偏差在两次探测之间也能外推</para>
+		/// <para>每个数据报前附加1字节的类型，对端需同样经本层收发；探测的时间戳与数据包的ts同为系统时钟（__utc()），前者精确到微秒，后者为毫秒</para>
+		/// <para>任一端调整系统时间后，下一次探测即发现偏差跳变并丢弃此前的样本，偏差立即更新，漂移在其后积累足够样本后重新拟合</para>
+		/// <para>非线程安全，应在同一线程中使用</para>
+		/// </summary>
+		class ClockSyncTransport final : public Transport
+		{
+		public:
+
+			/// <summary>类型头长度</summary>
+			static constexpr std::size_t Header_Len = 1;
+
+		private:
+
+			/// <summary>
+			/// 一次探测的结果
+			/// </summary>
+			struct __sample
+			{
+				/// <summary>以微秒为单位的本地收到应答的时间</summary>
+				int64_t at;
+				/// <summary>以微秒为单位的偏差</summary>
+				int64_t offset;
+				/// <summary>以微秒为单位的往返时延</summary>
+				int64_t rtt;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数，首次调用Poll或Receive时发出第一个探测
+			/// </summary>
+			/// <param name="lower">下层传输</param>
+			/// <param name="opts">同步参数</param>
+			explicit ClockSyncTransport(Transport& lower, const ClockSyncOptions& opts = ClockSyncOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			ClockSyncTransport(const ClockSyncTransport&) = delete;
+
+			/// <summary>
+			/// 发送数据
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">以毫秒为单位的发送端时间戳</param>
+			/// <returns>成功返回数据长度，失败返回-1</returns>
+			ssize_t        Send(const utils::Memory<char>& mem, const int64_t ts) override;
+
+			/// <summary>
+			/// 接收数据，同时应答对端的探测并处理己方探测的应答
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">以毫秒为单位的发送端时间戳，未经校正</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，失败返回-1，超时返回-2</returns>
+			ssize_t        Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override;
+
+			/// <summary>
+			/// 获取下层等待可读的套接字
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的最迟须再次调用Receive的时间</param>
+			/// <returns>套接字，不支持时返回-1</returns>
+			int            Handle(int64_t& next) noexcept override { return m_iLower.Handle(next); }
+
+			/// <summary>
+			/// 到达探测间隔时发出探测
+			/// </summary>
+			void           Poll();
+
+			/// <summary>
+			/// 判断是否已得到至少一个样本
+			/// </summary>
+			/// <returns>已同步返回true</returns>
+			bool           Synced() const noexcept { return !m_iHistory.empty(); }
+
+			/// <summary>
+			/// 将对端时间戳换算到本地时钟
+			/// </summary>
+			/// <param name="ts">以毫秒为单位的对端时间戳</param>
+			/// <returns>以毫秒为单位的本地时间戳，未同步时原样返回</returns>
+			int64_t        ToLocal(const int64_t ts) const noexcept;
+
+			/// <summary>
+			/// 计算校正后的单向时延
+			/// </summary>
+			/// <param name="ts">以毫秒为单位的对端时间戳</param>
+			/// <returns>以毫秒为单位的单向时延</returns>
+			double         OneWayDelay(const int64_t ts) const noexcept;
+
+			/// <summary>
+			/// 获取最近收到的数据包的校正后单向时延
+			/// </summary>
+			/// <returns>以毫秒为单位的单向时延，尚未同步时为0</returns>
+			double         LastDelay() const noexcept { return m_dLastDelay; }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			ClockSyncStats GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 估计指定本地时间的偏差
+			/// </summary>
+			/// <param name="now">以微秒为单位的本地时间</param>
+			/// <returns>以微秒为单位的偏差</returns>
+			int64_t        _Offset(const int64_t now) const noexcept;
+
+			/// <summary>
+			/// 加入一个样本并重新拟合
+			/// </summary>
+			/// <param name="s">样本</param>
+			void           _Update(const __sample& s);
+
+		private:
+
+			/// <summary>下层传输</summary>
+			Transport&             m_iLower;
+			/// <summary>同步参数</summary>
+			const ClockSyncOptions m_iOpts;
+			/// <summary>以微秒为单位的下一次探测时间</summary>
+			int64_t                m_nProbeAt;
+			/// <summary>最近的原始样本</summary>
+			std::deque<__sample>   m_iWindow;
+			/// <summary>滤波后的样本</summary>
+			std::deque<__sample>   m_iHistory;
+			/// <summary>以微秒为单位的拟合直线的参考时间</summary>
+			double                 m_dRefAt;
+			/// <summary>以微秒为单位的拟合直线在参考时间的偏差</summary>
+			double                 m_dRefOffset;
+			/// <summary>拟合的漂移，即偏差对本地时间的斜率</summary>
+			double                 m_dDrift;
+			/// <summary>以毫秒为单位的最近一个数据包的单向时延</summary>
+			double                 m_dLastDelay;
+			/// <summary>以毫秒为单位的单向时延累计值</summary>
+			double                 m_dDelaySum;
+			/// <summary>计入单向时延的数据包个数</summary>
+			uint64_t               m_uDelayed;
+			/// <summary>发送缓冲区</summary>
+			std::vector<char>      m_iSendBuf;
+			/// <summary>接收缓冲区</summary>
+			std::vector<char>      m_iRecvBuf;
+			/// <summary>统计信息</summary>
+			ClockSyncStats         m_iStats;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_CLOCK_SYNC_H__
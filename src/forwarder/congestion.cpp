@@ -0,0 +1,474 @@
+﻿/************************************************************************
+ * @ObjectName: congestion.cpp
+ * @Description: 基于时延梯度的拥塞控制与按估计带宽整形的传输层
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "congestion.h"
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+
+#include "wire.h"
+
+
+namespace
+{
+	/// <summary>数据报类型：数据</summary>
+	constexpr char        Kind_Data       = 0;
+	/// <summary>数据报类型：反馈</summary>
+	constexpr char        Kind_Feedback   = 1;
+	/// <summary>反馈头长度</summary>
+	constexpr std::size_t Feedback_Header = 4;
+	/// <summary>每个反馈项的长度</summary>
+	constexpr std::size_t Feedback_Item   = 6;
+	/// <summary>发送记录的个数，须为2的幂</summary>
+	constexpr std::size_t History_Len     = 4096;
+	/// <summary>以微秒为单位的包组时长</summary>
+	constexpr int64_t     Group_Span      = 5000;
+	/// <summary>线性回归窗口长度</summary>
+	constexpr std::size_t Trend_Window    = 20;
+	/// <summary>以微秒为单位的确认速率统计窗口</summary>
+	constexpr int64_t     Acked_Window    = 500000;
+	/// <summary>以微秒为单位的两次降速的最小间隔</summary>
+	constexpr int64_t     Decrease_Gap    = 200000;
+
+	int64_t nowMicroseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+
+vsnc::forwarder::CongestionController::CongestionController(const CongestionOptions& opts) :
+	m_iOpts(opts),
+	m_iHistory(History_Len),
+	m_nSentSeq(-1),
+	m_nAckedSeq(-1),
+	m_uLastRaw(0),
+	m_nArrival(-1),
+	m_dAccDelay(0.0),
+	m_dSmoothed(0.0),
+	m_uDeltas(0),
+	m_dPrevSlope(0.0),
+	m_dOverTime(-1.0),
+	m_uOverCount(0),
+	m_nThresholdAt(-1),
+	m_uAckedBytes(0),
+	m_dRate(static_cast<double>(opts.StartRate)),
+	m_nUpdateAt(-1),
+	m_nDecreaseAt(-1),
+	m_nFeedbackAt(-1)
+{
+	m_iStats.Threshold = 12.5;
+}
+
+
+void vsnc::forwarder::CongestionController::OnSent(const uint16_t seq, const std::size_t size, const int64_t now)
+{
+	m_nSentSeq = (m_nSentSeq < 0) ? seq : (m_nSentSeq + static_cast<int16_t>(seq - static_cast<uint16_t>(m_nSentSeq)));
+	auto& h = m_iHistory[static_cast<std::size_t>(m_nSentSeq) & (History_Len - 1)];
+	h.seq = m_nSentSeq;
+	h.time = now;
+	h.size = size;
+	if (m_nFeedbackAt < 0) {
+		m_nFeedbackAt = now;
+	}
+}
+
+
+void vsnc::forwarder::CongestionController::OnFeedback(const std::vector<feedback_type>& items, const int64_t now)
+{
+	++m_iStats.Feedbacks;
+	m_nFeedbackAt = now;
+	if (m_nSentSeq < 0) {
+		return;
+	}
+	auto highest = m_nAckedSeq;
+	std::size_t fresh = 0;
+	for (auto& item : items) {
+		auto seq = m_nSentSeq + static_cast<int16_t>(item.first - static_cast<uint16_t>(m_nSentSeq));
+		auto& h = m_iHistory[static_cast<std::size_t>(seq) & (History_Len - 1)];
+		if ((seq < 0) || (h.seq != seq)) {
+			continue;
+		}
+		if (m_nArrival < 0) {
+			m_nArrival = 0;
+			m_nAckedSeq = seq - 1;
+			highest = m_nAckedSeq;
+		}
+		else {
+			m_nArrival += static_cast<int32_t>(item.second - m_uLastRaw);
+		}
+		m_uLastRaw = item.second;
+		m_iAcked.emplace_back(m_nArrival, h.size);
+		m_uAckedBytes += h.size;
+		if (seq > m_nAckedSeq) {
+			++fresh;
+			highest = (std::max)(highest, seq);
+		}
+		_Arrive(h, m_nArrival);
+	}
+
+	// 以本次新确认的序号区间估计丢包率，乱序迟到的确认不计入
+	if (highest > m_nAckedSeq) {
+		auto expected = static_cast<double>(highest - m_nAckedSeq);
+		auto sample = (std::max)(0.0, 1.0 - static_cast<double>(fresh) / expected);
+		m_iStats.Loss = 0.8 * m_iStats.Loss + 0.2 * sample;
+		m_nAckedSeq = highest;
+	}
+	while (!m_iAcked.empty() && (m_nArrival - m_iAcked.front().first > Acked_Window)) {
+		m_uAckedBytes -= m_iAcked.front().second;
+		m_iAcked.pop_front();
+	}
+	// 统计时长不足半个窗口时估计值偏差大，暂不更新
+	auto span = m_iAcked.empty() ? 0 : (m_nArrival - m_iAcked.front().first);
+	if (span >= Acked_Window / 2) {
+		m_iStats.AckedRate = static_cast<uint64_t>(static_cast<double>(m_uAckedBytes) * 1000000.0 / static_cast<double>(span));
+	}
+	_Update(now);
+}
+
+
+void vsnc::forwarder::CongestionController::OnTick(const int64_t now)
+{
+	if ((m_nSentSeq < 0) || (m_nFeedbackAt < 0)) {
+		return;
+	}
+	auto& last = m_iHistory[static_cast<std::size_t>(m_nSentSeq) & (History_Len - 1)];
+	auto timeout = m_iOpts.FeedbackTimeout * 1000;
+	// 有数据发出却长时间收不到反馈，视为反馈通道拥塞或中断
+	if ((last.time > m_nFeedbackAt) && (now - m_nFeedbackAt > timeout) && ((m_nDecreaseAt < 0) || (now - m_nDecreaseAt > timeout))) {
+		m_dRate = (std::max)(m_dRate / 2.0, static_cast<double>(m_iOpts.MinRate));
+		m_nDecreaseAt = now;
+		++m_iStats.Timeouts;
+	}
+}
+
+
+vsnc::forwarder::CongestionStats vsnc::forwarder::CongestionController::GetStats() const noexcept
+{
+	auto stats = m_iStats;
+	stats.Rate = Rate();
+	return stats;
+}
+
+
+void vsnc::forwarder::CongestionController::_Arrive(const __sent& sent, const int64_t arrival)
+{
+	if (m_iGroup.first < 0) {
+		m_iGroup.first = sent.time;
+		m_iGroup.send = sent.time;
+		m_iGroup.arrival = arrival;
+		return;
+	}
+	if (sent.time < m_iGroup.first) {
+		return;
+	}
+	if (sent.time - m_iGroup.first <= Group_Span) {
+		m_iGroup.send = (std::max)(m_iGroup.send, sent.time);
+		m_iGroup.arrival = (std::max)(m_iGroup.arrival, arrival);
+		return;
+	}
+	if (m_iPrevGroup.first >= 0) {
+		_Detect(m_iGroup.send - m_iPrevGroup.send, m_iGroup.arrival - m_iPrevGroup.arrival, m_iGroup.arrival);
+	}
+	m_iPrevGroup = m_iGroup;
+	m_iGroup.first = sent.time;
+	m_iGroup.send = sent.time;
+	m_iGroup.arrival = arrival;
+}
+
+
+void vsnc::forwarder::CongestionController::_Detect(const int64_t sendDelta, const int64_t arrivalDelta, const int64_t arrival)
+{
+	m_uDeltas = (std::min)(m_uDeltas + 1, static_cast<std::size_t>(1000));
+	m_dAccDelay += static_cast<double>(arrivalDelta - sendDelta) / 1000.0;
+	m_dSmoothed = 0.9 * m_dSmoothed + 0.1 * m_dAccDelay;
+	m_iTrend.emplace_back(static_cast<double>(arrival) / 1000.0, m_dSmoothed);
+	if (m_iTrend.size() > Trend_Window) {
+		m_iTrend.pop_front();
+	}
+
+	// 对窗口内的(到达时间, 平滑累积时延)做最小二乘回归，斜率即排队时延的增长速度
+	auto slope = m_dPrevSlope;
+	if (m_iTrend.size() == Trend_Window) {
+		double sx = 0.0, sy = 0.0;
+		for (auto& pt : m_iTrend) {
+			sx += pt.first;
+			sy += pt.second;
+		}
+		auto mx = sx / Trend_Window;
+		auto my = sy / Trend_Window;
+		double num = 0.0, den = 0.0;
+		for (auto& pt : m_iTrend) {
+			num += (pt.first - mx) * (pt.second - my);
+			den += (pt.first - mx) * (pt.first - mx);
+		}
+		if (den > 0.0) {
+			slope = num / den;
+		}
+	}
+	auto trend = static_cast<double>((std::min)(m_uDeltas, static_cast<std::size_t>(60))) * slope * 4.0;
+	auto& threshold = m_iStats.Threshold;
+	m_iStats.Trend = trend;
+
+	if (trend > threshold) {
+		m_dOverTime = (m_dOverTime < 0.0) ? (static_cast<double>(sendDelta) / 2.0) : (m_dOverTime + static_cast<double>(sendDelta));
+		++m_uOverCount;
+		if ((m_dOverTime > 10000.0) && (m_uOverCount > 1) && (slope >= m_dPrevSlope)) {
+			m_iStats.Usage = bandwidth_usage::OVERUSING;
+			m_dOverTime = 0.0;
+			m_uOverCount = 0;
+		}
+	}
+	else {
+		m_iStats.Usage = (trend < -threshold) ? bandwidth_usage::UNDERUSING : bandwidth_usage::NORMAL;
+		m_dOverTime = -1.0;
+		m_uOverCount = 0;
+	}
+	m_dPrevSlope = slope;
+
+	// 自适应阈值：偏离较大时缓慢上调以容忍并发TCP流，偏离较小时较快回落
+	auto magnitude = std::fabs(trend);
+	if ((m_nThresholdAt >= 0) && (magnitude <= threshold + 15.0)) {
+		auto k = (magnitude < threshold) ? 0.039 : 0.0087;
+		auto dt = (std::min)(static_cast<double>(arrival - m_nThresholdAt) / 1000.0, 100.0);
+		threshold += k * (magnitude - threshold) * dt;
+		threshold = (std::min)((std::max)(threshold, 6.0), 600.0);
+	}
+	m_nThresholdAt = arrival;
+}
+
+
+void vsnc::forwarder::CongestionController::_Update(const int64_t now)
+{
+	auto dt = (m_nUpdateAt < 0) ? 0 : (std::min)(now - m_nUpdateAt, static_cast<int64_t>(1000000));
+	m_nUpdateAt = now;
+	auto acked = static_cast<double>(m_iStats.AckedRate);
+	auto canDecrease = (m_nDecreaseAt < 0) || (now - m_nDecreaseAt >= Decrease_Gap);
+	switch (m_iStats.Usage)
+	{
+	case bandwidth_usage::OVERUSING:
+		if (canDecrease) {
+			m_dRate = 0.85 * ((acked > 0.0) ? (std::min)(acked, m_dRate) : m_dRate);
+			m_nDecreaseAt = now;
+			++m_iStats.Overuses;
+			canDecrease = false;
+		}
+		break;
+	case bandwidth_usage::UNDERUSING:
+		break;
+	default:
+		m_dRate *= std::pow(1.08, static_cast<double>(dt) / 1000000.0);
+		if (acked > 0.0) {
+			// 应用发送不足时确认速率偏低，不让估计值无限上涨
+			m_dRate = (std::min)(m_dRate, 1.5 * acked + 16.0 * 1024);
+		}
+		break;
+	}
+	if ((m_iStats.Loss > 0.1) && canDecrease) {
+		m_dRate *= 1.0 - 0.5 * m_iStats.Loss;
+		m_nDecreaseAt = now;
+	}
+	m_dRate = (std::min)((std::max)(m_dRate, static_cast<double>(m_iOpts.MinRate)), static_cast<double>(m_iOpts.MaxRate));
+}
+
+
+constexpr std::size_t vsnc::forwarder::CongestionTransport::Header_Len;
+
+
+vsnc::forwarder::CongestionTransport::CongestionTransport(Transport& lower, const CongestionOptions& opts, const std::size_t mtu) :
+	m_iLower(lower),
+	m_iOpts(opts),
+	m_uMtu(mtu),
+	m_iController(opts),
+	m_uSeq(0),
+	m_iRecvBuf(mtu),
+	m_nFeedbackAt(0),
+	m_nNow(0)
+{
+	PacerOptions pace_opts;
+	pace_opts.Rate = opts.StartRate;
+	pace_opts.Burst = opts.Burst;
+	pace_opts.QueueLimit = opts.QueueLimit;
+	m_uSession = m_iPacer.AddSession([this](const utils::Memory<char>& mem) {
+		return _Transmit(mem);
+	}, pace_opts);
+	m_iPackBuf.reserve(mtu);
+	m_iSendBuf.reserve(mtu);
+}
+
+
+ssize_t vsnc::forwarder::CongestionTransport::Send(const utils::Memory<char>& mem, const int64_t ts)
+{
+	if (Header_Len + mem.Length() > m_uMtu) {
+		return -1;
+	}
+	m_nNow = nowMicroseconds();
+	m_iPackBuf.resize(Header_Len + mem.Length());
+	auto p = m_iPackBuf.data();
+	p[0] = Kind_Data;
+	p[1] = 0;
+	__put_u16(p + 2, 0);
+	__put_u64(p + 4, static_cast<uint64_t>(ts));
+	memcpy(p + Header_Len, mem.Data(), mem.Length());
+	utils::BasicMemory<char> pkt(m_iPackBuf.data(), m_iPackBuf.size());
+	if (!m_iPacer.Enqueue(m_uSession, pkt, m_nNow)) {
+		return -1;
+	}
+	return static_cast<ssize_t>(mem.Length());
+}
+
+
+ssize_t vsnc::forwarder::CongestionTransport::Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout)
+{
+	auto start = nowMicroseconds();
+	while (true) {
+		Poll();
+		auto elapsed = (m_nNow - start) / 1000;
+		auto wait = (timeout < 0) ? timeout : (std::max)(timeout - elapsed, static_cast<int64_t>(0));
+		// 有待发送的数据包或反馈时缩短等待，以免整形与反馈被阻塞的接收耽误
+		auto next = NextRelease();
+		if ((next >= 0) && ((wait < 0) || (next < wait))) {
+			wait = next;
+		}
+		utils::BasicMemory<char> buf(m_iRecvBuf.data(), m_iRecvBuf.size());
+		int64_t rts = 0;
+		auto ret = m_iLower.Receive(buf, rts, wait);
+		auto now = nowMicroseconds();
+		auto expired = (timeout >= 0) && ((now - start) / 1000 >= timeout);
+		if (-2 == ret) {
+			if (expired) {
+				return ret;
+			}
+			continue;
+		}
+		if (ret <= 0) {
+			return ret;
+		}
+		auto len = _Input(static_cast<std::size_t>(ret), mem, ts, now);
+		if (0 != len) {
+			return len;
+		}
+		if (expired) {
+			return -2;
+		}
+	}
+}
+
+
+void vsnc::forwarder::CongestionTransport::Poll()
+{
+	m_nNow = nowMicroseconds();
+	m_iController.OnTick(m_nNow);
+	m_iPacer.SetRate(m_uSession, m_iController.Rate(), m_nNow);
+	m_iPacer.Flush(m_nNow);
+	_Feedback(m_nNow, false);
+}
+
+
+int vsnc::forwarder::CongestionTransport::Handle(int64_t& next) noexcept
+{
+	auto sock = m_iLower.Handle(next);
+	if (sock < 0) {
+		return sock;
+	}
+	auto release = NextRelease();
+	if (release >= 0) {
+		next = (std::min)(next, nowMicroseconds() / 1000 + release);
+	}
+	return sock;
+}
+
+
+int64_t vsnc::forwarder::CongestionTransport::NextRelease() const noexcept
+{
+	auto now = nowMicroseconds();
+	auto next = m_iPacer.NextRelease(now);
+	if (next >= 0) {
+		next = (next + 999) / 1000;
+	}
+	if (!m_iPending.empty()) {
+		auto due = (std::max)(m_iOpts.FeedbackInterval - (now - m_nFeedbackAt) / 1000, static_cast<int64_t>(0));
+		next = (next < 0) ? due : (std::min)(next, due);
+	}
+	return next;
+}
+
+
+ssize_t vsnc::forwarder::CongestionTransport::_Transmit(const utils::Memory<char>& mem)
+{
+	m_iSendBuf.assign(mem.Data(), mem.Data() + mem.Length());
+	auto p = m_iSendBuf.data();
+	__put_u16(p + 2, m_uSeq);
+	utils::BasicMemory<char> out(m_iSendBuf.data(), m_iSendBuf.size());
+	auto ret = m_iLower.Send(out, static_cast<int64_t>(__get_u64(p + 4)));
+	if (ret >= 0) {
+		m_iController.OnSent(m_uSeq, m_iSendBuf.size(), m_nNow);
+		++m_uSeq;
+	}
+	return ret;
+}
+
+
+ssize_t vsnc::forwarder::CongestionTransport::_Input(const std::size_t len, utils::Memory<char>& mem, int64_t& ts, const int64_t now)
+{
+	auto p = m_iRecvBuf.data();
+	if ((Kind_Data == p[0]) && (len >= Header_Len)) {
+		auto n = len - Header_Len;
+		if (n > mem.Length()) {
+			return -1;
+		}
+		m_iPending.emplace_back(__get_u16(p + 2), static_cast<uint32_t>(now));
+		memcpy(mem.Data(), p + Header_Len, n);
+		ts = static_cast<int64_t>(__get_u64(p + 4));
+		_Feedback(now, m_iPending.size() >= (m_uMtu - Feedback_Header) / Feedback_Item);
+		return static_cast<ssize_t>(n);
+	}
+	if ((Kind_Feedback == p[0]) && (len >= Feedback_Header)) {
+		std::size_t cnt = __get_u16(p + 2);
+		if (len < Feedback_Header + cnt * Feedback_Item) {
+			return 0;
+		}
+		std::vector<CongestionController::feedback_type> items(cnt);
+		for (std::size_t i = 0; i < cnt; ++i) {
+			auto item = p + Feedback_Header + i * Feedback_Item;
+			items[i].first = __get_u16(item);
+			items[i].second = __get_u32(item + 2);
+		}
+		m_iController.OnFeedback(items, now);
+		m_iPacer.SetRate(m_uSession, m_iController.Rate(), now);
+	}
+	return 0;
+}
+
+
+void vsnc::forwarder::CongestionTransport::_Feedback(const int64_t now, const bool force)
+{
+	if (m_iPending.empty() || (!force && (now - m_nFeedbackAt < m_iOpts.FeedbackInterval * 1000))) {
+		return;
+	}
+	auto per = (m_uMtu - Feedback_Header) / Feedback_Item;
+	for (std::size_t i = 0; i < m_iPending.size(); i += per) {
+		auto cnt = (std::min)(per, m_iPending.size() - i);
+		m_iSendBuf.resize(Feedback_Header + cnt * Feedback_Item);
+		auto p = m_iSendBuf.data();
+		p[0] = Kind_Feedback;
+		p[1] = 0;
+		__put_u16(p + 2, static_cast<uint16_t>(cnt));
+		for (std::size_t j = 0; j < cnt; ++j) {
+			auto item = p + Feedback_Header + j * Feedback_Item;
+			__put_u16(item, m_iPending[i + j].first);
+			__put_u32(item + 2, m_iPending[i + j].second);
+		}
+		utils::BasicMemory<char> out(m_iSendBuf.data(), m_iSendBuf.size());
+		m_iLower.Send(out, 0);
+	}
+	m_iPending.clear();
+	m_nFeedbackAt = now;
+}
@@ -0,0 +1,392 @@
+﻿/************************************************************************
+ * @ObjectName: congestion.h
+ * @Description: 基于时延梯度的拥塞控制与按估计带宽整形的传输层
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_CONGESTION_H__
+#define __VSNC_FORWARDER_CONGESTION_H__
+
+
+#include <vector>
+#include <deque>
+#include <utility>
+
+
+#include <stdint.h>
+
+
+#include "transport.h"
+#include "pacer.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 链路使用状态
+		/// </summary>
+		enum class bandwidth_usage : int8_t
+		{
+			/// <summary>正常</summary>
+			NORMAL,
+			/// <summary>排队时延在减小</summary>
+			UNDERUSING,
+			/// <summary>排队时延在增大</summary>
+			OVERUSING
+		};
+
+
+		/// <summary>
+		/// 拥塞控制参数
+		/// </summary>
+		struct CongestionOptions
+		{
+			/// <summary>以字节每秒为单位的初始速率</summary>
+			uint64_t    StartRate        = 256 * 1024;
+			/// <summary>以字节每秒为单位的最低速率</summary>
+			uint64_t    MinRate          = 32 * 1024;
+			/// <summary>以字节每秒为单位的最高速率</summary>
+			uint64_t    MaxRate          = 16 * 1024 * 1024;
+			/// <summary>以字节为单位的整形允许突发量</summary>
+			std::size_t Burst            = 16 * 1024;
+			/// <summary>整形队列的数据包个数上限</summary>
+			std::size_t QueueLimit       = 1024;
+			/// <summary>以毫秒为单位的接收端反馈间隔</summary>
+			int64_t     FeedbackInterval = 50;
+			/// <summary>以毫秒为单位的反馈超时时间，超时后速率减半</summary>
+			int64_t     FeedbackTimeout  = 1000;
+		};
+
+
+		/// <summary>
+		/// 拥塞控制统计信息
+		/// </summary>
+		struct CongestionStats
+		{
+			/// <summary>以字节每秒为单位的当前估计带宽</summary>
+			uint64_t        Rate      = 0;
+			/// <summary>以字节每秒为单位的对端确认收到的速率</summary>
+			uint64_t        AckedRate = 0;
+			/// <summary>平滑后的丢包率</summary>
+			double          Loss      = 0.0;
+			/// <summary>放大后的时延梯度</summary>
+			double          Trend     = 0.0;
+			/// <summary>自适应的过载判定阈值</summary>
+			double          Threshold = 0.0;
+			/// <summary>当前链路使用状态</summary>
+			bandwidth_usage Usage     = bandwidth_usage::NORMAL;
+			/// <summary>因过载而降速的次数</summary>
+			uint64_t        Overuses  = 0;
+			/// <summary>收到的反馈个数</summary>
+			uint64_t        Feedbacks = 0;
+			/// <summary>反馈超时次数</summary>
+			uint64_t        Timeouts  = 0;
+		};
+
+
+		/// <summary>
+		/// <para>基于时延梯度的拥塞控制器（GCC风格）</para>
+		/// <para>发送端记录每个数据包的发送时间，根据接收端反馈的到达时间计算包组间的单向时延变化，以线性回归的斜率与自适应阈值比较判定过载</para>
+		/// <para>速率按AIMD调整：正常时每秒乘性增加8%，过载时降至确认速率的85%，丢包率超过10%时按丢包率降速</para>
+		/// <para>只使用到达时间之差，不要求两端时钟同步</para>
+		/// </summary>
+		class CongestionController
+		{
+		public:
+
+			/// <summary>反馈中的一项：序号与以微秒为单位的到达时间（低32位）</summary>
+			using feedback_type = std::pair<uint16_t, uint32_t>;
+
+		private:
+
+			/// <summary>
+			/// 发送记录
+			/// </summary>
+			struct __sent
+			{
+				/// <summary>扩展后的序号，未使用时为-1</summary>
+				int64_t     seq  = -1;
+				/// <summary>以微秒为单位的发送时间</summary>
+				int64_t     time = 0;
+				/// <summary>数据包长度</summary>
+				std::size_t size = 0;
+			};
+
+			/// <summary>
+			/// 包组，发送时间相差不超过5毫秒的数据包视为一组
+			/// </summary>
+			struct __group
+			{
+				/// <summary>组内首个数据包的发送时间</summary>
+				int64_t first   = -1;
+				/// <summary>组内最后一个数据包的发送时间</summary>
+				int64_t send    = 0;
+				/// <summary>组内最后一个数据包的到达时间</summary>
+				int64_t arrival = 0;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="opts">拥塞控制参数</param>
+			explicit CongestionController(const CongestionOptions& opts = CongestionOptions());
+
+			/// <summary>
+			/// 记录发出的数据包
+			/// </summary>
+			/// <param name="seq">序号</param>
+			/// <param name="size">数据包长度</param>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			void            OnSent(const uint16_t seq, const std::size_t size, const int64_t now);
+
+			/// <summary>
+			/// 处理接收端的反馈并更新估计带宽
+			/// </summary>
+			/// <param name="items">按到达顺序排列的反馈项</param>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			void            OnFeedback(const std::vector<feedback_type>& items, const int64_t now);
+
+			/// <summary>
+			/// 检查反馈是否超时，超时则降速
+			/// </summary>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			void            OnTick(const int64_t now);
+
+			/// <summary>
+			/// 获取当前估计带宽
+			/// </summary>
+			/// <returns>以字节每秒为单位的估计带宽</returns>
+			uint64_t        Rate() const noexcept { return static_cast<uint64_t>(m_dRate); }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			CongestionStats GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 输入一个到达的数据包，包组结束时更新时延梯度
+			/// </summary>
+			/// <param name="sent">发送记录</param>
+			/// <param name="arrival">扩展后的到达时间</param>
+			void            _Arrive(const __sent& sent, const int64_t arrival);
+
+			/// <summary>
+			/// 以两个包组之间的时延变化更新趋势并判定链路状态
+			/// </summary>
+			/// <param name="sendDelta">以微秒为单位的发送时间差</param>
+			/// <param name="arrivalDelta">以微秒为单位的到达时间差</param>
+			/// <param name="arrival">以微秒为单位的到达时间</param>
+			void            _Detect(const int64_t sendDelta, const int64_t arrivalDelta, const int64_t arrival);
+
+			/// <summary>
+			/// 按链路状态与丢包率调整速率
+			/// </summary>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			void            _Update(const int64_t now);
+
+		private:
+
+			/// <summary>拥塞控制参数</summary>
+			const CongestionOptions          m_iOpts;
+			/// <summary>以序号低位索引的发送记录</summary>
+			std::vector<__sent>              m_iHistory;
+			/// <summary>扩展后的最新发送序号</summary>
+			int64_t                          m_nSentSeq;
+			/// <summary>扩展后的已确认最大序号</summary>
+			int64_t                          m_nAckedSeq;
+			/// <summary>上一个到达时间的原始值</summary>
+			uint32_t                         m_uLastRaw;
+			/// <summary>扩展后的到达时间</summary>
+			int64_t                          m_nArrival;
+			/// <summary>当前包组</summary>
+			__group                          m_iGroup;
+			/// <summary>上一个完整的包组</summary>
+			__group                          m_iPrevGroup;
+			/// <summary>累积时延</summary>
+			double                           m_dAccDelay;
+			/// <summary>平滑后的累积时延</summary>
+			double                           m_dSmoothed;
+			/// <summary>回归窗口：到达时间（毫秒）与平滑时延</summary>
+			std::deque<std::pair<double, double>> m_iTrend;
+			/// <summary>参与计算的时延变化个数</summary>
+			std::size_t                      m_uDeltas;
+			/// <summary>上一次的回归斜率</summary>
+			double                           m_dPrevSlope;
+			/// <summary>以微秒为单位的持续超过阈值的时间，未超过时为-1</summary>
+			double                           m_dOverTime;
+			/// <summary>连续超过阈值的次数</summary>
+			std::size_t                      m_uOverCount;
+			/// <summary>上次更新阈值的到达时间</summary>
+			int64_t                          m_nThresholdAt;
+			/// <summary>已确认数据包的到达时间与长度，用于计算确认速率</summary>
+			std::deque<std::pair<int64_t, std::size_t>> m_iAcked;
+			/// <summary>窗口内已确认的字节数</summary>
+			std::size_t                      m_uAckedBytes;
+			/// <summary>以字节每秒为单位的当前估计带宽</summary>
+			double                           m_dRate;
+			/// <summary>上次调整速率的时间</summary>
+			int64_t                          m_nUpdateAt;
+			/// <summary>上次降速的时间</summary>
+			int64_t                          m_nDecreaseAt;
+			/// <summary>上次收到反馈的时间</summary>
+			int64_t                          m_nFeedbackAt;
+			/// <summary>统计信息</summary>
+			CongestionStats                  m_iStats;
+		};
+
+
+		/// <summary>
+		/// <para>拥塞控制传输层</para>
+		/// <para>发送端为每个数据报附加12字节的头（类型、保留字节、序号、时间戳），经令牌桶按估计带宽整形后发出</para>
+		/// <para>接收端剥去头并定期回送到达时间反馈，两端各自使用同一个对象的接收与发送两个方向</para>
+		/// <para>调用者应以NextRelease返回的时间作为Receive超时时间的上限，并周期性调用Poll</para>
+		/// <para>非线程安全，应在同一线程中使用</para>
+		/// </summary>
+		class CongestionTransport final : public Transport
+		{
+		public:
+
+			/// <summary>数据头长度</summary>
+			static constexpr std::size_t Header_Len = 12;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="lower">下层传输</param>
+			/// <param name="opts">拥塞控制参数</param>
+			/// <param name="mtu">下层单个数据报的最大长度</param>
+			CongestionTransport(Transport& lower, const CongestionOptions& opts = CongestionOptions(), const std::size_t mtu = 1504);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			CongestionTransport(const CongestionTransport&) = delete;
+
+			/// <summary>
+			/// 数据进入整形队列，令牌充足时立即发出
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回数据长度，队列已满、数据过长或发送失败返回-1</returns>
+			ssize_t         Send(const utils::Memory<char>& mem, const int64_t ts) override;
+
+			/// <summary>
+			/// 接收数据，同时处理对端的反馈
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，失败返回-1，超时返回-2</returns>
+			ssize_t         Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override;
+
+			/// <summary>
+			/// 获取下层等待可读的套接字，并将下一次整形发送与反馈的时间合并到next
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的最迟须再次调用Receive的时间</param>
+			/// <returns>套接字，不支持时返回-1</returns>
+			int             Handle(int64_t& next) noexcept override;
+
+			/// <summary>
+			/// 发送整形队列中已到时间的数据包与到期的反馈
+			/// </summary>
+			void            Poll();
+
+			/// <summary>
+			/// 获取距下一次需要调用Poll的时间
+			/// </summary>
+			/// <returns>以毫秒为单位的等待时间，无待办事项时返回-1</returns>
+			int64_t         NextRelease() const noexcept;
+
+			/// <summary>
+			/// 获取当前估计带宽，供编码器调整码率
+			/// </summary>
+			/// <returns>以字节每秒为单位的估计带宽</returns>
+			uint64_t        EstimatedRate() const noexcept { return m_iController.Rate(); }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			CongestionStats GetStats() const noexcept { return m_iController.GetStats(); }
+
+			/// <summary>
+			/// 获取整形统计信息
+			/// </summary>
+			/// <returns>整形统计信息</returns>
+			PacerStats      GetPacerStats() const noexcept { return m_iPacer.GetStats(m_uSession); }
+
+		private:
+
+			/// <summary>
+			/// 由整形器调用，写入序号后交给下层发送
+			/// </summary>
+			/// <param name="mem">含数据头的数据报</param>
+			/// <returns>下层发送的返回值</returns>
+			ssize_t         _Transmit(const utils::Memory<char>& mem);
+
+			/// <summary>
+			/// 处理收到的数据报
+			/// </summary>
+			/// <param name="len">数据报长度</param>
+			/// <param name="mem">接收缓冲区，数据报为数据时将其写入</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			/// <returns>数据报为数据时返回其长度，否则返回0，缓冲区过小返回-1</returns>
+			ssize_t         _Input(const std::size_t len, utils::Memory<char>& mem, int64_t& ts, const int64_t now);
+
+			/// <summary>
+			/// 发送到期的反馈
+			/// </summary>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			/// <param name="force">是否忽略反馈间隔立即发送</param>
+			void            _Feedback(const int64_t now, const bool force);
+
+		private:
+
+			/// <summary>下层传输</summary>
+			Transport&                    m_iLower;
+			/// <summary>拥塞控制参数</summary>
+			const CongestionOptions       m_iOpts;
+			/// <summary>下层单个数据报的最大长度</summary>
+			const std::size_t             m_uMtu;
+			/// <summary>拥塞控制器</summary>
+			CongestionController          m_iController;
+			/// <summary>整形器</summary>
+			Pacer                         m_iPacer;
+			/// <summary>整形会话</summary>
+			Pacer::session_type           m_uSession;
+			/// <summary>下一个发送序号</summary>
+			uint16_t                      m_uSeq;
+			/// <summary>打包缓冲区</summary>
+			std::vector<char>             m_iPackBuf;
+			/// <summary>发送缓冲区</summary>
+			std::vector<char>             m_iSendBuf;
+			/// <summary>接收缓冲区</summary>
+			std::vector<char>             m_iRecvBuf;
+			/// <summary>待反馈的到达记录</summary>
+			std::vector<CongestionController::feedback_type> m_iPending;
+			/// <summary>上次发送反馈的时间</summary>
+			int64_t                       m_nFeedbackAt;
+			/// <summary>以微秒为单位的当前时间，供整形器回调使用</summary>
+			int64_t                       m_nNow;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_CONGESTION_H__
@@ -0,0 +1,160 @@
+﻿/************************************************************************
+ * @ObjectName: connect_trace.cpp
+ * @Description: 记录连接建立过程中带时间戳的状态变化与失败原因
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "connect_trace.h"
+
+
+namespace
+{
+	/// <summary>
+	/// 获取事件类型名
+	/// </summary>
+	/// <param name="event">事件类型</param>
+	/// <returns>事件类型名</returns>
+	const char* eventName(const vsnc::forwarder::trace_event event) noexcept
+	{
+		switch (event)
+		{
+		case vsnc::forwarder::trace_event::ATTEMPT:    return "ATTEMPT";
+		case vsnc::forwarder::trace_event::STATE:      return "STATE";
+		case vsnc::forwarder::trace_event::TIMEOUT:    return "TIMEOUT";
+		case vsnc::forwarder::trace_event::FAILURE:    return "FAILURE";
+		case vsnc::forwarder::trace_event::CONNECTED:  return "CONNECTED";
+		case vsnc::forwarder::trace_event::LOST:       return "LOST";
+		case vsnc::forwarder::trace_event::DISCONNECT: return "DISCONNECT";
+		default:                                       return "UNKNOWN";
+		}
+	}
+
+	/// <summary>
+	/// 判断状态是否为连接建立过程中的阶段
+	/// </summary>
+	/// <param name="state">客户端状态</param>
+	/// <returns>是返回true，否则返回false</returns>
+	bool isPhase(const vsnc::p2p::vsnc_p2p_state state) noexcept
+	{
+		return (vsnc::p2p::vsnc_p2p_state::REQUESTING == state) ||
+			(vsnc::p2p::vsnc_p2p_state::CONNECTING == state) ||
+			(vsnc::p2p::vsnc_p2p_state::CONNECTED == state);
+	}
+}
+
+
+const char* vsnc::forwarder::__state_name(const p2p::vsnc_p2p_state state) noexcept
+{
+	switch (state)
+	{
+	case p2p::vsnc_p2p_state::OFFLINE:    return "OFFLINE";
+	case p2p::vsnc_p2p_state::FREE:       return "FREE";
+	case p2p::vsnc_p2p_state::REQUESTING: return "REQUESTING";
+	case p2p::vsnc_p2p_state::CONNECTING: return "CONNECTING";
+	case p2p::vsnc_p2p_state::CONNECTED:  return "CONNECTED";
+	default:                              return "UNKNOWN";
+	}
+}
+
+
+vsnc::forwarder::ConnectTrace::ConnectTrace(const uint64_t session, const std::size_t capacity) :
+	m_uSession(session),
+	m_uCapacity(capacity ? capacity : 1),
+	m_uNext(0)
+{
+	m_iRecords.reserve(m_uCapacity);
+}
+
+
+void vsnc::forwarder::ConnectTrace::Record(const int64_t time, const uint64_t attempt, const trace_event event, const p2p::vsnc_p2p_state state, const char* const reason)
+{
+	TraceRecord rec = { time, attempt, event, state, reason };
+	if (m_iRecords.size() < m_uCapacity) {
+		m_iRecords.push_back(rec);
+	}
+	else {
+		m_iRecords[m_uNext] = rec;
+	}
+	m_uNext = (m_uNext + 1) % m_uCapacity;
+}
+
+
+std::vector<vsnc::forwarder::TraceRecord> vsnc::forwarder::ConnectTrace::Records() const
+{
+	if (m_iRecords.size() < m_uCapacity) {
+		return m_iRecords;
+	}
+	std::vector<TraceRecord> recs(m_iRecords.begin() + m_uNext, m_iRecords.end());
+	recs.insert(recs.end(), m_iRecords.begin(), m_iRecords.begin() + m_uNext);
+	return recs;
+}
+
+
+std::vector<vsnc::forwarder::TraceRecord> vsnc::forwarder::ConnectTrace::Records(const uint64_t attempt) const
+{
+	std::vector<TraceRecord> recs;
+	for (auto& rec : Records()) {
+		if (rec.Attempt == attempt) {
+			recs.push_back(rec);
+		}
+	}
+	return recs;
+}
+
+
+void vsnc::forwarder::ConnectTrace::DumpChromeTrace(std::ostream& os, const int64_t offset) const
+{
+	auto first = true;
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	WriteEvents(os, first, offset);
+	os << "]}\n";
+}
+
+
+void vsnc::forwarder::ConnectTrace::WriteEvents(std::ostream& os, bool& first, const int64_t offset) const
+{
+	auto emit = [&os, &first, offset, this](const char* const ph, const char* const name, const int64_t time, const TraceRecord& rec) {
+		os << (first ? "" : ",") << "\n{\"ph\":\"" << ph << "\",\"name\":\"" << name
+			<< "\",\"pid\":1,\"tid\":" << m_uSession << ",\"ts\":" << ((time + offset) * 1000);
+		if ('i' == ph[0]) {
+			os << ",\"s\":\"t\"";
+		}
+		os << ",\"args\":{\"attempt\":" << rec.Attempt;
+		if (rec.Reason) {
+			os << ",\"reason\":\"" << rec.Reason << "\"";
+		}
+		os << "}}";
+		first = false;
+	};
+
+	// 阶段以B/E事件对表示，其余事件以瞬时事件表示
+	auto recs = Records();
+	auto phase = p2p::vsnc_p2p_state::FREE;
+	const TraceRecord* open = nullptr;
+	for (auto& rec : recs) {
+		if (trace_event::STATE == rec.Event) {
+			if (open) {
+				emit("E", __state_name(phase), rec.Time, *open);
+				open = nullptr;
+			}
+			phase = rec.State;
+			if (isPhase(phase)) {
+				emit("B", __state_name(phase), rec.Time, rec);
+				open = &rec;
+			}
+		}
+		else {
+			emit("i", eventName(rec.Event), rec.Time, rec);
+		}
+	}
+	if (open && !recs.empty()) {
+		emit("E", __state_name(phase), recs.back().Time, *open);
+	}
+}
+
+
+void vsnc::forwarder::ConnectTrace::Clear() noexcept
+{
+	m_iRecords.clear();
+	m_uNext = 0;
+}
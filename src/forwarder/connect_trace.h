@@ -0,0 +1,144 @@
+﻿/************************************************************************
+ * @ObjectName: connect_trace.h
+ * @Description: 记录连接建立过程中带时间戳的状态变化与失败原因
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_CONNECT_TRACE_H__
+#define __VSNC_FORWARDER_CONNECT_TRACE_H__
+
+
+#include <vector>
+#include <ostream>
+
+
+#include <stdint.h>
+
+
+#include <p2p/client.h>
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>连接跟踪事件类型</summary>
+		enum class trace_event : int8_t
+		{
+			ATTEMPT    = 0, // 发起连接
+			STATE      = 1, // 客户端状态变化
+			TIMEOUT    = 2, // 连接超时
+			FAILURE    = 3, // 连接失败
+			CONNECTED  = 4, // 连接成功
+			LOST       = 5, // 连接断开
+			DISCONNECT = 6, // 主动断开
+		};
+
+
+		/// <summary>
+		/// 连接跟踪记录
+		/// </summary>
+		struct TraceRecord
+		{
+			/// <summary>以毫秒为单位的单调时间</summary>
+			int64_t             Time;
+			/// <summary>所属的连接尝试序号，从1开始</summary>
+			uint64_t            Attempt;
+			/// <summary>事件类型</summary>
+			trace_event         Event;
+			/// <summary>事件发生后的客户端状态</summary>
+			p2p::vsnc_p2p_state State;
+			/// <summary>失败或断开的原因，须为静态字符串，可为空</summary>
+			const char*         Reason;
+		};
+
+
+		/// <summary>
+		/// <para>连接跟踪</para>
+		/// <para>以环形缓冲区保存最近的跟踪记录，可按连接尝试查询，也可导出为Chrome Trace（chrome://tracing、Perfetto）格式的JSON</para>
+		/// </summary>
+		class ConnectTrace
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="session">会话标识，导出时作为线程号以便在同一文件中区分多个会话</param>
+			/// <param name="capacity">保留的记录条数上限</param>
+			explicit ConnectTrace(const uint64_t session = 0, const std::size_t capacity = 4096);
+
+			/// <summary>
+			/// 添加一条记录
+			/// </summary>
+			/// <param name="time">以毫秒为单位的单调时间</param>
+			/// <param name="attempt">连接尝试序号</param>
+			/// <param name="event">事件类型</param>
+			/// <param name="state">客户端状态</param>
+			/// <param name="reason">原因，须为静态字符串</param>
+			void                     Record(const int64_t time, const uint64_t attempt, const trace_event event, const p2p::vsnc_p2p_state state, const char* const reason = nullptr);
+
+			/// <summary>
+			/// 按时间顺序获取保留的全部记录
+			/// </summary>
+			/// <returns>跟踪记录</returns>
+			std::vector<TraceRecord> Records() const;
+
+			/// <summary>
+			/// 获取某次连接尝试的记录
+			/// </summary>
+			/// <param name="attempt">连接尝试序号</param>
+			/// <returns>跟踪记录</returns>
+			std::vector<TraceRecord> Records(const uint64_t attempt) const;
+
+			/// <summary>
+			/// 以Chrome Trace JSON格式导出全部记录
+			/// </summary>
+			/// <param name="os">输出流</param>
+			/// <param name="offset">以毫秒为单位加到记录时间上的偏移，传入UTC时间与单调时间之差即导出为UTC时间</param>
+			void                     DumpChromeTrace(std::ostream& os, const int64_t offset = 0) const;
+
+			/// <summary>
+			/// <para>以Chrome Trace JSON格式导出全部记录，不含外层对象</para>
+			/// <para>用于将多个会话的记录合并到同一个文件中</para>
+			/// </summary>
+			/// <param name="os">输出流</param>
+			/// <param name="first">是否为数组中的第一个事件，导出后被置为false</param>
+			/// <param name="offset">以毫秒为单位加到记录时间上的偏移</param>
+			void                     WriteEvents(std::ostream& os, bool& first, const int64_t offset = 0) const;
+
+			/// <summary>
+			/// 清空全部记录
+			/// </summary>
+			void                     Clear() noexcept;
+
+		private:
+
+			/// <summary>会话标识</summary>
+			const uint64_t           m_uSession;
+			/// <summary>记录条数上限</summary>
+			const std::size_t        m_uCapacity;
+			/// <summary>环形缓冲区</summary>
+			std::vector<TraceRecord> m_iRecords;
+			/// <summary>下一条记录的写入位置</summary>
+			std::size_t              m_uNext;
+		};
+
+
+		/// <summary>
+		/// 获取客户端状态名
+		/// </summary>
+		/// <param name="state">客户端状态</param>
+		/// <returns>状态名</returns>
+		const char* __state_name(const p2p::vsnc_p2p_state state) noexcept;
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_CONNECT_TRACE_H__
@@ -0,0 +1,191 @@
+﻿/************************************************************************
+ * @ObjectName: connector.cpp
+ * @Description: 维持与对端的P2P连接，按超时与重试计划重连并统计各阶段耗时
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "connector.h"
+
+
+#include <algorithm>
+
+
+namespace
+{
+	/// <summary>保留的连接跟踪记录条数</summary>
+	constexpr std::size_t Trace_Capacity = 4096;
+}
+
+
+vsnc::forwarder::Connector::Connector(factory_type factory, const uint64_t peer, const ConnectOptions& opts) :
+	m_pfnFactory(factory),
+	m_upClient(factory()),
+	m_uPeer(peer),
+	m_iOptions(opts),
+	m_uRetries(0),
+	m_nNextAttempt(0),
+	m_uAttempt(0),
+	m_eLastState(p2p::vsnc_p2p_state::OFFLINE),
+	m_bAttempting(false),
+	m_nAttemptStart(0),
+	m_nPunchStart(-1),
+	m_nLostAt(-1),
+	m_nTotalSum(0),
+	m_nResumedSum(0),
+	m_nOutageSum(0),
+	m_uOutages(0),
+	m_iTrace(peer, Trace_Capacity)
+{
+}
+
+
+vsnc::p2p::vsnc_p2p_state vsnc::forwarder::Connector::Poll(const int64_t now)
+{
+	// 客户端由调用者驱动时在此执行其到期的定时任务，有后台线程时不做任何事
+	m_upClient->Pump();
+	auto state = m_upClient->GetState();
+	if ((p2p::vsnc_p2p_state::CONNECTED == m_eLastState) && (p2p::vsnc_p2p_state::CONNECTED != state)) {
+		Lost(now, "client left CONNECTED");
+	}
+
+	switch (state)
+	{
+	case p2p::vsnc_p2p_state::FREE:
+		if (m_bAttempting) {
+			_Fail(now, "client returned to FREE");
+		}
+		if (now >= m_nNextAttempt) {
+			// 经缓存端点恢复时可能在_Connect返回前即已连通，新状态留给下一次轮询，以免漏记本次连接
+			_Connect(now);
+		}
+		break;
+	case p2p::vsnc_p2p_state::REQUESTING:
+	case p2p::vsnc_p2p_state::CONNECTING:
+		if (m_bAttempting && (p2p::vsnc_p2p_state::CONNECTING == state) && (m_nPunchStart < 0)) {
+			m_nPunchStart = now;
+			m_iTiming.Request = now - m_nAttemptStart;
+		}
+		if (m_bAttempting && (m_iOptions.Timeout > 0) && (now - m_nAttemptStart >= m_iOptions.Timeout)) {
+			// 客户端没有取消连接的接口，重建客户端以终止本次连接
+			++m_iStats.Timeouts;
+			m_iTrace.Record(now, m_uAttempt, trace_event::TIMEOUT, state);
+			_Fail(now, "connect timeout");
+			_Rebuild();
+			state = m_upClient->GetState();
+		}
+		break;
+	case p2p::vsnc_p2p_state::CONNECTED:
+		if (m_bAttempting) {
+			m_bAttempting = false;
+			m_iTiming.Resumed = m_upClient->Resumed();
+			if (m_iTiming.Resumed) {
+				// 直接向缓存的端点打洞成功，没有经服务器交换端点
+				m_iTiming.Request = -1;
+				m_iTiming.Punch = now - m_nAttemptStart;
+			}
+			else if (m_nPunchStart >= 0) {
+				m_iTiming.Punch = now - m_nPunchStart;
+			}
+			else {
+				// REQUESTING与CONNECTING都在两次采样之间完成，无法区分
+				m_iTiming.Request = now - m_nAttemptStart;
+			}
+			m_iTiming.Total = now - m_nAttemptStart;
+			if (m_iTiming.Resumed) {
+				m_nResumedSum += m_iTiming.Total;
+				++m_iStats.Resumptions;
+			}
+			else {
+				m_nTotalSum += m_iTiming.Total;
+			}
+			if (m_nLostAt >= 0) {
+				m_iTiming.Outage = now - m_nLostAt;
+				m_nOutageSum += m_iTiming.Outage;
+				++m_uOutages;
+				m_nLostAt = -1;
+			}
+			++m_iStats.Successes;
+			m_iStats.Last = m_iTiming;
+			m_iTrace.Record(now, m_uAttempt, trace_event::CONNECTED, state);
+			m_uRetries = 0;
+		}
+		else if (m_nLostAt >= 0) {
+			// 仅接收循环退出而连接仍然保持，不计入重连
+			m_nLostAt = -1;
+		}
+		// 对端主动恢复的连接同样更新缓存
+		m_iCachedEp = m_upClient->PeerEndpoint();
+		break;
+	default:
+		break;
+	}
+	if (state != m_eLastState) {
+		m_iTrace.Record(now, m_uAttempt, trace_event::STATE, state);
+	}
+	m_eLastState = state;
+	return state;
+}
+
+
+void vsnc::forwarder::Connector::Lost(const int64_t now, const char* const reason)
+{
+	if (m_nLostAt < 0) {
+		m_nLostAt = now;
+		++m_iStats.Drops;
+		m_iTrace.Record(now, m_uAttempt, trace_event::LOST, m_eLastState, reason);
+	}
+}
+
+
+void vsnc::forwarder::Connector::Disconnect(const int64_t now, const char* const reason)
+{
+	m_iTrace.Record(now, m_uAttempt, trace_event::DISCONNECT, m_eLastState, reason);
+	m_bAttempting = false;
+	_Rebuild();
+	m_eLastState = m_upClient->GetState();
+	m_iTrace.Record(now, m_uAttempt, trace_event::STATE, m_eLastState);
+}
+
+
+vsnc::forwarder::ConnectorStats vsnc::forwarder::Connector::GetStats() const noexcept
+{
+	auto stats = m_iStats;
+	auto full = stats.Successes - stats.Resumptions;
+	stats.AvgTotal = full ? (static_cast<double>(m_nTotalSum) / full) : 0.0;
+	stats.AvgResumed = stats.Resumptions ? (static_cast<double>(m_nResumedSum) / stats.Resumptions) : 0.0;
+	stats.AvgOutage = m_uOutages ? (static_cast<double>(m_nOutageSum) / m_uOutages) : 0.0;
+	return stats;
+}
+
+
+void vsnc::forwarder::Connector::_Connect(const int64_t now)
+{
+	m_upClient->Connect(m_uPeer);
+	++m_iStats.Attempts;
+	m_iTrace.Record(now, ++m_uAttempt, trace_event::ATTEMPT, m_eLastState);
+	m_bAttempting = true;
+	m_nAttemptStart = now;
+	m_nPunchStart = -1;
+	m_iTiming = ConnectTiming();
+}
+
+
+void vsnc::forwarder::Connector::_Fail(const int64_t now, const char* const reason)
+{
+	++m_iStats.Failures;
+	m_iTrace.Record(now, m_uAttempt, trace_event::FAILURE, m_eLastState, reason);
+	m_bAttempting = false;
+	auto delay = m_iOptions.Backoff.empty() ? 0 : m_iOptions.Backoff[(std::min)(m_uRetries, m_iOptions.Backoff.size() - 1)];
+	m_nNextAttempt = now + delay;
+	++m_uRetries;
+}
+
+
+void vsnc::forwarder::Connector::_Rebuild()
+{
+	m_upClient.reset();
+	m_upClient = m_pfnFactory();
+	if (m_iCachedEp.Valid()) {
+		m_upClient->Cache(m_uPeer, m_iCachedEp);
+	}
+}
@@ -0,0 +1,241 @@
+﻿/************************************************************************
+ * @ObjectName: connector.h
+ * @Description: 维持与对端的P2P连接，按超时与重试计划重连并统计各阶段耗时
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_CONNECTOR_H__
+#define __VSNC_FORWARDER_CONNECTOR_H__
+
+
+#include <memory>
+#include <vector>
+#include <functional>
+
+
+#include <stdint.h>
+
+
+#include <p2p/client.h>
+
+
+#include "connect_trace.h"
+#include "../punch/client.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 连接参数
+		/// </summary>
+		struct ConnectOptions
+		{
+			/// <summary>
+			/// <para>以毫秒为单位的单次连接超时时间，小于等于0时只依靠客户端各连接阶段的超时</para>
+			/// <para>超时后连接器重建客户端以终止本次连接，各阶段的超时见punch::ClientOptions::Timeout</para>
+			/// </summary>
+			int64_t              Timeout = 3000;
+			/// <summary>以毫秒为单位的第n次重试前的等待时间，重试次数超出列表长度时沿用最后一项</summary>
+			std::vector<int64_t> Backoff = { 0, 200, 500, 1000, 2000 };
+		};
+
+
+		/// <summary>
+		/// 一次连接建立过程中各阶段的耗时，未经历的阶段为-1
+		/// </summary>
+		struct ConnectTiming
+		{
+			/// <summary>以毫秒为单位的REQUESTING阶段耗时，即经服务器交换端点的时间</summary>
+			int64_t Request = -1;
+			/// <summary>以毫秒为单位的CONNECTING阶段耗时，即打洞的时间</summary>
+			int64_t Punch   = -1;
+			/// <summary>以毫秒为单位的从发起连接到CONNECTED的总耗时</summary>
+			int64_t Total   = -1;
+			/// <summary>以毫秒为单位的从上次连接断开到重新CONNECTED的中断时间</summary>
+			int64_t Outage  = -1;
+			/// <summary>是否经缓存的对端端点直接恢复，此时没有REQUESTING阶段，Punch即总耗时</summary>
+			bool    Resumed = false;
+		};
+
+
+		/// <summary>
+		/// 连接统计信息
+		/// </summary>
+		struct ConnectorStats
+		{
+			/// <summary>发起连接的次数</summary>
+			uint64_t      Attempts    = 0;
+			/// <summary>连接成功的次数</summary>
+			uint64_t      Successes   = 0;
+			/// <summary>连接失败（回到FREE或超时）的次数</summary>
+			uint64_t      Failures    = 0;
+			/// <summary>因超时而终止的连接次数</summary>
+			uint64_t      Timeouts    = 0;
+			/// <summary>数据通道意外断开的次数，不含退出与主动断开</summary>
+			uint64_t      Drops       = 0;
+			/// <summary>经缓存的对端端点直接恢复的连接次数</summary>
+			uint64_t      Resumptions = 0;
+			/// <summary>以毫秒为单位的经服务器建立的连接的平均总耗时</summary>
+			double        AvgTotal    = 0.0;
+			/// <summary>以毫秒为单位的直接恢复的连接的平均总耗时</summary>
+			double        AvgResumed  = 0.0;
+			/// <summary>以毫秒为单位的平均重连中断时间</summary>
+			double        AvgOutage   = 0.0;
+			/// <summary>最近一次成功连接的各阶段耗时</summary>
+			ConnectTiming Last;
+		};
+
+
+		/// <summary>
+		/// <para>连接器</para>
+		/// <para>连接器持有客户端，周期性采样其状态，在FREE时按重试计划向对端发起连接，超时后重建客户端</para>
+		/// <para>记录REQUESTING、CONNECTING各阶段及断线重连的耗时，并将每次状态变化与失败原因写入连接跟踪</para>
+		/// <para>连接器记住最近一次连接的对端端点，重建客户端后交给新客户端，使重连先直接向该端点打洞</para>
+		/// <para>阶段耗时的精度取决于Poll的调用间隔；非线程安全</para>
+		/// </summary>
+		class Connector
+		{
+		public:
+
+			/// <summary>客户端指针类型</summary>
+			using client_ptr = std::unique_ptr<punch::Client>;
+			/// <summary>客户端构造函数类型</summary>
+			using factory_type = std::function<client_ptr()>;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="factory">客户端构造函数，连接超时后用于重建客户端</param>
+			/// <param name="peer">对端序列号</param>
+			/// <param name="opts">连接参数</param>
+			Connector(factory_type factory, const uint64_t peer, const ConnectOptions& opts = ConnectOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			Connector(const Connector&) = delete;
+
+			/// <summary>
+			/// <para>获取当前的客户端</para>
+			/// <para>连接超时后客户端会被重建，因此不应在Poll调用之间长期保存其引用</para>
+			/// </summary>
+			/// <returns>当前的客户端</returns>
+			punch::Client&      Client() noexcept { return *m_upClient; }
+
+			/// <summary>
+			/// 驱动客户端并采样其状态，必要时发起连接
+			/// </summary>
+			/// <param name="now">以毫秒为单位的单调时间，如utils::__steady()，不受系统时间调整的影响</param>
+			/// <returns>客户端当前状态</returns>
+			p2p::vsnc_p2p_state Poll(const int64_t now);
+
+			/// <summary>
+			/// <para>通知连接器数据通道意外断开，在接收循环因连接丢失而退出时调用</para>
+			/// <para>计入断开次数并开始计算重连中断时间；正常退出、下游故障等与链路无关的原因不应调用</para>
+			/// </summary>
+			/// <param name="now">以毫秒为单位的单调时间，如utils::__steady()，不受系统时间调整的影响</param>
+			/// <param name="reason">断开原因，须为静态字符串</param>
+			void                Lost(const int64_t now, const char* const reason = nullptr);
+
+			/// <summary>
+			/// <para>主动断开连接，如下游失效时</para>
+			/// <para>客户端没有断开连接的接口，因此重建客户端使其离开CONNECTED，此后按重试计划重新连接；不计入断开次数</para>
+			/// <para>调用后此前通过Client获取的引用失效</para>
+			/// </summary>
+			/// <param name="now">以毫秒为单位的单调时间，如utils::__steady()，不受系统时间调整的影响</param>
+			/// <param name="reason">断开原因，须为静态字符串</param>
+			void                Disconnect(const int64_t now, const char* const reason);
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			ConnectorStats      GetStats() const noexcept;
+
+			/// <summary>
+			/// 获取连接跟踪
+			/// </summary>
+			/// <returns>连接跟踪</returns>
+			const ConnectTrace& Trace() const noexcept { return m_iTrace; }
+
+		private:
+
+			/// <summary>
+			/// 发起一次连接
+			/// </summary>
+			/// <param name="now">以毫秒为单位的单调时间，如utils::__steady()，不受系统时间调整的影响</param>
+			void                _Connect(const int64_t now);
+
+			/// <summary>
+			/// 记录一次连接失败并按重试计划安排下一次连接
+			/// </summary>
+			/// <param name="now">以毫秒为单位的单调时间，如utils::__steady()，不受系统时间调整的影响</param>
+			/// <param name="reason">失败原因，须为静态字符串</param>
+			void                _Fail(const int64_t now, const char* const reason);
+
+			/// <summary>
+			/// 重建客户端，并交给新客户端缓存的对端端点
+			/// </summary>
+			void                _Rebuild();
+
+		private:
+
+			/// <summary>客户端构造函数</summary>
+			factory_type        m_pfnFactory;
+			/// <summary>P2P客户端</summary>
+			client_ptr          m_upClient;
+			/// <summary>对端序列号</summary>
+			const uint64_t      m_uPeer;
+			/// <summary>连接参数</summary>
+			ConnectOptions      m_iOptions;
+			/// <summary>连续失败的次数</summary>
+			std::size_t         m_uRetries;
+			/// <summary>下一次允许发起连接的时间</summary>
+			int64_t             m_nNextAttempt;
+			/// <summary>当前连接尝试序号</summary>
+			uint64_t            m_uAttempt;
+
+			/// <summary>上一次采样的状态</summary>
+			p2p::vsnc_p2p_state m_eLastState;
+			/// <summary>是否正在连接</summary>
+			bool                m_bAttempting;
+			/// <summary>本次连接的发起时间</summary>
+			int64_t             m_nAttemptStart;
+			/// <summary>本次连接进入CONNECTING的时间</summary>
+			int64_t             m_nPunchStart;
+			/// <summary>上次连接断开的时间，尚未断开过为-1</summary>
+			int64_t             m_nLostAt;
+			/// <summary>本次连接的各阶段耗时</summary>
+			ConnectTiming       m_iTiming;
+			/// <summary>最近一次连接的对端端点，无效时不做会话恢复</summary>
+			punch::Endpoint     m_iCachedEp;
+
+			/// <summary>统计信息</summary>
+			ConnectorStats      m_iStats;
+			/// <summary>经服务器建立的连接的总耗时之和</summary>
+			int64_t             m_nTotalSum;
+			/// <summary>直接恢复的连接的总耗时之和</summary>
+			int64_t             m_nResumedSum;
+			/// <summary>重连中断时间之和</summary>
+			int64_t             m_nOutageSum;
+			/// <summary>重连的次数</summary>
+			uint64_t            m_uOutages;
+
+			/// <summary>连接跟踪</summary>
+			ConnectTrace        m_iTrace;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_CONNECTOR_H__
@@ -0,0 +1,203 @@
+﻿/************************************************************************
+ * @ObjectName: downstream.cpp
+ * @Description: 带有界发送队列与背压策略的下游UDP目的地
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "downstream.h"
+
+
+#include <algorithm>
+
+
+#ifdef _WIN32
+#include <WS2tcpip.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/select.h>
+#endif // _WIN32
+
+
+namespace
+{
+	/// <summary>保留的空闲缓冲区个数上限，积压消除后归还内存</summary>
+	constexpr std::size_t Max_Free = 64;
+}
+
+
+vsnc::forwarder::Downstream::Downstream(const socket_type sock, const sockaddr_in& addr, const DownstreamOptions& opts) :
+	m_iSocket(sock),
+	m_iAddr(addr),
+	m_iOptions(opts),
+	m_bBroken(false),
+	m_bFailed(false)
+{
+#ifdef _WIN32
+	u_long mode = 1;
+	ioctlsocket(m_iSocket, FIONBIO, &mode);
+#else
+	fcntl(m_iSocket, F_SETFL, fcntl(m_iSocket, F_GETFL, 0) | O_NONBLOCK);
+#endif // _WIN32
+}
+
+
+ssize_t vsnc::forwarder::Downstream::Send(const utils::Memory<char>& mem)
+{
+	if (m_bBroken) {
+		return -1;
+	}
+	if (!m_iQueue.empty()) {
+		Flush();
+	}
+	if (m_iQueue.empty()) {
+		auto ret = _SendOne(mem.Data(), mem.Length());
+		if (ret > 0) {
+			return static_cast<ssize_t>(mem.Length());
+		}
+		if (ret < 0) {
+			return -1;
+		}
+		++m_iStats.Stalls;
+	}
+	return _Enqueue(mem) ? static_cast<ssize_t>(mem.Length()) : -1;
+}
+
+
+std::size_t vsnc::forwarder::Downstream::Flush(const int64_t timeout)
+{
+	std::size_t cnt = 0;
+	if (m_iQueue.empty() || !_WaitWritable(timeout)) {
+		return cnt;
+	}
+	while (!m_iQueue.empty()) {
+		auto& pkt = m_iQueue.front();
+		auto ret = _SendOne(pkt.data(), pkt.size());
+		if (0 == ret) {
+			break;
+		}
+		if (ret > 0) {
+			++cnt;
+		}
+		_PopFront();
+	}
+	return cnt;
+}
+
+
+void vsnc::forwarder::Downstream::Reset() noexcept
+{
+	while (!m_iQueue.empty()) {
+		_PopFront();
+	}
+	m_bBroken = false;
+	m_bFailed = false;
+}
+
+
+vsnc::forwarder::DownstreamStats vsnc::forwarder::Downstream::GetStats() const noexcept
+{
+	auto stats = m_iStats;
+	stats.Pending = m_iQueue.size();
+	return stats;
+}
+
+
+int vsnc::forwarder::Downstream::_SendOne(const char* const data, const std::size_t len) noexcept
+{
+	auto ret = sendto(m_iSocket, data, static_cast<int>(len), 0, reinterpret_cast<const sockaddr*>(&m_iAddr), sizeof(m_iAddr));
+	if (ret >= 0) {
+		++m_iStats.Sent;
+		return 1;
+	}
+#ifdef _WIN32
+	auto err = WSAGetLastError();
+	if ((WSAEWOULDBLOCK == err) || (WSAENOBUFS == err)) {
+		return 0;
+	}
+#else
+	if ((EAGAIN == errno) || (EWOULDBLOCK == errno) || (ENOBUFS == errno)) {
+		return 0;
+	}
+#endif // _WIN32
+	++m_iStats.Errors;
+	m_bFailed = true;
+	return -1;
+}
+
+
+bool vsnc::forwarder::Downstream::_WaitWritable(const int64_t timeout) const noexcept
+{
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(m_iSocket, &fds);
+	timeval tv;
+	tv.tv_sec = static_cast<long>(timeout / 1000);
+	tv.tv_usec = static_cast<long>((timeout % 1000) * 1000);
+	return select(static_cast<int>(m_iSocket) + 1, nullptr, &fds, nullptr, &tv) > 0;
+}
+
+
+bool vsnc::forwarder::Downstream::_Enqueue(const utils::Memory<char>& mem)
+{
+	auto len = mem.Length();
+	if (_Full(len)) {
+		switch (m_iOptions.Policy)
+		{
+		case overflow_policy::DROP_OLDEST:
+			while (!m_iQueue.empty() && _Full(len)) {
+				_PopFront();
+				++m_iStats.DroppedOldest;
+			}
+			break;
+		case overflow_policy::BLOCK:
+			Flush(m_iOptions.BlockTimeout);
+			break;
+		case overflow_policy::DISCONNECT:
+			m_bBroken = true;
+			break;
+		default:
+			break;
+		}
+		if (_Full(len)) {
+			++m_iStats.DroppedNewest;
+			return false;
+		}
+		// BLOCK策略下积压可能已经清空，此时直接发送
+		if (m_iQueue.empty()) {
+			auto ret = _SendOne(mem.Data(), len);
+			if (0 != ret) {
+				return ret > 0;
+			}
+		}
+	}
+
+	std::vector<char> pkt;
+	if (!m_iFree.empty()) {
+		pkt = std::move(m_iFree.back());
+		m_iFree.pop_back();
+	}
+	pkt.assign(mem.Data(), mem.Data() + len);
+	m_iQueue.push_back(std::move(pkt));
+	++m_iStats.Queued;
+	m_iStats.PendingBytes += len;
+	m_iStats.PeakBytes = (std::max)(m_iStats.PeakBytes, m_iStats.PendingBytes);
+	return true;
+}
+
+
+bool vsnc::forwarder::Downstream::_Full(const std::size_t len) const noexcept
+{
+	return (m_iQueue.size() >= m_iOptions.MaxPackets) || (m_iStats.PendingBytes + len > m_iOptions.MaxBytes);
+}
+
+
+void vsnc::forwarder::Downstream::_PopFront() noexcept
+{
+	auto& pkt = m_iQueue.front();
+	m_iStats.PendingBytes -= pkt.size();
+	if (m_iFree.size() < Max_Free) {
+		m_iFree.push_back(std::move(pkt));
+	}
+	m_iQueue.pop_front();
+}
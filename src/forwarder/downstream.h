@@ -0,0 +1,228 @@
+﻿/************************************************************************
+ * @ObjectName: downstream.h
+ * @Description: 带有界发送队列与背压策略的下游UDP目的地
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_DOWNSTREAM_H__
+#define __VSNC_FORWARDER_DOWNSTREAM_H__
+
+
+#include <vector>
+#include <deque>
+
+
+#include <stdint.h>
+
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif // _WIN32
+
+
+#include <p2p/client.h>
+#include <vsnc_utils/memory.h>
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>下游发送队列已满时的处理策略</summary>
+		enum class overflow_policy : int8_t
+		{
+			DROP_OLDEST = 0, // 丢弃最旧的数据包，适用于实时视频
+			BLOCK       = 1, // 阻塞等待套接字可写，超时后丢弃新数据包
+			DISCONNECT  = 2, // 标记下游失效，由调用者断开会话
+		};
+
+
+		/// <summary>
+		/// 下游参数
+		/// </summary>
+		struct DownstreamOptions
+		{
+			/// <summary>队列已满时的处理策略</summary>
+			overflow_policy Policy       = overflow_policy::DROP_OLDEST;
+			/// <summary>排队数据包个数上限</summary>
+			std::size_t     MaxPackets   = 2048;
+			/// <summary>以字节为单位的排队数据总量上限</summary>
+			std::size_t     MaxBytes     = 4 * 1024 * 1024;
+			/// <summary>以毫秒为单位的BLOCK策略最长阻塞时间</summary>
+			int64_t         BlockTimeout = 50;
+		};
+
+
+		/// <summary>
+		/// 下游统计信息
+		/// </summary>
+		struct DownstreamStats
+		{
+			/// <summary>发出的数据包个数</summary>
+			uint64_t    Sent          = 0;
+			/// <summary>因套接字不可写而进入队列的数据包个数</summary>
+			uint64_t    Queued        = 0;
+			/// <summary>因队列已满被丢弃的旧数据包个数</summary>
+			uint64_t    DroppedOldest = 0;
+			/// <summary>因队列已满被丢弃的新数据包个数</summary>
+			uint64_t    DroppedNewest = 0;
+			/// <summary>发送出错（非暂时性错误）的数据包个数</summary>
+			uint64_t    Errors        = 0;
+			/// <summary>套接字由可写变为不可写的次数</summary>
+			uint64_t    Stalls        = 0;
+			/// <summary>当前排队的数据包个数</summary>
+			std::size_t Pending       = 0;
+			/// <summary>以字节为单位的当前排队数据量</summary>
+			std::size_t PendingBytes  = 0;
+			/// <summary>以字节为单位的排队数据量峰值</summary>
+			std::size_t PeakBytes     = 0;
+		};
+
+
+		/// <summary>
+		/// <para>下游UDP目的地</para>
+		/// <para>套接字被设为非阻塞，发送遇到暂时性错误（EAGAIN、ENOBUFS）时数据包进入有界队列，待套接字可写后重试</para>
+		/// <para>不持有套接字，多个目的地可以共用同一个套接字；非线程安全，应在同一线程中使用</para>
+		/// </summary>
+		class Downstream
+		{
+		public:
+
+#ifdef _WIN32
+			/// <summary>套接字类型</summary>
+			using socket_type = SOCKET;
+#else
+			/// <summary>套接字类型</summary>
+			using socket_type = int;
+#endif // _WIN32
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="sock">已创建的UDP套接字，将被设为非阻塞</param>
+			/// <param name="addr">目的地址</param>
+			/// <param name="opts">下游参数</param>
+			Downstream(const socket_type sock, const sockaddr_in& addr, const DownstreamOptions& opts = DownstreamOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			Downstream(const Downstream&) = delete;
+
+			/// <summary>
+			/// 发送数据，队列中有积压时先尝试清空队列
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <returns>成功发送或进入队列返回数据长度，被丢弃或出错返回-1</returns>
+			ssize_t         Send(const utils::Memory<char>& mem);
+
+			/// <summary>
+			/// 在套接字可写时发送队列中积压的数据包
+			/// </summary>
+			/// <param name="timeout">以毫秒为单位的等待套接字可写的时间，为0时不等待</param>
+			/// <returns>发送的数据包个数</returns>
+			std::size_t     Flush(const int64_t timeout = 0);
+
+			/// <summary>
+			/// 判断是否有积压的数据包
+			/// </summary>
+			/// <returns>有积压返回true，否则返回false</returns>
+			bool            Pending() const noexcept { return !m_iQueue.empty(); }
+
+			/// <summary>
+			/// <para>判断下游是否已失效</para>
+			/// <para>DISCONNECT策略下队列溢出后返回true，调用者应断开会话并调用Reset</para>
+			/// </summary>
+			/// <returns>已失效返回true，否则返回false</returns>
+			bool            Broken() const noexcept { return m_bBroken; }
+
+			/// <summary>
+			/// <para>判断发送是否出错</para>
+			/// <para>遇到非暂时性错误后返回true，调用者应断开会话并调用Reset</para>
+			/// </summary>
+			/// <returns>出错返回true，否则返回false</returns>
+			bool            Failed() const noexcept { return m_bFailed; }
+
+			/// <summary>
+			/// 丢弃积压的数据包并清除失效与出错标记
+			/// </summary>
+			void            Reset() noexcept;
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			DownstreamStats GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 发送一个数据包
+			/// </summary>
+			/// <param name="data">数据头指针</param>
+			/// <param name="len">数据长度</param>
+			/// <returns>成功返回1，套接字暂不可写返回0，出错返回-1</returns>
+			int             _SendOne(const char* const data, const std::size_t len) noexcept;
+
+			/// <summary>
+			/// 等待套接字可写
+			/// </summary>
+			/// <param name="timeout">以毫秒为单位的超时时间</param>
+			/// <returns>可写返回true，否则返回false</returns>
+			bool            _WaitWritable(const int64_t timeout) const noexcept;
+
+			/// <summary>
+			/// 将数据包放入队列，必要时按策略腾出空间
+			/// </summary>
+			/// <param name="mem">待排队的数据</param>
+			/// <returns>成功排队返回true，被丢弃返回false</returns>
+			bool            _Enqueue(const utils::Memory<char>& mem);
+
+			/// <summary>
+			/// 判断再放入len字节后队列是否超出上限
+			/// </summary>
+			/// <param name="len">待放入的字节数</param>
+			/// <returns>超出返回true，否则返回false</returns>
+			bool            _Full(const std::size_t len) const noexcept;
+
+			/// <summary>
+			/// 移除队列头部的数据包
+			/// </summary>
+			void            _PopFront() noexcept;
+
+		private:
+
+			/// <summary>UDP套接字</summary>
+			socket_type     m_iSocket;
+			/// <summary>目的地址</summary>
+			sockaddr_in     m_iAddr;
+			/// <summary>下游参数</summary>
+			DownstreamOptions m_iOptions;
+			/// <summary>是否已失效</summary>
+			bool            m_bBroken;
+			/// <summary>是否发送出错</summary>
+			bool            m_bFailed;
+
+			/// <summary>积压的数据包</summary>
+			std::deque<std::vector<char>>  m_iQueue;
+			/// <summary>可复用的空闲缓冲区</summary>
+			std::vector<std::vector<char>> m_iFree;
+			/// <summary>统计信息</summary>
+			DownstreamStats m_iStats;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_DOWNSTREAM_H__
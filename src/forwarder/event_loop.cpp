@@ -0,0 +1,309 @@
+﻿/************************************************************************
+ * @ObjectName: event_loop.cpp
+ * @Description: 单线程协程事件循环，使大量会话以协程形式运行在少量线程上
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "event_loop.h"
+
+
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#include <mmsystem.h>
+
+
+namespace
+{
+	using __pollfd = WSAPOLLFD;
+
+	inline int __poll(__pollfd* fds, const std::size_t n, const int timeout) noexcept
+	{
+		return WSAPoll(fds, static_cast<ULONG>(n), timeout);
+	}
+
+	/// <summary>
+	/// 在作用域内提高系统定时器精度
+	/// </summary>
+	class __timer_resolution
+	{
+	public:
+
+		explicit __timer_resolution(const unsigned ms) noexcept :
+			m_uMs(ms && (TIMERR_NOERROR == timeBeginPeriod(ms)) ? ms : 0)
+		{
+		}
+
+		__timer_resolution(const __timer_resolution&) = delete;
+
+		~__timer_resolution()
+		{
+			if (m_uMs) {
+				timeEndPeriod(m_uMs);
+			}
+		}
+
+	private:
+
+		/// <summary>成功请求的精度，0为未请求</summary>
+		const unsigned m_uMs;
+	};
+}
+#else
+#include <poll.h>
+
+
+namespace
+{
+	using __pollfd = pollfd;
+
+	inline int __poll(__pollfd* fds, const std::size_t n, const int timeout) noexcept
+	{
+		return poll(fds, static_cast<nfds_t>(n), timeout);
+	}
+}
+#endif // _WIN32
+
+
+vsnc::forwarder::Task::~Task()
+{
+	if (m_hCoro) {
+		m_hCoro.destroy();
+	}
+}
+
+
+std::coroutine_handle<> vsnc::forwarder::Task::await_suspend(std::coroutine_handle<> waiter) noexcept
+{
+	m_hCoro.promise().continuation = waiter;
+	return m_hCoro;
+}
+
+
+void vsnc::forwarder::Task::await_resume()
+{
+	if (m_hCoro && m_hCoro.promise().error) {
+		std::rethrow_exception(m_hCoro.promise().error);
+	}
+}
+
+
+vsnc::forwarder::Task::handle_type vsnc::forwarder::Task::Release() noexcept
+{
+	auto h = m_hCoro;
+	m_hCoro = nullptr;
+	return h;
+}
+
+
+void vsnc::forwarder::EventLoop::__sleep_awaiter::await_suspend(std::coroutine_handle<> h)
+{
+	if (delay <= 0) {
+		loop._Post(h);
+		return;
+	}
+	loop.m_iWheel.ScheduleAt(utils::__steady() + delay, [this, h]() {
+		loop._Post(h);
+	});
+}
+
+
+vsnc::forwarder::EventLoop::EventLoop(const EventLoopOptions& opts) :
+	m_iOpts(opts),
+	m_iWheel(utils::__steady()),
+	m_bRun(true)
+{
+}
+
+
+vsnc::forwarder::EventLoop::~EventLoop()
+{
+	for (auto addr : m_iTasks) {
+		std::coroutine_handle<>::from_address(addr).destroy();
+	}
+}
+
+
+void vsnc::forwarder::EventLoop::Spawn(Task task)
+{
+	auto h = task.Release();
+	if (!h) {
+		return;
+	}
+	h.promise().loop = this;
+	m_iTasks.insert(h.address());
+	_Post(h);
+}
+
+
+void vsnc::forwarder::EventLoop::Run()
+{
+	m_bRun.store(true);
+#ifdef _WIN32
+	__timer_resolution resolution(m_iOpts.TimerResolution);
+#endif // _WIN32
+	while (m_bRun.load() && !m_iTasks.empty()) {
+		// 只执行本轮开始时已就绪的协程，Yield的协程排到下一轮，避免定时器与等待对象被饿死
+		for (auto n = m_iReady.size(); n; --n) {
+			auto h = m_iReady.front();
+			m_iReady.pop_front();
+			++m_iStats.Resumes;
+			h.resume();
+			if (m_pError) {
+				auto error = m_pError;
+				m_pError = nullptr;
+				std::rethrow_exception(error);
+			}
+		}
+		m_iWheel.Expire(utils::__steady(), m_iFired);
+		for (auto& cb : m_iFired) {
+			cb();
+		}
+		m_iFired.clear();
+		if (!m_iReady.empty() || m_iTasks.empty()) {
+			continue;
+		}
+		auto wait = m_iWheel.NextTimeout();
+		if ((1 == m_iWaiting.size()) && (*m_iWaiting.begin())->Blocking()) {
+			// 只有一个可阻塞的等待对象，直接阻塞在其上
+			_Poll(**m_iWaiting.begin(), wait);
+			continue;
+		}
+		if (_Wait(wait)) {
+			continue;
+		}
+		if (wait > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+		}
+		else if (wait < 0) {
+			// 没有定时器也没有等待对象，剩余的任务不会再被恢复
+			break;
+		}
+	}
+}
+
+
+void vsnc::forwarder::EventLoop::Watch(Poller& poller, std::coroutine_handle<> h)
+{
+	poller.m_hWaiter = h;
+	poller.m_nInterval = 0;
+	poller.m_nSocket = -1;
+	m_iWaiting.insert(&poller);
+	_Arm(poller, utils::__steady());
+}
+
+
+vsnc::forwarder::EventLoopStats vsnc::forwarder::EventLoop::GetStats() const noexcept
+{
+	auto stats = m_iStats;
+	stats.Tasks = m_iTasks.size();
+	stats.Waiting = m_iWaiting.size();
+	return stats;
+}
+
+
+void vsnc::forwarder::EventLoop::_Post(std::coroutine_handle<> h)
+{
+	m_iReady.push_back(h);
+}
+
+
+void vsnc::forwarder::EventLoop::_Arm(Poller& poller, const int64_t now)
+{
+	if (utils::TimerWheel::Invalid_Timer != poller.m_uTimer) {
+		m_iWheel.Cancel(poller.m_uTimer);
+		poller.m_uTimer = utils::TimerWheel::Invalid_Timer;
+	}
+	int64_t next = -1;
+	poller.m_nSocket = poller.Handle(next);
+	int64_t at = next;
+	if (poller.m_nSocket < 0) {
+		poller.m_nInterval = (std::min)((std::max)(poller.m_nInterval * 2, static_cast<int64_t>(1)), m_iOpts.MaxPollInterval);
+		at = now + poller.m_nInterval;
+	}
+	if (poller.m_nDeadline >= 0) {
+		at = (std::min)(at, poller.m_nDeadline);
+	}
+	auto p = &poller;
+	poller.m_uTimer = m_iWheel.ScheduleAt(at, [this, p]() {
+		p->m_uTimer = utils::TimerWheel::Invalid_Timer;
+		_Poll(*p, 0);
+	});
+}
+
+
+void vsnc::forwarder::EventLoop::_Poll(Poller& poller, const int64_t wait)
+{
+	auto w = wait;
+	if (w && (poller.m_nDeadline >= 0)) {
+		// 阻塞不超过截止时间
+		auto left = (std::max)(poller.m_nDeadline - utils::__steady(), static_cast<int64_t>(0));
+		w = (w < 0) ? left : (std::min)(w, left);
+	}
+	++(w ? m_iStats.Blocks : m_iStats.Polls);
+	if (!poller.Poll(w)) {
+		auto now = utils::__steady();
+		if ((poller.m_nDeadline < 0) || (now < poller.m_nDeadline)) {
+			// 就绪通知驱动的等待对象每次轮询后按新的时间重新安排，轮询驱动的只在定时器到期后重新安排
+			if ((poller.m_nSocket >= 0) || (utils::TimerWheel::Invalid_Timer == poller.m_uTimer)) {
+				_Arm(poller, now);
+			}
+			return;
+		}
+	}
+	if (utils::TimerWheel::Invalid_Timer != poller.m_uTimer) {
+		m_iWheel.Cancel(poller.m_uTimer);
+		poller.m_uTimer = utils::TimerWheel::Invalid_Timer;
+	}
+	m_iWaiting.erase(&poller);
+	_Post(poller.m_hWaiter);
+}
+
+
+bool vsnc::forwarder::EventLoop::_Wait(const int64_t wait)
+{
+	thread_local std::vector<__pollfd> fds;
+	fds.clear();
+	m_iPolled.clear();
+	for (auto p : m_iWaiting) {
+		if (p->m_nSocket < 0) {
+			continue;
+		}
+		__pollfd fd = {};
+		fd.fd = static_cast<decltype(fd.fd)>(p->m_nSocket);
+		fd.events = POLLIN;
+		fds.push_back(fd);
+		m_iPolled.push_back(p);
+	}
+	if (fds.empty()) {
+		return false;
+	}
+	if (__poll(fds.data(), fds.size(), static_cast<int>(wait)) <= 0) {
+		return true;
+	}
+	for (std::size_t i = 0; i < fds.size(); ++i) {
+		if (fds[i].revents) {
+			++m_iStats.Wakeups;
+			_Poll(*m_iPolled[i], 0);
+		}
+	}
+	return true;
+}
+
+
+void vsnc::forwarder::EventLoop::_Finish(Task::handle_type h) noexcept
+{
+	if (h.promise().error && !m_pError) {
+		m_pError = h.promise().error;
+	}
+	m_iTasks.erase(h.address());
+	h.destroy();
+}
@@ -0,0 +1,367 @@
+﻿/************************************************************************
+ * @ObjectName: event_loop.h
+ * @Description: 单线程协程事件循环，使大量会话以协程形式运行在少量线程上
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_EVENT_LOOP_H__
+#define __VSNC_FORWARDER_EVENT_LOOP_H__
+
+
+#include <coroutine>
+#include <exception>
+#include <deque>
+#include <vector>
+#include <unordered_set>
+#include <atomic>
+
+
+#include <stdint.h>
+
+
+#include <vsnc_utils/timer_wheel.h>
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		class EventLoop;
+
+
+		/// <summary>
+		/// <para>协程任务</para>
+		/// <para>惰性启动：创建后不执行，直到被co_await或交给EventLoop::Spawn；被co_await时结束后恢复等待者，并将异常传递给等待者</para>
+		/// </summary>
+		class Task
+		{
+		public:
+
+			/// <summary>
+			/// 协程承诺对象
+			/// </summary>
+			struct promise_type
+			{
+				/// <summary>等待本任务的协程</summary>
+				std::coroutine_handle<> continuation;
+				/// <summary>交给事件循环托管时所属的事件循环</summary>
+				EventLoop*              loop = nullptr;
+				/// <summary>协程中未捕获的异常</summary>
+				std::exception_ptr      error;
+
+				Task                get_return_object() noexcept { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				auto                final_suspend() noexcept;
+				void                return_void() noexcept {}
+				void                unhandled_exception() noexcept { error = std::current_exception(); }
+			};
+
+			/// <summary>协程句柄类型</summary>
+			using handle_type = std::coroutine_handle<promise_type>;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="h">协程句柄</param>
+			explicit Task(handle_type h) noexcept : m_hCoro(h) {}
+
+			/// <summary>
+			/// 移动构造函数
+			/// </summary>
+			/// <param name="other">被移动的任务</param>
+			Task(Task&& other) noexcept : m_hCoro(other.m_hCoro) { other.m_hCoro = nullptr; }
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			Task(const Task&) = delete;
+
+			/// <summary>
+			/// 析构函数，销毁尚未交出的协程
+			/// </summary>
+			~Task();
+
+			bool        await_ready() const noexcept { return !m_hCoro || m_hCoro.done(); }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) noexcept;
+			void        await_resume();
+
+			/// <summary>
+			/// 交出协程句柄，此后由调用方负责销毁
+			/// </summary>
+			/// <returns>协程句柄</returns>
+			handle_type Release() noexcept;
+
+		private:
+
+			/// <summary>协程句柄</summary>
+			handle_type m_hCoro;
+		};
+
+
+		/// <summary>
+		/// <para>可轮询的等待对象</para>
+		/// <para>Handle返回套接字的等待对象由就绪通知驱动：事件循环空闲时以poll（Windows上为WSAPoll）等待这些套接字可读，只在可读或到达Handle给出的时间时轮询，空闲会话不产生轮询</para>
+		/// <para>不提供套接字的等待对象只能轮询，等待期间按1、2、4…毫秒退避直至MaxPollInterval；等待对象完成时恢复挂起的协程</para>
+		/// <para>事件循环中只剩一个可阻塞的等待对象且没有就绪的协程时，事件循环直接以下一个定时器的等待时间阻塞在该对象上，因此单会话时的延迟与直接阻塞调用相同</para>
+		/// </summary>
+		class Poller
+		{
+			friend class EventLoop;
+
+		public:
+
+			/// <summary>
+			/// 虚默认析构函数
+			/// </summary>
+			virtual ~Poller() = default;
+
+			/// <summary>
+			/// 轮询一次
+			/// </summary>
+			/// <param name="wait">以毫秒为单位的允许阻塞的时间，0为不阻塞，小于0则阻塞</param>
+			/// <returns>已完成返回true</returns>
+			virtual bool Poll(const int64_t wait) = 0;
+
+			/// <summary>
+			/// 是否支持在Poll中阻塞
+			/// </summary>
+			/// <returns>支持返回true</returns>
+			virtual bool Blocking() const noexcept { return false; }
+
+			/// <summary>
+			/// 获取可等待可读的套接字，在每次未完成的Poll之后调用
+			/// </summary>
+			/// <param name="next">以__steady()毫秒计的最迟须再次Poll的时间</param>
+			/// <returns>套接字，不支持时返回-1，此时事件循环按退避轮询</returns>
+			virtual int  Handle(int64_t& next) noexcept { return -1; }
+
+		protected:
+
+			/// <summary>以__steady()毫秒计的截止时间，小于0为无限期；到达后事件循环不再轮询，以最后一次Poll留下的结果恢复协程</summary>
+			int64_t                                 m_nDeadline = -1;
+
+		private:
+
+			/// <summary>挂起的协程</summary>
+			std::coroutine_handle<>                 m_hWaiter;
+			/// <summary>以毫秒为单位的当前轮询间隔</summary>
+			int64_t                                 m_nInterval = 0;
+			/// <summary>最近一次Handle返回的套接字，-1为按退避轮询</summary>
+			int                                     m_nSocket = -1;
+			/// <summary>下一次轮询的定时器</summary>
+			utils::TimerWheel::timer_id             m_uTimer = utils::TimerWheel::Invalid_Timer;
+		};
+
+
+		/// <summary>
+		/// 事件循环参数
+		/// </summary>
+		struct EventLoopOptions
+		{
+			/// <summary>以毫秒为单位的轮询间隔上限，决定不提供套接字的空闲会话的轮询开销与首个数据包的最大附加延迟</summary>
+			int64_t MaxPollInterval = 16;
+			/// <summary>以毫秒为单位的Run期间请求的系统定时器精度，仅Windows有效，0为不修改；Windows默认以15.6毫秒的时钟中断唤醒休眠的线程，轮询退避的1、2、4毫秒会被取整为15.6毫秒</summary>
+			unsigned TimerResolution = 1;
+		};
+
+
+		/// <summary>
+		/// 事件循环统计信息
+		/// </summary>
+		struct EventLoopStats
+		{
+			/// <summary>存活的任务个数</summary>
+			std::size_t Tasks   = 0;
+			/// <summary>正在等待的等待对象个数</summary>
+			std::size_t Waiting = 0;
+			/// <summary>恢复协程的次数</summary>
+			uint64_t    Resumes = 0;
+			/// <summary>非阻塞轮询的次数</summary>
+			uint64_t    Polls   = 0;
+			/// <summary>允许阻塞的轮询次数</summary>
+			uint64_t    Blocks  = 0;
+			/// <summary>套接字可读而唤醒的次数</summary>
+			uint64_t    Wakeups = 0;
+		};
+
+
+		/// <summary>
+		/// <para>单线程协程事件循环</para>
+		/// <para>Spawn托管的任务在Run所在的线程中轮流执行，协程通过Sleep、Yield及Poller派生的等待对象挂起；多核时每个线程运行一个事件循环</para>
+		/// <para>除Stop外非线程安全</para>
+		/// </summary>
+		class EventLoop
+		{
+			friend struct Task::promise_type;
+
+		private:
+
+			/// <summary>
+			/// 定时恢复协程的等待对象
+			/// </summary>
+			struct __sleep_awaiter
+			{
+				EventLoop& loop;
+				int64_t    delay;
+
+				bool        await_ready() const noexcept { return false; }
+				void        await_suspend(std::coroutine_handle<> h);
+				void        await_resume() const noexcept {}
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="opts">参数</param>
+			explicit EventLoop(const EventLoopOptions& opts = EventLoopOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			EventLoop(const EventLoop&) = delete;
+
+			/// <summary>
+			/// 析构函数，销毁尚未结束的任务
+			/// </summary>
+			~EventLoop();
+
+			/// <summary>
+			/// 托管任务，在Run中开始执行
+			/// </summary>
+			/// <param name="task">任务</param>
+			void            Spawn(Task task);
+
+			/// <summary>
+			/// <para>运行事件循环，直到所有任务结束或Stop被调用</para>
+			/// <para>没有就绪的协程时等待提供套接字的等待对象可读，至多到下一个定时器到期；Windows下运行期间以timeBeginPeriod将系统定时器精度提高到TimerResolution，返回时恢复</para>
+			/// <para>任务中未捕获的异常会终止Run并被重新抛出</para>
+			/// </summary>
+			void            Run();
+
+			/// <summary>
+			/// 请求Run返回，可在其他线程中调用，在事件循环当前一次等待结束后生效
+			/// </summary>
+			void            Stop() noexcept { m_bRun.store(false); }
+
+			/// <summary>
+			/// 挂起当前协程指定的时间
+			/// </summary>
+			/// <param name="ms">以毫秒为单位的时间</param>
+			/// <returns>等待对象</returns>
+			__sleep_awaiter Sleep(const int64_t ms) noexcept { return __sleep_awaiter{ *this, ms }; }
+
+			/// <summary>
+			/// 让出执行权，待其他就绪协程执行后再继续
+			/// </summary>
+			/// <returns>等待对象</returns>
+			__sleep_awaiter Yield() noexcept { return __sleep_awaiter{ *this, 0 }; }
+
+			/// <summary>
+			/// <para>挂起协程直至等待对象完成，供Poller派生的等待对象在await_suspend中调用</para>
+			/// <para>调用前应先以Poll(0)确认尚未完成</para>
+			/// </summary>
+			/// <param name="poller">等待对象</param>
+			/// <param name="h">挂起的协程</param>
+			void            Watch(Poller& poller, std::coroutine_handle<> h);
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			EventLoopStats  GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 将协程放入就绪队列
+			/// </summary>
+			/// <param name="h">协程</param>
+			void            _Post(std::coroutine_handle<> h);
+
+			/// <summary>
+			/// 安排等待对象的下一次轮询
+			/// </summary>
+			/// <param name="poller">等待对象</param>
+			/// <param name="now">当前时间</param>
+			void            _Arm(Poller& poller, const int64_t now);
+
+			/// <summary>
+			/// 轮询等待对象，完成或超过截止时间时恢复协程
+			/// </summary>
+			/// <param name="poller">等待对象</param>
+			/// <param name="wait">允许阻塞的时间</param>
+			void            _Poll(Poller& poller, const int64_t wait);
+
+			/// <summary>
+			/// 等待提供套接字的等待对象可读，并轮询可读的等待对象
+			/// </summary>
+			/// <param name="wait">以毫秒为单位的最长等待时间，小于0则阻塞</param>
+			/// <returns>没有提供套接字的等待对象返回false</returns>
+			bool            _Wait(const int64_t wait);
+
+			/// <summary>
+			/// 托管的任务结束，在其final_suspend中调用
+			/// </summary>
+			/// <param name="h">任务的协程句柄</param>
+			void            _Finish(Task::handle_type h) noexcept;
+
+		private:
+
+			/// <summary>参数</summary>
+			const EventLoopOptions               m_iOpts;
+			/// <summary>定时器</summary>
+			utils::TimerWheel                    m_iWheel;
+			/// <summary>就绪的协程</summary>
+			std::deque<std::coroutine_handle<>>  m_iReady;
+			/// <summary>托管的任务</summary>
+			std::unordered_set<void*>            m_iTasks;
+			/// <summary>正在等待的等待对象</summary>
+			std::unordered_set<Poller*>          m_iWaiting;
+			/// <summary>本次等待中提供套接字的等待对象，与等待的套接字一一对应</summary>
+			std::vector<Poller*>                 m_iPolled;
+			/// <summary>取出的到期回调</summary>
+			std::vector<utils::TimerWheel::callback_type> m_iFired;
+			/// <summary>任务中未捕获的第一个异常</summary>
+			std::exception_ptr                   m_pError;
+			/// <summary>运行状态</summary>
+			std::atomic<bool>                    m_bRun;
+			/// <summary>统计信息</summary>
+			EventLoopStats                       m_iStats;
+		};
+
+
+		inline auto Task::promise_type::final_suspend() noexcept
+		{
+			struct __final_awaiter
+			{
+				bool        await_ready() const noexcept { return false; }
+				std::coroutine_handle<> await_suspend(Task::handle_type h) noexcept
+				{
+					auto& p = h.promise();
+					if (p.continuation) {
+						return p.continuation;
+					}
+					if (p.loop) {
+						p.loop->_Finish(h);
+					}
+					return std::noop_coroutine();
+				}
+				void        await_resume() const noexcept {}
+			};
+			return __final_awaiter{};
+		}
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_EVENT_LOOP_H__
@@ -0,0 +1,461 @@
+﻿/************************************************************************
+ * @ObjectName: fec.cpp
+ * @Description: 基于异或校验与Reed-Solomon码的前向纠错传输层
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "fec.h"
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+#include "gf256.h"
+#include "wire.h"
+
+
+namespace
+{
+	/// <summary>数据报类型：数据包</summary>
+	constexpr uint8_t Kind_Data   = 0;
+	/// <summary>数据报类型：校验包</summary>
+	constexpr uint8_t Kind_Parity = 1;
+
+	/// <summary>
+	/// 规范化参数：XOR方式固定一个校验包，数据包与校验包总数不超过256，窗口取2的幂以便块号回绕后仍可取模索引
+	/// </summary>
+	vsnc::forwarder::FecOptions normalize(vsnc::forwarder::FecOptions opts) noexcept
+	{
+		opts.Data = (std::max)(opts.Data, static_cast<uint8_t>(1));
+		opts.Parity = (vsnc::forwarder::fec_mode::XOR == opts.Mode) ? 1 : (std::max)(opts.Parity, static_cast<uint8_t>(1));
+		if (opts.Data + opts.Parity > 256) {
+			opts.Parity = static_cast<uint8_t>(256 - opts.Data);
+		}
+		std::size_t window = 1;
+		while ((window < opts.Window) && (window < 4096)) {
+			window <<= 1;
+		}
+		opts.Window = window;
+		return opts;
+	}
+
+	/// <summary>
+	/// Cauchy矩阵元素 1 / (x_i + y_j)，x_i = 255 - i，y_j = j
+	/// </summary>
+	/// <param name="i">校验包序号</param>
+	/// <param name="j">数据包序号</param>
+	/// <returns>编码系数</returns>
+	uint8_t cauchy(const std::size_t i, const std::size_t j) noexcept
+	{
+		return vsnc::forwarder::__gf_inv(static_cast<uint8_t>((255 - i) ^ j));
+	}
+
+	/// <summary>
+	/// 以高斯-约当消元求GF(2^8)上方阵的逆，Cauchy矩阵的方子阵总是可逆
+	/// </summary>
+	/// <param name="a">n×n矩阵，按行存放，求逆后被破坏</param>
+	/// <param name="inv">输出的逆矩阵</param>
+	/// <param name="n">阶数</param>
+	/// <returns>可逆返回true</returns>
+	bool invert(std::vector<uint8_t>& a, std::vector<uint8_t>& inv, const std::size_t n)
+	{
+		inv.assign(n * n, 0);
+		for (std::size_t i = 0; i < n; ++i) {
+			inv[i * n + i] = 1;
+		}
+		for (std::size_t c = 0; c < n; ++c) {
+			auto r = c;
+			while ((r < n) && !a[r * n + c]) {
+				++r;
+			}
+			if (r == n) {
+				return false;
+			}
+			if (r != c) {
+				std::swap_ranges(a.begin() + r * n, a.begin() + (r + 1) * n, a.begin() + c * n);
+				std::swap_ranges(inv.begin() + r * n, inv.begin() + (r + 1) * n, inv.begin() + c * n);
+			}
+			auto f = vsnc::forwarder::__gf_inv(a[c * n + c]);
+			for (std::size_t j = 0; j < n; ++j) {
+				a[c * n + j] = vsnc::forwarder::__gf_mul(a[c * n + j], f);
+				inv[c * n + j] = vsnc::forwarder::__gf_mul(inv[c * n + j], f);
+			}
+			for (std::size_t i = 0; i < n; ++i) {
+				auto g = a[i * n + c];
+				if ((i == c) || !g) {
+					continue;
+				}
+				for (std::size_t j = 0; j < n; ++j) {
+					a[i * n + j] ^= vsnc::forwarder::__gf_mul(a[c * n + j], g);
+					inv[i * n + j] ^= vsnc::forwarder::__gf_mul(inv[c * n + j], g);
+				}
+			}
+		}
+		return true;
+	}
+}
+
+
+constexpr std::size_t vsnc::forwarder::FecTransport::Header_Len;
+constexpr std::size_t vsnc::forwarder::FecTransport::Body_Prefix;
+
+
+vsnc::forwarder::FecTransport::FecTransport(Transport& lower, const FecOptions& opts, const std::size_t mtu) :
+	m_iLower(lower),
+	m_iOpts(normalize(opts)),
+	m_uMtu(mtu),
+	m_uBlock(0),
+	m_uCount(0),
+	m_uLastCount(0),
+	m_iShards(m_iOpts.Data),
+	m_iRecvBuf(mtu),
+	m_iBlocks(m_iOpts.Window),
+	m_uNewest(0),
+	m_bStarted(false)
+{
+	m_iSendBuf.reserve(mtu);
+}
+
+
+ssize_t vsnc::forwarder::FecTransport::Send(const utils::Memory<char>& mem, const int64_t ts)
+{
+	auto bodyLen = Body_Prefix + mem.Length();
+	if ((Header_Len + bodyLen > m_uMtu) || (mem.Length() > UINT16_MAX)) {
+		return -1;
+	}
+	m_iSendBuf.resize(Header_Len + bodyLen);
+	auto p = m_iSendBuf.data();
+	__put_u16(p, m_uBlock);
+	p[2] = static_cast<char>(m_uCount);
+	p[3] = static_cast<char>(m_iOpts.Data);
+	p[4] = static_cast<char>(m_iOpts.Parity);
+	p[5] = static_cast<char>(m_iOpts.Mode);
+	p[6] = static_cast<char>(Kind_Data);
+	p[7] = static_cast<char>(m_uLastCount);
+	__put_u16(p + Header_Len, static_cast<uint16_t>(mem.Length()));
+	__put_u64(p + Header_Len + 2, static_cast<uint64_t>(ts));
+	memcpy(p + Header_Len + Body_Prefix, mem.Data(), mem.Length());
+	utils::BasicMemory<char> out(m_iSendBuf.data(), m_iSendBuf.size());
+	if (m_iLower.Send(out, ts) < 0) {
+		return -1;
+	}
+	++m_iStats.DataSent;
+	auto body = reinterpret_cast<const uint8_t*>(p + Header_Len);
+	m_iShards[m_uCount].assign(body, body + bodyLen);
+	if (++m_uCount == m_iOpts.Data) {
+		_EmitParity();
+	}
+	return static_cast<ssize_t>(mem.Length());
+}
+
+
+ssize_t vsnc::forwarder::FecTransport::Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout)
+{
+	if (!m_iReady.empty()) {
+		return _Pop(mem, ts);
+	}
+	auto start = std::chrono::steady_clock::now();
+	auto wait = timeout;
+	while (true) {
+		utils::BasicMemory<char> buf(m_iRecvBuf.data(), m_iRecvBuf.size());
+		int64_t rts = 0;
+		auto ret = m_iLower.Receive(buf, rts, wait);
+		if (ret <= 0) {
+			return ret;
+		}
+		auto len = _Input(static_cast<std::size_t>(ret), mem, ts);
+		if (0 != len) {
+			return len;
+		}
+		if (!m_iReady.empty()) {
+			return _Pop(mem, ts);
+		}
+		if (timeout > 0) {
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			wait = (std::max)(timeout - static_cast<int64_t>(elapsed), static_cast<int64_t>(0));
+		}
+	}
+}
+
+
+bool vsnc::forwarder::FecTransport::Flush()
+{
+	return _EmitParity();
+}
+
+
+bool vsnc::forwarder::FecTransport::_EmitParity()
+{
+	if (!m_uCount) {
+		return true;
+	}
+	std::size_t len = 0;
+	for (uint8_t j = 0; j < m_uCount; ++j) {
+		len = (std::max)(len, m_iShards[j].size());
+	}
+	auto ok = true;
+	for (uint8_t i = 0; i < m_iOpts.Parity; ++i) {
+		m_iSendBuf.assign(Header_Len + len, 0);
+		auto p = m_iSendBuf.data();
+		__put_u16(p, m_uBlock);
+		p[2] = static_cast<char>(i);
+		p[3] = static_cast<char>(m_uCount);
+		p[4] = static_cast<char>(m_iOpts.Parity);
+		p[5] = static_cast<char>(m_iOpts.Mode);
+		p[6] = static_cast<char>(Kind_Parity);
+		auto dst = reinterpret_cast<uint8_t*>(p + Header_Len);
+		for (uint8_t j = 0; j < m_uCount; ++j) {
+			auto& shard = m_iShards[j];
+			if (fec_mode::XOR == m_iOpts.Mode) {
+				__xor_region(dst, shard.data(), shard.size());
+			}
+			else {
+				__gf_mul_add(dst, shard.data(), cauchy(i, j), shard.size());
+			}
+		}
+		utils::BasicMemory<char> out(m_iSendBuf.data(), m_iSendBuf.size());
+		if (m_iLower.Send(out, 0) < 0) {
+			ok = false;
+			continue;
+		}
+		++m_iStats.ParitySent;
+	}
+	++m_uBlock;
+	m_uLastCount = m_uCount;
+	m_uCount = 0;
+	return ok;
+}
+
+
+ssize_t vsnc::forwarder::FecTransport::_Input(const std::size_t len, utils::Memory<char>& mem, int64_t& ts)
+{
+	auto p = m_iRecvBuf.data();
+	if (len < Header_Len) {
+		++m_iStats.Malformed;
+		return 0;
+	}
+	auto id = __get_u16(p);
+	auto index = static_cast<uint8_t>(p[2]);
+	auto k = static_cast<uint8_t>(p[3]);
+	auto m = static_cast<uint8_t>(p[4]);
+	auto mode = static_cast<uint8_t>(p[5]);
+	auto kind = static_cast<uint8_t>(p[6]);
+	auto body = reinterpret_cast<const uint8_t*>(p + Header_Len);
+	auto bodyLen = len - Header_Len;
+	auto valid = k && m && (k + m <= 256) && (mode <= static_cast<uint8_t>(fec_mode::RS));
+	if (Kind_Data == kind) {
+		valid = valid && (index < k) && (bodyLen >= Body_Prefix) && (__get_u16(p + Header_Len) + Body_Prefix == bodyLen);
+	}
+	else {
+		valid = valid && (Kind_Parity == kind) && (index < m);
+	}
+	if (!valid) {
+		++m_iStats.Malformed;
+		return 0;
+	}
+	auto b = _Block(id);
+	if (b && !b->m) {
+		if (!b->sealed) {
+			b->k = k;
+		}
+		b->m = m;
+		b->mode = static_cast<fec_mode>(mode);
+	}
+	if ((Kind_Data == kind) && p[7]) {
+		_Seal(static_cast<uint16_t>(id - 1), static_cast<uint8_t>(p[7]));
+	}
+	if (Kind_Parity == kind) {
+		++m_iStats.ParityReceived;
+		if (!b || b->done || b->present[255 - index]) {
+			return 0;
+		}
+		if (!b->sealed) {
+			b->sealed = true;
+			b->k = k;
+		}
+		b->present.set(255 - index);
+		b->shards[255 - index].assign(body, body + bodyLen);
+		_Recover(*b);
+		return 0;
+	}
+	++m_iStats.DataReceived;
+	if (b && b->present[index]) {
+		return 0;
+	}
+	auto n = bodyLen - Body_Prefix;
+	if (n > mem.Length()) {
+		return -1;
+	}
+	memcpy(mem.Data(), body + Body_Prefix, n);
+	ts = static_cast<int64_t>(__get_u64(p + Header_Len + 2));
+	if (b) {
+		b->present.set(index);
+		b->seen = (std::max)(b->seen, static_cast<uint8_t>(index + 1));
+		if (!b->done) {
+			b->shards[index].assign(body, body + bodyLen);
+			_Recover(*b);
+		}
+	}
+	return static_cast<ssize_t>(n);
+}
+
+
+vsnc::forwarder::FecTransport::__block* vsnc::forwarder::FecTransport::_Block(const uint16_t id)
+{
+	if (!m_bStarted) {
+		m_bStarted = true;
+		m_uNewest = id;
+	}
+	auto diff = static_cast<int16_t>(id - m_uNewest);
+	if (diff > 0) {
+		m_uNewest = id;
+	}
+	else if (-diff >= static_cast<int>(m_iBlocks.size())) {
+		return nullptr;
+	}
+	auto& b = m_iBlocks[id & (m_iBlocks.size() - 1)];
+	if (b.used && (b.id == id)) {
+		return &b;
+	}
+	if (b.used && !b.done) {
+		// 数据包中携带的是配置的块长，Flush提前结束的块中未发送的序号不算丢失
+		auto sent = b.sealed ? b.k : b.seen;
+		for (uint8_t j = 0; j < sent; ++j) {
+			if (!b.present[j]) {
+				++m_iStats.Lost;
+			}
+		}
+	}
+	b.id = id;
+	b.used = true;
+	b.done = false;
+	b.sealed = false;
+	b.k = 0;
+	b.seen = 0;
+	b.m = 0;
+	b.present.reset();
+	if (b.shards.empty()) {
+		b.shards.resize(256);
+	}
+	return &b;
+}
+
+
+void vsnc::forwarder::FecTransport::_Seal(const uint16_t id, const uint8_t k)
+{
+	auto b = _Block(id);
+	if (!b || b->done || b->sealed || (b->k && (k > b->k)) || (k < b->seen)) {
+		return;
+	}
+	// 整块丢失时由此建立的块也可在被覆盖时统计丢失
+	b->sealed = true;
+	b->k = k;
+	if (b->m) {
+		_Recover(*b);
+	}
+}
+
+
+void vsnc::forwarder::FecTransport::_Recover(__block& b)
+{
+	std::vector<uint8_t> missing;
+	std::vector<uint8_t> parity;
+	for (uint8_t j = 0; j < b.k; ++j) {
+		if (!b.present[j]) {
+			missing.push_back(j);
+		}
+	}
+	if (missing.empty()) {
+		b.done = b.sealed || (b.k == m_iOpts.Data);
+		return;
+	}
+	for (std::size_t i = 0; (i < b.m) && (parity.size() < missing.size()); ++i) {
+		if (b.present[255 - i]) {
+			parity.push_back(static_cast<uint8_t>(i));
+		}
+	}
+	if (!b.sealed || (parity.size() < missing.size())) {
+		return;
+	}
+	auto len = b.shards[255 - parity[0]].size();
+	auto e = missing.size();
+	// 从校验包中消去已收到的数据包，得到只含丢失数据包的e元方程组
+	std::vector<std::vector<uint8_t>> rhs(e);
+	for (std::size_t a = 0; a < e; ++a) {
+		rhs[a] = b.shards[255 - parity[a]];
+		rhs[a].resize(len, 0);
+		for (uint8_t j = 0; j < b.k; ++j) {
+			if (!b.present[j]) {
+				continue;
+			}
+			auto& shard = b.shards[j];
+			auto n = (std::min)(shard.size(), len);
+			if (fec_mode::XOR == b.mode) {
+				__xor_region(rhs[a].data(), shard.data(), n);
+			}
+			else {
+				__gf_mul_add(rhs[a].data(), shard.data(), cauchy(parity[a], j), n);
+			}
+		}
+	}
+	if (fec_mode::XOR == b.mode) {
+		_Deliver(rhs[0]);
+	}
+	else {
+		std::vector<uint8_t> a(e * e), inv;
+		for (std::size_t r = 0; r < e; ++r) {
+			for (std::size_t c = 0; c < e; ++c) {
+				a[r * e + c] = cauchy(parity[r], missing[c]);
+			}
+		}
+		if (!invert(a, inv, e)) {
+			return;
+		}
+		std::vector<uint8_t> out;
+		for (std::size_t c = 0; c < e; ++c) {
+			out.assign(len, 0);
+			for (std::size_t r = 0; r < e; ++r) {
+				__gf_mul_add(out.data(), rhs[r].data(), inv[c * e + r], len);
+			}
+			_Deliver(out);
+		}
+	}
+	for (auto j : missing) {
+		b.present.set(j);
+	}
+	m_iStats.Recovered += e;
+	b.done = true;
+}
+
+
+void vsnc::forwarder::FecTransport::_Deliver(const std::vector<uint8_t>& body)
+{
+	if (body.size() < Body_Prefix) {
+		return;
+	}
+	auto p = reinterpret_cast<const char*>(body.data());
+	std::size_t n = __get_u16(p);
+	if (n + Body_Prefix > body.size()) {
+		return;
+	}
+	__packet pkt;
+	pkt.ts = static_cast<int64_t>(__get_u64(p + 2));
+	pkt.data.assign(p + Body_Prefix, p + Body_Prefix + n);
+	m_iReady.push_back(std::move(pkt));
+}
+
+
+ssize_t vsnc::forwarder::FecTransport::_Pop(utils::Memory<char>& mem, int64_t& ts)
+{
+	auto& pkt = m_iReady.front();
+	if (pkt.data.size() > mem.Length()) {
+		return -1;
+	}
+	auto len = pkt.data.size();
+	memcpy(mem.Data(), pkt.data.data(), len);
+	ts = pkt.ts;
+	m_iReady.pop_front();
+	return static_cast<ssize_t>(len);
+}
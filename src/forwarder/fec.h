@@ -0,0 +1,279 @@
+﻿/************************************************************************
+ * @ObjectName: fec.h
+ * @Description: 基于异或校验与Reed-Solomon码的前向纠错传输层
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_FEC_H__
+#define __VSNC_FORWARDER_FEC_H__
+
+
+#include <vector>
+#include <deque>
+#include <bitset>
+
+
+#include <stdint.h>
+
+
+#include "transport.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 纠错编码方式
+		/// </summary>
+		enum class fec_mode : int8_t
+		{
+			/// <summary>异或校验，每块只有一个校验包</summary>
+			XOR,
+			/// <summary>GF(2^8)上的Cauchy Reed-Solomon码</summary>
+			RS
+		};
+
+
+		/// <summary>
+		/// 前向纠错参数
+		/// </summary>
+		struct FecOptions
+		{
+			/// <summary>编码方式</summary>
+			fec_mode    Mode   = fec_mode::RS;
+			/// <summary>每块的数据包个数</summary>
+			uint8_t     Data   = 8;
+			/// <summary>每块的校验包个数，XOR方式下固定为1</summary>
+			uint8_t     Parity = 2;
+			/// <summary>接收端同时保留的块数</summary>
+			std::size_t Window = 32;
+		};
+
+
+		/// <summary>
+		/// 前向纠错统计信息
+		/// </summary>
+		struct FecStats
+		{
+			/// <summary>发出的数据包个数</summary>
+			uint64_t DataSent       = 0;
+			/// <summary>发出的校验包个数</summary>
+			uint64_t ParitySent     = 0;
+			/// <summary>收到的数据包个数</summary>
+			uint64_t DataReceived   = 0;
+			/// <summary>收到的校验包个数</summary>
+			uint64_t ParityReceived = 0;
+			/// <summary>通过校验包恢复的数据包个数</summary>
+			uint64_t Recovered      = 0;
+			/// <summary>
+			/// <para>未能恢复的数据包个数</para>
+			/// <para>块被覆盖时统计，Flush提前结束的块按校验包或下一块数据包中携带的实际个数统计；两者均未收到时只统计最后一个收到的数据包之前的丢失</para>
+			/// </summary>
+			uint64_t Lost           = 0;
+			/// <summary>格式错误而丢弃的数据报个数</summary>
+			uint64_t Malformed      = 0;
+		};
+
+
+		/// <summary>
+		/// <para>前向纠错传输层</para>
+		/// <para>发送端每k个数据包组成一块并追加m个校验包；数据包立即发出，校验包在块满或调用Flush时发出</para>
+		/// <para>接收端数据包到达即交付，块内收到任意k个包后恢复丢失的数据包，恢复出的数据包在随后的Receive中交付</para>
+		/// <para>每个数据报前附加8字节的纠错头：块号（2字节）、块内序号、数据包个数、校验包个数、编码方式、类型，数据包的最后1字节为上一块的实际数据包个数（0为未知），校验包的为保留字节</para>
+		/// <para>非线程安全，应在同一线程中使用</para>
+		/// </summary>
+		class FecTransport final : public Transport
+		{
+		public:
+
+			/// <summary>纠错头长度</summary>
+			static constexpr std::size_t Header_Len = 8;
+
+			/// <summary>编码体中长度与时间戳字段的长度</summary>
+			static constexpr std::size_t Body_Prefix = 10;
+
+		private:
+
+			/// <summary>
+			/// 接收端的一个块
+			/// </summary>
+			struct __block
+			{
+				/// <summary>块号</summary>
+				uint16_t                          id      = 0;
+				/// <summary>是否正在使用</summary>
+				bool                              used    = false;
+				/// <summary>是否已完成恢复或无需恢复</summary>
+				bool                              done    = false;
+				/// <summary>是否已由校验包或下一块的数据包确定数据包个数</summary>
+				bool                              sealed  = false;
+				/// <summary>数据包个数</summary>
+				uint8_t                           k       = 0;
+				/// <summary>收到的最大数据包序号加1，数据包个数未确定时只有此前的序号确定已发送</summary>
+				uint8_t                           seen    = 0;
+				/// <summary>校验包个数</summary>
+				uint8_t                           m       = 0;
+				/// <summary>编码方式</summary>
+				fec_mode                          mode    = fec_mode::RS;
+				/// <summary>已收到的包，数据包j位于第j位，校验包i位于第255-i位</summary>
+				std::bitset<256>                  present;
+				/// <summary>各包的编码体，下标同present</summary>
+				std::vector<std::vector<uint8_t>> shards;
+			};
+
+			/// <summary>
+			/// 恢复出的待交付数据包
+			/// </summary>
+			struct __packet
+			{
+				/// <summary>时间戳</summary>
+				int64_t           ts;
+				/// <summary>数据</summary>
+				std::vector<char> data;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="lower">下层传输</param>
+			/// <param name="opts">纠错参数</param>
+			/// <param name="mtu">下层单个数据报的最大长度</param>
+			FecTransport(Transport& lower, const FecOptions& opts = FecOptions(), const std::size_t mtu = 1504);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			FecTransport(const FecTransport&) = delete;
+
+			/// <summary>
+			/// 发送数据包，块满时随后发送校验包
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回数据长度，失败返回-1</returns>
+			ssize_t  Send(const utils::Memory<char>& mem, const int64_t ts) override;
+
+			/// <summary>
+			/// 接收数据包，优先交付已恢复的数据包
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，失败返回-1，超时返回-2</returns>
+			ssize_t  Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override;
+
+			/// <summary>
+			/// 获取下层等待可读的套接字
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的最迟须再次调用Receive的时间</param>
+			/// <returns>套接字，不支持时返回-1</returns>
+			int      Handle(int64_t& next) noexcept override { return m_iLower.Handle(next); }
+
+			/// <summary>
+			/// 以当前已发送的数据包结束本块并发送校验包，用于在发送间歇中保证末尾的数据包也可恢复
+			/// </summary>
+			/// <returns>成功返回true，下层发送失败返回false</returns>
+			bool     Flush();
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			FecStats GetStats() const noexcept { return m_iStats; }
+
+		private:
+
+			/// <summary>
+			/// 计算并发送当前块的校验包
+			/// </summary>
+			/// <returns>成功返回true，失败返回false</returns>
+			bool     _EmitParity();
+
+			/// <summary>
+			/// 处理收到的数据报
+			/// </summary>
+			/// <param name="len">数据报长度</param>
+			/// <param name="mem">接收缓冲区，数据报为数据包时将其写入</param>
+			/// <param name="ts">数据包时间戳</param>
+			/// <returns>数据报为数据包时返回其长度，否则返回0，缓冲区过小返回-1</returns>
+			ssize_t  _Input(const std::size_t len, utils::Memory<char>& mem, int64_t& ts);
+
+			/// <summary>
+			/// 获取块号对应的块，旧块被覆盖时统计其中未恢复的数据包
+			/// </summary>
+			/// <param name="id">块号</param>
+			/// <returns>块，块号早于窗口时返回nullptr</returns>
+			__block* _Block(const uint16_t id);
+
+			/// <summary>
+			/// 以下一块数据包中携带的个数确定上一块的数据包个数
+			/// </summary>
+			/// <param name="id">上一块的块号</param>
+			/// <param name="k">上一块的数据包个数</param>
+			void     _Seal(const uint16_t id, const uint8_t k);
+
+			/// <summary>
+			/// 收到足够的包后恢复丢失的数据包
+			/// </summary>
+			/// <param name="b">块</param>
+			void     _Recover(__block& b);
+
+			/// <summary>
+			/// 将编码体解析为数据包并放入待交付队列
+			/// </summary>
+			/// <param name="body">编码体</param>
+			void     _Deliver(const std::vector<uint8_t>& body);
+
+			/// <summary>
+			/// 从待交付队列取出一个数据包
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回数据长度，缓冲区过小返回-1</returns>
+			ssize_t  _Pop(utils::Memory<char>& mem, int64_t& ts);
+
+		private:
+
+			/// <summary>下层传输</summary>
+			Transport&                        m_iLower;
+			/// <summary>纠错参数</summary>
+			const FecOptions                  m_iOpts;
+			/// <summary>下层单个数据报的最大长度</summary>
+			const std::size_t                 m_uMtu;
+			/// <summary>发送端当前块号</summary>
+			uint16_t                          m_uBlock;
+			/// <summary>发送端当前块中已发送的数据包个数</summary>
+			uint8_t                           m_uCount;
+			/// <summary>发送端上一块的数据包个数，在本块的数据包中携带</summary>
+			uint8_t                           m_uLastCount;
+			/// <summary>发送端当前块中各数据包的编码体</summary>
+			std::vector<std::vector<uint8_t>> m_iShards;
+			/// <summary>发送缓冲区</summary>
+			std::vector<char>                 m_iSendBuf;
+			/// <summary>接收缓冲区</summary>
+			std::vector<char>                 m_iRecvBuf;
+			/// <summary>接收端按块号取模索引的块</summary>
+			std::vector<__block>              m_iBlocks;
+			/// <summary>接收端见过的最新块号</summary>
+			uint16_t                          m_uNewest;
+			/// <summary>是否已收到过数据报</summary>
+			bool                              m_bStarted;
+			/// <summary>已恢复待交付的数据包</summary>
+			std::deque<__packet>              m_iReady;
+			/// <summary>统计信息</summary>
+			FecStats                          m_iStats;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_FEC_H__
@@ -0,0 +1,341 @@
+﻿/************************************************************************
+ * @ObjectName: fragment.cpp
+ * @Description: 大消息的分片发送与池化缓冲区中的重组
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "fragment.h"
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+#include "wire.h"
+
+
+namespace
+{
+	/// <summary>最小尺寸等级的缓冲区容量</summary>
+	constexpr std::size_t Min_Class_Size = 4 * 1024;
+
+	int64_t nowMilliseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+
+constexpr std::size_t vsnc::forwarder::FragmentTransport::Header_Len;
+
+
+vsnc::forwarder::FragmentTransport::FragmentTransport(Transport& lower, const FragmentOptions& opts, const std::size_t mtu) :
+	m_iLower(lower),
+	m_iOpts(opts),
+	m_uMtu(mtu),
+	m_uNextId(0),
+	m_iRecvBuf(mtu),
+	m_uPendingBytes(0),
+	m_uPooledBytes(0)
+{
+	m_iSendBuf.reserve(mtu);
+	auto classes = _Class(opts.MaxMessage) + 1;
+	for (std::size_t cls = 0; cls < classes; ++cls) {
+		auto cap = Min_Class_Size << cls;
+		m_iPools.emplace_back(new __pool_type([cap]() {
+			auto buf = std::make_shared<std::vector<char>>();
+			buf->reserve(cap);
+			return buf;
+		}, (std::max)(opts.PoolPerClass, static_cast<std::size_t>(1))));
+	}
+}
+
+
+ssize_t vsnc::forwarder::FragmentTransport::Send(const utils::Memory<char>& mem, const int64_t ts)
+{
+	auto total = mem.Length();
+	auto frag = m_uMtu - Header_Len;
+	auto count = (std::max)((total + frag - 1) / frag, static_cast<std::size_t>(1));
+	if ((total > m_iOpts.MaxMessage) || (count > UINT16_MAX)) {
+		return -1;
+	}
+	auto id = m_uNextId++;
+	for (std::size_t index = 0; index < count; ++index) {
+		auto offset = index * frag;
+		auto len = (std::min)(frag, total - offset);
+		m_iSendBuf.resize(Header_Len + len);
+		auto p = m_iSendBuf.data();
+		__put_u32(p, id);
+		__put_u16(p + 4, static_cast<uint16_t>(index));
+		__put_u16(p + 6, static_cast<uint16_t>(count));
+		__put_u32(p + 8, static_cast<uint32_t>(total));
+		memcpy(p + Header_Len, mem.Data() + offset, len);
+		utils::BasicMemory<char> out(m_iSendBuf.data(), m_iSendBuf.size());
+		if (m_iLower.Send(out, ts) < 0) {
+			return -1;
+		}
+		++m_iStats.FragmentsSent;
+	}
+	++m_iStats.MessagesSent;
+	return static_cast<ssize_t>(total);
+}
+
+
+ssize_t vsnc::forwarder::FragmentTransport::Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout)
+{
+	auto start = nowMilliseconds();
+	auto wait = timeout;
+	while (true) {
+		auto ret = _Wait(wait);
+		if (ret <= 0) {
+			return ret;
+		}
+		if (m_iReady.front().buf->size() <= mem.Length()) {
+			break;
+		}
+		// 丢弃而不返回-1，调用者会把-1当作连接关闭
+		++m_iStats.Oversize;
+		Recycle(std::move(m_iReady.front().buf));
+		m_iReady.pop_front();
+		if (timeout >= 0) {
+			wait = (std::max)(timeout - (nowMilliseconds() - start), static_cast<int64_t>(0));
+		}
+	}
+	auto& msg = m_iReady.front();
+	auto len = msg.buf->size();
+	memcpy(mem.Data(), msg.buf->data(), len);
+	ts = msg.ts;
+	Recycle(std::move(msg.buf));
+	m_iReady.pop_front();
+	return static_cast<ssize_t>(len);
+}
+
+
+ssize_t vsnc::forwarder::FragmentTransport::ReceiveMessage(buffer_type& buf, int64_t& ts, const int64_t timeout)
+{
+	auto ret = _Wait(timeout);
+	if (ret <= 0) {
+		return ret;
+	}
+	auto& msg = m_iReady.front();
+	buf = std::move(msg.buf);
+	ts = msg.ts;
+	m_iReady.pop_front();
+	return static_cast<ssize_t>(buf->size());
+}
+
+
+void vsnc::forwarder::FragmentTransport::Recycle(buffer_type buf)
+{
+	if (!buf) {
+		return;
+	}
+	auto cap = buf->capacity();
+	auto cls = _Class(cap);
+	// 超出最大等级或容量不是等级尺寸的缓冲区不是从池中取得的，直接释放；缓存后会超出内存上限的也直接释放
+	if ((cls >= m_iPools.size()) || (cap != (Min_Class_Size << cls)) || (m_uPendingBytes + m_uPooledBytes + cap > m_iOpts.MaxBytes)) {
+		return;
+	}
+	auto& pool = *m_iPools[cls];
+	auto size = pool.Size();
+	buf->clear();
+	pool.Push(std::move(buf));
+	if (pool.Size() > size) {
+		m_uPooledBytes += cap;
+	}
+}
+
+
+vsnc::forwarder::FragmentStats vsnc::forwarder::FragmentTransport::GetStats() const noexcept
+{
+	auto stats = m_iStats;
+	stats.PendingBytes = m_uPendingBytes;
+	stats.PooledBytes = m_uPooledBytes;
+	return stats;
+}
+
+
+ssize_t vsnc::forwarder::FragmentTransport::_Wait(const int64_t timeout)
+{
+	auto start = nowMilliseconds();
+	auto wait = timeout;
+	while (m_iReady.empty()) {
+		utils::BasicMemory<char> buf(m_iRecvBuf.data(), m_iRecvBuf.size());
+		int64_t ts = 0;
+		auto ret = m_iLower.Receive(buf, ts, wait);
+		auto now = nowMilliseconds();
+		_Expire(now, 0);
+		if (ret <= 0) {
+			return ret;
+		}
+		_Input(static_cast<std::size_t>(ret), ts, now);
+		if (timeout >= 0) {
+			wait = (std::max)(timeout - (now - start), static_cast<int64_t>(0));
+		}
+	}
+	return 1;
+}
+
+
+void vsnc::forwarder::FragmentTransport::_Input(const std::size_t len, const int64_t ts, const int64_t now)
+{
+	if (len < Header_Len) {
+		++m_iStats.Discarded;
+		return;
+	}
+	auto p = m_iRecvBuf.data();
+	auto id = __get_u32(p);
+	std::size_t index = __get_u16(p + 4);
+	std::size_t count = __get_u16(p + 6);
+	std::size_t total = __get_u32(p + 8);
+	auto n = len - Header_Len;
+
+	// 非末尾分片等长，其位置为序号乘以分片长度；末尾分片对齐到消息末尾
+	auto last = (index + 1 == count);
+	auto pos = last ? (total - n) : (index * n);
+	auto valid = (index < count) && (total <= m_iOpts.MaxMessage) && (n <= total) && (pos + n <= total);
+	valid = valid && (last || ((n > 0) && ((total + n - 1) / n == count)));
+	// 单分片的消息必须完整，否则缓冲区尾部是上一次使用留下的数据
+	valid = valid && ((1 != count) || (n == total));
+	if (!valid) {
+		++m_iStats.Discarded;
+		return;
+	}
+	++m_iStats.FragmentsReceived;
+
+	if (1 == count) {
+		__ready msg;
+		msg.buf = _Acquire(total);
+		msg.ts = ts;
+		memcpy(msg.buf->data(), p + Header_Len, n);
+		m_iReady.push_back(std::move(msg));
+		++m_iStats.MessagesReceived;
+		return;
+	}
+
+	auto iter = m_iPending.find(id);
+	if (m_iPending.end() == iter) {
+		_Expire(now, _Capacity(total));
+		__message msg;
+		msg.buf = _Acquire(total);
+		msg.got.assign(count, false);
+		msg.received = 0;
+		msg.frag = 0;
+		msg.tail = 0;
+		msg.ts = ts;
+		msg.first = now;
+		m_uPendingBytes += msg.buf->capacity();
+		iter = m_iPending.emplace(id, std::move(msg)).first;
+		m_iOrder.push_back(id);
+		_Trim();
+	}
+	auto& msg = iter->second;
+	// 非末尾分片必须与首个非末尾分片等长，末尾分片的位置必须紧接在前面的分片之后，否则分片会互相覆盖或留下空洞
+	auto frag = last ? msg.frag : n;
+	auto tail = last ? n : msg.tail;
+	if ((msg.got.size() != count) || (msg.buf->size() != total) || msg.got[index]
+		|| (!last && msg.frag && (n != msg.frag))
+		|| (frag && tail && ((count - 1) * frag + tail != total))) {
+		++m_iStats.Discarded;
+		return;
+	}
+	msg.frag = frag;
+	msg.tail = tail;
+	memcpy(msg.buf->data() + pos, p + Header_Len, n);
+	msg.got[index] = true;
+	if (++msg.received < count) {
+		return;
+	}
+	__ready done;
+	m_uPendingBytes -= msg.buf->capacity();
+	done.buf = std::move(msg.buf);
+	done.ts = msg.ts;
+	m_iReady.push_back(std::move(done));
+	m_iPending.erase(iter);
+	++m_iStats.MessagesReceived;
+}
+
+
+void vsnc::forwarder::FragmentTransport::_Expire(const int64_t now, const std::size_t incoming)
+{
+	while (!m_iOrder.empty()) {
+		auto id = m_iOrder.front();
+		auto iter = m_iPending.find(id);
+		if (m_iPending.end() == iter) {
+			m_iOrder.pop_front();
+			continue;
+		}
+		if (now - iter->second.first > m_iOpts.Timeout) {
+			++m_iStats.Timeouts;
+		}
+		else if (incoming && ((m_iPending.size() >= m_iOpts.MaxPending) || (m_uPendingBytes + incoming > m_iOpts.MaxBytes))) {
+			++m_iStats.Evicted;
+		}
+		else {
+			break;
+		}
+		_Drop(id);
+		m_iOrder.pop_front();
+	}
+}
+
+
+void vsnc::forwarder::FragmentTransport::_Drop(const uint32_t id)
+{
+	auto iter = m_iPending.find(id);
+	if (m_iPending.end() == iter) {
+		return;
+	}
+	m_uPendingBytes -= iter->second.buf->capacity();
+	Recycle(std::move(iter->second.buf));
+	m_iPending.erase(iter);
+}
+
+
+vsnc::forwarder::FragmentTransport::buffer_type vsnc::forwarder::FragmentTransport::_Acquire(const std::size_t len)
+{
+	auto cls = _Class(len);
+	if (cls >= m_iPools.size()) {
+		return std::make_shared<std::vector<char>>(len);
+	}
+	auto& pool = *m_iPools[cls];
+	if (!pool.Empty()) {
+		m_uPooledBytes -= Min_Class_Size << cls;
+	}
+	auto buf = pool.Front();
+	pool.Pop();
+	// 容量已按等级预留，resize不会重新分配
+	buf->resize(len);
+	return buf;
+}
+
+
+void vsnc::forwarder::FragmentTransport::_Trim()
+{
+	// 从最大的等级开始释放，以最少的缓冲区腾出空间
+	for (auto cls = m_iPools.size(); cls-- > 0;) {
+		auto& pool = *m_iPools[cls];
+		while ((m_uPendingBytes + m_uPooledBytes > m_iOpts.MaxBytes) && !pool.Empty()) {
+			pool.Pop();
+			m_uPooledBytes -= Min_Class_Size << cls;
+		}
+	}
+}
+
+
+std::size_t vsnc::forwarder::FragmentTransport::_Class(const std::size_t len) noexcept
+{
+	std::size_t cls = 0;
+	while ((Min_Class_Size << cls) < len) {
+		++cls;
+	}
+	return cls;
+}
+
+
+std::size_t vsnc::forwarder::FragmentTransport::_Capacity(const std::size_t len) const noexcept
+{
+	auto cls = _Class(len);
+	return (cls < m_iPools.size()) ? (Min_Class_Size << cls) : len;
+}
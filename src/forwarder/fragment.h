@@ -0,0 +1,286 @@
+﻿/************************************************************************
+ * @ObjectName: fragment.h
+ * @Description: 大消息的分片发送与池化缓冲区中的重组
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_FRAGMENT_H__
+#define __VSNC_FORWARDER_FRAGMENT_H__
+
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+
+#include <stdint.h>
+
+
+#include <vsnc_utils/object_pool.h>
+
+
+#include "transport.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 分片参数
+		/// </summary>
+		struct FragmentOptions
+		{
+			/// <summary>单个消息的最大长度</summary>
+			std::size_t MaxMessage   = 4 * 1024 * 1024;
+			/// <summary>正在重组的消息个数上限</summary>
+			std::size_t MaxPending   = 64;
+			/// <summary>正在重组的消息与缓冲池中缓存的缓冲区按容量计的总字节数上限</summary>
+			std::size_t MaxBytes     = 16 * 1024 * 1024;
+			/// <summary>以毫秒为单位的重组超时时间，超时未收齐的消息被丢弃</summary>
+			int64_t     Timeout      = 1000;
+			/// <summary>每种尺寸的缓冲区最多缓存的个数，至少为1</summary>
+			std::size_t PoolPerClass = 8;
+		};
+
+
+		/// <summary>
+		/// 分片统计信息
+		/// </summary>
+		struct FragmentStats
+		{
+			/// <summary>发出的消息个数</summary>
+			uint64_t    MessagesSent      = 0;
+			/// <summary>发出的分片个数</summary>
+			uint64_t    FragmentsSent     = 0;
+			/// <summary>重组完成的消息个数</summary>
+			uint64_t    MessagesReceived  = 0;
+			/// <summary>收到的分片个数</summary>
+			uint64_t    FragmentsReceived = 0;
+			/// <summary>重组超时而丢弃的消息个数</summary>
+			uint64_t    Timeouts          = 0;
+			/// <summary>超出个数或内存上限而丢弃的消息个数</summary>
+			uint64_t    Evicted           = 0;
+			/// <summary>重复或格式错误而丢弃的分片个数</summary>
+			uint64_t    Discarded         = 0;
+			/// <summary>因接收缓冲区过小而被Receive丢弃的消息个数</summary>
+			uint64_t    Oversize          = 0;
+			/// <summary>正在重组的消息按缓冲区容量计的字节数</summary>
+			std::size_t PendingBytes      = 0;
+			/// <summary>缓冲池中缓存的字节数</summary>
+			std::size_t PooledBytes       = 0;
+		};
+
+
+		/// <summary>
+		/// <para>消息分片传输层</para>
+		/// <para>发送端将任意长度的消息切分为不超过下层MTU的分片，每个分片前附加12字节的分片头：消息号、分片序号、分片个数、消息总长</para>
+		/// <para>接收端按消息总长从按尺寸分级的缓冲池取得预分配的缓冲区，分片到达即写入最终位置，重组过程中不再拷贝或扩容</para>
+		/// <para>未收齐的消息在超时后、或正在重组的消息超出个数与内存上限时丢弃最旧者；正在重组的消息与缓冲池共用内存上限，超出时先释放池中的缓冲区</para>
+		/// <para>非线程安全，应在同一线程中使用</para>
+		/// </summary>
+		class FragmentTransport final : public Transport
+		{
+		public:
+
+			/// <summary>分片头长度</summary>
+			static constexpr std::size_t Header_Len = 12;
+
+			/// <summary>消息缓冲区类型</summary>
+			using buffer_type = std::shared_ptr<std::vector<char>>;
+
+		private:
+
+			/// <summary>缓冲池类型</summary>
+			using __pool_type = utils::AdaptiveObjectPool<buffer_type>;
+
+			/// <summary>
+			/// 正在重组的消息
+			/// </summary>
+			struct __message
+			{
+				/// <summary>预分配为消息总长的缓冲区</summary>
+				buffer_type       buf;
+				/// <summary>已收到的分片</summary>
+				std::vector<bool> got;
+				/// <summary>已收到的分片个数</summary>
+				std::size_t       received;
+				/// <summary>非末尾分片的长度，收到首个非末尾分片前为0</summary>
+				std::size_t       frag;
+				/// <summary>末尾分片的长度，收到末尾分片前为0</summary>
+				std::size_t       tail;
+				/// <summary>数据时间戳</summary>
+				int64_t           ts;
+				/// <summary>以毫秒为单位的首个分片到达时间</summary>
+				int64_t           first;
+			};
+
+			/// <summary>
+			/// 重组完成的消息
+			/// </summary>
+			struct __ready
+			{
+				/// <summary>缓冲区</summary>
+				buffer_type buf;
+				/// <summary>数据时间戳</summary>
+				int64_t     ts;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="lower">下层传输</param>
+			/// <param name="opts">分片参数</param>
+			/// <param name="mtu">下层单个数据报的最大长度</param>
+			FragmentTransport(Transport& lower, const FragmentOptions& opts = FragmentOptions(), const std::size_t mtu = 1504);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			FragmentTransport(const FragmentTransport&) = delete;
+
+			/// <summary>
+			/// 分片发送一个消息
+			/// </summary>
+			/// <param name="mem">消息</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回消息长度，消息过长或下层发送失败返回-1</returns>
+			ssize_t       Send(const utils::Memory<char>& mem, const int64_t ts) override;
+
+			/// <summary>
+			/// 接收一个完整的消息并拷贝到缓冲区
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回消息长度，失败返回-1，超时返回-2；大于缓冲区的消息被丢弃并计入Oversize</returns>
+			ssize_t       Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override;
+
+			/// <summary>
+			/// 获取下层等待可读的套接字
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的最迟须再次调用Receive的时间</param>
+			/// <returns>套接字，不支持时返回-1</returns>
+			int           Handle(int64_t& next) noexcept override { return m_iLower.Handle(next); }
+
+			/// <summary>
+			/// <para>接收一个完整的消息，直接交出重组缓冲区而不拷贝</para>
+			/// <para>用完后应调用Recycle归还缓冲区，否则它将被释放而不能复用</para>
+			/// </summary>
+			/// <param name="buf">消息缓冲区，其长度即消息长度</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回消息长度，失败返回-1，超时返回-2</returns>
+			ssize_t       ReceiveMessage(buffer_type& buf, int64_t& ts, const int64_t timeout = -1);
+
+			/// <summary>
+			/// 归还ReceiveMessage交出的缓冲区
+			/// </summary>
+			/// <param name="buf">缓冲区</param>
+			void          Recycle(buffer_type buf);
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			FragmentStats GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 等待直到有重组完成的消息
+			/// </summary>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>有消息返回1，否则返回下层Receive的返回值</returns>
+			ssize_t       _Wait(const int64_t timeout);
+
+			/// <summary>
+			/// 处理收到的分片
+			/// </summary>
+			/// <param name="len">分片长度</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <param name="now">以毫秒为单位的当前时间</param>
+			void          _Input(const std::size_t len, const int64_t ts, const int64_t now);
+
+			/// <summary>
+			/// 丢弃超时的消息，并在超出上限时丢弃最旧的消息
+			/// </summary>
+			/// <param name="now">以毫秒为单位的当前时间</param>
+			/// <param name="incoming">即将加入的消息长度</param>
+			void          _Expire(const int64_t now, const std::size_t incoming);
+
+			/// <summary>
+			/// 丢弃一个正在重组的消息
+			/// </summary>
+			/// <param name="id">消息号</param>
+			void          _Drop(const uint32_t id);
+
+			/// <summary>
+			/// 释放缓冲池中的缓冲区，直到与正在重组的消息合计不超过内存上限
+			/// </summary>
+			void          _Trim();
+
+			/// <summary>
+			/// 从缓冲池取得不小于指定长度的缓冲区
+			/// </summary>
+			/// <param name="len">消息长度</param>
+			/// <returns>长度为len的缓冲区</returns>
+			buffer_type   _Acquire(const std::size_t len);
+
+			/// <summary>
+			/// 计算长度对应的尺寸等级
+			/// </summary>
+			/// <param name="len">长度</param>
+			/// <returns>尺寸等级，等级n的缓冲区容量为4KB左移n位</returns>
+			static std::size_t _Class(const std::size_t len) noexcept;
+
+			/// <summary>
+			/// 计算长度对应的缓冲区容量
+			/// </summary>
+			/// <param name="len">长度</param>
+			/// <returns>缓冲区容量，超出最大等级时为长度本身</returns>
+			std::size_t   _Capacity(const std::size_t len) const noexcept;
+
+		private:
+
+			/// <summary>下层传输</summary>
+			Transport&                              m_iLower;
+			/// <summary>分片参数</summary>
+			const FragmentOptions                   m_iOpts;
+			/// <summary>下层单个数据报的最大长度</summary>
+			const std::size_t                       m_uMtu;
+			/// <summary>下一个发送的消息号</summary>
+			uint32_t                                m_uNextId;
+			/// <summary>发送缓冲区</summary>
+			std::vector<char>                       m_iSendBuf;
+			/// <summary>接收缓冲区</summary>
+			std::vector<char>                       m_iRecvBuf;
+			/// <summary>按尺寸等级划分的缓冲池</summary>
+			std::vector<std::unique_ptr<__pool_type>> m_iPools;
+			/// <summary>正在重组的消息</summary>
+			std::unordered_map<uint32_t, __message> m_iPending;
+			/// <summary>按首个分片到达顺序排列的消息号</summary>
+			std::deque<uint32_t>                    m_iOrder;
+			/// <summary>正在重组的消息按缓冲区容量计的字节数</summary>
+			std::size_t                             m_uPendingBytes;
+			/// <summary>缓冲池中缓存的字节数</summary>
+			std::size_t                             m_uPooledBytes;
+			/// <summary>重组完成待交付的消息</summary>
+			std::deque<__ready>                     m_iReady;
+			/// <summary>统计信息</summary>
+			FragmentStats                           m_iStats;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_FRAGMENT_H__
@@ -0,0 +1,251 @@
+﻿/************************************************************************
+ * @ObjectName: gf256.cpp
+ * @Description: GF(2^8)上的运算，供前向纠错编解码使用
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "gf256.h"
+
+
+#include <cstring>
+
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define __VSNC_GF_X86__
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define __VSNC_TARGET(isa)
+#else
+#include <cpuid.h>
+#define __VSNC_TARGET(isa) __attribute__((target(isa)))
+#endif // _MSC_VER
+#endif // x86
+
+
+namespace
+{
+	/// <summary>
+	/// 对数表与指数表
+	/// </summary>
+	struct GfTables
+	{
+		/// <summary>指数表，长度加倍以省去取模</summary>
+		uint8_t exp[512];
+		/// <summary>对数表</summary>
+		uint8_t log[256];
+
+		GfTables() noexcept
+		{
+			unsigned x = 1;
+			for (int i = 0; i < 255; ++i) {
+				exp[i] = static_cast<uint8_t>(x);
+				log[x] = static_cast<uint8_t>(i);
+				x <<= 1;
+				if (x & 0x100) {
+					x ^= 0x11D;
+				}
+			}
+			for (int i = 255; i < 512; ++i) {
+				exp[i] = exp[i - 255];
+			}
+			log[0] = 0;
+		}
+	};
+
+	const GfTables& tables() noexcept
+	{
+		static const GfTables t;
+		return t;
+	}
+
+	/// <summary>区域乘加函数类型</summary>
+	using mul_add_func = void(*)(uint8_t*, const uint8_t*, uint8_t, std::size_t);
+
+	void mulAddScalar(uint8_t* dst, const uint8_t* src, uint8_t c, std::size_t len)
+	{
+		auto& t = tables();
+		auto lc = t.log[c];
+		for (std::size_t i = 0; i < len; ++i) {
+			if (src[i]) {
+				dst[i] ^= t.exp[t.log[src[i]] + lc];
+			}
+		}
+	}
+
+#ifdef __VSNC_GF_X86__
+	/// <summary>
+	/// 生成低、高半字节乘法表：lo[i] = c * i，hi[i] = c * (i << 4)
+	/// </summary>
+	void nibbleTables(const uint8_t c, uint8_t lo[16], uint8_t hi[16]) noexcept
+	{
+		for (uint8_t i = 0; i < 16; ++i) {
+			lo[i] = vsnc::forwarder::__gf_mul(c, i);
+			hi[i] = vsnc::forwarder::__gf_mul(c, static_cast<uint8_t>(i << 4));
+		}
+	}
+
+	__VSNC_TARGET("ssse3")
+	void mulAddSsse3(uint8_t* dst, const uint8_t* src, uint8_t c, std::size_t len)
+	{
+		alignas(16) uint8_t lo[16], hi[16];
+		nibbleTables(c, lo, hi);
+		auto tlo = _mm_load_si128(reinterpret_cast<const __m128i*>(lo));
+		auto thi = _mm_load_si128(reinterpret_cast<const __m128i*>(hi));
+		auto mask = _mm_set1_epi8(0x0f);
+		std::size_t i = 0;
+		for (; i + 16 <= len; i += 16) {
+			auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			auto l = _mm_shuffle_epi8(tlo, _mm_and_si128(x, mask));
+			auto h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+			auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(d, _mm_xor_si128(l, h)));
+		}
+		mulAddScalar(dst + i, src + i, c, len - i);
+	}
+
+	__VSNC_TARGET("avx2")
+	void mulAddAvx2(uint8_t* dst, const uint8_t* src, uint8_t c, std::size_t len)
+	{
+		alignas(16) uint8_t lo[16], hi[16];
+		nibbleTables(c, lo, hi);
+		auto tlo = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(lo)));
+		auto thi = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(hi)));
+		auto mask = _mm256_set1_epi8(0x0f);
+		std::size_t i = 0;
+		for (; i + 32 <= len; i += 32) {
+			auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			auto l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(x, mask));
+			auto h = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+			auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(d, _mm256_xor_si256(l, h)));
+		}
+		mulAddScalar(dst + i, src + i, c, len - i);
+	}
+
+	/// <summary>
+	/// 检测CPU与操作系统是否支持指定的指令集
+	/// </summary>
+	/// <returns>1为SSSE3，2为AVX2，0为都不支持</returns>
+	int detectIsa() noexcept
+	{
+		int regs[4] = { 0 };
+#ifdef _MSC_VER
+		__cpuid(regs, 0);
+		auto max = regs[0];
+		__cpuid(regs, 1);
+#else
+		unsigned a = 0, b = 0, c = 0, d = 0;
+		auto max = static_cast<int>(__get_cpuid_max(0, nullptr));
+		__cpuid(1, a, b, c, d);
+		regs[2] = static_cast<int>(c);
+#endif // _MSC_VER
+		auto ssse3 = (regs[2] & (1 << 9)) != 0;
+		auto osxsave = (regs[2] & (1 << 27)) != 0;
+		auto avx = (regs[2] & (1 << 28)) != 0;
+		auto avx2 = false;
+		if ((max >= 7) && osxsave && avx) {
+#ifdef _MSC_VER
+			auto xcr0 = _xgetbv(0);
+			__cpuidex(regs, 7, 0);
+			avx2 = ((xcr0 & 6) == 6) && ((regs[1] & (1 << 5)) != 0);
+#else
+			unsigned lo = 0, hi = 0;
+			__asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+			__cpuid_count(7, 0, a, b, c, d);
+			avx2 = ((lo & 6) == 6) && ((b & (1 << 5)) != 0);
+#endif // _MSC_VER
+		}
+		return avx2 ? 2 : (ssse3 ? 1 : 0);
+	}
+#endif // __VSNC_GF_X86__
+
+	/// <summary>
+	/// 选择区域乘加的实现
+	/// </summary>
+	struct Kernel
+	{
+		mul_add_func func;
+		const char*  name;
+
+		Kernel() noexcept : func(&mulAddScalar), name("scalar")
+		{
+#ifdef __VSNC_GF_X86__
+			switch (detectIsa())
+			{
+			case 2:
+				func = &mulAddAvx2;
+				name = "avx2";
+				break;
+			case 1:
+				func = &mulAddSsse3;
+				name = "ssse3";
+				break;
+			default:
+				break;
+			}
+#endif // __VSNC_GF_X86__
+		}
+	};
+
+	const Kernel& kernel() noexcept
+	{
+		static const Kernel k;
+		return k;
+	}
+}
+
+
+uint8_t vsnc::forwarder::__gf_mul(const uint8_t a, const uint8_t b) noexcept
+{
+	if (!a || !b) {
+		return 0;
+	}
+	auto& t = tables();
+	return t.exp[t.log[a] + t.log[b]];
+}
+
+
+uint8_t vsnc::forwarder::__gf_inv(const uint8_t a) noexcept
+{
+	if (!a) {
+		return 0;
+	}
+	auto& t = tables();
+	return t.exp[255 - t.log[a]];
+}
+
+
+void vsnc::forwarder::__gf_mul_add(uint8_t* const dst, const uint8_t* const src, const uint8_t c, const std::size_t len) noexcept
+{
+	if (0 == c) {
+		return;
+	}
+	if (1 == c) {
+		__xor_region(dst, src, len);
+		return;
+	}
+	kernel().func(dst, src, c, len);
+}
+
+
+void vsnc::forwarder::__xor_region(uint8_t* const dst, const uint8_t* const src, const std::size_t len) noexcept
+{
+	std::size_t i = 0;
+	for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t a, b;
+		memcpy(&a, dst + i, sizeof(a));
+		memcpy(&b, src + i, sizeof(b));
+		a ^= b;
+		memcpy(dst + i, &a, sizeof(a));
+	}
+	for (; i < len; ++i) {
+		dst[i] ^= src[i];
+	}
+}
+
+
+const char* vsnc::forwarder::__gf_kernel_name() noexcept
+{
+	return kernel().name;
+}
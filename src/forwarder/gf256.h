@@ -0,0 +1,69 @@
+﻿/************************************************************************
+ * @ObjectName: gf256.h
+ * @Description: GF(2^8)上的运算，供前向纠错编解码使用
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_GF256_H__
+#define __VSNC_FORWARDER_GF256_H__
+
+
+#include <cstddef>
+
+
+#include <stdint.h>
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// GF(2^8)上的乘法，本原多项式为x^8+x^4+x^3+x^2+1（0x11D）
+		/// </summary>
+		/// <param name="a">乘数</param>
+		/// <param name="b">乘数</param>
+		/// <returns>乘积</returns>
+		uint8_t     __gf_mul(const uint8_t a, const uint8_t b) noexcept;
+
+		/// <summary>
+		/// GF(2^8)上的乘法逆元
+		/// </summary>
+		/// <param name="a">非零元素</param>
+		/// <returns>a的逆元，a为0时返回0</returns>
+		uint8_t     __gf_inv(const uint8_t a) noexcept;
+
+		/// <summary>
+		/// <para>区域乘加：dst[i] ^= c * src[i]</para>
+		/// <para>运行时检测CPU，依次选用AVX2、SSSE3的查表（PSHUFB）实现或标量实现</para>
+		/// </summary>
+		/// <param name="dst">目标区域</param>
+		/// <param name="src">源区域</param>
+		/// <param name="c">系数</param>
+		/// <param name="len">区域长度</param>
+		void        __gf_mul_add(uint8_t* const dst, const uint8_t* const src, const uint8_t c, const std::size_t len) noexcept;
+
+		/// <summary>
+		/// 区域异或：dst[i] ^= src[i]
+		/// </summary>
+		/// <param name="dst">目标区域</param>
+		/// <param name="src">源区域</param>
+		/// <param name="len">区域长度</param>
+		void        __xor_region(uint8_t* const dst, const uint8_t* const src, const std::size_t len) noexcept;
+
+		/// <summary>
+		/// 获取当前使用的区域运算实现名
+		/// </summary>
+		/// <returns>"avx2"、"ssse3"或"scalar"</returns>
+		const char* __gf_kernel_name() noexcept;
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_GF256_H__
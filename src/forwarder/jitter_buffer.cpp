@@ -0,0 +1,170 @@
+﻿/************************************************************************
+ * @ObjectName: jitter_buffer.cpp
+ * @Description: 按时间戳重排序并匀速释放数据包的抖动缓冲区
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "jitter_buffer.h"
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+namespace
+{
+	/// <summary>以毫秒为单位的基准传输时延统计窗口</summary>
+	constexpr int64_t Base_Window = 10000;
+}
+
+
+vsnc::forwarder::JitterBuffer::JitterBuffer(const JitterBufferOptions& opts) :
+	m_iOptions(opts),
+	m_uNextSeq(0)
+{
+	Clear();
+}
+
+
+bool vsnc::forwarder::JitterBuffer::Push(const utils::Memory<char>& mem, const int64_t ts, const int64_t now)
+{
+	++m_iStats.Pushed;
+	_UpdateDelay(now - _ToMs(ts), now);
+
+	// 比已释放的数据包更早的数据包已无法按序送出
+	if (m_bReleased && ts < m_nLastTs) {
+		++m_iStats.LateDrops;
+		return false;
+	}
+	if (m_iHeap.size() >= m_iOptions.Capacity) {
+		++m_iStats.OverflowDrops;
+		_DropTop();
+	}
+
+	__packet pkt;
+	pkt.ts = ts;
+	pkt.seq = m_uNextSeq++;
+	pkt.arrival = now;
+	if (!m_iFree.empty()) {
+		pkt.data = std::move(m_iFree.back());
+		m_iFree.pop_back();
+	}
+	pkt.data.assign(mem.Data(), mem.Data() + mem.Length());
+	m_iHeap.push_back(std::move(pkt));
+	std::push_heap(m_iHeap.begin(), m_iHeap.end(), __later());
+	return true;
+}
+
+
+ssize_t vsnc::forwarder::JitterBuffer::Pop(utils::Memory<char>& mem, int64_t& ts, const int64_t now)
+{
+	while (!m_iHeap.empty() && (_Deadline(m_iHeap.front().ts) <= now)) {
+		auto& pkt = m_iHeap.front();
+		if (pkt.data.size() > mem.Length()) {
+			++m_iStats.OversizeDrops;
+			_DropTop();
+			continue;
+		}
+		auto len = pkt.data.size();
+		memcpy(mem.Data(), pkt.data.data(), len);
+		ts = pkt.ts;
+
+		auto delay = now - pkt.arrival;
+		++m_iStats.Popped;
+		m_nDelaySum += delay;
+		m_iStats.MaxDelay = (std::max)(m_iStats.MaxDelay, delay);
+
+		m_bReleased = true;
+		m_nLastTs = pkt.ts;
+		_PopTop();
+		return static_cast<ssize_t>(len);
+	}
+	return 0;
+}
+
+
+int64_t vsnc::forwarder::JitterBuffer::NextRelease(const int64_t now) const noexcept
+{
+	if (m_iHeap.empty()) {
+		return -1;
+	}
+	return (std::max)(static_cast<int64_t>(0), _Deadline(m_iHeap.front().ts) - now);
+}
+
+
+void vsnc::forwarder::JitterBuffer::Clear() noexcept
+{
+	for (auto& pkt : m_iHeap) {
+		m_iFree.push_back(std::move(pkt.data));
+	}
+	m_iHeap.clear();
+	m_bStarted = false;
+	m_bReleased = false;
+	m_nLastTs = 0;
+	m_nLastTransit = 0;
+	m_nBaseTransit = 0;
+	m_nWindowMin = 0;
+	m_nWindowStart = 0;
+	m_dJitter = 0.0;
+	m_nTargetDelay = m_iOptions.MinDelay;
+	m_iStats = JitterBufferStats();
+	m_nDelaySum = 0;
+}
+
+
+vsnc::forwarder::JitterBufferStats vsnc::forwarder::JitterBuffer::GetStats() const noexcept
+{
+	auto stats = m_iStats;
+	stats.Jitter = m_dJitter;
+	stats.TargetDelay = m_nTargetDelay;
+	stats.AvgDelay = stats.Popped ? (static_cast<double>(m_nDelaySum) / stats.Popped) : 0.0;
+	return stats;
+}
+
+
+void vsnc::forwarder::JitterBuffer::_UpdateDelay(const int64_t transit, const int64_t now) noexcept
+{
+	if (!m_bStarted) {
+		m_bStarted = true;
+		m_nLastTransit = transit;
+		m_nBaseTransit = transit;
+		m_nWindowMin = transit;
+		m_nWindowStart = now;
+		return;
+	}
+
+	// RFC 3550 A.8：J += (|D| - J) / 16
+	auto d = static_cast<double>(std::llabs(transit - m_nLastTransit));
+	m_dJitter += (d - m_dJitter) / 16.0;
+	m_nLastTransit = transit;
+
+	// 基准传输时延取窗口内最小值，窗口轮换以跟随两端时钟漂移
+	m_nBaseTransit = (std::min)(m_nBaseTransit, transit);
+	m_nWindowMin = (std::min)(m_nWindowMin, transit);
+	if (now - m_nWindowStart >= Base_Window) {
+		m_nBaseTransit = m_nWindowMin;
+		m_nWindowMin = transit;
+		m_nWindowStart = now;
+	}
+
+	auto target = static_cast<int64_t>(std::lround(m_dJitter * m_iOptions.JitterFactor));
+	m_nTargetDelay = (std::min)((std::max)(target, m_iOptions.MinDelay), m_iOptions.MaxDelay);
+}
+
+
+void vsnc::forwarder::JitterBuffer::_DropTop()
+{
+	m_bReleased = true;
+	m_nLastTs = (std::max)(m_nLastTs, m_iHeap.front().ts);
+	_PopTop();
+}
+
+
+void vsnc::forwarder::JitterBuffer::_PopTop()
+{
+	// pop_heap把堆顶换到末尾，此时可合法地移出其缓冲区以便复用
+	std::pop_heap(m_iHeap.begin(), m_iHeap.end(), __later());
+	m_iFree.push_back(std::move(m_iHeap.back().data));
+	m_iHeap.pop_back();
+}
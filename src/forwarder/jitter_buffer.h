@@ -0,0 +1,249 @@
+﻿/************************************************************************
+ * @ObjectName: jitter_buffer.h
+ * @Description: 按时间戳重排序并匀速释放数据包的抖动缓冲区
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_JITTER_BUFFER_H__
+#define __VSNC_FORWARDER_JITTER_BUFFER_H__
+
+
+#include <vector>
+#include <functional>
+
+
+#include <stdint.h>
+
+
+#include <p2p/client.h>
+#include <vsnc_utils/memory.h>
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 抖动缓冲区参数
+		/// </summary>
+		struct JitterBufferOptions
+		{
+			/// <summary>以毫秒为单位的最小缓冲时延</summary>
+			int64_t     MinDelay     = 0;
+			/// <summary>以毫秒为单位的最大缓冲时延</summary>
+			int64_t     MaxDelay     = 200;
+			/// <summary>目标缓冲时延与测得抖动的倍数关系</summary>
+			double      JitterFactor = 3.0;
+			/// <summary>缓冲区最多容纳的数据包个数</summary>
+			std::size_t Capacity     = 1024;
+			/// <summary>发送端时间戳的时钟频率，即每秒的刻度数，毫秒时间戳为1000，RTP视频时间戳为90000</summary>
+			int64_t     ClockRate    = 1000;
+		};
+
+
+		/// <summary>
+		/// 抖动缓冲区统计信息
+		/// </summary>
+		struct JitterBufferStats
+		{
+			/// <summary>推入的数据包个数</summary>
+			uint64_t Pushed        = 0;
+			/// <summary>释放的数据包个数</summary>
+			uint64_t Popped        = 0;
+			/// <summary>因迟到而丢弃的数据包个数</summary>
+			uint64_t LateDrops     = 0;
+			/// <summary>因缓冲区已满而丢弃的数据包个数</summary>
+			uint64_t OverflowDrops = 0;
+			/// <summary>因超出接收缓冲区而丢弃的数据包个数</summary>
+			uint64_t OversizeDrops = 0;
+			/// <summary>以毫秒为单位的到达间隔抖动</summary>
+			double   Jitter        = 0.0;
+			/// <summary>以毫秒为单位的当前目标缓冲时延</summary>
+			int64_t  TargetDelay   = 0;
+			/// <summary>以毫秒为单位的平均附加时延</summary>
+			double   AvgDelay      = 0.0;
+			/// <summary>以毫秒为单位的最大附加时延</summary>
+			int64_t  MaxDelay      = 0;
+		};
+
+
+		/// <summary>
+		/// <para>抖动缓冲区</para>
+		/// <para>按发送端时间戳对数据包重新排序，并在“时间戳+基准传输时延+目标缓冲时延”时刻释放</para>
+		/// <para>目标缓冲时延随测得的到达间隔抖动（RFC 3550）自适应调整，插入与释放的复杂度均为O(log n)</para>
+		/// <para>非线程安全，应在同一线程中推入与释放</para>
+		/// </summary>
+		class JitterBuffer
+		{
+			/// <summary>
+			/// 缓冲的数据包
+			/// </summary>
+			struct __packet
+			{
+				/// <summary>发送端时间戳</summary>
+				int64_t           ts;
+				/// <summary>推入序号，保证时间戳相同时按到达顺序释放</summary>
+				uint64_t          seq;
+				/// <summary>本地到达时间</summary>
+				int64_t           arrival;
+				/// <summary>数据</summary>
+				std::vector<char> data;
+			};
+
+			/// <summary>
+			/// 数据包排序规则，时间戳小者优先
+			/// </summary>
+			struct __later
+			{
+				bool operator()(const __packet& lhs, const __packet& rhs) const noexcept
+				{
+					return (lhs.ts != rhs.ts) ? (lhs.ts > rhs.ts) : (lhs.seq > rhs.seq);
+				}
+			};
+
+			/// <summary>按时间戳排序的最小堆类型，以std::push_heap/std::pop_heap维护，弹出后可从末尾移出数据</summary>
+			using __heap_type = std::vector<__packet>;
+			/// <summary>空闲缓冲区列表类型</summary>
+			using __free_type = std::vector<std::vector<char>>;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="opts">缓冲区参数</param>
+			explicit JitterBuffer(const JitterBufferOptions& opts = JitterBufferOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			JitterBuffer(const JitterBuffer&) = delete;
+
+			/// <summary>
+			/// 推入一个数据包
+			/// </summary>
+			/// <param name="mem">数据</param>
+			/// <param name="ts">以ClockRate为频率的发送端时间戳</param>
+			/// <param name="now">以毫秒为单位的本地时间</param>
+			/// <returns>成功缓冲返回true，迟到而被丢弃返回false</returns>
+			bool              Push(const utils::Memory<char>& mem, const int64_t ts, const int64_t now);
+
+			/// <summary>
+			/// 释放一个已到期的数据包，超出接收缓冲区的到期数据包被丢弃，不会阻塞其后的数据包
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">释放的数据包的发送端时间戳</param>
+			/// <param name="now">以毫秒为单位的本地时间</param>
+			/// <returns>成功返回数据包的字节数，没有到期的数据包返回0</returns>
+			ssize_t           Pop(utils::Memory<char>& mem, int64_t& ts, const int64_t now);
+
+			/// <summary>
+			/// 获取距下一个数据包到期的时间
+			/// </summary>
+			/// <param name="now">以毫秒为单位的本地时间</param>
+			/// <returns>以毫秒为单位的等待时间，缓冲区为空时返回-1</returns>
+			int64_t           NextRelease(const int64_t now) const noexcept;
+
+			/// <summary>
+			/// 判断缓冲区是否为空
+			/// </summary>
+			/// <returns>为空返回true，否则返回false</returns>
+			bool              Empty() const noexcept { return m_iHeap.empty(); }
+
+			/// <summary>
+			/// 获取缓冲的数据包个数
+			/// </summary>
+			/// <returns>缓冲的数据包个数</returns>
+			std::size_t       Size() const noexcept { return m_iHeap.size(); }
+
+			/// <summary>
+			/// 清空缓冲区并重置时延估计，在会话断开时调用
+			/// </summary>
+			void              Clear() noexcept;
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			JitterBufferStats GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 获取数据包的释放时刻
+			/// </summary>
+			/// <param name="ts">发送端时间戳</param>
+			/// <returns>以本地毫秒时间表示的释放时刻</returns>
+			int64_t           _Deadline(const int64_t ts) const noexcept { return _ToMs(ts) + m_nBaseTransit + m_nTargetDelay; }
+
+			/// <summary>
+			/// 将发送端时间戳换算为毫秒
+			/// </summary>
+			/// <param name="ts">发送端时间戳</param>
+			/// <returns>以毫秒为单位的发送端时间</returns>
+			int64_t           _ToMs(const int64_t ts) const noexcept { return (1000 == m_iOptions.ClockRate) ? ts : (ts * 1000 / m_iOptions.ClockRate); }
+
+			/// <summary>
+			/// 根据新数据包的传输时延更新抖动与目标缓冲时延
+			/// </summary>
+			/// <param name="transit">以毫秒为单位的本地到达时间与发送端时间之差</param>
+			/// <param name="now">以毫秒为单位的本地时间</param>
+			void              _UpdateDelay(const int64_t transit, const int64_t now) noexcept;
+
+			/// <summary>
+			/// 丢弃堆顶的数据包
+			/// </summary>
+			void              _DropTop();
+
+			/// <summary>
+			/// 弹出堆顶的数据包并回收其缓冲区
+			/// </summary>
+			void              _PopTop();
+
+		private:
+
+			/// <summary>缓冲区参数</summary>
+			JitterBufferOptions m_iOptions;
+
+			/// <summary>按时间戳排序的数据包</summary>
+			__heap_type       m_iHeap;
+			/// <summary>可复用的空闲缓冲区</summary>
+			__free_type       m_iFree;
+			/// <summary>下一个推入序号</summary>
+			uint64_t          m_uNextSeq;
+
+			/// <summary>是否已收到过数据包</summary>
+			bool              m_bStarted;
+			/// <summary>是否已释放过数据包</summary>
+			bool              m_bReleased;
+			/// <summary>最近释放的数据包的时间戳</summary>
+			int64_t           m_nLastTs;
+			/// <summary>上一个数据包的传输时延</summary>
+			int64_t           m_nLastTransit;
+			/// <summary>基准传输时延，即当前窗口内的最小传输时延</summary>
+			int64_t           m_nBaseTransit;
+			/// <summary>正在统计的窗口内的最小传输时延</summary>
+			int64_t           m_nWindowMin;
+			/// <summary>当前统计窗口的起始时间</summary>
+			int64_t           m_nWindowStart;
+			/// <summary>到达间隔抖动</summary>
+			double            m_dJitter;
+			/// <summary>目标缓冲时延</summary>
+			int64_t           m_nTargetDelay;
+
+			/// <summary>统计信息</summary>
+			JitterBufferStats m_iStats;
+			/// <summary>附加时延总和</summary>
+			int64_t           m_nDelaySum;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_JITTER_BUFFER_H__
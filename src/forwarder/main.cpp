@@ -5,7 +5,15 @@
  * @Date: 2021/8/11
  ***********************************************************************/
 #include <iostream>
+#include <fstream>
 #include <thread>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <string>
+#include <utility>
+#include <array>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -15,18 +23,157 @@
 #include <p2p/client.h>
 #include <vsnc_utils/utils.h>
 #include <vsnc_utils/memory.h>
+#include <vsnc_utils/clock.h>
+#include <vsnc_utils/logger.h>
 
+#include "jitter_buffer.h"
+#include "pacer.h"
+#include "downstream.h"
+#include "connector.h"
+#include "fec.h"
+#include "pmtu.h"
+#include "congestion.h"
+#include "clock_sync.h"
+#include "event_loop.h"
+#include "async_client.h"
+#include "shard.h"
+#include "rtp.h"
+#include "sequence.h"
+#include "secure.h"
 
-static int creatUdpSocket()
+
+/// <summary>Ƿڽת֮ö</summary>
+static constexpr bool    Enable_Jitter_Buffer = false;
+/// <summary>ʱʱƵʣԶԺʱʱΪ1000</summary>
+static constexpr int64_t     Jitter_Clock_Rate = 1000;
+/// <summary>ֽÿΪληʣΪ0ʱΣδʱ</summary>
+static constexpr uint64_t    Pace_Rate = 0;
+/// <summary>ֽΪλͻ</summary>
+static constexpr std::size_t Pace_Burst = 32 * 1024;
+/// <summary>ηͶʱĴ</summary>
+static constexpr vsnc::forwarder::overflow_policy Overflow_Policy = vsnc::forwarder::overflow_policy::DROP_OLDEST;
+/// <summary>ԺΪλλѹԼ</summary>
+static constexpr int64_t     Retry_Interval = 5;
+/// <summary>ԺΪλδʱ״̬</summary>
+static constexpr int         Poll_Interval = 10;
+/// <summary>ԺΪλĵӳʱʱ䣬벻ڿͻֱת׶֮</summary>
+static constexpr int64_t     Connect_Timeout = 3000;
+/// <summary>ԺΪλĿͻÿӽ׶εĳʱʱ</summary>
+static constexpr int64_t     Punch_Timeout = 1000;
+/// <summary>Ƿ̽Զ˵ȫѡ˵</summary>
+static constexpr bool        Punch_Parallel = true;
+/// <summary>Ӹٵĵ·ǰ׺ÿỰǰ׺_Զк.jsonchrome://tracingPerfetto</summary>
+static constexpr const char* Trace_Prefix = "connect_trace";
+/// <summary>Ƿ֤ܣԶͬԤԿܲ㷢</summary>
+static constexpr bool    Enable_Aead = false;
+/// <summary>ʮƱʾ32ֽԤԿ</summary>
+static constexpr const char* Aead_Key = "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f";
+/// <summary>ʹõ֤㷨AUTOCPU֧AES-NIʱѡAES-256-GCMѡChaCha20-Poly1305</summary>
+static constexpr vsnc::forwarder::aead_cipher Aead_Cipher = vsnc::forwarder::aead_cipher::AUTO;
+/// <summary>ǷΪݸŲͳ֮ĶظԶͬŲ㷢</summary>
+static constexpr bool    Enable_Sequence = false;
+/// <summary>ͳƴڣȷ϶ǰ</summary>
+static constexpr std::size_t Sequence_Window = 1024;
+/// <summary>ǷεʱƫУʱԶͬͬշ</summary>
+static constexpr bool    Enable_Clock_Sync = false;
+/// <summary>Ƿ̽⵽ε·MTUԶͬ̽շú򶴿ͻ˵׽òƬ</summary>
+static constexpr bool    Enable_Pmtu = false;
+/// <summary>·MTU̽ޣMTU</summary>
+static constexpr std::size_t Pmtu_Max_Size = 1500;
+/// <summary>εݰ󳤶ȣշĳȣ·MTU̽ʱԶӦ̽õ</summary>
+static constexpr std::size_t Max_Packet_Len = 1504;
+/// <summary>ǷλӵƷԶͬӵƲ㷢</summary>
+static constexpr bool    Enable_Congestion_Control = false;
+/// <summary>ǷǰԶͬ</summary>
+static constexpr bool    Enable_Fec = false;
+/// <summary>ԺΪλĽճʱʱ</summary>
+static constexpr int64_t Recv_Timeout = 200;
+/// <summary>ԺΪλͳϢ</summary>
+static constexpr int64_t Stats_Interval = 5000;
+/// <summary>ת̸߳ÿ̰߳һ˲ռһֻỰΪ0ʱȡӲ</summary>
+static constexpr std::size_t Shard_Workers = 1;
+/// <summary>תỰбÿΪԶ˵кţỰԶкŷ߳</summary>
+static const std::pair<uint64_t, uint64_t> Sessions[] = {
+	{ 42, 41 },
+};
+/// <summary>ǷRTPSSRC븺ͽݷͬζ˿ڣͳƸͬԴĶ붶</summary>
+static constexpr bool    Enable_Rtp_Demux = false;
+/// <summary>
+/// <para>RTPÿΪSSRCζ˿ڣδеݰĬ</para>
+/// <para>SSRCΪ0ʾSSRCΪ-1ʾ⸺</para>
+/// </summary>
+static const struct { uint32_t ssrc; int pt; uint16_t port; } Rtp_Routes[] = {
+	{ 0, 111, 4006 },
+};
+/// <summary>RTP͵ʱʱƵʣδгİ90kHz</summary>
+static const std::pair<uint8_t, uint32_t> Rtp_Clock_Rates[] = {
+	{ 111, 48000 },
+};
+
+
+/// <summary>
+/// ȡ΢Ϊλĵʱ䣬ÿݰҪȡTSC
+/// </summary>
+/// <returns>΢Ϊλĵʱ</returns>
+static int64_t steadyMicroseconds()
+{
+	return vsnc::utils::__tsc_ns() / 1000;
+}
+
+
+/// <summary>
+/// ȵֱͼʽΪ:б
+/// </summary>
+/// <param name="histogram">ֱͼ</param>
+/// <returns>ʽַ</returns>
+static std::string burstHistogram(const std::vector<uint64_t>& histogram)
+{
+	std::string out;
+	for (std::size_t i = 0; i < histogram.size(); ++i) {
+		uint64_t low = static_cast<uint64_t>(1) << i;
+		out += out.empty() ? "" : " ";
+		out += std::to_string(low);
+		if (i + 1 == histogram.size()) {
+			out += "+";
+		}
+		else if (low > 1) {
+			out += "-" + std::to_string(2 * low - 1);
+		}
+		out += ":" + std::to_string(histogram[i]);
+	}
+	return out;
+}
+
+
+/// <summary>
+/// ʮƱʾԤԿ
+/// </summary>
+/// <param name="hex">ʮַ</param>
+/// <param name="key">Կ</param>
+/// <returns>Ȳ򺬷ʮַfalse</returns>
+static bool parseKey(const char* hex, std::array<uint8_t, vsnc::forwarder::Aead::Key_Len>& key)
 {
-	int sock = socket(AF_INET, SOCK_DGRAM, 0);
-	if (sock == -1) {
-		std::cout << "UDP::Socket() failed." << std::endl;
+	auto digit = [](const char c) {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
 		return -1;
+	};
+	if (2 * key.size() != strlen(hex)) {
+		return false;
+	}
+	for (std::size_t i = 0; i < key.size(); ++i) {
+		auto hi = digit(hex[2 * i]);
+		auto lo = digit(hex[2 * i + 1]);
+		if ((hi < 0) || (lo < 0)) {
+			return false;
+		}
+		key[i] = static_cast<uint8_t>((hi << 4) | lo);
 	}
-	return sock;
+	return true;
 }
 
+
 static void worker(bool& run)
 {
 	char c = '\0';
@@ -37,83 +184,390 @@ static void worker(bool& run)
 }
 
 
-int main(int argc, char* argv[])
+/// <summary>
+/// תỰάֵԶ˵P2Pӣյݾ뷢ת
+/// </summary>
+/// <param name="loop">¼ѭ</param>
+/// <param name="sock">̵߳׽</param>
+/// <param name="local">к</param>
+/// <param name="peer">Զк</param>
+/// <param name="sin">εַ</param>
+/// <param name="active">б־ΪfalseỰ</param>
+/// <returns>Э</returns>
+static vsnc::forwarder::Task forward(vsnc::forwarder::EventLoop& loop, const int sock, const uint64_t local, const uint64_t peer, const sockaddr_in sin,
+	vsnc::forwarder::ShardedForwarder::active_type active)
 {
-	//ʼWSA
-	WORD sockVersion = MAKEWORD(2, 2);
-	WSADATA wsaData;
-	if (WSAStartup(sockVersion, &wsaData) != 0) return 0;
-
-	auto udp_sock = creatUdpSocket();
-	sockaddr_in addr;
-	addr.sin_family = AF_INET;
-	addr.sin_port = htons(4004);
-	inet_pton(AF_INET, "0.0.0.0", &addr.sin_addr);
-	if (bind(udp_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
-		std::cout << "UDP::bind() failed." << std::endl;
-		return 0;
+	std::vector<char> rBuf(Max_Packet_Len);
+	std::vector<char> sBuf(Max_Packet_Len);
+	vsnc::forwarder::ConnectOptions connect_opts;
+	connect_opts.Timeout = Connect_Timeout;
+	vsnc::punch::ClientOptions client_opts;
+	client_opts.Timeout = Punch_Timeout;
+	client_opts.Parallel = Punch_Parallel;
+	// ͻ˲̵̨̣߳߳¼ѭ׽ֿɶʱ
+	client_opts.Thread = false;
+	// ̽ԵƬݱͬʱݱMTUIPƬ
+	client_opts.DontFragment = Enable_Pmtu;
+	if (Enable_Pmtu) {
+		client_opts.MaxDatagram = Pmtu_Max_Size - vsnc::forwarder::PmtuTransport::Ip_Udp_Header_Len;
+	}
+	vsnc::forwarder::Connector connector([local, client_opts]() {
+		return std::unique_ptr<vsnc::punch::Client>(new vsnc::punch::Client(local, "52.130.75.26", 10000, 0, client_opts));
+	}, peer, connect_opts);
+	vsnc::utils::BasicMemory<char> mem(rBuf.data(), Max_Packet_Len);
+	vsnc::utils::BasicMemory<char> out(sBuf.data(), Max_Packet_Len);
+	vsnc::forwarder::JitterBufferOptions jitter_opts;
+	jitter_opts.ClockRate = Jitter_Clock_Rate;
+	vsnc::forwarder::JitterBuffer jitter(jitter_opts);
+	vsnc::forwarder::Pacer pacer;
+	vsnc::forwarder::PacerOptions pace_opts;
+	pace_opts.Rate = Pace_Rate;
+	pace_opts.Burst = Pace_Burst;
+	vsnc::forwarder::DownstreamOptions sink_opts;
+	sink_opts.Policy = Overflow_Policy;
+	vsnc::forwarder::Downstream sink(sock, sin, sink_opts);
+	auto downstream = pacer.AddSession([&sink](const vsnc::utils::Memory<char>& pkt) -> ssize_t {
+		return sink.Send(pkt);
+	}, pace_opts);
+	// Ŀĵ0ΪĬΣζӦRtp_Routes
+	vsnc::forwarder::RtpDemux demux;
+	std::vector<std::unique_ptr<vsnc::forwarder::Downstream>> route_sinks;
+	std::vector<vsnc::forwarder::Pacer::session_type> lanes{ downstream };
+	for (std::size_t i = 0; Enable_Rtp_Demux && (i < sizeof(Rtp_Routes) / sizeof(Rtp_Routes[0])); ++i) {
+		auto& route = Rtp_Routes[i];
+		if (route.pt < 0) {
+			demux.AddSsrcRoute(route.ssrc, i + 1);
+		}
+		else if (0 == route.ssrc) {
+			demux.AddPayloadRoute(static_cast<uint8_t>(route.pt), i + 1);
+		}
+		else {
+			demux.AddRoute(route.ssrc, static_cast<uint8_t>(route.pt), i + 1);
+		}
+		auto rsin = sin;
+		rsin.sin_port = htons(route.port);
+		route_sinks.emplace_back(new vsnc::forwarder::Downstream(sock, rsin, sink_opts));
+		auto route_sink = route_sinks.back().get();
+		lanes.push_back(pacer.AddSession([route_sink](const vsnc::utils::Memory<char>& pkt) -> ssize_t {
+			return route_sink->Send(pkt);
+		}, pace_opts));
+	}
+	for (auto& rate : Rtp_Clock_Rates) {
+		demux.SetClockRate(rate.first, rate.second);
 	}
-
-	
-	sockaddr_in sin;
-	sin.sin_family = AF_INET;
-	sin.sin_port = htons(4002);
-	inet_pton(AF_INET, "192.168.3.229", &sin.sin_addr);
-	int len = sizeof(sin);
-
-	size_t Max_Len = 1504;
-	char* rBuf = (char*)malloc(Max_Len);
-	vsnc::p2p::Client client(42, "52.130.75.26", 10000, 0);
-	bool run = true;
-	std::thread quit(&worker, std::ref(run));
-	vsnc::utils::BasicMemory<char> mem(rBuf, Max_Len);
 	int64_t ts = 0;
-	while (run) {
-		vsnc::utils::__sleep_seconds(1);
-		auto state = client.GetState();
+	auto print_stats = [&jitter, &pacer, &sink, &demux, downstream, peer]() {
+		if (Enable_Jitter_Buffer) {
+			auto stats = jitter.GetStats();
+			log_info("peer {}: jitter: {}ms target: {}ms added latency avg/max: {}/{}ms late drops: {} overflow drops: {} oversize drops: {}", peer,
+				stats.Jitter, stats.TargetDelay, stats.AvgDelay, stats.MaxDelay, stats.LateDrops, stats.OverflowDrops, stats.OversizeDrops);
+		}
+		auto stats = pacer.GetStats(downstream);
+		log_info("peer {}: pacer sent: {} delayed: {} wait avg/max: {}/{}us dropped: {} cleared: {} failed: {}", peer,
+			stats.Sent, stats.Delayed, stats.AvgWait, stats.MaxWait, stats.Dropped, stats.Cleared, stats.Failed);
+		auto sink_stats = sink.GetStats();
+		log_info("peer {}: downstream sent: {} queued: {} pending: {}/{}B peak: {}B dropped oldest/newest: {}/{} stalls: {} errors: {}", peer,
+			sink_stats.Sent, sink_stats.Queued, sink_stats.Pending, sink_stats.PendingBytes, sink_stats.PeakBytes,
+			sink_stats.DroppedOldest, sink_stats.DroppedNewest, sink_stats.Stalls, sink_stats.Errors);
+		if (Enable_Rtp_Demux) {
+			for (auto& src : demux.GetSources()) {
+				log_info("peer {}: rtp ssrc: {} pt: {} received: {} lost: {} gaps: {} max gap: {} reordered: {} resyncs: {} jitter: {}us", peer,
+					src.Ssrc, src.PayloadType, src.Received, src.Lost, src.Gaps, src.MaxGap, src.Reordered, src.Resyncs, src.JitterUs);
+			}
+			auto demux_stats = demux.GetStats();
+			log_info("peer {}: rtp packets: {} non-rtp: {} untracked: {}", peer, demux_stats.Packets, demux_stats.NonRtp, demux_stats.Untracked);
+		}
+	};
+	auto print_timing = [&connector, peer]() {
+		auto stats = connector.GetStats();
+		log_info("peer {}: connect request/punch/total: {}/{}/{}ms resumed: {} outage: {}ms avg total/resumed/outage: {}/{}/{}ms attempts: {} resumptions: {} failures: {} timeouts: {} drops: {}", peer,
+			stats.Last.Request, stats.Last.Punch, stats.Last.Total, stats.Last.Resumed, stats.Last.Outage, stats.AvgTotal, stats.AvgResumed, stats.AvgOutage,
+			stats.Attempts, stats.Resumptions, stats.Failures, stats.Timeouts, stats.Drops);
+	};
+	auto last_state = vsnc::p2p::vsnc_p2p_state::CONNECTED;
+	while (*active) {
+		auto state = connector.Poll(vsnc::utils::__steady());
+		auto changed = (state != last_state);
+		last_state = state;
 		switch (state)
 		{
 		case vsnc::p2p::vsnc_p2p_state::OFFLINE:
-			std::cout << "OFFLINE" << std::endl;
+			if (changed) log_info("peer {}: OFFLINE", peer);
+			co_await vsnc::forwarder::LeaveAsync(loop, connector.Client(), state, 1000);
 			break;
 		case vsnc::p2p::vsnc_p2p_state::FREE:
-			client.Connect(41);
-			std::cout << "FREE" << std::endl;
+			if (changed) log_info("peer {}: FREE", peer);
+			co_await loop.Sleep(Poll_Interval);
 			break;
 		case vsnc::p2p::vsnc_p2p_state::REQUESTING:
-			std::cout << "REQUESTING" << std::endl;
+			if (changed) log_info("peer {}: REQUESTING", peer);
+			co_await loop.Sleep(Poll_Interval);
 			break;
 		case vsnc::p2p::vsnc_p2p_state::CONNECTING:
-			std::cout << "CONNECTING" << std::endl;
+			if (changed) log_info("peer {}: CONNECTING", peer);
+			co_await loop.Sleep(Poll_Interval);
 			break;
 		case vsnc::p2p::vsnc_p2p_state::CONNECTED:
-			std::cout << "CONNECTED" << std::endl;
-			while (run) {
-				auto _size = client.Receive(mem, ts,200);
+		{
+			log_info("peer {}: CONNECTED", peer);
+			print_timing();
+			auto& client = connector.Client();
+			vsnc::forwarder::ClientTransport link(client);
+			std::array<uint8_t, vsnc::forwarder::Aead::Key_Len> key = {};
+			parseKey(Aead_Key, key);
+			vsnc::forwarder::SecureTransport secured(link, key.data(), Aead_Cipher, Sequence_Window);
+			vsnc::forwarder::Transport& wire = Enable_Aead ? static_cast<vsnc::forwarder::Transport&>(secured) : link;
+			vsnc::forwarder::SequenceTransport sequenced(wire, Sequence_Window);
+			vsnc::forwarder::Transport& counted = Enable_Sequence ? static_cast<vsnc::forwarder::Transport&>(sequenced) : wire;
+			if (Enable_Aead) {
+				log_info("peer {}: aead: {}", peer, secured.Name());
+			}
+			vsnc::forwarder::ClockSyncTransport sync(counted);
+			vsnc::forwarder::Transport& synced = Enable_Clock_Sync ? static_cast<vsnc::forwarder::Transport&>(sync) : counted;
+			// ̽ȰIPƣ۳֮̽¸ͷ
+			vsnc::forwarder::PmtuOptions pmtu_opts;
+			pmtu_opts.MaxSize = Pmtu_Max_Size;
+			pmtu_opts.Overhead += vsnc::punch::Data_Header_Len + (Enable_Aead ? vsnc::forwarder::SecureTransport::Overhead : 0) +
+				(Enable_Sequence ? vsnc::forwarder::SequenceTransport::Header_Len : 0) + (Enable_Clock_Sync ? vsnc::forwarder::ClockSyncTransport::Header_Len : 0);
+			vsnc::forwarder::PmtuTransport pmtu(synced, pmtu_opts);
+			auto path_mtu = pmtu.PathMtu();
+			vsnc::forwarder::Transport& path = Enable_Pmtu ? static_cast<vsnc::forwarder::Transport&>(pmtu) : synced;
+			// ӵнϴĴ黺棬ֻʱ
+			std::unique_ptr<vsnc::forwarder::CongestionTransport> congestion;
+			if (Enable_Congestion_Control) {
+				congestion.reset(new vsnc::forwarder::CongestionTransport(path));
+			}
+			vsnc::forwarder::Transport& carrier = congestion ? static_cast<vsnc::forwarder::Transport&>(*congestion) : path;
+			std::unique_ptr<vsnc::forwarder::FecTransport> fec;
+			if (Enable_Fec) {
+				fec.reset(new vsnc::forwarder::FecTransport(carrier));
+			}
+			vsnc::forwarder::Transport& upstream = fec ? static_cast<vsnc::forwarder::Transport&>(*fec) : carrier;
+			auto print_loss = [&sequenced, peer]() {
+				if (Enable_Sequence) {
+					auto& stats = sequenced.GetStats();
+					log_info("peer {}: seq received: {} lost: {} duplicates: {} reordered: {} max reorder: {} stale: {} loss bursts: {} max burst: {} burst histogram: {}", peer,
+						stats.Received, stats.Lost, stats.Duplicates, stats.Reordered, stats.MaxReorder, stats.Stale, stats.Bursts, stats.MaxBurst,
+						burstHistogram(stats.BurstHistogram));
+				}
+			};
+			// ͳڵĶʣȡŲͳƣȡRTPԴ֮ͣ·MTU̽жϵǰǷԿɴ
+			int64_t last_received = 0;
+			int64_t last_lost = 0;
+			auto interval_loss = [&sequenced, &demux, &last_received, &last_lost]() {
+				int64_t received = 0;
+				int64_t lost = 0;
+				if (Enable_Sequence) {
+					auto& stats = sequenced.GetStats();
+					received = static_cast<int64_t>(stats.Received);
+					lost = static_cast<int64_t>(stats.Lost);
+				}
+				else if (Enable_Rtp_Demux) {
+					for (auto& src : demux.GetSources()) {
+						received += static_cast<int64_t>(src.Received);
+						lost += src.Lost;
+					}
+				}
+				auto got = received - last_received;
+				auto missed = (std::max)(lost - last_lost, static_cast<int64_t>(0));
+				last_received = received;
+				last_lost = lost;
+				return (got + missed > 0) ? static_cast<double>(missed) / static_cast<double>(got + missed) : 0.0;
+			};
+			// RTPͳƿỰۼƣӱλỰ
+			interval_loss();
+			auto last_stats = vsnc::utils::__utc();
+			const char* reason = "quit";
+			auto lost = false;
+			auto disconnect = false;
+			while (*active) {
+				auto timeout = Recv_Timeout;
+				if (Enable_Jitter_Buffer && !jitter.Empty()) {
+					timeout = (std::min)(timeout, jitter.NextRelease(vsnc::utils::__utc()));
+				}
+				auto pace_wait = pacer.NextRelease(steadyMicroseconds());
+				if (pace_wait >= 0) {
+					timeout = (std::min)(timeout, (pace_wait + 999) / 1000);
+				}
+				if (sink.Pending() || std::any_of(route_sinks.begin(), route_sinks.end(), [](const std::unique_ptr<vsnc::forwarder::Downstream>& r) { return r->Pending(); })) {
+					timeout = (std::min)(timeout, Retry_Interval);
+				}
+				auto _size = co_await vsnc::forwarder::ReceiveAsync(loop, upstream, mem, ts, timeout);
 				//std::cout << _size << std::endl;
-				if (_size < 0) {
-					std::cout << "recvfrom close" << std::endl;
+				if (_size == -2) {
+					if (client.GetState() != vsnc::p2p::vsnc_p2p_state::CONNECTED) {
+						log_warn("peer {}: connection lost", peer);
+						reason = "connection lost";
+						lost = true;
+						break;
+					}
+				}
+				else if (_size < 0) {
+					log_warn("peer {}: recvfrom close", peer);
+					reason = "recvfrom close";
+					lost = true;
 					break;
 				}
 				else if (_size == 0) {
-					std::cout << "client shutdown..." << std::endl;
+					log_info("peer {}: client shutdown...", peer);
+					reason = "client shutdown...";
+					lost = true;
 					break;
 				}
+				else if (!Enable_Jitter_Buffer) {
+					vsnc::utils::BasicMemory<char> pkt(mem.Data(), _size);
+					auto lane = Enable_Rtp_Demux ? lanes[demux.Input(mem.Data(), _size, steadyMicroseconds())] : downstream;
+					pacer.Enqueue(lane, pkt, steadyMicroseconds());
+				}
 				else {
-					auto data_len = sendto(udp_sock, mem.Data(), _size, 0, reinterpret_cast<sockaddr*>(&sin), len);
-					//std::cout << " len: " << data_len << std::endl;
-					if (data_len < 0) {
-						break;
+					if (Enable_Rtp_Demux) {
+						demux.Input(mem.Data(), _size, steadyMicroseconds());
+					}
+					vsnc::utils::BasicMemory<char> pkt(mem.Data(), _size);
+					jitter.Push(pkt, Enable_Clock_Sync ? sync.ToLocal(ts) : ts, vsnc::utils::__utc());
+				}
+
+				auto now = vsnc::utils::__utc();
+				if (Enable_Pmtu && (pmtu.PathMtu() != path_mtu)) {
+					path_mtu = pmtu.PathMtu();
+					log_info("peer {}: path mtu: {} max payload: {}", peer, path_mtu, pmtu.MaxPayload());
+				}
+				int64_t out_ts = 0;
+				ssize_t out_size = 0;
+				while (Enable_Jitter_Buffer && (out_size = jitter.Pop(out, out_ts, now)) > 0) {
+					vsnc::utils::BasicMemory<char> pkt(out.Data(), out_size);
+					auto lane = Enable_Rtp_Demux ? lanes[demux.Route(out.Data(), out_size)] : downstream;
+					pacer.Enqueue(lane, pkt, steadyMicroseconds());
+				}
+				sink.Flush();
+				for (auto& r : route_sinks) {
+					r->Flush();
+				}
+				pacer.Flush(steadyMicroseconds());
+				if (sink.Failed() || std::any_of(route_sinks.begin(), route_sinks.end(), [](const std::unique_ptr<vsnc::forwarder::Downstream>& r) { return r->Failed(); })) {
+					log_warn("peer {}: sendto failed", peer);
+					reason = "sendto failed";
+					break;
+				}
+				if (sink.Broken() || std::any_of(route_sinks.begin(), route_sinks.end(), [](const std::unique_ptr<vsnc::forwarder::Downstream>& r) { return r->Broken(); })) {
+					log_warn("peer {}: downstream overflow", peer);
+					reason = "downstream overflow";
+					disconnect = true;
+					break;
+				}
+				if (now - last_stats >= Stats_Interval) {
+					print_stats();
+					print_loss();
+					if (Enable_Pmtu) {
+						pmtu.ReportLoss(interval_loss());
 					}
+					last_stats = now;
 				}
 			}
+			if (lost) {
+				// ֻ·ϿϿжʱ䣬˳ιϲ
+				connector.Lost(vsnc::utils::__steady(), reason);
+			}
+			last_state = vsnc::p2p::vsnc_p2p_state::FREE;
+			print_stats();
+			print_loss();
+			if (Enable_Clock_Sync) {
+				auto sync_stats = sync.GetStats();
+				log_info("peer {}: clock offset: {}us drift: {}ppm rtt: {}us one-way delay avg/min/max: {}/{}/{}ms", peer,
+					sync_stats.Offset, sync_stats.Drift, sync_stats.Rtt, sync_stats.AvgDelay, sync_stats.MinDelay, sync_stats.MaxDelay);
+			}
+			if (Enable_Pmtu) {
+				auto pmtu_stats = pmtu.GetStats();
+				log_info("peer {}: path mtu: {} max payload: {} probes: {} acks: {}", peer, pmtu_stats.PathMtu, pmtu_stats.MaxPayload, pmtu_stats.Probes, pmtu_stats.Acks);
+			}
+			if (Enable_Aead) {
+				auto& aead_stats = secured.GetStats();
+				log_info("peer {}: aead sealed: {} opened: {} auth failures: {} replays: {} malformed: {} peer restarts: {} unverified: {} challenges: {} throttled: {}", peer,
+					aead_stats.Sealed, aead_stats.Opened, aead_stats.AuthFailures, aead_stats.Replays, aead_stats.Malformed, aead_stats.Restarts,
+					aead_stats.Unverified, aead_stats.Challenges, aead_stats.Throttled);
+			}
+			if (fec) {
+				auto fec_stats = fec->GetStats();
+				log_info("peer {}: fec data/parity received: {}/{} recovered: {} lost: {}", peer,
+					fec_stats.DataReceived, fec_stats.ParityReceived, fec_stats.Recovered, fec_stats.Lost);
+			}
+			jitter.Clear();
+			pacer.Clear();
+			if (sink.Broken() || sink.Failed()) {
+				sink.Reset();
+			}
+			for (auto& r : route_sinks) {
+				if (r->Broken() || r->Failed()) {
+					r->Reset();
+				}
+			}
+			if (disconnect) {
+				// DISCONNECTҪϿỰ˳ѭʱͻΪCONNECTED´β½
+				connector.Disconnect(vsnc::utils::__steady(), reason);
+			}
 			break;
+		}
 		default:
-			std::cout << "UNKNOWN STATE" << std::endl;
+			log_warn("peer {}: UNKNOWN STATE", peer);
+			co_await loop.Sleep(1000);
 			break;
 		}
 	}
+	std::ofstream trace(std::string(Trace_Prefix) + "_" + std::to_string(peer) + ".json");
+	// Ӽʱټ¼ʹõʱ䣬ʱŻΪUTCʱ
+	connector.Trace().DumpChromeTrace(trace, vsnc::utils::__utc() - vsnc::utils::__steady());
+}
+
+
+int main(int argc, char* argv[])
+{
+	//ʼWSA
+	WORD sockVersion = MAKEWORD(2, 2);
+	WSADATA wsaData;
+	if (WSAStartup(sockVersion, &wsaData) != 0) return 0;
+	// ʱ궨TSCʱӣ궨æȲ׸Ự־
+	vsnc::utils::TscClock::Calibrate();
+
+	sockaddr_in sin;
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(4002);
+	inet_pton(AF_INET, "192.168.3.229", &sin.sin_addr);
+
+	std::array<uint8_t, vsnc::forwarder::Aead::Key_Len> key = {};
+	if (Enable_Aead && !parseKey(Aead_Key, key)) {
+		log_error("invalid aead key, expected {} hex digits.", 2 * key.size());
+		return 0;
+	}
+
+	vsnc::forwarder::ShardOptions shard_opts;
+	shard_opts.Workers = Shard_Workers;
+	shard_opts.Port = 4004;
+	vsnc::forwarder::ShardedForwarder forwarder([sin](vsnc::forwarder::EventLoop& loop, const int sock, const uint64_t peer,
+		vsnc::forwarder::ShardedForwarder::active_type active) {
+		uint64_t local = 0;
+		for (auto& s : Sessions) {
+			if (s.second == peer) {
+				local = s.first;
+			}
+		}
+		return forward(loop, sock, local, peer, sin, std::move(active));
+	}, shard_opts);
+	for (auto& s : Sessions) {
+		forwarder.AddSession(s.second);
+	}
+	if (!forwarder.Start()) {
+		log_error("UDP::bind() failed.");
+		return 0;
+	}
+	bool run = true;
+	std::thread quit(&worker, std::ref(run));
 	quit.join();
+	forwarder.Stop();
+	auto shard_stats = forwarder.GetStats();
+	for (std::size_t i = 0; i < shard_stats.size(); ++i) {
+		log_info("shard {} sessions started: {} stopped: {}", i, shard_stats[i].Started, shard_stats[i].Stopped);
+	}
+	vsnc::utils::Logger::Instance().Flush();
 	WSACleanup();
 	return 0;
 }
@@ -0,0 +1,233 @@
+﻿/************************************************************************
+ * @ObjectName: multipath.cpp
+ * @Description: 经多条独立路径冗余发送，接收端取最先到达的副本并去重
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "multipath.h"
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+#include "wire.h"
+
+
+namespace
+{
+	/// <summary>以微秒为单位的领先时间直方图桶宽</summary>
+	constexpr int64_t     Gain_Bucket  = 100;
+	/// <summary>领先时间直方图的桶个数，最后一个桶包含更大的值</summary>
+	constexpr std::size_t Gain_Buckets = 2000;
+	/// <summary>连续早于窗口的数据包达到该个数时视为发送端重新编号并清空窗口</summary>
+	constexpr std::size_t Stale_Reset  = 64;
+
+	int64_t nowMicroseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	std::size_t countPaths(uint8_t paths)
+	{
+		std::size_t n = 0;
+		for (; paths; paths &= paths - 1) {
+			++n;
+		}
+		return n;
+	}
+}
+
+
+vsnc::forwarder::MultipathTransport::MultipathTransport(const std::vector<Transport*>& paths, const MultipathOptions& opts, const std::size_t mtu) :
+	m_iPaths(paths.begin(), paths.begin() + (std::min)(paths.size(), Max_Paths)),
+	m_iOpts(opts),
+	m_uMtu(mtu),
+	m_uSeq(0),
+	m_uLastPath(0),
+	m_iWindow(opts.Window),
+	m_iArrivals(m_iWindow.Size()),
+	m_uStaleRun(0),
+	m_iGains(Gain_Buckets, 0),
+	m_nGainSum(0),
+	m_uGainCount(0),
+	m_bRun(true)
+{
+	m_iSendBuf.reserve(mtu);
+	m_iStats.Wins.assign(m_iPaths.size(), 0);
+	for (std::size_t i = 0; i < m_iPaths.size(); ++i) {
+		m_iThreads.emplace_back(&MultipathTransport::_Run, this, i);
+	}
+}
+
+
+vsnc::forwarder::MultipathTransport::~MultipathTransport()
+{
+	m_bRun.store(false);
+	for (auto& t : m_iThreads) {
+		t.join();
+	}
+}
+
+
+ssize_t vsnc::forwarder::MultipathTransport::Send(const utils::Memory<char>& mem, const int64_t ts)
+{
+	if (Header_Len + mem.Length() > m_uMtu) {
+		return -1;
+	}
+	m_iSendBuf.resize(Header_Len + mem.Length());
+	__put_u32(m_iSendBuf.data(), m_uSeq++);
+	memcpy(m_iSendBuf.data() + Header_Len, mem.Data(), mem.Length());
+	utils::BasicMemory<char> pkt(m_iSendBuf.data(), m_iSendBuf.size());
+	auto ok = false;
+	for (auto path : m_iPaths) {
+		ok = (path->Send(pkt, ts) >= 0) || ok;
+	}
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	++m_iStats.Sent;
+	if (!ok) {
+		++m_iStats.Failures;
+		return -1;
+	}
+	return static_cast<ssize_t>(mem.Length());
+}
+
+
+ssize_t vsnc::forwarder::MultipathTransport::Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout)
+{
+	std::unique_lock<std::mutex> lock(m_iMutex);
+	auto ready = [this]() { return !m_iQueue.empty(); };
+	if (timeout < 0) {
+		m_iReady.wait(lock, ready);
+	}
+	else if (!m_iReady.wait_for(lock, std::chrono::milliseconds(timeout), ready)) {
+		return -2;
+	}
+	auto& pkt = m_iQueue.front();
+	auto n = pkt.data.size();
+	ssize_t ret = -1;
+	if (n <= mem.Length()) {
+		memcpy(mem.Data(), pkt.data.data(), n);
+		ts = pkt.ts;
+		m_uLastPath = pkt.path;
+		ret = static_cast<ssize_t>(n);
+	}
+	m_iFree.push_back(std::move(pkt.data));
+	m_iQueue.pop_front();
+	return ret;
+}
+
+
+vsnc::forwarder::MultipathStats vsnc::forwarder::MultipathTransport::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	auto stats = m_iStats;
+	if (m_uGainCount) {
+		stats.GainAvg = m_nGainSum / static_cast<int64_t>(m_uGainCount);
+		// 取累计个数首次达到99%的桶的上界
+		auto target = m_uGainCount - m_uGainCount / 100;
+		uint64_t acc = 0;
+		for (std::size_t i = 0; i < m_iGains.size(); ++i) {
+			acc += m_iGains[i];
+			if (acc >= target) {
+				stats.Gain99 = (std::min)(static_cast<int64_t>(i + 1) * Gain_Bucket, stats.GainMax);
+				break;
+			}
+		}
+	}
+	return stats;
+}
+
+
+void vsnc::forwarder::MultipathTransport::_Run(const std::size_t index)
+{
+	auto path = m_iPaths[index];
+	std::vector<char> buf(m_uMtu);
+	while (m_bRun.load()) {
+		utils::BasicMemory<char> mem(buf.data(), buf.size());
+		int64_t ts = 0;
+		auto ret = path->Receive(mem, ts, m_iOpts.PollTimeout);
+		if (-2 == ret) {
+			continue;
+		}
+		if (ret < 0) {
+			// 路径尚未连接或已断开，稍后重试
+			std::this_thread::sleep_for(std::chrono::milliseconds(m_iOpts.PollTimeout));
+			continue;
+		}
+		auto now = nowMicroseconds();
+		if (static_cast<std::size_t>(ret) < Header_Len) {
+			continue;
+		}
+		bool queued = false;
+		{
+			std::lock_guard<std::mutex> lock(m_iMutex);
+			queued = _Input(index, buf, static_cast<std::size_t>(ret), ts, now);
+		}
+		if (queued) {
+			m_iReady.notify_one();
+		}
+	}
+}
+
+
+bool vsnc::forwarder::MultipathTransport::_Input(const std::size_t index, const std::vector<char>& buf, const std::size_t len, const int64_t ts, const int64_t now)
+{
+	auto seq = __get_u32(buf.data());
+	auto state = m_iWindow.Insert(seq);
+	if (seq_state::STALE == state) {
+		++m_iStats.Stale;
+		if (++m_uStaleRun < Stale_Reset) {
+			return false;
+		}
+		m_iWindow.Reset();
+		std::fill(m_iArrivals.begin(), m_iArrivals.end(), __arrival());
+		state = m_iWindow.Insert(seq);
+	}
+	m_uStaleRun = 0;
+	auto bit = static_cast<uint8_t>(1u << index);
+	auto& slot = m_iArrivals[seq & (m_iArrivals.size() - 1)];
+	if (seq_state::DUPLICATE == state) {
+		++m_iStats.Duplicates;
+		if ((slot.seq == seq) && (slot.paths)) {
+			if ((slot.first >= 0) && !(slot.paths & bit)) {
+				_Gain(now - slot.first);
+				slot.first = -1;
+			}
+			slot.paths |= bit;
+		}
+		return false;
+	}
+	// 槽位中的旧记录已移出窗口，只经部分路径到达说明其余路径丢失了该数据包
+	if (slot.paths && (countPaths(slot.paths) < m_iPaths.size())) {
+		++m_iStats.Rescued;
+	}
+	slot.seq = seq;
+	slot.paths = bit;
+	slot.first = now;
+	if (m_iQueue.size() >= m_iOpts.QueueLimit) {
+		++m_iStats.Overflows;
+		return false;
+	}
+	std::vector<char> data;
+	if (!m_iFree.empty()) {
+		data = std::move(m_iFree.back());
+		m_iFree.pop_back();
+	}
+	data.assign(buf.data() + Header_Len, buf.data() + len);
+	m_iQueue.push_back(__packet{ index, ts, std::move(data) });
+	++m_iStats.Wins[index];
+	++m_iStats.Delivered;
+	return true;
+}
+
+
+void vsnc::forwarder::MultipathTransport::_Gain(const int64_t gain)
+{
+	auto g = (std::max)(gain, static_cast<int64_t>(0));
+	m_iGains[(std::min)(static_cast<std::size_t>(g / Gain_Bucket), Gain_Buckets - 1)]++;
+	m_nGainSum += g;
+	++m_uGainCount;
+	m_iStats.GainMax = (std::max)(m_iStats.GainMax, g);
+}
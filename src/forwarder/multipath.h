@@ -0,0 +1,242 @@
+﻿/************************************************************************
+ * @ObjectName: multipath.h
+ * @Description: 经多条独立路径冗余发送，接收端取最先到达的副本并去重
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_MULTIPATH_H__
+#define __VSNC_FORWARDER_MULTIPATH_H__
+
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+
+#include <stdint.h>
+
+
+#include "transport.h"
+#include "seq_window.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 多路径参数
+		/// </summary>
+		struct MultipathOptions
+		{
+			/// <summary>去重窗口的序号个数</summary>
+			std::size_t Window      = 4096;
+			/// <summary>已去重待取出的数据包个数上限</summary>
+			std::size_t QueueLimit  = 1024;
+			/// <summary>以毫秒为单位的接收线程单次等待时间，决定析构时的最长等待</summary>
+			int64_t     PollTimeout = 50;
+		};
+
+
+		/// <summary>
+		/// 多路径统计信息
+		/// </summary>
+		struct MultipathStats
+		{
+			/// <summary>发送的数据包个数</summary>
+			uint64_t              Sent       = 0;
+			/// <summary>所有路径都发送失败的数据包个数</summary>
+			uint64_t              Failures   = 0;
+			/// <summary>去重后交付的数据包个数</summary>
+			uint64_t              Delivered  = 0;
+			/// <summary>丢弃的重复副本个数</summary>
+			uint64_t              Duplicates = 0;
+			/// <summary>早于去重窗口而丢弃的数据包个数</summary>
+			uint64_t              Stale      = 0;
+			/// <summary>队列已满而丢弃的数据包个数</summary>
+			uint64_t              Overflows  = 0;
+			/// <summary>移出窗口时仍只经部分路径到达的数据包个数，即冗余掩盖的丢包</summary>
+			uint64_t              Rescued    = 0;
+			/// <summary>按路径序号排列的最先到达的数据包个数</summary>
+			std::vector<uint64_t> Wins;
+			/// <summary>以微秒为单位的最先到达的副本领先于次先到达的副本的平均时间</summary>
+			int64_t               GainAvg    = 0;
+			/// <summary>以微秒为单位的领先时间的99分位数，即冗余削减的尾延迟</summary>
+			int64_t               Gain99     = 0;
+			/// <summary>以微秒为单位的最大领先时间</summary>
+			int64_t               GainMax    = 0;
+		};
+
+
+		/// <summary>
+		/// <para>多路径冗余传输层</para>
+		/// <para>发送端为每个数据报附加4字节的序号头，经所有路径各发送一份；接收端每条路径一个接收线程，以到达时间为准取最先到达的副本，其余副本经滑动位图去重后丢弃</para>
+		/// <para>路径可以是经不同中转服务器或本地网卡建立的多个p2p::Client，各路径的Send会在调用者线程中与接收线程的Receive并发执行，因此路径应是ClientTransport等允许收发并发的传输；拥塞控制、前向纠错等协议层应叠加在本层之上</para>
+		/// <para>Send与Receive可分别在不同线程中调用，但各自不应并发调用</para>
+		/// </summary>
+		class MultipathTransport final : public Transport
+		{
+		public:
+
+			/// <summary>数据头长度</summary>
+			static constexpr std::size_t Header_Len = 4;
+			/// <summary>路径个数上限</summary>
+			static constexpr std::size_t Max_Paths  = 8;
+
+		private:
+
+			/// <summary>
+			/// 已去重待取出的数据包
+			/// </summary>
+			struct __packet
+			{
+				/// <summary>最先送达的路径序号</summary>
+				std::size_t       path;
+				/// <summary>数据时间戳</summary>
+				int64_t           ts;
+				/// <summary>去掉数据头的数据</summary>
+				std::vector<char> data;
+			};
+
+			/// <summary>
+			/// 窗口内序号的到达记录，以序号对窗口长度取模索引
+			/// </summary>
+			struct __arrival
+			{
+				/// <summary>序号</summary>
+				uint32_t seq   = 0;
+				/// <summary>以位表示的已送达的路径，0为空记录</summary>
+				uint8_t  paths = 0;
+				/// <summary>以微秒为单位的首个副本的到达时间，记录领先时间后置为-1</summary>
+				int64_t  first = -1;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数，为每条路径启动接收线程
+			/// </summary>
+			/// <param name="paths">路径，个数不超过Max_Paths，生存期须长于本对象</param>
+			/// <param name="opts">多路径参数</param>
+			/// <param name="mtu">下层单个数据报的最大长度</param>
+			MultipathTransport(const std::vector<Transport*>& paths, const MultipathOptions& opts = MultipathOptions(), const std::size_t mtu = 1504);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			MultipathTransport(const MultipathTransport&) = delete;
+
+			/// <summary>
+			/// 析构函数，停止接收线程
+			/// </summary>
+			~MultipathTransport();
+
+			/// <summary>
+			/// 经所有路径发送数据
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>至少一条路径发送成功返回数据长度，数据过长或全部失败返回-1</returns>
+			ssize_t        Send(const utils::Memory<char>& mem, const int64_t ts) override;
+
+			/// <summary>
+			/// 接收去重后的数据
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，缓冲区过小返回-1，超时返回-2</returns>
+			ssize_t        Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override;
+
+			/// <summary>
+			/// 获取最近一次Receive返回的数据包最先经哪条路径送达
+			/// </summary>
+			/// <returns>路径序号</returns>
+			std::size_t    LastPath() const noexcept { return m_uLastPath; }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			MultipathStats GetStats();
+
+		private:
+
+			/// <summary>
+			/// 接收线程主函数
+			/// </summary>
+			/// <param name="index">路径序号</param>
+			void           _Run(const std::size_t index);
+
+			/// <summary>
+			/// 去重并将首个副本放入队列，须持有m_iMutex
+			/// </summary>
+			/// <param name="index">路径序号</param>
+			/// <param name="buf">含数据头的数据报</param>
+			/// <param name="len">数据报长度</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <param name="now">以微秒为单位的到达时间</param>
+			/// <returns>放入队列返回true</returns>
+			bool           _Input(const std::size_t index, const std::vector<char>& buf, const std::size_t len, const int64_t ts, const int64_t now);
+
+			/// <summary>
+			/// 记录首个副本的领先时间，须持有m_iMutex
+			/// </summary>
+			/// <param name="gain">以微秒为单位的领先时间</param>
+			void           _Gain(const int64_t gain);
+
+		private:
+
+			/// <summary>路径</summary>
+			const std::vector<Transport*> m_iPaths;
+			/// <summary>多路径参数</summary>
+			const MultipathOptions        m_iOpts;
+			/// <summary>下层单个数据报的最大长度</summary>
+			const std::size_t             m_uMtu;
+			/// <summary>下一个发送序号</summary>
+			uint32_t                      m_uSeq;
+			/// <summary>发送缓冲区</summary>
+			std::vector<char>             m_iSendBuf;
+			/// <summary>最近一次交付的数据包的路径序号</summary>
+			std::size_t                   m_uLastPath;
+			/// <summary>保护以下接收状态</summary>
+			std::mutex                    m_iMutex;
+			/// <summary>队列非空的通知</summary>
+			std::condition_variable       m_iReady;
+			/// <summary>去重窗口</summary>
+			SequenceWindow                m_iWindow;
+			/// <summary>窗口内序号的到达记录</summary>
+			std::vector<__arrival>        m_iArrivals;
+			/// <summary>连续早于窗口的数据包个数，过多时视为发送端重新编号</summary>
+			std::size_t                   m_uStaleRun;
+			/// <summary>已去重待取出的数据包</summary>
+			std::deque<__packet>          m_iQueue;
+			/// <summary>回收的数据缓冲区</summary>
+			std::vector<std::vector<char>> m_iFree;
+			/// <summary>以Gain_Bucket微秒为桶宽的领先时间直方图</summary>
+			std::vector<uint64_t>         m_iGains;
+			/// <summary>领先时间的总和</summary>
+			int64_t                       m_nGainSum;
+			/// <summary>记录的领先时间个数</summary>
+			uint64_t                      m_uGainCount;
+			/// <summary>统计信息</summary>
+			MultipathStats                m_iStats;
+			/// <summary>运行状态</summary>
+			std::atomic<bool>             m_bRun;
+			/// <summary>接收线程</summary>
+			std::vector<std::thread>      m_iThreads;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_MULTIPATH_H__
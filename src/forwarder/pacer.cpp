@@ -0,0 +1,179 @@
+﻿/************************************************************************
+ * @ObjectName: pacer.cpp
+ * @Description: 令牌桶发送整形器，平滑向下游转发时的突发流量
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "pacer.h"
+
+
+#include <algorithm>
+#include <cmath>
+
+
+vsnc::forwarder::Pacer::session_type vsnc::forwarder::Pacer::AddSession(send_func send, const PacerOptions& opts)
+{
+	__session s;
+	s.opts = opts;
+	s.send = send;
+	s.tokens = static_cast<double>(opts.Burst);
+	s.last = -1;
+	s.waitSum = 0;
+	s.waitCount = 0;
+	m_iSessions.push_back(std::move(s));
+	return m_iSessions.size() - 1;
+}
+
+
+bool vsnc::forwarder::Pacer::Enqueue(const session_type id, const utils::Memory<char>& mem, const int64_t now)
+{
+	auto& s = m_iSessions[id];
+	++s.stats.Enqueued;
+	_Refill(s, now);
+
+	// 无排队且令牌充足时直接发送，不经过队列
+	auto len = mem.Length();
+	auto need = (std::min)(static_cast<double>(len), static_cast<double>(s.opts.Burst));
+	if (s.queue.empty() && ((0 == s.opts.Rate) || (s.tokens >= need))) {
+		// 不整形时不扣除令牌，以免累积的欠额在之后设置速率时长时间阻塞发送
+		if (s.opts.Rate) {
+			s.tokens -= static_cast<double>(len);
+		}
+		if (s.send(mem) < 0) {
+			++s.stats.Failed;
+			return false;
+		}
+		++s.stats.Sent;
+		return true;
+	}
+	if (s.queue.size() >= s.opts.QueueLimit) {
+		++s.stats.Dropped;
+		return false;
+	}
+
+	__packet pkt;
+	pkt.enqueued = now;
+	if (!m_iFree.empty()) {
+		pkt.data = std::move(m_iFree.back());
+		m_iFree.pop_back();
+	}
+	pkt.data.assign(mem.Data(), mem.Data() + len);
+	s.queue.push_back(std::move(pkt));
+	++s.stats.Delayed;
+	return true;
+}
+
+
+std::size_t vsnc::forwarder::Pacer::Flush(const int64_t now)
+{
+	std::size_t cnt = 0;
+	for (auto& s : m_iSessions) {
+		if (!s.queue.empty()) {
+			cnt += _Drain(s, now);
+		}
+	}
+	return cnt;
+}
+
+
+int64_t vsnc::forwarder::Pacer::NextRelease(const int64_t now) const noexcept
+{
+	int64_t next = -1;
+	for (auto& s : m_iSessions) {
+		if (s.queue.empty()) {
+			continue;
+		}
+		int64_t wait = 0;
+		auto need = (std::min)(static_cast<double>(s.queue.front().data.size()), static_cast<double>(s.opts.Burst));
+		if (s.opts.Rate && (s.tokens < need)) {
+			// 令牌以Rate字节每秒补充，向上取整到微秒
+			auto elapsed = (s.last < 0) ? 0 : (now - s.last);
+			auto lack = need - s.tokens - static_cast<double>(elapsed) * s.opts.Rate / 1000000.0;
+			wait = (lack > 0.0) ? static_cast<int64_t>(std::ceil(lack * 1000000.0 / s.opts.Rate)) : 0;
+		}
+		next = (next < 0) ? wait : (std::min)(next, wait);
+	}
+	return next;
+}
+
+
+void vsnc::forwarder::Pacer::SetRate(const session_type id, const uint64_t rate, const int64_t now) noexcept
+{
+	auto& s = m_iSessions[id];
+	// 先按原速率补充令牌，新速率只作用于此后的时间
+	_Refill(s, now);
+	s.opts.Rate = rate;
+	// 透支最多一个桶容量，速率变化后至多等待Burst/Rate即可恢复发送
+	s.tokens = (std::max)(s.tokens, -static_cast<double>(s.opts.Burst));
+}
+
+
+void vsnc::forwarder::Pacer::Clear() noexcept
+{
+	for (auto& s : m_iSessions) {
+		s.stats.Cleared += s.queue.size();
+		for (auto& pkt : s.queue) {
+			m_iFree.push_back(std::move(pkt.data));
+		}
+		s.queue.clear();
+		s.tokens = static_cast<double>(s.opts.Burst);
+		s.last = -1;
+	}
+}
+
+
+vsnc::forwarder::PacerStats vsnc::forwarder::Pacer::GetStats(const session_type id) const noexcept
+{
+	auto& s = m_iSessions[id];
+	auto stats = s.stats;
+	// 被清空的数据包没有等待时间，只按实际出队的数据包平均
+	stats.AvgWait = s.waitCount ? (static_cast<double>(s.waitSum) / s.waitCount) : 0.0;
+	return stats;
+}
+
+
+void vsnc::forwarder::Pacer::_Refill(__session& s, const int64_t now) noexcept
+{
+	if (s.last >= 0) {
+		s.tokens += static_cast<double>(now - s.last) * s.opts.Rate / 1000000.0;
+		s.tokens = (std::min)(s.tokens, static_cast<double>(s.opts.Burst));
+	}
+	s.last = now;
+}
+
+
+std::size_t vsnc::forwarder::Pacer::_Drain(__session& s, const int64_t now)
+{
+	_Refill(s, now);
+
+	std::size_t cnt = 0;
+	while (!s.queue.empty()) {
+		auto& pkt = s.queue.front();
+		auto len = static_cast<double>(pkt.data.size());
+		// 桶容量小于数据包长度时，允许令牌满桶后透支发送，避免数据包永久阻塞
+		auto need = (std::min)(len, static_cast<double>(s.opts.Burst));
+		if (s.opts.Rate && (s.tokens < need)) {
+			break;
+		}
+		if (s.opts.Rate) {
+			s.tokens -= len;
+		}
+
+		utils::BasicMemory<char> mem(pkt.data.data(), pkt.data.size());
+		if (s.send(mem) < 0) {
+			++s.stats.Failed;
+		}
+		else {
+			++s.stats.Sent;
+			++cnt;
+		}
+		auto wait = now - pkt.enqueued;
+		s.waitSum += wait;
+		++s.waitCount;
+		s.stats.MaxWait = (std::max)(s.stats.MaxWait, wait);
+
+		m_iFree.push_back(std::move(pkt.data));
+		s.queue.pop_front();
+	}
+	return cnt;
+}
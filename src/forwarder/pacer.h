@@ -0,0 +1,213 @@
+﻿/************************************************************************
+ * @ObjectName: pacer.h
+ * @Description: 令牌桶发送整形器，平滑向下游转发时的突发流量
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_PACER_H__
+#define __VSNC_FORWARDER_PACER_H__
+
+
+#include <vector>
+#include <deque>
+#include <functional>
+
+
+#include <stdint.h>
+
+
+#include <p2p/client.h>
+#include <vsnc_utils/memory.h>
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 令牌桶参数
+		/// </summary>
+		struct PacerOptions
+		{
+			/// <summary>以字节每秒为单位的发送速率，为0时不整形</summary>
+			uint64_t    Rate       = 0;
+			/// <summary>以字节为单位的桶容量，即允许的最大突发</summary>
+			std::size_t Burst      = 64 * 1024;
+			/// <summary>排队数据包个数上限，超出时丢弃新数据包</summary>
+			std::size_t QueueLimit = 4096;
+		};
+
+
+		/// <summary>
+		/// 整形统计信息
+		/// </summary>
+		struct PacerStats
+		{
+			/// <summary>进入整形器的数据包个数</summary>
+			uint64_t Enqueued = 0;
+			/// <summary>发出的数据包个数</summary>
+			uint64_t Sent     = 0;
+			/// <summary>因队列已满而丢弃的数据包个数</summary>
+			uint64_t Dropped  = 0;
+			/// <summary>发送失败的数据包个数</summary>
+			uint64_t Failed   = 0;
+			/// <summary>需要排队等待令牌的数据包个数</summary>
+			uint64_t Delayed  = 0;
+			/// <summary>排队后因会话结束被清空的数据包个数</summary>
+			uint64_t Cleared  = 0;
+			/// <summary>以微秒为单位的出队数据包的平均等待时间</summary>
+			double   AvgWait  = 0.0;
+			/// <summary>以微秒为单位的最大等待时间</summary>
+			int64_t  MaxWait  = 0;
+		};
+
+
+		/// <summary>
+		/// <para>令牌桶整形器</para>
+		/// <para>每个会话（下游目的地）拥有独立的令牌桶与队列，互不影响</para>
+		/// <para>整形器本身不休眠，调用者应按NextRelease返回的时间等待（如作为Receive的超时时间）后调用Flush批量发送</para>
+		/// <para>非线程安全，应在同一线程中使用</para>
+		/// </summary>
+		class Pacer
+		{
+		public:
+
+			/// <summary>会话标识类型</summary>
+			using session_type = std::size_t;
+			/// <summary>发送函数类型，返回值含义与sendto一致</summary>
+			using send_func = std::function<ssize_t(const utils::Memory<char>&)>;
+
+		private:
+
+			/// <summary>
+			/// 排队的数据包
+			/// </summary>
+			struct __packet
+			{
+				/// <summary>入队时间</summary>
+				int64_t           enqueued;
+				/// <summary>数据</summary>
+				std::vector<char> data;
+			};
+
+			/// <summary>
+			/// 会话
+			/// </summary>
+			struct __session
+			{
+				/// <summary>令牌桶参数</summary>
+				PacerOptions         opts;
+				/// <summary>发送函数</summary>
+				send_func            send;
+				/// <summary>当前令牌数（字节）</summary>
+				double               tokens;
+				/// <summary>上次补充令牌的时间</summary>
+				int64_t              last;
+				/// <summary>排队的数据包</summary>
+				std::deque<__packet> queue;
+				/// <summary>统计信息</summary>
+				PacerStats           stats;
+				/// <summary>等待时间总和</summary>
+				int64_t              waitSum;
+				/// <summary>计入等待时间的出队数据包个数</summary>
+				uint64_t             waitCount;
+			};
+
+		public:
+
+			/// <summary>
+			/// 默认构造函数
+			/// </summary>
+			Pacer() = default;
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			Pacer(const Pacer&) = delete;
+
+			/// <summary>
+			/// 添加一个会话
+			/// </summary>
+			/// <param name="send">该会话的发送函数</param>
+			/// <param name="opts">该会话的令牌桶参数</param>
+			/// <returns>会话标识</returns>
+			session_type AddSession(send_func send, const PacerOptions& opts = PacerOptions());
+
+			/// <summary>
+			/// 数据包进入整形器，令牌充足且无排队时立即发送
+			/// </summary>
+			/// <param name="id">会话标识</param>
+			/// <param name="mem">数据</param>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			/// <returns>成功发送或排队返回true，被丢弃或发送失败返回false</returns>
+			bool         Enqueue(const session_type id, const utils::Memory<char>& mem, const int64_t now);
+
+			/// <summary>
+			/// 发送所有会话中令牌已充足的数据包
+			/// </summary>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			/// <returns>发送的数据包个数</returns>
+			std::size_t  Flush(const int64_t now);
+
+			/// <summary>
+			/// 获取距下一个数据包可以发送的时间
+			/// </summary>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			/// <returns>以微秒为单位的等待时间，没有排队的数据包时返回-1</returns>
+			int64_t      NextRelease(const int64_t now) const noexcept;
+
+			/// <summary>
+			/// 修改会话的发送速率，供拥塞控制等按反馈调整速率
+			/// </summary>
+			/// <param name="id">会话标识</param>
+			/// <param name="rate">以字节每秒为单位的发送速率，为0时不整形</param>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			void         SetRate(const session_type id, const uint64_t rate, const int64_t now) noexcept;
+
+			/// <summary>
+			/// 丢弃所有排队的数据包并重置令牌桶
+			/// </summary>
+			void         Clear() noexcept;
+
+			/// <summary>
+			/// 获取会话的统计信息
+			/// </summary>
+			/// <param name="id">会话标识</param>
+			/// <returns>统计信息</returns>
+			PacerStats   GetStats(const session_type id) const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 补充令牌
+			/// </summary>
+			/// <param name="s">会话</param>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			static void  _Refill(__session& s, const int64_t now) noexcept;
+
+			/// <summary>
+			/// 发送一个会话中令牌已充足的数据包
+			/// </summary>
+			/// <param name="s">会话</param>
+			/// <param name="now">以微秒为单位的单调时间</param>
+			/// <returns>发送的数据包个数</returns>
+			std::size_t  _Drain(__session& s, const int64_t now);
+
+		private:
+
+			/// <summary>会话列表</summary>
+			std::vector<__session>         m_iSessions;
+			/// <summary>可复用的空闲缓冲区</summary>
+			std::vector<std::vector<char>> m_iFree;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_PACER_H__
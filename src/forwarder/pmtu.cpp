@@ -0,0 +1,252 @@
+﻿/************************************************************************
+ * @ObjectName: pmtu.cpp
+ * @Description: P2P数据通道的路径MTU探测
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "pmtu.h"
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+#include "wire.h"
+
+
+namespace
+{
+	/// <summary>数据报类型：数据</summary>
+	constexpr char        Kind_Data  = 0;
+	/// <summary>数据报类型：探测</summary>
+	constexpr char        Kind_Probe = 1;
+	/// <summary>数据报类型：探测确认</summary>
+	constexpr char        Kind_Ack   = 2;
+	/// <summary>探测包与确认的头长度：类型、编号、长度</summary>
+	constexpr std::size_t Probe_Len  = 5;
+
+	int64_t nowMilliseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+
+constexpr std::size_t vsnc::forwarder::PmtuTransport::Header_Len;
+
+
+vsnc::forwarder::PmtuTransport::PmtuTransport(Transport& lower, const PmtuOptions& opts) :
+	m_iLower(lower),
+	m_iOpts(opts),
+	m_eState(pmtu_state::COMPLETE),
+	m_uConfirmed(opts.MinSize),
+	m_uFailed(opts.MaxSize + 1),
+	m_uProbing(0),
+	m_uTries(0),
+	m_uProbeId(0),
+	m_nProbeAt(-1),
+	m_nRaiseAt(0),
+	m_iRecvBuf(opts.MaxSize)
+{
+	// 首次Poll时立即到达增大时间，从而开始搜索
+	m_iSendBuf.reserve(opts.MaxSize);
+}
+
+
+ssize_t vsnc::forwarder::PmtuTransport::Send(const utils::Memory<char>& mem, const int64_t ts)
+{
+	if (m_iOpts.Overhead + Header_Len + mem.Length() > m_iOpts.MaxSize) {
+		return -1;
+	}
+	m_iSendBuf.resize(Header_Len + mem.Length());
+	m_iSendBuf[0] = Kind_Data;
+	memcpy(m_iSendBuf.data() + Header_Len, mem.Data(), mem.Length());
+	utils::BasicMemory<char> out(m_iSendBuf.data(), m_iSendBuf.size());
+	if (m_iLower.Send(out, ts) < 0) {
+		return -1;
+	}
+	return static_cast<ssize_t>(mem.Length());
+}
+
+
+ssize_t vsnc::forwarder::PmtuTransport::Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout)
+{
+	auto start = nowMilliseconds();
+	while (true) {
+		Poll();
+		auto now = nowMilliseconds();
+		auto wait = (timeout < 0) ? timeout : (std::max)(timeout - (now - start), static_cast<int64_t>(0));
+		// 探测进行中时不阻塞超过探测超时，以便及时重发
+		if ((pmtu_state::SEARCHING == m_eState) && (m_nProbeAt >= 0)) {
+			auto due = (std::max)(m_nProbeAt + m_iOpts.ProbeTimeout - now, static_cast<int64_t>(0));
+			wait = (wait < 0) ? due : (std::min)(wait, due);
+		}
+		utils::BasicMemory<char> buf(m_iRecvBuf.data(), m_iRecvBuf.size());
+		auto ret = m_iLower.Receive(buf, ts, wait);
+		auto expired = (timeout >= 0) && (nowMilliseconds() - start >= timeout);
+		if (-2 == ret) {
+			if (expired) {
+				return ret;
+			}
+			continue;
+		}
+		if (ret <= 0) {
+			return ret;
+		}
+		auto p = m_iRecvBuf.data();
+		auto len = static_cast<std::size_t>(ret);
+		if (Kind_Data == p[0]) {
+			auto n = len - Header_Len;
+			if (n > mem.Length()) {
+				return -1;
+			}
+			memcpy(mem.Data(), p + Header_Len, n);
+			return static_cast<ssize_t>(n);
+		}
+		if ((Kind_Probe == p[0]) && (len >= Probe_Len)) {
+			// 回送不含填充的确认，并带上实际收到的长度
+			char ack[Probe_Len];
+			ack[0] = Kind_Ack;
+			memcpy(ack + 1, p + 1, 2);
+			__put_u16(ack + 3, static_cast<uint16_t>(len));
+			utils::BasicMemory<char> out(ack, sizeof(ack));
+			m_iLower.Send(out, 0);
+		}
+		else if ((Kind_Ack == p[0]) && (len >= Probe_Len)) {
+			if ((pmtu_state::SEARCHING == m_eState) && (m_nProbeAt >= 0) && (__get_u16(p + 1) == m_uProbeId) && (__get_u16(p + 3) == m_uProbing - m_iOpts.Overhead)) {
+				++m_iStats.Acks;
+				_Settle(true, nowMilliseconds());
+			}
+		}
+		if (expired) {
+			return -2;
+		}
+	}
+}
+
+
+int vsnc::forwarder::PmtuTransport::Handle(int64_t& next) noexcept
+{
+	auto sock = m_iLower.Handle(next);
+	if (sock < 0) {
+		return sock;
+	}
+	int64_t due = -1;
+	if ((pmtu_state::SEARCHING == m_eState) && (m_nProbeAt >= 0)) {
+		due = m_nProbeAt + m_iOpts.ProbeTimeout;
+	}
+	else if ((pmtu_state::COMPLETE == m_eState) && (m_uConfirmed < m_iOpts.MaxSize)) {
+		due = m_nRaiseAt;
+	}
+	if (due >= 0) {
+		next = (std::min)(next, due);
+	}
+	return sock;
+}
+
+
+void vsnc::forwarder::PmtuTransport::Poll()
+{
+	auto now = nowMilliseconds();
+	if (pmtu_state::COMPLETE == m_eState) {
+		if ((m_uConfirmed < m_iOpts.MaxSize) && (now >= m_nRaiseAt)) {
+			_Search(m_iOpts.MaxSize + 1, now);
+		}
+		return;
+	}
+	if ((m_nProbeAt < 0) || (now - m_nProbeAt < m_iOpts.ProbeTimeout)) {
+		return;
+	}
+	++m_iStats.Timeouts;
+	if (m_uTries >= m_iOpts.ProbeRetries) {
+		_Settle(false, now);
+	}
+	else {
+		_Probe(now);
+	}
+}
+
+
+void vsnc::forwarder::PmtuTransport::ReportLoss(const double loss)
+{
+	if ((pmtu_state::COMPLETE != m_eState) || (loss <= m_iOpts.LossThreshold) || (m_uConfirmed <= m_iOpts.MinSize)) {
+		return;
+	}
+	// 重新确认期间退回到最小长度，确认成功后立即恢复
+	++m_iStats.Rechecks;
+	auto size = m_uConfirmed;
+	m_uConfirmed = m_iOpts.MinSize;
+	m_uFailed = size + 1;
+	m_eState = pmtu_state::SEARCHING;
+	m_uProbing = size;
+	m_uTries = 0;
+	_Probe(nowMilliseconds());
+}
+
+
+vsnc::forwarder::PmtuStats vsnc::forwarder::PmtuTransport::GetStats() const noexcept
+{
+	auto stats = m_iStats;
+	stats.PathMtu = PathMtu();
+	stats.MaxPayload = MaxPayload();
+	return stats;
+}
+
+
+void vsnc::forwarder::PmtuTransport::_Search(const std::size_t hi, const int64_t now)
+{
+	++m_iStats.Searches;
+	m_uFailed = hi;
+	m_uTries = 0;
+	if (m_uConfirmed + m_iOpts.Precision >= m_uFailed) {
+		m_eState = pmtu_state::COMPLETE;
+		m_nRaiseAt = now + m_iOpts.RaiseInterval;
+		return;
+	}
+	// 多数路径支持最大长度，先直接探测上限，失败后再二分
+	m_eState = pmtu_state::SEARCHING;
+	m_uProbing = m_uFailed - 1;
+	_Probe(now);
+}
+
+
+void vsnc::forwarder::PmtuTransport::_Probe(const int64_t now)
+{
+	// 扣除下层各头后填充，使发出的IP包恰为待测长度
+	auto len = m_uProbing - m_iOpts.Overhead;
+	++m_uProbeId;
+	m_iSendBuf.assign(len, 0);
+	m_iSendBuf[0] = Kind_Probe;
+	__put_u16(m_iSendBuf.data() + 1, m_uProbeId);
+	__put_u16(m_iSendBuf.data() + 3, static_cast<uint16_t>(len));
+	utils::BasicMemory<char> out(m_iSendBuf.data(), m_iSendBuf.size());
+	++m_uTries;
+	m_nProbeAt = now;
+	if (m_iLower.Send(out, 0) < 0) {
+		// 下层直接拒绝（如EMSGSIZE）说明本机接口即不支持该长度
+		_Settle(false, now);
+		return;
+	}
+	++m_iStats.Probes;
+}
+
+
+void vsnc::forwarder::PmtuTransport::_Settle(const bool ok, const int64_t now)
+{
+	if (ok) {
+		m_uConfirmed = m_uProbing;
+	}
+	else {
+		m_uFailed = m_uProbing;
+	}
+	m_uTries = 0;
+	m_nProbeAt = -1;
+	if (m_uConfirmed + m_iOpts.Precision >= m_uFailed) {
+		m_eState = pmtu_state::COMPLETE;
+		m_nRaiseAt = now + m_iOpts.RaiseInterval;
+		return;
+	}
+	m_uProbing = (m_uConfirmed + m_uFailed) / 2;
+	_Probe(now);
+}
@@ -0,0 +1,236 @@
+﻿/************************************************************************
+ * @ObjectName: pmtu.h
+ * @Description: P2P数据通道的路径MTU探测
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_PMTU_H__
+#define __VSNC_FORWARDER_PMTU_H__
+
+
+#include <vector>
+
+
+#include <stdint.h>
+
+
+#include "transport.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 探测状态
+		/// </summary>
+		enum class pmtu_state : int8_t
+		{
+			/// <summary>正在搜索</summary>
+			SEARCHING,
+			/// <summary>搜索完成</summary>
+			COMPLETE
+		};
+
+
+		/// <summary>
+		/// 路径MTU探测参数，长度均指IP包的长度
+		/// </summary>
+		struct PmtuOptions
+		{
+			/// <summary>保证可达的最小长度，即IPv4主机必须能接收的长度</summary>
+			std::size_t MinSize       = 576;
+			/// <summary>探测的最大长度，通常为本机出口网卡的MTU</summary>
+			std::size_t MaxSize       = 1500;
+			/// <summary>
+			/// <para>探测层之下每个数据报附加的字节数：IPv4与UDP头，加上打洞客户端的数据头与加密、序号等下层传输的头</para>
+			/// <para>探测包按待测长度减去该值交给下层，使到达网卡的IP包恰为待测长度</para>
+			/// </summary>
+			std::size_t Overhead      = 28;
+			/// <summary>搜索区间小于该值时结束搜索</summary>
+			std::size_t Precision     = 16;
+			/// <summary>以毫秒为单位的单个探测包的超时时间</summary>
+			int64_t     ProbeTimeout  = 300;
+			/// <summary>同一长度的最大探测次数，均超时则认为该长度不可达</summary>
+			std::size_t ProbeRetries  = 3;
+			/// <summary>以毫秒为单位的搜索完成后再次尝试增大的间隔</summary>
+			int64_t     RaiseInterval = 600000;
+			/// <summary>丢包率超过该值时重新确认当前长度</summary>
+			double      LossThreshold = 0.1;
+		};
+
+
+		/// <summary>
+		/// 路径MTU探测统计信息
+		/// </summary>
+		struct PmtuStats
+		{
+			/// <summary>已确认的路径MTU</summary>
+			std::size_t PathMtu    = 0;
+			/// <summary>上层单个数据报可用的最大长度</summary>
+			std::size_t MaxPayload = 0;
+			/// <summary>发出的探测包个数</summary>
+			uint64_t    Probes     = 0;
+			/// <summary>收到的探测确认个数</summary>
+			uint64_t    Acks       = 0;
+			/// <summary>探测超时次数</summary>
+			uint64_t    Timeouts   = 0;
+			/// <summary>开始搜索的次数</summary>
+			uint64_t    Searches   = 0;
+			/// <summary>因丢包而重新确认的次数</summary>
+			uint64_t    Rechecks   = 0;
+		};
+
+
+		/// <summary>
+		/// <para>路径MTU探测传输层（参考RFC 8899的DPLPMTUD）</para>
+		/// <para>每个数据报前附加1字节的类型；探测包填充到待测长度，对端收到后回送确认，以二分法在[MinSize, MaxSize]内搜索最大可达长度</para>
+		/// <para>下层必须不拆分探测包且在IP层设置不分片，即打洞客户端的DontFragment为true、MaxDatagram不小于MaxSize减去IP与UDP头，否则超长的探测包照样到达</para>
+		/// <para>搜索完成后每隔RaiseInterval尝试增大；上层报告的丢包率超过阈值时重新确认当前长度，不可达则向下搜索</para>
+		/// <para>上层应按MaxPayload决定数据报长度与缓冲区大小，并周期性调用Poll</para>
+		/// <para>非线程安全，应在同一线程中使用</para>
+		/// </summary>
+		class PmtuTransport final : public Transport
+		{
+		public:
+
+			/// <summary>类型头长度</summary>
+			static constexpr std::size_t Header_Len        = 1;
+			/// <summary>IPv4与UDP头的长度</summary>
+			static constexpr std::size_t Ip_Udp_Header_Len = 28;
+
+		public:
+
+			/// <summary>
+			/// 构造函数，首次调用Poll或Receive时开始搜索
+			/// </summary>
+			/// <param name="lower">下层传输</param>
+			/// <param name="opts">探测参数</param>
+			explicit PmtuTransport(Transport& lower, const PmtuOptions& opts = PmtuOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			PmtuTransport(const PmtuTransport&) = delete;
+
+			/// <summary>
+			/// 发送数据
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回数据长度，连同各层的头超过MaxSize或下层发送失败返回-1</returns>
+			ssize_t     Send(const utils::Memory<char>& mem, const int64_t ts) override;
+
+			/// <summary>
+			/// 接收数据，同时应答对端的探测并处理己方探测的确认
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，失败返回-1，超时返回-2</returns>
+			ssize_t     Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override;
+
+			/// <summary>
+			/// 获取下层等待可读的套接字，并将探测超时与下一次尝试提高长度的时间合并到next
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的最迟须再次调用Receive的时间</param>
+			/// <returns>套接字，不支持时返回-1</returns>
+			int         Handle(int64_t& next) noexcept override;
+
+			/// <summary>
+			/// 处理探测超时并发出下一个探测包
+			/// </summary>
+			void        Poll();
+
+			/// <summary>
+			/// 报告上层观测到的丢包率，持续偏高时可能是路径改变导致当前长度不再可达
+			/// </summary>
+			/// <param name="loss">丢包率</param>
+			void        ReportLoss(const double loss);
+
+			/// <summary>
+			/// 获取上层单个数据报可用的最大长度
+			/// </summary>
+			/// <returns>最大长度</returns>
+			std::size_t MaxPayload() const noexcept { return m_uConfirmed - m_iOpts.Overhead - Header_Len; }
+
+			/// <summary>
+			/// 获取已确认的路径MTU，打洞客户端的MaxDatagram应取该值减去Ip_Udp_Header_Len
+			/// </summary>
+			/// <returns>IP包的最大长度</returns>
+			std::size_t PathMtu() const noexcept { return m_uConfirmed; }
+
+			/// <summary>
+			/// 获取探测状态
+			/// </summary>
+			/// <returns>探测状态</returns>
+			pmtu_state  State() const noexcept { return m_eState; }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			PmtuStats   GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 开始在(m_uConfirmed, hi)内搜索
+			/// </summary>
+			/// <param name="hi">不可达或不探测的最小长度</param>
+			/// <param name="now">以毫秒为单位的当前时间</param>
+			void        _Search(const std::size_t hi, const int64_t now);
+
+			/// <summary>
+			/// 发送当前长度的探测包
+			/// </summary>
+			/// <param name="now">以毫秒为单位的当前时间</param>
+			void        _Probe(const int64_t now);
+
+			/// <summary>
+			/// 当前长度的探测结束，缩小搜索区间
+			/// </summary>
+			/// <param name="ok">是否可达</param>
+			/// <param name="now">以毫秒为单位的当前时间</param>
+			void        _Settle(const bool ok, const int64_t now);
+
+		private:
+
+			/// <summary>下层传输</summary>
+			Transport&        m_iLower;
+			/// <summary>探测参数</summary>
+			const PmtuOptions m_iOpts;
+			/// <summary>探测状态</summary>
+			pmtu_state        m_eState;
+			/// <summary>已确认可达的最大IP包长度</summary>
+			std::size_t       m_uConfirmed;
+			/// <summary>已知不可达的最小长度</summary>
+			std::size_t       m_uFailed;
+			/// <summary>正在探测的长度</summary>
+			std::size_t       m_uProbing;
+			/// <summary>当前长度已发出的探测次数</summary>
+			std::size_t       m_uTries;
+			/// <summary>当前探测包的编号</summary>
+			uint16_t          m_uProbeId;
+			/// <summary>以毫秒为单位的当前探测包的发送时间</summary>
+			int64_t           m_nProbeAt;
+			/// <summary>以毫秒为单位的下一次尝试增大的时间</summary>
+			int64_t           m_nRaiseAt;
+			/// <summary>发送缓冲区</summary>
+			std::vector<char> m_iSendBuf;
+			/// <summary>接收缓冲区</summary>
+			std::vector<char> m_iRecvBuf;
+			/// <summary>统计信息</summary>
+			PmtuStats         m_iStats;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_PMTU_H__
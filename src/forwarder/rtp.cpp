@@ -0,0 +1,297 @@
+﻿/************************************************************************
+ * @ObjectName: rtp.cpp
+ * @Description: RTP头的零拷贝解析、按SSRC与负载类型分流及RFC 3550接收统计
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "rtp.h"
+
+
+#include <algorithm>
+#include <limits>
+
+
+namespace
+{
+	/// <summary>16位序号的模</summary>
+	constexpr uint32_t    Seq_Mod   = 1u << 16;
+	/// <summary>未设置规则的标记</summary>
+	constexpr std::size_t No_Route  = (std::numeric_limits<std::size_t>::max)();
+	/// <summary>无缓存的标记</summary>
+	constexpr uint64_t    No_Cache  = (std::numeric_limits<uint64_t>::max)();
+
+	uint64_t routeKey(const uint32_t ssrc, const uint8_t pt)
+	{
+		return (static_cast<uint64_t>(ssrc) << 8) | pt;
+	}
+}
+
+
+bool vsnc::forwarder::RtpView::Parse(const char* const data, const std::size_t len) noexcept
+{
+	if ((len < Fixed_Len) || (0x80 != (static_cast<uint8_t>(data[0]) & 0xC0))) {
+		return false;
+	}
+	m_pData = data;
+	m_uLen = len;
+	auto offset = Fixed_Len + 4 * CsrcCount();
+	if (Extension()) {
+		if (offset + 4 > len) {
+			return false;
+		}
+		offset += 4 + 4 * static_cast<std::size_t>(__get_u16(data + offset + 2));
+	}
+	std::size_t padding = 0;
+	if (static_cast<uint8_t>(data[0]) & 0x20) {
+		padding = static_cast<uint8_t>(data[len - 1]);
+		if (0 == padding) {
+			return false;
+		}
+	}
+	if (offset + padding > len) {
+		return false;
+	}
+	m_uPayload = offset;
+	m_uPayloadLen = len - offset - padding;
+	return true;
+}
+
+
+vsnc::forwarder::RtpSource::RtpSource(const uint32_t ssrc, const uint32_t rate) noexcept :
+	m_uRate(rate ? rate : 90000),
+	m_dScale(m_uRate / 1e6),
+	m_uMaxSeq(0),
+	m_uCycles(0),
+	m_uBaseSeq(0),
+	m_uBadSeq(Seq_Mod + 1),
+	m_uProbation(Min_Sequential),
+	m_nEpoch(-1),
+	m_nTransit((std::numeric_limits<int64_t>::min)()),
+	m_uJitter(0)
+{
+	m_iStats.Ssrc = ssrc;
+}
+
+
+bool vsnc::forwarder::RtpSource::Update(const RtpView& pkt, const int64_t arrival) noexcept
+{
+	auto seq = pkt.Sequence();
+	m_iStats.PayloadType = pkt.PayloadType();
+	if (m_nEpoch < 0) {
+		// 首个数据包：以前一个序号作为最大序号，使下一个连续数据包通过确认
+		m_nEpoch = arrival;
+		_Init(seq);
+		m_uMaxSeq = static_cast<uint16_t>(seq - 1);
+		m_uProbation = Min_Sequential;
+	}
+	auto udelta = static_cast<uint16_t>(seq - m_uMaxSeq);
+	if (m_uProbation) {
+		if (seq == static_cast<uint16_t>(m_uMaxSeq + 1)) {
+			--m_uProbation;
+			m_uMaxSeq = seq;
+			if (0 == m_uProbation) {
+				_Init(seq);
+				++m_iStats.Received;
+				_Jitter(pkt.Timestamp(), arrival);
+				return true;
+			}
+		}
+		else {
+			m_uProbation = Min_Sequential - 1;
+			m_uMaxSeq = seq;
+		}
+		return false;
+	}
+	if (udelta < Max_Dropout) {
+		if (seq < m_uMaxSeq) {
+			m_uCycles += Seq_Mod;
+		}
+		if (udelta > 1) {
+			++m_iStats.Gaps;
+			m_iStats.MaxGap = (std::max)(m_iStats.MaxGap, static_cast<uint32_t>(udelta - 1));
+		}
+		m_uMaxSeq = seq;
+	}
+	else if (udelta <= Seq_Mod - Max_Misorder) {
+		if (seq != m_uBadSeq) {
+			// 序号大幅跳变，等待下一个连续数据包确认对端已重启
+			m_uBadSeq = (seq + 1) & (Seq_Mod - 1);
+			return false;
+		}
+		_Init(seq);
+		++m_iStats.Resyncs;
+		m_nTransit = (std::numeric_limits<int64_t>::min)();
+	}
+	else {
+		++m_iStats.Reordered;
+	}
+	++m_iStats.Received;
+	_Jitter(pkt.Timestamp(), arrival);
+	return true;
+}
+
+
+vsnc::forwarder::RtpSourceStats vsnc::forwarder::RtpSource::GetStats() const noexcept
+{
+	auto stats = m_iStats;
+	stats.MaxSeq = m_uCycles + m_uMaxSeq;
+	if (!m_uProbation) {
+		stats.Expected = static_cast<uint64_t>(stats.MaxSeq) - m_uBaseSeq + 1;
+		stats.Lost = static_cast<int64_t>(stats.Expected) - static_cast<int64_t>(stats.Received);
+	}
+	stats.Jitter = m_uJitter >> 4;
+	stats.JitterUs = static_cast<int64_t>(stats.Jitter) * 1000000 / m_uRate;
+	return stats;
+}
+
+
+void vsnc::forwarder::RtpSource::_Init(const uint16_t seq) noexcept
+{
+	m_uBaseSeq = seq;
+	m_uMaxSeq = seq;
+	m_uBadSeq = Seq_Mod + 1;
+	m_uCycles = 0;
+	m_iStats.Received = 0;
+}
+
+
+void vsnc::forwarder::RtpSource::_Jitter(const uint32_t ts, const int64_t arrival) noexcept
+{
+	// 到达时间换算为RTP时间戳单位，以乘法代替每个数据包一次的64位除法
+	auto r = static_cast<int64_t>(static_cast<double>(arrival - m_nEpoch) * m_dScale);
+	auto transit = r - static_cast<int64_t>(ts);
+	if ((std::numeric_limits<int64_t>::min)() != m_nTransit) {
+		// RTP时间戳回绕时传输时间跳变2^32，按32位差值计算
+		auto d = static_cast<int32_t>(static_cast<uint32_t>(transit - m_nTransit));
+		auto ad = static_cast<uint32_t>(d < 0 ? -static_cast<int64_t>(d) : d);
+		m_uJitter += ad - ((m_uJitter + 8) >> 4);
+	}
+	m_nTransit = transit;
+}
+
+
+vsnc::forwarder::RtpDemux::RtpDemux(const RtpDemuxOptions& opts) :
+	m_iOpts(opts),
+	m_iByPayload(128, No_Route),
+	m_iRates(128, opts.ClockRate),
+	m_uCacheKey(No_Cache),
+	m_uCacheDest(opts.Default),
+	m_pCacheSource(nullptr),
+	m_uCacheSsrc(0)
+{
+}
+
+
+void vsnc::forwarder::RtpDemux::AddRoute(const uint32_t ssrc, const uint8_t pt, const std::size_t dest)
+{
+	m_iExact[routeKey(ssrc, pt & 0x7F)] = dest;
+	m_uCacheKey = No_Cache;
+}
+
+
+void vsnc::forwarder::RtpDemux::AddSsrcRoute(const uint32_t ssrc, const std::size_t dest)
+{
+	m_iBySsrc[ssrc] = dest;
+	m_uCacheKey = No_Cache;
+}
+
+
+void vsnc::forwarder::RtpDemux::AddPayloadRoute(const uint8_t pt, const std::size_t dest)
+{
+	m_iByPayload[pt & 0x7F] = dest;
+	m_uCacheKey = No_Cache;
+}
+
+
+std::size_t vsnc::forwarder::RtpDemux::Input(const char* const data, const std::size_t len, const int64_t arrival)
+{
+	++m_iStats.Packets;
+	RtpView pkt;
+	if (!pkt.Parse(data, len)) {
+		++m_iStats.NonRtp;
+		_Count(m_iOpts.Default);
+		return m_iOpts.Default;
+	}
+	auto ssrc = pkt.Ssrc();
+	if (!m_pCacheSource || (ssrc != m_uCacheSsrc)) {
+		auto it = m_iSources.find(ssrc);
+		if (m_iSources.end() != it) {
+			m_pCacheSource = &it->second;
+		}
+		else if (m_iSources.size() < m_iOpts.MaxSources) {
+			m_pCacheSource = &m_iSources.emplace(ssrc, RtpSource(ssrc, m_iRates[pkt.PayloadType()])).first->second;
+		}
+		else {
+			m_pCacheSource = nullptr;
+		}
+		m_uCacheSsrc = ssrc;
+	}
+	if (m_pCacheSource) {
+		m_pCacheSource->Update(pkt, arrival);
+	}
+	else {
+		++m_iStats.Untracked;
+	}
+	auto dest = _Lookup(ssrc, pkt.PayloadType());
+	_Count(dest);
+	return dest;
+}
+
+
+std::size_t vsnc::forwarder::RtpDemux::Route(const char* const data, const std::size_t len) noexcept
+{
+	RtpView pkt;
+	if (!pkt.Parse(data, len)) {
+		return m_iOpts.Default;
+	}
+	return _Lookup(pkt.Ssrc(), pkt.PayloadType());
+}
+
+
+std::vector<vsnc::forwarder::RtpSourceStats> vsnc::forwarder::RtpDemux::GetSources() const
+{
+	std::vector<RtpSourceStats> sources;
+	sources.reserve(m_iSources.size());
+	for (auto& s : m_iSources) {
+		sources.push_back(s.second.GetStats());
+	}
+	std::sort(sources.begin(), sources.end(), [](const RtpSourceStats& a, const RtpSourceStats& b) {
+		return a.Ssrc < b.Ssrc;
+	});
+	return sources;
+}
+
+
+std::size_t vsnc::forwarder::RtpDemux::_Lookup(const uint32_t ssrc, const uint8_t pt) noexcept
+{
+	auto key = routeKey(ssrc, pt);
+	if (key == m_uCacheKey) {
+		return m_uCacheDest;
+	}
+	auto dest = m_iOpts.Default;
+	auto exact = m_iExact.find(key);
+	if (m_iExact.end() != exact) {
+		dest = exact->second;
+	}
+	else {
+		auto by_ssrc = m_iBySsrc.find(ssrc);
+		if (m_iBySsrc.end() != by_ssrc) {
+			dest = by_ssrc->second;
+		}
+		else if (No_Route != m_iByPayload[pt]) {
+			dest = m_iByPayload[pt];
+		}
+	}
+	m_uCacheKey = key;
+	m_uCacheDest = dest;
+	return dest;
+}
+
+
+void vsnc::forwarder::RtpDemux::_Count(const std::size_t dest)
+{
+	if (dest >= m_iStats.Routed.size()) {
+		m_iStats.Routed.resize(dest + 1, 0);
+	}
+	++m_iStats.Routed[dest];
+}
@@ -0,0 +1,349 @@
+﻿/************************************************************************
+ * @ObjectName: rtp.h
+ * @Description: RTP头的零拷贝解析、按SSRC与负载类型分流及RFC 3550接收统计
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_RTP_H__
+#define __VSNC_FORWARDER_RTP_H__
+
+
+#include <vector>
+#include <unordered_map>
+
+
+#include <stdint.h>
+
+
+#include "wire.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// <para>RTP数据包的只读视图</para>
+		/// <para>Parse只校验并记录负载位置，不复制数据；各字段在读取时从原缓冲区按网络字节序取出，视图的生存期不应长于缓冲区</para>
+		/// </summary>
+		class RtpView
+		{
+		public:
+
+			/// <summary>固定头长度</summary>
+			static constexpr std::size_t Fixed_Len = 12;
+
+		public:
+
+			/// <summary>
+			/// 解析数据包
+			/// </summary>
+			/// <param name="data">数据包</param>
+			/// <param name="len">数据包长度</param>
+			/// <returns>版本为2且CSRC、扩展头与填充的长度均不越界返回true</returns>
+			bool        Parse(const char* const data, const std::size_t len) noexcept;
+
+			/// <summary>获取标记位</summary>
+			bool        Marker() const noexcept { return 0 != (static_cast<uint8_t>(m_pData[1]) & 0x80); }
+			/// <summary>获取负载类型</summary>
+			uint8_t     PayloadType() const noexcept { return static_cast<uint8_t>(m_pData[1]) & 0x7F; }
+			/// <summary>获取序号</summary>
+			uint16_t    Sequence() const noexcept { return __get_u16(m_pData + 2); }
+			/// <summary>获取RTP时间戳</summary>
+			uint32_t    Timestamp() const noexcept { return __get_u32(m_pData + 4); }
+			/// <summary>获取同步源标识</summary>
+			uint32_t    Ssrc() const noexcept { return __get_u32(m_pData + 8); }
+			/// <summary>获取CSRC个数</summary>
+			std::size_t CsrcCount() const noexcept { return static_cast<uint8_t>(m_pData[0]) & 0x0F; }
+			/// <summary>获取是否带扩展头</summary>
+			bool        Extension() const noexcept { return 0 != (static_cast<uint8_t>(m_pData[0]) & 0x10); }
+			/// <summary>获取负载</summary>
+			const char* Payload() const noexcept { return m_pData + m_uPayload; }
+			/// <summary>获取不含填充的负载长度</summary>
+			std::size_t PayloadLength() const noexcept { return m_uPayloadLen; }
+			/// <summary>获取整个数据包</summary>
+			const char* Data() const noexcept { return m_pData; }
+			/// <summary>获取数据包长度</summary>
+			std::size_t Length() const noexcept { return m_uLen; }
+
+		private:
+
+			/// <summary>数据包</summary>
+			const char* m_pData       = nullptr;
+			/// <summary>数据包长度</summary>
+			std::size_t m_uLen        = 0;
+			/// <summary>负载的偏移</summary>
+			std::size_t m_uPayload    = 0;
+			/// <summary>负载长度</summary>
+			std::size_t m_uPayloadLen = 0;
+		};
+
+
+		/// <summary>
+		/// 单个同步源的接收统计信息
+		/// </summary>
+		struct RtpSourceStats
+		{
+			/// <summary>同步源标识</summary>
+			uint32_t Ssrc        = 0;
+			/// <summary>最近一个数据包的负载类型</summary>
+			uint8_t  PayloadType = 0;
+			/// <summary>收到的数据包个数，含重复与乱序</summary>
+			uint64_t Received    = 0;
+			/// <summary>按扩展序号范围应收到的数据包个数</summary>
+			uint64_t Expected    = 0;
+			/// <summary>累计丢失个数，即Expected减Received，重复包多时可为负</summary>
+			int64_t  Lost        = 0;
+			/// <summary>序号跳跃的次数</summary>
+			uint64_t Gaps        = 0;
+			/// <summary>单次序号跳跃跨过的最大个数</summary>
+			uint32_t MaxGap      = 0;
+			/// <summary>晚于更大序号到达的数据包个数</summary>
+			uint64_t Reordered   = 0;
+			/// <summary>序号大幅跳变后重新同步的次数</summary>
+			uint64_t Resyncs     = 0;
+			/// <summary>扩展后的最大序号，高16位为回绕次数</summary>
+			uint32_t MaxSeq      = 0;
+			/// <summary>以RTP时间戳为单位的到达间隔抖动</summary>
+			uint32_t Jitter      = 0;
+			/// <summary>以微秒为单位的到达间隔抖动</summary>
+			int64_t  JitterUs    = 0;
+		};
+
+
+		/// <summary>
+		/// <para>单个同步源的RFC 3550接收统计</para>
+		/// <para>序号维护按附录A.1：连续收到Min_Sequential个有序数据包后才确认新的源，跳变超过Max_Dropout视为对端重启并在下一个连续数据包处重新同步；抖动按附录A.8以1/16增益平滑</para>
+		/// </summary>
+		class RtpSource
+		{
+		public:
+
+			/// <summary>确认新的源所需的连续数据包个数</summary>
+			static constexpr uint32_t Min_Sequential = 2;
+			/// <summary>视为丢包的最大序号前跳</summary>
+			static constexpr uint32_t Max_Dropout    = 3000;
+			/// <summary>视为乱序的最大序号后跳</summary>
+			static constexpr uint32_t Max_Misorder   = 100;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="ssrc">同步源标识</param>
+			/// <param name="rate">RTP时间戳的时钟频率</param>
+			RtpSource(const uint32_t ssrc, const uint32_t rate) noexcept;
+
+			/// <summary>
+			/// 输入一个数据包
+			/// </summary>
+			/// <param name="pkt">已解析的数据包</param>
+			/// <param name="arrival">以微秒为单位的到达时间</param>
+			/// <returns>数据包有效返回true，处于确认期或被判定为跳变时返回false</returns>
+			bool           Update(const RtpView& pkt, const int64_t arrival) noexcept;
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			RtpSourceStats GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 以序号重新开始统计
+			/// </summary>
+			/// <param name="seq">序号</param>
+			void           _Init(const uint16_t seq) noexcept;
+
+			/// <summary>
+			/// 更新到达间隔抖动
+			/// </summary>
+			/// <param name="ts">RTP时间戳</param>
+			/// <param name="arrival">以微秒为单位的到达时间</param>
+			void           _Jitter(const uint32_t ts, const int64_t arrival) noexcept;
+
+		private:
+
+			/// <summary>RTP时间戳的时钟频率</summary>
+			const uint32_t m_uRate;
+			/// <summary>每微秒的RTP时间戳单位数</summary>
+			const double   m_dScale;
+			/// <summary>最大序号</summary>
+			uint16_t       m_uMaxSeq;
+			/// <summary>左移16位的回绕次数</summary>
+			uint32_t       m_uCycles;
+			/// <summary>统计开始时的序号</summary>
+			uint32_t       m_uBaseSeq;
+			/// <summary>跳变后期待的下一个序号，用于判断是否重新同步</summary>
+			uint32_t       m_uBadSeq;
+			/// <summary>确认期内尚需的连续数据包个数</summary>
+			uint32_t       m_uProbation;
+			/// <summary>以到达时间计算抖动的基准，首个数据包的到达时间</summary>
+			int64_t        m_nEpoch;
+			/// <summary>上一个数据包的相对传输时间，尚无时为INT64_MIN</summary>
+			int64_t        m_nTransit;
+			/// <summary>放大16倍的抖动</summary>
+			uint32_t       m_uJitter;
+			/// <summary>统计信息</summary>
+			RtpSourceStats m_iStats;
+		};
+
+
+		/// <summary>
+		/// RTP分流参数
+		/// </summary>
+		struct RtpDemuxOptions
+		{
+			/// <summary>未命中任何规则的RTP数据包及非RTP数据包的目的地</summary>
+			std::size_t Default    = 0;
+			/// <summary>未单独设置的负载类型使用的RTP时间戳时钟频率</summary>
+			uint32_t    ClockRate  = 90000;
+			/// <summary>统计的同步源个数上限，超出后的新源只分流不统计</summary>
+			std::size_t MaxSources = 256;
+		};
+
+
+		/// <summary>
+		/// RTP分流统计信息
+		/// </summary>
+		struct RtpDemuxStats
+		{
+			/// <summary>输入的数据包个数</summary>
+			uint64_t              Packets   = 0;
+			/// <summary>无法按RTP解析的数据包个数</summary>
+			uint64_t              NonRtp    = 0;
+			/// <summary>因同步源个数达到上限而未统计的数据包个数</summary>
+			uint64_t              Untracked = 0;
+			/// <summary>按目的地序号排列的分流个数</summary>
+			std::vector<uint64_t> Routed;
+		};
+
+
+		/// <summary>
+		/// <para>按SSRC与负载类型分流的RTP解复用器</para>
+		/// <para>规则按精确匹配（SSRC与负载类型）、仅SSRC、仅负载类型的顺序查找，均未命中时交给Default；目的地只是序号，由调用者映射到下游</para>
+		/// <para>同时按同步源维护RFC 3550的丢包、乱序与抖动统计；连续数据包通常来自同一个流，因此缓存上一次的查找结果，热路径上只有一次头解析与一次比较</para>
+		/// <para>非线程安全</para>
+		/// </summary>
+		class RtpDemux
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="opts">分流参数</param>
+			explicit RtpDemux(const RtpDemuxOptions& opts = RtpDemuxOptions());
+
+			/// <summary>
+			/// 添加按SSRC与负载类型精确匹配的规则
+			/// </summary>
+			/// <param name="ssrc">同步源标识</param>
+			/// <param name="pt">负载类型</param>
+			/// <param name="dest">目的地</param>
+			void                        AddRoute(const uint32_t ssrc, const uint8_t pt, const std::size_t dest);
+
+			/// <summary>
+			/// 添加只匹配SSRC的规则
+			/// </summary>
+			/// <param name="ssrc">同步源标识</param>
+			/// <param name="dest">目的地</param>
+			void                        AddSsrcRoute(const uint32_t ssrc, const std::size_t dest);
+
+			/// <summary>
+			/// 添加只匹配负载类型的规则
+			/// </summary>
+			/// <param name="pt">负载类型</param>
+			/// <param name="dest">目的地</param>
+			void                        AddPayloadRoute(const uint8_t pt, const std::size_t dest);
+
+			/// <summary>
+			/// 设置负载类型的RTP时间戳时钟频率，只影响之后出现的同步源
+			/// </summary>
+			/// <param name="pt">负载类型</param>
+			/// <param name="rate">时钟频率</param>
+			void                        SetClockRate(const uint8_t pt, const uint32_t rate) noexcept { m_iRates[pt & 0x7F] = rate; }
+
+			/// <summary>
+			/// 输入网络上收到的数据包，更新统计并返回目的地
+			/// </summary>
+			/// <param name="data">数据包</param>
+			/// <param name="len">数据包长度</param>
+			/// <param name="arrival">以微秒为单位的到达时间</param>
+			/// <returns>目的地</returns>
+			std::size_t                 Input(const char* const data, const std::size_t len, const int64_t arrival);
+
+			/// <summary>
+			/// 只查找目的地而不更新统计，用于经抖动缓冲区等延后转发的数据包
+			/// </summary>
+			/// <param name="data">数据包</param>
+			/// <param name="len">数据包长度</param>
+			/// <returns>目的地</returns>
+			std::size_t                 Route(const char* const data, const std::size_t len) noexcept;
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			RtpDemuxStats               GetStats() const { return m_iStats; }
+
+			/// <summary>
+			/// 获取各同步源的统计信息
+			/// </summary>
+			/// <returns>按同步源标识排列的统计信息</returns>
+			std::vector<RtpSourceStats> GetSources() const;
+
+		private:
+
+			/// <summary>
+			/// 按规则查找目的地，命中缓存时不查表
+			/// </summary>
+			/// <param name="ssrc">同步源标识</param>
+			/// <param name="pt">负载类型</param>
+			/// <returns>目的地</returns>
+			std::size_t                 _Lookup(const uint32_t ssrc, const uint8_t pt) noexcept;
+
+			/// <summary>
+			/// 记录一次分流
+			/// </summary>
+			/// <param name="dest">目的地</param>
+			void                        _Count(const std::size_t dest);
+
+		private:
+
+			/// <summary>分流参数</summary>
+			const RtpDemuxOptions                      m_iOpts;
+			/// <summary>以SSRC左移8位与负载类型为键的精确匹配规则</summary>
+			std::unordered_map<uint64_t, std::size_t>  m_iExact;
+			/// <summary>只匹配SSRC的规则</summary>
+			std::unordered_map<uint32_t, std::size_t>  m_iBySsrc;
+			/// <summary>以负载类型索引的规则，未设置为SIZE_MAX</summary>
+			std::vector<std::size_t>                   m_iByPayload;
+			/// <summary>以负载类型索引的时钟频率</summary>
+			std::vector<uint32_t>                      m_iRates;
+			/// <summary>各同步源的接收统计</summary>
+			std::unordered_map<uint32_t, RtpSource>    m_iSources;
+			/// <summary>上一次查找的键，无缓存时为UINT64_MAX</summary>
+			uint64_t                                   m_uCacheKey;
+			/// <summary>上一次查找的目的地</summary>
+			std::size_t                                m_uCacheDest;
+			/// <summary>上一次更新的同步源，未统计时为nullptr；元素地址在unordered_map重新散列后仍有效</summary>
+			RtpSource*                                 m_pCacheSource;
+			/// <summary>上一次更新的同步源标识</summary>
+			uint32_t                                   m_uCacheSsrc;
+			/// <summary>统计信息</summary>
+			RtpDemuxStats                              m_iStats;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_RTP_H__
@@ -0,0 +1,336 @@
+﻿/************************************************************************
+ * @ObjectName: secure.cpp
+ * @Description: 以预共享密钥对数据报认证加密并防重放
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "secure.h"
+
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "wire.h"
+
+
+namespace
+{
+	/// <summary>会话标识的掩码，数据头首个64位字的高8位为类型与算法</summary>
+	constexpr uint64_t    Session_Mask = 0x00FFFFFFFFFFFFFFull;
+	/// <summary>数据头首字节中表示质询或应答的类型位</summary>
+	constexpr uint8_t     Control_Flag = 0x80;
+	/// <summary>质询</summary>
+	constexpr uint8_t     Challenge    = 1;
+	/// <summary>应答</summary>
+	constexpr uint8_t     Response     = 2;
+	/// <summary>质询随机串长度</summary>
+	constexpr std::size_t Nonce_Len    = 16;
+	/// <summary>质询与应答的明文长度：种类(1) 随机串(16) 目标会话标识(8)</summary>
+	constexpr std::size_t Control_Len  = 1 + Nonce_Len + 8;
+
+	/// <summary>
+	/// 生成随机的会话标识
+	/// </summary>
+	uint64_t randomSession()
+	{
+		std::random_device rd;
+		return ((static_cast<uint64_t>(rd()) << 32) | rd()) & Session_Mask;
+	}
+
+	/// <summary>
+	/// 生成质询随机串
+	/// </summary>
+	void randomNonce(uint8_t* nonce)
+	{
+		std::random_device rd;
+		for (std::size_t i = 0; i < Nonce_Len; i += 4) {
+			auto v = rd();
+			memcpy(nonce + i, &v, 4);
+		}
+	}
+
+	/// <summary>
+	/// 写入数据报的随机数：4字节0后接64位大端序计数器
+	/// </summary>
+	void dataNonce(uint8_t* nonce, const uint64_t counter) noexcept
+	{
+		memset(nonce, 0, 4);
+		vsnc::forwarder::__put_u64(reinterpret_cast<char*>(nonce) + 4, counter);
+	}
+}
+
+
+vsnc::forwarder::SecureTransport::SecureTransport(Transport& lower, const uint8_t* const key, const aead_cipher cipher,
+	const std::size_t window, const std::size_t mtu) :
+	m_iLower(lower),
+	m_uMtu(mtu),
+	m_iMaster(aead_cipher::CHACHA20_POLY1305, key),
+	m_uSession(randomSession()),
+	m_uCounter(0),
+	m_uPeerSession(0),
+	m_uHighest(0),
+	m_iWindow(window),
+	m_uTick(0),
+	m_nTokens(Derive_Burst),
+	m_nRefilled(utils::__steady()),
+	m_iRecvBuf(mtu)
+{
+	auto resolved = cipher;
+	if (aead_cipher::AUTO == resolved) {
+		resolved = Aead::Accelerated() ? aead_cipher::AES_256_GCM : aead_cipher::CHACHA20_POLY1305;
+	}
+	m_pSeal = _Derive(resolved, m_uSession);
+	m_iKeys.reserve(Key_Cache);
+	m_iSendBuf.reserve(mtu);
+}
+
+
+ssize_t vsnc::forwarder::SecureTransport::Send(const utils::Memory<char>& mem, const int64_t ts)
+{
+	if (Overhead + mem.Length() > m_uMtu) {
+		return -1;
+	}
+	m_iSendBuf.resize(Overhead + mem.Length());
+	auto buf = m_iSendBuf.data();
+	__put_u64(buf, (static_cast<uint64_t>(m_pSeal->Cipher()) << 56) | m_uSession);
+	__put_u64(buf + 8, m_uCounter);
+	uint8_t nonce[Aead::Nonce_Len];
+	dataNonce(nonce, m_uCounter);
+	// 随机数在加密后即视为已使用，无论下层是否发送成功
+	++m_uCounter;
+	AeadPacket pkt;
+	pkt.Nonce = nonce;
+	pkt.Aad = reinterpret_cast<const uint8_t*>(buf);
+	pkt.AadLen = Header_Len;
+	pkt.In = reinterpret_cast<const uint8_t*>(mem.Data());
+	pkt.Out = reinterpret_cast<uint8_t*>(buf + Header_Len);
+	pkt.Len = mem.Length();
+	pkt.Tag = reinterpret_cast<uint8_t*>(buf + Header_Len + mem.Length());
+	m_pSeal->Seal(pkt);
+	utils::BasicMemory<char> out(buf, m_iSendBuf.size());
+	if (m_iLower.Send(out, ts) < 0) {
+		return -1;
+	}
+	++m_iStats.Sealed;
+	return static_cast<ssize_t>(mem.Length());
+}
+
+
+ssize_t vsnc::forwarder::SecureTransport::Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout)
+{
+	auto deadline = (timeout < 0) ? -1 : (utils::__steady() + timeout);
+	while (true) {
+		auto wait = (deadline < 0) ? timeout : (std::max)(deadline - utils::__steady(), static_cast<int64_t>(0));
+		utils::BasicMemory<char> buf(m_iRecvBuf.data(), m_iRecvBuf.size());
+		auto ret = m_iLower.Receive(buf, ts, wait);
+		if (ret <= 0) {
+			return ret;
+		}
+		auto size = _Open(mem, static_cast<std::size_t>(ret));
+		if (-3 != size) {
+			return size;
+		}
+		if ((deadline >= 0) && (utils::__steady() >= deadline)) {
+			return -2;
+		}
+	}
+}
+
+
+std::unique_ptr<vsnc::forwarder::Aead> vsnc::forwarder::SecureTransport::_Derive(const aead_cipher cipher, const uint64_t session) const
+{
+	// 以主密钥的ChaCha20密钥流作为会话密钥，随机数为算法、会话标识与"KDF\0"；会话标识来自未认证的数据头，ChaCha20没有查表，不泄露主密钥的计时信息
+	uint8_t nonce[Aead::Nonce_Len];
+	__put_u64(reinterpret_cast<char*>(nonce), (static_cast<uint64_t>(cipher) << 56) | session);
+	memcpy(nonce + 8, "KDF", 4);
+	uint8_t zero[Aead::Key_Len] = { 0 };
+	uint8_t key[Aead::Key_Len];
+	uint8_t tag[Aead::Tag_Len];
+	AeadPacket pkt;
+	pkt.Nonce = nonce;
+	pkt.In = zero;
+	pkt.Out = key;
+	pkt.Len = Aead::Key_Len;
+	pkt.Tag = tag;
+	m_iMaster.Seal(pkt);
+	return std::make_unique<Aead>(cipher, key);
+}
+
+
+vsnc::forwarder::SecureTransport::__peer_key* vsnc::forwarder::SecureTransport::_Lookup(const aead_cipher cipher, const uint64_t session)
+{
+	++m_uTick;
+	for (auto& k : m_iKeys) {
+		if ((k.cipher == cipher) && (k.session == session)) {
+			k.used = m_uTick;
+			return &k;
+		}
+	}
+	// 令牌桶限速，未命中的派生每秒最多Derive_Rate个
+	auto now = utils::__steady();
+	auto add = (now - m_nRefilled) * Derive_Rate / 1000;
+	if (add > 0) {
+		m_nTokens = (std::min)(m_nTokens + add, Derive_Burst);
+		m_nRefilled = (Derive_Burst == m_nTokens) ? now : (m_nRefilled + add * 1000 / Derive_Rate);
+	}
+	if (m_nTokens <= 0) {
+		return nullptr;
+	}
+	--m_nTokens;
+	__peer_key* slot = nullptr;
+	if (m_iKeys.size() < Key_Cache) {
+		m_iKeys.emplace_back();
+		slot = &m_iKeys.back();
+	}
+	else {
+		// 淘汰最久未用的缓存，当前对端会话除外
+		for (auto& k : m_iKeys) {
+			if ((k.key != m_pOpen) && (!slot || (k.used < slot->used))) {
+				slot = &k;
+			}
+		}
+	}
+	slot->cipher = cipher;
+	slot->session = session;
+	slot->key = _Derive(cipher, session);
+	slot->challengedAt = -1;
+	slot->used = m_uTick;
+	return slot;
+}
+
+
+void vsnc::forwarder::SecureTransport::_Control(const uint8_t kind, const uint8_t* const nonce, const uint64_t target)
+{
+	char buf[Overhead + Control_Len];
+	uint8_t plain[Control_Len];
+	plain[0] = kind;
+	memcpy(plain + 1, nonce, Nonce_Len);
+	__put_u64(reinterpret_cast<char*>(plain) + 1 + Nonce_Len, target);
+	__put_u64(buf, (static_cast<uint64_t>(static_cast<uint8_t>(m_pSeal->Cipher()) | Control_Flag) << 56) | m_uSession);
+	__put_u64(buf + 8, m_uCounter);
+	uint8_t iv[Aead::Nonce_Len];
+	dataNonce(iv, m_uCounter);
+	++m_uCounter;
+	AeadPacket pkt;
+	pkt.Nonce = iv;
+	pkt.Aad = reinterpret_cast<const uint8_t*>(buf);
+	pkt.AadLen = Header_Len;
+	pkt.In = plain;
+	pkt.Out = reinterpret_cast<uint8_t*>(buf + Header_Len);
+	pkt.Len = Control_Len;
+	pkt.Tag = reinterpret_cast<uint8_t*>(buf + Header_Len + Control_Len);
+	m_pSeal->Seal(pkt);
+	utils::BasicMemory<char> out(buf, sizeof(buf));
+	m_iLower.Send(out, 0);
+}
+
+
+void vsnc::forwarder::SecureTransport::_Accept(__peer_key& peer)
+{
+	m_pOpen = peer.key;
+	m_uPeerSession = peer.session;
+	m_uHighest = 0;
+	m_iWindow.Reset();
+	peer.challengedAt = -1;
+}
+
+
+ssize_t vsnc::forwarder::SecureTransport::_Open(utils::Memory<char>& mem, const std::size_t len)
+{
+	if (len < Overhead) {
+		++m_iStats.Malformed;
+		return -3;
+	}
+	auto buf = m_iRecvBuf.data();
+	auto word = __get_u64(buf);
+	auto control = 0 != ((word >> 56) & Control_Flag);
+	auto cipher = static_cast<aead_cipher>((word >> 56) & ~static_cast<uint64_t>(Control_Flag) & 0xFF);
+	auto session = word & Session_Mask;
+	auto counter = __get_u64(buf + 8);
+	auto size = len - Overhead;
+	if (((aead_cipher::AES_256_GCM != cipher) && (aead_cipher::CHACHA20_POLY1305 != cipher)) || (control && (Control_Len != size))) {
+		++m_iStats.Malformed;
+		return -3;
+	}
+	if (!control && (size > mem.Length())) {
+		return -1;
+	}
+	// 只有已确认的对端会话的数据报直接以当前密钥校验，其余先查找或在限速内派生会话密钥
+	auto current = !control && m_pOpen && (session == m_uPeerSession) && (cipher == m_pOpen->Cipher());
+	__peer_key* peer = nullptr;
+	if (current) {
+		if (counter + m_iWindow.Size() <= m_uHighest) {
+			++m_iStats.Replays;
+			return -3;
+		}
+	}
+	else if (!(peer = _Lookup(cipher, session))) {
+		++m_iStats.Throttled;
+		return -3;
+	}
+	uint8_t plain[Control_Len];
+	uint8_t nonce[Aead::Nonce_Len];
+	dataNonce(nonce, counter);
+	AeadPacket pkt;
+	pkt.Nonce = nonce;
+	pkt.Aad = reinterpret_cast<const uint8_t*>(buf);
+	pkt.AadLen = Header_Len;
+	pkt.In = reinterpret_cast<const uint8_t*>(buf + Header_Len);
+	pkt.Out = control ? plain : reinterpret_cast<uint8_t*>(mem.Data());
+	pkt.Len = size;
+	pkt.Tag = reinterpret_cast<uint8_t*>(buf + Header_Len + size);
+	if (!(current ? m_pOpen : peer->key)->Open(pkt)) {
+		++m_iStats.AuthFailures;
+		return -3;
+	}
+	if (control) {
+		// 只处理发给本端当前会话的质询与应答；重放的质询只会得到对旧随机串的应答，对端不会接受
+		if (__get_u64(reinterpret_cast<const char*>(plain) + 1 + Nonce_Len) != m_uSession) {
+			return -3;
+		}
+		if (Challenge == plain[0]) {
+			_Control(Response, plain + 1, session);
+		}
+		else if (Response != plain[0]) {
+			++m_iStats.Malformed;
+		}
+		else if ((peer->challengedAt >= 0) && __aead_equal(peer->challenge, plain + 1, Nonce_Len)) {
+			// 对端以该会话的密钥应答了本端的随机串，确认其为存活的新会话
+			if (m_pOpen && (session != m_uPeerSession)) {
+				++m_iStats.Restarts;
+			}
+			_Accept(*peer);
+		}
+		return -3;
+	}
+	if (!current && !m_pOpen) {
+		// 尚无对端会话：直接接受，只发送不接收的对端不会应答质询；此后的会话更替仍须质询确认
+		_Accept(*peer);
+	}
+	else if (!current) {
+		// 未确认的会话：可能是对端重启，也可能是录制的旧会话，丢弃并质询，当前会话不受影响
+		++m_iStats.Unverified;
+		auto now = utils::__steady();
+		if ((peer->challengedAt < 0) || (now - peer->challengedAt >= Challenge_Interval)) {
+			if (peer->challengedAt < 0) {
+				randomNonce(peer->challenge);
+			}
+			peer->challengedAt = now;
+			_Control(Challenge, peer->challenge, session);
+			++m_iStats.Challenges;
+		}
+		return -3;
+	}
+	if (seq_state::FRESH != m_iWindow.Insert(static_cast<uint32_t>(counter))) {
+		++m_iStats.Replays;
+		return -3;
+	}
+	m_uHighest = (std::max)(m_uHighest, counter);
+	++m_iStats.Opened;
+	return static_cast<ssize_t>(size);
+}
@@ -0,0 +1,242 @@
+﻿/************************************************************************
+ * @ObjectName: secure.h
+ * @Description: 以预共享密钥对数据报认证加密并防重放
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_SECURE_H__
+#define __VSNC_FORWARDER_SECURE_H__
+
+
+#include <memory>
+#include <vector>
+
+
+#include <stdint.h>
+
+
+#include "transport.h"
+#include "aead.h"
+#include "seq_window.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 加密传输统计信息
+		/// </summary>
+		struct SecureStats
+		{
+			/// <summary>加密发送的数据报个数</summary>
+			uint64_t Sealed       = 0;
+			/// <summary>校验通过并交付的数据报个数</summary>
+			uint64_t Opened       = 0;
+			/// <summary>认证标签校验失败的数据报个数</summary>
+			uint64_t AuthFailures = 0;
+			/// <summary>计数器重复或早于重放窗口而丢弃的数据报个数</summary>
+			uint64_t Replays      = 0;
+			/// <summary>过短、算法或控制类型未知而丢弃的数据报个数</summary>
+			uint64_t Malformed    = 0;
+			/// <summary>对端会话更替的次数，即对端重启的次数</summary>
+			uint64_t Restarts     = 0;
+			/// <summary>发出的质询个数</summary>
+			uint64_t Challenges   = 0;
+			/// <summary>校验通过但会话尚未经质询确认而丢弃的数据报个数</summary>
+			uint64_t Unverified   = 0;
+			/// <summary>因派生会话密钥过于频繁而未校验即丢弃的数据报个数</summary>
+			uint64_t Throttled    = 0;
+		};
+
+
+		/// <summary>
+		/// <para>认证加密传输层</para>
+		/// <para>格式：类型与算法(1) 会话标识(7) 计数器(8) 密文 标签(16)；数据头作为关联数据参与认证，计数器作为随机数；类型位为1的是质询与应答，密文为种类(1) 随机串(16) 目标会话标识(8)</para>
+		/// <para>两端预共享主密钥，每个实例生成随机的会话标识并由主密钥以ChaCha20派生会话密钥，因此重启后计数器从0开始也不会重用随机数；接收端按数据头的算法与会话标识派生对端的会话密钥，两端可使用不同的算法</para>
+		/// <para>尚无对端会话时直接接受首个校验通过的会话，只发送不接收的对端无需应答即可送达；代价是先于对端到达的录制数据报可能被当作首个会话，直到对端的真实会话经质询确认后替换</para>
+		/// <para>已有对端会话时，新的会话须经质询确认：校验通过的未知会话的数据报被丢弃，并以本端会话密钥向其发出随机串，只有持有该会话密钥的对端才能以其会话密钥加密应答；收到匹配的应答后才替换当前会话，录制的旧会话数据报无法应答，未经请求的数据报也不会使当前会话退役</para>
+		/// <para>因此对端重启后须在Receive中处理质询，新会话的首个往返内的数据报被丢弃；只发送的对端重启后需本端也重建实例才能恢复。接收端以计数器的滑动位图拒绝会话内的重放，校验通过后才记录</para>
+		/// <para>派生的会话密钥缓存最近Key_Cache个，缓存未命中的派生按每秒Derive_Rate个限速，伪造会话标识的数据报无法消耗大量CPU</para>
+		/// <para>应叠加在最靠近P2P客户端的位置，使其上各协议层的数据头同样受到保护；非线程安全，应在同一线程中使用</para>
+		/// </summary>
+		class SecureTransport final : public Transport
+		{
+		public:
+
+			/// <summary>数据头长度</summary>
+			static constexpr std::size_t Header_Len         = 16;
+			/// <summary>每个数据报增加的长度</summary>
+			static constexpr std::size_t Overhead           = Header_Len + Aead::Tag_Len;
+			/// <summary>缓存的对端会话密钥个数</summary>
+			static constexpr std::size_t Key_Cache          = 8;
+			/// <summary>每秒允许派生的会话密钥个数</summary>
+			static constexpr int64_t     Derive_Rate        = 4;
+			/// <summary>允许连续派生的会话密钥个数</summary>
+			static constexpr int64_t     Derive_Burst       = 2;
+			/// <summary>以毫秒为单位的同一会话两次质询的最小间隔</summary>
+			static constexpr int64_t     Challenge_Interval = 100;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="lower">下层传输</param>
+			/// <param name="key">Aead::Key_Len字节的主密钥</param>
+			/// <param name="cipher">发送使用的算法，AUTO按CPU选择</param>
+			/// <param name="window">重放窗口的计数器个数，即容许的最大乱序距离</param>
+			/// <param name="mtu">下层单个数据报的最大长度</param>
+			SecureTransport(Transport& lower, const uint8_t* const key, const aead_cipher cipher = aead_cipher::AUTO,
+				const std::size_t window = 1024, const std::size_t mtu = 1504);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			SecureTransport(const SecureTransport&) = delete;
+
+			/// <summary>
+			/// 加密后发送数据，发送失败时计数器同样前移，以免重用随机数
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回数据长度，数据过长或发送失败返回-1</returns>
+			ssize_t            Send(const utils::Memory<char>& mem, const int64_t ts) override;
+
+			/// <summary>
+			/// 接收数据，校验失败、重放与格式错误的数据报被丢弃
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，失败返回-1，超时返回-2</returns>
+			ssize_t            Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override;
+
+			/// <summary>
+			/// 获取下层等待可读的套接字
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的最迟须再次调用Receive的时间</param>
+			/// <returns>套接字，不支持时返回-1</returns>
+			int                Handle(int64_t& next) noexcept override { return m_iLower.Handle(next); }
+
+			/// <summary>
+			/// 获取发送使用的实现名
+			/// </summary>
+			/// <returns>实现名</returns>
+			const char*        Name() const noexcept { return m_pSeal->Name(); }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			const SecureStats& GetStats() const noexcept { return m_iStats; }
+
+		private:
+
+			/// <summary>
+			/// 缓存的对端会话
+			/// </summary>
+			struct __peer_key
+			{
+				/// <summary>算法</summary>
+				aead_cipher           cipher = aead_cipher::AUTO;
+				/// <summary>会话标识</summary>
+				uint64_t              session = 0;
+				/// <summary>会话密钥的加密上下文</summary>
+				std::shared_ptr<Aead> key;
+				/// <summary>发给该会话的质询随机串</summary>
+				uint8_t               challenge[16] = { 0 };
+				/// <summary>以__steady()毫秒计的最近一次质询时间，小于0为尚未质询</summary>
+				int64_t               challengedAt = -1;
+				/// <summary>最近一次使用的序号，用于淘汰最久未用的缓存</summary>
+				uint64_t              used = 0;
+			};
+
+		private:
+
+			/// <summary>
+			/// 由主密钥派生会话密钥
+			/// </summary>
+			/// <param name="cipher">算法</param>
+			/// <param name="session">会话标识</param>
+			/// <returns>会话密钥的加密上下文</returns>
+			std::unique_ptr<Aead> _Derive(const aead_cipher cipher, const uint64_t session) const;
+
+			/// <summary>
+			/// 查找缓存的对端会话，未命中时在限速内派生并替换最久未用的缓存
+			/// </summary>
+			/// <param name="cipher">算法</param>
+			/// <param name="session">会话标识</param>
+			/// <returns>缓存的对端会话，超过限速返回nullptr</returns>
+			__peer_key*        _Lookup(const aead_cipher cipher, const uint64_t session);
+
+			/// <summary>
+			/// 以本端会话密钥发送质询或应答
+			/// </summary>
+			/// <param name="kind">种类</param>
+			/// <param name="nonce">16字节的随机串</param>
+			/// <param name="target">目标会话标识</param>
+			void               _Control(const uint8_t kind, const uint8_t* const nonce, const uint64_t target);
+
+			/// <summary>
+			/// 以缓存的对端会话作为当前会话，重置重放窗口
+			/// </summary>
+			/// <param name="peer">缓存的对端会话</param>
+			void               _Accept(__peer_key& peer);
+
+			/// <summary>
+			/// 校验并解密一个数据报
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="len">含数据头与标签的数据报长度</param>
+			/// <returns>成功返回明文长度，缓冲区过小返回-1，应丢弃返回-3</returns>
+			ssize_t            _Open(utils::Memory<char>& mem, const std::size_t len);
+
+		private:
+
+			/// <summary>下层传输</summary>
+			Transport&              m_iLower;
+			/// <summary>下层单个数据报的最大长度</summary>
+			const std::size_t       m_uMtu;
+			/// <summary>主密钥的ChaCha20-Poly1305上下文，只用于派生会话密钥</summary>
+			const Aead              m_iMaster;
+			/// <summary>本端的56位会话标识</summary>
+			const uint64_t          m_uSession;
+			/// <summary>本端会话密钥的加密上下文</summary>
+			std::unique_ptr<Aead>   m_pSeal;
+			/// <summary>下一个发送计数器</summary>
+			uint64_t                m_uCounter;
+			/// <summary>对端的会话标识</summary>
+			uint64_t                m_uPeerSession;
+			/// <summary>对端会话密钥的加密上下文，尚未确认对端会话时为空</summary>
+			std::shared_ptr<Aead>   m_pOpen;
+			/// <summary>已收到的对端最大计数器</summary>
+			uint64_t                m_uHighest;
+			/// <summary>以计数器低32位记录的重放窗口</summary>
+			SequenceWindow          m_iWindow;
+			/// <summary>缓存的对端会话</summary>
+			std::vector<__peer_key> m_iKeys;
+			/// <summary>缓存的使用序号</summary>
+			uint64_t                m_uTick;
+			/// <summary>派生会话密钥的令牌数</summary>
+			int64_t                 m_nTokens;
+			/// <summary>以__steady()毫秒计的上一次补充令牌的时间</summary>
+			int64_t                 m_nRefilled;
+			/// <summary>发送缓冲区</summary>
+			std::vector<char>       m_iSendBuf;
+			/// <summary>接收缓冲区</summary>
+			std::vector<char>       m_iRecvBuf;
+			/// <summary>统计信息</summary>
+			SecureStats             m_iStats;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_SECURE_H__
@@ -0,0 +1,142 @@
+﻿/************************************************************************
+ * @ObjectName: seq_window.cpp
+ * @Description: 以滑动位图记录最近收到的32位序号，用于去重及丢包、乱序统计
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "seq_window.h"
+
+
+#include <algorithm>
+
+
+namespace
+{
+	std::size_t wordsOf(const std::size_t size)
+	{
+		std::size_t n = 64;
+		while (n < size) {
+			n <<= 1;
+		}
+		return n / 64;
+	}
+}
+
+
+vsnc::forwarder::SequenceWindow::SequenceWindow(const std::size_t size) :
+	m_iBits(wordsOf(size), 0),
+	m_uHead(0),
+	m_nAdvance(0),
+	m_uRun(0),
+	m_bStarted(false)
+{
+	m_iStats.BurstHistogram.assign(Burst_Buckets, 0);
+}
+
+
+vsnc::forwarder::seq_state vsnc::forwarder::SequenceWindow::Insert(const uint32_t seq) noexcept
+{
+	if (!m_bStarted) {
+		m_bStarted = true;
+		m_uHead = seq;
+		m_nAdvance = 0;
+		_Mark(seq, true);
+		++m_iStats.Received;
+		return seq_state::FRESH;
+	}
+	auto delta = static_cast<int32_t>(seq - m_uHead);
+	auto size = static_cast<int64_t>(Size());
+	if (delta > 0) {
+		// 位置head+k的槽位原先记录序号head+k-Size，按序号顺序检查后清除；前移超过Size时所有槽位都被移出
+		auto n = (std::min)(static_cast<int64_t>(delta), size);
+		for (int64_t k = 1; k <= n; ++k) {
+			auto s = m_uHead + static_cast<uint32_t>(k);
+			if (m_nAdvance + k - size >= 0) {
+				_Evict(_Test(s));
+			}
+			_Mark(s, false);
+		}
+		if (delta > size) {
+			// 跳过的序号未进入窗口就已移出
+			m_iStats.Lost += static_cast<uint64_t>(delta - size);
+			m_uRun += static_cast<uint64_t>(delta - size);
+		}
+		m_uHead = seq;
+		m_nAdvance += delta;
+		_Mark(seq, true);
+		++m_iStats.Received;
+		return seq_state::FRESH;
+	}
+	auto behind = -static_cast<int64_t>(delta);
+	if (behind >= size) {
+		++m_iStats.Stale;
+		return seq_state::STALE;
+	}
+	if (_Test(seq)) {
+		++m_iStats.Duplicates;
+		return seq_state::DUPLICATE;
+	}
+	_Mark(seq, true);
+	++m_iStats.Received;
+	++m_iStats.Reordered;
+	m_iStats.MaxReorder = (std::max)(m_iStats.MaxReorder, static_cast<uint32_t>(behind));
+	return seq_state::FRESH;
+}
+
+
+void vsnc::forwarder::SequenceWindow::Reset() noexcept
+{
+	std::fill(m_iBits.begin(), m_iBits.end(), 0);
+	m_uHead = 0;
+	m_nAdvance = 0;
+	if (m_uRun) {
+		_Burst(m_uRun);
+		m_uRun = 0;
+	}
+	m_bStarted = false;
+}
+
+
+void vsnc::forwarder::SequenceWindow::_Mark(const uint32_t seq, const bool on) noexcept
+{
+	auto i = static_cast<std::size_t>(seq) & (Size() - 1);
+	auto bit = static_cast<uint64_t>(1) << (i % 64);
+	if (on) {
+		m_iBits[i / 64] |= bit;
+	}
+	else {
+		m_iBits[i / 64] &= ~bit;
+	}
+}
+
+
+bool vsnc::forwarder::SequenceWindow::_Test(const uint32_t seq) const noexcept
+{
+	auto i = static_cast<std::size_t>(seq) & (Size() - 1);
+	return 0 != (m_iBits[i / 64] & (static_cast<uint64_t>(1) << (i % 64)));
+}
+
+
+void vsnc::forwarder::SequenceWindow::_Evict(const bool seen) noexcept
+{
+	if (!seen) {
+		++m_iStats.Lost;
+		++m_uRun;
+	}
+	else if (m_uRun) {
+		_Burst(m_uRun);
+		m_uRun = 0;
+	}
+}
+
+
+void vsnc::forwarder::SequenceWindow::_Burst(const uint64_t len) noexcept
+{
+	++m_iStats.Bursts;
+	m_iStats.MaxBurst = (std::max)(m_iStats.MaxBurst, len);
+	std::size_t bucket = 0;
+	for (auto n = len; (n > 1) && (bucket + 1 < Burst_Buckets); n >>= 1) {
+		++bucket;
+	}
+	++m_iStats.BurstHistogram[bucket];
+}
@@ -0,0 +1,165 @@
+﻿/************************************************************************
+ * @ObjectName: seq_window.h
+ * @Description: 以滑动位图记录最近收到的32位序号，用于去重及丢包、乱序统计
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_SEQ_WINDOW_H__
+#define __VSNC_FORWARDER_SEQ_WINDOW_H__
+
+
+#include <vector>
+
+
+#include <stdint.h>
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 序号相对窗口的状态
+		/// </summary>
+		enum class seq_state : int8_t
+		{
+			/// <summary>首次收到</summary>
+			FRESH,
+			/// <summary>窗口内已收到过</summary>
+			DUPLICATE,
+			/// <summary>早于窗口，无法判断是否重复</summary>
+			STALE
+		};
+
+
+		/// <summary>
+		/// 序号统计信息
+		/// </summary>
+		struct SequenceStats
+		{
+			/// <summary>首次收到的序号个数</summary>
+			uint64_t              Received   = 0;
+			/// <summary>重复的序号个数</summary>
+			uint64_t              Duplicates = 0;
+			/// <summary>早于窗口的序号个数</summary>
+			uint64_t              Stale      = 0;
+			/// <summary>晚于更大序号到达的序号个数</summary>
+			uint64_t              Reordered  = 0;
+			/// <summary>乱序到达的序号落后于最大序号的最大距离</summary>
+			uint32_t              MaxReorder = 0;
+			/// <summary>移出窗口时仍未收到的序号个数，即确认的丢包</summary>
+			uint64_t              Lost       = 0;
+			/// <summary>连续丢包的次数</summary>
+			uint64_t              Bursts     = 0;
+			/// <summary>最长的连续丢包个数</summary>
+			uint64_t              MaxBurst   = 0;
+			/// <summary>连续丢包长度的直方图，第i个桶为长度在[2^i, 2^(i+1))之间的次数，最后一个桶含更长的丢包</summary>
+			std::vector<uint64_t> BurstHistogram;
+		};
+
+
+		/// <summary>
+		/// <para>32位序号的滑动位图窗口</para>
+		/// <para>以最大序号为窗口右端，记录其前Size个序号是否已收到；序号按串行数算术比较，可跨越回绕</para>
+		/// <para>每个序号的判断与记录为O(1)；窗口前移时检查并清除移出的位，均摊到每个序号仍为O(1)</para>
+		/// <para>序号移出窗口时仍未收到才计为丢包，因此窗口长度即容许的最大乱序距离，丢包统计相应滞后Size个序号</para>
+		/// </summary>
+		class SequenceWindow
+		{
+		public:
+
+			/// <summary>连续丢包长度直方图的桶个数</summary>
+			static constexpr std::size_t Burst_Buckets = 8;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="size">窗口长度，向上取整为2的幂且不小于64，使序号回绕时取模仍连续</param>
+			explicit SequenceWindow(const std::size_t size = 4096);
+
+			/// <summary>
+			/// 判断并记录序号
+			/// </summary>
+			/// <param name="seq">序号</param>
+			/// <returns>序号的状态，只有FRESH会被记录</returns>
+			seq_state   Insert(const uint32_t seq) noexcept;
+
+			/// <summary>
+			/// 清空窗口，在发送端重新开始编号时调用；窗口内尚未确认的丢包被放弃，统计信息保留
+			/// </summary>
+			void        Reset() noexcept;
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			const SequenceStats& GetStats() const noexcept { return m_iStats; }
+
+			/// <summary>
+			/// 获取窗口长度
+			/// </summary>
+			/// <returns>窗口长度</returns>
+			std::size_t Size() const noexcept { return m_iBits.size() * 64; }
+
+			/// <summary>
+			/// 获取已收到的最大序号
+			/// </summary>
+			/// <returns>最大序号，尚未收到任何序号时为0</returns>
+			uint32_t    Head() const noexcept { return m_uHead; }
+
+		private:
+
+			/// <summary>
+			/// 设置或清除序号对应的位
+			/// </summary>
+			/// <param name="seq">序号</param>
+			/// <param name="on">设置为true，清除为false</param>
+			void        _Mark(const uint32_t seq, const bool on) noexcept;
+
+			/// <summary>
+			/// 测试序号对应的位
+			/// </summary>
+			/// <param name="seq">序号</param>
+			/// <returns>已设置返回true</returns>
+			bool        _Test(const uint32_t seq) const noexcept;
+
+			/// <summary>
+			/// 处理移出窗口的序号
+			/// </summary>
+			/// <param name="seen">是否已收到</param>
+			void        _Evict(const bool seen) noexcept;
+
+			/// <summary>
+			/// 记录一次连续丢包
+			/// </summary>
+			/// <param name="len">丢包个数</param>
+			void        _Burst(const uint64_t len) noexcept;
+
+		private:
+
+			/// <summary>以序号对窗口长度取模索引的位图</summary>
+			std::vector<uint64_t> m_iBits;
+			/// <summary>已收到的最大序号</summary>
+			uint32_t              m_uHead;
+			/// <summary>最大序号自首个序号起前移的个数，用于判断移出的位置是否早于首个序号</summary>
+			int64_t               m_nAdvance;
+			/// <summary>当前连续丢包的个数</summary>
+			uint64_t              m_uRun;
+			/// <summary>是否已收到过序号</summary>
+			bool                  m_bStarted;
+			/// <summary>统计信息</summary>
+			SequenceStats         m_iStats;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_SEQ_WINDOW_H__
@@ -0,0 +1,81 @@
+﻿/************************************************************************
+ * @ObjectName: sequence.cpp
+ * @Description: 为数据报附加序号，接收端统计丢包、重复与乱序
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "sequence.h"
+
+
+#include <algorithm>
+#include <cstring>
+
+
+#include <vsnc_utils/utils.h>
+
+
+#include "wire.h"
+
+
+vsnc::forwarder::SequenceTransport::SequenceTransport(Transport& lower, const std::size_t window, const std::size_t mtu) :
+	m_iLower(lower),
+	m_uMtu(mtu),
+	m_uSeq(0),
+	m_iWindow(window),
+	m_iRecvBuf(mtu),
+	m_uMalformed(0),
+	m_uOversize(0)
+{
+	m_iSendBuf.reserve(mtu);
+}
+
+
+ssize_t vsnc::forwarder::SequenceTransport::Send(const utils::Memory<char>& mem, const int64_t ts)
+{
+	if (Header_Len + mem.Length() > m_uMtu) {
+		return -1;
+	}
+	m_iSendBuf.resize(Header_Len + mem.Length());
+	__put_u32(m_iSendBuf.data(), m_uSeq);
+	memcpy(m_iSendBuf.data() + Header_Len, mem.Data(), mem.Length());
+	utils::BasicMemory<char> pkt(m_iSendBuf.data(), m_iSendBuf.size());
+	if (m_iLower.Send(pkt, ts) < 0) {
+		return -1;
+	}
+	// 发送失败的数据报不占用序号，以免被接收端计为丢包
+	++m_uSeq;
+	return static_cast<ssize_t>(mem.Length());
+}
+
+
+ssize_t vsnc::forwarder::SequenceTransport::Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout)
+{
+	auto deadline = (timeout < 0) ? -1 : (utils::__steady() + timeout);
+	while (true) {
+		auto wait = (deadline < 0) ? timeout : (std::max)(deadline - utils::__steady(), static_cast<int64_t>(0));
+		utils::BasicMemory<char> buf(m_iRecvBuf.data(), m_iRecvBuf.size());
+		auto ret = m_iLower.Receive(buf, ts, wait);
+		if (ret <= 0) {
+			return ret;
+		}
+		auto len = static_cast<std::size_t>(ret);
+		if (len < Header_Len) {
+			++m_uMalformed;
+			if ((deadline >= 0) && (utils::__steady() >= deadline)) {
+				return -2;
+			}
+			continue;
+		}
+		m_iWindow.Insert(__get_u32(m_iRecvBuf.data()));
+		if (len - Header_Len > mem.Length()) {
+			// 丢弃而不返回-1，调用者会把-1当作连接关闭
+			++m_uOversize;
+			if ((deadline >= 0) && (utils::__steady() >= deadline)) {
+				return -2;
+			}
+			continue;
+		}
+		memcpy(mem.Data(), m_iRecvBuf.data() + Header_Len, len - Header_Len);
+		return static_cast<ssize_t>(len - Header_Len);
+	}
+}
@@ -0,0 +1,124 @@
+﻿/************************************************************************
+ * @ObjectName: sequence.h
+ * @Description: 为数据报附加序号，接收端统计丢包、重复与乱序
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_SEQUENCE_H__
+#define __VSNC_FORWARDER_SEQUENCE_H__
+
+
+#include <vector>
+
+
+#include <stdint.h>
+
+
+#include "transport.h"
+#include "seq_window.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// <para>序号传输层</para>
+		/// <para>发送端为每个数据报附加4字节的序号，接收端剥去序号并以滑动位图统计丢包、重复与乱序，连续丢包的长度计入直方图</para>
+		/// <para>本层只统计不纠正：重复与乱序的数据报照常交给上层；叠加在最靠近P2P客户端的位置时统计的即是两端之间的网络丢包</para>
+		/// <para>非线程安全，应在同一线程中使用</para>
+		/// </summary>
+		class SequenceTransport final : public Transport
+		{
+		public:
+
+			/// <summary>数据头长度</summary>
+			static constexpr std::size_t Header_Len = 4;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="lower">下层传输</param>
+			/// <param name="window">统计窗口的序号个数，即确认丢包前容许的最大乱序距离</param>
+			/// <param name="mtu">下层单个数据报的最大长度</param>
+			SequenceTransport(Transport& lower, const std::size_t window = 1024, const std::size_t mtu = 1504);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			SequenceTransport(const SequenceTransport&) = delete;
+
+			/// <summary>
+			/// 附加序号后发送数据
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回数据长度，数据过长或发送失败返回-1</returns>
+			ssize_t              Send(const utils::Memory<char>& mem, const int64_t ts) override;
+
+			/// <summary>
+			/// 接收数据并记录其序号，短于数据头与超出接收缓冲区的数据报被丢弃并计数，接收继续到超时为止
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，下层失败返回-1，超时返回-2</returns>
+			ssize_t              Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override;
+
+			/// <summary>
+			/// 获取下层等待可读的套接字
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的最迟须再次调用Receive的时间</param>
+			/// <returns>套接字，不支持时返回-1</returns>
+			int                  Handle(int64_t& next) noexcept override { return m_iLower.Handle(next); }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			const SequenceStats& GetStats() const noexcept { return m_iWindow.GetStats(); }
+
+			/// <summary>
+			/// 获取被丢弃的过短数据报个数
+			/// </summary>
+			/// <returns>数据报个数</returns>
+			uint64_t             Malformed() const noexcept { return m_uMalformed; }
+
+			/// <summary>
+			/// 获取因超出接收缓冲区而丢弃的数据报个数，其序号照常计入统计，不算作丢包
+			/// </summary>
+			/// <returns>数据报个数</returns>
+			uint64_t             Oversize() const noexcept { return m_uOversize; }
+
+		private:
+
+			/// <summary>下层传输</summary>
+			Transport&        m_iLower;
+			/// <summary>下层单个数据报的最大长度</summary>
+			const std::size_t m_uMtu;
+			/// <summary>下一个发送序号</summary>
+			uint32_t          m_uSeq;
+			/// <summary>序号窗口</summary>
+			SequenceWindow    m_iWindow;
+			/// <summary>发送缓冲区</summary>
+			std::vector<char> m_iSendBuf;
+			/// <summary>接收缓冲区</summary>
+			std::vector<char> m_iRecvBuf;
+			/// <summary>被丢弃的过短数据报个数</summary>
+			uint64_t          m_uMalformed;
+			/// <summary>因超出接收缓冲区而丢弃的数据报个数</summary>
+			uint64_t          m_uOversize;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_SEQUENCE_H__
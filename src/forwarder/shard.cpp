@@ -0,0 +1,366 @@
+﻿/************************************************************************
+ * @ObjectName: shard.cpp
+ * @Description: 多核分片转发，每个工作线程独占一部分会话与自己的下游套接字
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "shard.h"
+
+
+#include <algorithm>
+#include <exception>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+
+
+#include <vsnc_utils/executor.h>
+#include <vsnc_utils/logger.h>
+
+
+vsnc::forwarder::HashRing::HashRing(const std::size_t vnodes) :
+	m_uVnodes(vnodes ? vnodes : 1)
+{
+}
+
+
+void vsnc::forwarder::HashRing::Add(const node_type node)
+{
+	Remove(node);
+	for (std::size_t i = 0; i < m_uVnodes; ++i) {
+		// 再哈希一次，否则小于2^32的键与0号节点的虚拟节点哈希相同，全部落到0号节点
+		m_iRing.emplace_back(_Hash(_Hash((static_cast<uint64_t>(node) << 32) | i)), node);
+	}
+	std::sort(m_iRing.begin(), m_iRing.end());
+}
+
+
+void vsnc::forwarder::HashRing::Remove(const node_type node)
+{
+	m_iRing.erase(std::remove_if(m_iRing.begin(), m_iRing.end(), [node](const std::pair<uint64_t, node_type>& v) {
+		return v.second == node;
+	}), m_iRing.end());
+}
+
+
+vsnc::forwarder::HashRing::node_type vsnc::forwarder::HashRing::Lookup(const uint64_t key) const noexcept
+{
+	auto h = _Hash(key);
+	auto it = std::lower_bound(m_iRing.begin(), m_iRing.end(), std::make_pair(h, static_cast<node_type>(0)));
+	return (m_iRing.end() == it) ? m_iRing.front().second : it->second;
+}
+
+
+uint64_t vsnc::forwarder::HashRing::_Hash(uint64_t x) noexcept
+{
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+
+vsnc::forwarder::ShardedForwarder::ShardedForwarder(session_factory factory, const ShardOptions& opts) :
+	m_pfnFactory(std::move(factory)),
+	m_iOpts(opts),
+	m_iRing(opts.VirtualNodes),
+	m_bRun(false)
+{
+	auto n = opts.Workers ? opts.Workers : (std::max)(1u, std::thread::hardware_concurrency());
+	for (std::size_t i = 0; i < n; ++i) {
+		m_iWorkers.emplace_back(new __worker);
+		m_iWorkers.back()->index = i;
+		m_iRing.Add(static_cast<HashRing::node_type>(i));
+	}
+}
+
+
+vsnc::forwarder::ShardedForwarder::~ShardedForwarder()
+{
+	Stop();
+}
+
+
+bool vsnc::forwarder::ShardedForwarder::Start()
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	if (m_bRun) {
+		return true;
+	}
+	for (auto& w : m_iWorkers) {
+		if (!_Open(*w)) {
+			for (auto& o : m_iWorkers) {
+				if (-1 != o->sock) {
+					closesocket(o->sock);
+					o->sock = -1;
+				}
+			}
+			return false;
+		}
+	}
+	m_bRun = true;
+	for (auto peer : m_iSessions) {
+		_Post(m_iRing.Lookup(peer), true, peer);
+	}
+	for (auto& w : m_iWorkers) {
+		_Launch(*w);
+	}
+	return true;
+}
+
+
+void vsnc::forwarder::ShardedForwarder::Stop()
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	if (!m_bRun) {
+		return;
+	}
+	m_bRun = false;
+	for (auto& w : m_iWorkers) {
+		w->run.store(false);
+	}
+	for (auto& w : m_iWorkers) {
+		if (w->thread.joinable()) {
+			w->thread.join();
+		}
+		closesocket(w->sock);
+		w->sock = -1;
+		w->handoff.clear();
+	}
+	// 所有会话协程均已返回，Start时按当前归属重新启动
+	m_iMoving.clear();
+}
+
+
+void vsnc::forwarder::ShardedForwarder::AddSession(const uint64_t peer)
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	if (!m_iSessions.insert(peer).second || m_iMoving.count(peer)) {
+		// 迁移中的会话在原线程上停止后按当前归属启动
+		return;
+	}
+	_Post(m_iRing.Lookup(peer), true, peer);
+}
+
+
+void vsnc::forwarder::ShardedForwarder::RemoveSession(const uint64_t peer)
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	if (!m_iSessions.erase(peer)) {
+		return;
+	}
+	_Post(m_iRing.Lookup(peer), false, peer);
+}
+
+
+ssize_t vsnc::forwarder::ShardedForwarder::AddWorker()
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	std::unique_ptr<__worker> w(new __worker);
+	w->index = m_iWorkers.size();
+	if (m_bRun && !_Open(*w)) {
+		return -1;
+	}
+	std::vector<std::pair<uint64_t, HashRing::node_type>> owners;
+	for (auto peer : m_iSessions) {
+		if (!m_iMoving.count(peer)) {
+			owners.emplace_back(peer, m_iRing.Lookup(peer));
+		}
+	}
+	m_iRing.Add(static_cast<HashRing::node_type>(w->index));
+	m_iWorkers.push_back(std::move(w));
+	ssize_t moved = 0;
+	for (auto& o : owners) {
+		auto owner = m_iRing.Lookup(o.first);
+		if (owner == o.second) {
+			continue;
+		}
+		if (m_bRun) {
+			// 原线程确认会话协程返回后经_Handoff在新的所属线程上启动
+			m_iMoving.insert(o.first);
+			_Post(o.second, false, o.first, true);
+		}
+		else {
+			_Post(o.second, false, o.first);
+			_Post(owner, true, o.first);
+		}
+		++moved;
+	}
+	if (m_bRun) {
+		_Launch(*m_iWorkers.back());
+	}
+	return moved;
+}
+
+
+std::size_t vsnc::forwarder::ShardedForwarder::Owner(const uint64_t peer)
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	return m_iRing.Lookup(peer);
+}
+
+
+std::vector<vsnc::forwarder::ShardStats> vsnc::forwarder::ShardedForwarder::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	std::vector<ShardStats> stats(m_iWorkers.size());
+	for (std::size_t i = 0; i < m_iWorkers.size(); ++i) {
+		stats[i].Sessions = m_iWorkers[i]->active.load(std::memory_order_relaxed);
+		stats[i].Started = m_iWorkers[i]->started.load(std::memory_order_relaxed);
+		stats[i].Stopped = m_iWorkers[i]->stopped.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+
+bool vsnc::forwarder::ShardedForwarder::_Open(__worker& w)
+{
+	w.sock = static_cast<int>(socket(AF_INET, SOCK_DGRAM, 0));
+	if (-1 == w.sock) {
+		return false;
+	}
+	// 各工作线程的套接字绑定同一端口，发送时互不争用同一个套接字
+	int on = 1;
+#ifdef SO_REUSEPORT
+	setsockopt(w.sock, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char*>(&on), sizeof(on));
+#else
+	setsockopt(w.sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+#endif // SO_REUSEPORT
+	sockaddr_in addr;
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(m_iOpts.Port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(w.sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+		closesocket(w.sock);
+		w.sock = -1;
+		return false;
+	}
+	return true;
+}
+
+
+void vsnc::forwarder::ShardedForwarder::_Launch(__worker& w)
+{
+	// 单个工作线程绑定到0号核只会与该核上的中断处理及其他线程争用，交给系统调度
+	w.pin = m_iOpts.Pin && (m_iWorkers.size() > 1);
+	w.run.store(true);
+	w.thread = std::thread(&ShardedForwarder::_Run, this, std::ref(w));
+}
+
+
+void vsnc::forwarder::ShardedForwarder::_Run(__worker& w)
+{
+	if (w.pin) {
+		utils::__pin_thread(w.index);
+	}
+	// 在转发开始前创建本线程的日志缓冲区，首条日志不再分配与加锁
+	utils::Logger::Instance().Attach();
+	w.loop.Spawn(_Control(w));
+	while (true) {
+		try {
+			w.loop.Run();
+			break;
+		}
+		catch (const std::exception& e) {
+			log_error("shard {} session failed: {}", w.index, e.what());
+		}
+	}
+}
+
+
+vsnc::forwarder::Task vsnc::forwarder::ShardedForwarder::_Control(__worker& w)
+{
+	std::vector<__command> cmds;
+	while (w.run.load()) {
+		{
+			std::lock_guard<std::mutex> lock(w.mutex);
+			cmds.swap(w.inbox);
+		}
+		for (auto& cmd : cmds) {
+			auto it = w.sessions.find(cmd.peer);
+			if (cmd.start && (w.sessions.end() == it)) {
+				auto active = std::make_shared<bool>(true);
+				w.sessions.emplace(cmd.peer, __session{ active });
+				w.loop.Spawn(_Session(w, cmd.peer, std::move(active)));
+				w.started.fetch_add(1, std::memory_order_relaxed);
+			}
+			else if (cmd.start) {
+				// 仍在停止中的会话返回后再启动
+				it->second.restart = !*it->second.active;
+			}
+			else if (w.sessions.end() != it) {
+				*it->second.active = false;
+				it->second.migrate = it->second.migrate || cmd.migrate;
+				it->second.restart = false;
+			}
+			else if (cmd.migrate) {
+				// 会话未在本线程上运行，直接交还控制通道
+				w.handoff.push_back(cmd.peer);
+			}
+		}
+		cmds.clear();
+		_Handoff(w);
+		w.active.store(w.sessions.size(), std::memory_order_relaxed);
+		co_await w.loop.Sleep(m_iOpts.ControlInterval);
+	}
+	// 会话协程返回时各自移除，事件循环在全部返回后结束
+	for (auto& s : w.sessions) {
+		*s.second.active = false;
+		s.second.migrate = false;
+		s.second.restart = false;
+	}
+}
+
+
+vsnc::forwarder::Task vsnc::forwarder::ShardedForwarder::_Session(__worker& w, const uint64_t peer, std::shared_ptr<bool> active)
+{
+	try {
+		co_await m_pfnFactory(w.loop, w.sock, peer, active);
+	}
+	catch (const std::exception& e) {
+		log_error("shard {} session {} failed: {}", w.index, peer, e.what());
+	}
+	w.stopped.fetch_add(1, std::memory_order_relaxed);
+	auto it = w.sessions.find(peer);
+	if ((w.sessions.end() == it) || (it->second.active != active)) {
+		co_return;
+	}
+	auto migrate = it->second.migrate;
+	auto restart = it->second.restart;
+	w.sessions.erase(it);
+	w.active.store(w.sessions.size(), std::memory_order_relaxed);
+	if (migrate) {
+		w.handoff.push_back(peer);
+	}
+	else if (restart && w.run.load()) {
+		// 停止中被重新添加的会话在本线程上重新启动
+		std::lock_guard<std::mutex> lock(w.mutex);
+		w.inbox.push_back(__command{ true, peer });
+	}
+}
+
+
+void vsnc::forwarder::ShardedForwarder::_Handoff(__worker& w)
+{
+	if (w.handoff.empty()) {
+		return;
+	}
+	// Stop持有m_iMutex等待工作线程退出，这里只尝试加锁，失败时下一次控制周期重试
+	std::unique_lock<std::mutex> lock(m_iMutex, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		return;
+	}
+	for (auto peer : w.handoff) {
+		if (m_iMoving.erase(peer) && m_bRun && m_iSessions.count(peer)) {
+			_Post(m_iRing.Lookup(peer), true, peer);
+		}
+	}
+	w.handoff.clear();
+}
+
+
+void vsnc::forwarder::ShardedForwarder::_Post(const std::size_t index, const bool start, const uint64_t peer, const bool migrate)
+{
+	auto& w = *m_iWorkers[index];
+	std::lock_guard<std::mutex> lock(w.mutex);
+	w.inbox.push_back(__command{ start, peer, migrate });
+}
@@ -0,0 +1,349 @@
+﻿/************************************************************************
+ * @ObjectName: shard.h
+ * @Description: 多核分片转发，每个工作线程独占一部分会话与自己的下游套接字
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_SHARD_H__
+#define __VSNC_FORWARDER_SHARD_H__
+
+
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+
+#include <stdint.h>
+
+
+#include <p2p/client.h>
+
+
+#include "event_loop.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// <para>一致性哈希环</para>
+		/// <para>每个节点在环上放置若干虚拟节点，键归属于顺时针方向的第一个虚拟节点；增加一个节点时只有约1/(n+1)的键改变归属</para>
+		/// </summary>
+		class HashRing
+		{
+		public:
+
+			/// <summary>节点类型</summary>
+			using node_type = uint32_t;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="vnodes">每个节点的虚拟节点个数</param>
+			explicit HashRing(const std::size_t vnodes = 64);
+
+			/// <summary>
+			/// 添加节点
+			/// </summary>
+			/// <param name="node">节点</param>
+			void        Add(const node_type node);
+
+			/// <summary>
+			/// 移除节点
+			/// </summary>
+			/// <param name="node">节点</param>
+			void        Remove(const node_type node);
+
+			/// <summary>
+			/// 查找键所属的节点，环为空时行为未定义
+			/// </summary>
+			/// <param name="key">键</param>
+			/// <returns>节点</returns>
+			node_type   Lookup(const uint64_t key) const noexcept;
+
+			/// <summary>
+			/// 获取节点个数
+			/// </summary>
+			/// <returns>节点个数</returns>
+			std::size_t Size() const noexcept { return m_iRing.size() / m_uVnodes; }
+
+		private:
+
+			/// <summary>
+			/// splitmix64哈希
+			/// </summary>
+			/// <param name="x">输入</param>
+			/// <returns>哈希值</returns>
+			static uint64_t _Hash(uint64_t x) noexcept;
+
+		private:
+
+			/// <summary>每个节点的虚拟节点个数</summary>
+			const std::size_t                           m_uVnodes;
+			/// <summary>按哈希值排序的虚拟节点</summary>
+			std::vector<std::pair<uint64_t, node_type>> m_iRing;
+		};
+
+
+		/// <summary>
+		/// 分片参数
+		/// </summary>
+		struct ShardOptions
+		{
+			/// <summary>工作线程个数，为0时取硬件并发数</summary>
+			std::size_t Workers         = 0;
+			/// <summary>是否将第i个工作线程绑定到第i个逻辑核，启动时只有一个工作线程则不绑定，使其仍由系统调度而不与0号核上的中断处理争用</summary>
+			bool        Pin             = true;
+			/// <summary>各工作线程下游套接字共同绑定的本地端口</summary>
+			uint16_t    Port            = 4004;
+			/// <summary>一致性哈希环上每个工作线程的虚拟节点个数</summary>
+			std::size_t VirtualNodes    = 64;
+			/// <summary>以毫秒为单位的工作线程处理会话增减的间隔</summary>
+			int64_t     ControlInterval = 10;
+		};
+
+
+		/// <summary>
+		/// 工作线程统计信息
+		/// </summary>
+		struct ShardStats
+		{
+			/// <summary>当前运行的会话个数</summary>
+			std::size_t Sessions = 0;
+			/// <summary>启动的会话个数</summary>
+			uint64_t    Started  = 0;
+			/// <summary>已结束的会话个数，含迁移到其他工作线程的会话，在会话协程返回时计数</summary>
+			uint64_t    Stopped  = 0;
+		};
+
+
+		/// <summary>
+		/// <para>多核分片转发器</para>
+		/// <para>每个工作线程运行一个EventLoop并拥有自己的下游UDP套接字，这些套接字以SO_REUSEPORT（Windows上为SO_REUSEADDR）绑定同一端口；会话按对端序列号经一致性哈希分配给工作线程，热路径上工作线程之间不共享任何状态</para>
+		/// <para>会话应以ClientOptions::Thread为false创建P2P客户端，由所属工作线程的事件循环在套接字可读时驱动，上游收包与客户端的定时任务都在所属线程上完成，不经过其他线程与跨线程的锁</para>
+		/// <para>增减会话与工作线程只经过加锁的控制通道，工作线程每ControlInterval毫秒处理一次；增加工作线程时归属改变的会话先在原线程上停止，原线程确认其协程已返回后才在新的所属线程上重新建立连接，同一会话不会同时运行在两个线程上</para>
+		/// </summary>
+		class ShardedForwarder
+		{
+		public:
+
+			/// <summary>会话是否应继续运行的标志，由所属的工作线程修改</summary>
+			using active_type     = std::shared_ptr<const bool>;
+			/// <summary>
+			/// <para>会话协程的构造函数，参数为事件循环、工作线程的下游套接字、对端序列号与运行标志</para>
+			/// <para>在工作线程中调用，因此须是线程安全的；会话应在运行标志变为false后尽快结束</para>
+			/// </summary>
+			using session_factory = std::function<Task(EventLoop&, const int, const uint64_t, active_type)>;
+
+		private:
+
+			/// <summary>
+			/// 控制命令
+			/// </summary>
+			struct __command
+			{
+				/// <summary>启动为true，停止为false</summary>
+				bool     start;
+				/// <summary>对端序列号</summary>
+				uint64_t peer;
+				/// <summary>停止是否因迁移引起，为true时会话协程返回后交还控制通道在新的所属线程上启动</summary>
+				bool     migrate = false;
+			};
+
+			/// <summary>
+			/// 工作线程上的会话
+			/// </summary>
+			struct __session
+			{
+				/// <summary>运行标志</summary>
+				std::shared_ptr<bool> active;
+				/// <summary>停止中的会话返回后是否迁移</summary>
+				bool                  migrate = false;
+				/// <summary>停止中的会话返回后是否在本线程上重新启动</summary>
+				bool                  restart = false;
+			};
+
+			/// <summary>
+			/// 工作线程
+			/// </summary>
+			struct __worker
+			{
+				/// <summary>序号，同时是哈希环上的节点</summary>
+				std::size_t                                         index;
+				/// <summary>下游套接字</summary>
+				int                                                 sock = -1;
+				/// <summary>是否绑定到第index个逻辑核</summary>
+				bool                                                pin = false;
+				/// <summary>事件循环</summary>
+				EventLoop                                           loop;
+				/// <summary>保护命令队列</summary>
+				std::mutex                                          mutex;
+				/// <summary>待处理的命令</summary>
+				std::vector<__command>                              inbox;
+				/// <summary>运行中与停止中的会话，协程返回后移除，仅工作线程访问</summary>
+				std::unordered_map<uint64_t, __session>             sessions;
+				/// <summary>已停止且待在新的所属线程上启动的会话，仅工作线程访问</summary>
+				std::vector<uint64_t>                               handoff;
+				/// <summary>运行状态</summary>
+				std::atomic<bool>                                   run{ false };
+				/// <summary>当前运行的会话个数</summary>
+				std::atomic<std::size_t>                            active{ 0 };
+				/// <summary>启动的会话个数</summary>
+				std::atomic<uint64_t>                               started{ 0 };
+				/// <summary>停止的会话个数</summary>
+				std::atomic<uint64_t>                               stopped{ 0 };
+				/// <summary>线程</summary>
+				std::thread                                         thread;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="factory">会话协程的构造函数</param>
+			/// <param name="opts">分片参数</param>
+			explicit ShardedForwarder(session_factory factory, const ShardOptions& opts = ShardOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			ShardedForwarder(const ShardedForwarder&) = delete;
+
+			/// <summary>
+			/// 析构函数，停止所有工作线程
+			/// </summary>
+			~ShardedForwarder();
+
+			/// <summary>
+			/// 创建套接字并启动工作线程
+			/// </summary>
+			/// <returns>成功返回true，创建或绑定套接字失败返回false</returns>
+			bool                    Start();
+
+			/// <summary>
+			/// 停止所有会话与工作线程，等待会话协程结束
+			/// </summary>
+			void                    Stop();
+
+			/// <summary>
+			/// 添加会话，由对端序列号所属的工作线程启动
+			/// </summary>
+			/// <param name="peer">对端序列号</param>
+			void                    AddSession(const uint64_t peer);
+
+			/// <summary>
+			/// 移除会话
+			/// </summary>
+			/// <param name="peer">对端序列号</param>
+			void                    RemoveSession(const uint64_t peer);
+
+			/// <summary>
+			/// 增加一个工作线程并重新平衡会话，运行中调用时新线程立即启动
+			/// </summary>
+			/// <returns>迁移的会话个数，创建套接字失败返回-1</returns>
+			ssize_t                 AddWorker();
+
+			/// <summary>
+			/// 获取会话所属的工作线程
+			/// </summary>
+			/// <param name="peer">对端序列号</param>
+			/// <returns>工作线程序号</returns>
+			std::size_t             Owner(const uint64_t peer);
+
+			/// <summary>
+			/// 获取各工作线程的统计信息
+			/// </summary>
+			/// <returns>按工作线程序号排列的统计信息</returns>
+			std::vector<ShardStats> GetStats();
+
+		private:
+
+			/// <summary>
+			/// 创建并绑定工作线程的下游套接字
+			/// </summary>
+			/// <param name="w">工作线程</param>
+			/// <returns>成功返回true</returns>
+			bool                    _Open(__worker& w);
+
+			/// <summary>
+			/// 启动工作线程
+			/// </summary>
+			/// <param name="w">工作线程</param>
+			void                    _Launch(__worker& w);
+
+			/// <summary>
+			/// 工作线程主函数
+			/// </summary>
+			/// <param name="w">工作线程</param>
+			void                    _Run(__worker& w);
+
+			/// <summary>
+			/// 工作线程上处理控制命令的协程
+			/// </summary>
+			/// <param name="w">工作线程</param>
+			/// <returns>协程任务</returns>
+			Task                    _Control(__worker& w);
+
+			/// <summary>
+			/// 工作线程上运行一个会话的协程，会话协程返回后移除会话并处理迁移
+			/// </summary>
+			/// <param name="w">工作线程</param>
+			/// <param name="peer">对端序列号</param>
+			/// <param name="active">运行标志</param>
+			/// <returns>协程任务</returns>
+			Task                    _Session(__worker& w, const uint64_t peer, std::shared_ptr<bool> active);
+
+			/// <summary>
+			/// 在控制通道上启动已在原线程上停止的迁移会话，在工作线程中调用
+			/// </summary>
+			/// <param name="w">工作线程</param>
+			void                    _Handoff(__worker& w);
+
+			/// <summary>
+			/// 向工作线程发送控制命令
+			/// </summary>
+			/// <param name="index">工作线程序号</param>
+			/// <param name="start">启动为true，停止为false</param>
+			/// <param name="peer">对端序列号</param>
+			/// <param name="migrate">停止是否因迁移引起</param>
+			void                    _Post(const std::size_t index, const bool start, const uint64_t peer, const bool migrate = false);
+
+		private:
+
+			/// <summary>会话协程的构造函数</summary>
+			session_factory                        m_pfnFactory;
+			/// <summary>分片参数</summary>
+			const ShardOptions                     m_iOpts;
+			/// <summary>保护以下控制状态</summary>
+			std::mutex                             m_iMutex;
+			/// <summary>一致性哈希环</summary>
+			HashRing                               m_iRing;
+			/// <summary>所有会话的对端序列号</summary>
+			std::set<uint64_t>                     m_iSessions;
+			/// <summary>正在原线程上停止、尚未在新的所属线程上启动的会话</summary>
+			std::set<uint64_t>                     m_iMoving;
+			/// <summary>工作线程</summary>
+			std::vector<std::unique_ptr<__worker>> m_iWorkers;
+			/// <summary>运行状态</summary>
+			bool                                   m_bRun;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_SHARD_H__
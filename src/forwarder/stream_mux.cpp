@@ -0,0 +1,191 @@
+﻿/************************************************************************
+ * @ObjectName: stream_mux.cpp
+ * @Description: 在同一条P2P连接上复用多条带优先级的逻辑流
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "stream_mux.h"
+
+
+#include <algorithm>
+#include <cstring>
+
+
+constexpr std::size_t vsnc::forwarder::StreamMux::Header_Len;
+
+
+vsnc::forwarder::StreamMux::StreamMux(Transport& lower, const std::size_t mtu) :
+	m_iLower(lower),
+	m_uMtu(mtu),
+	m_iStreams(256),
+	m_iRecvBuf(mtu),
+	m_uMalformed(0)
+{
+}
+
+
+void vsnc::forwarder::StreamMux::Open(const stream_type id, const StreamOptions& opts)
+{
+	auto& s = m_iStreams[id];
+	if (!s) {
+		s.reset(new __stream);
+		m_iOrder.push_back(id);
+	}
+	s->opts = opts;
+	std::stable_sort(m_iOrder.begin(), m_iOrder.end(), [this](const stream_type lhs, const stream_type rhs) {
+		return m_iStreams[lhs]->opts.Priority < m_iStreams[rhs]->opts.Priority;
+	});
+}
+
+
+ssize_t vsnc::forwarder::StreamMux::Send(const stream_type id, const utils::Memory<char>& mem, const int64_t ts)
+{
+	auto& s = _Stream(id);
+	if ((mem.Length() + Header_Len > m_uMtu) || (s.tx.size() >= s.opts.QueueLimit)) {
+		++s.stats.SendDropped;
+		return -1;
+	}
+	__packet pkt;
+	pkt.ts = ts;
+	pkt.data = _Alloc();
+	pkt.data.resize(Header_Len + mem.Length());
+	pkt.data[0] = static_cast<char>(id);
+	pkt.data[1] = 0;
+	memcpy(pkt.data.data() + Header_Len, mem.Data(), mem.Length());
+	s.tx.push_back(std::move(pkt));
+	return static_cast<ssize_t>(mem.Length());
+}
+
+
+std::size_t vsnc::forwarder::StreamMux::Flush(const std::size_t budget)
+{
+	std::size_t sent = 0;
+	for (auto id : m_iOrder) {
+		auto& s = *m_iStreams[id];
+		while (!s.tx.empty()) {
+			auto& pkt = s.tx.front();
+			if (sent + pkt.data.size() > budget) {
+				return sent;
+			}
+			utils::BasicMemory<char> mem(pkt.data.data(), pkt.data.size());
+			if (m_iLower.Send(mem, pkt.ts) < 0) {
+				return sent;
+			}
+			sent += pkt.data.size();
+			++s.stats.Sent;
+			m_iFree.push_back(std::move(pkt.data));
+			s.tx.pop_front();
+		}
+	}
+	return sent;
+}
+
+
+ssize_t vsnc::forwarder::StreamMux::Pump(const int64_t timeout, const std::size_t batch)
+{
+	ssize_t cnt = 0;
+	auto wait = timeout;
+	while (static_cast<std::size_t>(cnt) < batch) {
+		utils::BasicMemory<char> mem(m_iRecvBuf.data(), m_iRecvBuf.size());
+		int64_t ts = 0;
+		auto ret = m_iLower.Receive(mem, ts, wait);
+		if (ret <= 0) {
+			return cnt ? cnt : ((0 == ret) ? -1 : ret);
+		}
+		wait = 0;
+		if ((static_cast<std::size_t>(ret) < Header_Len) || (0 != m_iRecvBuf[1])) {
+			++m_uMalformed;
+			continue;
+		}
+		auto& s = _Stream(static_cast<stream_type>(m_iRecvBuf[0]));
+		if (s.rx.size() >= s.opts.QueueLimit) {
+			++s.stats.RecvDropped;
+			continue;
+		}
+		__packet pkt;
+		pkt.ts = ts;
+		pkt.data = _Alloc();
+		pkt.data.assign(m_iRecvBuf.data() + Header_Len, m_iRecvBuf.data() + ret);
+		s.rx.push_back(std::move(pkt));
+		++s.stats.Received;
+		++cnt;
+	}
+	return cnt;
+}
+
+
+ssize_t vsnc::forwarder::StreamMux::Receive(const stream_type id, utils::Memory<char>& mem, int64_t& ts)
+{
+	auto& s = _Stream(id);
+	while (!s.rx.empty() && (s.rx.front().data.size() > mem.Length())) {
+		// 丢弃而不返回-1，调用者会把-1当作连接关闭
+		++s.stats.RecvOversize;
+		m_iFree.push_back(std::move(s.rx.front().data));
+		s.rx.pop_front();
+	}
+	if (s.rx.empty()) {
+		return 0;
+	}
+	auto& pkt = s.rx.front();
+	auto len = pkt.data.size();
+	memcpy(mem.Data(), pkt.data.data(), len);
+	ts = pkt.ts;
+	m_iFree.push_back(std::move(pkt.data));
+	s.rx.pop_front();
+	return static_cast<ssize_t>(len);
+}
+
+
+ssize_t vsnc::forwarder::StreamMux::ReceiveAny(stream_type& id, utils::Memory<char>& mem, int64_t& ts, const int64_t timeout)
+{
+	auto pending = std::any_of(m_iOrder.begin(), m_iOrder.end(), [this](const stream_type sid) {
+		return !m_iStreams[sid]->rx.empty();
+	});
+	auto ret = Pump(pending ? 0 : timeout);
+	if ((-1 == ret) && !pending) {
+		return -1;
+	}
+	for (auto sid : m_iOrder) {
+		if (!m_iStreams[sid]->rx.empty()) {
+			auto len = Receive(sid, mem, ts);
+			if (len > 0) {
+				id = sid;
+				return len;
+			}
+		}
+	}
+	return -2;
+}
+
+
+vsnc::forwarder::StreamStats vsnc::forwarder::StreamMux::GetStats(const stream_type id) const noexcept
+{
+	auto& s = m_iStreams[id];
+	if (!s) {
+		return StreamStats();
+	}
+	auto stats = s->stats;
+	stats.SendPending = s->tx.size();
+	stats.RecvPending = s->rx.size();
+	return stats;
+}
+
+
+vsnc::forwarder::StreamMux::__stream& vsnc::forwarder::StreamMux::_Stream(const stream_type id)
+{
+	if (!m_iStreams[id]) {
+		Open(id);
+	}
+	return *m_iStreams[id];
+}
+
+
+std::vector<char> vsnc::forwarder::StreamMux::_Alloc()
+{
+	if (m_iFree.empty()) {
+		return std::vector<char>();
+	}
+	auto buf = std::move(m_iFree.back());
+	m_iFree.pop_back();
+	return buf;
+}
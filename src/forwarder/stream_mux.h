@@ -0,0 +1,226 @@
+﻿/************************************************************************
+ * @ObjectName: stream_mux.h
+ * @Description: 在同一条P2P连接上复用多条带优先级的逻辑流
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_STREAM_MUX_H__
+#define __VSNC_FORWARDER_STREAM_MUX_H__
+
+
+#include <vector>
+#include <deque>
+#include <memory>
+
+
+#include <stdint.h>
+
+
+#include "transport.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 逻辑流参数
+		/// </summary>
+		struct StreamOptions
+		{
+			/// <summary>优先级，数值越小越优先</summary>
+			uint8_t     Priority   = 128;
+			/// <summary>发送与接收队列各自的数据包个数上限</summary>
+			std::size_t QueueLimit = 1024;
+		};
+
+
+		/// <summary>
+		/// 逻辑流统计信息
+		/// </summary>
+		struct StreamStats
+		{
+			/// <summary>发出的数据包个数</summary>
+			uint64_t    Sent        = 0;
+			/// <summary>收到的数据包个数</summary>
+			uint64_t    Received    = 0;
+			/// <summary>因发送队列已满而丢弃的数据包个数</summary>
+			uint64_t    SendDropped = 0;
+			/// <summary>因接收队列已满而丢弃的数据包个数</summary>
+			uint64_t    RecvDropped = 0;
+			/// <summary>因接收缓冲区过小而丢弃的数据包个数</summary>
+			uint64_t    RecvOversize = 0;
+			/// <summary>发送队列中的数据包个数</summary>
+			std::size_t SendPending = 0;
+			/// <summary>接收队列中的数据包个数</summary>
+			std::size_t RecvPending = 0;
+		};
+
+
+		/// <summary>
+		/// <para>逻辑流复用器</para>
+		/// <para>每个数据报前附加2字节的流头（流号、保留字节），一次打洞得到的连接即可承载最多256条逻辑流；保留字节必须为0，非0的数据报按畸形丢弃，以便日后扩展流头</para>
+		/// <para>发送端各流拥有独立队列，Flush按优先级严格调度；接收端按流号分发到各流队列，ReceiveAny总是先交付高优先级流</para>
+		/// <para>非线程安全，应在同一线程中使用</para>
+		/// <para>仅作为库提供，forwarder的main.cpp未使用：其对端是只收发裸数据的p2p.dll，附加流头会破坏互通；两端均为本库时再在Transport链中叠加</para>
+		/// </summary>
+		class StreamMux
+		{
+		public:
+
+			/// <summary>流号类型</summary>
+			using stream_type = uint8_t;
+
+			/// <summary>流头长度</summary>
+			static constexpr std::size_t Header_Len = 2;
+
+		private:
+
+			/// <summary>
+			/// 排队的数据包
+			/// </summary>
+			struct __packet
+			{
+				/// <summary>时间戳</summary>
+				int64_t           ts;
+				/// <summary>发送队列中含流头，接收队列中不含</summary>
+				std::vector<char> data;
+			};
+
+			/// <summary>
+			/// 逻辑流
+			/// </summary>
+			struct __stream
+			{
+				/// <summary>参数</summary>
+				StreamOptions        opts;
+				/// <summary>发送队列</summary>
+				std::deque<__packet> tx;
+				/// <summary>接收队列</summary>
+				std::deque<__packet> rx;
+				/// <summary>统计信息</summary>
+				StreamStats          stats;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="lower">下层传输</param>
+			/// <param name="mtu">下层单个数据报的最大长度</param>
+			explicit StreamMux(Transport& lower, const std::size_t mtu = 1504);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			StreamMux(const StreamMux&) = delete;
+
+			/// <summary>
+			/// <para>打开或重新配置一条逻辑流</para>
+			/// <para>收到未打开的流的数据时会以默认参数自动打开</para>
+			/// </summary>
+			/// <param name="id">流号</param>
+			/// <param name="opts">流参数</param>
+			void        Open(const stream_type id, const StreamOptions& opts = StreamOptions());
+
+			/// <summary>
+			/// 将数据放入流的发送队列，由Flush实际发送
+			/// </summary>
+			/// <param name="id">流号</param>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回数据长度，队列已满或数据过长返回-1</returns>
+			ssize_t     Send(const stream_type id, const utils::Memory<char>& mem, const int64_t ts);
+
+			/// <summary>
+			/// 按优先级发送队列中的数据包
+			/// </summary>
+			/// <param name="budget">本次最多发送的字节数</param>
+			/// <returns>发送的字节数</returns>
+			std::size_t Flush(const std::size_t budget = SIZE_MAX);
+
+			/// <summary>
+			/// 从下层接收数据报并分发到各流的接收队列
+			/// </summary>
+			/// <param name="timeout">以毫秒为单位的第一个数据报的等待时间，此后只取走已到达的数据报</param>
+			/// <param name="batch">本次最多接收的数据报个数</param>
+			/// <returns>成功返回分发的数据报个数，下层失败返回-1，超时返回-2</returns>
+			ssize_t     Pump(const int64_t timeout, const std::size_t batch = 64);
+
+			/// <summary>
+			/// 从指定流的接收队列取出一个数据包
+			/// </summary>
+			/// <param name="id">流号</param>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回数据长度，队列为空返回0；大于缓冲区的数据包被丢弃并计入RecvOversize</returns>
+			ssize_t     Receive(const stream_type id, utils::Memory<char>& mem, int64_t& ts);
+
+			/// <summary>
+			/// <para>按优先级取出一个数据包</para>
+			/// <para>先取走下层已到达的全部数据报，再交付最高优先级流中的数据包，因此高优先级流不会被低优先级流的突发阻塞</para>
+			/// </summary>
+			/// <param name="id">数据包所属的流号</param>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回数据长度，失败返回-1，超时返回-2</returns>
+			ssize_t     ReceiveAny(stream_type& id, utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1);
+
+			/// <summary>
+			/// 获取流的统计信息
+			/// </summary>
+			/// <param name="id">流号</param>
+			/// <returns>统计信息</returns>
+			StreamStats GetStats(const stream_type id) const noexcept;
+
+			/// <summary>
+			/// 获取被丢弃的过短或保留字节非0的数据报个数
+			/// </summary>
+			/// <returns>数据报个数</returns>
+			uint64_t    Malformed() const noexcept { return m_uMalformed; }
+
+		private:
+
+			/// <summary>
+			/// 获取流，不存在时以默认参数打开
+			/// </summary>
+			/// <param name="id">流号</param>
+			/// <returns>流</returns>
+			__stream&   _Stream(const stream_type id);
+
+			/// <summary>
+			/// 从空闲列表获取缓冲区
+			/// </summary>
+			/// <returns>缓冲区</returns>
+			std::vector<char> _Alloc();
+
+		private:
+
+			/// <summary>下层传输</summary>
+			Transport&                             m_iLower;
+			/// <summary>下层单个数据报的最大长度</summary>
+			const std::size_t                      m_uMtu;
+			/// <summary>按流号索引的逻辑流</summary>
+			std::vector<std::unique_ptr<__stream>> m_iStreams;
+			/// <summary>按优先级排序的已打开流号</summary>
+			std::vector<stream_type>               m_iOrder;
+			/// <summary>接收缓冲区</summary>
+			std::vector<char>                      m_iRecvBuf;
+			/// <summary>可复用的空闲缓冲区</summary>
+			std::vector<std::vector<char>>         m_iFree;
+			/// <summary>被丢弃的过短或保留字节非0的数据报个数</summary>
+			uint64_t                               m_uMalformed;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_STREAM_MUX_H__
@@ -0,0 +1,123 @@
+﻿/************************************************************************
+ * @ObjectName: transport.h
+ * @Description: 数据报传输接口，用于在P2P客户端之上叠加协议层
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_TRANSPORT_H__
+#define __VSNC_FORWARDER_TRANSPORT_H__
+
+
+#include <stdint.h>
+
+
+#include <p2p/client.h>
+#include <vsnc_utils/memory.h>
+
+
+#include "../punch/client.h"
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// <para>数据报传输接口</para>
+		/// <para>各协议层实现该接口并持有下层传输的引用，从而可以任意叠加；返回值含义与p2p::Client一致</para>
+		/// </summary>
+		class Transport
+		{
+		public:
+
+			/// <summary>
+			/// 虚默认析构函数
+			/// </summary>
+			virtual ~Transport() = default;
+
+			/// <summary>
+			/// 发送数据
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回发送的字节数，失败返回-1</returns>
+			virtual ssize_t Send(const utils::Memory<char>& mem, const int64_t ts) = 0;
+
+			/// <summary>
+			/// 接收数据
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，失败返回-1，超时返回-2</returns>
+			virtual ssize_t Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) = 0;
+
+			/// <summary>
+			/// <para>获取可等待可读的套接字，供事件循环以就绪通知代替轮询</para>
+			/// <para>套接字可读或到达next时应再次调用Receive；各层将下层的结果与自身的定时任务合并</para>
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的最迟须再次调用Receive的时间</param>
+			/// <returns>套接字，不支持时返回-1，此时只能轮询</returns>
+			virtual int     Handle(int64_t& next) noexcept { return -1; }
+		};
+
+
+		/// <summary>
+		/// 以P2P客户端为底层的传输
+		/// </summary>
+		class ClientTransport final : public Transport
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="client">P2P客户端</param>
+			explicit ClientTransport(punch::Client& client) noexcept : m_pClient(&client) {}
+
+			/// <summary>
+			/// 更换底层客户端，在客户端被重建后调用
+			/// </summary>
+			/// <param name="client">P2P客户端</param>
+			void    Reset(punch::Client& client) noexcept { m_pClient = &client; }
+
+			/// <summary>
+			/// 发送数据
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回发送的字节数，失败返回-1</returns>
+			ssize_t Send(const utils::Memory<char>& mem, const int64_t ts) override { return m_pClient->Send(mem, ts); }
+
+			/// <summary>
+			/// 接收数据
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，失败返回-1，超时返回-2</returns>
+			ssize_t Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) override { return m_pClient->Receive(mem, ts, timeout); }
+
+			/// <summary>
+			/// 获取客户端由调用者驱动时等待可读的套接字
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的下一次须驱动客户端的时间</param>
+			/// <returns>套接字，客户端有后台线程时返回-1</returns>
+			int     Handle(int64_t& next) noexcept override { return m_pClient->Handle(next); }
+
+		private:
+
+			/// <summary>P2P客户端</summary>
+			punch::Client* m_pClient;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_TRANSPORT_H__
@@ -0,0 +1,90 @@
+﻿/************************************************************************
+ * @ObjectName: wire.h
+ * @Description: 协议头中整数的网络字节序读写
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_FORWARDER_WIRE_H__
+#define __VSNC_FORWARDER_WIRE_H__
+
+
+#include <stdint.h>
+
+
+namespace vsnc
+{
+
+	namespace forwarder
+	{
+
+
+		/// <summary>
+		/// 以大端序写入16位无符号整数
+		/// </summary>
+		/// <param name="p">写入位置</param>
+		/// <param name="v">数值</param>
+		inline void     __put_u16(char* const p, const uint16_t v) noexcept
+		{
+			p[0] = static_cast<char>(v >> 8);
+			p[1] = static_cast<char>(v);
+		}
+
+		/// <summary>
+		/// 以大端序写入32位无符号整数
+		/// </summary>
+		/// <param name="p">写入位置</param>
+		/// <param name="v">数值</param>
+		inline void     __put_u32(char* const p, const uint32_t v) noexcept
+		{
+			__put_u16(p, static_cast<uint16_t>(v >> 16));
+			__put_u16(p + 2, static_cast<uint16_t>(v));
+		}
+
+		/// <summary>
+		/// 以大端序写入64位无符号整数
+		/// </summary>
+		/// <param name="p">写入位置</param>
+		/// <param name="v">数值</param>
+		inline void     __put_u64(char* const p, const uint64_t v) noexcept
+		{
+			__put_u32(p, static_cast<uint32_t>(v >> 32));
+			__put_u32(p + 4, static_cast<uint32_t>(v));
+		}
+
+		/// <summary>
+		/// 以大端序读取16位无符号整数
+		/// </summary>
+		/// <param name="p">读取位置</param>
+		/// <returns>数值</returns>
+		inline uint16_t __get_u16(const char* const p) noexcept
+		{
+			return static_cast<uint16_t>((static_cast<uint8_t>(p[0]) << 8) | static_cast<uint8_t>(p[1]));
+		}
+
+		/// <summary>
+		/// 以大端序读取32位无符号整数
+		/// </summary>
+		/// <param name="p">读取位置</param>
+		/// <returns>数值</returns>
+		inline uint32_t __get_u32(const char* const p) noexcept
+		{
+			return (static_cast<uint32_t>(__get_u16(p)) << 16) | __get_u16(p + 2);
+		}
+
+		/// <summary>
+		/// 以大端序读取64位无符号整数
+		/// </summary>
+		/// <param name="p">读取位置</param>
+		/// <returns>数值</returns>
+		inline uint64_t __get_u64(const char* const p) noexcept
+		{
+			return (static_cast<uint64_t>(__get_u32(p)) << 32) | __get_u32(p + 4);
+		}
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_FORWARDER_WIRE_H__
@@ -0,0 +1,98 @@
+﻿/************************************************************************
+ * @ObjectName: histogram.cpp
+ * @Description: 对数分桶的时延直方图，用于统计分位数
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "histogram.h"
+
+
+#include <algorithm>
+
+
+namespace
+{
+	/// <summary>每段的桶个数</summary>
+	constexpr std::size_t Sub_Buckets = 16;
+	/// <summary>桶个数，覆盖到2^63</summary>
+	constexpr std::size_t Buckets     = (64 - 4 + 1) * Sub_Buckets;
+
+	std::size_t highestBit(uint64_t v)
+	{
+		std::size_t n = 0;
+		for (std::size_t step = 32; step; step >>= 1) {
+			if (v >> step) {
+				v >>= step;
+				n += step;
+			}
+		}
+		return n;
+	}
+}
+
+
+vsnc::generator::Histogram::Histogram() :
+	m_iBuckets(Buckets, 0),
+	m_uCount(0),
+	m_nMax(0)
+{
+}
+
+
+void vsnc::generator::Histogram::Record(const int64_t value) noexcept
+{
+	auto v = (std::max)(value, static_cast<int64_t>(0));
+	++m_iBuckets[_Index(static_cast<uint64_t>(v))];
+	++m_uCount;
+	m_nMax = (std::max)(m_nMax, v);
+}
+
+
+void vsnc::generator::Histogram::Merge(const Histogram& other) noexcept
+{
+	for (std::size_t i = 0; i < m_iBuckets.size(); ++i) {
+		m_iBuckets[i] += other.m_iBuckets[i];
+	}
+	m_uCount += other.m_uCount;
+	m_nMax = (std::max)(m_nMax, other.m_nMax);
+}
+
+
+int64_t vsnc::generator::Histogram::Percentile(const double q) const noexcept
+{
+	if (!m_uCount) {
+		return 0;
+	}
+	auto target = static_cast<uint64_t>(q * static_cast<double>(m_uCount));
+	target = (std::min)((std::max)(target, static_cast<uint64_t>(1)), m_uCount);
+	uint64_t acc = 0;
+	for (std::size_t i = 0; i < m_iBuckets.size(); ++i) {
+		acc += m_iBuckets[i];
+		if (acc >= target) {
+			return (std::min)(_Upper(i), m_nMax);
+		}
+	}
+	return m_nMax;
+}
+
+
+std::size_t vsnc::generator::Histogram::_Index(const uint64_t value) noexcept
+{
+	if (value < 2 * Sub_Buckets) {
+		return static_cast<std::size_t>(value);
+	}
+	// 保留最高的5位：shift段内的第(value >> shift) - 16个桶
+	auto shift = highestBit(value) - 4;
+	return (shift + 1) * Sub_Buckets + static_cast<std::size_t>(value >> shift) - Sub_Buckets;
+}
+
+
+int64_t vsnc::generator::Histogram::_Upper(const std::size_t index) noexcept
+{
+	if (index < 2 * Sub_Buckets) {
+		return static_cast<int64_t>(index);
+	}
+	auto shift = index / Sub_Buckets - 1;
+	auto sub = static_cast<uint64_t>(index % Sub_Buckets + Sub_Buckets);
+	return static_cast<int64_t>(((sub + 1) << shift) - 1);
+}
@@ -0,0 +1,101 @@
+﻿/************************************************************************
+ * @ObjectName: histogram.h
+ * @Description: 对数分桶的时延直方图，用于统计分位数
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_GENERATOR_HISTOGRAM_H__
+#define __VSNC_GENERATOR_HISTOGRAM_H__
+
+
+#include <vector>
+
+
+#include <stdint.h>
+
+
+namespace vsnc
+{
+
+	namespace generator
+	{
+
+
+		/// <summary>
+		/// <para>对数分桶的直方图</para>
+		/// <para>小于32的值各占一个桶，更大的值按2的幂分段，每段16个桶，相对误差不超过1/16；记录为O(1)且内存固定，适合每个数据包记录一次</para>
+		/// <para>非线程安全，多线程时各自记录后以Merge合并</para>
+		/// </summary>
+		class Histogram
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			Histogram();
+
+			/// <summary>
+			/// 记录一个值，负值按0记录
+			/// </summary>
+			/// <param name="value">值</param>
+			void     Record(const int64_t value) noexcept;
+
+			/// <summary>
+			/// 合并另一个直方图
+			/// </summary>
+			/// <param name="other">直方图</param>
+			void     Merge(const Histogram& other) noexcept;
+
+			/// <summary>
+			/// 获取分位数
+			/// </summary>
+			/// <param name="q">0到1之间的分位</param>
+			/// <returns>分位数所在桶的上界，没有记录时返回0</returns>
+			int64_t  Percentile(const double q) const noexcept;
+
+			/// <summary>
+			/// 获取记录的个数
+			/// </summary>
+			/// <returns>记录的个数</returns>
+			uint64_t Count() const noexcept { return m_uCount; }
+
+			/// <summary>
+			/// 获取最大值
+			/// </summary>
+			/// <returns>最大值</returns>
+			int64_t  Max() const noexcept { return m_nMax; }
+
+		private:
+
+			/// <summary>
+			/// 计算值所在的桶
+			/// </summary>
+			/// <param name="value">非负值</param>
+			/// <returns>桶序号</returns>
+			static std::size_t _Index(const uint64_t value) noexcept;
+
+			/// <summary>
+			/// 计算桶的上界
+			/// </summary>
+			/// <param name="index">桶序号</param>
+			/// <returns>上界</returns>
+			static int64_t     _Upper(const std::size_t index) noexcept;
+
+		private:
+
+			/// <summary>各桶的计数</summary>
+			std::vector<uint64_t> m_iBuckets;
+			/// <summary>记录的个数</summary>
+			uint64_t              m_uCount;
+			/// <summary>最大值</summary>
+			int64_t               m_nMax;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_GENERATOR_HISTOGRAM_H__
@@ -0,0 +1,158 @@
+﻿/************************************************************************
+ * @ObjectName: main.cpp
+ * @Description: 流量发生器与接收端入口
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+
+#include <vsnc_utils/clock.h>
+#include <vsnc_utils/utils.h>
+
+#include "traffic.h"
+
+
+static void usage()
+{
+	std::cout << "usage: generator send <server> <port> <local> <peer> [key=value ...]" << std::endl;
+	std::cout << "         clients=1 threads=1 rate=1000 (pps) bitrate=0 (bit/s, overrides rate)" << std::endl;
+	std::cout << "         size=1200 min=64 max=1200 dist=fixed|uniform|imix" << std::endl;
+	std::cout << "         burst=1 on=0 off=0 (ms) duration=10 (s) sync=0 (1: clock sync with the sink)" << std::endl;
+	std::cout << "       generator sink <server> <port> <local> [clients] [duration] [sync]" << std::endl;
+	std::cout << "       generator sink udp <port> [duration]  (latency valid on the same host or with externally synced clocks)" << std::endl;
+}
+
+static bool option(const char* arg, vsnc::generator::GeneratorOptions& opts)
+{
+	auto eq = strchr(arg, '=');
+	if (!eq) {
+		return false;
+	}
+	std::string key(arg, eq);
+	std::string value(eq + 1);
+	auto n = strtoull(value.c_str(), nullptr, 10);
+	if ("clients" == key) opts.Clients = static_cast<std::size_t>(n);
+	else if ("threads" == key) opts.Threads = static_cast<std::size_t>(n);
+	else if ("rate" == key) opts.Rate = n;
+	else if ("bitrate" == key) opts.Bitrate = n;
+	else if ("size" == key) opts.MaxSize = static_cast<std::size_t>(n);
+	else if ("min" == key) opts.MinSize = static_cast<std::size_t>(n);
+	else if ("max" == key) opts.MaxSize = static_cast<std::size_t>(n);
+	else if ("burst" == key) opts.Burst = static_cast<std::size_t>(n);
+	else if ("on" == key) opts.OnTime = static_cast<int64_t>(n);
+	else if ("off" == key) opts.OffTime = static_cast<int64_t>(n);
+	else if ("duration" == key) opts.Duration = static_cast<int64_t>(n);
+	else if ("sync" == key) opts.ClockSync = (0 != n);
+	else if ("dist" == key) {
+		if ("fixed" == value) opts.Distribution = vsnc::generator::size_distribution::FIXED;
+		else if ("uniform" == value) opts.Distribution = vsnc::generator::size_distribution::UNIFORM;
+		else if ("imix" == value) opts.Distribution = vsnc::generator::size_distribution::IMIX;
+		else return false;
+	}
+	else return false;
+	return true;
+}
+
+static int generate(int argc, char* argv[])
+{
+	if (argc < 6) {
+		usage();
+		return 1;
+	}
+	vsnc::generator::GeneratorOptions opts;
+	opts.Server = argv[2];
+	opts.Port = static_cast<uint16_t>(atoi(argv[3]));
+	opts.Local = strtoull(argv[4], nullptr, 10);
+	opts.Peer = strtoull(argv[5], nullptr, 10);
+	for (auto i = 6; i < argc; ++i) {
+		if (!option(argv[i], opts)) {
+			std::cout << "unknown option: " << argv[i] << std::endl;
+			usage();
+			return 1;
+		}
+	}
+	vsnc::generator::TrafficGenerator gen(opts);
+	auto report = gen.Run();
+	std::cout << "connected: " << report.Connected << "/" << opts.Clients << std::endl;
+	if (!report.Connected) {
+		return 1;
+	}
+	std::cout << "sent: " << report.Sent
+		<< " failed: " << report.Failed
+		<< " in " << vsnc::utils::__to_string_with_precision(report.Seconds) << "s" << std::endl;
+	std::cout << "throughput: " << vsnc::utils::__to_string_with_precision(report.Pps) << " pps "
+		<< vsnc::utils::__to_string_with_precision(report.Mbps) << " Mbit/s" << std::endl;
+	std::cout << "schedule lag avg/max: " << vsnc::utils::__to_string_with_precision(report.AvgLag) << "/" << report.MaxLag
+		<< "us late: " << report.Late << std::endl;
+	return 0;
+}
+
+static int sink(int argc, char* argv[])
+{
+	vsnc::generator::SinkOptions opts;
+	if ((argc > 3) && (0 == strcmp(argv[2], "udp"))) {
+		opts.UdpPort = static_cast<uint16_t>(atoi(argv[3]));
+		if (argc > 4) opts.Duration = static_cast<int64_t>(atoll(argv[4]));
+	}
+	else if (argc > 4) {
+		opts.Server = argv[2];
+		opts.Port = static_cast<uint16_t>(atoi(argv[3]));
+		opts.Local = strtoull(argv[4], nullptr, 10);
+		if (argc > 5) opts.Clients = static_cast<std::size_t>(atoll(argv[5]));
+		if (argc > 6) opts.Duration = static_cast<int64_t>(atoll(argv[6]));
+		if (argc > 7) opts.ClockSync = (0 != atoi(argv[7]));
+	}
+	else {
+		usage();
+		return 1;
+	}
+	vsnc::generator::TrafficSink receiver(opts);
+	std::cout << "receiving for " << opts.Duration << "s" << std::endl;
+	auto report = receiver.Run();
+	auto total = report.Received + report.Lost;
+	auto loss = total ? (100.0 * static_cast<double>(report.Lost) / static_cast<double>(total)) : 0.0;
+	std::cout << "streams: " << report.Streams
+		<< " received: " << report.Received
+		<< " lost: " << report.Lost << " (" << vsnc::utils::__to_string_with_precision(loss, 3) << "%)"
+		<< " duplicates: " << report.Duplicates
+		<< " reordered: " << report.Reordered
+		<< " malformed: " << report.Malformed << std::endl;
+	std::cout << "throughput: " << vsnc::utils::__to_string_with_precision(report.Pps) << " pps "
+		<< vsnc::utils::__to_string_with_precision(report.Mbps) << " Mbit/s over "
+		<< vsnc::utils::__to_string_with_precision(report.Seconds) << "s" << std::endl;
+	std::cout << "latency p50/p90/p99/p99.9/max: " << report.P50 << "/" << report.P90 << "/" << report.P99
+		<< "/" << report.P999 << "/" << report.Max << "us" << std::endl;
+	if (opts.ClockSync) {
+		std::cout << "sender clock offset: " << report.Offset << "us" << std::endl;
+	}
+	return 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+	//初始化WSA
+	WORD sockVersion = MAKEWORD(2, 2);
+	WSADATA wsaData;
+	if (WSAStartup(sockVersion, &wsaData) != 0) return 0;
+	// 启动时标定TSC时钟，标定的忙等不计入首个发送周期
+	vsnc::utils::TscClock::Calibrate();
+
+	auto ret = 1;
+	if ((argc > 1) && (0 == strcmp(argv[1], "send"))) {
+		ret = generate(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "sink"))) {
+		ret = sink(argc, argv);
+	}
+	else {
+		usage();
+	}
+	WSACleanup();
+	return ret;
+}
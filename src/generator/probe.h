@@ -0,0 +1,95 @@
+﻿/************************************************************************
+ * @ObjectName: probe.h
+ * @Description: 测试数据包头的编解码
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_GENERATOR_PROBE_H__
+#define __VSNC_GENERATOR_PROBE_H__
+
+
+#include <cstddef>
+
+
+#include <stdint.h>
+
+
+#include "../forwarder/wire.h"
+
+
+namespace vsnc
+{
+
+	namespace generator
+	{
+
+
+		/// <summary>数据包头长度，也是测试数据包的最小长度</summary>
+		constexpr std::size_t Probe_Len   = 20;
+		/// <summary>数据包头魔数"VSNG"</summary>
+		constexpr uint32_t    Probe_Magic = 0x56534E47;
+		/// <summary>结束标记的魔数"VSNE"</summary>
+		constexpr uint32_t    End_Magic   = 0x56534E45;
+
+
+		/// <summary>
+		/// <para>测试数据包头</para>
+		/// <para>格式：魔数(4) 流标识(4) 序号(4) 发送时间(8)，均为网络字节序，其后为填充数据</para>
+		/// <para>结束标记以End_Magic代替魔数，序号字段为该流发出的数据包个数，没有填充数据</para>
+		/// </summary>
+		struct Probe
+		{
+			/// <summary>流标识，即发送端的客户端序号</summary>
+			uint32_t Stream = 0;
+			/// <summary>流内从0开始的序号</summary>
+			uint32_t Seq    = 0;
+			/// <summary>以纳秒为单位的UTC发送时间，跨主机计算时延时两端需已同步时钟</summary>
+			int64_t  SentAt = 0;
+			/// <summary>是否为结束标记</summary>
+			bool     End    = false;
+		};
+
+
+		/// <summary>
+		/// 写入数据包头
+		/// </summary>
+		/// <param name="probe">数据包头</param>
+		/// <param name="buf">写入位置，至少Probe_Len字节</param>
+		inline void __encode(const Probe& probe, char* const buf) noexcept
+		{
+			forwarder::__put_u32(buf, probe.End ? End_Magic : Probe_Magic);
+			forwarder::__put_u32(buf + 4, probe.Stream);
+			forwarder::__put_u32(buf + 8, probe.Seq);
+			forwarder::__put_u64(buf + 12, static_cast<uint64_t>(probe.SentAt));
+		}
+
+		/// <summary>
+		/// 解析数据包头
+		/// </summary>
+		/// <param name="buf">数据</param>
+		/// <param name="len">数据长度</param>
+		/// <param name="probe">解析出的数据包头</param>
+		/// <returns>长度不足或魔数不符返回false</returns>
+		inline bool __decode(const char* const buf, const std::size_t len, Probe& probe) noexcept
+		{
+			if (len < Probe_Len) {
+				return false;
+			}
+			auto magic = forwarder::__get_u32(buf);
+			if ((Probe_Magic != magic) && (End_Magic != magic)) {
+				return false;
+			}
+			probe.End = (End_Magic == magic);
+			probe.Stream = forwarder::__get_u32(buf + 4);
+			probe.Seq = forwarder::__get_u32(buf + 8);
+			probe.SentAt = static_cast<int64_t>(forwarder::__get_u64(buf + 12));
+			return true;
+		}
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_GENERATOR_PROBE_H__
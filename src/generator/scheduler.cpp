@@ -0,0 +1,46 @@
+﻿/************************************************************************
+ * @ObjectName: scheduler.cpp
+ * @Description: 按绝对截止时间精确调度发送时刻
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "scheduler.h"
+
+
+#include <algorithm>
+#include <thread>
+
+
+#include <vsnc_utils/clock.h>
+#include <vsnc_utils/utils.h>
+
+
+int64_t vsnc::generator::Scheduler::Now() noexcept
+{
+	return utils::__tsc_ns();
+}
+
+
+int64_t vsnc::generator::Scheduler::WaitUntil(const int64_t deadline) noexcept
+{
+	++m_iStats.Waits;
+	auto now = Now();
+	while (now < deadline) {
+		auto left = deadline - now;
+		if (left > Sleep_Margin) {
+			++m_iStats.Sleeps;
+			utils::__sleep_milliseconds(static_cast<int>((left - Sleep_Margin) / 1000000 + 1));
+		}
+		else if (left > Spin_Margin) {
+			std::this_thread::yield();
+		}
+		now = Now();
+	}
+	auto lag = now - deadline;
+	m_iStats.LagSum += lag;
+	m_iStats.MaxLag = (std::max)(m_iStats.MaxLag, lag);
+	if (lag > m_nLate) {
+		++m_iStats.Late;
+	}
+	return lag;
+}
@@ -0,0 +1,97 @@
+﻿/************************************************************************
+ * @ObjectName: scheduler.h
+ * @Description: 按绝对截止时间精确调度发送时刻
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_GENERATOR_SCHEDULER_H__
+#define __VSNC_GENERATOR_SCHEDULER_H__
+
+
+#include <stdint.h>
+
+
+namespace vsnc
+{
+
+	namespace generator
+	{
+
+
+		/// <summary>
+		/// 调度统计信息
+		/// </summary>
+		struct SchedulerStats
+		{
+			/// <summary>等待的次数</summary>
+			uint64_t Waits  = 0;
+			/// <summary>晚于截止时间超过容限的次数</summary>
+			uint64_t Late   = 0;
+			/// <summary>以纳秒为单位的累计延迟</summary>
+			int64_t  LagSum = 0;
+			/// <summary>以纳秒为单位的最大延迟</summary>
+			int64_t  MaxLag = 0;
+			/// <summary>进入休眠的次数</summary>
+			uint64_t Sleeps = 0;
+		};
+
+
+		/// <summary>
+		/// <para>精确调度器</para>
+		/// <para>调用者以起始时间加整数倍间隔计算绝对截止时间，单次等待的误差不会累积到后续的发送时刻</para>
+		/// <para>剩余时间较长时休眠，较短时让出时间片，最后一段忙等读取TSC时钟；Windows默认定时器精度约15.6毫秒，因此只在剩余时间超过Sleep_Margin时休眠，代价是每个发送线程占满一个核</para>
+		/// <para>非线程安全，每个发送线程使用独立的实例</para>
+		/// </summary>
+		class Scheduler
+		{
+		public:
+
+			/// <summary>以纳秒为单位的休眠余量，剩余时间超过该值才休眠</summary>
+			static constexpr int64_t Sleep_Margin   = 20000000;
+			/// <summary>以纳秒为单位的忙等余量，剩余时间小于该值时不再让出时间片</summary>
+			static constexpr int64_t Spin_Margin    = 50000;
+			/// <summary>以纳秒为单位的默认延迟容限</summary>
+			static constexpr int64_t Late_Threshold = 100000;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="late">以纳秒为单位的延迟容限，晚于截止时间超过该值计为一次迟到</param>
+			explicit Scheduler(const int64_t late = Late_Threshold) noexcept : m_nLate(late) {}
+
+			/// <summary>
+			/// 获取当前时间
+			/// </summary>
+			/// <returns>以纳秒为单位的单调时间</returns>
+			static int64_t        Now() noexcept;
+
+			/// <summary>
+			/// 等待直到截止时间
+			/// </summary>
+			/// <param name="deadline">以纳秒为单位的单调时间</param>
+			/// <returns>以纳秒为单位的返回时刻晚于截止时间的量</returns>
+			int64_t               WaitUntil(const int64_t deadline) noexcept;
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			const SchedulerStats& GetStats() const noexcept { return m_iStats; }
+
+		private:
+
+			/// <summary>以纳秒为单位的延迟容限</summary>
+			const int64_t  m_nLate;
+			/// <summary>统计信息</summary>
+			SchedulerStats m_iStats;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_GENERATOR_SCHEDULER_H__
@@ -0,0 +1,511 @@
+﻿/************************************************************************
+ * @ObjectName: traffic.cpp
+ * @Description: 以P2P客户端按设定速率发送测试流量，并在接收端统计吞吐、丢包与时延
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "traffic.h"
+
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <random>
+#include <thread>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+
+
+#include <vsnc_utils/clock.h>
+#include <vsnc_utils/utils.h>
+
+
+#include "probe.h"
+#include "scheduler.h"
+
+
+namespace
+{
+	/// <summary>IMIX的包长</summary>
+	constexpr std::size_t Imix_Sizes[]   = { 64, 576, 1500 };
+	/// <summary>IMIX各包长的权重</summary>
+	constexpr std::size_t Imix_Weights[] = { 7, 4, 1 };
+	/// <summary>IMIX权重之和</summary>
+	constexpr std::size_t Imix_Total     = 12;
+	/// <summary>单个数据报的最大长度</summary>
+	constexpr std::size_t Max_Datagram   = 65507;
+	/// <summary>结束标记的发送次数，以防标记本身丢失</summary>
+	constexpr int         End_Repeats    = 5;
+	/// <summary>以毫秒为单位的结束标记的发送间隔</summary>
+	constexpr int64_t     End_Interval   = 20;
+
+	std::size_t clampSize(const std::size_t size, const vsnc::generator::GeneratorOptions& opts)
+	{
+		auto lo = (std::max)(opts.MinSize, vsnc::generator::Probe_Len);
+		auto hi = (std::max)(opts.MaxSize, lo);
+		return (std::min)((std::max)(size, lo), hi);
+	}
+
+	std::size_t packetSize(const vsnc::generator::GeneratorOptions& opts, std::mt19937& rng)
+	{
+		switch (opts.Distribution)
+		{
+		case vsnc::generator::size_distribution::UNIFORM:
+		{
+			std::uniform_int_distribution<std::size_t> pick(clampSize(opts.MinSize, opts), clampSize(opts.MaxSize, opts));
+			return pick(rng);
+		}
+		case vsnc::generator::size_distribution::IMIX:
+		{
+			auto r = static_cast<std::size_t>(rng() % Imix_Total);
+			std::size_t i = 0;
+			while (r >= Imix_Weights[i]) {
+				r -= Imix_Weights[i++];
+			}
+			return clampSize(Imix_Sizes[i], opts);
+		}
+		default:
+			return clampSize(opts.MaxSize, opts);
+		}
+	}
+
+	int64_t nowUtcNanoseconds()
+	{
+		return vsnc::utils::__monotonic_ns() + vsnc::utils::__utc_offset_ns();
+	}
+
+	template <typename _Pred>
+	bool waitUntil(_Pred done, const int64_t deadline)
+	{
+		while (!done()) {
+			if (vsnc::utils::__steady() >= deadline) {
+				return false;
+			}
+			vsnc::utils::__sleep_milliseconds(10);
+		}
+		return true;
+	}
+}
+
+
+vsnc::generator::TrafficGenerator::TrafficGenerator(const GeneratorOptions& opts) :
+	m_iOpts(opts),
+	m_nInterval(1),
+	m_nLagSum(0),
+	m_uWaits(0)
+{
+	m_iOpts.Clients = (std::max)(m_iOpts.Clients, static_cast<std::size_t>(1));
+	m_iOpts.Threads = (std::max)(m_iOpts.Threads, static_cast<std::size_t>(1));
+	m_iOpts.Burst = (std::max)(m_iOpts.Burst, static_cast<std::size_t>(1));
+	m_iOpts.MaxSize = (std::min)(m_iOpts.MaxSize, Max_Datagram);
+}
+
+
+vsnc::generator::GeneratorReport vsnc::generator::TrafficGenerator::Run()
+{
+	m_iReport = GeneratorReport();
+	m_nLagSum = 0;
+	m_uWaits = 0;
+	m_iReport.Connected = _Connect();
+	if (!m_iReport.Connected) {
+		return m_iReport;
+	}
+
+	// 每个发送时刻发出Burst个数据包，间隔相应放大以保持平均速率
+	auto pps = m_iOpts.Bitrate ? (static_cast<double>(m_iOpts.Bitrate) / 8.0 / _MeanSize()) : static_cast<double>(m_iOpts.Rate);
+	pps = (std::max)(pps, 1e-3);
+	m_nInterval = (std::max)(static_cast<int64_t>(1e9 * static_cast<double>(m_iOpts.Burst) / pps), static_cast<int64_t>(1));
+
+	// 各流的首个发送时刻在一个间隔内均匀错开，避免所有客户端同时发送
+	auto start = Scheduler::Now() + 10000000;
+	auto end = start + m_iOpts.Duration * 1000000000;
+	auto nthread = (std::min)(m_iOpts.Threads, m_iFlows.size());
+	std::vector<std::vector<__flow*>> groups(nthread);
+	for (std::size_t i = 0; i < m_iFlows.size(); ++i) {
+		m_iFlows[i].next = start + m_nInterval * static_cast<int64_t>(i) / static_cast<int64_t>(m_iFlows.size());
+		groups[i % nthread].push_back(&m_iFlows[i]);
+	}
+	std::vector<std::thread> threads;
+	for (auto& group : groups) {
+		threads.emplace_back(&TrafficGenerator::_Send, this, group, start, end);
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	auto elapsed = (std::min)(Scheduler::Now(), end) - start;
+	_Finish();
+	for (auto& flow : m_iFlows) {
+		flow.client->Close();
+	}
+	m_iFlows.clear();
+
+	m_iReport.Seconds = static_cast<double>(elapsed) / 1e9;
+	if (m_iReport.Seconds > 0.0) {
+		m_iReport.Pps = static_cast<double>(m_iReport.Sent) / m_iReport.Seconds;
+		m_iReport.Mbps = static_cast<double>(m_iReport.Bytes) * 8.0 / m_iReport.Seconds / 1e6;
+	}
+	m_iReport.AvgLag = m_uWaits ? (static_cast<double>(m_nLagSum) / static_cast<double>(m_uWaits) / 1000.0) : 0.0;
+	m_iReport.MaxLag /= 1000;
+	return m_iReport;
+}
+
+
+std::size_t vsnc::generator::TrafficGenerator::_Connect()
+{
+	auto deadline = utils::__steady() + m_iOpts.ConnectTimeout;
+	m_iFlows.clear();
+	for (std::size_t i = 0; i < m_iOpts.Clients; ++i) {
+		__flow flow;
+		flow.client.reset(new punch::Client(m_iOpts.Local + i, m_iOpts.Server, m_iOpts.Port));
+		flow.link.reset(new forwarder::ClientTransport(*flow.client));
+		if (m_iOpts.ClockSync) {
+			flow.sync.reset(new forwarder::ClockSyncTransport(*flow.link));
+		}
+		flow.out = flow.sync ? static_cast<forwarder::Transport*>(flow.sync.get()) : flow.link.get();
+		flow.stream = static_cast<uint32_t>(m_iOpts.Local + i);
+		flow.seq = 0;
+		flow.next = 0;
+		m_iFlows.push_back(std::move(flow));
+	}
+	// 先等待所有客户端注册，再同时发起连接，总耗时约为一次连接超时
+	waitUntil([this]() {
+		return std::all_of(m_iFlows.begin(), m_iFlows.end(), [](const __flow& f) { return p2p::vsnc_p2p_state::OFFLINE != f.client->GetState(); });
+	}, deadline);
+	for (std::size_t i = 0; i < m_iFlows.size(); ++i) {
+		if (p2p::vsnc_p2p_state::FREE == m_iFlows[i].client->GetState()) {
+			m_iFlows[i].client->Connect(m_iOpts.Peer + i);
+		}
+	}
+	waitUntil([this]() {
+		return std::none_of(m_iFlows.begin(), m_iFlows.end(), [](const __flow& f) {
+			auto state = f.client->GetState();
+			return (p2p::vsnc_p2p_state::REQUESTING == state) || (p2p::vsnc_p2p_state::CONNECTING == state);
+		});
+	}, deadline);
+	auto it = std::remove_if(m_iFlows.begin(), m_iFlows.end(), [](const __flow& f) {
+		return p2p::vsnc_p2p_state::CONNECTED != f.client->GetState();
+	});
+	for (auto failed = it; failed != m_iFlows.end(); ++failed) {
+		failed->client->Close();
+	}
+	m_iFlows.erase(it, m_iFlows.end());
+	return m_iFlows.size();
+}
+
+
+void vsnc::generator::TrafficGenerator::_Send(std::vector<__flow*> flows, const int64_t start, const int64_t end)
+{
+	using __entry = std::pair<int64_t, std::size_t>;
+	std::priority_queue<__entry, std::vector<__entry>, std::greater<__entry>> heap;
+	for (std::size_t k = 0; k < flows.size(); ++k) {
+		heap.emplace(flows[k]->next, k);
+	}
+	std::mt19937 rng(flows.empty() ? 0 : flows.front()->stream);
+	std::vector<char> buf(clampSize(m_iOpts.MaxSize, m_iOpts));
+	for (std::size_t i = 0; i < buf.size(); ++i) {
+		buf[i] = static_cast<char>(i);
+	}
+	auto on = m_iOpts.OnTime * 1000000;
+	auto cycle = ((m_iOpts.OnTime > 0) && (m_iOpts.OffTime > 0)) ? (on + m_iOpts.OffTime * 1000000) : 0;
+
+	Scheduler sched;
+	uint64_t sent = 0, bytes = 0, failed = 0;
+	while (!heap.empty()) {
+		auto deadline = heap.top().first;
+		auto k = heap.top().second;
+		heap.pop();
+		if (deadline >= end) {
+			continue;
+		}
+		if (cycle) {
+			// 静默期内的发送时刻推迟到下一个周期开始
+			auto phase = (deadline - start) % cycle;
+			if (phase >= on) {
+				heap.emplace(deadline - phase + cycle, k);
+				continue;
+			}
+		}
+		if (m_iOpts.ClockSync) {
+			_Serve(flows, deadline);
+		}
+		sched.WaitUntil(deadline);
+		auto& flow = *flows[k];
+		for (std::size_t b = 0; b < m_iOpts.Burst; ++b) {
+			auto size = packetSize(m_iOpts, rng);
+			Probe probe;
+			probe.Stream = flow.stream;
+			probe.Seq = flow.seq;
+			probe.SentAt = nowUtcNanoseconds();
+			__encode(probe, buf.data());
+			utils::BasicMemory<char> mem(buf.data(), size);
+			if (flow.out->Send(mem, utils::__utc()) < 0) {
+				++failed;
+				continue;
+			}
+			// 发送失败的数据包不占用序号，以免被接收端计为丢包
+			++flow.seq;
+			++sent;
+			bytes += size;
+		}
+		heap.emplace(deadline + m_nInterval, k);
+	}
+
+	auto& stats = sched.GetStats();
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	m_iReport.Sent += sent;
+	m_iReport.Bytes += bytes;
+	m_iReport.Failed += failed;
+	m_iReport.Late += stats.Late;
+	m_iReport.MaxLag = (std::max)(m_iReport.MaxLag, stats.MaxLag);
+	m_nLagSum += stats.LagSum;
+	m_uWaits += stats.Waits;
+}
+
+
+void vsnc::generator::TrafficGenerator::_Serve(const std::vector<__flow*>& flows, const int64_t deadline)
+{
+	// 发送端不会收到数据，缓冲区只需容纳时钟探测
+	char buf[Probe_Len];
+	int64_t ts = 0;
+	while (true) {
+		for (auto flow : flows) {
+			utils::BasicMemory<char> mem(buf, sizeof(buf));
+			flow->sync->Receive(mem, ts, 0);
+		}
+		auto left = deadline - Scheduler::Now();
+		if (left <= Scheduler::Spin_Margin) {
+			break;
+		}
+		if (left > Scheduler::Sleep_Margin) {
+			// 与Scheduler相同，只在定时器精度允许时阻塞；阻塞期间由首个流应答探测，有多个流时每毫秒轮流应答一次
+			auto wait = (flows.size() > 1) ? 1 : ((left - Scheduler::Sleep_Margin) / 1000000 + 1);
+			utils::BasicMemory<char> mem(buf, sizeof(buf));
+			flows.front()->sync->Receive(mem, ts, wait);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+
+void vsnc::generator::TrafficGenerator::_Finish()
+{
+	char buf[Probe_Len];
+	for (int i = 0; i < End_Repeats; ++i) {
+		if (i) {
+			utils::__sleep_milliseconds(End_Interval);
+		}
+		for (auto& flow : m_iFlows) {
+			Probe probe;
+			probe.Stream = flow.stream;
+			probe.Seq = flow.seq;
+			probe.SentAt = nowUtcNanoseconds();
+			probe.End = true;
+			__encode(probe, buf);
+			utils::BasicMemory<char> mem(buf, sizeof(buf));
+			flow.out->Send(mem, utils::__utc());
+		}
+	}
+}
+
+
+double vsnc::generator::TrafficGenerator::_MeanSize() const noexcept
+{
+	switch (m_iOpts.Distribution)
+	{
+	case size_distribution::UNIFORM:
+		return (static_cast<double>(clampSize(m_iOpts.MinSize, m_iOpts)) + static_cast<double>(clampSize(m_iOpts.MaxSize, m_iOpts))) / 2.0;
+	case size_distribution::IMIX:
+	{
+		double sum = 0.0;
+		for (std::size_t i = 0; i < 3; ++i) {
+			sum += static_cast<double>(clampSize(Imix_Sizes[i], m_iOpts) * Imix_Weights[i]);
+		}
+		return sum / static_cast<double>(Imix_Total);
+	}
+	default:
+		return static_cast<double>(clampSize(m_iOpts.MaxSize, m_iOpts));
+	}
+}
+
+
+vsnc::generator::SinkReport vsnc::generator::TrafficSink::Run()
+{
+	SinkReport report;
+	auto deadline = utils::__steady() + m_iOpts.Duration * 1000;
+	std::vector<__state> states;
+	if (m_iOpts.UdpPort) {
+		states.resize(1);
+		if (!_ReceiveUdp(states.front(), deadline)) {
+			return report;
+		}
+	}
+	else {
+		auto nclient = (std::max)(m_iOpts.Clients, static_cast<std::size_t>(1));
+		std::vector<std::unique_ptr<punch::Client>> clients;
+		for (std::size_t i = 0; i < nclient; ++i) {
+			clients.emplace_back(new punch::Client(m_iOpts.Local + i, m_iOpts.Server, m_iOpts.Port));
+		}
+		states.resize(nclient);
+		std::vector<std::thread> threads;
+		for (std::size_t i = 0; i < nclient; ++i) {
+			threads.emplace_back(&TrafficSink::_ReceiveClient, this, std::ref(*clients[i]), std::ref(states[i]), deadline);
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		for (auto& client : clients) {
+			client->Close();
+		}
+	}
+
+	Histogram latency;
+	int64_t first = -1, last = -1, offset = 0, synced = 0;
+	for (auto& state : states) {
+		if (state.synced) {
+			offset += state.offset;
+			++synced;
+		}
+		latency.Merge(state.latency);
+		report.Bytes += state.bytes;
+		report.Malformed += state.malformed;
+		if (state.first >= 0) {
+			first = (first < 0) ? state.first : (std::min)(first, state.first);
+			last = (std::max)(last, state.last);
+		}
+		for (auto& s : state.streams) {
+			auto& stats = s.second.window.GetStats();
+			// 收到结束标记时按发送端发出的个数计，否则末尾连续丢失的数据包无从得知
+			auto expected = (s.second.count >= 0) ? static_cast<uint64_t>((std::max)(s.second.count - static_cast<int64_t>(s.second.first), static_cast<int64_t>(0)))
+				: static_cast<uint64_t>(s.second.window.Head() - s.second.first) + 1;
+			++report.Streams;
+			report.Received += stats.Received;
+			report.Duplicates += stats.Duplicates;
+			report.Reordered += stats.Reordered;
+			report.Lost += (expected > stats.Received) ? (expected - stats.Received) : 0;
+		}
+	}
+	if (last > first) {
+		report.Seconds = static_cast<double>(last - first) / 1e9;
+		report.Pps = static_cast<double>(report.Received) / report.Seconds;
+		report.Mbps = static_cast<double>(report.Bytes) * 8.0 / report.Seconds / 1e6;
+	}
+	report.P50 = latency.Percentile(0.5);
+	report.P90 = latency.Percentile(0.9);
+	report.P99 = latency.Percentile(0.99);
+	report.P999 = latency.Percentile(0.999);
+	report.Max = latency.Max();
+	report.Offset = synced ? (offset / synced / 1000) : 0;
+	return report;
+}
+
+
+void vsnc::generator::TrafficSink::_ReceiveClient(punch::Client& client, __state& state, const int64_t deadline)
+{
+	forwarder::ClientTransport link(client);
+	std::unique_ptr<forwarder::ClockSyncTransport> sync;
+	if (m_iOpts.ClockSync) {
+		sync.reset(new forwarder::ClockSyncTransport(link));
+	}
+	auto& in = sync ? static_cast<forwarder::Transport&>(*sync) : link;
+	std::vector<char> buf(Max_Datagram);
+	while (true) {
+		auto left = deadline - utils::__steady();
+		if (left <= 0) {
+			break;
+		}
+		if (p2p::vsnc_p2p_state::CONNECTED != client.GetState()) {
+			// 被动等待发生器连接
+			utils::__sleep_milliseconds(10);
+			continue;
+		}
+		utils::BasicMemory<char> mem(buf.data(), buf.size());
+		int64_t ts = 0;
+		auto ret = in.Receive(mem, ts, (std::min)(left, static_cast<int64_t>(100)));
+		if (ret <= 0) {
+			continue;
+		}
+		if (!sync) {
+			_Input(state, buf.data(), static_cast<std::size_t>(ret), true, 0);
+			continue;
+		}
+		state.synced = sync->Synced();
+		state.offset = state.synced ? (sync->GetStats().Offset * 1000) : 0;
+		_Input(state, buf.data(), static_cast<std::size_t>(ret), state.synced, state.offset);
+	}
+}
+
+
+bool vsnc::generator::TrafficSink::_ReceiveUdp(__state& state, const int64_t deadline)
+{
+	auto sock = static_cast<int>(socket(AF_INET, SOCK_DGRAM, 0));
+	if (-1 == sock) {
+		return false;
+	}
+	int rcvbuf = 8 * 1024 * 1024;
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&rcvbuf), sizeof(rcvbuf));
+	sockaddr_in addr;
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(m_iOpts.UdpPort);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+		closesocket(sock);
+		return false;
+	}
+	std::vector<char> buf(Max_Datagram);
+	while (utils::__steady() < deadline) {
+		fd_set rfds;
+		FD_ZERO(&rfds);
+		FD_SET(sock, &rfds);
+		timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		if (select(sock + 1, &rfds, nullptr, nullptr, &tv) <= 0) {
+			continue;
+		}
+		auto ret = recv(sock, buf.data(), static_cast<int>(buf.size()), 0);
+		if (ret > 0) {
+			_Input(state, buf.data(), static_cast<std::size_t>(ret), true, 0);
+		}
+	}
+	closesocket(sock);
+	return true;
+}
+
+
+void vsnc::generator::TrafficSink::_Input(__state& state, const char* const data, const std::size_t len, const bool timed, const int64_t offset)
+{
+	auto now = nowUtcNanoseconds();
+	Probe probe;
+	if (!__decode(data, len, probe)) {
+		++state.malformed;
+		return;
+	}
+	if (probe.End) {
+		// 只收到结束标记的流从序号0开始全部丢失
+		auto it = state.streams.find(probe.Stream);
+		if (state.streams.end() == it) {
+			it = state.streams.emplace(probe.Stream, __stream { forwarder::SequenceWindow(m_iOpts.Window), 0, -1 }).first;
+		}
+		it->second.count = probe.Seq;
+		return;
+	}
+	if (state.first < 0) {
+		state.first = now;
+	}
+	state.last = now;
+	state.bytes += len;
+	auto it = state.streams.find(probe.Stream);
+	if (state.streams.end() == it) {
+		it = state.streams.emplace(probe.Stream, __stream { forwarder::SequenceWindow(m_iOpts.Window), probe.Seq, -1 }).first;
+	}
+	else if (static_cast<int32_t>(probe.Seq - it->second.first) < 0) {
+		// 早于首个数据包发出的数据包乱序到达，以其为流的起点
+		it->second.first = probe.Seq;
+	}
+	// 发送时间换算到本地时钟：本地时刻等于发送端时刻减去偏差
+	if ((forwarder::seq_state::FRESH == it->second.window.Insert(probe.Seq)) && timed) {
+		state.latency.Record((now - (probe.SentAt - offset)) / 1000);
+	}
+}
@@ -0,0 +1,388 @@
+﻿/************************************************************************
+ * @ObjectName: traffic.h
+ * @Description: 以P2P客户端按设定速率发送测试流量，并在接收端统计吞吐、丢包与时延
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_GENERATOR_TRAFFIC_H__
+#define __VSNC_GENERATOR_TRAFFIC_H__
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+
+#include <stdint.h>
+
+
+#include "../forwarder/clock_sync.h"
+#include "../forwarder/seq_window.h"
+#include "../forwarder/transport.h"
+#include "../punch/client.h"
+#include "histogram.h"
+
+
+namespace vsnc
+{
+
+	namespace generator
+	{
+
+
+		/// <summary>数据包长度分布</summary>
+		enum class size_distribution : int8_t
+		{
+			FIXED   = 0, // 固定为MaxSize
+			UNIFORM = 1, // 在[MinSize, MaxSize]内均匀分布
+			IMIX    = 2, // 64:576:1500字节按7:4:1混合，并限制在[MinSize, MaxSize]内
+		};
+
+
+		/// <summary>
+		/// 发送参数
+		/// </summary>
+		struct GeneratorOptions
+		{
+			/// <summary>打洞服务器地址</summary>
+			std::string       Server         = "127.0.0.1";
+			/// <summary>打洞服务器端口</summary>
+			uint16_t          Port           = 10000;
+			/// <summary>首个客户端的序列号，第i个客户端为Local+i</summary>
+			uint64_t          Local          = 1000;
+			/// <summary>首个对端的序列号，第i个客户端连接Peer+i</summary>
+			uint64_t          Peer           = 2000;
+			/// <summary>客户端个数</summary>
+			std::size_t       Clients        = 1;
+			/// <summary>发送线程个数，客户端按序号轮流分配到各线程</summary>
+			std::size_t       Threads        = 1;
+			/// <summary>每个客户端以数据包每秒为单位的发送速率</summary>
+			uint64_t          Rate           = 1000;
+			/// <summary>每个客户端以比特每秒为单位的发送速率，不为0时按平均包长换算并覆盖Rate</summary>
+			uint64_t          Bitrate        = 0;
+			/// <summary>数据包长度分布</summary>
+			size_distribution Distribution   = size_distribution::FIXED;
+			/// <summary>最小数据包长度，不小于Probe_Len，FIXED分布时不使用</summary>
+			std::size_t       MinSize        = 64;
+			/// <summary>最大数据包长度</summary>
+			std::size_t       MaxSize        = 1200;
+			/// <summary>每个发送时刻连续发出的数据包个数，平均速率不变</summary>
+			std::size_t       Burst          = 1;
+			/// <summary>以毫秒为单位的发送时长，与OffTime交替，为0时持续发送</summary>
+			int64_t           OnTime         = 0;
+			/// <summary>以毫秒为单位的静默时长</summary>
+			int64_t           OffTime        = 0;
+			/// <summary>以秒为单位的测试时长</summary>
+			int64_t           Duration       = 10;
+			/// <summary>以毫秒为单位的注册与连接超时时间</summary>
+			int64_t           ConnectTimeout = 10000;
+			/// <summary>是否经ClockSyncTransport发送并应答对端的时钟探测；须与接收端的ClockSync一致，经转发器时须与其Enable_Clock_Sync一致</summary>
+			bool              ClockSync      = false;
+		};
+
+
+		/// <summary>
+		/// 发送结果
+		/// </summary>
+		struct GeneratorReport
+		{
+			/// <summary>连接成功的客户端个数</summary>
+			std::size_t Connected = 0;
+			/// <summary>发送成功的数据包个数</summary>
+			uint64_t    Sent      = 0;
+			/// <summary>发送成功的字节数</summary>
+			uint64_t    Bytes     = 0;
+			/// <summary>发送失败的数据包个数</summary>
+			uint64_t    Failed    = 0;
+			/// <summary>以秒为单位的发送时长</summary>
+			double      Seconds   = 0.0;
+			/// <summary>数据包每秒</summary>
+			double      Pps       = 0.0;
+			/// <summary>兆比特每秒</summary>
+			double      Mbps      = 0.0;
+			/// <summary>晚于计划发送时刻超过容限的次数</summary>
+			uint64_t    Late      = 0;
+			/// <summary>以微秒为单位的平均发送延迟</summary>
+			double      AvgLag    = 0.0;
+			/// <summary>以微秒为单位的最大发送延迟</summary>
+			int64_t     MaxLag    = 0;
+		};
+
+
+		/// <summary>
+		/// 接收参数
+		/// </summary>
+		struct SinkOptions
+		{
+			/// <summary>打洞服务器地址</summary>
+			std::string Server   = "127.0.0.1";
+			/// <summary>打洞服务器端口</summary>
+			uint16_t    Port     = 10000;
+			/// <summary>首个客户端的序列号，第i个客户端为Local+i</summary>
+			uint64_t    Local    = 2000;
+			/// <summary>客户端个数</summary>
+			std::size_t Clients  = 1;
+			/// <summary>不为0时不创建客户端，改为在该UDP端口接收，用于测量经转发器输出的流量</summary>
+			uint16_t    UdpPort  = 0;
+			/// <summary>每个流的序号窗口长度，即容许的最大乱序距离</summary>
+			std::size_t Window   = 4096;
+			/// <summary>以秒为单位的测试时长</summary>
+			int64_t     Duration = 10;
+			/// <summary>
+			/// <para>以客户端接收时是否经ClockSyncTransport估计发送端的时钟偏差，并以此校正单向时延，须与发生器的ClockSync一致</para>
+			/// <para>启用时时钟同步完成前收到的数据包不计入时延；未启用或以UDP接收时直接以本地时钟计算，仅在同一主机或两端时钟已由外部同步时有效</para>
+			/// </summary>
+			bool        ClockSync = false;
+		};
+
+
+		/// <summary>
+		/// 接收结果
+		/// </summary>
+		struct SinkReport
+		{
+			/// <summary>收到数据的流个数</summary>
+			std::size_t Streams    = 0;
+			/// <summary>首次收到的数据包个数</summary>
+			uint64_t    Received   = 0;
+			/// <summary>收到的字节数</summary>
+			uint64_t    Bytes      = 0;
+			/// <summary>丢失的数据包个数，按各流首个序号到发送端结束标记所告知的数据包个数之间未收到的个数计，未收到结束标记时到收到的最大序号为止</summary>
+			uint64_t    Lost       = 0;
+			/// <summary>重复的数据包个数</summary>
+			uint64_t    Duplicates = 0;
+			/// <summary>乱序到达的数据包个数</summary>
+			uint64_t    Reordered  = 0;
+			/// <summary>不是测试数据包的数据报个数</summary>
+			uint64_t    Malformed  = 0;
+			/// <summary>以秒为单位的首末数据包之间的时长</summary>
+			double      Seconds    = 0.0;
+			/// <summary>数据包每秒</summary>
+			double      Pps        = 0.0;
+			/// <summary>兆比特每秒</summary>
+			double      Mbps       = 0.0;
+			/// <summary>以微秒为单位的单向时延中位数</summary>
+			int64_t     P50        = 0;
+			/// <summary>以微秒为单位的单向时延90分位数</summary>
+			int64_t     P90        = 0;
+			/// <summary>以微秒为单位的单向时延99分位数</summary>
+			int64_t     P99        = 0;
+			/// <summary>以微秒为单位的单向时延99.9分位数</summary>
+			int64_t     P999       = 0;
+			/// <summary>以微秒为单位的最大单向时延</summary>
+			int64_t     Max        = 0;
+			/// <summary>以微秒为单位的各客户端估计的发送端时钟偏差的平均值，即发送端时钟减去本地时钟，未启用ClockSync或未同步时为0</summary>
+			int64_t     Offset     = 0;
+		};
+
+
+		/// <summary>
+		/// <para>流量发生器</para>
+		/// <para>为每个客户端注册序列号并连接对端，再按设定的速率、包长分布与突发模式发送测试数据包，数据包头含流标识、序号与纳秒级发送时间</para>
+		/// <para>发送时刻由Scheduler按绝对截止时间调度，每个线程以最小堆管理其客户端的下一发送时刻；启用ClockSync时发送线程在等待发送时刻期间应答对端的时钟探测</para>
+		/// <para>测试结束后各流重复发送结束标记，告知接收端该流发出的数据包个数</para>
+		/// </summary>
+		class TrafficGenerator
+		{
+		private:
+
+			/// <summary>
+			/// 发送流
+			/// </summary>
+			struct __flow
+			{
+				/// <summary>客户端</summary>
+				std::unique_ptr<punch::Client>                 client;
+				/// <summary>客户端的传输层</summary>
+				std::unique_ptr<forwarder::ClientTransport>    link;
+				/// <summary>启用ClockSync时叠加在link之上的时钟同步层</summary>
+				std::unique_ptr<forwarder::ClockSyncTransport> sync;
+				/// <summary>发送所经的传输层，为sync或link</summary>
+				forwarder::Transport*                          out;
+				/// <summary>流标识</summary>
+				uint32_t                                       stream;
+				/// <summary>下一个序号，也是已发出的数据包个数</summary>
+				uint32_t                                       seq;
+				/// <summary>以纳秒为单位的下一发送时刻</summary>
+				int64_t                                        next;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="opts">发送参数</param>
+			explicit TrafficGenerator(const GeneratorOptions& opts);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			TrafficGenerator(const TrafficGenerator&) = delete;
+
+			/// <summary>
+			/// 连接并发送，阻塞直到测试时长结束
+			/// </summary>
+			/// <returns>发送结果</returns>
+			GeneratorReport Run();
+
+		private:
+
+			/// <summary>
+			/// 创建客户端并连接对端，未连接成功的客户端被关闭
+			/// </summary>
+			/// <returns>连接成功的客户端个数</returns>
+			std::size_t     _Connect();
+
+			/// <summary>
+			/// 发送线程
+			/// </summary>
+			/// <param name="flows">本线程负责的发送流</param>
+			/// <param name="start">以纳秒为单位的开始时刻</param>
+			/// <param name="end">以纳秒为单位的结束时刻</param>
+			void            _Send(std::vector<__flow*> flows, const int64_t start, const int64_t end);
+
+			/// <summary>
+			/// <para>等待到发送时刻之前持续应答各流的时钟探测</para>
+			/// <para>对端以应答中的收发时间估计偏差，探测在队列中等待的时间会使估计偏大约一半，因此不能只在发送时刻应答</para>
+			/// </summary>
+			/// <param name="flows">本线程负责的发送流</param>
+			/// <param name="deadline">以纳秒为单位的发送时刻</param>
+			void            _Serve(const std::vector<__flow*>& flows, const int64_t deadline);
+
+			/// <summary>
+			/// 各流发送结束标记
+			/// </summary>
+			void            _Finish();
+
+			/// <summary>
+			/// 按长度分布计算平均包长
+			/// </summary>
+			/// <returns>平均包长</returns>
+			double          _MeanSize() const noexcept;
+
+		private:
+
+			/// <summary>发送参数</summary>
+			GeneratorOptions    m_iOpts;
+			/// <summary>以纳秒为单位的发送时刻间隔</summary>
+			int64_t             m_nInterval;
+			/// <summary>发送流</summary>
+			std::vector<__flow> m_iFlows;
+			/// <summary>汇总各线程结果的互斥锁</summary>
+			std::mutex          m_iMutex;
+			/// <summary>发送结果</summary>
+			GeneratorReport     m_iReport;
+			/// <summary>以纳秒为单位的累计发送延迟</summary>
+			int64_t             m_nLagSum;
+			/// <summary>发送时刻的个数</summary>
+			uint64_t            m_uWaits;
+		};
+
+
+		/// <summary>
+		/// <para>流量接收端</para>
+		/// <para>以被动的客户端等待发生器连接，或直接在UDP端口接收经转发器输出的流量；按流标识以序号窗口统计丢包、重复与乱序，以发送时间统计单向时延</para>
+		/// <para>每个客户端由独立线程接收，各线程的统计在结束时合并；单向时延要求两端时钟已同步，以客户端接收时可由ClockSync在线估计发送端的时钟偏差</para>
+		/// </summary>
+		class TrafficSink
+		{
+		private:
+
+			/// <summary>
+			/// 接收流
+			/// </summary>
+			struct __stream
+			{
+				/// <summary>序号窗口</summary>
+				forwarder::SequenceWindow window;
+				/// <summary>首个序号</summary>
+				uint32_t                  first;
+				/// <summary>结束标记告知的数据包个数，未收到时为-1</summary>
+				int64_t                   count;
+			};
+
+			/// <summary>
+			/// 接收线程的统计
+			/// </summary>
+			struct __state
+			{
+				/// <summary>以流标识索引的接收流</summary>
+				std::unordered_map<uint32_t, __stream> streams;
+				/// <summary>以微秒为单位的时延直方图</summary>
+				Histogram                              latency;
+				/// <summary>收到的字节数</summary>
+				uint64_t                               bytes     = 0;
+				/// <summary>不是测试数据包的数据报个数</summary>
+				uint64_t                               malformed = 0;
+				/// <summary>以纳秒为单位的首个数据包到达时刻</summary>
+				int64_t                                first     = -1;
+				/// <summary>以纳秒为单位的最后一个数据包到达时刻</summary>
+				int64_t                                last      = -1;
+				/// <summary>时钟是否已同步</summary>
+				bool                                   synced    = false;
+				/// <summary>以纳秒为单位的最近估计的发送端时钟偏差</summary>
+				int64_t                                offset    = 0;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="opts">接收参数</param>
+			explicit TrafficSink(const SinkOptions& opts) : m_iOpts(opts) {}
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			TrafficSink(const TrafficSink&) = delete;
+
+			/// <summary>
+			/// 接收并统计，阻塞直到测试时长结束
+			/// </summary>
+			/// <returns>接收结果</returns>
+			SinkReport Run();
+
+		private:
+
+			/// <summary>
+			/// 以客户端接收的线程
+			/// </summary>
+			/// <param name="client">客户端</param>
+			/// <param name="state">本线程的统计</param>
+			/// <param name="deadline">以毫秒为单位的单调结束时间</param>
+			void       _ReceiveClient(punch::Client& client, __state& state, const int64_t deadline);
+
+			/// <summary>
+			/// 以UDP套接字接收
+			/// </summary>
+			/// <param name="state">统计</param>
+			/// <param name="deadline">以毫秒为单位的单调结束时间</param>
+			/// <returns>绑定端口失败返回false</returns>
+			bool       _ReceiveUdp(__state& state, const int64_t deadline);
+
+			/// <summary>
+			/// 统计一个数据报
+			/// </summary>
+			/// <param name="state">统计</param>
+			/// <param name="data">数据</param>
+			/// <param name="len">数据长度</param>
+			/// <param name="timed">是否计入时延，时钟同步完成前为false</param>
+			/// <param name="offset">以纳秒为单位的发送端时钟减去本地时钟的偏差</param>
+			void       _Input(__state& state, const char* const data, const std::size_t len, const bool timed, const int64_t offset);
+
+		private:
+
+			/// <summary>接收参数</summary>
+			const SinkOptions m_iOpts;
+		};
+
+	}
+
+}
+
+
+#endif // !__VSNC_GENERATOR_TRAFFIC_H__
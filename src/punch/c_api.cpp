@@ -0,0 +1,103 @@
+﻿/************************************************************************
+ * @ObjectName: c_api.cpp
+ * @Description: P2P客户端的C接口实现，编译进punch_dll动态库
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "c_api.h"
+
+
+#include "client.h"
+
+
+void __VSNC_PUNCH_CDECL vsnc_p2p_punch_default_options(vsnc_p2p_punch_options* opts)
+{
+	if (!opts) {
+		return;
+	}
+	vsnc::punch::ClientOptions def;
+	opts->timeout = def.Timeout;
+	opts->probe_interval = def.ProbeInterval;
+	opts->port_guesses = def.PortGuesses;
+	opts->parallel = def.Parallel;
+	opts->relay = def.Relay;
+	opts->resume = def.Resume;
+	opts->dont_fragment = def.DontFragment;
+	opts->max_datagram = static_cast<uint32_t>(def.MaxDatagram);
+	opts->max_message = static_cast<uint32_t>(def.MaxMessage);
+}
+
+
+vsnc_p2p_punch_handler __VSNC_PUNCH_CDECL vsnc_p2p_punch_create_handler(const uint64_t seqno, const char* srv_ip, const uint16_t srv_port,
+	const uint16_t port, const vsnc_p2p_punch_options* opts)
+{
+	if (!srv_ip) {
+		return nullptr;
+	}
+	vsnc::punch::ClientOptions client_opts;
+	if (opts) {
+		client_opts.Timeout = opts->timeout;
+		client_opts.ProbeInterval = opts->probe_interval;
+		client_opts.PortGuesses = opts->port_guesses;
+		client_opts.Parallel = (0 != opts->parallel);
+		client_opts.Relay = (0 != opts->relay);
+		client_opts.Resume = (0 != opts->resume);
+		client_opts.DontFragment = (0 != opts->dont_fragment);
+		client_opts.MaxDatagram = opts->max_datagram;
+		client_opts.MaxMessage = opts->max_message;
+	}
+	try {
+		return new vsnc::punch::Client(seqno, srv_ip, srv_port, port, client_opts);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+
+vsnc_p2p_punch_state __VSNC_PUNCH_CDECL vsnc_p2p_punch_get_state(const vsnc_p2p_punch_handler hdl)
+{
+	if (!hdl) {
+		return VSNC_P2P_PUNCH_OFFLINE;
+	}
+	return static_cast<vsnc_p2p_punch_state>(static_cast<const vsnc::punch::Client*>(hdl)->GetState());
+}
+
+
+void __VSNC_PUNCH_CDECL vsnc_p2p_punch_connect(vsnc_p2p_punch_handler hdl, const uint64_t seqno)
+{
+	if (hdl) {
+		static_cast<vsnc::punch::Client*>(hdl)->Connect(seqno);
+	}
+}
+
+
+ptrdiff_t __VSNC_PUNCH_CDECL vsnc_p2p_punch_send(const vsnc_p2p_punch_handler hdl, const char* const head, const size_t len, const int64_t ts)
+{
+	if (!hdl || !head) {
+		return -1;
+	}
+	vsnc::utils::BasicMemory<char> mem(const_cast<char*>(head), len);
+	return static_cast<vsnc::punch::Client*>(hdl)->Send(mem, ts);
+}
+
+
+ptrdiff_t __VSNC_PUNCH_CDECL vsnc_p2p_punch_receive(vsnc_p2p_punch_handler hdl, char* const head, const size_t len, int64_t* ts, const int64_t timeout)
+{
+	if (!hdl || !head) {
+		return -1;
+	}
+	vsnc::utils::BasicMemory<char> mem(head, len);
+	int64_t stamp = 0;
+	auto ret = static_cast<vsnc::punch::Client*>(hdl)->Receive(mem, stamp, timeout);
+	if ((ret >= 0) && ts) {
+		*ts = stamp;
+	}
+	return ret;
+}
+
+
+void __VSNC_PUNCH_CDECL vsnc_p2p_punch_destroy_handler(vsnc_p2p_punch_handler hdl)
+{
+	delete static_cast<vsnc::punch::Client*>(hdl);
+}
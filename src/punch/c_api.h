@@ -0,0 +1,149 @@
+﻿/************************************************************************
+ * @ObjectName: c_api.h
+ * @Description: P2P客户端的C接口，只依赖C标准头，可供C程序与其他语言经动态库调用
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_PUNCH_C_API_H__
+#define __VSNC_PUNCH_C_API_H__
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef _WIN32
+#if defined(VSNC_PUNCH_EXPORTS)
+#define __VSNC_PUNCH_PORT __declspec(dllexport)
+#elif defined(VSNC_PUNCH_STATIC)
+#define __VSNC_PUNCH_PORT
+#else
+#define __VSNC_PUNCH_PORT __declspec(dllimport)
+#endif // VSNC_PUNCH_EXPORTS
+#define __VSNC_PUNCH_CDECL __cdecl
+#else
+#define __VSNC_PUNCH_PORT __attribute__((visibility("default")))
+#define __VSNC_PUNCH_CDECL
+#endif // _WIN32
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+	/// <summary>
+	/// P2P客户端句柄
+	/// </summary>
+	typedef void* vsnc_p2p_punch_handler;
+
+	/// <summary>
+	/// 客户端状态，取值与vsnc::p2p::vsnc_p2p_state相同
+	/// </summary>
+	typedef enum vsnc_p2p_punch_state
+	{
+		/// <summary>离线</summary>
+		VSNC_P2P_PUNCH_OFFLINE    = -2,
+		/// <summary>在线但空闲</summary>
+		VSNC_P2P_PUNCH_FREE       =  0,
+		/// <summary>正在请求连接</summary>
+		VSNC_P2P_PUNCH_REQUESTING =  1,
+		/// <summary>正在建立连接</summary>
+		VSNC_P2P_PUNCH_CONNECTING =  2,
+		/// <summary>已连接</summary>
+		VSNC_P2P_PUNCH_CONNECTED  =  3
+	} vsnc_p2p_punch_state;
+
+	/// <summary>
+	/// 客户端参数，与vsnc::punch::ClientOptions对应
+	/// </summary>
+	typedef struct vsnc_p2p_punch_options
+	{
+		/// <summary>以毫秒为单位的每个连接阶段的超时时间</summary>
+		int64_t  timeout;
+		/// <summary>以毫秒为单位的打洞探测间隔</summary>
+		int64_t  probe_interval;
+		/// <summary>在对端公网端口之后依次预测的端口个数</summary>
+		int32_t  port_guesses;
+		/// <summary>非0时并行探测全部候选端点</summary>
+		int32_t  parallel;
+		/// <summary>非0时直连失败后经服务器中转</summary>
+		int32_t  relay;
+		/// <summary>非0时启用会话恢复</summary>
+		int32_t  resume;
+		/// <summary>非0时在套接字上设置不分片</summary>
+		int32_t  dont_fragment;
+		/// <summary>发送的单个数据报的最大长度，不含IP与UDP头</summary>
+		uint32_t max_datagram;
+		/// <summary>接收的单条消息的最大长度</summary>
+		uint32_t max_message;
+	} vsnc_p2p_punch_options;
+
+	/// <summary>
+	/// 以默认值填写客户端参数
+	/// </summary>
+	/// <param name="opts">客户端参数</param>
+	__VSNC_PUNCH_PORT void                   __VSNC_PUNCH_CDECL vsnc_p2p_punch_default_options(vsnc_p2p_punch_options* opts);
+
+	/// <summary>
+	/// <para>创建P2P客户端句柄，参数与vsnc_p2p_create_handler相同</para>
+	/// <para>程序结束时需调用vsnc_p2p_punch_destroy_handler函数释放该句柄</para>
+	/// </summary>
+	/// <param name="seqno">客户端序列号</param>
+	/// <param name="srv_ip">服务器IP</param>
+	/// <param name="srv_port">服务器端口</param>
+	/// <param name="port">监听的端口号</param>
+	/// <param name="opts">客户端参数，为NULL时使用默认值</param>
+	/// <returns>创建好的P2P客户端句柄，失败返回NULL</returns>
+	__VSNC_PUNCH_PORT vsnc_p2p_punch_handler __VSNC_PUNCH_CDECL vsnc_p2p_punch_create_handler(const uint64_t seqno, const char* srv_ip,
+		const uint16_t srv_port, const uint16_t port, const vsnc_p2p_punch_options* opts);
+
+	/// <summary>
+	/// 获取P2P客户端状态
+	/// </summary>
+	/// <param name="hdl">P2P客户端句柄</param>
+	/// <returns>P2P客户端的状态</returns>
+	__VSNC_PUNCH_PORT vsnc_p2p_punch_state   __VSNC_PUNCH_CDECL vsnc_p2p_punch_get_state(const vsnc_p2p_punch_handler hdl);
+
+	/// <summary>
+	/// 向指定终端发起连接，超时与重试按创建句柄时的参数
+	/// </summary>
+	/// <param name="hdl">P2P客户端句柄</param>
+	/// <param name="seqno">对端序列号</param>
+	__VSNC_PUNCH_PORT void                   __VSNC_PUNCH_CDECL vsnc_p2p_punch_connect(vsnc_p2p_punch_handler hdl, const uint64_t seqno);
+
+	/// <summary>
+	/// 发送数据
+	/// </summary>
+	/// <param name="hdl">P2P客户端句柄</param>
+	/// <param name="head">数据头指针</param>
+	/// <param name="len">数据长度</param>
+	/// <param name="ts">时间戳</param>
+	/// <returns>成功返回发送的字节数，失败返回-1</returns>
+	__VSNC_PUNCH_PORT ptrdiff_t              __VSNC_PUNCH_CDECL vsnc_p2p_punch_send(const vsnc_p2p_punch_handler hdl, const char* const head,
+		const size_t len, const int64_t ts);
+
+	/// <summary>
+	/// 接收数据
+	/// </summary>
+	/// <param name="hdl">P2P客户端句柄</param>
+	/// <param name="head">数据缓存区头指针</param>
+	/// <param name="len">数据缓存区长度</param>
+	/// <param name="ts">时间戳</param>
+	/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+	/// <returns>成功返回接收到的字节数，已关闭返回-1，超时返回-2</returns>
+	__VSNC_PUNCH_PORT ptrdiff_t              __VSNC_PUNCH_CDECL vsnc_p2p_punch_receive(vsnc_p2p_punch_handler hdl, char* const head,
+		const size_t len, int64_t* ts, const int64_t timeout);
+
+	/// <summary>
+	/// 释放句柄资源
+	/// </summary>
+	/// <param name="hdl">待释放的句柄</param>
+	__VSNC_PUNCH_PORT void                   __VSNC_PUNCH_CDECL vsnc_p2p_punch_destroy_handler(vsnc_p2p_punch_handler hdl);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+
+#endif // !__VSNC_PUNCH_C_API_H__
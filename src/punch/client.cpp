@@ -0,0 +1,826 @@
+﻿/************************************************************************
+ * @ObjectName: client.cpp
+ * @Description: 与p2p.dll协议兼容的P2P客户端，支持以缓存的对端端点快速重连
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "client.h"
+
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+#ifdef _WIN32
+#include <mstcpip.h>
+#else
+#include <poll.h>
+#endif // _WIN32
+
+
+#include <vsnc_utils/utils.h>
+
+
+namespace
+{
+	/// <summary>以毫秒为单位的后台线程最长等待时间，决定Close的响应时间</summary>
+	constexpr int64_t     Max_Wait      = 10;
+	/// <summary>每次就绪后最多连续接收的数据报个数</summary>
+	constexpr int         Recv_Batch    = 64;
+	/// <summary>保留待复用的消息缓冲区个数</summary>
+	constexpr std::size_t Spare_Buffers = 64;
+
+	uint64_t packEndpoint(const vsnc::punch::Endpoint& ep) noexcept
+	{
+		return (static_cast<uint64_t>(ep.Ip) << 16) | ep.Port;
+	}
+
+	/// <summary>
+	/// 等待套接字可读，以poll代替select，不受FD_SETSIZE限制
+	/// </summary>
+	/// <returns>可读返回true</returns>
+	bool waitReadable(const int sock, const int64_t ms) noexcept
+	{
+#ifdef _WIN32
+		WSAPOLLFD fd = {};
+		fd.fd = static_cast<SOCKET>(sock);
+		fd.events = POLLRDNORM;
+		return WSAPoll(&fd, 1, static_cast<INT>(ms)) > 0;
+#else
+		pollfd fd = {};
+		fd.fd = sock;
+		fd.events = POLLIN;
+		return poll(&fd, 1, static_cast<int>(ms)) > 0;
+#endif // _WIN32
+	}
+
+	vsnc::punch::Endpoint unpackEndpoint(const uint64_t v) noexcept
+	{
+		vsnc::punch::Endpoint ep;
+		ep.Ip = static_cast<uint32_t>(v >> 16);
+		ep.Port = static_cast<uint16_t>(v);
+		return ep;
+	}
+
+	bool isPunching(const vsnc::p2p::vsnc_p2p_state state) noexcept
+	{
+		return (vsnc::p2p::vsnc_p2p_state::REQUESTING == state) || (vsnc::p2p::vsnc_p2p_state::CONNECTING == state);
+	}
+}
+
+
+vsnc::punch::Client::Client(const uint64_t seqno, const std::string& srv_ip, const uint16_t srv_port, const uint16_t port,
+	const ClientOptions& opts) :
+	m_uSeqno(seqno),
+	m_iOpts(opts),
+	m_uMaxChunk((std::max)((std::min)(opts.MaxDatagram, Max_Datagram), Data_Header_Len + 1) - Data_Header_Len),
+	m_nSock(-1),
+	m_bRun(false),
+	m_nNextPump(0),
+	m_eState(p2p::vsnc_p2p_state::OFFLINE),
+	m_bResumed(false),
+	m_uLink(0),
+	m_uLinkAddr(0),
+	m_nOffset(0),
+	m_uConn(static_cast<uint8_t>(conn_type::INTRANET)),
+	m_uMessageId(0),
+	m_uPeer(0),
+	m_bRetry(false),
+	m_nStart(0),
+	m_nPeerHeard(0),
+	m_nPeerTs(INT64_MIN),
+	m_nServerHeard(0),
+	m_nAckTs(INT64_MIN),
+	m_nNextServer(0),
+	m_nNextProbe(0),
+	m_uCachedPeer(0),
+	m_uPartialId(0),
+	m_bPartial(false),
+	m_bDiscard(false),
+	m_uSentPackets(0),
+	m_uRecvPackets(0),
+	m_uSentBytes(0),
+	m_uRecvBytes(0),
+	m_uDropped(0)
+{
+	in_addr addr;
+	if (inet_pton(AF_INET, srv_ip.c_str(), &addr) != 1) {
+		return;
+	}
+	m_iServer.Ip = addr.s_addr;
+	m_iServer.Port = srv_port;
+	m_nSock = static_cast<int>(socket(AF_INET, SOCK_DGRAM, 0));
+	if (-1 == m_nSock) {
+		return;
+	}
+	sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_port = htons(port);
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(m_nSock, reinterpret_cast<sockaddr*>(&local), sizeof(local)) == -1) {
+		closesocket(m_nSock);
+		m_nSock = -1;
+		return;
+	}
+	u_long nonblocking = 1;
+	ioctlsocket(m_nSock, FIONBIO, &nonblocking);
+	if (m_iOpts.DontFragment) {
+#if defined(IP_DONTFRAGMENT)
+		int df = 1;
+		setsockopt(m_nSock, IPPROTO_IP, IP_DONTFRAGMENT, reinterpret_cast<const char*>(&df), sizeof(df));
+#elif defined(IP_MTU_DISCOVER)
+		int df = IP_PMTUDISC_DO;
+		setsockopt(m_nSock, IPPROTO_IP, IP_MTU_DISCOVER, reinterpret_cast<const char*>(&df), sizeof(df));
+#endif // IP_DONTFRAGMENT
+	}
+#ifdef SIO_UDP_CONNRESET
+	// 对端端口不可达的ICMP会使下一次recvfrom失败，打洞时这很常见
+	BOOL reset = FALSE;
+	DWORD bytes = 0;
+	WSAIoctl(m_nSock, SIO_UDP_CONNRESET, &reset, sizeof(reset), nullptr, 0, &bytes, nullptr, nullptr);
+#endif // SIO_UDP_CONNRESET
+	socklen_t len = sizeof(local);
+	getsockname(m_nSock, reinterpret_cast<sockaddr*>(&local), &len);
+	m_iIntranet.Port = ntohs(local.sin_port);
+	// 以连接到服务器的临时套接字获取出口网卡的地址作为内网地址
+	auto probe = static_cast<int>(socket(AF_INET, SOCK_DGRAM, 0));
+	if (-1 != probe) {
+		sockaddr_in srv;
+		memset(&srv, 0, sizeof(srv));
+		srv.sin_family = AF_INET;
+		srv.sin_port = htons(srv_port);
+		srv.sin_addr.s_addr = m_iServer.Ip;
+		sockaddr_in self;
+		len = sizeof(self);
+		if ((connect(probe, reinterpret_cast<sockaddr*>(&srv), sizeof(srv)) == 0) &&
+			(getsockname(probe, reinterpret_cast<sockaddr*>(&self), &len) == 0)) {
+			m_iIntranet.Ip = self.sin_addr.s_addr;
+		}
+		closesocket(probe);
+	}
+	if (m_iOpts.Intranet.Valid()) {
+		m_iIntranet = m_iOpts.Intranet;
+	}
+	m_bRun = true;
+	if (m_iOpts.Thread) {
+		m_iThread = std::thread(&Client::_Work, this);
+	}
+}
+
+
+vsnc::punch::Client::~Client() noexcept
+{
+	Close();
+}
+
+
+void vsnc::punch::Client::Connect(const uint64_t seqno) noexcept
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	auto state = m_eState.load(std::memory_order_relaxed);
+	if (!m_bRun || (p2p::vsnc_p2p_state::OFFLINE == state) || (0 == seqno) || (m_uSeqno == seqno)) {
+		return;
+	}
+	if (p2p::vsnc_p2p_state::FREE != state) {
+		_Free(p2p::vsnc_p2p_state::CONNECTED == state);
+	}
+	auto now = utils::__steady();
+	m_uPeer = seqno;
+	// 并行探测时以公网方式请求，对端收到的事件中带有双方的全部端点
+	m_uConn = static_cast<uint8_t>(m_iOpts.Parallel ? conn_type::EXTERNAL : conn_type::INTRANET);
+	m_bRetry = true;
+	m_nStart = now;
+	m_nPeerTs = INT64_MIN;
+	m_iCandidates.clear();
+	if (m_iOpts.Resume && (seqno == m_uCachedPeer) && m_iCachedEp.Valid()) {
+		m_iCandidates.push_back(m_iCachedEp);
+	}
+	m_eState = p2p::vsnc_p2p_state::REQUESTING;
+	// 立即发出连接请求与恢复探测，不等后台线程的下一次定时
+	m_nNextServer = now;
+	m_nNextProbe = now;
+	_Tick(now);
+}
+
+
+void vsnc::punch::Client::Close() noexcept
+{
+	if (!m_bRun.exchange(false)) {
+		return;
+	}
+	if (m_iThread.joinable()) {
+		m_iThread.join();
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		if (p2p::vsnc_p2p_state::OFFLINE != m_eState) {
+			_Free(true);
+			Message msg;
+			_Header(msg, message_type::BYE);
+			msg.SentPackets = m_uSentPackets;
+			msg.RecvPackets = m_uRecvPackets;
+			_Send(msg, m_iServer);
+		}
+		m_eState = p2p::vsnc_p2p_state::OFFLINE;
+	}
+	closesocket(m_nSock);
+	m_nSock = -1;
+	{
+		// 持锁通知，以免Receive在检查m_bRun之后、等待之前错过通知
+		std::lock_guard<std::mutex> lock(m_iQueueMutex);
+	}
+	m_iQueueCond.notify_all();
+}
+
+
+ssize_t vsnc::punch::Client::Send(const utils::Memory<char>& mem, const int64_t ts) noexcept
+{
+	if (p2p::vsnc_p2p_state::CONNECTED != m_eState.load(std::memory_order_acquire)) {
+		return -1;
+	}
+	auto to = unpackEndpoint(m_uLinkAddr.load(std::memory_order_acquire));
+	Message msg;
+	_Header(msg, message_type::DATA);
+	msg.Peer = m_uLink.load(std::memory_order_acquire);
+	msg.UserTs = ts;
+	msg.MessageId = m_uMessageId.fetch_add(1, std::memory_order_relaxed) + 1;
+	char buf[Max_Datagram];
+	std::size_t offset = 0;
+	do {
+		auto chunk = (std::min)(mem.Length() - offset, m_uMaxChunk);
+		msg.Payload = mem.Data() + offset;
+		msg.PayloadLen = chunk;
+		msg.Last = (offset + chunk == mem.Length());
+		if (!_SendTo(buf, __encode(msg, buf), to)) {
+			return -1;
+		}
+		offset += chunk;
+	} while (offset < mem.Length());
+	return static_cast<ssize_t>(mem.Length());
+}
+
+
+ssize_t vsnc::punch::Client::Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout) noexcept
+{
+	if (!m_iOpts.Thread) {
+		// 没有后台线程，队列为空时才自行驱动，持续收包时每一批数据报只驱动一次
+		auto start = utils::__steady();
+		auto pumped = false;
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lock(m_iQueueMutex);
+				auto ret = _Pop(mem, ts);
+				if (ret >= 0) {
+					return ret;
+				}
+			}
+			if (pumped) {
+				auto now = utils::__steady();
+				if ((timeout >= 0) && (now - start >= timeout)) {
+					return -2;
+				}
+				auto wait = (std::max)(m_nNextPump.load(std::memory_order_relaxed) - now, static_cast<int64_t>(0));
+				if (timeout >= 0) {
+					wait = (std::min)(wait, start + timeout - now);
+				}
+				waitReadable(m_nSock, wait);
+			}
+			if (Pump() < 0) {
+				return -1;
+			}
+			pumped = true;
+		}
+	}
+	std::unique_lock<std::mutex> lock(m_iQueueMutex);
+	auto ready = [this]() { return !m_iQueue.empty() || !m_bRun; };
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds((std::max)(timeout, static_cast<int64_t>(0)));
+	while (true) {
+		if (timeout < 0) {
+			m_iQueueCond.wait(lock, ready);
+		}
+		else if (!m_iQueueCond.wait_until(lock, deadline, ready)) {
+			return -2;
+		}
+		if (m_iQueue.empty()) {
+			return -1;
+		}
+		auto ret = _Pop(mem, ts);
+		if (ret >= 0) {
+			return ret;
+		}
+	}
+}
+
+
+int64_t vsnc::punch::Client::Pump() noexcept
+{
+	if (m_iOpts.Thread || !m_bRun.load(std::memory_order_relaxed)) {
+		return -1;
+	}
+	_Drain();
+	int64_t wait = 0;
+	auto now = utils::__steady();
+	{
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		wait = _Tick(now);
+	}
+	auto next = now + (std::max)(wait, static_cast<int64_t>(0));
+	m_nNextPump.store(next, std::memory_order_relaxed);
+	return next;
+}
+
+
+int vsnc::punch::Client::Handle(int64_t& next) const noexcept
+{
+	if (m_iOpts.Thread || !m_bRun.load(std::memory_order_relaxed)) {
+		return -1;
+	}
+	next = m_nNextPump.load(std::memory_order_relaxed);
+	return m_nSock;
+}
+
+
+vsnc::punch::Endpoint vsnc::punch::Client::PeerEndpoint() const
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	return m_iPeerEp;
+}
+
+
+void vsnc::punch::Client::Cache(const uint64_t seqno, const Endpoint& ep)
+{
+	std::lock_guard<std::mutex> lock(m_iMutex);
+	m_uCachedPeer = seqno;
+	m_iCachedEp = ep;
+}
+
+
+vsnc::punch::ClientStats vsnc::punch::Client::GetStats() const noexcept
+{
+	ClientStats stats;
+	stats.SentPackets = m_uSentPackets.load(std::memory_order_relaxed);
+	stats.RecvPackets = m_uRecvPackets.load(std::memory_order_relaxed);
+	stats.SentBytes = m_uSentBytes.load(std::memory_order_relaxed);
+	stats.RecvBytes = m_uRecvBytes.load(std::memory_order_relaxed);
+	stats.Dropped = m_uDropped.load(std::memory_order_relaxed);
+	return stats;
+}
+
+
+void vsnc::punch::Client::_Work()
+{
+	while (m_bRun.load(std::memory_order_relaxed)) {
+		int64_t wait = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_iMutex);
+			wait = _Tick(utils::__steady());
+		}
+		wait = (std::max)((std::min)(wait, Max_Wait), static_cast<int64_t>(0));
+		if (waitReadable(m_nSock, wait)) {
+			_Drain();
+		}
+	}
+}
+
+
+void vsnc::punch::Client::_Drain() noexcept
+{
+	char buf[Max_Datagram];
+	for (int i = 0; i < Recv_Batch; ++i) {
+		sockaddr_in from;
+		socklen_t len = sizeof(from);
+		auto ret = recvfrom(m_nSock, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &len);
+		if (ret <= 0) {
+			break;
+		}
+		m_uRecvPackets.fetch_add(1, std::memory_order_relaxed);
+		m_uRecvBytes.fetch_add(static_cast<uint64_t>(ret), std::memory_order_relaxed);
+		Message msg;
+		if (!__decode(buf, static_cast<std::size_t>(ret), msg) || (m_uSeqno == msg.Seqno)) {
+			continue;
+		}
+		if (message_type::DATA == msg.Type) {
+			// 数据只在CONNECTED时来自对端，走无锁的快速路径
+			if ((p2p::vsnc_p2p_state::CONNECTED == m_eState.load(std::memory_order_acquire)) &&
+				(msg.Seqno == m_uLink.load(std::memory_order_acquire)) && (msg.Peer == m_uSeqno)) {
+				_Data(msg);
+			}
+			continue;
+		}
+		Endpoint src;
+		src.Ip = from.sin_addr.s_addr;
+		src.Port = ntohs(from.sin_port);
+		std::lock_guard<std::mutex> lock(m_iMutex);
+		_Handle(msg, src, utils::__steady());
+	}
+}
+
+
+int64_t vsnc::punch::Client::_Tick(const int64_t now)
+{
+	auto state = m_eState.load(std::memory_order_relaxed);
+	if (p2p::vsnc_p2p_state::OFFLINE == state) {
+		if (now >= m_nNextServer) {
+			Message msg;
+			_Header(msg, message_type::REGISTER);
+			msg.Intranet = m_iIntranet;
+			_Send(msg, m_iServer);
+			m_nNextServer = now + Heartbeat_Interval;
+		}
+		return m_nNextServer - now;
+	}
+	if (now - m_nServerHeard > Server_Timeout) {
+		Message msg;
+		_Header(msg, message_type::BYE);
+		msg.SentPackets = m_uSentPackets;
+		msg.RecvPackets = m_uRecvPackets;
+		_Send(msg, m_iServer);
+		_Offline();
+		return 0;
+	}
+	uint8_t conn = 0;
+	if (isPunching(state) && (now - m_nStart > m_iOpts.Timeout)) {
+		// 主动发起的连接进入下一阶段，均失败后回到FREE
+		if (m_bRetry && (p2p::vsnc_p2p_state::CONNECTING == state) && _Next(conn)) {
+			m_uConn = conn;
+			m_nStart = now;
+			m_nNextServer = now;
+			m_iCandidates.clear();
+			m_eState = p2p::vsnc_p2p_state::REQUESTING;
+		}
+		else {
+			_Free(false);
+		}
+	}
+	else if ((p2p::vsnc_p2p_state::CONNECTED == state) && (now - m_nPeerHeard > Connect_Timeout)) {
+		_Free(true);
+	}
+	state = m_eState.load(std::memory_order_relaxed);
+	if (now >= m_nNextServer) {
+		Message msg;
+		if (p2p::vsnc_p2p_state::REQUESTING == state) {
+			_Header(msg, message_type::CONNECT);
+			msg.Peer = m_uPeer;
+		}
+		else {
+			_Header(msg, message_type::HEARTBEAT);
+			msg.Peer = (p2p::vsnc_p2p_state::FREE == state) ? 0 : m_uPeer;
+			msg.SentPackets = m_uSentPackets;
+			msg.RecvPackets = m_uRecvPackets;
+			msg.SentBytes = m_uSentBytes;
+			msg.RecvBytes = m_uRecvBytes;
+			msg.Intranet = m_iIntranet;
+		}
+		_Send(msg, m_iServer);
+		m_nNextServer = now + Heartbeat_Interval;
+	}
+	auto next = m_nNextServer - now;
+	if (isPunching(state) && !m_iCandidates.empty()) {
+		if (now >= m_nNextProbe) {
+			_Probe();
+			m_nNextProbe = now + m_iOpts.ProbeInterval;
+		}
+		next = (std::min)(next, m_nNextProbe - now);
+	}
+	else if (p2p::vsnc_p2p_state::CONNECTED == state) {
+		if (now >= m_nNextProbe) {
+			_Probe();
+			m_nNextProbe = now + Heartbeat_Interval;
+		}
+		next = (std::min)(next, m_nNextProbe - now);
+	}
+	return next;
+}
+
+
+void vsnc::punch::Client::_Handle(const Message& msg, const Endpoint& from, const int64_t now)
+{
+	auto state = m_eState.load(std::memory_order_relaxed);
+	if (0 != msg.Seqno) {
+		if (message_type::HEARTBEAT == msg.Type) {
+			_Heartbeat(msg, from, now);
+		}
+		else if ((message_type::BYE == msg.Type) && (msg.Seqno == m_uPeer) && (msg.Peer == m_uSeqno) &&
+			((p2p::vsnc_p2p_state::CONNECTING == state) || (p2p::vsnc_p2p_state::CONNECTED == state))) {
+			_Free(false);
+		}
+		return;
+	}
+	if (from != m_iServer) {
+		return;
+	}
+	m_nServerHeard = now;
+	switch (msg.Type)
+	{
+	case message_type::ACK:
+		if (msg.Ts < m_nAckTs) {
+			return;
+		}
+		m_nAckTs = msg.Ts;
+		if (State_Unknown == msg.State) {
+			// 服务器已删除本端的注册，重新注册
+			_Offline();
+		}
+		else if ((State_Conflict != msg.State) && (p2p::vsnc_p2p_state::OFFLINE == state)) {
+			// 回显的时间戳含发送时的校正量，先还原为本地时间
+			m_nOffset = msg.ServerTime - (msg.Ts - m_nOffset.load(std::memory_order_relaxed));
+			m_nNextServer = now + Heartbeat_Interval;
+			m_eState = p2p::vsnc_p2p_state::FREE;
+		}
+		break;
+	case message_type::BYE:
+		_Offline();
+		break;
+	case message_type::EVENT:
+	{
+		if ((p2p::vsnc_p2p_state::OFFLINE == state) || (m_uSeqno == msg.Peer)) {
+			return;
+		}
+		if ((p2p::vsnc_p2p_state::FREE != state) && !(isPunching(state) && (msg.Peer == m_uPeer))) {
+			return;
+		}
+		if (p2p::vsnc_p2p_state::FREE == state) {
+			// 被动方不重试，由发起方改变连接方式后服务器再次下发事件
+			m_bRetry = false;
+		}
+		m_uPeer = msg.Peer;
+		m_uConn = static_cast<uint8_t>(msg.Conn);
+		_Candidates(msg);
+		m_nStart = now;
+		m_nPeerTs = INT64_MIN;
+		m_eState = p2p::vsnc_p2p_state::CONNECTING;
+		_Probe();
+		m_nNextProbe = now + m_iOpts.ProbeInterval;
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+
+void vsnc::punch::Client::_Heartbeat(const Message& msg, const Endpoint& from, const int64_t now)
+{
+	if (msg.Peer != m_uSeqno) {
+		return;
+	}
+	auto state = m_eState.load(std::memory_order_relaxed);
+	auto expected = (msg.Seqno == m_uPeer) && (isPunching(state) || (p2p::vsnc_p2p_state::CONNECTED == state));
+	auto resumed = (p2p::vsnc_p2p_state::FREE == state) && m_iOpts.Resume && (msg.Seqno == m_uCachedPeer);
+	if ((!expected && !resumed) || (msg.Ts < m_nPeerTs)) {
+		return;
+	}
+	m_nPeerTs = msg.Ts;
+	m_nPeerHeard = now;
+	m_uConn = (std::max)(m_uConn.load(std::memory_order_relaxed), static_cast<uint8_t>(msg.Conn));
+	if (p2p::vsnc_p2p_state::CONNECTED == state) {
+		// 对端的NAT映射变化后跟随其新端点
+		if (from != m_iPeerEp) {
+			m_iPeerEp = from;
+			m_uLinkAddr.store(packEndpoint(from), std::memory_order_release);
+		}
+		return;
+	}
+	if (resumed) {
+		m_uPeer = msg.Seqno;
+		m_bRetry = false;
+	}
+	// 尚未收到服务器下发的事件即已连通，说明是经缓存的端点恢复的
+	m_bResumed = (p2p::vsnc_p2p_state::CONNECTING != state);
+	_Connected(from, now);
+}
+
+
+ssize_t vsnc::punch::Client::_Pop(utils::Memory<char>& mem, int64_t& ts)
+{
+	while (!m_iQueue.empty()) {
+		auto& front = m_iQueue.front();
+		ssize_t ret = -1;
+		if (front.data.size() <= mem.Length()) {
+			memcpy(mem.Data(), front.data.data(), front.data.size());
+			ts = front.ts;
+			ret = static_cast<ssize_t>(front.data.size());
+		}
+		else {
+			// 超出接收缓冲区的消息丢弃并计数，而不是返回-1使调用者误以为连接已关闭
+			m_uDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (m_iSpare.size() < Spare_Buffers) {
+			m_iSpare.push_back(std::move(front.data));
+		}
+		m_iQueue.pop_front();
+		if (ret >= 0) {
+			return ret;
+		}
+	}
+	return -2;
+}
+
+
+void vsnc::punch::Client::_Data(const Message& msg)
+{
+	if (msg.Last && !m_bPartial) {
+		std::lock_guard<std::mutex> lock(m_iQueueMutex);
+		if ((m_iQueue.size() >= Queue_Limit) || (msg.PayloadLen > m_iOpts.MaxMessage)) {
+			m_uDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		__message whole;
+		if (!m_iSpare.empty()) {
+			whole.data.swap(m_iSpare.back());
+			m_iSpare.pop_back();
+		}
+		whole.data.assign(msg.Payload, msg.Payload + msg.PayloadLen);
+		whole.ts = msg.UserTs;
+		m_iQueue.push_back(std::move(whole));
+		m_iQueueCond.notify_one();
+		return;
+	}
+	if (m_bPartial && (msg.MessageId != m_uPartialId)) {
+		// 上一条消息的后续分片丢失，已因超长丢弃的消息不重复计数
+		if (!m_bDiscard) {
+			m_uDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		m_bPartial = false;
+	}
+	if (!m_bPartial) {
+		m_bPartial = true;
+		m_bDiscard = false;
+		m_uPartialId = msg.MessageId;
+		m_iPartial.data.clear();
+	}
+	if (!m_bDiscard && (m_iPartial.data.size() + msg.PayloadLen > m_iOpts.MaxMessage)) {
+		// 超长的消息整条丢弃，其余分片直接忽略，重组缓冲区不再增长
+		m_uDropped.fetch_add(1, std::memory_order_relaxed);
+		m_bDiscard = true;
+		m_iPartial = __message();
+	}
+	if (m_bDiscard) {
+		m_bPartial = !msg.Last;
+		return;
+	}
+	m_iPartial.data.insert(m_iPartial.data.end(), msg.Payload, msg.Payload + msg.PayloadLen);
+	m_iPartial.ts = msg.UserTs;
+	if (!msg.Last) {
+		return;
+	}
+	m_bPartial = false;
+	std::lock_guard<std::mutex> lock(m_iQueueMutex);
+	if (m_iQueue.size() >= Queue_Limit) {
+		m_uDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	m_iQueue.push_back(std::move(m_iPartial));
+	m_iPartial = __message();
+	m_iQueueCond.notify_one();
+}
+
+
+void vsnc::punch::Client::_Free(const bool bye)
+{
+	if (bye && (p2p::vsnc_p2p_state::CONNECTED == m_eState.load(std::memory_order_relaxed))) {
+		Message msg;
+		_Header(msg, message_type::BYE);
+		msg.Peer = m_uPeer;
+		msg.SentPackets = m_uSentPackets;
+		msg.RecvPackets = m_uRecvPackets;
+		_Send(msg, m_iPeerEp);
+	}
+	m_eState = p2p::vsnc_p2p_state::FREE;
+	m_uLink.store(0, std::memory_order_release);
+	m_uLinkAddr.store(0, std::memory_order_release);
+	m_uConn = static_cast<uint8_t>(conn_type::INTRANET);
+	m_bRetry = false;
+	m_bResumed = false;
+	m_nPeerTs = INT64_MIN;
+	m_iCandidates.clear();
+}
+
+
+void vsnc::punch::Client::_Offline()
+{
+	_Free(true);
+	m_eState = p2p::vsnc_p2p_state::OFFLINE;
+	m_nNextServer = 0;
+}
+
+
+void vsnc::punch::Client::_Connected(const Endpoint& from, const int64_t now)
+{
+	m_iPeerEp = from;
+	if (static_cast<uint8_t>(conn_type::RELAY) != m_uConn) {
+		// 中转的端点是服务器，恢复时没有意义
+		m_uCachedPeer = m_uPeer;
+		m_iCachedEp = from;
+	}
+	m_iCandidates.clear();
+	m_uLink.store(m_uPeer, std::memory_order_release);
+	m_uLinkAddr.store(packEndpoint(from), std::memory_order_release);
+	m_eState.store(p2p::vsnc_p2p_state::CONNECTED, std::memory_order_release);
+	// 立即回复心跳，对端不必等到下一次探测即可确认连通
+	_Probe();
+	m_nNextProbe = now + Heartbeat_Interval;
+}
+
+
+void vsnc::punch::Client::_Probe()
+{
+	Message msg;
+	_Header(msg, message_type::HEARTBEAT);
+	msg.Peer = m_uPeer;
+	msg.SentPackets = m_uSentPackets;
+	msg.RecvPackets = m_uRecvPackets;
+	msg.SentBytes = m_uSentBytes;
+	msg.RecvBytes = m_uRecvBytes;
+	msg.Intranet = m_iIntranet;
+	if (p2p::vsnc_p2p_state::CONNECTED == m_eState.load(std::memory_order_relaxed)) {
+		_Send(msg, m_iPeerEp);
+		return;
+	}
+	for (auto& ep : m_iCandidates) {
+		_Send(msg, ep);
+	}
+}
+
+
+void vsnc::punch::Client::_Candidates(const Message& msg)
+{
+	m_iCandidates.clear();
+	auto add = [this](const Endpoint& ep) {
+		if (ep.Valid() && (std::find(m_iCandidates.begin(), m_iCandidates.end(), ep) == m_iCandidates.end())) {
+			m_iCandidates.push_back(ep);
+		}
+	};
+	if (conn_type::RELAY == msg.Conn) {
+		add(m_iServer);
+		return;
+	}
+	if (m_iOpts.Parallel || (conn_type::INTRANET == msg.Conn)) {
+		add(msg.Intranet);
+	}
+	if (m_iOpts.Parallel || (conn_type::EXTERNAL == msg.Conn)) {
+		add(msg.External);
+		// 按顺序分配端口的对称NAT为本端新开的映射通常紧随服务器看到的端口
+		for (int i = 1; (i <= m_iOpts.PortGuesses) && (msg.External.Port + i <= UINT16_MAX); ++i) {
+			auto guess = msg.External;
+			guess.Port = static_cast<uint16_t>(msg.External.Port + i);
+			add(guess);
+		}
+	}
+	if (m_iOpts.Resume && (msg.Peer == m_uCachedPeer)) {
+		add(m_iCachedEp);
+	}
+}
+
+
+bool vsnc::punch::Client::_Next(uint8_t& conn) const noexcept
+{
+	auto cur = static_cast<conn_type>(m_uConn.load(std::memory_order_relaxed));
+	if (!m_iOpts.Parallel && (conn_type::INTRANET == cur)) {
+		conn = static_cast<uint8_t>(conn_type::EXTERNAL);
+		return true;
+	}
+	if (m_iOpts.Relay && (conn_type::RELAY != cur)) {
+		conn = static_cast<uint8_t>(conn_type::RELAY);
+		return true;
+	}
+	return false;
+}
+
+
+void vsnc::punch::Client::_Header(Message& msg, const message_type type) const noexcept
+{
+	msg.Seqno = m_uSeqno;
+	msg.Type = type;
+	msg.State = static_cast<uint8_t>(m_eState.load(std::memory_order_relaxed));
+	msg.Conn = static_cast<conn_type>(m_uConn.load(std::memory_order_relaxed));
+	msg.Ts = utils::__utc() + m_nOffset.load(std::memory_order_relaxed);
+}
+
+
+void vsnc::punch::Client::_Send(const Message& msg, const Endpoint& to) noexcept
+{
+	char buf[Max_Control_Len];
+	_SendTo(buf, __encode(msg, buf), to);
+}
+
+
+bool vsnc::punch::Client::_SendTo(const char* const buf, const std::size_t len, const Endpoint& to) noexcept
+{
+	if (!len || !to.Valid()) {
+		return false;
+	}
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = to.Ip;
+	addr.sin_port = htons(to.Port);
+	if (sendto(m_nSock, buf, static_cast<int>(len), 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+		return false;
+	}
+	m_uSentPackets.fetch_add(1, std::memory_order_relaxed);
+	m_uSentBytes.fetch_add(len, std::memory_order_relaxed);
+	return true;
+}
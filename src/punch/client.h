@@ -0,0 +1,436 @@
+﻿/************************************************************************
+ * @ObjectName: client.h
+ * @Description: 与p2p.dll协议兼容的P2P客户端，支持以缓存的对端端点快速重连
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_PUNCH_CLIENT_H__
+#define __VSNC_PUNCH_CLIENT_H__
+
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+#include <stdint.h>
+
+
+#include <p2p/client.h>
+#include <vsnc_utils/memory.h>
+
+
+#include "protocol.h"
+
+
+struct sockaddr_in;
+
+
+namespace vsnc
+{
+
+	namespace punch
+	{
+
+
+		/// <summary>
+		/// 客户端参数
+		/// </summary>
+		struct ClientOptions
+		{
+			/// <summary>
+			/// <para>是否启用会话恢复</para>
+			/// <para>Connect的对端与缓存的对端相同时，先直接向缓存的端点打洞，同时照常经服务器请求连接，先成功者胜出</para>
+			/// <para>FREE状态下收到缓存对端发来的心跳时直接进入CONNECTED；对端为p2p.dll时不会响应，连接退化为经服务器的过程</para>
+			/// </summary>
+			bool     Resume        = true;
+			/// <summary>以毫秒为单位的打洞探测间隔，p2p.dll只随每秒一次的心跳探测</summary>
+			int64_t  ProbeInterval = 50;
+			/// <summary>以毫秒为单位的每个连接阶段的超时时间，p2p.dll固定为5000</summary>
+			int64_t  Timeout       = 5000;
+			/// <summary>
+			/// <para>是否并行探测对端的全部候选端点：内网端点、公网端点与预测的公网端口，先应答者胜出</para>
+			/// <para>为false时与p2p.dll相同，依次以内网、公网端点各尝试一个阶段；为true时只有直连与中转两个阶段，直连阶段以公网方式请求，使p2p.dll的对端也向本端的公网端点打洞</para>
+			/// </summary>
+			bool     Parallel      = true;
+			/// <summary>在对端公网端口之后依次预测的端口个数，用于按顺序分配端口的对称NAT</summary>
+			int      PortGuesses   = 2;
+			/// <summary>直连的各阶段均失败后是否经服务器中转</summary>
+			bool     Relay         = true;
+			/// <summary>上报给服务器的内网端点，无效时使用连接服务器的出口网卡地址与本地端口；多网卡主机可借此指定与对端同网段的地址</summary>
+			Endpoint Intranet;
+			/// <summary>
+			/// <para>是否在套接字上设置不分片（Windows的IP_DONTFRAGMENT，Linux的IP_MTU_DISCOVER），超过路径MTU的数据报被丢弃或直接发送失败，不在IP层分片</para>
+			/// <para>路径MTU探测依赖此项，否则超长的探测包被分片后照样到达</para>
+			/// </summary>
+			bool     DontFragment  = false;
+			/// <summary>发送的单个数据报的最大长度，不含IP与UDP头，超过时拆分为多个分片；不超过Max_Datagram，启用路径MTU探测时应不小于探测上限减去IP与UDP头</summary>
+			std::size_t MaxDatagram = Max_Datagram;
+			/// <summary>接收的单条消息的最大长度，超过时整条消息被丢弃并计入ClientStats::Dropped，重组缓冲区不会超过此长度</summary>
+			std::size_t MaxMessage  = 1024 * 1024;
+			/// <summary>
+			/// <para>是否启动后台线程收包并驱动定时任务</para>
+			/// <para>为false时由调用者驱动：在Handle返回的套接字可读或到达Pump返回的时间时调用Pump，供事件循环以一个线程承载大量客户端；Receive在等待期间自行驱动</para>
+			/// </summary>
+			bool     Thread        = true;
+		};
+
+
+		/// <summary>
+		/// 客户端统计信息
+		/// </summary>
+		struct ClientStats
+		{
+			/// <summary>发送的数据报个数，含控制报文</summary>
+			uint64_t SentPackets = 0;
+			/// <summary>接收的数据报个数，含控制报文</summary>
+			uint64_t RecvPackets = 0;
+			/// <summary>发送的字节数</summary>
+			uint64_t SentBytes   = 0;
+			/// <summary>接收的字节数</summary>
+			uint64_t RecvBytes   = 0;
+			/// <summary>接收队列已满、不完整、超过MaxMessage或超出接收缓冲区而丢弃的消息个数</summary>
+			uint64_t Dropped     = 0;
+		};
+
+
+		/// <summary>
+		/// <para>P2P客户端</para>
+		/// <para>接口与p2p::Client一致，报文格式与p2p.dll相同，可与p2p.dll的客户端及其服务器互通</para>
+		/// <para>后台线程负责注册、心跳、打洞与接收，接收到的消息放入队列由Receive取出；Send在调用者线程中直接发送，可与Receive并发</para>
+		/// <para>ClientOptions::Thread为false时没有后台线程，由调用者以Pump驱动，除Send外的接口应在驱动的线程中调用</para>
+		/// <para>客户端记住最近一次连接的对端端点，Connect同一对端时按ClientOptions::Resume先直接向该端点打洞，省去经服务器交换端点的往返</para>
+		/// </summary>
+		class Client
+		{
+		public:
+
+			/// <summary>心跳与注册的间隔，与p2p.dll相同</summary>
+			static constexpr int64_t     Heartbeat_Interval = 1000;
+			/// <summary>未收到服务器报文多久后视为离线，与p2p.dll相同</summary>
+			static constexpr int64_t     Server_Timeout     = 5000;
+			/// <summary>连接保活的超时时间，与p2p.dll相同</summary>
+			static constexpr int64_t     Connect_Timeout    = 5000;
+			/// <summary>接收队列的最大消息个数</summary>
+			static constexpr std::size_t Queue_Limit        = 1024;
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="seqno">客户端序列号</param>
+			/// <param name="srv_ip">服务器IP</param>
+			/// <param name="srv_port">服务器端口</param>
+			/// <param name="port">监听的端口号，为0时由系统分配</param>
+			/// <param name="opts">客户端参数</param>
+			Client(const uint64_t seqno, const std::string& srv_ip, const uint16_t srv_port, const uint16_t port = 0,
+				const ClientOptions& opts = ClientOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			Client(const Client&) = delete;
+
+			/// <summary>
+			/// 析构函数，关闭客户端
+			/// </summary>
+			~Client() noexcept;
+
+			/// <summary>
+			/// 获取客户端状态
+			/// </summary>
+			/// <returns>客户端状态</returns>
+			p2p::vsnc_p2p_state GetState() const noexcept { return m_eState.load(std::memory_order_acquire); }
+
+			/// <summary>
+			/// <para>向指定对端发起连接，与p2p::Client::Connect相同是异步的，调用后状态变为REQUESTING</para>
+			/// <para>各阶段的超时、是否并行探测与是否中转见ClientOptions；离线或对端为0、自身时不发起连接</para>
+			/// </summary>
+			/// <param name="seqno">对端序列号</param>
+			void                Connect(const uint64_t seqno) noexcept;
+
+			/// <summary>
+			/// 关闭客户端，通知服务器与对端后停止后台线程，阻塞在Receive中的调用返回-1
+			/// </summary>
+			void                Close() noexcept;
+
+			/// <summary>
+			/// 发送数据，单个数据报超过MaxDatagram时拆分为多个分片
+			/// </summary>
+			/// <param name="mem">待发送的数据</param>
+			/// <param name="ts">数据时间戳</param>
+			/// <returns>成功返回发送的字节数，未连接或发送失败返回-1</returns>
+			ssize_t             Send(const utils::Memory<char>& mem, const int64_t ts) noexcept;
+
+			/// <summary>
+			/// 接收数据
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <param name="timeout">以毫秒为单位的超时时间，小于0则阻塞</param>
+			/// <returns>成功返回接收到的字节数，已关闭返回-1，超时返回-2；超出接收缓冲区的消息被丢弃并计数，不影响其后的消息</returns>
+			ssize_t             Receive(utils::Memory<char>& mem, int64_t& ts, const int64_t timeout = -1) noexcept;
+
+			/// <summary>
+			/// 由调用者驱动时，执行到期的定时任务并取走套接字上已到达的数据报；有后台线程时不做任何事
+			/// </summary>
+			/// <returns>以utils::__steady()毫秒计的下一次须调用的时间，有后台线程或已关闭时返回-1</returns>
+			int64_t             Pump() noexcept;
+
+			/// <summary>
+			/// 获取由调用者驱动时等待可读的套接字
+			/// </summary>
+			/// <param name="next">以utils::__steady()毫秒计的下一次须调用Pump的时间</param>
+			/// <returns>套接字，有后台线程或已关闭时返回-1</returns>
+			int                 Handle(int64_t& next) const noexcept;
+
+			/// <summary>
+			/// 获取当前或最近一次连接的对端端点
+			/// </summary>
+			/// <returns>对端端点，尚未连接过为无效端点</returns>
+			Endpoint            PeerEndpoint() const;
+
+			/// <summary>
+			/// 预置会话恢复使用的对端端点，用于重建客户端后沿用此前的缓存
+			/// </summary>
+			/// <param name="seqno">对端序列号</param>
+			/// <param name="ep">对端端点</param>
+			void                Cache(const uint64_t seqno, const Endpoint& ep);
+
+			/// <summary>
+			/// 判断当前连接是否经缓存的端点直接建立，未经服务器交换端点
+			/// </summary>
+			/// <returns>是返回true</returns>
+			bool                Resumed() const noexcept { return m_bResumed.load(std::memory_order_acquire); }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			ClientStats         GetStats() const noexcept;
+
+		private:
+
+			/// <summary>
+			/// 接收到的消息
+			/// </summary>
+			struct __message
+			{
+				/// <summary>数据</summary>
+				std::vector<char> data;
+				/// <summary>数据时间戳</summary>
+				int64_t           ts = 0;
+			};
+
+			/// <summary>
+			/// 后台线程，收包并驱动定时任务
+			/// </summary>
+			void                _Work();
+
+			/// <summary>
+			/// 取走套接字上已到达的一批数据报
+			/// </summary>
+			void                _Drain() noexcept;
+
+			/// <summary>
+			/// 从接收队列取出一条消息，超出接收缓冲区的消息丢弃并计数，须持有m_iQueueMutex
+			/// </summary>
+			/// <param name="mem">接收缓冲区</param>
+			/// <param name="ts">接收到的数据时间戳</param>
+			/// <returns>成功返回接收到的字节数，队列为空返回-2</returns>
+			ssize_t             _Pop(utils::Memory<char>& mem, int64_t& ts);
+
+			/// <summary>
+			/// 执行到期的定时任务，须持有m_iMutex
+			/// </summary>
+			/// <param name="now">以毫秒为单位的单调时间</param>
+			/// <returns>以毫秒为单位的距下一个定时任务的时间</returns>
+			int64_t             _Tick(const int64_t now);
+
+			/// <summary>
+			/// 处理一个报文，须持有m_iMutex
+			/// </summary>
+			/// <param name="msg">报文</param>
+			/// <param name="from">发送方端点</param>
+			/// <param name="now">以毫秒为单位的单调时间</param>
+			void                _Handle(const Message& msg, const Endpoint& from, const int64_t now);
+
+			/// <summary>
+			/// 处理对端的心跳，须持有m_iMutex
+			/// </summary>
+			/// <param name="msg">报文</param>
+			/// <param name="from">发送方端点</param>
+			/// <param name="now">以毫秒为单位的单调时间</param>
+			void                _Heartbeat(const Message& msg, const Endpoint& from, const int64_t now);
+
+			/// <summary>
+			/// 处理数据分片，完整的消息放入接收队列
+			/// </summary>
+			/// <param name="msg">报文</param>
+			void                _Data(const Message& msg);
+
+			/// <summary>
+			/// 回到FREE，须持有m_iMutex
+			/// </summary>
+			/// <param name="bye">是否通知对端</param>
+			void                _Free(const bool bye);
+
+			/// <summary>
+			/// 进入离线状态，须持有m_iMutex
+			/// </summary>
+			void                _Offline();
+
+			/// <summary>
+			/// 进入CONNECTED，须持有m_iMutex
+			/// </summary>
+			/// <param name="from">对端端点</param>
+			/// <param name="now">以毫秒为单位的单调时间</param>
+			void                _Connected(const Endpoint& from, const int64_t now);
+
+			/// <summary>
+			/// 向对端的候选端点发送心跳，须持有m_iMutex
+			/// </summary>
+			void                _Probe();
+
+			/// <summary>
+			/// 按EVENT中的对端端点与连接方式生成候选端点，须持有m_iMutex
+			/// </summary>
+			/// <param name="msg">EVENT报文</param>
+			void                _Candidates(const Message& msg);
+
+			/// <summary>
+			/// 获取当前阶段超时后的下一个连接方式
+			/// </summary>
+			/// <param name="conn">下一个连接方式</param>
+			/// <returns>下一个连接方式，没有下一阶段时返回false</returns>
+			bool                _Next(uint8_t& conn) const noexcept;
+
+			/// <summary>
+			/// 填写报文的公共头
+			/// </summary>
+			/// <param name="msg">报文</param>
+			/// <param name="type">报文类型</param>
+			void                _Header(Message& msg, const message_type type) const noexcept;
+
+			/// <summary>
+			/// 发送控制报文
+			/// </summary>
+			/// <param name="msg">报文</param>
+			/// <param name="to">目的端点</param>
+			void                _Send(const Message& msg, const Endpoint& to) noexcept;
+
+			/// <summary>
+			/// 发送一个已编码的数据报
+			/// </summary>
+			/// <param name="buf">数据</param>
+			/// <param name="len">长度</param>
+			/// <param name="to">目的端点</param>
+			/// <returns>成功返回true</returns>
+			bool                _SendTo(const char* const buf, const std::size_t len, const Endpoint& to) noexcept;
+
+		private:
+
+			/// <summary>本端序列号</summary>
+			const uint64_t                   m_uSeqno;
+			/// <summary>客户端参数</summary>
+			const ClientOptions              m_iOpts;
+			/// <summary>单个数据分片的最大负载，由MaxDatagram限制在1到Max_Chunk之间</summary>
+			const std::size_t                m_uMaxChunk;
+			/// <summary>服务器端点</summary>
+			Endpoint                         m_iServer;
+			/// <summary>本端内网端点</summary>
+			Endpoint                         m_iIntranet;
+			/// <summary>UDP套接字</summary>
+			int                              m_nSock;
+			/// <summary>运行状态</summary>
+			std::atomic<bool>                m_bRun;
+			/// <summary>后台线程</summary>
+			std::thread                      m_iThread;
+			/// <summary>由调用者驱动时下一次须调用Pump的时间</summary>
+			std::atomic<int64_t>             m_nNextPump;
+
+			/// <summary>客户端状态</summary>
+			std::atomic<p2p::vsnc_p2p_state> m_eState;
+			/// <summary>当前连接是否经缓存端点直接建立</summary>
+			std::atomic<bool>                m_bResumed;
+			/// <summary>CONNECTED时的对端序列号，供Send使用</summary>
+			std::atomic<uint64_t>            m_uLink;
+			/// <summary>CONNECTED时以地址左移16位加端口表示的对端端点，供Send使用</summary>
+			std::atomic<uint64_t>            m_uLinkAddr;
+			/// <summary>以毫秒为单位的服务器时间与本地UTC时间之差</summary>
+			std::atomic<int64_t>             m_nOffset;
+			/// <summary>当前连接方式</summary>
+			std::atomic<uint8_t>             m_uConn;
+			/// <summary>发送消息的编号</summary>
+			std::atomic<uint64_t>            m_uMessageId;
+
+			/// <summary>保护以下连接状态</summary>
+			mutable std::mutex               m_iMutex;
+			/// <summary>对端序列号</summary>
+			uint64_t                         m_uPeer;
+			/// <summary>回到FREE前是否按连接方式进入下一阶段，仅由Connect发起的连接重试</summary>
+			bool                             m_bRetry;
+			/// <summary>本次连接的开始时间</summary>
+			int64_t                          m_nStart;
+			/// <summary>最近一次收到对端心跳的时间</summary>
+			int64_t                          m_nPeerHeard;
+			/// <summary>最近一次收到的对端心跳的时间戳，更早的心跳被忽略</summary>
+			int64_t                          m_nPeerTs;
+			/// <summary>最近一次收到服务器报文的时间</summary>
+			int64_t                          m_nServerHeard;
+			/// <summary>最近一次被应答的本端时间戳，更早的应答被忽略</summary>
+			int64_t                          m_nAckTs;
+			/// <summary>下一次向服务器发送注册、心跳或连接请求的时间</summary>
+			int64_t                          m_nNextServer;
+			/// <summary>下一次向对端发送心跳的时间</summary>
+			int64_t                          m_nNextProbe;
+			/// <summary>对端的候选端点</summary>
+			std::vector<Endpoint>            m_iCandidates;
+			/// <summary>当前或最近一次连接的对端端点</summary>
+			Endpoint                         m_iPeerEp;
+			/// <summary>缓存的对端序列号，为0表示没有缓存</summary>
+			uint64_t                         m_uCachedPeer;
+			/// <summary>缓存的对端端点</summary>
+			Endpoint                         m_iCachedEp;
+
+			/// <summary>保护接收队列</summary>
+			mutable std::mutex               m_iQueueMutex;
+			/// <summary>接收队列非空或客户端关闭的通知</summary>
+			std::condition_variable          m_iQueueCond;
+			/// <summary>接收队列</summary>
+			std::deque<__message>            m_iQueue;
+			/// <summary>已取出的消息缓冲区，留待复用</summary>
+			std::vector<std::vector<char>>   m_iSpare;
+			/// <summary>正在重组的消息，仅后台线程访问</summary>
+			__message                        m_iPartial;
+			/// <summary>正在重组的消息号，仅后台线程访问</summary>
+			uint64_t                         m_uPartialId;
+			/// <summary>是否有正在重组的消息，仅后台线程访问</summary>
+			bool                             m_bPartial;
+			/// <summary>正在重组的消息是否因超过MaxMessage而丢弃其余分片，仅后台线程访问</summary>
+			bool                             m_bDiscard;
+
+			/// <summary>发送的数据报个数</summary>
+			std::atomic<uint64_t>            m_uSentPackets;
+			/// <summary>接收的数据报个数</summary>
+			std::atomic<uint64_t>            m_uRecvPackets;
+			/// <summary>发送的字节数</summary>
+			std::atomic<uint64_t>            m_uSentBytes;
+			/// <summary>接收的字节数</summary>
+			std::atomic<uint64_t>            m_uRecvBytes;
+			/// <summary>丢弃的消息个数</summary>
+			std::atomic<uint64_t>            m_uDropped;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_PUNCH_CLIENT_H__
@@ -0,0 +1,212 @@
+﻿/************************************************************************
+ * @ObjectName: protocol.cpp
+ * @Description: P2P客户端与打洞服务器之间的报文格式，与p2p.dll兼容
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "protocol.h"
+
+
+#include <cstring>
+
+
+namespace
+{
+	/// <summary>p2p.dll在注册与心跳中填写的未使用浮点字段</summary>
+	constexpr double Unused_Double = -1.0;
+
+	void put(char* const p, const uint64_t v, const std::size_t bytes) noexcept
+	{
+		for (std::size_t i = 0; i < bytes; ++i) {
+			p[i] = static_cast<char>(v >> (8 * i));
+		}
+	}
+
+	uint64_t get(const char* const p, const std::size_t bytes) noexcept
+	{
+		uint64_t v = 0;
+		for (std::size_t i = 0; i < bytes; ++i) {
+			v |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+		}
+		return v;
+	}
+
+	void putDouble(char* const p, const double v) noexcept
+	{
+		uint64_t bits = 0;
+		memcpy(&bits, &v, sizeof(bits));
+		put(p, bits, 8);
+	}
+
+	void putEndpoint(char* const p, const vsnc::punch::Endpoint& ep) noexcept
+	{
+		memcpy(p, &ep.Ip, 4);
+		put(p + 4, ep.Port, 2);
+		put(p + 6, 0, 2);
+	}
+
+	vsnc::punch::Endpoint getEndpoint(const char* const p) noexcept
+	{
+		vsnc::punch::Endpoint ep;
+		memcpy(&ep.Ip, p, 4);
+		ep.Port = static_cast<uint16_t>(get(p + 4, 2));
+		return ep;
+	}
+
+	/// <summary>
+	/// 各类型报文不含负载的长度，0表示未知类型
+	/// </summary>
+	std::size_t fixedLength(const vsnc::punch::message_type type) noexcept
+	{
+		switch (type)
+		{
+		case vsnc::punch::message_type::REGISTER:  return 48;
+		case vsnc::punch::message_type::HEARTBEAT: return 88;
+		case vsnc::punch::message_type::BYE:       return 48;
+		case vsnc::punch::message_type::ACK:       return 32;
+		case vsnc::punch::message_type::CONNECT:   return 32;
+		case vsnc::punch::message_type::EVENT:     return 64;
+		case vsnc::punch::message_type::DATA:      return vsnc::punch::Data_Header_Len;
+		default:                                   return 0;
+		}
+	}
+}
+
+
+std::size_t vsnc::punch::__length(const Message& msg) noexcept
+{
+	auto len = fixedLength(msg.Type);
+	return (message_type::DATA == msg.Type) ? (len + msg.PayloadLen) : len;
+}
+
+
+std::size_t vsnc::punch::__encode(const Message& msg, char* const buf) noexcept
+{
+	auto len = __length(msg);
+	if (!len) {
+		return 0;
+	}
+	memset(buf, 0, fixedLength(msg.Type));
+	put(buf, msg.Seqno, 8);
+	put(buf + 8, static_cast<uint8_t>(msg.Type), 1);
+	put(buf + 9, msg.State, 1);
+	put(buf + 10, static_cast<uint8_t>(msg.Conn), 1);
+	put(buf + 12, msg.Reserved, 2);
+	put(buf + 14, msg.Version, 2);
+	put(buf + 16, static_cast<uint64_t>(msg.Ts), 8);
+	auto body = buf + Header_Len;
+	switch (msg.Type)
+	{
+	case message_type::REGISTER:
+		putDouble(body, Unused_Double);
+		putDouble(body + 8, Unused_Double);
+		putEndpoint(body + 16, msg.Intranet);
+		break;
+	case message_type::HEARTBEAT:
+		put(body, msg.Peer, 8);
+		put(body + 8, msg.SentPackets, 8);
+		put(body + 16, msg.RecvPackets, 8);
+		put(body + 24, msg.SentBytes, 8);
+		put(body + 32, msg.RecvBytes, 8);
+		putDouble(body + 40, Unused_Double);
+		putDouble(body + 48, Unused_Double);
+		putEndpoint(body + 56, msg.Intranet);
+		break;
+	case message_type::BYE:
+		put(body, msg.Peer, 8);
+		put(body + 8, msg.SentPackets, 8);
+		put(body + 16, msg.RecvPackets, 8);
+		break;
+	case message_type::ACK:
+		put(body, static_cast<uint64_t>(msg.ServerTime), 8);
+		break;
+	case message_type::CONNECT:
+		put(body, msg.Peer, 8);
+		break;
+	case message_type::EVENT:
+		put(body, static_cast<uint64_t>(msg.ServerTime), 8);
+		put(body + 8, msg.Peer, 8);
+		putEndpoint(body + 16, msg.Intranet);
+		putEndpoint(body + 24, msg.External);
+		break;
+	case message_type::DATA:
+		put(body, msg.Peer, 8);
+		put(body + 8, static_cast<uint64_t>(msg.UserTs), 8);
+		put(body + 16, msg.MessageId, 8);
+		put(body + 24, msg.Last ? 1 : 0, 1);
+		if (msg.PayloadLen) {
+			memcpy(buf + Data_Header_Len, msg.Payload, msg.PayloadLen);
+		}
+		break;
+	default:
+		break;
+	}
+	return len;
+}
+
+
+bool vsnc::punch::__decode(const char* const buf, const std::size_t len, Message& msg) noexcept
+{
+	if (len < Header_Len) {
+		return false;
+	}
+	auto type = static_cast<message_type>(static_cast<uint8_t>(buf[8]));
+	auto expect = fixedLength(type);
+	if (!expect || (len < expect)) {
+		return false;
+	}
+	msg = Message();
+	msg.Seqno = get(buf, 8);
+	msg.Type = type;
+	msg.State = static_cast<uint8_t>(buf[9]);
+	msg.Conn = static_cast<conn_type>(static_cast<uint8_t>(buf[10]));
+	msg.Reserved = static_cast<uint16_t>(get(buf + 12, 2));
+	msg.Version = static_cast<uint16_t>(get(buf + 14, 2));
+	msg.Ts = static_cast<int64_t>(get(buf + 16, 8));
+	auto body = buf + Header_Len;
+	switch (type)
+	{
+	case message_type::REGISTER:
+		msg.Intranet = getEndpoint(body + 16);
+		break;
+	case message_type::HEARTBEAT:
+		msg.Peer = get(body, 8);
+		msg.SentPackets = get(body + 8, 8);
+		msg.RecvPackets = get(body + 16, 8);
+		msg.SentBytes = get(body + 24, 8);
+		msg.RecvBytes = get(body + 32, 8);
+		msg.Intranet = getEndpoint(body + 56);
+		break;
+	case message_type::BYE:
+		msg.Peer = get(body, 8);
+		msg.SentPackets = get(body + 8, 8);
+		msg.RecvPackets = get(body + 16, 8);
+		break;
+	case message_type::ACK:
+		msg.ServerTime = static_cast<int64_t>(get(body, 8));
+		break;
+	case message_type::CONNECT:
+		msg.Peer = get(body, 8);
+		break;
+	case message_type::EVENT:
+		msg.ServerTime = static_cast<int64_t>(get(body, 8));
+		msg.Peer = get(body + 8, 8);
+		msg.Intranet = getEndpoint(body + 16);
+		msg.External = getEndpoint(body + 24);
+		break;
+	case message_type::DATA:
+		if (len - Data_Header_Len > Max_Chunk) {
+			return false;
+		}
+		msg.Peer = get(body, 8);
+		msg.UserTs = static_cast<int64_t>(get(body + 8, 8));
+		msg.MessageId = get(body + 16, 8);
+		msg.Last = 0 != buf[Data_Header_Len - 8];
+		msg.Payload = buf + Data_Header_Len;
+		msg.PayloadLen = len - Data_Header_Len;
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,177 @@
+﻿/************************************************************************
+ * @ObjectName: protocol.h
+ * @Description: P2P客户端与打洞服务器之间的报文格式，与p2p.dll兼容
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_PUNCH_PROTOCOL_H__
+#define __VSNC_PUNCH_PROTOCOL_H__
+
+
+#include <cstddef>
+
+
+#include <stdint.h>
+
+
+namespace vsnc
+{
+
+	namespace punch
+	{
+
+
+		/// <summary>
+		/// <para>报文类型</para>
+		/// <para>所有报文以24字节的公共头开始：发送方序列号(8) 类型(1) 状态(1) 连接方式(1) 0(1) 保留(2) 版本(2) 时间戳(8)，整数均为小端序；服务器发出的报文序列号为0</para>
+		/// <para>端点为8字节：网络字节序的IPv4地址(4) 小端序的端口(2) 0(2)</para>
+		/// </summary>
+		enum class message_type : uint8_t
+		{
+			/// <summary>客户端向服务器注册：-1.0(8) -1.0(8) 内网端点(8)，共48字节</summary>
+			REGISTER  = 0,
+			/// <summary>心跳，发往服务器与对端：对端序列号(8) 收发包数(8×2) 收发字节数(8×2) -1.0(8×2) 内网端点(8)，共88字节</summary>
+			HEARTBEAT = 1,
+			/// <summary>离开：对端序列号(8) 收发包数(8×2)，共48字节；对端序列号为0表示下线</summary>
+			BYE       = 2,
+			/// <summary>服务器对注册与心跳的应答：服务器时间(8)，共32字节；公共头的时间戳为回显的客户端时间戳</summary>
+			ACK       = 3,
+			/// <summary>经服务器向对端发起连接：对端序列号(8)，共32字节</summary>
+			CONNECT   = 4,
+			/// <summary>服务器下发的连接事件，同时发给双方：服务器时间(8) 对端序列号(8) 对端内网端点(8) 对端公网端点(8) 0(8)，共64字节</summary>
+			EVENT     = 5,
+			/// <summary>数据分片：目的序列号(8) 数据时间戳(8) 消息号(8) 是否末片(1) 0(7) 负载</summary>
+			DATA      = 6,
+		};
+
+
+		/// <summary>
+		/// 连接方式，即打洞使用的对端端点
+		/// </summary>
+		enum class conn_type : uint8_t
+		{
+			/// <summary>对端的内网端点</summary>
+			INTRANET = 0,
+			/// <summary>服务器看到的对端公网端点</summary>
+			EXTERNAL = 1,
+			/// <summary>经服务器中转</summary>
+			RELAY    = 2,
+		};
+
+
+		/// <summary>ACK中表示服务器不认识该客户端的状态，与p2p::vsnc_p2p_state::OFFLINE相同</summary>
+		constexpr uint8_t     State_Unknown   = 0xfe;
+		/// <summary>ACK中表示序列号已被其他端点注册的状态</summary>
+		constexpr uint8_t     State_Conflict  = 0xff;
+		/// <summary>公共头的长度</summary>
+		constexpr std::size_t Header_Len      = 24;
+		/// <summary>数据分片的头长度</summary>
+		constexpr std::size_t Data_Header_Len = 56;
+		/// <summary>单个报文的最大长度，即p2p.dll的接收缓冲区长度</summary>
+		constexpr std::size_t Max_Datagram    = 1500;
+		/// <summary>单个数据分片的最大负载</summary>
+		constexpr std::size_t Max_Chunk       = Max_Datagram - Data_Header_Len;
+		/// <summary>控制报文的最大长度</summary>
+		constexpr std::size_t Max_Control_Len = 88;
+
+
+		/// <summary>
+		/// IPv4端点
+		/// </summary>
+		struct Endpoint
+		{
+			/// <summary>网络字节序的IPv4地址</summary>
+			uint32_t Ip   = 0;
+			/// <summary>主机字节序的端口</summary>
+			uint16_t Port = 0;
+
+			/// <summary>
+			/// 判断端点是否有效
+			/// </summary>
+			/// <returns>地址与端口均非0返回true</returns>
+			bool Valid() const noexcept { return Ip && Port; }
+
+			bool operator==(const Endpoint& other) const noexcept { return (Ip == other.Ip) && (Port == other.Port); }
+			bool operator!=(const Endpoint& other) const noexcept { return !(*this == other); }
+		};
+
+
+		/// <summary>
+		/// 报文，各类型只使用其中的部分字段
+		/// </summary>
+		struct Message
+		{
+			/// <summary>发送方序列号，服务器发出时为0</summary>
+			uint64_t     Seqno       = 0;
+			/// <summary>报文类型</summary>
+			message_type Type        = message_type::REGISTER;
+			/// <summary>发送方状态，即p2p::vsnc_p2p_state的取值；服务器发出时为目标方的状态或State_Unknown、State_Conflict</summary>
+			uint8_t      State       = 0;
+			/// <summary>连接方式</summary>
+			conn_type    Conn        = conn_type::INTRANET;
+			/// <summary>保留字段，服务器原样记录</summary>
+			uint16_t     Reserved    = 0;
+			/// <summary>版本字段，p2p.dll固定为6</summary>
+			uint16_t     Version     = 6;
+			/// <summary>以毫秒为单位、按服务器时间校正后的发送时间；ACK中为回显的客户端时间戳，EVENT中为目标方最近的时间戳</summary>
+			int64_t      Ts          = 0;
+			/// <summary>对端序列号：心跳、离开与连接请求的对端，EVENT中的对端，DATA的目的方</summary>
+			uint64_t     Peer        = 0;
+			/// <summary>以毫秒为单位的服务器时间，用于ACK与EVENT</summary>
+			int64_t      ServerTime  = 0;
+			/// <summary>发送的数据报个数，用于心跳与离开</summary>
+			uint64_t     SentPackets = 0;
+			/// <summary>接收的数据报个数，用于心跳与离开</summary>
+			uint64_t     RecvPackets = 0;
+			/// <summary>发送的字节数，用于心跳</summary>
+			uint64_t     SentBytes   = 0;
+			/// <summary>接收的字节数，用于心跳</summary>
+			uint64_t     RecvBytes   = 0;
+			/// <summary>内网端点，用于注册、心跳与EVENT</summary>
+			Endpoint     Intranet;
+			/// <summary>服务器看到的公网端点，用于EVENT</summary>
+			Endpoint     External;
+			/// <summary>数据时间戳，用于DATA</summary>
+			int64_t      UserTs      = 0;
+			/// <summary>消息号，同一次发送的各分片相同，用于DATA</summary>
+			uint64_t     MessageId   = 0;
+			/// <summary>是否为消息的末片，用于DATA</summary>
+			bool         Last        = true;
+			/// <summary>分片负载，解码时指向输入缓冲区，用于DATA</summary>
+			const char*  Payload     = nullptr;
+			/// <summary>分片负载长度，不超过Max_Chunk，用于DATA</summary>
+			std::size_t  PayloadLen  = 0;
+		};
+
+
+		/// <summary>
+		/// 获取报文编码后的长度
+		/// </summary>
+		/// <param name="msg">报文</param>
+		/// <returns>编码后的长度，未知类型返回0</returns>
+		std::size_t __length(const Message& msg) noexcept;
+
+		/// <summary>
+		/// 编码报文，DATA的负载同时被拷贝
+		/// </summary>
+		/// <param name="msg">报文</param>
+		/// <param name="buf">长度不小于__length(msg)的缓冲区</param>
+		/// <returns>编码后的长度，未知类型返回0</returns>
+		std::size_t __encode(const Message& msg, char* const buf) noexcept;
+
+		/// <summary>
+		/// 解码报文
+		/// </summary>
+		/// <param name="buf">数据</param>
+		/// <param name="len">数据长度</param>
+		/// <param name="msg">解码得到的报文</param>
+		/// <returns>格式正确返回true，否则返回false</returns>
+		bool        __decode(const char* const buf, const std::size_t len, Message& msg) noexcept;
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_PUNCH_PROTOCOL_H__
@@ -0,0 +1,213 @@
+﻿/************************************************************************
+ * @ObjectName: load_generator.cpp
+ * @Description: 以大量模拟客户端压测打洞服务器
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "load_generator.h"
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+
+
+#include "../punch/protocol.h"
+
+
+namespace
+{
+	int64_t nowNanoseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+
+vsnc::rendezvous::LoadReport vsnc::rendezvous::LoadGenerator::Run()
+{
+	LoadReport report;
+	sockaddr_in server;
+	server.sin_family = AF_INET;
+	server.sin_port = htons(m_iOpts.Port);
+	if (inet_pton(AF_INET, m_iOpts.Host.c_str(), &server.sin_addr) != 1) {
+		return report;
+	}
+	auto requests = m_iOpts.Requests;
+	m_iSentAt.reset(new std::atomic<int64_t>[requests + 1]());
+	m_iLatency.reset(new std::atomic<int64_t>[requests + 1]());
+	for (std::size_t i = 0; i <= requests; ++i) {
+		m_iLatency[i] = -1;
+	}
+
+	auto nsock = (std::max)(m_iOpts.Sockets, static_cast<std::size_t>(2));
+	auto clients = (std::max)(m_iOpts.Clients, static_cast<std::size_t>(2));
+	// 序列号1..half为发起方，由前nsock/2个套接字承载；其余为被连接方，由后面的套接字承载
+	auto half = clients / 2;
+	auto hsock = nsock / 2;
+	std::vector<int> socks;
+	for (std::size_t i = 0; i < nsock; ++i) {
+		auto sock = static_cast<int>(socket(AF_INET, SOCK_DGRAM, 0));
+		if (-1 == sock) {
+			break;
+		}
+		int rcvbuf = 4 * 1024 * 1024;
+		setsockopt(sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&rcvbuf), sizeof(rcvbuf));
+		socks.push_back(sock);
+	}
+	if (socks.size() != nsock) {
+		for (auto sock : socks) {
+			closesocket(sock);
+		}
+		return report;
+	}
+	// 先绑定端口，接收线程才能开始recv
+	for (auto sock : socks) {
+		sockaddr_in local;
+		memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		bind(sock, reinterpret_cast<sockaddr*>(&local), sizeof(local));
+	}
+	char buf[punch::Max_Control_Len];
+	punch::Message msg;
+	m_bRun = true;
+	std::vector<std::thread> receivers;
+	for (std::size_t i = 0; i < nsock; ++i) {
+		receivers.emplace_back(&LoadGenerator::_Receive, this, socks[i], i < hsock);
+	}
+	auto send = [&](const std::size_t client, const punch::Message& m) {
+		auto sock = (client <= half) ? socks[client % hsock] : socks[hsock + client % (nsock - hsock)];
+		auto len = punch::__encode(m, buf);
+		sendto(sock, buf, static_cast<int>(len), 0, reinterpret_cast<sockaddr*>(&server), sizeof(server));
+	};
+
+	// 注册阶段：序列号为1..clients，时间戳为0以区别于连接请求的ACK，未应答的注册不超过Window个
+	auto start = nowNanoseconds();
+	for (std::size_t client = 1; client <= clients; ++client) {
+		_WaitUntil([&]() { return client - m_uRegistered < m_iOpts.Window; }, m_iOpts.Timeout);
+		msg.Type = punch::message_type::REGISTER;
+		msg.Seqno = client;
+		msg.Ts = 0;
+		send(client, msg);
+	}
+	_WaitUntil([&]() { return m_uRegistered >= clients; }, m_iOpts.Timeout);
+	report.Registered = m_uRegistered;
+	report.RegisterSeconds = static_cast<double>(nowNanoseconds() - start) / 1e9;
+
+	// 连接阶段：随机选择发起方与被连接方，请求号从1开始
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<uint64_t> pickInitiator(1, half);
+	std::uniform_int_distribution<uint64_t> pickTarget(half + 1, clients);
+	start = nowNanoseconds();
+	for (std::size_t r = 1; r <= requests; ++r) {
+		_WaitUntil([&]() { return r - 1 - (m_uMatched + m_uNotFound) < m_iOpts.Window; }, m_iOpts.Timeout);
+		if (m_iOpts.Rate) {
+			auto due = start + static_cast<int64_t>(static_cast<double>(r - 1) * 1e9 / static_cast<double>(m_iOpts.Rate));
+			while (nowNanoseconds() < due) {
+				std::this_thread::yield();
+			}
+		}
+		msg.Type = punch::message_type::CONNECT;
+		msg.Seqno = pickInitiator(rng);
+		msg.Peer = pickTarget(rng);
+		msg.Ts = static_cast<int64_t>(r);
+		m_iSentAt[r].store(nowNanoseconds(), std::memory_order_release);
+		send(static_cast<std::size_t>(msg.Seqno), msg);
+	}
+	_WaitUntil([&]() { return m_uMatched + m_uNotFound >= requests; }, m_iOpts.Timeout);
+	auto elapsed = static_cast<double>(nowNanoseconds() - start) / 1e9;
+
+	m_bRun = false;
+	for (auto sock : socks) {
+		closesocket(sock);
+	}
+	for (auto& t : receivers) {
+		t.join();
+	}
+
+	std::vector<int64_t> lat;
+	lat.reserve(requests);
+	for (std::size_t r = 1; r <= requests; ++r) {
+		auto v = m_iLatency[r].load(std::memory_order_relaxed);
+		if (v >= 0) {
+			lat.push_back(v / 1000);
+		}
+	}
+	std::sort(lat.begin(), lat.end());
+	report.Requests = requests;
+	report.Matched = m_uMatched;
+	report.NotFound = m_uNotFound;
+	report.Notified = m_uNotified;
+	report.Lost = requests - (std::min)(requests, report.Matched + report.NotFound);
+	report.RequestsPerSecond = (elapsed > 0.0) ? (static_cast<double>(report.Matched + report.NotFound) / elapsed) : 0.0;
+	if (!lat.empty()) {
+		report.P50 = lat[lat.size() / 2];
+		report.P99 = lat[(std::min)(lat.size() - 1, lat.size() * 99 / 100)];
+		report.Max = lat.back();
+	}
+	return report;
+}
+
+
+void vsnc::rendezvous::LoadGenerator::_Receive(const int sock, const bool initiator)
+{
+	char buf[punch::Max_Control_Len];
+	while (m_bRun) {
+		fd_set rfds;
+		FD_ZERO(&rfds);
+		FD_SET(sock, &rfds);
+		timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		if (select(sock + 1, &rfds, nullptr, nullptr, &tv) <= 0) {
+			continue;
+		}
+		auto ret = recv(sock, buf, sizeof(buf), 0);
+		punch::Message msg;
+		if ((ret <= 0) || !punch::__decode(buf, static_cast<std::size_t>(ret), msg)) {
+			continue;
+		}
+		auto now = nowNanoseconds();
+		auto request = static_cast<std::size_t>(msg.Ts);
+		switch (msg.Type)
+		{
+		case punch::message_type::ACK:
+			if (0 == msg.Ts) {
+				++m_uRegistered;
+			}
+			else if (initiator) {
+				++m_uNotFound;
+			}
+			break;
+		case punch::message_type::EVENT:
+			if (initiator) {
+				++m_uMatched;
+			}
+			else if ((request > 0) && (request <= m_iOpts.Requests)) {
+				m_iLatency[request].store(now - m_iSentAt[request].load(std::memory_order_acquire), std::memory_order_relaxed);
+				++m_uNotified;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+
+template<typename _Pred>
+bool vsnc::rendezvous::LoadGenerator::_WaitUntil(_Pred done, const int64_t timeout)
+{
+	auto deadline = nowNanoseconds() + timeout * 1000000;
+	while (!done()) {
+		if (nowNanoseconds() >= deadline) {
+			return false;
+		}
+		std::this_thread::yield();
+	}
+	return true;
+}
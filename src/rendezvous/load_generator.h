@@ -0,0 +1,152 @@
+﻿/************************************************************************
+ * @ObjectName: load_generator.h
+ * @Description: 以大量模拟客户端压测打洞服务器
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_RENDEZVOUS_LOAD_GENERATOR_H__
+#define __VSNC_RENDEZVOUS_LOAD_GENERATOR_H__
+
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+
+
+#include <stdint.h>
+
+
+namespace vsnc
+{
+
+	namespace rendezvous
+	{
+
+
+		/// <summary>
+		/// 压测参数
+		/// </summary>
+		struct LoadOptions
+		{
+			/// <summary>服务器地址</summary>
+			std::string Host     = "127.0.0.1";
+			/// <summary>服务器端口</summary>
+			uint16_t    Port     = 10000;
+			/// <summary>模拟客户端个数，即注册的序列号个数，前一半为发起方，后一半为被连接方</summary>
+			std::size_t Clients  = 100000;
+			/// <summary>承载模拟客户端的套接字个数，发起方与被连接方各占一半</summary>
+			std::size_t Sockets  = 8;
+			/// <summary>连接请求总数</summary>
+			std::size_t Requests = 200000;
+			/// <summary>以请求每秒为单位的发送速率，为0时只受Window限制</summary>
+			uint64_t    Rate     = 0;
+			/// <summary>未得到应答的请求个数上限</summary>
+			std::size_t Window   = 1024;
+			/// <summary>以毫秒为单位的等待应答的超时时间</summary>
+			int64_t     Timeout  = 2000;
+		};
+
+
+		/// <summary>
+		/// 压测结果
+		/// </summary>
+		struct LoadReport
+		{
+			/// <summary>注册成功的序列号个数</summary>
+			std::size_t Registered        = 0;
+			/// <summary>以秒为单位的注册阶段耗时</summary>
+			double      RegisterSeconds   = 0.0;
+			/// <summary>发出的连接请求个数</summary>
+			std::size_t Requests          = 0;
+			/// <summary>发起方收到EVENT的请求个数</summary>
+			std::size_t Matched           = 0;
+			/// <summary>对端不存在、发起方收到ACK的请求个数</summary>
+			std::size_t NotFound          = 0;
+			/// <summary>没有应答的请求个数</summary>
+			std::size_t Lost              = 0;
+			/// <summary>被连接方收到EVENT的请求个数</summary>
+			std::size_t Notified          = 0;
+			/// <summary>每秒完成的请求个数</summary>
+			double      RequestsPerSecond = 0.0;
+			/// <summary>以微秒为单位的匹配时延中位数，即从发出CONNECT到被连接方收到EVENT</summary>
+			int64_t     P50               = 0;
+			/// <summary>以微秒为单位的匹配时延99分位数</summary>
+			int64_t     P99               = 0;
+			/// <summary>以微秒为单位的最大匹配时延</summary>
+			int64_t     Max               = 0;
+		};
+
+
+		/// <summary>
+		/// <para>打洞服务器压测器，使用与p2p.dll相同的报文</para>
+		/// <para>先为每个模拟客户端注册一个序列号，再由随机的发起方向随机的被连接方发起连接请求，统计吞吐与从发出CONNECT到被连接方收到EVENT的时延</para>
+		/// <para>CONNECT的时间戳填写请求号，服务器把它作为发起方的时间戳放在发给被连接方的EVENT中，据此匹配请求；被连接方不再发送报文，发给发起方的EVENT中的时间戳始终为0</para>
+		/// <para>每个套接字承载多个模拟客户端并由独立线程接收应答</para>
+		/// </summary>
+		class LoadGenerator
+		{
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="opts">压测参数</param>
+			explicit LoadGenerator(const LoadOptions& opts) : m_iOpts(opts) {}
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			LoadGenerator(const LoadGenerator&) = delete;
+
+			/// <summary>
+			/// 执行压测，阻塞直到完成
+			/// </summary>
+			/// <returns>压测结果</returns>
+			LoadReport Run();
+
+		private:
+
+			/// <summary>
+			/// 接收线程
+			/// </summary>
+			/// <param name="sock">套接字</param>
+			/// <param name="initiator">是否为承载发起方的套接字</param>
+			void       _Receive(const int sock, const bool initiator);
+
+			/// <summary>
+			/// 等待直到满足条件或超时
+			/// </summary>
+			/// <param name="done">条件</param>
+			/// <param name="timeout">以毫秒为单位的超时时间</param>
+			/// <returns>满足条件返回true</returns>
+			template <typename _Pred>
+			static bool _WaitUntil(_Pred done, const int64_t timeout);
+
+		private:
+
+			/// <summary>压测参数</summary>
+			const LoadOptions                         m_iOpts;
+			/// <summary>运行状态</summary>
+			std::atomic<bool>                         m_bRun { false };
+			/// <summary>注册成功的个数</summary>
+			std::atomic<std::size_t>                  m_uRegistered { 0 };
+			/// <summary>发起方收到EVENT的个数</summary>
+			std::atomic<std::size_t>                  m_uMatched { 0 };
+			/// <summary>发起方收到ACK的个数</summary>
+			std::atomic<std::size_t>                  m_uNotFound { 0 };
+			/// <summary>被连接方收到的通知个数</summary>
+			std::atomic<std::size_t>                  m_uNotified { 0 };
+			/// <summary>以请求号索引的以纳秒为单位的发送时间</summary>
+			std::unique_ptr<std::atomic<int64_t>[]>   m_iSentAt;
+			/// <summary>以请求号索引的以纳秒为单位的时延，未应答为-1</summary>
+			std::unique_ptr<std::atomic<int64_t>[]>   m_iLatency;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_RENDEZVOUS_LOAD_GENERATOR_H__
@@ -0,0 +1,125 @@
+﻿/************************************************************************
+ * @ObjectName: main.cpp
+ * @Description: 打洞服务器与压测器入口
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+
+#include <vsnc_utils/utils.h>
+
+#include "server.h"
+#include "load_generator.h"
+
+
+/// <summary>以毫秒为单位的统计信息输出间隔</summary>
+static constexpr int64_t Stats_Interval = 5000;
+
+
+static void usage()
+{
+	std::cout << "usage: rendezvous serve [port] [workers]" << std::endl;
+	std::cout << "       rendezvous bench <host> <port> [clients] [requests]" << std::endl;
+}
+
+static void worker(std::atomic<bool>& run)
+{
+	char c = '\0';
+	do {
+		std::cin >> c;
+	} while ('q' != c);
+	run = false;
+}
+
+static int serve(int argc, char* argv[])
+{
+	vsnc::rendezvous::ServerOptions opts;
+	if (argc > 2) opts.Port = static_cast<uint16_t>(atoi(argv[2]));
+	if (argc > 3) opts.Workers = static_cast<std::size_t>(atoi(argv[3]));
+	vsnc::rendezvous::Server server(opts);
+	if (!server.Start()) {
+		std::cout << "Server::Start() failed." << std::endl;
+		return 1;
+	}
+	std::cout << "listening on " << server.Port() << ", q to quit" << std::endl;
+	std::atomic<bool> run { true };
+	std::thread quit(&worker, std::ref(run));
+	auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(Stats_Interval);
+	while (run) {
+		vsnc::utils::__sleep_milliseconds(100);
+		if (std::chrono::steady_clock::now() < next) {
+			continue;
+		}
+		next += std::chrono::milliseconds(Stats_Interval);
+		auto stats = server.GetStats();
+		std::cout << "registered: " << stats.Registered
+			<< " registers: " << stats.Registers
+			<< " heartbeats: " << stats.Heartbeats
+			<< " connects: " << stats.Connects
+			<< " matches: " << stats.Matches
+			<< " not found: " << stats.NotFound
+			<< " unregisters: " << stats.Unregisters
+			<< " relayed: " << stats.Relayed
+			<< " unknown: " << stats.Unknown
+			<< " expired: " << stats.Expired
+			<< " malformed: " << stats.Malformed << std::endl;
+	}
+	quit.join();
+	server.Stop();
+	return 0;
+}
+
+static int bench(int argc, char* argv[])
+{
+	if (argc < 4) {
+		usage();
+		return 1;
+	}
+	vsnc::rendezvous::LoadOptions opts;
+	opts.Host = argv[2];
+	opts.Port = static_cast<uint16_t>(atoi(argv[3]));
+	if (argc > 4) opts.Clients = static_cast<std::size_t>(atoll(argv[4]));
+	if (argc > 5) opts.Requests = static_cast<std::size_t>(atoll(argv[5]));
+	vsnc::rendezvous::LoadGenerator gen(opts);
+	auto report = gen.Run();
+	std::cout << "registered: " << report.Registered << "/" << opts.Clients
+		<< " in " << vsnc::utils::__to_string_with_precision(report.RegisterSeconds) << "s" << std::endl;
+	std::cout << "requests: " << report.Requests
+		<< " matched: " << report.Matched
+		<< " not found: " << report.NotFound
+		<< " lost: " << report.Lost
+		<< " notified: " << report.Notified << std::endl;
+	std::cout << "throughput: " << vsnc::utils::__to_string_with_precision(report.RequestsPerSecond)
+		<< " req/s latency p50/p99/max: " << report.P50 << "/" << report.P99 << "/" << report.Max << "us" << std::endl;
+	return 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+	//初始化WSA
+	WORD sockVersion = MAKEWORD(2, 2);
+	WSADATA wsaData;
+	if (WSAStartup(sockVersion, &wsaData) != 0) return 0;
+
+	auto ret = 1;
+	if ((argc > 1) && (0 == strcmp(argv[1], "serve"))) {
+		ret = serve(argc, argv);
+	}
+	else if ((argc > 1) && (0 == strcmp(argv[1], "bench"))) {
+		ret = bench(argc, argv);
+	}
+	else {
+		usage();
+	}
+	WSACleanup();
+	return ret;
+}
@@ -0,0 +1,215 @@
+﻿/************************************************************************
+ * @ObjectName: registry.cpp
+ * @Description: 按序列号索引的分片注册表
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "registry.h"
+
+
+namespace
+{
+	/// <summary>以毫秒为单位的时间轮槽位宽度</summary>
+	constexpr int64_t     Tick_Len     = 1000;
+	/// <summary>每个分片的最小哈希表长度</summary>
+	constexpr std::size_t Min_Slots    = 64;
+	/// <summary>装载因子上限的分子，分母为10</summary>
+	constexpr std::size_t Max_Load_Num = 7;
+}
+
+
+vsnc::rendezvous::Registry::Registry(const std::size_t shards, const int64_t ttl, const std::size_t capacity) :
+	m_nTtl(ttl)
+{
+	std::size_t slots = Min_Slots;
+	while (slots * Max_Load_Num / 10 < capacity / (shards ? shards : 1)) {
+		slots <<= 1;
+	}
+	// 过期时间距当前秒最多ttl/Tick_Len+1个槽位，多留一个保证不会回绕到尚未检查的槽位
+	auto wheel = static_cast<std::size_t>(ttl / Tick_Len) + 2;
+	for (std::size_t i = 0; i < (shards ? shards : 1); ++i) {
+		std::unique_ptr<__shard> s(new __shard);
+		s->slots.resize(slots);
+		s->wheel.resize(wheel);
+		m_iShards.push_back(std::move(s));
+	}
+}
+
+
+bool vsnc::rendezvous::Registry::Register(const uint64_t seqno, const Record& rec, const int64_t now)
+{
+	auto h = _Hash(seqno);
+	auto& s = _Shard(h);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto idx = _Find(s, seqno, h);
+	if (SIZE_MAX != idx) {
+		s.slots[idx].rec = rec;
+		_Touch(s, s.slots[idx], now + m_nTtl);
+		return false;
+	}
+	if ((s.count + 1) * 10 > s.slots.size() * Max_Load_Num) {
+		_Grow(s);
+	}
+	auto mask = s.slots.size() - 1;
+	idx = static_cast<std::size_t>(h) & mask;
+	while (s.slots[idx].used) {
+		idx = (idx + 1) & mask;
+	}
+	auto& slot = s.slots[idx];
+	slot.seqno = seqno;
+	slot.rec = rec;
+	slot.expiry = 0;
+	slot.used = true;
+	_Touch(s, slot, now + m_nTtl);
+	++s.count;
+	return true;
+}
+
+
+bool vsnc::rendezvous::Registry::Lookup(const uint64_t seqno, Record& rec, const int64_t now)
+{
+	auto h = _Hash(seqno);
+	auto& s = _Shard(h);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto idx = _Find(s, seqno, h);
+	if ((SIZE_MAX == idx) || (s.slots[idx].expiry <= now)) {
+		return false;
+	}
+	rec = s.slots[idx].rec;
+	return true;
+}
+
+
+bool vsnc::rendezvous::Registry::Unregister(const uint64_t seqno)
+{
+	auto h = _Hash(seqno);
+	auto& s = _Shard(h);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto idx = _Find(s, seqno, h);
+	if (SIZE_MAX == idx) {
+		return false;
+	}
+	_Erase(s, idx);
+	return true;
+}
+
+
+std::size_t vsnc::rendezvous::Registry::Expire(const int64_t now)
+{
+	std::size_t cnt = 0;
+	auto target = now / Tick_Len;
+	for (auto& sp : m_iShards) {
+		auto& s = *sp;
+		std::lock_guard<std::mutex> lock(s.mutex);
+		if (s.tick < 0) {
+			s.tick = target;
+		}
+		// 只检查已完全过去的秒，其中记录的注册若未被刷新则必然已过期
+		for (; s.tick < target; ++s.tick) {
+			auto pos = static_cast<std::size_t>(s.tick) % s.wheel.size();
+			auto& bucket = s.wheel[pos];
+			std::size_t keep = 0;
+			for (auto seqno : bucket) {
+				auto idx = _Find(s, seqno, _Hash(seqno));
+				if (SIZE_MAX == idx) {
+					continue;
+				}
+				auto due = s.slots[idx].expiry / Tick_Len;
+				if (due <= s.tick) {
+					_Erase(s, idx);
+					++cnt;
+				}
+				else if (static_cast<std::size_t>(due) % s.wheel.size() == pos) {
+					// 检查滞后超过一圈时，本槽位中还有下一圈才到期的注册，保留到下一圈；其余的已在刷新时追加到别的槽位
+					bucket[keep++] = seqno;
+				}
+			}
+			bucket.resize(keep);
+		}
+	}
+	return cnt;
+}
+
+
+std::size_t vsnc::rendezvous::Registry::Size()
+{
+	std::size_t cnt = 0;
+	for (auto& sp : m_iShards) {
+		std::lock_guard<std::mutex> lock(sp->mutex);
+		cnt += sp->count;
+	}
+	return cnt;
+}
+
+
+uint64_t vsnc::rendezvous::Registry::_Hash(const uint64_t seqno) noexcept
+{
+	// splitmix64的混合函数，使连续的序列号均匀分布
+	auto h = seqno + 0x9E3779B97F4A7C15ull;
+	h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+	h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+	return h ^ (h >> 31);
+}
+
+
+vsnc::rendezvous::Registry::__shard& vsnc::rendezvous::Registry::_Shard(const uint64_t h) noexcept
+{
+	return *m_iShards[static_cast<std::size_t>(h >> 40) % m_iShards.size()];
+}
+
+
+std::size_t vsnc::rendezvous::Registry::_Find(const __shard& s, const uint64_t seqno, const uint64_t h) noexcept
+{
+	auto mask = s.slots.size() - 1;
+	for (auto idx = static_cast<std::size_t>(h) & mask; s.slots[idx].used; idx = (idx + 1) & mask) {
+		if (s.slots[idx].seqno == seqno) {
+			return idx;
+		}
+	}
+	return SIZE_MAX;
+}
+
+
+void vsnc::rendezvous::Registry::_Touch(__shard& s, __slot& slot, const int64_t expiry)
+{
+	if (expiry / Tick_Len != slot.expiry / Tick_Len) {
+		s.wheel[static_cast<std::size_t>(expiry / Tick_Len) % s.wheel.size()].push_back(slot.seqno);
+	}
+	slot.expiry = expiry;
+}
+
+
+void vsnc::rendezvous::Registry::_Erase(__shard& s, std::size_t idx) noexcept
+{
+	auto mask = s.slots.size() - 1;
+	auto next = (idx + 1) & mask;
+	while (s.slots[next].used) {
+		// 后续元素的理想位置不在(idx, next]之间时，可以移到空位上
+		auto home = static_cast<std::size_t>(_Hash(s.slots[next].seqno)) & mask;
+		if (((next - home) & mask) >= ((next - idx) & mask)) {
+			s.slots[idx] = s.slots[next];
+			idx = next;
+		}
+		next = (next + 1) & mask;
+	}
+	s.slots[idx] = __slot();
+	--s.count;
+}
+
+
+void vsnc::rendezvous::Registry::_Grow(__shard& s)
+{
+	std::vector<__slot> old(s.slots.size() * 2);
+	old.swap(s.slots);
+	auto mask = s.slots.size() - 1;
+	for (auto& slot : old) {
+		if (!slot.used) {
+			continue;
+		}
+		auto idx = static_cast<std::size_t>(_Hash(slot.seqno)) & mask;
+		while (s.slots[idx].used) {
+			idx = (idx + 1) & mask;
+		}
+		s.slots[idx] = slot;
+	}
+}
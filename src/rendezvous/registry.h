@@ -0,0 +1,231 @@
+﻿/************************************************************************
+ * @ObjectName: registry.h
+ * @Description: 按序列号索引的分片注册表
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_RENDEZVOUS_REGISTRY_H__
+#define __VSNC_RENDEZVOUS_REGISTRY_H__
+
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+
+#include <stdint.h>
+
+
+#include "../punch/protocol.h"
+
+
+namespace vsnc
+{
+
+	namespace rendezvous
+	{
+
+
+		/// <summary>
+		/// 客户端的注册信息
+		/// </summary>
+		struct Record
+		{
+			/// <summary>服务器看到的公网端点</summary>
+			punch::Endpoint  External;
+			/// <summary>客户端上报的内网端点</summary>
+			punch::Endpoint  Intranet;
+			/// <summary>最近一次连接的对端序列号</summary>
+			uint64_t         Peer  = 0;
+			/// <summary>客户端最近一次报文的时间戳，EVENT中转发给对端</summary>
+			int64_t          Ts    = 0;
+			/// <summary>客户端最近一次上报的状态</summary>
+			uint8_t          State = 0;
+			/// <summary>最近一次连接的连接方式，为RELAY时服务器转发双方的心跳、离开与数据</summary>
+			punch::conn_type Conn  = punch::conn_type::INTRANET;
+		};
+
+
+		/// <summary>
+		/// <para>注册表</para>
+		/// <para>按序列号的哈希值分为多个分片，每个分片持有独立的锁、线性探测的开放寻址哈希表与秒级时间轮</para>
+		/// <para>删除时后移后续元素填补空位，不使用墓碑，因此大量注册、过期后查找性能不会退化</para>
+		/// <para>刷新使过期时间跨入新的秒时才把序列号追加到对应的时间轮槽位，旧槽位中的记录在到期检查时因过期时间不符而被忽略</para>
+		/// <para>线程安全</para>
+		/// </summary>
+		class Registry
+		{
+		private:
+
+			/// <summary>
+			/// 哈希表槽位
+			/// </summary>
+			struct __slot
+			{
+				/// <summary>序列号</summary>
+				uint64_t seqno  = 0;
+				/// <summary>注册信息</summary>
+				Record   rec;
+				/// <summary>以毫秒为单位的过期时间</summary>
+				int64_t  expiry = 0;
+				/// <summary>是否已占用</summary>
+				bool     used   = false;
+			};
+
+			/// <summary>
+			/// 分片
+			/// </summary>
+			struct __shard
+			{
+				/// <summary>保护本分片的锁</summary>
+				std::mutex                         mutex;
+				/// <summary>长度为2的幂的哈希表</summary>
+				std::vector<__slot>                slots;
+				/// <summary>已占用的槽位个数</summary>
+				std::size_t                        count = 0;
+				/// <summary>时间轮，每个槽位保存该秒内过期的序列号</summary>
+				std::vector<std::vector<uint64_t>> wheel;
+				/// <summary>下一个待检查的秒，未开始时为-1</summary>
+				int64_t                            tick  = -1;
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="shards">分片个数</param>
+			/// <param name="ttl">以毫秒为单位的注册有效期</param>
+			/// <param name="capacity">预计的注册总数，用于预分配哈希表</param>
+			Registry(const std::size_t shards, const int64_t ttl, const std::size_t capacity = 0);
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			Registry(const Registry&) = delete;
+
+			/// <summary>
+			/// 注册，已存在时覆盖原有的注册信息
+			/// </summary>
+			/// <param name="seqno">序列号</param>
+			/// <param name="rec">注册信息</param>
+			/// <param name="now">以毫秒为单位的单调时间</param>
+			/// <returns>新注册返回true，覆盖返回false</returns>
+			bool        Register(const uint64_t seqno, const Record& rec, const int64_t now);
+
+			/// <summary>
+			/// 查找未过期的注册
+			/// </summary>
+			/// <param name="seqno">序列号</param>
+			/// <param name="rec">注册信息</param>
+			/// <param name="now">以毫秒为单位的单调时间</param>
+			/// <returns>找到返回true</returns>
+			bool        Lookup(const uint64_t seqno, Record& rec, const int64_t now);
+
+			/// <summary>
+			/// 在分片锁内修改未过期的注册并刷新有效期
+			/// </summary>
+			/// <param name="seqno">序列号</param>
+			/// <param name="now">以毫秒为单位的单调时间</param>
+			/// <param name="fn">以Record&amp;为参数的修改函数，其中不得再访问注册表</param>
+			/// <returns>找到返回true</returns>
+			template <typename _Fn>
+			bool        Update(const uint64_t seqno, const int64_t now, _Fn fn);
+
+			/// <summary>
+			/// 注销
+			/// </summary>
+			/// <param name="seqno">序列号</param>
+			/// <returns>存在返回true</returns>
+			bool        Unregister(const uint64_t seqno);
+
+			/// <summary>
+			/// 删除已过期的注册
+			/// </summary>
+			/// <param name="now">以毫秒为单位的单调时间</param>
+			/// <returns>删除的个数</returns>
+			std::size_t Expire(const int64_t now);
+
+			/// <summary>
+			/// 获取注册总数
+			/// </summary>
+			/// <returns>注册总数</returns>
+			std::size_t Size();
+
+		private:
+
+			/// <summary>
+			/// 计算序列号的哈希值
+			/// </summary>
+			/// <param name="seqno">序列号</param>
+			/// <returns>哈希值</returns>
+			static uint64_t    _Hash(const uint64_t seqno) noexcept;
+
+			/// <summary>
+			/// 获取序列号所在的分片
+			/// </summary>
+			/// <param name="h">哈希值</param>
+			/// <returns>分片</returns>
+			__shard&           _Shard(const uint64_t h) noexcept;
+
+			/// <summary>
+			/// 在分片中查找序列号
+			/// </summary>
+			/// <param name="s">分片</param>
+			/// <param name="seqno">序列号</param>
+			/// <param name="h">哈希值</param>
+			/// <returns>槽位下标，不存在时返回SIZE_MAX</returns>
+			static std::size_t _Find(const __shard& s, const uint64_t seqno, const uint64_t h) noexcept;
+
+			/// <summary>
+			/// 更新槽位的过期时间，跨入新的秒时把序列号追加到对应的时间轮槽位
+			/// </summary>
+			/// <param name="s">分片</param>
+			/// <param name="slot">槽位</param>
+			/// <param name="expiry">以毫秒为单位的过期时间</param>
+			static void        _Touch(__shard& s, __slot& slot, const int64_t expiry);
+
+			/// <summary>
+			/// 删除槽位，并后移后续元素填补空位
+			/// </summary>
+			/// <param name="s">分片</param>
+			/// <param name="idx">槽位下标</param>
+			static void        _Erase(__shard& s, std::size_t idx) noexcept;
+
+			/// <summary>
+			/// 扩容哈希表
+			/// </summary>
+			/// <param name="s">分片</param>
+			static void        _Grow(__shard& s);
+
+		private:
+
+			/// <summary>以毫秒为单位的注册有效期</summary>
+			const int64_t                         m_nTtl;
+			/// <summary>分片</summary>
+			std::vector<std::unique_ptr<__shard>> m_iShards;
+		};
+
+
+	}
+
+}
+
+
+template<typename _Fn>
+bool vsnc::rendezvous::Registry::Update(const uint64_t seqno, const int64_t now, _Fn fn)
+{
+	auto h = _Hash(seqno);
+	auto& s = _Shard(h);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto idx = _Find(s, seqno, h);
+	if ((SIZE_MAX == idx) || (s.slots[idx].expiry <= now)) {
+		return false;
+	}
+	fn(s.slots[idx].rec);
+	_Touch(s, s.slots[idx], now + m_nTtl);
+	return true;
+}
+
+
+#endif // !__VSNC_RENDEZVOUS_REGISTRY_H__
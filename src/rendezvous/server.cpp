@@ -0,0 +1,262 @@
+﻿/************************************************************************
+ * @ObjectName: server.cpp
+ * @Description: 打洞服务器
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "server.h"
+
+
+#include <algorithm>
+#include <chrono>
+
+
+#include <p2p/client.h>
+#include <vsnc_utils/utils.h>
+
+
+namespace
+{
+	/// <summary>以毫秒为单位的工作线程最长等待时间，决定Stop的响应时间</summary>
+	constexpr int64_t Max_Wait = 100;
+
+	int64_t nowMilliseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool isLinked(const uint8_t state) noexcept
+	{
+		return (static_cast<uint8_t>(vsnc::p2p::vsnc_p2p_state::CONNECTING) == state) ||
+			(static_cast<uint8_t>(vsnc::p2p::vsnc_p2p_state::CONNECTED) == state);
+	}
+}
+
+
+vsnc::rendezvous::Server::Server(const ServerOptions& opts) :
+	m_iOpts(opts),
+	m_uPort(0),
+	m_bRun(false),
+	m_iRegistry(opts.Shards, opts.Ttl, opts.Capacity),
+	m_uExpired(0)
+{
+}
+
+
+vsnc::rendezvous::Server::~Server()
+{
+	Stop();
+}
+
+
+bool vsnc::rendezvous::Server::Start()
+{
+	if (m_bRun) {
+		return true;
+	}
+	auto workers = UdpShard::Shareable() ? (std::max)(m_iOpts.Workers, static_cast<std::size_t>(1)) : 1;
+	auto port = m_iOpts.Port;
+	for (std::size_t i = 0; i < workers; ++i) {
+		std::unique_ptr<UdpShard> io(new UdpShard);
+		if (!io->Open(port, workers > 1)) {
+			m_iShards.clear();
+			m_iCounters.clear();
+			return false;
+		}
+		// 端口为0时其余分片绑定第一个分片分配到的端口
+		port = io->Port();
+		m_iShards.push_back(std::move(io));
+		m_iCounters.emplace_back(new __counters);
+	}
+	m_uPort = port;
+	m_bRun = true;
+	for (std::size_t i = 0; i < workers; ++i) {
+		m_iThreads.emplace_back(&Server::_Work, this, std::ref(*m_iShards[i]), std::ref(*m_iCounters[i]));
+	}
+	m_iThreads.emplace_back(&Server::_Expire, this);
+	return true;
+}
+
+
+void vsnc::rendezvous::Server::Stop()
+{
+	if (!m_bRun.exchange(false)) {
+		return;
+	}
+	// 工作线程最多等待Max_Wait毫秒即检查运行状态
+	for (auto& t : m_iThreads) {
+		t.join();
+	}
+	m_iThreads.clear();
+	m_iShards.clear();
+	m_iCounters.clear();
+	m_uPort = 0;
+}
+
+
+vsnc::rendezvous::ServerStats vsnc::rendezvous::Server::GetStats()
+{
+	ServerStats stats;
+	for (auto& c : m_iCounters) {
+		stats.Registers += c->registers.load(std::memory_order_relaxed);
+		stats.Heartbeats += c->heartbeats.load(std::memory_order_relaxed);
+		stats.Connects += c->connects.load(std::memory_order_relaxed);
+		stats.Matches += c->matches.load(std::memory_order_relaxed);
+		stats.NotFound += c->notFound.load(std::memory_order_relaxed);
+		stats.Unregisters += c->unregisters.load(std::memory_order_relaxed);
+		stats.Relayed += c->relayed.load(std::memory_order_relaxed);
+		stats.Unknown += c->unknown.load(std::memory_order_relaxed);
+		stats.Malformed += c->malformed.load(std::memory_order_relaxed);
+	}
+	stats.Expired = m_uExpired.load(std::memory_order_relaxed);
+	stats.Registered = m_iRegistry.Size();
+	return stats;
+}
+
+
+void vsnc::rendezvous::Server::_Work(UdpShard& io, __counters& c)
+{
+	Datagram batch[UdpShard::Batch];
+	while (m_bRun.load(std::memory_order_relaxed)) {
+		auto n = io.Receive(batch, Max_Wait);
+		for (std::size_t i = 0; i < n; ++i) {
+			_Handle(io, batch[i], c);
+		}
+	}
+}
+
+
+void vsnc::rendezvous::Server::_Expire()
+{
+	while (m_bRun) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		m_uExpired.fetch_add(m_iRegistry.Expire(nowMilliseconds()), std::memory_order_relaxed);
+	}
+}
+
+
+void vsnc::rendezvous::Server::_Handle(UdpShard& io, const Datagram& dgram, __counters& c)
+{
+	punch::Message msg;
+	if (!punch::__decode(dgram.Data, dgram.Len, msg) || (0 == msg.Seqno)) {
+		c.malformed.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	auto now = nowMilliseconds();
+	punch::Message reply;
+	reply.ServerTime = utils::__utc();
+	reply.Ts = msg.Ts;
+	if (punch::message_type::REGISTER == msg.Type) {
+		c.registers.fetch_add(1, std::memory_order_relaxed);
+		Record rec;
+		rec.External = dgram.From;
+		rec.Intranet = msg.Intranet;
+		rec.Ts = msg.Ts;
+		m_iRegistry.Register(msg.Seqno, rec, now);
+		reply.Type = punch::message_type::ACK;
+		_Reply(io, reply, dgram.From);
+		return;
+	}
+	if ((punch::message_type::ACK == msg.Type) || (punch::message_type::EVENT == msg.Type)) {
+		c.malformed.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	// 其余报文都刷新发送方的注册，NAT映射变化时随之更新公网端点
+	Record self;
+	auto found = m_iRegistry.Update(msg.Seqno, now, [&](Record& rec) {
+		rec.External = dgram.From;
+		rec.Ts = msg.Ts;
+		rec.State = msg.State;
+		if (punch::message_type::HEARTBEAT == msg.Type) {
+			rec.Intranet = msg.Intranet;
+		}
+		self = rec;
+	});
+	if (!found) {
+		// 注册已过期或服务器重启过，要求客户端重新注册
+		c.unknown.fetch_add(1, std::memory_order_relaxed);
+		reply.Type = punch::message_type::ACK;
+		reply.State = punch::State_Unknown;
+		_Reply(io, reply, dgram.From);
+		return;
+	}
+	switch (msg.Type)
+	{
+	case punch::message_type::HEARTBEAT:
+		c.heartbeats.fetch_add(1, std::memory_order_relaxed);
+		reply.Type = punch::message_type::ACK;
+		reply.State = msg.State;
+		_Reply(io, reply, dgram.From);
+		if (msg.Peer && isLinked(msg.State)) {
+			_Relay(io, dgram, msg.Seqno, self, now, c);
+		}
+		break;
+	case punch::message_type::BYE:
+		if (!msg.Peer) {
+			c.unregisters.fetch_add(1, std::memory_order_relaxed);
+			m_iRegistry.Unregister(msg.Seqno);
+		}
+		else {
+			_Relay(io, dgram, msg.Seqno, self, now, c);
+		}
+		break;
+	case punch::message_type::CONNECT:
+	{
+		c.connects.fetch_add(1, std::memory_order_relaxed);
+		Record target;
+		if ((msg.Peer == msg.Seqno) || !m_iRegistry.Lookup(msg.Peer, target, now)) {
+			c.notFound.fetch_add(1, std::memory_order_relaxed);
+			reply.Type = punch::message_type::ACK;
+			_Reply(io, reply, dgram.From);
+			break;
+		}
+		c.matches.fetch_add(1, std::memory_order_relaxed);
+		// 双方记录本次连接，RELAY时据此转发
+		m_iRegistry.Update(msg.Seqno, now, [&](Record& rec) { rec.Peer = msg.Peer; rec.Conn = msg.Conn; });
+		m_iRegistry.Update(msg.Peer, now, [&](Record& rec) { rec.Peer = msg.Seqno; rec.Conn = msg.Conn; });
+		// 双方同时得到对方的内网与公网端点后，按连接方式各自向对方发包打洞
+		reply.Type = punch::message_type::EVENT;
+		reply.Conn = msg.Conn;
+		reply.State = target.State;
+		reply.Ts = target.Ts;
+		reply.Peer = msg.Peer;
+		reply.Intranet = target.Intranet;
+		reply.External = target.External;
+		_Reply(io, reply, dgram.From);
+		reply.State = self.State;
+		reply.Ts = self.Ts;
+		reply.Peer = msg.Seqno;
+		reply.Intranet = self.Intranet;
+		reply.External = self.External;
+		_Reply(io, reply, target.External);
+		break;
+	}
+	case punch::message_type::DATA:
+		_Relay(io, dgram, msg.Seqno, self, now, c);
+		break;
+	default:
+		break;
+	}
+}
+
+
+void vsnc::rendezvous::Server::_Relay(UdpShard& io, const Datagram& dgram, const uint64_t seqno, const Record& rec, const int64_t now, __counters& c)
+{
+	if (punch::conn_type::RELAY != rec.Conn) {
+		return;
+	}
+	// 只在双方互为对端时转发，不能借服务器向任意注册者发包
+	Record peer;
+	if (!m_iRegistry.Lookup(rec.Peer, peer, now) || (punch::conn_type::RELAY != peer.Conn) || (seqno != peer.Peer)) {
+		return;
+	}
+	c.relayed.fetch_add(1, std::memory_order_relaxed);
+	io.Send(dgram.Data, dgram.Len, peer.External);
+}
+
+
+void vsnc::rendezvous::Server::_Reply(UdpShard& io, const punch::Message& msg, const punch::Endpoint& ep)
+{
+	char buf[punch::Max_Control_Len];
+	io.Send(buf, punch::__encode(msg, buf), ep);
+}
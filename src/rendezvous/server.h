@@ -0,0 +1,215 @@
+﻿/************************************************************************
+ * @ObjectName: server.h
+ * @Description: 打洞服务器
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_RENDEZVOUS_SERVER_H__
+#define __VSNC_RENDEZVOUS_SERVER_H__
+
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+
+#include <stdint.h>
+
+
+#include "registry.h"
+#include "udp_shard.h"
+
+
+namespace vsnc
+{
+
+	namespace rendezvous
+	{
+
+
+		/// <summary>
+		/// 服务器参数
+		/// </summary>
+		struct ServerOptions
+		{
+			/// <summary>监听端口</summary>
+			uint16_t    Port     = 10000;
+			/// <summary>工作线程个数，每个线程一个UdpShard；Windows下各线程共用一个RIO套接字，其他平台各自独占一个套接字</summary>
+			std::size_t Workers  = 4;
+			/// <summary>注册表分片个数</summary>
+			std::size_t Shards   = 64;
+			/// <summary>以毫秒为单位的注册有效期，与p2p.dll的服务器相同</summary>
+			int64_t     Ttl      = 10000;
+			/// <summary>预计的注册总数</summary>
+			std::size_t Capacity = 131072;
+		};
+
+
+		/// <summary>
+		/// 服务器统计信息
+		/// </summary>
+		struct ServerStats
+		{
+			/// <summary>收到的注册请求个数</summary>
+			uint64_t    Registers   = 0;
+			/// <summary>收到的心跳个数</summary>
+			uint64_t    Heartbeats  = 0;
+			/// <summary>收到的连接请求个数</summary>
+			uint64_t    Connects    = 0;
+			/// <summary>成功匹配的连接请求个数</summary>
+			uint64_t    Matches     = 0;
+			/// <summary>对端不存在的连接请求个数</summary>
+			uint64_t    NotFound    = 0;
+			/// <summary>收到的下线请求个数</summary>
+			uint64_t    Unregisters = 0;
+			/// <summary>中转的报文个数</summary>
+			uint64_t    Relayed     = 0;
+			/// <summary>来自未注册客户端、被要求重新注册的报文个数</summary>
+			uint64_t    Unknown     = 0;
+			/// <summary>格式错误的报文个数</summary>
+			uint64_t    Malformed   = 0;
+			/// <summary>过期删除的注册个数</summary>
+			uint64_t    Expired     = 0;
+			/// <summary>当前注册总数</summary>
+			std::size_t Registered  = 0;
+		};
+
+
+		/// <summary>
+		/// <para>打洞服务器，与p2p.dll的客户端协议兼容，报文格式见punch::message_type</para>
+		/// <para>每个工作线程独占一个绑定在同一端口上的UdpShard，批量接收并直接从本线程发出应答；共享状态只有按序列号分片加锁的注册表与Windows下RIO队列的出入队</para>
+		/// <para>连接方式为RELAY的双方之间的心跳、离开与数据由服务器原样转发</para>
+		/// <para>另有一个线程每100毫秒推进注册表的时间轮，删除过期的注册</para>
+		/// </summary>
+		class Server
+		{
+		private:
+
+			/// <summary>
+			/// 单个工作线程的计数器，独占缓存行以免伪共享
+			/// </summary>
+			struct __counters
+			{
+				std::atomic<uint64_t> registers   { 0 };
+				std::atomic<uint64_t> heartbeats  { 0 };
+				std::atomic<uint64_t> connects    { 0 };
+				std::atomic<uint64_t> matches     { 0 };
+				std::atomic<uint64_t> notFound    { 0 };
+				std::atomic<uint64_t> unregisters { 0 };
+				std::atomic<uint64_t> relayed     { 0 };
+				std::atomic<uint64_t> unknown     { 0 };
+				std::atomic<uint64_t> malformed   { 0 };
+				/// <summary>填充到三个缓存行，new在C++14中不保证超过16字节的对齐</summary>
+				char                  padding[192 - 9 * sizeof(std::atomic<uint64_t>)];
+			};
+
+		public:
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			/// <param name="opts">服务器参数</param>
+			explicit Server(const ServerOptions& opts = ServerOptions());
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			Server(const Server&) = delete;
+
+			/// <summary>
+			/// 析构函数，停止服务
+			/// </summary>
+			~Server();
+
+			/// <summary>
+			/// 绑定端口并启动工作线程，端口为0时由系统分配
+			/// </summary>
+			/// <returns>成功返回true，失败返回false</returns>
+			bool        Start();
+
+			/// <summary>
+			/// 停止服务并等待线程退出
+			/// </summary>
+			void        Stop();
+
+			/// <summary>
+			/// 获取实际监听的端口
+			/// </summary>
+			/// <returns>端口，未启动时返回0</returns>
+			uint16_t    Port() const noexcept { return m_uPort; }
+
+			/// <summary>
+			/// 获取统计信息
+			/// </summary>
+			/// <returns>统计信息</returns>
+			ServerStats GetStats();
+
+		private:
+
+			/// <summary>
+			/// 工作线程
+			/// </summary>
+			/// <param name="io">本线程的收发端</param>
+			/// <param name="c">本线程的计数器</param>
+			void        _Work(UdpShard& io, __counters& c);
+
+			/// <summary>
+			/// 过期检查线程
+			/// </summary>
+			void        _Expire();
+
+			/// <summary>
+			/// 处理一个报文
+			/// </summary>
+			/// <param name="io">本线程的收发端</param>
+			/// <param name="dgram">报文</param>
+			/// <param name="c">本线程的计数器</param>
+			void        _Handle(UdpShard& io, const Datagram& dgram, __counters& c);
+
+			/// <summary>
+			/// 向连接方式为RELAY的对端原样转发报文
+			/// </summary>
+			/// <param name="io">本线程的收发端</param>
+			/// <param name="dgram">报文</param>
+			/// <param name="seqno">发送方序列号</param>
+			/// <param name="rec">发送方的注册信息</param>
+			/// <param name="now">以毫秒为单位的单调时间</param>
+			/// <param name="c">本线程的计数器</param>
+			void        _Relay(UdpShard& io, const Datagram& dgram, const uint64_t seqno, const Record& rec, const int64_t now, __counters& c);
+
+			/// <summary>
+			/// 发送报文
+			/// </summary>
+			/// <param name="io">本线程的收发端</param>
+			/// <param name="msg">报文</param>
+			/// <param name="ep">目的地址</param>
+			static void _Reply(UdpShard& io, const punch::Message& msg, const punch::Endpoint& ep);
+
+		private:
+
+			/// <summary>服务器参数</summary>
+			const ServerOptions                         m_iOpts;
+			/// <summary>实际监听的端口</summary>
+			uint16_t                                    m_uPort;
+			/// <summary>运行状态</summary>
+			std::atomic<bool>                           m_bRun;
+			/// <summary>各工作线程的收发端</summary>
+			std::vector<std::unique_ptr<UdpShard>>      m_iShards;
+			/// <summary>注册表</summary>
+			Registry                                    m_iRegistry;
+			/// <summary>工作线程与过期检查线程</summary>
+			std::vector<std::thread>                    m_iThreads;
+			/// <summary>各工作线程的计数器</summary>
+			std::vector<std::unique_ptr<__counters>>    m_iCounters;
+			/// <summary>过期删除的注册个数</summary>
+			std::atomic<uint64_t>                       m_uExpired;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_RENDEZVOUS_SERVER_H__
@@ -0,0 +1,493 @@
+﻿/************************************************************************
+ * @ObjectName: udp_shard.cpp
+ * @Description: 打洞服务器单个工作线程独占的UDP收发端
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#include "udp_shard.h"
+
+
+#include <cstring>
+#ifdef _WIN32
+#include <map>
+#include <mutex>
+#include <winsock2.h>
+#include <WS2tcpip.h>
+#include <mswsock.h>
+#include <mstcpip.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#endif // _WIN32
+
+
+namespace
+{
+	/// <summary>每个缓冲区槽位的长度</summary>
+	constexpr std::size_t Slot_Len = vsnc::punch::Max_Datagram;
+	/// <summary>以字节为单位的接收缓冲区大小，吸收大量客户端同时注册时的突发</summary>
+	constexpr int         Rcv_Buf  = 8 * 1024 * 1024;
+}
+
+
+#ifdef _WIN32
+namespace
+{
+	/// <summary>始终投递着的接收个数</summary>
+	constexpr DWORD Recv_Slots = 1024;
+	/// <summary>同时未完成的发送个数上限</summary>
+	constexpr DWORD Send_Slots = 1024;
+
+
+	/// <summary>
+	/// <para>一个端口上的RIO套接字及其注册的缓冲区，由绑定同一端口的各分片共用</para>
+	/// <para>一个套接字只能创建一个请求队列，且RIO的请求队列与完成队列都不是线程安全的，出入队均在lock下进行</para>
+	/// </summary>
+	struct __endpoint
+	{
+		/// <summary>以WSA_FLAG_REGISTERED_IO创建的套接字</summary>
+		SOCKET                       sock   = INVALID_SOCKET;
+		/// <summary>RIO函数表</summary>
+		RIO_EXTENSION_FUNCTION_TABLE rio;
+		/// <summary>接收与发送共用的完成队列</summary>
+		RIO_CQ                       cq     = RIO_INVALID_CQ;
+		/// <summary>请求队列</summary>
+		RIO_RQ                       rq     = RIO_INVALID_RQ;
+		/// <summary>完成队列非空时触发的自动复位事件，一次只唤醒一个等待的分片</summary>
+		HANDLE                       event  = nullptr;
+		/// <summary>数据缓冲区，前Recv_Slots个槽位用于接收，其余用于发送；请求上下文即槽位下标</summary>
+		char*                        data   = nullptr;
+		/// <summary>与数据槽位一一对应的地址缓冲区</summary>
+		SOCKADDR_INET*               addrs  = nullptr;
+		/// <summary>数据缓冲区的注册号</summary>
+		RIO_BUFFERID                 dataId = RIO_INVALID_BUFFERID;
+		/// <summary>地址缓冲区的注册号</summary>
+		RIO_BUFFERID                 addrId = RIO_INVALID_BUFFERID;
+		/// <summary>保护请求队列、完成队列与空闲的发送槽位</summary>
+		std::mutex                   lock;
+		/// <summary>空闲的发送槽位</summary>
+		std::vector<DWORD>           sends;
+
+		/// <summary>
+		/// 析构函数，释放套接字与注册的缓冲区
+		/// </summary>
+		~__endpoint()
+		{
+			if (INVALID_SOCKET != sock) {
+				// 请求队列随套接字一起释放
+				closesocket(sock);
+			}
+			if (RIO_INVALID_CQ != cq) {
+				rio.RIOCloseCompletionQueue(cq);
+			}
+			if (RIO_INVALID_BUFFERID != dataId) {
+				rio.RIODeregisterBuffer(dataId);
+			}
+			if (RIO_INVALID_BUFFERID != addrId) {
+				rio.RIODeregisterBuffer(addrId);
+			}
+			if (data) {
+				VirtualFree(data, 0, MEM_RELEASE);
+			}
+			if (addrs) {
+				VirtualFree(addrs, 0, MEM_RELEASE);
+			}
+			if (event) {
+				CloseHandle(event);
+			}
+		}
+
+		/// <summary>
+		/// 创建套接字、注册缓冲区并投递全部接收
+		/// </summary>
+		/// <param name="port">端口</param>
+		/// <returns>成功返回true，失败返回false，已创建的资源由析构函数释放</returns>
+		bool Open(const uint16_t port)
+		{
+			sock = WSASocket(AF_INET, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+			if (INVALID_SOCKET == sock) {
+				return false;
+			}
+			GUID id = WSAID_MULTIPLE_RIO;
+			DWORD bytes = 0;
+			if (WSAIoctl(sock, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, &id, sizeof(id), &rio, sizeof(rio), &bytes, nullptr, nullptr) != 0) {
+				return false;
+			}
+			setsockopt(sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&Rcv_Buf), sizeof(Rcv_Buf));
+			// 客户端下线后发往它的报文会引起ICMP端口不可达，不应使接收失败
+			BOOL reset = FALSE;
+			WSAIoctl(sock, SIO_UDP_CONNRESET, &reset, sizeof(reset), nullptr, 0, &bytes, nullptr, nullptr);
+			sockaddr_in addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_port = htons(port);
+			addr.sin_addr.s_addr = htonl(INADDR_ANY);
+			if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+				return false;
+			}
+			constexpr DWORD total = Recv_Slots + Send_Slots;
+			data = static_cast<char*>(VirtualAlloc(nullptr, total * Slot_Len, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+			addrs = static_cast<SOCKADDR_INET*>(VirtualAlloc(nullptr, total * sizeof(SOCKADDR_INET), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+			event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+			if (!data || !addrs || !event) {
+				return false;
+			}
+			dataId = rio.RIORegisterBuffer(data, static_cast<DWORD>(total * Slot_Len));
+			addrId = rio.RIORegisterBuffer(reinterpret_cast<PCHAR>(addrs), static_cast<DWORD>(total * sizeof(SOCKADDR_INET)));
+			RIO_NOTIFICATION_COMPLETION notify;
+			notify.Type = RIO_EVENT_COMPLETION;
+			notify.Event.EventHandle = event;
+			notify.Event.NotifyReset = TRUE;
+			cq = rio.RIOCreateCompletionQueue(total, &notify);
+			if ((RIO_INVALID_BUFFERID == dataId) || (RIO_INVALID_BUFFERID == addrId) || (RIO_INVALID_CQ == cq)) {
+				return false;
+			}
+			rq = rio.RIOCreateRequestQueue(sock, Recv_Slots, 1, Send_Slots, 1, cq, cq, nullptr);
+			if (RIO_INVALID_RQ == rq) {
+				return false;
+			}
+			for (DWORD slot = 0; slot < Recv_Slots; ++slot) {
+				Post(slot);
+			}
+			sends.reserve(Send_Slots);
+			for (DWORD slot = Recv_Slots; slot < total; ++slot) {
+				sends.push_back(slot);
+			}
+			return true;
+		}
+
+		/// <summary>
+		/// 投递一个接收，调用者须持有lock
+		/// </summary>
+		/// <param name="slot">接收槽位</param>
+		void Post(const DWORD slot) noexcept
+		{
+			RIO_BUF buf;
+			buf.BufferId = dataId;
+			buf.Offset = static_cast<ULONG>(slot * Slot_Len);
+			buf.Length = static_cast<ULONG>(Slot_Len);
+			RIO_BUF addr;
+			addr.BufferId = addrId;
+			addr.Offset = static_cast<ULONG>(slot * sizeof(SOCKADDR_INET));
+			addr.Length = sizeof(SOCKADDR_INET);
+			rio.RIOReceiveEx(rq, &buf, 1, nullptr, &addr, nullptr, nullptr, 0, reinterpret_cast<PVOID>(static_cast<ULONG_PTR>(slot)));
+		}
+	};
+
+
+	/// <summary>保护endpoints</summary>
+	std::mutex                                      endpointsLock;
+	/// <summary>以共享方式打开的端点，按端口索引，最后一个分片关闭时端点随之释放</summary>
+	std::map<uint16_t, std::weak_ptr<__endpoint>>   endpoints;
+}
+
+
+struct vsnc::rendezvous::UdpShard::__impl
+{
+	/// <summary>共用或独占的端点</summary>
+	std::shared_ptr<__endpoint> ep;
+	/// <summary>上一次Receive交出、待重新投递的接收槽位</summary>
+	std::vector<DWORD>          reposts;
+};
+
+
+vsnc::rendezvous::UdpShard::UdpShard() : m_upImpl(new __impl)
+{
+}
+
+
+vsnc::rendezvous::UdpShard::~UdpShard()
+{
+	Close();
+}
+
+
+bool vsnc::rendezvous::UdpShard::Shareable() noexcept
+{
+	return true;
+}
+
+
+bool vsnc::rendezvous::UdpShard::Open(const uint16_t port, const bool share)
+{
+	auto& d = *m_upImpl;
+	d.reposts.reserve(Batch);
+	if (!share) {
+		d.ep = std::make_shared<__endpoint>();
+		if (!d.ep->Open(port)) {
+			d.ep.reset();
+			return false;
+		}
+		return true;
+	}
+	// 一个端口只能有一个RIO请求队列，其余分片共用先打开者的端点
+	std::lock_guard<std::mutex> guard(endpointsLock);
+	if (port) {
+		auto iter = endpoints.find(port);
+		if (endpoints.end() != iter) {
+			d.ep = iter->second.lock();
+			if (d.ep) {
+				return true;
+			}
+		}
+	}
+	d.ep = std::make_shared<__endpoint>();
+	if (!d.ep->Open(port)) {
+		d.ep.reset();
+		return false;
+	}
+	endpoints[Port()] = d.ep;
+	return true;
+}
+
+
+void vsnc::rendezvous::UdpShard::Close() noexcept
+{
+	auto& d = *m_upImpl;
+	if (d.ep && !d.reposts.empty()) {
+		// 共用的端点可能仍在使用，交还持有的接收槽位
+		std::lock_guard<std::mutex> guard(d.ep->lock);
+		for (auto slot : d.reposts) {
+			d.ep->Post(slot);
+		}
+	}
+	d.reposts.clear();
+	d.ep.reset();
+}
+
+
+uint16_t vsnc::rendezvous::UdpShard::Port() const noexcept
+{
+	sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	if (!m_upImpl->ep || (getsockname(m_upImpl->ep->sock, reinterpret_cast<sockaddr*>(&addr), &len) == SOCKET_ERROR)) {
+		return 0;
+	}
+	return ntohs(addr.sin_port);
+}
+
+
+std::size_t vsnc::rendezvous::UdpShard::Receive(Datagram* const out, const int64_t timeout)
+{
+	auto& d = *m_upImpl;
+	auto& e = *d.ep;
+	RIORESULT results[Batch];
+	ULONG n = 0;
+	{
+		std::lock_guard<std::mutex> guard(e.lock);
+		for (auto slot : d.reposts) {
+			e.Post(slot);
+		}
+		n = e.rio.RIODequeueCompletion(e.cq, results, static_cast<DWORD>(Batch));
+		if (0 == n) {
+			// 队列为空时才请求通知，其他分片已请求时返回WSAEALREADY，可忽略
+			e.rio.RIONotify(e.cq);
+		}
+	}
+	d.reposts.clear();
+	if (0 == n) {
+		if (WaitForSingleObject(e.event, static_cast<DWORD>(timeout)) != WAIT_OBJECT_0) {
+			return 0;
+		}
+		std::lock_guard<std::mutex> guard(e.lock);
+		n = e.rio.RIODequeueCompletion(e.cq, results, static_cast<DWORD>(Batch));
+	}
+	if (RIO_CORRUPT_CQ == n) {
+		return 0;
+	}
+	if (Batch == n) {
+		// 取满一批说明完成队列中可能还有，唤醒另一个等待中的分片并行处理
+		SetEvent(e.event);
+	}
+	std::size_t count = 0;
+	std::size_t sent = 0;
+	DWORD done[Batch];
+	for (ULONG i = 0; i < n; ++i) {
+		auto slot = static_cast<DWORD>(results[i].RequestContext);
+		if (slot >= Recv_Slots) {
+			done[sent++] = slot;
+			continue;
+		}
+		// 接收槽位由取得它的分片在下一次Receive时重新投递，数据在此之前有效
+		d.reposts.push_back(slot);
+		if ((0 != results[i].Status) || (0 == results[i].BytesTransferred)) {
+			continue;
+		}
+		auto& from = e.addrs[slot].Ipv4;
+		out[count].Data = e.data + slot * Slot_Len;
+		out[count].Len = results[i].BytesTransferred;
+		out[count].From.Ip = from.sin_addr.s_addr;
+		out[count].From.Port = ntohs(from.sin_port);
+		++count;
+	}
+	if (sent) {
+		std::lock_guard<std::mutex> guard(e.lock);
+		e.sends.insert(e.sends.end(), done, done + sent);
+	}
+	return count;
+}
+
+
+bool vsnc::rendezvous::UdpShard::Send(const char* const buf, const std::size_t len, const punch::Endpoint& to)
+{
+	auto& e = *m_upImpl->ep;
+	if (len > Slot_Len) {
+		return false;
+	}
+	std::lock_guard<std::mutex> guard(e.lock);
+	if (e.sends.empty()) {
+		return false;
+	}
+	auto slot = e.sends.back();
+	e.sends.pop_back();
+	memcpy(e.data + slot * Slot_Len, buf, len);
+	auto& addr = e.addrs[slot].Ipv4;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = to.Ip;
+	addr.sin_port = htons(to.Port);
+	RIO_BUF data;
+	data.BufferId = e.dataId;
+	data.Offset = static_cast<ULONG>(slot * Slot_Len);
+	data.Length = static_cast<ULONG>(len);
+	RIO_BUF remote;
+	remote.BufferId = e.addrId;
+	remote.Offset = static_cast<ULONG>(slot * sizeof(SOCKADDR_INET));
+	remote.Length = sizeof(SOCKADDR_INET);
+	if (!e.rio.RIOSendEx(e.rq, &data, 1, nullptr, &remote, nullptr, nullptr, 0, reinterpret_cast<PVOID>(static_cast<ULONG_PTR>(slot)))) {
+		e.sends.push_back(slot);
+		return false;
+	}
+	return true;
+}
+#else
+struct vsnc::rendezvous::UdpShard::__impl
+{
+	/// <summary>非阻塞的UDP套接字</summary>
+	int               sock = -1;
+	/// <summary>只监听sock的epoll</summary>
+	int               ep   = -1;
+	/// <summary>Batch个接收槽位</summary>
+	std::vector<char> bufs;
+};
+
+
+vsnc::rendezvous::UdpShard::UdpShard() : m_upImpl(new __impl)
+{
+}
+
+
+vsnc::rendezvous::UdpShard::~UdpShard()
+{
+	Close();
+}
+
+
+bool vsnc::rendezvous::UdpShard::Shareable() noexcept
+{
+	return true;
+}
+
+
+bool vsnc::rendezvous::UdpShard::Open(const uint16_t port, const bool share)
+{
+	auto& d = *m_upImpl;
+	d.sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (-1 == d.sock) {
+		return false;
+	}
+	int on = 1;
+	if (share) {
+		setsockopt(d.sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+	}
+	setsockopt(d.sock, SOL_SOCKET, SO_RCVBUF, &Rcv_Buf, sizeof(Rcv_Buf));
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if ((bind(d.sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) || (fcntl(d.sock, F_SETFL, fcntl(d.sock, F_GETFL) | O_NONBLOCK) == -1)) {
+		Close();
+		return false;
+	}
+	d.ep = epoll_create1(0);
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = d.sock;
+	if ((-1 == d.ep) || (epoll_ctl(d.ep, EPOLL_CTL_ADD, d.sock, &ev) == -1)) {
+		Close();
+		return false;
+	}
+	d.bufs.resize(Batch * Slot_Len);
+	return true;
+}
+
+
+void vsnc::rendezvous::UdpShard::Close() noexcept
+{
+	auto& d = *m_upImpl;
+	if (-1 != d.ep) {
+		close(d.ep);
+		d.ep = -1;
+	}
+	if (-1 != d.sock) {
+		close(d.sock);
+		d.sock = -1;
+	}
+}
+
+
+uint16_t vsnc::rendezvous::UdpShard::Port() const noexcept
+{
+	sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	if ((-1 == m_upImpl->sock) || (getsockname(m_upImpl->sock, reinterpret_cast<sockaddr*>(&addr), &len) == -1)) {
+		return 0;
+	}
+	return ntohs(addr.sin_port);
+}
+
+
+std::size_t vsnc::rendezvous::UdpShard::Receive(Datagram* const out, const int64_t timeout)
+{
+	auto& d = *m_upImpl;
+	epoll_event ev;
+	if (epoll_wait(d.ep, &ev, 1, static_cast<int>(timeout)) <= 0) {
+		return 0;
+	}
+	std::size_t count = 0;
+	while (count < Batch) {
+		auto buf = d.bufs.data() + count * Slot_Len;
+		sockaddr_in from;
+		socklen_t len = sizeof(from);
+		auto ret = recvfrom(d.sock, buf, Slot_Len, 0, reinterpret_cast<sockaddr*>(&from), &len);
+		if (ret < 0) {
+			break;
+		}
+		if (0 == ret) {
+			continue;
+		}
+		out[count].Data = buf;
+		out[count].Len = static_cast<std::size_t>(ret);
+		out[count].From.Ip = from.sin_addr.s_addr;
+		out[count].From.Port = ntohs(from.sin_port);
+		++count;
+	}
+	return count;
+}
+
+
+bool vsnc::rendezvous::UdpShard::Send(const char* const buf, const std::size_t len, const punch::Endpoint& to)
+{
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = to.Ip;
+	addr.sin_port = htons(to.Port);
+	return sendto(m_upImpl->sock, buf, len, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) >= 0;
+}
+#endif // _WIN32
@@ -0,0 +1,128 @@
+﻿/************************************************************************
+ * @ObjectName: udp_shard.h
+ * @Description: 打洞服务器单个工作线程独占的UDP收发端
+ * @Author: agent
+ * @Date: 2026/10/19
+ ***********************************************************************/
+#ifndef __VSNC_RENDEZVOUS_UDP_SHARD_H__
+#define __VSNC_RENDEZVOUS_UDP_SHARD_H__
+
+
+#include <vector>
+#include <memory>
+
+
+#include <stdint.h>
+
+
+#include "../punch/protocol.h"
+
+
+namespace vsnc
+{
+
+	namespace rendezvous
+	{
+
+
+		/// <summary>
+		/// 收到的数据报，内容在下一次调用Receive之前有效
+		/// </summary>
+		struct Datagram
+		{
+			/// <summary>数据</summary>
+			const char*     Data = nullptr;
+			/// <summary>数据长度</summary>
+			std::size_t     Len  = 0;
+			/// <summary>发送方端点</summary>
+			punch::Endpoint From;
+		};
+
+
+		/// <summary>
+		/// <para>单个工作线程独占的UDP收发端，所有接口只能在同一个线程中调用</para>
+		/// <para>Windows下使用注册I/O（RIO）：接收缓冲区预先注册并始终保持投递，一次出队批量取得完成的接收与发送，没有逐包的系统调用与缓冲区锁定</para>
+		/// <para>Windows不能让多个套接字分担同一个UDP端口，一个套接字也只能有一个RIO请求队列，因此同一端口的各分片共用一个RIO套接字，加锁出入队，各自批量取走完成项后并行处理；其他平台以SO_REUSEPORT在同一端口上打开多个套接字，由内核按四元组分配到各分片，各自以epoll等待</para>
+		/// </summary>
+		class UdpShard
+		{
+		private:
+
+			/// <summary>平台相关的实现</summary>
+			struct __impl;
+
+		public:
+
+			/// <summary>每次Receive最多返回的数据报个数</summary>
+			static constexpr std::size_t Batch = 64;
+
+			/// <summary>
+			/// 构造函数
+			/// </summary>
+			UdpShard();
+
+			/// <summary>
+			/// 删除的拷贝构造函数
+			/// </summary>
+			UdpShard(const UdpShard&) = delete;
+
+			/// <summary>
+			/// 析构函数，关闭套接字
+			/// </summary>
+			~UdpShard();
+
+			/// <summary>
+			/// 判断当前平台是否支持多个分片共用一个端口
+			/// </summary>
+			/// <returns>支持返回true</returns>
+			static bool Shareable() noexcept;
+
+			/// <summary>
+			/// 绑定端口
+			/// </summary>
+			/// <param name="port">端口</param>
+			/// <param name="share">是否允许其他分片绑定同一端口，仅在Shareable()为true时有效</param>
+			/// <returns>成功返回true，失败返回false</returns>
+			bool        Open(const uint16_t port, const bool share);
+
+			/// <summary>
+			/// 关闭套接字
+			/// </summary>
+			void        Close() noexcept;
+
+			/// <summary>
+			/// 获取绑定的端口
+			/// </summary>
+			/// <returns>端口，未打开时返回0</returns>
+			uint16_t    Port() const noexcept;
+
+			/// <summary>
+			/// 等待并批量接收数据报，同时回收已完成的发送
+			/// </summary>
+			/// <param name="out">长度不小于Batch的数组</param>
+			/// <param name="timeout">以毫秒为单位的最长等待时间</param>
+			/// <returns>接收到的数据报个数，超时返回0</returns>
+			std::size_t Receive(Datagram* const out, const int64_t timeout);
+
+			/// <summary>
+			/// 发送数据报，发送队列已满时丢弃
+			/// </summary>
+			/// <param name="buf">数据</param>
+			/// <param name="len">数据长度，不超过punch::Max_Datagram</param>
+			/// <param name="to">目的端点</param>
+			/// <returns>成功投递返回true</returns>
+			bool        Send(const char* const buf, const std::size_t len, const punch::Endpoint& to);
+
+		private:
+
+			/// <summary>平台相关的实现</summary>
+			std::unique_ptr<__impl> m_upImpl;
+		};
+
+
+	}
+
+}
+
+
+#endif // !__VSNC_RENDEZVOUS_UDP_SHARD_H__